@@ -43,5 +43,167 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 ///
 #define FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE              0xFF
 
+///
+/// The version of the boot script table layout described below.
+///
+#define FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_VERSION                 0x0001
+
+///
+/// The boot script table is a sequence of variable length records that starts with a
+/// FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER record and ends with a terminate record. All
+/// fields have a fixed size so that a table saved by a 64-bit DXE phase can be executed
+/// by a 32-bit PEI phase on S3 resume.
+///
+#pragma pack(1)
+
+///
+/// The header common to all boot script records.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;   ///< The size, in bytes, of the whole record including trailing data.
+} FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER;
+
+///
+/// FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_OPCODE record, the first record of the table.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT16  Version;
+  UINT32  TableLength;  ///< The size, in bytes, of the table including this header and the terminate record.
+  UINT16  Reserved[2];
+} FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER;
+
+///
+/// EFI_BOOT_SCRIPT_IO_WRITE_OPCODE, EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE and
+/// EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE record. The record is followed by
+/// Count units of data, each of the size specified by Width.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT32  Width;      ///< EFI_BOOT_SCRIPT_WIDTH.
+  UINT32  Count;
+  UINT64  Address;
+} FRAMEWORK_EFI_BOOT_SCRIPT_WRITE;
+
+///
+/// EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE record. The record is followed by
+/// Count units of data, each of the size specified by Width.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT32  Width;
+  UINT32  Count;
+  UINT64  Address;
+  UINT16  Segment;
+} FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE;
+
+///
+/// EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE, EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE and
+/// EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE record. The value written back is
+/// ((Value read) & DataMask) | Data.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT32  Width;
+  UINT64  Address;
+  UINT64  Data;
+  UINT64  DataMask;
+} FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE;
+
+///
+/// EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE record.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT32  Width;
+  UINT64  Address;
+  UINT64  Data;
+  UINT64  DataMask;
+  UINT16  Segment;
+} FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE;
+
+///
+/// EFI_BOOT_SCRIPT_SMBUS_EXECUTE_OPCODE record. The record is followed by
+/// DataSize bytes of data.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT64  SlaveAddress;
+  UINT64  Command;
+  UINT32  Operation;  ///< EFI_SMBUS_OPERATION.
+  UINT8   PecCheck;
+  UINT32  DataSize;
+} FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE;
+
+///
+/// EFI_BOOT_SCRIPT_STALL_OPCODE record. Duration is in microseconds.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT64  Duration;
+} FRAMEWORK_EFI_BOOT_SCRIPT_STALL;
+
+///
+/// EFI_BOOT_SCRIPT_DISPATCH_OPCODE record.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT64  EntryPoint;
+} FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH;
+
+///
+/// FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2_OPCODE record.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT64  EntryPoint;
+  UINT64  Context;
+} FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2;
+
+///
+/// FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE record. The memory location is read
+/// until ((Value read) & DataMask) == Data, for at most LoopTimes reads that are
+/// separated by Duration microseconds.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT32  Width;
+  UINT64  Address;
+  UINT64  Data;
+  UINT64  DataMask;
+  UINT64  Duration;
+  UINT64  LoopTimes;
+} FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL;
+
+///
+/// EFI_BOOT_SCRIPT_INFORMATION_OPCODE record. The record is followed by
+/// InformationLength bytes of information that are ignored by the executor.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+  UINT32  InformationLength;
+} FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION;
+
+///
+/// FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE record, the last record of the table.
+///
+typedef struct {
+  UINT16  OpCode;
+  UINT8   Length;
+} FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE;
+
+#pragma pack()
 
 #endif
@@ -0,0 +1,64 @@
+/** @file
+  Definition of the GUIDed HOB that indexes the files of a firmware volume.
+
+  The files of a volume are indexed by one pass over their headers as soon as the
+  volume is found in PEI. Later lookups by name or by type read the index instead of
+  the file headers, which matters when the volume is executed in place from slow
+  flash. The HOBs are passed to DXE, which can use the same index.
+
+  A volume is described by one or more HOBs with the same FvBase, in the order of
+  the files. Each HOB holds up to FV_FILE_INDEX_ENTRIES_PER_HOB entries, and the
+  FileCount of the last one may be smaller.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _FV_FILE_INDEX_HOB_H_
+#define _FV_FILE_INDEX_HOB_H_
+
+#define FRAMEWORK_FV_FILE_INDEX_HOB_GUID \
+  { \
+    0x012f7d45, 0xbadf, 0x48df, { 0x93, 0x0b, 0xc0, 0x3d, 0xaf, 0x35, 0x21, 0x1f } \
+  }
+
+#define FV_FILE_INDEX_ENTRIES_PER_HOB   32
+
+///
+/// A file of a firmware volume. Pad files and files that are not valid are not
+/// indexed.
+///
+typedef struct {
+  EFI_GUID  Name;
+  UINT32    Offset;       ///< Offset of the file header from the start of the volume.
+  UINT8     Type;
+  UINT8     Attributes;
+  UINT8     State;        ///< EFI_FILE_DATA_VALID or EFI_FILE_MARKED_FOR_UPDATE.
+  UINT8     Reserved;
+} FV_FILE_INDEX_ENTRY;
+
+typedef struct {
+  EFI_PHYSICAL_ADDRESS  FvBase;
+  UINT64                FvLength;
+  UINT32                FirstFile;      ///< Number of Entry[0] in the order of the files.
+  UINT32                FileCount;      ///< Number of entries of this HOB.
+  ///
+  /// The following fields are valid in the HOB whose FirstFile is 0.
+  ///
+  UINT32                Complete;       ///< Nonzero when all the files are indexed.
+  UINT32                HeadersRead;    ///< File headers read to build the index.
+  UINT32                Lookups;        ///< Lookups served by the index.
+  UINT32                HeadersSaved;   ///< File headers the lookups did not read from the volume.
+  FV_FILE_INDEX_ENTRY   Entry[1];
+} FV_FILE_INDEX_HOB;
+
+extern EFI_GUID gFrameworkFvFileIndexHobGuid;
+
+#endif
@@ -0,0 +1,69 @@
+/** @file
+  Definition of the request ring shared between the code outside SMM and an SMM
+  driver, and of the doorbell message that has the driver handle the requests.
+
+  EFI_SMM_BASE_PROTOCOL.Communicate() takes one SMI per message. With the ring,
+  the code outside SMM writes any number of requests in place into the slots of
+  the ring, then sends one doorbell message through Communicate(): an
+  EFI_SMM_COMMUNICATE_HEADER whose HeaderGuid is FRAMEWORK_SMM_COMMUNICATE_RING_GUID
+  and whose MessageLength is 0. The SMM driver handles all the posted requests in
+  that SMI and writes the replies in place.
+
+  The ring is made of an SMM_COMMUNICATE_RING_HEADER followed by SlotCount slots
+  of SlotSize bytes. Each slot is an SMM_COMMUNICATE_RING_SLOT followed by the data
+  of the request, then of the reply.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_COMMUNICATE_RING_GUID_H_
+#define _SMM_COMMUNICATE_RING_GUID_H_
+
+#define FRAMEWORK_SMM_COMMUNICATE_RING_GUID \
+  { \
+    0x81bb6df7, 0x6dab, 0x4600, { 0x9f, 0xeb, 0xef, 0xe7, 0x29, 0xc2, 0xd3, 0xed } \
+  }
+
+#define SMM_COMMUNICATE_RING_SIGNATURE  SIGNATURE_32 ('S', 'C', 'R', 'G')
+
+///
+/// States of a slot.
+///
+#define SMM_COMMUNICATE_RING_SLOT_FREE    0   ///< Free, or being written.
+#define SMM_COMMUNICATE_RING_SLOT_POSTED  1   ///< Holds a request.
+#define SMM_COMMUNICATE_RING_SLOT_DONE    2   ///< Holds the reply to the request.
+
+typedef struct {
+  UINT32           Signature;
+  UINT32           SlotCount;       ///< Number of slots, a power of 2.
+  UINT32           SlotSize;        ///< Size of a slot, a multiple of 8.
+  UINT32           Reserved;
+  ///
+  /// The indexes count the slots since the ring was initialized; slot N is at
+  /// index N & (SlotCount - 1). Head and Tail are written outside SMM only, Done in
+  /// SMM only.
+  ///
+  volatile UINT32  Head;            ///< Requests posted.
+  volatile UINT32  Done;            ///< Requests handled.
+  volatile UINT32  Tail;            ///< Slots released by the code outside SMM.
+  UINT32           Reserved2;
+} SMM_COMMUNICATE_RING_HEADER;
+
+typedef struct {
+  volatile UINT32  State;           ///< SMM_COMMUNICATE_RING_SLOT_*.
+  UINT32           Length;          ///< Length of the request, then of the reply.
+  EFI_GUID         HeaderGuid;      ///< Handler of the request.
+  UINT64           Status;          ///< EFI_STATUS returned by the handler.
+} SMM_COMMUNICATE_RING_SLOT;
+
+extern EFI_GUID gFrameworkSmmCommunicateRingGuid;
+
+#endif
@@ -0,0 +1,82 @@
+/** @file
+  Definition of the messages that read the SMI latency profile through
+  EFI_SMM_BASE_PROTOCOL.Communicate().
+
+  The profile is a ring of records kept in SMRAM. A record gives the time that a
+  handler, a Communicate() callback or a whole SMI kept the processors in SMM, in
+  ticks of the performance counter, with the processor that ran it. The caller
+  puts an EFI_SMM_COMMUNICATE_HEADER whose HeaderGuid is
+  FRAMEWORK_SMM_LATENCY_PROFILE_GUID before an SMM_LATENCY_PROFILE_QUERY, and
+  reads the records in order by passing back the NextSequence it was returned.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_LATENCY_PROFILE_GUID_H_
+#define _SMM_LATENCY_PROFILE_GUID_H_
+
+#define FRAMEWORK_SMM_LATENCY_PROFILE_GUID \
+  { \
+    0x42857ba9, 0xd9fe, 0x4ddf, { 0x9a, 0xc3, 0xc5, 0xa5, 0x1c, 0xfc, 0x7c, 0x50 } \
+  }
+
+///
+/// What a record measures.
+///
+#define SMM_LATENCY_KIND_SMI          0   ///< A whole SMI, from the arrival of the processor in SMM.
+#define SMM_LATENCY_KIND_HANDLER      1   ///< A child handler of an SMM dispatch protocol.
+#define SMM_LATENCY_KIND_COMMUNICATE  2   ///< A callback called by Communicate().
+
+typedef struct {
+  ///
+  /// The address of the handler or of the callback, or 0 for a whole SMI.
+  ///
+  UINT64  Handler;
+  UINT64  Entry;              ///< Performance counter at the entry, counting up.
+  ///
+  /// Entry plus the ticks spent, which is the performance counter at the exit,
+  /// counting up, unless the counter wrapped around in between.
+  ///
+  UINT64  Exit;
+  ///
+  /// For a whole SMI, the ticks spent waiting for the other processors to enter
+  /// SMM, up to MAX_UINT32. 0 for the other records.
+  ///
+  UINT32  Rendezvous;
+  UINT16  Cpu;                ///< CurrentlyExecutingCpu of the SMST.
+  UINT8   Kind;               ///< SMM_LATENCY_KIND_*.
+  UINT8   Reserved;
+} SMM_LATENCY_RECORD;
+
+typedef struct {
+  ///
+  /// On input, the sequence number of the first record wanted, 0 for the oldest
+  /// one. On output, the sequence number of the record after the last one returned.
+  ///
+  UINT64              NextSequence;
+  ///
+  /// On output, the number of records after the wanted one that were overwritten
+  /// before they could be read.
+  ///
+  UINT64              Lost;
+  UINT64              Frequency;      ///< On output, the ticks per second of the performance counter.
+  ///
+  /// On input, the number of records that the message can hold. On output, the
+  /// number of records returned.
+  ///
+  UINT32              RecordCount;
+  UINT32              Reserved;
+  SMM_LATENCY_RECORD  Records[1];
+} SMM_LATENCY_PROFILE_QUERY;
+
+extern EFI_GUID gFrameworkSmmLatencyProfileGuid;
+
+#endif
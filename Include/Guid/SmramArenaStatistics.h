@@ -0,0 +1,83 @@
+/** @file
+  Definition of the message that reads the statistics of the SMRAM arena heap
+  through EFI_SMM_BASE_PROTOCOL.Communicate().
+
+  The caller puts an EFI_SMM_COMMUNICATE_HEADER whose HeaderGuid is
+  FRAMEWORK_SMRAM_ARENA_STATISTICS_GUID before an SMRAM_ARENA_STATISTICS_QUERY.
+  The answer holds the statistics of the heap and of as many arenas as fit in the
+  message, starting at the arena index that the caller asked for.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMRAM_ARENA_STATISTICS_GUID_H_
+#define _SMRAM_ARENA_STATISTICS_GUID_H_
+
+#define FRAMEWORK_SMRAM_ARENA_STATISTICS_GUID \
+  { \
+    0x724e1e85, 0x51a1, 0x4fde, { 0x8b, 0x06, 0xf8, 0x91, 0x7a, 0xd8, 0x92, 0x3c } \
+  }
+
+///
+/// Statistics of the pages of a heap. The fragmentation of the free pages shows in
+/// FreeRuns and LargestFreeRun.
+///
+typedef struct {
+  UINT32  TotalPages;         ///< Pages that the heap hands out.
+  UINT32  FreePages;          ///< Pages that are free.
+  UINT32  LargestFreeRun;     ///< Most contiguous free pages.
+  UINT32  FreeRuns;           ///< Runs of contiguous free pages.
+  UINT32  HighWaterPages;     ///< Most pages in use at once.
+  UINT32  ArenaCount;         ///< Arenas that are created.
+  UINT32  SlabPages;          ///< Pages in use as slabs.
+  UINT32  Reserved;
+  UINT64  SlabFreeBytes;      ///< Bytes of the slabs that are free.
+  UINT64  Failures;           ///< Allocations that found no free pages.
+} SMRAM_ARENA_HEAP_STATISTICS;
+
+///
+/// Statistics of an arena, since it was created.
+///
+typedef struct {
+  UINT64  Owner;              ///< The handle of the driver that owns the arena, 0 for none.
+  UINT32  Index;              ///< The index of the arena in the heap.
+  UINT32  Pages;              ///< Pages that the arena holds, out of the slabs.
+  UINT32  HighWaterPages;     ///< Most pages that the arena held at once.
+  UINT32  Reserved;
+  ///
+  /// Bytes handed out, rounded up to the size class of the slab or to pages.
+  ///
+  UINT64  BytesInUse;
+  UINT64  HighWaterBytes;     ///< Most bytes handed out at once.
+  UINT64  Allocations;
+  UINT64  Frees;
+  UINT64  Failures;
+} SMRAM_ARENA_STATISTICS;
+
+typedef struct {
+  ///
+  /// On input, the index of the first arena wanted, 0 for the first one. On output,
+  /// the index to pass back for the arenas that follow. All the arenas were returned
+  /// when fewer arenas than asked for are returned.
+  ///
+  UINT32                       NextIndex;
+  ///
+  /// On input, the number of arenas that the message can hold. On output, the
+  /// number of arenas returned.
+  ///
+  UINT32                       ArenaCount;
+  SMRAM_ARENA_HEAP_STATISTICS  Heap;
+  SMRAM_ARENA_STATISTICS       Arenas[1];
+} SMRAM_ARENA_STATISTICS_QUERY;
+
+extern EFI_GUID gFrameworkSmramArenaStatisticsGuid;
+
+#endif
@@ -0,0 +1,80 @@
+/** @file
+  Definition of the GUIDed HOB that indexes the variables of the read-only
+  variable store.
+
+  The variables are read once through the Read-only Variable PPI and copied with
+  their data into hash tables kept in HOBs. Later lookups hash the name and the
+  vendor GUID instead of scanning the store, and the HOBs are passed to DXE as a
+  snapshot of the variables seen by PEI.
+
+  The index is described by one or more HOBs in the order of the variables. Each
+  HOB has its own hash table of VARIABLE_INDEX_BUCKETS buckets and up to
+  VARIABLE_INDEX_MAX_RECORD_BYTES bytes of records. The offsets of the buckets and
+  of the records are relative to the first record of the HOB, so the HOBs can be
+  moved with the rest of the HOB list. The HOBs are never written once the index
+  is complete.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _VARIABLE_INDEX_HOB_H_
+#define _VARIABLE_INDEX_HOB_H_
+
+#define FRAMEWORK_VARIABLE_INDEX_HOB_GUID \
+  { \
+    0xca749370, 0x0cf2, 0x4eb6, { 0xa1, 0x2b, 0x35, 0x23, 0x9b, 0x6e, 0xba, 0xdc } \
+  }
+
+#define VARIABLE_INDEX_BUCKETS            64
+#define VARIABLE_INDEX_MAX_RECORD_BYTES   0xF000
+#define VARIABLE_INDEX_END                0xFFFF
+
+///
+/// A variable. The record is followed by the name, including its terminator, and
+/// by the data, and is padded to a multiple of 8 bytes.
+///
+typedef struct {
+  EFI_GUID  VendorGuid;
+  UINT32    Hash;           ///< Hash of the name and of the vendor GUID.
+  UINT32    Attributes;
+  UINT32    NameSize;       ///< Size of the name in bytes, including the terminator.
+  UINT32    DataSize;
+  UINT16    Next;           ///< Offset of the next record of the bucket, or VARIABLE_INDEX_END.
+  UINT16    Reserved[3];
+} VARIABLE_INDEX_RECORD;
+
+typedef struct {
+  UINT32    FirstVariable;  ///< Number of the first record in the order of the variables.
+  UINT32    VariableCount;  ///< Number of records of this HOB.
+  UINT32    RecordBytes;    ///< Size of the records of this HOB.
+  ///
+  /// The following fields are valid in the HOB whose FirstVariable is 0.
+  ///
+  UINT32    Complete;       ///< Nonzero when all the variables are indexed.
+  UINT32    StoreCalls;     ///< Calls to the Read-only Variable PPI to build the index.
+  UINT32    Reserved;
+  UINT16    Bucket[VARIABLE_INDEX_BUCKETS];   ///< Offset of the first record of each bucket,
+                                              ///< or VARIABLE_INDEX_END.
+} VARIABLE_INDEX_HOB;
+
+#define VARIABLE_INDEX_RECORD_SIZE(NameSize, DataSize) \
+  ALIGN_VALUE (sizeof (VARIABLE_INDEX_RECORD) + (NameSize) + (DataSize), 8)
+
+#define VARIABLE_INDEX_RECORD_AT(Hob, Offset) \
+  ((VARIABLE_INDEX_RECORD *) ((UINT8 *) ((Hob) + 1) + (Offset)))
+
+#define VARIABLE_INDEX_RECORD_NAME(Record)  ((CHAR16 *) ((Record) + 1))
+
+#define VARIABLE_INDEX_RECORD_DATA(Record)  ((UINT8 *) ((Record) + 1) + (Record)->NameSize)
+
+extern EFI_GUID gFrameworkVariableIndexHobGuid;
+
+#endif
@@ -0,0 +1,200 @@
+/** @file
+  Mailbox dispatch library for the application processors.
+
+  Keeps the application processors running a worker loop, started once with the
+  Framework MP Services Protocol, that waits on a mailbox of its own. The BSP posts
+  work items to a mailbox and checks their completion without going through the
+  protocol, so that small work items do not pay the wake-up and handshake of a
+  StartupThisAP() call each. The application processors either spin on their
+  mailbox or sleep in MWAIT on it, where the processor supports MONITOR/MWAIT.
+
+  The application processors stay busy until ApMailboxStop() is called, so the MP
+  Services Protocol must not be used for anything else meanwhile.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _AP_MAILBOX_LIB_H_
+#define _AP_MAILBOX_LIB_H_
+
+#include <Protocol/FrameworkMpService.h>
+
+///
+/// Number of work items that a mailbox holds.
+///
+#define AP_MAILBOX_DEPTH  8
+
+typedef struct _AP_MAILBOX_POOL  AP_MAILBOX_POOL;
+
+///
+/// How the application processors wait for work items.
+///
+typedef enum {
+  ApMailboxWaitSpin,      ///< Poll the mailbox. Lowest latency.
+  ApMailboxWaitMonitor,   ///< Sleep in MWAIT on the mailbox, or poll if MWAIT is not supported.
+  ApMailboxWaitMaximum
+} AP_MAILBOX_WAIT_MODE;
+
+///
+/// Counters of a mailbox pool, since it was started.
+///
+typedef struct {
+  UINTN   Mailboxes;        ///< Application processors that serve a mailbox.
+  BOOLEAN Monitor;          ///< The application processors wait in MWAIT.
+  UINT64  Posted;           ///< Work items posted.
+  UINT64  Completed;        ///< Work items completed.
+  UINT64  Refused;          ///< Posts refused because the mailbox was full.
+} AP_MAILBOX_STATISTICS;
+
+/**
+  Starts the application processors in their worker loop.
+
+  The function returns once the enabled application processors have reached their
+  loop, or after a second if some never do; the processors that did are given the
+  mailboxes from 0 to the Mailboxes counter minus 1.
+
+  @param  MpServices    The MP Services Protocol.
+  @param  WaitMode      How the application processors wait for work items.
+  @param  Pool          Returns the mailbox pool.
+
+  @retval EFI_SUCCESS             The application processors were started.
+  @retval EFI_INVALID_PARAMETER   MpServices or Pool is NULL, or WaitMode is not valid.
+  @retval EFI_NOT_FOUND           There is no enabled application processor.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+  @retval Others                  The status returned by StartupAllAPs().
+
+**/
+EFI_STATUS
+EFIAPI
+ApMailboxStart (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices,
+  IN  AP_MAILBOX_WAIT_MODE                WaitMode,
+  OUT AP_MAILBOX_POOL                     **Pool
+  );
+
+/**
+  Stops the application processors, once they have run the work items posted to
+  them, and frees the mailbox pool.
+
+  @param  Pool    The mailbox pool.
+
+**/
+VOID
+EFIAPI
+ApMailboxStop (
+  IN AP_MAILBOX_POOL  *Pool
+  );
+
+/**
+  Returns the number of mailboxes, one per application processor.
+
+  @param  Pool    The mailbox pool.
+
+  @return The number of mailboxes.
+
+**/
+UINTN
+EFIAPI
+ApMailboxGetCount (
+  IN AP_MAILBOX_POOL  *Pool
+  );
+
+/**
+  Posts a work item to a mailbox. The items of a mailbox are run in the order they
+  were posted.
+
+  @param  Pool        The mailbox pool.
+  @param  Mailbox     The mailbox.
+  @param  Procedure   The work item.
+  @param  Argument    The argument of the work item.
+  @param  Ticket      Returns the ticket of the work item, for ApMailboxIsDone() and
+                      ApMailboxWait().
+
+  @retval EFI_SUCCESS             The work item was posted.
+  @retval EFI_INVALID_PARAMETER   Procedure is NULL, or Mailbox does not exist.
+  @retval EFI_NOT_READY           The mailbox is full.
+
+**/
+EFI_STATUS
+EFIAPI
+ApMailboxPost (
+  IN  AP_MAILBOX_POOL             *Pool,
+  IN  UINTN                       Mailbox,
+  IN  FRAMEWORK_EFI_AP_PROCEDURE  Procedure,
+  IN  VOID                        *Argument  OPTIONAL,
+  OUT UINT32                      *Ticket    OPTIONAL
+  );
+
+/**
+  Checks whether a work item has completed.
+
+  @param  Pool      The mailbox pool.
+  @param  Mailbox   The mailbox of the work item.
+  @param  Ticket    The ticket of the work item.
+
+  @retval TRUE    The work item has completed.
+  @retval FALSE   The work item has not completed.
+
+**/
+BOOLEAN
+EFIAPI
+ApMailboxIsDone (
+  IN AP_MAILBOX_POOL  *Pool,
+  IN UINTN            Mailbox,
+  IN UINT32           Ticket
+  );
+
+/**
+  Waits for a work item to complete.
+
+  @param  Pool      The mailbox pool.
+  @param  Mailbox   The mailbox of the work item.
+  @param  Ticket    The ticket of the work item.
+
+**/
+VOID
+EFIAPI
+ApMailboxWait (
+  IN AP_MAILBOX_POOL  *Pool,
+  IN UINTN            Mailbox,
+  IN UINT32           Ticket
+  );
+
+/**
+  Waits for all the work items posted to all the mailboxes to complete.
+
+  @param  Pool    The mailbox pool.
+
+**/
+VOID
+EFIAPI
+ApMailboxWaitAll (
+  IN AP_MAILBOX_POOL  *Pool
+  );
+
+/**
+  Returns the counters of a mailbox pool.
+
+  @param  Pool          The mailbox pool.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   Pool or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+ApMailboxGetStatistics (
+  IN  AP_MAILBOX_POOL        *Pool,
+  OUT AP_MAILBOX_STATISTICS  *Statistics
+  );
+
+#endif
@@ -0,0 +1,246 @@
+/** @file
+  Task-parallel library for the application processors.
+
+  Runs fork/join tasks and parallel loops on the BSP and on the application
+  processors started through the Framework MP Services Protocol. Every processor
+  owns a deque of tasks: it pushes and pops the tasks it spawns at the bottom,
+  and takes tasks from the top of the deque of another processor when its own is
+  empty. The BSP runs the root task and takes part in the work instead of waiting
+  for the application processors.
+
+  Tasks run on application processors, so they must not call boot services or use
+  global state without locking. A task that spawns tasks must wait for them with
+  ApTaskSync() before it returns.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _AP_TASK_LIB_H_
+#define _AP_TASK_LIB_H_
+
+#include <Protocol/FrameworkMpService.h>
+
+///
+/// Default number of tasks that the deque of a processor holds.
+///
+#define AP_TASK_DEFAULT_DEQUE_SIZE  256
+
+typedef struct _AP_TASK_SCHEDULER  AP_TASK_SCHEDULER;
+typedef struct _AP_TASK_WORKER     AP_TASK_WORKER;
+
+///
+/// Tasks waited for together. A group must be zeroed before its first task is
+/// spawned.
+///
+typedef struct {
+  volatile UINT32  Pending;   ///< Tasks of the group that have not finished.
+} AP_TASK_GROUP;
+
+/**
+  A task.
+
+  @param  Worker    The processor that runs the task.
+  @param  Context   The context given when the task was spawned.
+
+**/
+typedef
+VOID
+(EFIAPI *AP_TASK_PROCEDURE)(
+  IN AP_TASK_WORKER  *Worker,
+  IN VOID            *Context
+  );
+
+/**
+  The body of a parallel loop, run on a part of the range of the loop.
+
+  @param  Worker    The processor that runs the part.
+  @param  Context   The context given to ApTaskParallelFor().
+  @param  Start     The first index of the part.
+  @param  End       The index that follows the part.
+
+**/
+typedef
+VOID
+(EFIAPI *AP_TASK_RANGE_PROCEDURE)(
+  IN AP_TASK_WORKER  *Worker,
+  IN VOID            *Context,
+  IN UINTN           Start,
+  IN UINTN           End
+  );
+
+///
+/// Counters of a scheduler, since it was created.
+///
+typedef struct {
+  UINTN   Processors;       ///< Processors that run tasks, including the BSP.
+  UINTN   Runs;             ///< ApTaskRun() calls.
+  UINTN   Dispatches;       ///< Runs that started the application processors.
+  UINT64  Tasks;            ///< Tasks run, on any processor.
+  UINT64  ApTasks;          ///< Tasks run on application processors.
+  UINT64  Steals;           ///< Tasks taken from the deque of another processor.
+  UINT64  InlineSpawns;     ///< Tasks run at once because the deque was full.
+} AP_TASK_STATISTICS;
+
+/**
+  Creates a scheduler.
+
+  The deques are allocated here, so that running tasks needs no memory allocation.
+
+  @param  MpServices    The MP Services Protocol used to start the application
+                        processors, or NULL to run the tasks on the calling
+                        processor only.
+  @param  DequeSize     The number of tasks that the deque of a processor holds,
+                        rounded up to a power of 2, or 0 for
+                        AP_TASK_DEFAULT_DEQUE_SIZE.
+  @param  Scheduler     Returns the scheduler.
+
+  @retval EFI_SUCCESS             The scheduler was created.
+  @retval EFI_INVALID_PARAMETER   Scheduler is NULL.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+ApTaskCreate (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices  OPTIONAL,
+  IN  UINTN                               DequeSize,
+  OUT AP_TASK_SCHEDULER                   **Scheduler
+  );
+
+/**
+  Frees a scheduler created by ApTaskCreate().
+
+  @param  Scheduler   The scheduler, which must not be running.
+
+**/
+VOID
+EFIAPI
+ApTaskDestroy (
+  IN AP_TASK_SCHEDULER  *Scheduler
+  );
+
+/**
+  Runs a root task on the BSP, and the tasks it spawns on all the processors.
+
+  The application processors are started with StartupAllAPs() and a timeout, so
+  that the BSP goes on with the root task while they work. If they cannot be
+  started, the BSP runs all the tasks. The function returns once the root task has
+  returned and the application processors have stopped. It must be called on the
+  BSP at a TPL that lets the MP Services Protocol signal its completion event.
+
+  @param  Scheduler   The scheduler.
+  @param  Procedure   The root task.
+  @param  Context     The context of the root task.
+
+  @retval EFI_SUCCESS             The tasks were run.
+  @retval EFI_INVALID_PARAMETER   Scheduler or Procedure is NULL.
+  @retval EFI_ALREADY_STARTED     The scheduler is already running.
+
+**/
+EFI_STATUS
+EFIAPI
+ApTaskRun (
+  IN AP_TASK_SCHEDULER  *Scheduler,
+  IN AP_TASK_PROCEDURE  Procedure,
+  IN VOID               *Context  OPTIONAL
+  );
+
+/**
+  Spawns a task in a group. The task is run at once if the deque of the processor
+  is full.
+
+  @param  Worker      The processor that runs the calling task.
+  @param  Group       The group of the task.
+  @param  Procedure   The task.
+  @param  Context     The context of the task.
+
+**/
+VOID
+EFIAPI
+ApTaskSpawn (
+  IN     AP_TASK_WORKER     *Worker,
+  IN OUT AP_TASK_GROUP      *Group,
+  IN     AP_TASK_PROCEDURE  Procedure,
+  IN     VOID               *Context  OPTIONAL
+  );
+
+/**
+  Waits for the tasks of a group to finish, running tasks meanwhile.
+
+  @param  Worker    The processor that runs the calling task.
+  @param  Group     The group.
+
+**/
+VOID
+EFIAPI
+ApTaskSync (
+  IN     AP_TASK_WORKER  *Worker,
+  IN OUT AP_TASK_GROUP   *Group
+  );
+
+/**
+  Runs a loop over a range of indexes in parallel, and waits for it to finish.
+
+  The range is split in halves until the parts hold at most Grain indexes. The
+  upper halves are spawned, so that other processors take the largest parts first.
+
+  @param  Worker      The processor that runs the calling task.
+  @param  Start       The first index of the range.
+  @param  End         The index that follows the range.
+  @param  Grain       The largest number of indexes that a part holds, or 0 for 1.
+  @param  Procedure   The body of the loop.
+  @param  Context     The context of the body.
+
+**/
+VOID
+EFIAPI
+ApTaskParallelFor (
+  IN AP_TASK_WORKER           *Worker,
+  IN UINTN                    Start,
+  IN UINTN                    End,
+  IN UINTN                    Grain,
+  IN AP_TASK_RANGE_PROCEDURE  Procedure,
+  IN VOID                     *Context  OPTIONAL
+  );
+
+/**
+  Returns the index of a processor among the processors of its scheduler, which
+  lets tasks keep results per processor without locking.
+
+  @param  Worker    The processor.
+
+  @return The index, which is 0 for the BSP and below the Processors counter.
+
+**/
+UINTN
+EFIAPI
+ApTaskGetWorkerIndex (
+  IN AP_TASK_WORKER  *Worker
+  );
+
+/**
+  Returns the counters of a scheduler.
+
+  @param  Scheduler     The scheduler.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   Scheduler or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+ApTaskGetStatistics (
+  IN  AP_TASK_SCHEDULER   *Scheduler,
+  OUT AP_TASK_STATISTICS  *Statistics
+  );
+
+#endif
@@ -0,0 +1,190 @@
+/** @file
+  Boot script compression library.
+
+  Encodes a closed Framework boot script table into a compact form for storage in
+  reserved memory, and decodes it again one record at a time so that an S3 resume
+  executor never needs the expanded table in memory.
+
+  Addresses are stored as the difference from the address that follows the previous
+  access to the same address space, integers are stored as variable length
+  quantities and repeated data units are run length encoded.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _BOOT_SCRIPT_COMPRESS_LIB_H_
+#define _BOOT_SCRIPT_COMPRESS_LIB_H_
+
+#include <Library/BootScriptInterpreterLib.h>
+
+#define BOOT_SCRIPT_ENCODED_SIGNATURE   SIGNATURE_32 ('B', 'S', 'C', 'Z')
+
+///
+/// The largest record of a boot script table. The record length is a UINT8.
+///
+#define BOOT_SCRIPT_MAX_RECORD_LENGTH   MAX_UINT8
+
+///
+/// Header of an encoded boot script table, followed by the encoded records.
+///
+typedef struct {
+  UINT32  Signature;        ///< BOOT_SCRIPT_ENCODED_SIGNATURE.
+  UINT32  EncodedLength;    ///< Size, in bytes, of the encoded table including this header.
+  UINT32  TableLength;      ///< Size, in bytes, of the decoded table.
+  UINT16  Version;          ///< Version of the decoded table header.
+  UINT16  Reserved;
+} BOOT_SCRIPT_ENCODED_HEADER;
+
+///
+/// Statistics returned by BootScriptEncode().
+///
+typedef struct {
+  UINTN   Records;          ///< Number of records in the table.
+  UINTN   TableLength;      ///< Size, in bytes, of the table.
+  UINTN   EncodedLength;    ///< Size, in bytes, of the encoded table.
+  UINTN   RepeatedUnits;    ///< Data units stored as part of a run instead of individually.
+} BOOT_SCRIPT_ENCODE_STATISTICS;
+
+///
+/// State of a streaming decoder. The contents are private to the library.
+///
+typedef struct {
+  CONST UINT8   *Encoded;
+  UINTN         EncodedLength;
+  UINTN         Position;
+  UINT32        Offset;
+  UINT32        TableLength;
+  UINT16        Version;
+  BOOLEAN       Done;
+  UINT64        NextAddress[BootScriptSpaceMaximum];
+} BOOT_SCRIPT_DECODER;
+
+/**
+  Encodes a Framework boot script table.
+
+  @param  Table         A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that starts the table.
+  @param  Encoded       The buffer that receives the encoded table. It may be NULL if
+                        EncodedSize is 0.
+  @param  EncodedSize   On input the size of Encoded, on output the size of the encoded table.
+  @param  Statistics    An optional pointer that receives the encoding statistics.
+
+  @retval RETURN_SUCCESS            The table was encoded.
+  @retval RETURN_INVALID_PARAMETER  Table or EncodedSize is NULL.
+  @retval RETURN_UNSUPPORTED        The table is malformed.
+  @retval RETURN_BUFFER_TOO_SMALL   Encoded is too small. EncodedSize returns the size needed.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptEncode (
+  IN     CONST VOID                     *Table,
+  OUT    VOID                           *Encoded      OPTIONAL,
+  IN OUT UINTN                          *EncodedSize,
+  OUT    BOOT_SCRIPT_ENCODE_STATISTICS  *Statistics   OPTIONAL
+  );
+
+/**
+  Starts decoding an encoded boot script table.
+
+  @param  Decoder       The decoder state to initialize.
+  @param  Encoded       A pointer to the BOOT_SCRIPT_ENCODED_HEADER that starts the encoded table.
+  @param  EncodedSize   The size of the buffer holding the encoded table.
+
+  @retval RETURN_SUCCESS            The decoder is ready.
+  @retval RETURN_INVALID_PARAMETER  Decoder or Encoded is NULL.
+  @retval RETURN_VOLUME_CORRUPTED   The header of the encoded table is not valid.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptDecoderInitialize (
+  OUT BOOT_SCRIPT_DECODER  *Decoder,
+  IN  CONST VOID           *Encoded,
+  IN  UINTN                EncodedSize
+  );
+
+/**
+  Decodes the next record of an encoded boot script table.
+
+  The first record returned is the table header and the last one is the terminate
+  record, which must end the encoded table.
+
+  @param  Decoder   The decoder state.
+  @param  Record    A buffer of BOOT_SCRIPT_MAX_RECORD_LENGTH bytes that receives the record.
+  @param  Offset    An optional pointer that receives the offset of the record in the
+                    decoded table.
+
+  @retval RETURN_SUCCESS            A record was decoded.
+  @retval RETURN_END_OF_MEDIA       The terminate record has already been returned.
+  @retval RETURN_VOLUME_CORRUPTED   The encoded table is not valid, or bytes follow
+                                    its terminate record.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptDecodeNext (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  OUT    VOID                 *Record,
+  OUT    UINT32               *Offset  OPTIONAL
+  );
+
+/**
+  Decodes a whole encoded boot script table.
+
+  @param  Encoded       A pointer to the BOOT_SCRIPT_ENCODED_HEADER that starts the encoded table.
+  @param  EncodedSize   The size of the buffer holding the encoded table.
+  @param  Table         The buffer that receives the table. It may be NULL if TableSize is 0.
+  @param  TableSize     On input the size of Table, on output the size of the table.
+
+  @retval RETURN_SUCCESS            The table was decoded.
+  @retval RETURN_INVALID_PARAMETER  Encoded or TableSize is NULL.
+  @retval RETURN_VOLUME_CORRUPTED   The encoded table is not valid.
+  @retval RETURN_BUFFER_TOO_SMALL   Table is too small. TableSize returns the size needed.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptDecode (
+  IN     CONST VOID  *Encoded,
+  IN     UINTN       EncodedSize,
+  OUT    VOID        *Table      OPTIONAL,
+  IN OUT UINTN       *TableSize
+  );
+
+/**
+  Executes an encoded boot script table, decoding one record at a time.
+
+  The whole table is decoded and checked once before the first record is executed,
+  so that a truncated or corrupted table does not program part of the hardware.
+
+  @param  Encoded       A pointer to the BOOT_SCRIPT_ENCODED_HEADER that starts the encoded table.
+  @param  EncodedSize   The size of the buffer holding the encoded table.
+  @param  Backend       The hardware access services.
+  @param  Profile       An optional pointer that receives the execution profile.
+
+  @retval RETURN_SUCCESS            The table was executed.
+  @retval RETURN_INVALID_PARAMETER  Encoded or Backend is NULL.
+  @retval RETURN_VOLUME_CORRUPTED   The encoded table is not valid. No record was
+                                    executed.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptExecuteEncoded (
+  IN  CONST VOID               *Encoded,
+  IN  UINTN                    EncodedSize,
+  IN  BOOT_SCRIPT_BACKEND      *Backend,
+  OUT BOOT_SCRIPT_PROFILE      *Profile  OPTIONAL
+  );
+
+#endif
@@ -0,0 +1,427 @@
+/** @file
+  Boot script interpreter library.
+
+  The interpreter executes a Framework boot script table against a set of hardware
+  access services supplied by the caller and profiles the execution. Backed by real
+  hardware it is an S3 resume executor; backed by modeled devices it runs anywhere and
+  reports where resume time is spent.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under 
+the terms and conditions of the BSD License that accompanies this distribution.  
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.                                          
+    
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,                     
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _BOOT_SCRIPT_INTERPRETER_LIB_H_
+#define _BOOT_SCRIPT_INTERPRETER_LIB_H_
+
+#include <Framework/BootScript.h>
+
+///
+/// Address spaces accessed through BOOT_SCRIPT_BACKEND_ACCESS.
+///
+typedef enum {
+  BootScriptSpaceIo,
+  BootScriptSpaceMemory,
+  BootScriptSpacePciConfig,
+  BootScriptSpaceMaximum
+} BOOT_SCRIPT_SPACE;
+
+///
+/// Classes of work that boot script execution time is attributed to.
+///
+typedef enum {
+  BootScriptCostIo,
+  BootScriptCostMemory,
+  BootScriptCostPciConfig,
+  BootScriptCostSmbus,
+  BootScriptCostStall,
+  BootScriptCostPoll,
+  BootScriptCostDispatch,
+  BootScriptCostMaximum
+} BOOT_SCRIPT_COST_CLASS;
+
+typedef struct _BOOT_SCRIPT_BACKEND BOOT_SCRIPT_BACKEND;
+
+/**
+  Reads or writes one unit of an address space.
+
+  @param  This      A pointer to the backend.
+  @param  Space     The address space to access.
+  @param  Write     TRUE to write Value, FALSE to read into Value.
+  @param  Width     The width of the access, EfiBootScriptWidthUint8 to EfiBootScriptWidthUint64.
+  @param  Segment   The PCI segment for BootScriptSpacePciConfig, 0 otherwise.
+  @param  Address   The address. PCI configuration addresses use the EFI_PCI_ADDRESS layout.
+  @param  Value     The value to write, or returns the value read.
+  @param  Cost      Returns the time, in nanoseconds, the access took.
+
+  @retval RETURN_SUCCESS  The access was performed.
+  @retval Others          The access failed and execution is aborted.
+
+**/
+typedef
+RETURN_STATUS
+(EFIAPI *BOOT_SCRIPT_BACKEND_ACCESS)(
+  IN     BOOT_SCRIPT_BACKEND    *This,
+  IN     BOOT_SCRIPT_SPACE      Space,
+  IN     BOOLEAN                Write,
+  IN     EFI_BOOT_SCRIPT_WIDTH  Width,
+  IN     UINT16                 Segment,
+  IN     UINT64                 Address,
+  IN OUT UINT64                 *Value,
+  OUT    UINT64                 *Cost
+  );
+
+/**
+  Executes an SMBus operation.
+
+  @param  This          A pointer to the backend.
+  @param  SlaveAddress  The SMBus slave address.
+  @param  Command       The SMBus command.
+  @param  Operation     The EFI_SMBUS_OPERATION to execute.
+  @param  PecCheck      TRUE if packet error code checking is required.
+  @param  Length        On input the size of Buffer, on output the number of bytes transferred.
+  @param  Buffer        The data of the operation.
+  @param  Cost          Returns the time, in nanoseconds, the operation took.
+
+  @retval RETURN_SUCCESS  The operation was performed.
+  @retval Others          The operation failed and execution is aborted.
+
+**/
+typedef
+RETURN_STATUS
+(EFIAPI *BOOT_SCRIPT_BACKEND_SMBUS)(
+  IN     BOOT_SCRIPT_BACKEND    *This,
+  IN     UINT64                 SlaveAddress,
+  IN     UINT64                 Command,
+  IN     UINT32                 Operation,
+  IN     BOOLEAN                PecCheck,
+  IN OUT UINTN                  *Length,
+  IN OUT VOID                   *Buffer,
+  OUT    UINT64                 *Cost
+  );
+
+/**
+  Waits for a number of microseconds.
+
+  @param  This          A pointer to the backend.
+  @param  Microseconds  The time to wait.
+  @param  Cost          Returns the time, in nanoseconds, that elapsed.
+
+**/
+typedef
+VOID
+(EFIAPI *BOOT_SCRIPT_BACKEND_STALL)(
+  IN     BOOT_SCRIPT_BACKEND    *This,
+  IN     UINT64                 Microseconds,
+  OUT    UINT64                 *Cost
+  );
+
+/**
+  Dispatches code referenced by a dispatch record.
+
+  @param  This        A pointer to the backend.
+  @param  EntryPoint  The entry point of the code.
+  @param  Context     The context of FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2_OPCODE records, 0 otherwise.
+  @param  Cost        Returns the time, in nanoseconds, the code took.
+
+  @retval RETURN_SUCCESS  The code was dispatched.
+  @retval Others          The code failed and execution is aborted.
+
+**/
+typedef
+RETURN_STATUS
+(EFIAPI *BOOT_SCRIPT_BACKEND_DISPATCH)(
+  IN     BOOT_SCRIPT_BACKEND    *This,
+  IN     UINT64                 EntryPoint,
+  IN     UINT64                 Context,
+  OUT    UINT64                 *Cost
+  );
+
+///
+/// Hardware access services used by the interpreter. A backend that drives real
+/// hardware measures the cost of each access; a modeled backend derives it from a
+/// latency model such as BootScriptGetAccessLatency().
+///
+struct _BOOT_SCRIPT_BACKEND {
+  BOOT_SCRIPT_BACKEND_ACCESS    Access;
+  BOOT_SCRIPT_BACKEND_SMBUS     Smbus;
+  BOOT_SCRIPT_BACKEND_STALL     Stall;
+  BOOT_SCRIPT_BACKEND_DISPATCH  Dispatch;
+};
+
+///
+/// The number of most expensive records kept in BOOT_SCRIPT_PROFILE.
+///
+#define BOOT_SCRIPT_PROFILE_HOT_RECORDS     8
+
+///
+/// Opcodes 0x00 through 0x10 are profiled individually.
+///
+#define BOOT_SCRIPT_PROFILE_OPCODE_COUNT    0x11
+
+///
+/// Execution count and total cost of one opcode.
+///
+typedef struct {
+  UINT64  Count;
+  UINT64  Cost;
+} BOOT_SCRIPT_OPCODE_PROFILE;
+
+///
+/// Cost of one record of the table.
+///
+typedef struct {
+  UINT32  Offset;     ///< Offset of the record from the start of the table.
+  UINT16  OpCode;
+  UINT64  Cost;
+} BOOT_SCRIPT_RECORD_COST;
+
+///
+/// Execution profile of a boot script table. All costs are in nanoseconds.
+///
+typedef struct {
+  ///
+  /// Time from the first to the last record.
+  ///
+  UINT64                      TotalCost;
+  ///
+  /// Sum of the costs of all records, the time a linear execution would take.
+  /// SerialCost / TotalCost is the speedup of a segmented execution.
+  ///
+  UINT64                      SerialCost;
+  ///
+  /// Number of segments executed, 0 for linear execution.
+  ///
+  UINT32                      SegmentCount;
+  ///
+  /// Per opcode execution counts and costs.
+  ///
+  BOOT_SCRIPT_OPCODE_PROFILE  OpCode[BOOT_SCRIPT_PROFILE_OPCODE_COUNT];
+  ///
+  /// Breakdown of the critical path by class of work. For linear execution the
+  /// critical path is the whole table, for segmented execution it is the most
+  /// expensive chain of dependent segments.
+  ///
+  UINT64                      CriticalPath[BootScriptCostMaximum];
+  ///
+  /// Number of poll reads that did not match, and the time spent waiting for them.
+  ///
+  UINT64                      PollRetries;
+  UINT64                      PollWait;
+  ///
+  /// The most expensive records, most expensive first. Unused entries have a Cost of 0.
+  ///
+  BOOT_SCRIPT_RECORD_COST     HotRecord[BOOT_SCRIPT_PROFILE_HOT_RECORDS];
+} BOOT_SCRIPT_PROFILE;
+
+///
+/// Signature of the information payload that starts a segment.
+///
+#define BOOT_SCRIPT_SEGMENT_SIGNATURE       SIGNATURE_32 ('B', 'S', 'S', 'G')
+
+///
+/// The maximum number of segments in a table.
+///
+#define BOOT_SCRIPT_MAX_SEGMENTS            32
+
+///
+/// Payload of the EFI_BOOT_SCRIPT_INFORMATION_OPCODE record that starts a segment.
+///
+/// A segmented table starts with a segment marker and every record up to the next
+/// marker or the terminate record belongs to that segment. Segments are numbered
+/// from 0 in table order. A segment may only depend on earlier segments, and it
+/// starts after all the segments in its DependencyMask have completed. Segments that
+/// do not depend on each other must not access the same registers; their records
+/// may be interleaved in any order.
+///
+typedef struct {
+  UINT32  Signature;        ///< BOOT_SCRIPT_SEGMENT_SIGNATURE.
+  UINT32  SegmentId;        ///< Index of the segment in the table.
+  UINT32  DependencyMask;   ///< Bit N set if the segment depends on segment N.
+} BOOT_SCRIPT_SEGMENT_INFORMATION;
+
+///
+/// Latency of the accesses to one device, used to model devices.
+///
+typedef struct {
+  BOOT_SCRIPT_SPACE  Space;
+  UINT64             Base;
+  UINT64             Length;
+  UINT64             ReadCost;
+  UINT64             WriteCost;
+} BOOT_SCRIPT_LATENCY_RANGE;
+
+/**
+  Returns the size, in bytes, of one unit of a boot script width.
+
+  @param  Width   The EFI_BOOT_SCRIPT_WIDTH value.
+
+  @return The size of one unit in bytes.
+
+**/
+UINTN
+EFIAPI
+BootScriptGetWidthSize (
+  IN UINT32  Width
+  );
+
+/**
+  Returns the size of the fixed part of a boot script record.
+
+  @param  OpCode  The boot script opcode.
+
+  @return The size of the fixed part of the record in bytes, or 0 if the opcode is
+          unknown.
+
+**/
+UINTN
+EFIAPI
+BootScriptGetFixedLength (
+  IN UINT16  OpCode
+  );
+
+/**
+  Validates one record of a boot script table.
+
+  The common header is checked to fit in Remaining bytes, then its Length to fit
+  in them and to cover the fixed part of the record, before any other field of the
+  record is read.
+
+  @param  Record      A pointer to the record.
+  @param  Remaining   The number of bytes from Record to the end of the table.
+
+  @retval RETURN_SUCCESS            The record is well formed and fits in the table.
+  @retval RETURN_INVALID_PARAMETER  Record is NULL.
+  @retval RETURN_UNSUPPORTED        The record is malformed or has an unknown opcode.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptValidateRecord (
+  IN CONST VOID  *Record,
+  IN UINTN       Remaining
+  );
+
+/**
+  Validates a Framework boot script table.
+
+  @param  Table   A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that starts the table.
+
+  @retval RETURN_SUCCESS            The table is well formed.
+  @retval RETURN_INVALID_PARAMETER  Table is NULL.
+  @retval RETURN_UNSUPPORTED        The table is malformed or contains an unknown opcode.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptValidateTable (
+  IN CONST VOID  *Table
+  );
+
+/**
+  Executes one boot script record.
+
+  This allows a caller that produces records one at a time, for example a decoder of
+  an encoded table, to execute them without an expanded copy of the table.
+
+  @param  Record    A pointer to the record. It must have been validated.
+  @param  Offset    The offset of the record in its table, recorded in the profile.
+  @param  Backend   The hardware access services.
+  @param  Profile   An optional profile that is updated with the cost of the record.
+
+  @retval RETURN_SUCCESS            The record was executed.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval RETURN_UNSUPPORTED        The opcode is not supported.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptExecuteRecord (
+  IN     CONST VOID               *Record,
+  IN     UINT32                   Offset,
+  IN     BOOT_SCRIPT_BACKEND      *Backend,
+  IN OUT BOOT_SCRIPT_PROFILE      *Profile  OPTIONAL
+  );
+
+/**
+  Validates and executes a Framework boot script table in order.
+
+  @param  Table     A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that starts the table.
+  @param  Backend   The hardware access services.
+  @param  Profile   An optional pointer that receives the execution profile.
+
+  @retval RETURN_SUCCESS            The table was executed.
+  @retval RETURN_INVALID_PARAMETER  Table or Backend is NULL.
+  @retval RETURN_UNSUPPORTED        The table is malformed or contains an unknown opcode.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptExecute (
+  IN  CONST VOID               *Table,
+  IN  BOOT_SCRIPT_BACKEND      *Backend,
+  OUT BOOT_SCRIPT_PROFILE      *Profile  OPTIONAL
+  );
+
+/**
+  Validates and executes a Framework boot script table, interleaving independent segments.
+
+  Records of a segment run in order. When a segment waits on a stall or a poll
+  record, the lowest numbered segment that is ready runs in the meantime, so the
+  order of execution is deterministic for a given set of costs. The backend is only
+  asked to stall when every ready segment is waiting. Tables without valid segment
+  markers are executed in order as by BootScriptExecute().
+
+  @param  Table     A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that starts the table.
+  @param  Backend   The hardware access services.
+  @param  Profile   An optional pointer that receives the execution profile.
+
+  @retval RETURN_SUCCESS            The table was executed.
+  @retval RETURN_INVALID_PARAMETER  Table or Backend is NULL.
+  @retval RETURN_UNSUPPORTED        The table is malformed or contains an unknown opcode.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptExecuteSegmented (
+  IN  CONST VOID               *Table,
+  IN  BOOT_SCRIPT_BACKEND      *Backend,
+  OUT BOOT_SCRIPT_PROFILE      *Profile  OPTIONAL
+  );
+
+/**
+  Looks up the modeled latency of an access.
+
+  @param  Ranges        An array of device latency ranges. The first match wins.
+  @param  RangeCount    The number of entries in Ranges.
+  @param  Space         The address space of the access.
+  @param  Address       The address of the access.
+  @param  Write         TRUE for a write, FALSE for a read.
+  @param  DefaultCost   The cost returned when no range matches.
+
+  @return The modeled cost of the access in nanoseconds.
+
+**/
+UINT64
+EFIAPI
+BootScriptGetAccessLatency (
+  IN CONST BOOT_SCRIPT_LATENCY_RANGE  *Ranges,
+  IN UINTN                            RangeCount,
+  IN BOOT_SCRIPT_SPACE                Space,
+  IN UINT64                           Address,
+  IN BOOLEAN                          Write,
+  IN UINT64                           DefaultCost
+  );
+
+#endif
@@ -0,0 +1,96 @@
+/** @file
+  Boot script optimization library.
+
+  The optimizer rewrites a closed Framework boot script table in place so that fewer
+  records are replayed on S3 resume. A producer of EFI_BOOT_SCRIPT_SAVE_PROTOCOL calls
+  it from CloseTable() before it returns the address of the table.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under 
+the terms and conditions of the BSD License that accompanies this distribution.  
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.                                          
+    
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,                     
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _BOOT_SCRIPT_OPTIMIZE_LIB_H_
+#define _BOOT_SCRIPT_OPTIMIZE_LIB_H_
+
+#include <Framework/BootScript.h>
+
+///
+/// A range of memory that the caller declares to be plain RAM.
+///
+typedef struct {
+  UINT64  Base;
+  UINT64  Length;
+} BOOT_SCRIPT_OPTIMIZE_RAM_RANGE;
+
+///
+/// Statistics returned by BootScriptOptimize().
+///
+typedef struct {
+  UINTN   RecordsBefore;          ///< Number of records in the table before optimization.
+  UINTN   RecordsAfter;           ///< Number of records in the table after optimization.
+  UINTN   LengthBefore;           ///< Size, in bytes, of the table before optimization.
+  UINTN   LengthAfter;            ///< Size, in bytes, of the table after optimization.
+  UINTN   CoalescedWrites;        ///< Write records merged into the preceding adjacent write.
+  UINTN   EliminatedWrites;       ///< Write records dropped because a later write supersedes them.
+  UINTN   FoldedReadWrites;       ///< Read-modify-write records folded into the preceding access.
+} BOOT_SCRIPT_OPTIMIZE_STATISTICS;
+
+/**
+  Optimizes a Framework boot script table in place.
+
+  The table is first validated as a whole and is left untouched if it is malformed.
+  The following transformations are then applied in a single forward pass. None of
+  them moves a record across a barrier, where a barrier is any record that reads
+  hardware, stalls, polls, dispatches code, executes an SMBus operation or carries
+  information, so information records can be used as markers that the optimizer
+  preserves.
+
+  1. A write is merged into the immediately preceding write when both have the same
+     opcode, the same non-FIFO, non-fill width and the second one starts right
+     after the last unit of the first one.
+  2. A write is dropped when the next write, to any address space, is a write
+     with the same opcode and width that covers every unit written by the first
+     one. A write to another address space in between, such as a PCI
+     configuration write that enables a decode, keeps the first write.
+  3. A memory read-modify-write of an address in one of RamRanges is folded into
+     the immediately preceding memory read-modify-write or single unit memory
+     write of the same address. Other read-modify-writes, such as those of I/O,
+     PCI configuration or memory mapped I/O registers, are never folded, because
+     their registers may have write-1-to-clear, read-only or self-clearing bits
+     and need not read back what was written.
+
+  The table only ever shrinks, so TableLength in the table header is updated and no
+  memory is allocated.
+
+  @param  Table         A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that
+                        starts the boot script table.
+  @param  RamRanges     An optional array of the memory ranges that the caller
+                        declares to be plain RAM, which reads back the last value
+                        written to it. Read-modify-writes are only folded within
+                        them.
+  @param  RamRangeCount The number of entries in RamRanges.
+  @param  Statistics    An optional pointer that receives the optimization statistics.
+
+  @retval RETURN_SUCCESS            The table was optimized.
+  @retval RETURN_INVALID_PARAMETER  Table is NULL, or RamRanges is NULL while
+                                    RamRangeCount is not 0.
+  @retval RETURN_UNSUPPORTED        The table is malformed or contains an unknown opcode.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptOptimize (
+  IN OUT VOID                                  *Table,
+  IN     CONST BOOT_SCRIPT_OPTIMIZE_RAM_RANGE  *RamRanges  OPTIONAL,
+  IN     UINTN                                 RamRangeCount,
+  OUT    BOOT_SCRIPT_OPTIMIZE_STATISTICS       *Statistics  OPTIONAL
+  );
+
+#endif
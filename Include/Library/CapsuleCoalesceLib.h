@@ -0,0 +1,157 @@
+/** @file
+  Capsule coalescing library.
+
+  Coalesces the data blocks of a FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR chain into
+  one contiguous image inside a memory range, typically after a warm reset when the
+  blocks are scattered over the memory preserved by the operating system. When the
+  range has a free gap large enough for the image, the blocks are copied into it.
+  Otherwise the image is built in place over the blocks themselves: every block is
+  copied once the blocks lying where it goes have left, and only the blocks that
+  wait for each other in cycles are first moved out to free memory. The capsule
+  headers can be checked and the image summed while it is coalesced.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _CAPSULE_COALESCE_LIB_H_
+#define _CAPSULE_COALESCE_LIB_H_
+
+#include <Guid/Capsule.h>
+
+///
+/// Maximum number of descriptors of a chain, which bounds the walk of a chain
+/// that loops.
+///
+#define CAPSULE_COALESCE_MAX_DESCRIPTORS  0x100000
+
+///
+/// Counters of a coalescing.
+///
+typedef struct {
+  UINTN     BlockCount;       ///< Data blocks of the chain.
+  UINTN     DescriptorCount;  ///< Descriptors of the chain, including the continuation
+                              ///< and terminator descriptors.
+  UINT64    DataSize;         ///< Size of the image.
+  BOOLEAN   InPlace;          ///< The image was built over the blocks.
+  UINTN     PlanSize;         ///< Size of the relocation plan.
+  UINTN     EvacuatedBytes;   ///< Bytes moved out of the way of the image.
+  UINTN     PeakExtraBytes;   ///< Largest amount of memory used besides the image and the
+                              ///< blocks: the plan, plus the evacuated blocks in place mode
+                              ///< or the whole image in copy mode.
+} CAPSULE_COALESCE_STATISTICS;
+
+/**
+  Validates a descriptor chain in one pass.
+
+  Every descriptor must be 8-byte aligned, carry the CBDS signature, and sum to 0
+  as an array of UINT32 values. A descriptor with a Length of 0 continues the chain
+  at Data, or ends it if Data is 0. The data blocks must not wrap around the
+  address space.
+
+  @param  BlockList         The first descriptor of the chain.
+  @param  BlockCount        Returns the number of data blocks. Optional.
+  @param  DescriptorCount   Returns the number of descriptors. Optional.
+  @param  DataSize          Returns the total size of the data blocks. Optional.
+
+  @retval EFI_SUCCESS             The chain is valid.
+  @retval EFI_INVALID_PARAMETER   BlockList is NULL.
+  @retval EFI_NOT_FOUND           The chain holds no data.
+  @retval EFI_VOLUME_CORRUPTED    A descriptor is not valid, or the chain is longer than
+                                  CAPSULE_COALESCE_MAX_DESCRIPTORS.
+
+**/
+EFI_STATUS
+EFIAPI
+CapsuleCoalesceValidate (
+  IN  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  OUT UINTN                                         *BlockCount       OPTIONAL,
+  OUT UINTN                                         *DescriptorCount  OPTIONAL,
+  OUT UINT64                                        *DataSize         OPTIONAL
+  );
+
+/**
+  Coalesces the data blocks of a descriptor chain into one image.
+
+  The image, an 8-byte aligned relocation plan and the evacuated blocks are placed
+  in the memory range, which may hold data blocks and descriptors of the chain but
+  nothing else the caller needs. The blocks outside the range are only read. The
+  plan is checked before any block is moved, so a failure leaves the data blocks
+  and the descriptors as they were. The descriptors are not valid after the image
+  is built.
+
+  @param  BlockList     The first descriptor of the chain.
+  @param  MemoryBase    The base of the memory range.
+  @param  MemorySize    The size of the memory range.
+  @param  Image         Returns the image.
+  @param  ImageSize     Returns the size of the image.
+  @param  Statistics    Returns the counters of the coalescing. Optional.
+
+  @retval EFI_SUCCESS             The image was built.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_FOUND           The chain holds no data.
+  @retval EFI_VOLUME_CORRUPTED    The chain is not valid, or data blocks overlap.
+  @retval EFI_BUFFER_TOO_SMALL    The memory range cannot hold the image and the plan.
+  @retval EFI_OUT_OF_RESOURCES    The memory range has too little free memory to move
+                                  the blocks out of the way of the image.
+
+**/
+EFI_STATUS
+EFIAPI
+CapsuleCoalesce (
+  IN  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  IN  VOID                                          *MemoryBase,
+  IN  UINTN                                         MemorySize,
+  OUT VOID                                          **Image,
+  OUT UINTN                                         *ImageSize,
+  OUT CAPSULE_COALESCE_STATISTICS                   *Statistics  OPTIONAL
+  );
+
+/**
+  Coalesces the data blocks of a descriptor chain into one capsule image, checking
+  the capsule while it is coalesced.
+
+  The FRAMEWORK_EFI_CAPSULE_HEADER and the EFI_CAPSULE_OEM_HEADER of the image are
+  checked on the data blocks before any of them is moved, so a capsule with a bad
+  header is rejected without touching memory. The checksum of the image is summed
+  by the copies that build the image, so the image is not read again.
+
+  @param  BlockList     The first descriptor of the chain.
+  @param  MemoryBase    The base of the memory range.
+  @param  MemorySize    The size of the memory range.
+  @param  Image         Returns the image.
+  @param  ImageSize     Returns the size of the image.
+  @param  Checksum      Returns the sum of the image as an array of UINT32 values,
+                        the last one padded with zeros.
+  @param  Statistics    Returns the counters of the coalescing. Optional.
+
+  @retval EFI_SUCCESS             The image was built.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_FOUND           The chain holds no data.
+  @retval EFI_VOLUME_CORRUPTED    The chain is not valid, data blocks overlap, or a
+                                  capsule header is not valid.
+  @retval EFI_BUFFER_TOO_SMALL    The memory range cannot hold the image and the plan.
+  @retval EFI_OUT_OF_RESOURCES    The memory range has too little free memory to move
+                                  the blocks out of the way of the image.
+
+**/
+EFI_STATUS
+EFIAPI
+CapsuleCoalesceVerify (
+  IN  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  IN  VOID                                          *MemoryBase,
+  IN  UINTN                                         MemorySize,
+  OUT VOID                                          **Image,
+  OUT UINTN                                         *ImageSize,
+  OUT UINT32                                        *Checksum,
+  OUT CAPSULE_COALESCE_STATISTICS                   *Statistics  OPTIONAL
+  );
+
+#endif
@@ -0,0 +1,203 @@
+/** @file
+  Framework firmware volume library.
+
+  Produces EFI_FIRMWARE_VOLUME_PROTOCOL instances for firmware volumes that are
+  resident in memory, such as memory mapped flash or a volume decompressed into RAM.
+
+  The first access to a volume walks its FFS file headers once and builds an index
+  of the files hashed by name, so ReadFile() and ReadSection() find a file without
+  walking the volume again.
+
+  Each instance also produces the Firmware Volume Zero Copy Protocol, which returns
+  pointers into the volume instead of copying file and section data. A write moves
+  and erases files in place, so the volumes whose writes are enabled are not mapped.
+
+  Once FrameworkFvEnableWrite() gives a volume in flash its firmware volume block
+  protocol, WriteFile() plans a multi-file write as a whole: the new files are
+  programmed together in the free space, or, when the free space is too small, the
+  live files are compacted and only the blocks whose contents change are erased and
+  programmed, with contiguous erases merged into one request.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _FRAMEWORK_FV_LIB_H_
+#define _FRAMEWORK_FV_LIB_H_
+
+#include <Protocol/FirmwareVolume.h>
+#include <Protocol/FirmwareVolumeZeroCopy.h>
+#include <Protocol/FrameworkFirmwareVolumeBlock.h>
+
+///
+/// Counters of the file lookups, data reads and flash writes of a firmware volume.
+///
+typedef struct {
+  UINTN   Files;            ///< Number of files in the index.
+  UINTN   HeadersVisited;   ///< FFS file headers read while building the index.
+  UINTN   Lookups;          ///< Lookups of a file by name.
+  UINTN   Probes;           ///< Index entries compared during the lookups.
+  UINT64  BytesCopied;      ///< Bytes copied to callers by ReadFile() and ReadSection().
+  UINT64  BytesMapped;      ///< Bytes returned in place by MapFile() and MapSection().
+  UINTN   EraseCalls;       ///< EraseBlocks() requests made by WriteFile().
+  UINTN   BlocksErased;     ///< Blocks erased by WriteFile(), including spare blocks.
+  UINTN   WriteCalls;       ///< Write() requests made by WriteFile().
+  UINT64  BytesWritten;     ///< Bytes programmed by WriteFile(), including spare blocks.
+  UINTN   Reclaims;         ///< Writes that compacted the volume.
+  UINTN   JournaledBlocks;  ///< Blocks saved to the spare blocks before being rewritten.
+} FRAMEWORK_FV_STATISTICS;
+
+/**
+  Creates a Firmware Volume Protocol instance for a firmware volume in memory.
+
+  The caller installs the returned protocol on a handle and sets its ParentHandle.
+  The firmware volume must stay in memory until FrameworkFvDestroy() is called.
+
+  @param  FvHeader        The header of the firmware volume.
+  @param  FirmwareVolume  Returns the protocol instance.
+
+  @retval EFI_SUCCESS             The protocol instance was created.
+  @retval EFI_INVALID_PARAMETER   FvHeader or FirmwareVolume is NULL.
+  @retval EFI_VOLUME_CORRUPTED    The firmware volume header is not valid.
+  @retval EFI_UNSUPPORTED         The firmware volume does not use a firmware file system
+                                  known to this library.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvCreate (
+  IN  CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  OUT EFI_FIRMWARE_VOLUME_PROTOCOL      **FirmwareVolume
+  );
+
+/**
+  Returns the Firmware Volume Zero Copy Protocol of a Firmware Volume Protocol
+  instance created by FrameworkFvCreate().
+
+  The caller installs it on the handle of the Firmware Volume Protocol.
+
+  @param  FirmwareVolume  The protocol instance.
+
+  @return The Firmware Volume Zero Copy Protocol instance.
+
+**/
+FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL *
+EFIAPI
+FrameworkFvGetZeroCopy (
+  IN EFI_FIRMWARE_VOLUME_PROTOCOL  *FirmwareVolume
+  );
+
+/**
+  Enables WriteFile() on a Firmware Volume Protocol instance created by FrameworkFvCreate().
+
+  Fvb must write the flash device whose memory mapping holds the firmware volume.
+  From then on, MapFile() and MapSection() of the Firmware Volume Zero Copy Protocol
+  return EFI_ACCESS_DENIED, and the pointers that they returned before must no
+  longer be used.
+  The reliable write policy is supported only if spare blocks are given. A reclaim
+  under this policy saves the new contents of the blocks it rewrites to the spare
+  blocks first, so that it can be completed by the next call to this function if it
+  is interrupted. The first spare block holds the journal and the others hold block
+  contents, so the spare blocks limit the number of blocks one reliable reclaim
+  may rewrite.
+
+  @param  FirmwareVolume  The protocol instance.
+  @param  Fvb             The firmware volume block protocol of the firmware volume.
+  @param  SpareFvb        The firmware volume block protocol of the spare blocks, or
+                          NULL to support only the unreliable write policy.
+  @param  SpareLba        The first spare block.
+  @param  SpareBlocks     The number of spare blocks. It must be at least 2, and each
+                          spare block must be as large as the largest block of the
+                          firmware volume.
+
+  @retval EFI_SUCCESS             Writes are enabled.
+  @retval EFI_INVALID_PARAMETER   FirmwareVolume was not created by this library, Fvb is
+                                  NULL or does not map the firmware volume, or the spare
+                                  blocks are not valid.
+  @retval EFI_VOLUME_CORRUPTED    The block map of the firmware volume is not valid, or
+                                  the journal of an interrupted reclaim is not valid.
+  @retval EFI_DEVICE_ERROR        An interrupted reclaim could not be completed.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvEnableWrite (
+  IN EFI_FIRMWARE_VOLUME_PROTOCOL                  *FirmwareVolume,
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *SpareFvb     OPTIONAL,
+  IN EFI_LBA                                       SpareLba,
+  IN UINTN                                         SpareBlocks
+  );
+
+/**
+  Completes a reclaim of a firmware volume that was interrupted after its journal
+  became valid.
+
+  FrameworkFvEnableWrite() calls this function. A platform calls it directly before
+  FrameworkFvCreate() if the interrupted reclaim erased the firmware volume header.
+
+  @param  Fvb         The firmware volume block protocol of the firmware volume.
+  @param  SpareFvb    The firmware volume block protocol of the spare blocks.
+  @param  SpareLba    The first spare block.
+
+  @retval EFI_SUCCESS             No reclaim was interrupted, or it was completed.
+  @retval EFI_INVALID_PARAMETER   Fvb or SpareFvb is NULL.
+  @retval EFI_VOLUME_CORRUPTED    The journal is not valid, or one of its entries is
+                                  not a block of the firmware volume. Nothing was
+                                  written.
+  @retval EFI_DEVICE_ERROR        The firmware volume or the spare blocks could not be
+                                  read or written.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvRecoverWrite (
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *SpareFvb,
+  IN EFI_LBA                                       SpareLba
+  );
+
+/**
+  Frees a Firmware Volume Protocol instance created by FrameworkFvCreate().
+
+  The caller must uninstall the protocols first.
+
+  @param  FirmwareVolume  The protocol instance.
+
+**/
+VOID
+EFIAPI
+FrameworkFvDestroy (
+  IN EFI_FIRMWARE_VOLUME_PROTOCOL  *FirmwareVolume
+  );
+
+/**
+  Returns the lookup, read and write counters of a Firmware Volume Protocol instance
+  created by FrameworkFvCreate().
+
+  @param  FirmwareVolume  The protocol instance.
+  @param  Statistics      Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   FirmwareVolume was not created by this library, or
+                                  Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvGetStatistics (
+  IN  EFI_FIRMWARE_VOLUME_PROTOCOL  *FirmwareVolume,
+  OUT FRAMEWORK_FV_STATISTICS       *Statistics
+  );
+
+#endif
@@ -0,0 +1,147 @@
+/** @file
+  Firmware volume file index library.
+
+  Indexes the files of a firmware volume in GUIDed HOBs by one pass over the file
+  headers, and finds files by name or by type through the index, so that PEI reads
+  the file headers of a volume executed in place from flash once instead of at
+  every lookup. FvFileIndexFindFv() indexes every volume that the Find FV PPI
+  reports as soon as it is found. The HOB layout is defined in
+  Guid/FvFileIndexHob.h.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _FV_FILE_INDEX_LIB_H_
+#define _FV_FILE_INDEX_LIB_H_
+
+#include <Ppi/FindFv.h>
+#include <Guid/FvFileIndexHob.h>
+
+///
+/// Counters of the index of a firmware volume.
+///
+typedef struct {
+  UINT32  Files;            ///< Files indexed.
+  UINT32  HeadersRead;      ///< File headers read to build the index.
+  UINT32  Lookups;          ///< Lookups served by the index.
+  UINT32  HeadersSaved;     ///< File headers that a walk of the volume would have read
+                            ///< for the lookups, counting the indexed files only.
+} FV_FILE_INDEX_STATISTICS;
+
+/**
+  Indexes the files of a firmware volume, unless the volume is already indexed.
+
+  @param  FvHeader    The firmware volume, which must be memory mapped.
+
+  @retval EFI_SUCCESS             The volume is indexed.
+  @retval EFI_INVALID_PARAMETER   FvHeader is NULL.
+  @retval EFI_UNSUPPORTED         The volume is not formatted with a firmware file
+                                  system this library supports.
+  @retval EFI_VOLUME_CORRUPTED    The volume header or a file header is not valid,
+                                  or an earlier attempt to index the volume failed.
+  @retval EFI_OUT_OF_RESOURCES    The HOBs could not be built.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexBuild (
+  IN CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader
+  );
+
+/**
+  Finds a firmware volume through the Find FV PPI, and indexes it.
+
+  The parameters and return values are those of EFI_PEI_FIND_FV_FINDFV. The
+  volume is returned even if it cannot be indexed; lookups then return
+  EFI_NOT_READY and the caller walks the volume.
+
+  @param  FindFv        The Find FV PPI.
+  @param  PeiServices   The PEI Services Table.
+  @param  FvNumber      The index of the firmware volume to locate.
+  @param  FvAddress     Returns the address of the volume.
+
+  @return The status returned by the Find FV PPI.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexFindFv (
+  IN     EFI_PEI_FIND_FV_PPI         *FindFv,
+  IN     EFI_PEI_SERVICES            **PeiServices,
+  IN     UINT8                       *FvNumber,
+  IN OUT EFI_FIRMWARE_VOLUME_HEADER  **FvAddress
+  );
+
+/**
+  Finds a file of an indexed firmware volume by name.
+
+  A valid file is returned rather than a file marked for update with the same name.
+
+  @param  FvHeader      The firmware volume.
+  @param  FileName      The name of the file.
+  @param  FileHeader    Returns the header of the file.
+
+  @retval EFI_SUCCESS             The file was found.
+  @retval EFI_NOT_FOUND           The volume has no such file.
+  @retval EFI_NOT_READY           The volume is not indexed.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexFindFileByName (
+  IN  CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN  CONST EFI_GUID                    *FileName,
+  OUT EFI_FFS_FILE_HEADER               **FileHeader
+  );
+
+/**
+  Finds the next file of a type in an indexed firmware volume.
+
+  @param  FvHeader      The firmware volume.
+  @param  SearchType    The type of the file, or EFI_FV_FILETYPE_ALL for any type.
+  @param  FileHeader    On input, the file to start after, or NULL to start at the
+                        beginning of the volume. Returns the header of the file.
+
+  @retval EFI_SUCCESS             The file was found.
+  @retval EFI_NOT_FOUND           There is no more file of the type, or the input
+                                  file is not in the index.
+  @retval EFI_NOT_READY           The volume is not indexed.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexFindNextFile (
+  IN     CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN     EFI_FV_FILETYPE                   SearchType,
+  IN OUT EFI_FFS_FILE_HEADER               **FileHeader
+  );
+
+/**
+  Returns the counters of the index of a firmware volume.
+
+  @param  FvHeader      The firmware volume.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_NOT_READY           The volume is not indexed.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexGetStatistics (
+  IN  CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  OUT FV_FILE_INDEX_STATISTICS          *Statistics
+  );
+
+#endif
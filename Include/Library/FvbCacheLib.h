@@ -0,0 +1,118 @@
+/** @file
+  Firmware volume block cache library.
+
+  Produces a Framework Firmware Volume Block Protocol instance that filters another
+  one and caches whole blocks, so that the many small reads of FFS file and section
+  headers are served from memory instead of from a slow flash device such as SPI
+  flash. The least recently used block is replaced when the cache is full, the
+  blocks that follow a block are read ahead when blocks are read in sequence, and
+  Write(), EraseBlocks() and SetAttributes() invalidate the blocks they affect.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _FVB_CACHE_LIB_H_
+#define _FVB_CACHE_LIB_H_
+
+#include <Protocol/FrameworkFirmwareVolumeBlock.h>
+
+///
+/// Counters of a firmware volume block cache.
+///
+typedef struct {
+  UINTN   Reads;            ///< Read() requests.
+  UINTN   Hits;             ///< Read() requests served from the cache.
+  UINTN   Misses;           ///< Read() requests that fetched their block.
+  UINTN   ReadAheads;       ///< Blocks fetched by read-ahead.
+  UINTN   ReadAheadHits;    ///< Blocks fetched by read-ahead that were read later.
+  UINTN   Evictions;        ///< Valid blocks replaced to make room.
+  UINTN   Invalidations;    ///< Blocks invalidated by writes, erases or attribute changes.
+  UINTN   DeviceReads;      ///< Read() requests passed to the filtered instance.
+  UINT64  DeviceBytes;      ///< Bytes read from the filtered instance.
+  UINT64  BytesRead;        ///< Bytes returned by Read().
+} FVB_CACHE_STATISTICS;
+
+/**
+  Creates a caching Firmware Volume Block Protocol instance over another instance.
+
+  The caller installs the returned protocol in place of the filtered one. All the
+  writes to the flash device must go through the returned protocol, or be followed
+  by FvbCacheInvalidate().
+
+  @param  Fvb               The instance to filter.
+  @param  CacheBlocks       The number of blocks the cache holds. It must not be 0.
+  @param  ReadAheadBlocks   The number of blocks read ahead when blocks are read in
+                            sequence, or 0 to disable read-ahead. It must be smaller
+                            than CacheBlocks.
+  @param  CachedFvb         Returns the caching instance.
+
+  @retval EFI_SUCCESS             The caching instance was created.
+  @retval EFI_INVALID_PARAMETER   Fvb or CachedFvb is NULL, CacheBlocks is 0, or
+                                  ReadAheadBlocks is not smaller than CacheBlocks.
+  @retval EFI_DEVICE_ERROR        The block map of Fvb could not be read.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheCreate (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN  UINTN                                         CacheBlocks,
+  IN  UINTN                                         ReadAheadBlocks,
+  OUT FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  **CachedFvb
+  );
+
+/**
+  Frees a caching Firmware Volume Block Protocol instance created by FvbCacheCreate().
+
+  The caller must uninstall the protocol first.
+
+  @param  CachedFvb   The caching instance.
+
+**/
+VOID
+EFIAPI
+FvbCacheDestroy (
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *CachedFvb
+  );
+
+/**
+  Invalidates all the blocks of a caching instance, after the flash device was
+  changed without going through it.
+
+  @param  CachedFvb   The caching instance.
+
+**/
+VOID
+EFIAPI
+FvbCacheInvalidate (
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *CachedFvb
+  );
+
+/**
+  Returns the counters of a caching instance created by FvbCacheCreate().
+
+  @param  CachedFvb     The caching instance.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   CachedFvb was not created by this library, or
+                                  Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheGetStatistics (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *CachedFvb,
+  OUT FVB_CACHE_STATISTICS                          *Statistics
+  );
+
+#endif
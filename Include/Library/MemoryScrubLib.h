@@ -0,0 +1,144 @@
+/** @file
+  Memory test and scrub library.
+
+  Fills, tests or reads ranges of memory on the BSP and on the application
+  processors started through the Framework MP Services Protocol. The ranges are
+  cut in chunks that the processors take from the ranges of their own package
+  first, so that a range with a package given by the platform is mostly handled by
+  the processors local to it. A progress code is reported when a range has been
+  handled, and an error code when it did not hold the values written to it.
+
+  The ranges must not be in use. The untested system memory of the GCD memory space
+  map is not, but the DXE core promotes it to system memory when an allocation
+  fails, so the ranges that are filled or tested are checked against the map again
+  right before they are written.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _MEMORY_SCRUB_LIB_H_
+#define _MEMORY_SCRUB_LIB_H_
+
+#include <Protocol/FrameworkMpService.h>
+
+///
+/// Package of a range that is not local to any package.
+///
+#define MEMORY_SCRUB_ANY_PACKAGE  MAX_UINT32
+
+typedef enum {
+  ///
+  /// Writes the pattern to every 64-bit word. Used to clear the memory and
+  /// initialize its ECC.
+  ///
+  MemoryScrubFill,
+  ///
+  /// Writes the pattern XOR the address of the word to every 64-bit word, writes
+  /// the words back from the caches, then reads them from memory and compares
+  /// them. Finds the stuck bits and the address lines that alias.
+  ///
+  MemoryScrubTest,
+  ///
+  /// Reads every 64-bit word, so that the memory controller corrects the ECC
+  /// errors it finds.
+  ///
+  MemoryScrubRead,
+  MemoryScrubOperationMaximum
+} MEMORY_SCRUB_OPERATION;
+
+typedef struct {
+  ///
+  /// Base address, a multiple of 8.
+  ///
+  EFI_PHYSICAL_ADDRESS  Base;
+  ///
+  /// Length in bytes, a multiple of 8.
+  ///
+  UINT64                Length;
+  ///
+  /// Physical package number of the processors local to the range, as in the
+  /// processor context of the MP Services Protocol, or MEMORY_SCRUB_ANY_PACKAGE.
+  ///
+  UINT32                Package;
+  ///
+  /// Returns the number of words that did not hold the value written to them.
+  ///
+  UINT32                ErrorCount;
+  ///
+  /// Returns the address of one of these words, if ErrorCount is not 0.
+  ///
+  EFI_PHYSICAL_ADDRESS  ErrorAddress;
+} MEMORY_SCRUB_RANGE;
+
+/**
+  Returns the untested system memory of the GCD memory space map.
+
+  This is the memory space of type EfiGcdMemoryTypeReserved that is present and
+  initialized, but not tested.
+
+  The ranges are cut to the memory that the processor can address, and their
+  Package is MEMORY_SCRUB_ANY_PACKAGE; the platform sets the package of the ranges
+  it knows to be local to one.
+
+  @param  Ranges        Returns the ranges, to be freed with FreePool().
+  @param  RangeCount    Returns the number of ranges.
+
+  @retval EFI_SUCCESS             The ranges were returned.
+  @retval EFI_INVALID_PARAMETER   Ranges or RangeCount is NULL.
+  @retval EFI_NOT_FOUND           There is no untested system memory.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+MemoryScrubGetUntestedRanges (
+  OUT MEMORY_SCRUB_RANGE  **Ranges,
+  OUT UINTN               *RangeCount
+  );
+
+/**
+  Fills, tests or reads ranges of memory on the BSP and on the enabled application
+  processors.
+
+  The function reports EFI_CU_MEMORY_PC_TEST with the range as extended data when a
+  range has been handled, and EFI_CU_MEMORY_EC_UNCORRECTABLE with one of the words
+  that did not match when a test found some.
+
+  @param  MpServices    The MP Services Protocol, or NULL to run on the BSP only.
+  @param  Operation     The operation.
+  @param  Pattern       The pattern of MemoryScrubFill and MemoryScrubTest.
+  @param  Ranges        The ranges. Their ErrorCount and ErrorAddress are set.
+  @param  RangeCount    The number of ranges.
+
+  @retval EFI_SUCCESS             The ranges were handled, and tested good.
+  @retval EFI_DEVICE_ERROR        The ranges were handled, and some words did not
+                                  hold the value written to them.
+  @retval EFI_INVALID_PARAMETER   Operation is not valid, Ranges is NULL while
+                                  RangeCount is not 0, or a range is not aligned on
+                                  8 bytes or is beyond the addressable memory.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+  @retval EFI_ACCESS_DENIED       Operation is MemoryScrubFill or MemoryScrubTest,
+                                  and some part of a range is no longer untested
+                                  system memory in the GCD memory space map. No
+                                  memory was written.
+
+**/
+EFI_STATUS
+EFIAPI
+MemoryScrubRun (
+  IN     FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices  OPTIONAL,
+  IN     MEMORY_SCRUB_OPERATION              Operation,
+  IN     UINT64                              Pattern,
+  IN OUT MEMORY_SCRUB_RANGE                  *Ranges,
+  IN     UINTN                               RangeCount
+  );
+
+#endif
@@ -0,0 +1,176 @@
+/** @file
+  Processor topology library.
+
+  Produces a Framework MP Services Protocol instance that filters another one and
+  keeps a snapshot of the processors: their APIC IDs, package, core and thread
+  numbers, health and state, in one contiguous cache-aligned table. The table is
+  read once when the instance is created and updated only by EnableDisableAP() and
+  SwitchBSP(), so GetGeneralMPInfo() and GetProcessorContext() are served from it,
+  and code that builds per-package or per-core maps reads the table directly
+  instead of calling the protocol once per processor. An APIC ID is mapped to its
+  processor number in constant time.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _MP_TOPOLOGY_LIB_H_
+#define _MP_TOPOLOGY_LIB_H_
+
+#include <Protocol/FrameworkMpService.h>
+
+///
+/// A processor of the snapshot. Two processors fit in a cache line.
+///
+typedef struct {
+  UINT32         ApicId;
+  UINT32         Package;         ///< Physical package number, from the processor context.
+  UINT32         Core;            ///< Core number within the package.
+  UINT32         Thread;          ///< Thread number within the core.
+  EFI_MP_HEALTH  Health;
+  UINT32         CoreIndex;       ///< Index of the core among the cores of the system.
+  UINT16         PackageIndex;    ///< Index of the package among the packages of the system.
+  BOOLEAN        Enabled;
+  BOOLEAN        Bsp;
+} MP_TOPOLOGY_PROCESSOR;
+
+///
+/// A snapshot of the processors. The package and core indexes are dense, so that
+/// per-package and per-core data can be kept in arrays of PackageCount and
+/// CoreCount entries.
+///
+typedef struct {
+  UINT32                 Generation;        ///< Changes whenever the snapshot is updated.
+  UINT32                 ProcessorCount;    ///< Processors, including the disabled ones.
+  UINT32                 EnabledCount;      ///< Enabled processors, including the BSP.
+  UINT32                 BspNumber;         ///< Processor number of the BSP.
+  UINT32                 PackageCount;
+  UINT32                 CoreCount;
+  UINT32                 ApicIdMask;        ///< Number of ApicIdTable entries minus 1.
+  UINT32                 ApicIdShift;       ///< 32 minus log2 of the number of ApicIdTable entries.
+  ///
+  /// The processors, indexed by processor number.
+  ///
+  MP_TOPOLOGY_PROCESSOR  *Processors;
+  ///
+  /// The processor numbers, sorted by package, core and thread number.
+  ///
+  UINT32                 *ByTopology;
+  ///
+  /// The first entry of every package in ByTopology, and ProcessorCount at the end.
+  /// The processors of the cores of a package follow each other.
+  ///
+  UINT32                 *PackageStart;
+  ///
+  /// Hash table of the processor numbers by APIC ID, used by
+  /// MpTopologyFindProcessor(). Empty entries are MAX_UINT32.
+  ///
+  UINT32                 *ApicIdTable;
+} MP_TOPOLOGY;
+
+/**
+  Creates a Framework MP Services Protocol instance that caches the topology of
+  another instance.
+
+  The caller installs the returned protocol in place of the filtered one. All the
+  calls to EnableDisableAP() and SwitchBSP() must go through the returned protocol,
+  or be followed by MpTopologyRefresh().
+
+  @param  MpServices        The instance to filter.
+  @param  CachedMpServices  Returns the caching instance.
+
+  @retval EFI_SUCCESS             The caching instance was created.
+  @retval EFI_INVALID_PARAMETER   MpServices or CachedMpServices is NULL.
+  @retval EFI_DEVICE_ERROR        The processors could not be read from MpServices.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyCreate (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices,
+  OUT FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  **CachedMpServices
+  );
+
+/**
+  Frees a caching MP Services Protocol instance created by MpTopologyCreate().
+
+  The caller must uninstall the protocol first.
+
+  @param  CachedMpServices  The caching instance.
+
+**/
+VOID
+EFIAPI
+MpTopologyDestroy (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *CachedMpServices
+  );
+
+/**
+  Returns the snapshot of a caching instance.
+
+  The snapshot stays at the same address until the instance is destroyed, unless a
+  refresh finds more processors than it has room for.
+
+  @param  CachedMpServices  The caching instance.
+  @param  Topology          Returns the snapshot.
+
+  @retval EFI_SUCCESS             The snapshot was returned.
+  @retval EFI_INVALID_PARAMETER   CachedMpServices was not created by this library,
+                                  or Topology is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyGet (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *CachedMpServices,
+  OUT CONST MP_TOPOLOGY                   **Topology
+  );
+
+/**
+  Reads all the processors again from the filtered instance, after processors were
+  enabled, disabled or switched without going through the caching instance.
+
+  @param  CachedMpServices  The caching instance.
+
+  @retval EFI_SUCCESS             The snapshot was refreshed.
+  @retval EFI_INVALID_PARAMETER   CachedMpServices was not created by this library.
+  @retval EFI_DEVICE_ERROR        The processors could not be read. The previous
+                                  snapshot is kept.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated. The previous
+                                  snapshot is kept.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyRefresh (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *CachedMpServices
+  );
+
+/**
+  Finds the processor that has an APIC ID.
+
+  @param  Topology          The snapshot.
+  @param  ApicId            The APIC ID.
+  @param  ProcessorNumber   Returns the processor number.
+
+  @retval EFI_SUCCESS     The processor was found.
+  @retval EFI_NOT_FOUND   No processor has the APIC ID.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyFindProcessor (
+  IN  CONST MP_TOPOLOGY  *Topology,
+  IN  UINT32             ApicId,
+  OUT UINTN              *ProcessorNumber
+  );
+
+#endif
@@ -0,0 +1,130 @@
+/** @file
+  Section extraction library.
+
+  Produces Section Extraction Protocol instances that decode a section stream
+  completely when it is opened. The encapsulation sections of a stream are decoded
+  one nesting level at a time, and the independent sections of a level are decoded
+  concurrently on the application processors through the Framework MP Services
+  Protocol. The decoded streams are kept until the stream is closed, so any number
+  of GetSection() requests are served without decoding again, and the sections are
+  numbered in the same depth first order whatever processor decoded them. The
+  nesting depth of the decoded sections and the total size of the decoded streams
+  of a stream are bounded; the encapsulation sections beyond these bounds are not
+  decoded, and a search that reaches them fails.
+
+  Sections compressed with EFI_STANDARD_COMPRESSION are decoded with
+  UefiDecompressLib, which is safe to run on application processors. GUID-defined
+  sections are decoded with ExtractGuidedSectionLib, on the application processors
+  only for the GUIDs the caller names as safe to decode there.
+
+  The decoded tree of a stream is shared by all the open streams with the same
+  contents, and is kept after they are closed within the cache size given at
+  creation, so that opening the same stream again decodes nothing. The trees are
+  found by the hash of the stream contents and freed least recently used first.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SECTION_EXTRACTION_LIB_H_
+#define _SECTION_EXTRACTION_LIB_H_
+
+#include <Protocol/SectionExtraction.h>
+#include <Protocol/FrameworkMpService.h>
+
+///
+/// Counters of a section extraction instance.
+///
+typedef struct {
+  UINTN   Streams;          ///< Section streams opened.
+  UINTN   Sections;         ///< Sections found in the opened streams, at any depth.
+  UINTN   Decodes;          ///< Encapsulation sections decoded.
+  UINTN   ApDecodes;        ///< Encapsulation sections decoded on application processors.
+  UINTN   Levels;           ///< Nesting levels decoded.
+  UINTN   Dispatches;       ///< Levels dispatched to the application processors.
+  UINTN   GetSections;      ///< GetSection() requests.
+  UINT64  BytesDecoded;     ///< Bytes produced by decoding.
+  UINTN   CacheHits;        ///< Streams opened with a decoded tree found in the cache.
+  UINTN   CacheMisses;      ///< Streams opened by decoding a new tree.
+  UINT64  BytesReused;      ///< Decoded bytes reused instead of decoded again.
+  UINTN   Evictions;        ///< Trees freed to keep the cache within its size.
+  UINT64  EvictedBytes;     ///< Memory of the trees freed.
+  UINTN   CachedBytes;      ///< Memory held by the decoded trees.
+} SECTION_EXTRACTION_STATISTICS;
+
+/**
+  Creates a Section Extraction Protocol instance.
+
+  The handlers that ExtractGuidedSectionLib registers for the GUIDs in ParallelGuids
+  must not call boot services or use global state without locking, because they
+  run on application processors.
+
+  @param  MpServices          The MP Services Protocol used to decode on the
+                              application processors, or NULL to decode on the
+                              calling processor only.
+  @param  ParallelGuidCount   The number of GUIDs in ParallelGuids.
+  @param  ParallelGuids       The GUID-defined sections that may be decoded on
+                              application processors. It may be NULL if
+                              ParallelGuidCount is 0.
+  @param  CacheSize           The memory that the decoded section streams may hold
+                              after they are closed, in bytes, or 0 to free them
+                              when they are closed.
+  @param  SectionExtraction   Returns the protocol instance.
+
+  @retval EFI_SUCCESS             The instance was created.
+  @retval EFI_INVALID_PARAMETER   SectionExtraction is NULL, or ParallelGuids is NULL
+                                  and ParallelGuidCount is not 0.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionCreate (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices         OPTIONAL,
+  IN  UINTN                               ParallelGuidCount,
+  IN  CONST EFI_GUID                      *ParallelGuids      OPTIONAL,
+  IN  UINTN                               CacheSize,
+  OUT EFI_SECTION_EXTRACTION_PROTOCOL     **SectionExtraction
+  );
+
+/**
+  Closes all the section streams of an instance created by SectionExtractionCreate(),
+  frees the cached trees and frees the instance.
+
+  The caller must uninstall the protocol first.
+
+  @param  SectionExtraction   The protocol instance.
+
+**/
+VOID
+EFIAPI
+SectionExtractionDestroy (
+  IN EFI_SECTION_EXTRACTION_PROTOCOL  *SectionExtraction
+  );
+
+/**
+  Returns the counters of an instance created by SectionExtractionCreate().
+
+  @param  SectionExtraction   The protocol instance.
+  @param  Statistics          Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   SectionExtraction was not created by this library,
+                                  or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionGetStatistics (
+  IN  EFI_SECTION_EXTRACTION_PROTOCOL  *SectionExtraction,
+  OUT SECTION_EXTRACTION_STATISTICS    *Statistics
+  );
+
+#endif
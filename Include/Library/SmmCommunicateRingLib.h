@@ -0,0 +1,335 @@
+/** @file
+  SMM communicate ring library.
+
+  Sends batches of requests to an SMM driver with one SMI, through the request
+  ring of Guid/SmmCommunicateRing.h.
+
+  Outside SMM, the ring is initialized in memory that SMM can read and write, the
+  requests are written in place into the slots with SmmCommRingReserve() and
+  SmmCommRingSubmit(), and SmmCommRingDoorbell() sends the doorbell message. The
+  ring has one producer at a time.
+
+  In SMM, the driver opens the ring with SmmCommRingOpen(), registers a handler
+  for each GUID of request, and calls SmmCommRingCommunicate() from the callback
+  that it registered with EFI_SMM_BASE_PROTOCOL.RegisterCallback(). The geometry of
+  the ring is checked and kept in SMRAM when the ring is opened, and every request
+  is checked against it before its handler is called.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_COMMUNICATE_RING_LIB_H_
+#define _SMM_COMMUNICATE_RING_LIB_H_
+
+#include <FrameworkSmm.h>
+
+#include <Guid/SmmCommunicateRing.h>
+#include <Protocol/SmmBase.h>
+
+///
+/// Number of handlers that an SMM channel can hold.
+///
+#define SMM_COMM_RING_MAX_HANDLERS  16
+
+typedef struct _SMM_COMM_RING_CHANNEL  SMM_COMM_RING_CHANNEL;
+
+/**
+  Handles a request of the ring, in SMM.
+
+  @param  Context     The context of the handler.
+  @param  Data        The data of the request, to be replaced by the data of the
+                      reply. It is in the slot of the ring, unless the handler was
+                      registered with CopyIn.
+  @param  Length      On input, the length of the request. On output, the length of
+                      the reply, up to MaxLength.
+  @param  MaxLength   The size of Data.
+
+  @return The status returned to the code outside SMM.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *SMM_COMM_RING_HANDLER)(
+  IN     VOID   *Context,
+  IN OUT VOID   *Data,
+  IN OUT UINTN  *Length,
+  IN     UINTN  MaxLength
+  );
+
+///
+/// Counters of an SMM channel, since it was opened.
+///
+typedef struct {
+  UINT64  Doorbells;          ///< Calls to SmmCommRingProcess().
+  UINT64  Requests;           ///< Requests handled.
+  UINT64  Rejected;           ///< Requests too long, or without handler.
+  UINT64  Corrupted;          ///< Doorbells that found indexes out of range.
+  UINT32  MaximumBatch;       ///< Most requests handled by one doorbell.
+} SMM_COMM_RING_STATISTICS;
+
+/**
+  Initializes a ring, outside SMM.
+
+  @param  Buffer        The memory of the ring, 8-byte aligned, outside SMRAM.
+  @param  BufferSize    The size of Buffer.
+  @param  MaxLength     The largest request or reply. The slots are sized for it, and
+                        there are as many as fit in Buffer, rounded down to a power
+                        of 2.
+
+  @retval EFI_SUCCESS             The ring was initialized.
+  @retval EFI_INVALID_PARAMETER   Buffer is NULL or not aligned, MaxLength is 0, or
+                                  Buffer cannot hold 2 slots.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingInitialize (
+  OUT VOID   *Buffer,
+  IN  UINTN  BufferSize,
+  IN  UINTN  MaxLength
+  );
+
+/**
+  Returns where to write the next request, outside SMM.
+
+  @param  Ring        The ring.
+  @param  Data        Returns the data of the next request.
+  @param  MaxLength   Returns the size of Data.
+
+  @retval EFI_SUCCESS             The slot is free.
+  @retval EFI_OUT_OF_RESOURCES    All the slots hold requests or replies that were
+                                  not released.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, or Ring is not initialized.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingReserve (
+  IN  SMM_COMMUNICATE_RING_HEADER  *Ring,
+  OUT VOID                         **Data,
+  OUT UINTN                        *MaxLength
+  );
+
+/**
+  Posts the request written at the place returned by SmmCommRingReserve(), outside
+  SMM.
+
+  @param  Ring          The ring.
+  @param  HeaderGuid    The handler of the request.
+  @param  Length        The length of the request.
+  @param  Ticket        Returns the ticket of the request.
+
+  @retval EFI_SUCCESS             The request was posted.
+  @retval EFI_OUT_OF_RESOURCES    No slot was free.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, Ring is not initialized, or
+                                  Length is larger than the slot.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingSubmit (
+  IN  SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN  CONST EFI_GUID               *HeaderGuid,
+  IN  UINTN                        Length,
+  OUT UINT32                       *Ticket
+  );
+
+/**
+  Has the SMM driver handle the posted requests, outside SMM.
+
+  @param  Ring          The ring.
+  @param  SmmBase       The SMM Base Protocol.
+  @param  ImageHandle   The handle of the SMM driver that opened the ring.
+
+  @retval EFI_SUCCESS             The doorbell was sent, or no request was waiting.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, or Ring is not initialized.
+  @return Others                  The status returned by Communicate().
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingDoorbell (
+  IN SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN EFI_SMM_BASE_PROTOCOL        *SmmBase,
+  IN EFI_HANDLE                   ImageHandle
+  );
+
+/**
+  Returns the reply to a request, outside SMM.
+
+  @param  Ring      The ring.
+  @param  Ticket    The ticket of the request.
+  @param  Data      Returns the data of the reply, in the slot.
+  @param  Length    Returns the length of the reply.
+  @param  Status    Returns the status returned by the handler.
+
+  @retval EFI_SUCCESS             The reply was returned.
+  @retval EFI_NOT_READY           The request was not handled yet.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, Ring is not initialized, or
+                                  Ticket is not a request that was not released.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingGetReply (
+  IN  SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN  UINT32                       Ticket,
+  OUT VOID                         **Data,
+  OUT UINTN                        *Length,
+  OUT EFI_STATUS                   *Status
+  );
+
+/**
+  Frees the slot of a request whose reply was read, outside SMM.
+
+  @param  Ring      The ring.
+  @param  Ticket    The ticket of the request.
+
+  @retval EFI_SUCCESS             The slot was freed.
+  @retval EFI_NOT_READY           The request was not handled yet.
+  @retval EFI_INVALID_PARAMETER   Ring is NULL or not initialized, or Ticket is not
+                                  a request that was not released.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingRelease (
+  IN SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN UINT32                       Ticket
+  );
+
+/**
+  Opens a ring initialized outside SMM, in SMM.
+
+  @param  Smst              The SMM System Table, whose SmmAllocatePool() allocates
+                            the channel.
+  @param  Ring              The address of the ring.
+  @param  RingSize          The size of the ring.
+  @param  SmramRanges       The SMRAM ranges, that the ring and the doorbell
+                            messages must not overlap. They are copied into the
+                            channel.
+  @param  SmramRangeCount   The number of SMRAM ranges.
+  @param  Channel           Returns the channel.
+
+  @retval EFI_SUCCESS             The channel was opened.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, the ring overlaps SMRAM or
+                                  the end of the address space, or its header is
+                                  not valid or describes more than RingSize bytes.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingOpen (
+  IN  EFI_SMM_SYSTEM_TABLE        *Smst,
+  IN  EFI_PHYSICAL_ADDRESS        Ring,
+  IN  UINTN                       RingSize,
+  IN  CONST EFI_SMRAM_DESCRIPTOR  *SmramRanges,
+  IN  UINTN                       SmramRangeCount,
+  OUT SMM_COMM_RING_CHANNEL       **Channel
+  );
+
+/**
+  Closes an SMM channel.
+
+  @param  Channel   The channel.
+
+**/
+VOID
+EFIAPI
+SmmCommRingClose (
+  IN SMM_COMM_RING_CHANNEL  *Channel
+  );
+
+/**
+  Registers the handler of the requests of a GUID, in SMM.
+
+  @param  Channel       The channel.
+  @param  HeaderGuid    The GUID of the requests.
+  @param  Handler       The handler.
+  @param  Context       The context of the handler.
+  @param  CopyIn        TRUE to copy the request into SMRAM before the handler is
+                        called and the reply back after, so that the handler
+                        does not read the shared memory; FALSE to have the handler
+                        work in place in the slot.
+
+  @retval EFI_SUCCESS             The handler was registered.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, or a handler is already
+                                  registered for HeaderGuid.
+  @retval EFI_OUT_OF_RESOURCES    SMM_COMM_RING_MAX_HANDLERS handlers are already
+                                  registered.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingRegisterHandler (
+  IN SMM_COMM_RING_CHANNEL  *Channel,
+  IN CONST EFI_GUID         *HeaderGuid,
+  IN SMM_COMM_RING_HANDLER  Handler,
+  IN VOID                   *Context,
+  IN BOOLEAN                CopyIn
+  );
+
+/**
+  Handles all the requests posted to the ring, in SMM.
+
+  @param  Channel   The channel.
+
+  @return The number of requests handled.
+
+**/
+UINTN
+EFIAPI
+SmmCommRingProcess (
+  IN SMM_COMM_RING_CHANNEL  *Channel
+  );
+
+/**
+  Answers a doorbell message sent through Communicate(), in SMM.
+
+  @param  Channel               The channel.
+  @param  CommunicationBuffer   The EFI_SMM_COMMUNICATE_HEADER of the message.
+  @param  SourceSize            On input, the size of CommunicationBuffer. On
+                                output, the size of the answer.
+
+  @retval EFI_SUCCESS             The posted requests were handled.
+  @retval EFI_UNSUPPORTED         The message is not a doorbell.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, CommunicationBuffer overlaps
+                                  SMRAM or the end of the address space, or the
+                                  message does not fit in CommunicationBuffer.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingCommunicate (
+  IN     SMM_COMM_RING_CHANNEL  *Channel,
+  IN OUT VOID                   *CommunicationBuffer,
+  IN OUT UINTN                  *SourceSize
+  );
+
+/**
+  Returns the counters of an SMM channel.
+
+  @param  Channel       The channel.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   Channel or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingGetStatistics (
+  IN  SMM_COMM_RING_CHANNEL     *Channel,
+  OUT SMM_COMM_RING_STATISTICS  *Statistics
+  );
+
+#endif
@@ -0,0 +1,219 @@
+/** @file
+  SMI latency profile library.
+
+  Records how long the SMIs, the child handlers of the Framework SMM dispatch
+  protocols and the Communicate() callbacks keep the processors in SMM, with the
+  time spent waiting for the other processors to enter SMM and the processor that
+  ran them. The records are kept in a ring in SMRAM, that is read from outside SMM
+  through EFI_SMM_BASE_PROTOCOL.Communicate() with the messages of
+  Guid/SmmLatencyProfile.h, and summarized as percentiles.
+
+  The SMM code that dispatches the SMIs calls SmmLatencyProfileBeginSmi() and
+  SmmLatencyProfileEndSmi() around each SMI, and SmmLatencyProfileRecord() after
+  each handler or callback. These functions are called by one processor at a time.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_LATENCY_PROFILE_LIB_H_
+#define _SMM_LATENCY_PROFILE_LIB_H_
+
+#include <FrameworkSmm.h>
+
+#include <Guid/SmmLatencyProfile.h>
+
+///
+/// Number of buckets of the histogram of a summary. Bucket N counts the times from
+/// 2^N to 2^(N+1) - 1 ticks; bucket 0 also counts the times of 0 ticks.
+///
+#define SMM_LATENCY_HISTOGRAM_SIZE  64
+
+typedef struct _SMM_LATENCY_PROFILE  SMM_LATENCY_PROFILE;
+
+///
+/// Times of a set of records, in ticks of the performance counter. The percentiles
+/// are rounded up to 1/8 of their power of 2, and never exceed the maximum.
+///
+typedef struct {
+  UINT64  Count;
+  UINT64  Minimum;
+  UINT64  Maximum;
+  UINT64  Total;
+  UINT64  Median;
+  UINT64  Percentile90;
+  UINT64  Percentile99;
+  UINT64  Percentile999;
+  UINT32  Histogram[SMM_LATENCY_HISTOGRAM_SIZE];
+} SMM_LATENCY_SUMMARY;
+
+/**
+  Creates an SMI latency profile.
+
+  @param  Smst          The SMM System Table, whose SmmAllocatePool() allocates the
+                        ring.
+  @param  RecordCount   The number of records of the ring, a power of 2. The oldest
+                        records are overwritten when the ring is full.
+  @param  Profile       Returns the profile.
+
+  @retval EFI_SUCCESS             The profile was created.
+  @retval EFI_INVALID_PARAMETER   Smst or Profile is NULL, or RecordCount is not a
+                                  power of 2.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmLatencyProfileCreate (
+  IN  EFI_SMM_SYSTEM_TABLE  *Smst,
+  IN  UINTN                 RecordCount,
+  OUT SMM_LATENCY_PROFILE   **Profile
+  );
+
+/**
+  Frees an SMI latency profile.
+
+  @param  Profile   The profile.
+
+**/
+VOID
+EFIAPI
+SmmLatencyProfileDestroy (
+  IN SMM_LATENCY_PROFILE  *Profile
+  );
+
+/**
+  Returns the performance counter, as a value that counts up.
+
+  The ticks passed to the other functions of the library are values returned by
+  this function.
+
+  @param  Profile   The profile.
+
+  @return The ticks.
+
+**/
+UINT64
+EFIAPI
+SmmLatencyProfileGetTicks (
+  IN SMM_LATENCY_PROFILE  *Profile
+  );
+
+/**
+  Starts the record of an SMI, once all the processors are in SMM.
+
+  @param  Profile         The profile.
+  @param  ArrivalTicks    The ticks when the processor entered SMM, or 0 if they
+                          are not known.
+
+**/
+VOID
+EFIAPI
+SmmLatencyProfileBeginSmi (
+  IN SMM_LATENCY_PROFILE  *Profile,
+  IN UINT64               ArrivalTicks
+  );
+
+/**
+  Records an SMI started by SmmLatencyProfileBeginSmi(), before the processors
+  leave SMM.
+
+  @param  Profile   The profile.
+
+**/
+VOID
+EFIAPI
+SmmLatencyProfileEndSmi (
+  IN SMM_LATENCY_PROFILE  *Profile
+  );
+
+/**
+  Records a handler or a callback that has just returned.
+
+  @param  Profile       The profile.
+  @param  Kind          SMM_LATENCY_KIND_HANDLER or SMM_LATENCY_KIND_COMMUNICATE.
+  @param  Handler       The address of the handler or of the callback.
+  @param  EntryTicks    The ticks when it was called.
+
+**/
+VOID
+EFIAPI
+SmmLatencyProfileRecord (
+  IN SMM_LATENCY_PROFILE  *Profile,
+  IN UINT8                Kind,
+  IN UINT64               Handler,
+  IN UINT64               EntryTicks
+  );
+
+/**
+  Answers a query of the profile sent through Communicate().
+
+  The driver that owns the profile calls this function from the callback that it
+  registered with EFI_SMM_BASE_PROTOCOL.RegisterCallback(). The message is read
+  once into SMRAM before it is checked, and the records returned never go beyond
+  MessageLength or SourceSize.
+
+  @param  Profile               The profile.
+  @param  CommunicationBuffer   The EFI_SMM_COMMUNICATE_HEADER of the message.
+  @param  SourceSize            On input, the size of CommunicationBuffer. On
+                                output, the size of the answer.
+  @param  SmramRanges           The SMRAM ranges, that CommunicationBuffer must not
+                                overlap.
+  @param  SmramRangeCount       The number of SMRAM ranges.
+
+  @retval EFI_SUCCESS             The records were returned.
+  @retval EFI_UNSUPPORTED         The message is not a query of the profile.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, CommunicationBuffer overlaps
+                                  SMRAM or the end of the address space, or the
+                                  message does not fit in CommunicationBuffer or is
+                                  too small for a query.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmLatencyProfileCommunicate (
+  IN     SMM_LATENCY_PROFILE         *Profile,
+  IN OUT VOID                        *CommunicationBuffer,
+  IN OUT UINTN                       *SourceSize,
+  IN     CONST EFI_SMRAM_DESCRIPTOR  *SmramRanges,
+  IN     UINTN                       SmramRangeCount
+  );
+
+/**
+  Summarizes the times of some records of a profile.
+
+  This function may be called outside SMM, on the records returned by a query.
+
+  @param  Records       The records.
+  @param  RecordCount   The number of records.
+  @param  Kind          The kind of the records to summarize.
+  @param  Handler       The handler of the records to summarize, or 0 for all.
+  @param  Rendezvous    TRUE to summarize the time spent waiting for the other
+                        processors instead of the time in SMM.
+  @param  Summary       Returns the summary.
+
+  @retval EFI_SUCCESS             The summary was returned.
+  @retval EFI_NOT_FOUND           No record matches.
+  @retval EFI_INVALID_PARAMETER   Records is NULL while RecordCount is not 0, or
+                                  Summary is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmLatencyProfileSummarize (
+  IN  CONST SMM_LATENCY_RECORD  *Records,
+  IN  UINTN                     RecordCount,
+  IN  UINT8                     Kind,
+  IN  UINT64                    Handler,
+  IN  BOOLEAN                   Rendezvous,
+  OUT SMM_LATENCY_SUMMARY       *Summary
+  );
+
+#endif
@@ -0,0 +1,195 @@
+/** @file
+  SMI source demultiplexer library.
+
+  Finds the pending sources of an SMI for the parent dispatch drivers of the
+  Framework SMM child dispatch protocols (Sx, software, GPI, USB, periodic timer,
+  power button, standby button and ICHn). The sources give the status register and
+  the status bits that show them pending. On every SMI, the demultiplexer reads
+  each status register once, reading adjacent registers of the same width with one
+  call to the SmmIo services of the SMST, then calls the handlers of the pending
+  sources only, in priority order.
+
+  The sources are added and removed in SMM, or before SMIs are enabled; they are
+  not protected against SMIs handled by other processors.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_SOURCE_DEMUX_LIB_H_
+#define _SMM_SOURCE_DEMUX_LIB_H_
+
+#include <FrameworkSmm.h>
+
+///
+/// Number of sources that a demultiplexer can hold.
+///
+#define SMM_DEMUX_MAX_SOURCES  64
+
+typedef struct _SMM_DEMUX  SMM_DEMUX;
+
+typedef enum {
+  SmmDemuxIo,
+  SmmDemuxMemory,
+  SmmDemuxSpaceMaximum
+} SMM_DEMUX_SPACE;
+
+/**
+  Handles a pending SMI source.
+
+  @param  Context   The context of the source.
+  @param  Status    The status bits of the source that are set.
+
+**/
+typedef
+VOID
+(EFIAPI *SMM_DEMUX_HANDLER)(
+  IN VOID    *Context,
+  IN UINT64  Status
+  );
+
+typedef struct {
+  SMM_DEMUX_SPACE    Space;               ///< Space of the status register.
+  EFI_SMM_IO_WIDTH   Width;               ///< Width of the status register.
+  UINT64             Address;             ///< Address of the status register.
+  UINT64             StatusMask;          ///< Status bits of the source.
+  ///
+  /// The sources are handled in increasing priority, then in the order they were
+  /// added.
+  ///
+  UINT32             Priority;
+  ///
+  /// The demultiplexer writes the status bits back once the handler has returned,
+  /// which clears them in write-1-to-clear registers.
+  ///
+  BOOLEAN            ClearStatus;
+  SMM_DEMUX_HANDLER  Handler;
+  VOID               *Context;
+} SMM_DEMUX_SOURCE;
+
+///
+/// Counters of a demultiplexer, since it was created.
+///
+typedef struct {
+  UINT64  Smis;               ///< Calls to SmmDemuxDispatch().
+  UINT64  Spurious;           ///< SMIs without pending source.
+  UINT64  Dispatched;         ///< Calls to the handlers.
+  UINT64  Reads;              ///< Calls to the read services of SmmIo.
+  UINTN   Sources;
+  UINTN   Registers;          ///< Distinct status registers.
+  UINTN   ReadsPerSmi;        ///< Calls to the read services of SmmIo per SMI.
+} SMM_DEMUX_STATISTICS;
+
+/**
+  Creates an SMI source demultiplexer.
+
+  @param  Smst    The SMM System Table, whose SmmIo reads the status registers and
+                  whose SmmAllocatePool() allocates the demultiplexer.
+  @param  Demux   Returns the demultiplexer.
+
+  @retval EFI_SUCCESS             The demultiplexer was created.
+  @retval EFI_INVALID_PARAMETER   Smst or Demux is NULL.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmDemuxCreate (
+  IN  EFI_SMM_SYSTEM_TABLE  *Smst,
+  OUT SMM_DEMUX             **Demux
+  );
+
+/**
+  Frees an SMI source demultiplexer.
+
+  @param  Demux   The demultiplexer.
+
+**/
+VOID
+EFIAPI
+SmmDemuxDestroy (
+  IN SMM_DEMUX  *Demux
+  );
+
+/**
+  Adds a source to a demultiplexer.
+
+  @param  Demux         The demultiplexer.
+  @param  Source        The source, which is copied.
+  @param  SourceHandle  Returns the handle of the source.
+
+  @retval EFI_SUCCESS             The source was added.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, the space or the width of
+                                  the status register is not valid, or StatusMask
+                                  is 0 or has bits beyond the width.
+  @retval EFI_OUT_OF_RESOURCES    The demultiplexer already holds
+                                  SMM_DEMUX_MAX_SOURCES sources.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmDemuxAddSource (
+  IN  SMM_DEMUX               *Demux,
+  IN  CONST SMM_DEMUX_SOURCE  *Source,
+  OUT UINTN                   *SourceHandle
+  );
+
+/**
+  Removes a source from a demultiplexer.
+
+  @param  Demux         The demultiplexer.
+  @param  SourceHandle  The handle of the source.
+
+  @retval EFI_SUCCESS             The source was removed.
+  @retval EFI_INVALID_PARAMETER   Demux is NULL, or SourceHandle is not a source of
+                                  the demultiplexer.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmDemuxRemoveSource (
+  IN SMM_DEMUX  *Demux,
+  IN UINTN      SourceHandle
+  );
+
+/**
+  Reads the status registers and calls the handlers of the pending sources.
+
+  The status bits are read once, before the first handler is called.
+
+  @param  Demux   The demultiplexer.
+
+  @return The number of handlers called. 0 means that no source was pending.
+
+**/
+UINTN
+EFIAPI
+SmmDemuxDispatch (
+  IN SMM_DEMUX  *Demux
+  );
+
+/**
+  Returns the counters of a demultiplexer.
+
+  @param  Demux         The demultiplexer.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   Demux or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmDemuxGetStatistics (
+  IN  SMM_DEMUX             *Demux,
+  OUT SMM_DEMUX_STATISTICS  *Statistics
+  );
+
+#endif
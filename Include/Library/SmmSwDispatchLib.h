@@ -0,0 +1,132 @@
+/** @file
+  Software SMI parent dispatch library.
+
+  Produces EFI_SMM_SW_DISPATCH_PROTOCOL instances that keep the child dispatch
+  functions in a table indexed by the software SMI input value, so that finding
+  the child of a software SMI does not depend on the number of registrations.
+  Registering and unregistering update the table with atomic operations, so they
+  need no lock against the SMIs handled by other processors. The time spent in
+  each child is counted per input value.
+
+  The platform enables the software SMI source and calls SmmSwDispatchDispatch()
+  with the value written to the software SMI port.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_SW_DISPATCH_LIB_H_
+#define _SMM_SW_DISPATCH_LIB_H_
+
+#include <FrameworkSmm.h>
+
+#include <Protocol/SmmSwDispatch.h>
+
+///
+/// Number of software SMI input values that an instance can dispatch.
+///
+#define SMM_SW_DISPATCH_VALUE_COUNT  256
+
+///
+/// Number of buckets of the time histogram. Bucket N counts the calls that took
+/// from 4^N to 4^(N+1) - 1 ticks of the performance counter; the last one also
+/// counts the longer calls.
+///
+#define SMM_SW_DISPATCH_HISTOGRAM_SIZE  16
+
+///
+/// Counters of a software SMI input value.
+///
+typedef struct {
+  UINT64  Count;                                          ///< Calls to the child.
+  UINT64  Ticks;                                          ///< Performance counter ticks spent in the child.
+  UINT64  MaximumTicks;                                   ///< Longest call.
+  UINT32  Histogram[SMM_SW_DISPATCH_HISTOGRAM_SIZE];
+} SMM_SW_DISPATCH_STATISTICS;
+
+/**
+  Creates a software SMI dispatch instance.
+
+  @param  Smst              The SMM System Table, whose SmmAllocatePool() allocates
+                            the instance.
+  @param  MaximumSwiValue   The largest input value that can be registered, below
+                            SMM_SW_DISPATCH_VALUE_COUNT.
+  @param  SwDispatch        Returns the instance.
+
+  @retval EFI_SUCCESS             The instance was created.
+  @retval EFI_INVALID_PARAMETER   Smst or SwDispatch is NULL, or MaximumSwiValue is
+                                  too large.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmSwDispatchCreate (
+  IN  EFI_SMM_SYSTEM_TABLE          *Smst,
+  IN  UINTN                         MaximumSwiValue,
+  OUT EFI_SMM_SW_DISPATCH_PROTOCOL  **SwDispatch
+  );
+
+/**
+  Frees a software SMI dispatch instance.
+
+  The caller must uninstall the protocol first.
+
+  @param  SwDispatch    The instance.
+
+**/
+VOID
+EFIAPI
+SmmSwDispatchDestroy (
+  IN EFI_SMM_SW_DISPATCH_PROTOCOL  *SwDispatch
+  );
+
+/**
+  Calls the child registered for a software SMI input value.
+
+  @param  SwDispatch        The instance.
+  @param  SwSmiInputValue   The value written to the software SMI port.
+
+  @retval EFI_SUCCESS             The child was called.
+  @retval EFI_NOT_FOUND           No child is registered for the value.
+  @retval EFI_INVALID_PARAMETER   SwDispatch was not created by this library.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmSwDispatchDispatch (
+  IN EFI_SMM_SW_DISPATCH_PROTOCOL  *SwDispatch,
+  IN UINTN                         SwSmiInputValue
+  );
+
+/**
+  Returns the counters of a software SMI input value.
+
+  The counters are kept when the child is unregistered.
+
+  @param  SwDispatch        The instance.
+  @param  SwSmiInputValue   The input value.
+  @param  Statistics        Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   SwDispatch was not created by this library,
+                                  SwSmiInputValue is above MaximumSwiValue, or
+                                  Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmSwDispatchGetStatistics (
+  IN  EFI_SMM_SW_DISPATCH_PROTOCOL  *SwDispatch,
+  IN  UINTN                         SwSmiInputValue,
+  OUT SMM_SW_DISPATCH_STATISTICS    *Statistics
+  );
+
+#endif
@@ -0,0 +1,327 @@
+/** @file
+  SMRAM arena library.
+
+  Hands out SMRAM from a heap built over a range of SMRAM, such as one of the
+  ranges that the EFI_SMRAM_HOB_DESCRIPTOR_BLOCK of Guid/SmramMemoryReserve.h
+  reserves. The pages of the heap are handed out best fit, so that the free pages
+  stay in as few runs as can be. The pools up to SMRAM_ARENA_MAX_SLAB_SIZE bytes
+  are carved out of one-page slabs of size classes, so that the small pools that
+  the SMM drivers allocate and free in their handlers do not break up the runs of
+  free pages.
+
+  Every allocation belongs to an arena. A driver gets its own arena, and all the
+  SMRAM of the arena is released at once when the arena is destroyed, for example
+  when the driver is unloaded. The slabs are shared by the arenas, and every object
+  of a slab records its arena, so that the arenas do not each hold part-empty
+  slabs.
+
+  SmramArenaHookSmst() puts the heap behind SmmAllocatePool(), SmmFreePool(),
+  SmmAllocatePages() and SmmFreePages() of the SMM System Table, so that the SMM
+  drivers use it without change. The allocations go to the arena made current with
+  SmramArenaSetCurrent(), and fall back to the allocator of the SMM core when the
+  heap is full.
+
+  The statistics of the heap and of the arenas are returned by
+  SmramArenaGetStatistics() and SmramArenaGetArenaStatistics(), and through
+  EFI_SMM_BASE_PROTOCOL.Communicate() by SmramArenaCommunicate().
+
+  The heap is used by one processor at a time.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMRAM_ARENA_LIB_H_
+#define _SMRAM_ARENA_LIB_H_
+
+#include <FrameworkSmm.h>
+
+#include <Guid/SmramArenaStatistics.h>
+
+///
+/// Number of arenas that a heap can hold.
+///
+#define SMRAM_ARENA_MAX_ARENAS     32
+
+///
+/// Largest pool carved out of a slab. The larger pools take whole pages.
+///
+#define SMRAM_ARENA_MAX_SLAB_SIZE  2016
+
+typedef struct _SMRAM_ARENA_HEAP  SMRAM_ARENA_HEAP;
+typedef struct _SMRAM_ARENA       SMRAM_ARENA;
+
+/**
+  Builds a heap over a range of SMRAM.
+
+  The heap keeps its own structures at the start of the range, and hands out the
+  rest of the range.
+
+  @param  Base    The start of the range.
+  @param  Size    The size of the range.
+  @param  Heap    Returns the heap.
+
+  @retval EFI_SUCCESS             The heap was built.
+  @retval EFI_INVALID_PARAMETER   Heap is NULL, or the range is too small to hand out
+                                  one page.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaCreateHeap (
+  IN  EFI_PHYSICAL_ADDRESS  Base,
+  IN  UINTN                 Size,
+  OUT SMRAM_ARENA_HEAP      **Heap
+  );
+
+/**
+  Creates an arena in a heap.
+
+  @param  Heap    The heap.
+  @param  Owner   The handle of the driver that owns the arena, or NULL.
+  @param  Arena   Returns the arena.
+
+  @retval EFI_SUCCESS             The arena was created.
+  @retval EFI_INVALID_PARAMETER   Heap or Arena is NULL.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM_ARENA_MAX_ARENAS arenas are already created.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaCreate (
+  IN  SMRAM_ARENA_HEAP  *Heap,
+  IN  EFI_HANDLE        Owner,
+  OUT SMRAM_ARENA       **Arena
+  );
+
+/**
+  Finds the arena of a driver.
+
+  @param  Heap    The heap.
+  @param  Owner   The handle of the driver.
+  @param  Arena   Returns the arena.
+
+  @retval EFI_SUCCESS             The arena was found.
+  @retval EFI_NOT_FOUND           The driver owns no arena.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaFind (
+  IN  SMRAM_ARENA_HEAP  *Heap,
+  IN  EFI_HANDLE        Owner,
+  OUT SMRAM_ARENA       **Arena
+  );
+
+/**
+  Destroys an arena, and releases at once all the SMRAM that it holds.
+
+  @param  Arena   The arena.
+
+  @retval EFI_SUCCESS             The arena was destroyed.
+  @retval EFI_INVALID_PARAMETER   Arena is NULL or was destroyed.
+  @retval EFI_ACCESS_DENIED       Arena is the default arena of the SMM System Table
+                                  that the heap is behind.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaDestroy (
+  IN SMRAM_ARENA  *Arena
+  );
+
+/**
+  Allocates a pool from an arena.
+
+  @param  Arena   The arena.
+  @param  Size    The size of the pool.
+  @param  Buffer  Returns the pool, 8-byte aligned.
+
+  @retval EFI_SUCCESS             The pool was allocated.
+  @retval EFI_INVALID_PARAMETER   Arena or Buffer is NULL.
+  @retval EFI_OUT_OF_RESOURCES    The heap has no free pages left for the pool.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaAllocatePool (
+  IN  SMRAM_ARENA  *Arena,
+  IN  UINTN        Size,
+  OUT VOID         **Buffer
+  );
+
+/**
+  Frees a pool, to the arena that it was allocated from.
+
+  @param  Heap    The heap.
+  @param  Buffer  The pool.
+
+  @retval EFI_SUCCESS             The pool was freed.
+  @retval EFI_INVALID_PARAMETER   Heap is NULL, or Buffer is not a pool of the heap.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaFreePool (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN VOID              *Buffer
+  );
+
+/**
+  Allocates pages from an arena.
+
+  @param  Arena           The arena.
+  @param  NumberOfPages   The number of pages.
+  @param  Memory          Returns the address of the first page.
+
+  @retval EFI_SUCCESS             The pages were allocated.
+  @retval EFI_INVALID_PARAMETER   Arena or Memory is NULL, or NumberOfPages is 0.
+  @retval EFI_OUT_OF_RESOURCES    The heap has no run of NumberOfPages free pages.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaAllocatePages (
+  IN  SMRAM_ARENA           *Arena,
+  IN  UINTN                 NumberOfPages,
+  OUT EFI_PHYSICAL_ADDRESS  *Memory
+  );
+
+/**
+  Frees pages, to the arena that they were allocated from.
+
+  @param  Heap            The heap.
+  @param  Memory          The address of the first page.
+  @param  NumberOfPages   The number of pages, as they were allocated.
+
+  @retval EFI_SUCCESS             The pages were freed.
+  @retval EFI_INVALID_PARAMETER   Heap is NULL.
+  @retval EFI_NOT_FOUND           The pages were not allocated with
+                                  SmramArenaAllocatePages().
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaFreePages (
+  IN SMRAM_ARENA_HEAP      *Heap,
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages
+  );
+
+/**
+  Puts a heap behind the memory services of the SMM System Table.
+
+  SmmAllocatePool() and SmmAllocatePages() with AllocateAnyPages allocate from the
+  current arena, and from the SMM core when the heap is full. SmmFreePool() and
+  SmmFreePages() free to the heap the memory of the heap, and to the SMM core the
+  rest. Only one heap can be put behind the SMM System Table.
+
+  @param  Heap            The heap.
+  @param  Smst            The SMM System Table.
+  @param  DefaultArena    The arena that is current when no other is.
+
+  @retval EFI_SUCCESS             The heap is behind the SMM System Table.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, or DefaultArena is not an
+                                  arena of Heap.
+  @retval EFI_ALREADY_STARTED     A heap is already behind the SMM System Table.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaHookSmst (
+  IN SMRAM_ARENA_HEAP      *Heap,
+  IN EFI_SMM_SYSTEM_TABLE  *Smst,
+  IN SMRAM_ARENA           *DefaultArena
+  );
+
+/**
+  Makes an arena current, for the allocations through the SMM System Table.
+
+  The loader of the SMM drivers makes the arena of a driver current before it
+  calls the entry point of the driver or one of its handlers, and puts back the
+  previous one after.
+
+  @param  Arena   The arena, or NULL for the default arena.
+
+  @return The arena that was current, or NULL when no heap is behind the SMM
+          System Table.
+
+**/
+SMRAM_ARENA *
+EFIAPI
+SmramArenaSetCurrent (
+  IN SMRAM_ARENA  *Arena
+  );
+
+/**
+  Returns the statistics of a heap.
+
+  @param  Heap          The heap.
+  @param  Statistics    Returns the statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Heap or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaGetStatistics (
+  IN  SMRAM_ARENA_HEAP             *Heap,
+  OUT SMRAM_ARENA_HEAP_STATISTICS  *Statistics
+  );
+
+/**
+  Returns the statistics of an arena.
+
+  @param  Arena         The arena.
+  @param  Statistics    Returns the statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Arena or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaGetArenaStatistics (
+  IN  SMRAM_ARENA             *Arena,
+  OUT SMRAM_ARENA_STATISTICS  *Statistics
+  );
+
+/**
+  Answers a query of the statistics sent through Communicate().
+
+  @param  Heap                  The heap.
+  @param  CommunicationBuffer   The EFI_SMM_COMMUNICATE_HEADER of the message.
+  @param  SourceSize            On input, the size of CommunicationBuffer. On
+                                output, the size of the answer.
+  @param  SmramRanges           The SMRAM ranges, that CommunicationBuffer must not
+                                overlap.
+  @param  SmramRangeCount       The number of SMRAM ranges.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_UNSUPPORTED         The message is not a query of the statistics.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, CommunicationBuffer overlaps
+                                  SMRAM or the end of the address space, or the
+                                  message does not fit in CommunicationBuffer or is
+                                  too small for a query.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaCommunicate (
+  IN     SMRAM_ARENA_HEAP            *Heap,
+  IN OUT VOID                        *CommunicationBuffer,
+  IN OUT UINTN                       *SourceSize,
+  IN     CONST EFI_SMRAM_DESCRIPTOR  *SmramRanges,
+  IN     UINTN                       SmramRangeCount
+  );
+
+#endif
@@ -0,0 +1,238 @@
+/** @file
+  Status code ring library.
+
+  Captures status codes with a performance counter timestamp into per-processor
+  rings in memory, so that reporting a status code costs a few stores instead of a
+  synchronous write to a slow device. The rings are drained later, merged into one
+  timeline, and the codes defined by the Framework Status Codes Specification can be
+  printed by name.
+
+  Each processor owns one ring. Recording into it is lock free and safe against
+  nested reports from interrupt handlers on the same processor. Draining may run
+  on any processor while the others keep recording.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _STATUS_CODE_RING_LIB_H_
+#define _STATUS_CODE_RING_LIB_H_
+
+#include <Pi/PiStatusCode.h>
+
+#define STATUS_CODE_RING_SIGNATURE  SIGNATURE_32 ('S', 'C', 'R', 'G')
+
+///
+/// Header of the status code ring memory. It is followed by CpuCount
+/// STATUS_CODE_CPU_RING structures and then by CpuCount * EntriesPerCpu
+/// STATUS_CODE_RING_ENTRY structures, so the memory can be decoded without the
+/// code that filled it.
+///
+typedef struct {
+  UINT32  Signature;        ///< STATUS_CODE_RING_SIGNATURE.
+  UINT32  CpuCount;
+  UINT32  EntriesPerCpu;    ///< A power of two.
+  UINT32  CountsDown;       ///< Nonzero if the performance counter counts down.
+  UINT64  Frequency;        ///< Frequency of the timestamps in Hz.
+  UINT64  CounterStart;     ///< First value of the performance counter.
+  ///
+  /// Number of values of the performance counter before it wraps around, or 0 if
+  /// it goes through all the 64-bit values.
+  ///
+  UINT64  CounterPeriod;
+  ///
+  /// Timestamp taken when the rings were initialized. A timestamp is the number of
+  /// ticks of the performance counter since CounterStart, counting the wraps around
+  /// seen since the rings were initialized, so it keeps increasing as long as a
+  /// timestamp is taken at least once per period of the counter.
+  ///
+  UINT64  StartTimestamp;
+  ///
+  /// Latest timestamp taken. It is shared by all the processors, and carries the
+  /// wraps around of the counter from one timestamp to the next.
+  ///
+  volatile UINT64  LastTimestamp;
+} STATUS_CODE_RING_HEADER;
+
+///
+/// Indexes of the ring of one processor. The indexes run freely and are reduced
+/// modulo EntriesPerCpu to address an entry.
+///
+typedef struct {
+  volatile UINT32  Reserve;   ///< Next entry to be claimed by a producer.
+  volatile UINT32  Tail;      ///< Next entry to be drained.
+  volatile UINT32  Dropped;   ///< Status codes dropped because the ring was full.
+  UINT32           Reserved;
+} STATUS_CODE_CPU_RING;
+
+///
+/// One captured status code.
+///
+typedef struct {
+  UINT64                  Timestamp;
+  EFI_STATUS_CODE_TYPE    CodeType;
+  EFI_STATUS_CODE_VALUE   Value;
+  UINT32                  Instance;
+  UINT32                  CpuIndex;
+  ///
+  /// Index of the entry plus one once the entry is complete. The drain uses it to
+  /// skip entries that a producer has claimed but not yet filled.
+  ///
+  volatile UINT32         Sequence;
+  UINT32                  Reserved;
+  EFI_GUID                CallerId;
+} STATUS_CODE_RING_ENTRY;
+
+/**
+  Called by StatusCodeRingDrain() for each entry.
+
+  @param  Context   The context passed to StatusCodeRingDrain().
+  @param  Ring      The ring memory.
+  @param  Entry     The entry. It is only valid during the call.
+
+**/
+typedef
+VOID
+(EFIAPI *STATUS_CODE_RING_DRAIN_CALLBACK)(
+  IN VOID                           *Context,
+  IN CONST STATUS_CODE_RING_HEADER  *Ring,
+  IN CONST STATUS_CODE_RING_ENTRY   *Entry
+  );
+
+/**
+  Returns the size of the memory needed for the rings.
+
+  @param  CpuCount        The number of processors.
+  @param  EntriesPerCpu   The number of entries of each ring. It must be a power of two.
+
+  @return The size in bytes, or 0 if a parameter is not valid.
+
+**/
+UINTN
+EFIAPI
+StatusCodeRingGetSize (
+  IN UINT32  CpuCount,
+  IN UINT32  EntriesPerCpu
+  );
+
+/**
+  Initializes the rings in caller supplied memory.
+
+  @param  Buffer          The memory for the rings, aligned on 8 bytes.
+  @param  BufferSize      The size of Buffer.
+  @param  CpuCount        The number of processors.
+  @param  EntriesPerCpu   The number of entries of each ring. It must be a power of two.
+
+  @return The ring header, or NULL if the parameters are not valid or Buffer is too small.
+
+**/
+STATUS_CODE_RING_HEADER *
+EFIAPI
+StatusCodeRingInitialize (
+  OUT VOID    *Buffer,
+  IN  UINTN   BufferSize,
+  IN  UINT32  CpuCount,
+  IN  UINT32  EntriesPerCpu
+  );
+
+/**
+  Captures a status code into the ring of a processor.
+
+  @param  Ring        The ring header.
+  @param  CpuIndex    The index of the calling processor.
+  @param  CodeType    The type of the status code.
+  @param  Value       The value of the status code.
+  @param  Instance    The instance of the status code.
+  @param  CallerId    An optional GUID identifying the caller.
+
+  @retval RETURN_SUCCESS            The status code was captured.
+  @retval RETURN_INVALID_PARAMETER  CpuIndex is not valid.
+  @retval RETURN_OUT_OF_RESOURCES   The ring is full and the status code was dropped.
+
+**/
+RETURN_STATUS
+EFIAPI
+StatusCodeRingRecord (
+  IN OUT STATUS_CODE_RING_HEADER  *Ring,
+  IN     UINT32                   CpuIndex,
+  IN     EFI_STATUS_CODE_TYPE     CodeType,
+  IN     EFI_STATUS_CODE_VALUE    Value,
+  IN     UINT32                   Instance,
+  IN     CONST EFI_GUID           *CallerId  OPTIONAL
+  );
+
+/**
+  Drains the completed entries of all rings, merged by timestamp.
+
+  The entries of one ring are drained in the order they were claimed, and the ring
+  whose next entry has the oldest timestamp is drained first. A producer takes its
+  timestamp after it claims its entry, so an entry may be drained before the entry
+  of a nested producer that interrupted it and has an older timestamp: the drain
+  is only in timestamp order across entries that did not nest.
+
+  Only one drain may run at a time. Entries recorded while the drain runs are
+  drained if they are complete when their ring is reached.
+
+  @param  Ring        The ring header.
+  @param  Callback    The function called for each entry.
+  @param  Context     The context passed to Callback.
+
+  @return The number of entries drained.
+
+**/
+UINTN
+EFIAPI
+StatusCodeRingDrain (
+  IN OUT STATUS_CODE_RING_HEADER          *Ring,
+  IN     STATUS_CODE_RING_DRAIN_CALLBACK  Callback,
+  IN     VOID                             *Context
+  );
+
+/**
+  Returns the name of a status code defined by the Framework Status Codes Specification.
+
+  @param  CodeType    The type of the status code.
+  @param  Value       The value of the status code.
+
+  @return The name of the status code, or NULL if it is not known.
+
+**/
+CONST CHAR8 *
+EFIAPI
+StatusCodeRingGetName (
+  IN EFI_STATUS_CODE_TYPE   CodeType,
+  IN EFI_STATUS_CODE_VALUE  Value
+  );
+
+/**
+  Formats an entry as one line of a boot timeline.
+
+  The line holds the time since the rings were initialized, the processor, the
+  type and the name of the status code, or its class, subclass and operation if
+  it has no name.
+
+  @param  Ring        The ring header.
+  @param  Entry       The entry.
+  @param  Buffer      The buffer that receives the Null-terminated line.
+  @param  BufferSize  The size of Buffer in bytes.
+
+  @return The number of characters written, not including the Null terminator.
+
+**/
+UINTN
+EFIAPI
+StatusCodeRingFormatEntry (
+  IN  CONST STATUS_CODE_RING_HEADER  *Ring,
+  IN  CONST STATUS_CODE_RING_ENTRY   *Entry,
+  OUT CHAR8                          *Buffer,
+  IN  UINTN                          BufferSize
+  );
+
+#endif
@@ -0,0 +1,166 @@
+/** @file
+  Read-only variable index library.
+
+  Reads the variables once through the Read-only Variable PPI, which typical
+  producers implement as a scan of the variable store in flash, and keeps them in
+  hash tables in GUIDed HOBs. VariableIndexInstall() then replaces the PPI with an
+  instance that answers from the index, so that the setup variables read by many
+  PEIMs are found without scanning the store again. The HOB layout is defined in
+  Guid/VariableIndexHob.h.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _VARIABLE_INDEX_LIB_H_
+#define _VARIABLE_INDEX_LIB_H_
+
+#include <Ppi/ReadOnlyVariable.h>
+#include <Guid/VariableIndexHob.h>
+
+///
+/// Counters of the variable index.
+///
+typedef struct {
+  UINT32  Variables;        ///< Variables indexed.
+  UINT32  StoreCalls;       ///< Calls to the Read-only Variable PPI to build the index.
+  UINT32  Hobs;             ///< HOBs that hold the index.
+  UINT32  Probes;           ///< Records compared to look up each indexed variable once.
+} VARIABLE_INDEX_STATISTICS;
+
+/**
+  Indexes the variables returned by a Read-only Variable PPI, unless they are
+  already indexed.
+
+  @param  PeiServices   The PEI Services Table.
+  @param  Variable      The Read-only Variable PPI to read the variables from.
+
+  @retval EFI_SUCCESS             The variables are indexed.
+  @retval EFI_INVALID_PARAMETER   Variable is NULL.
+  @retval EFI_UNSUPPORTED         A variable is too large to be kept in a HOB.
+  @retval EFI_OUT_OF_RESOURCES    The HOBs could not be built.
+  @retval EFI_VOLUME_CORRUPTED    An earlier attempt to index the variables failed.
+  @retval Others                  The status returned by the Read-only Variable PPI.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexBuild (
+  IN EFI_PEI_SERVICES                **PeiServices,
+  IN EFI_PEI_READ_ONLY_VARIABLE_PPI  *Variable
+  );
+
+/**
+  Indexes the variables of the installed Read-only Variable PPI, and reinstalls
+  the PPI with an instance that answers from the index.
+
+  The installed PPI is left in place if the variables cannot be indexed.
+
+  @param  PeiServices   The PEI Services Table.
+
+  @retval EFI_SUCCESS     The indexed PPI is installed.
+  @retval Others          The status returned by VariableIndexBuild() or by the PEI
+                          Services.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexInstall (
+  IN EFI_PEI_SERVICES  **PeiServices
+  );
+
+/**
+  Returns the value of an indexed variable.
+
+  The parameters and return values are those of EFI_PEI_GET_VARIABLE, with the
+  addition of EFI_NOT_READY when the variables are not indexed. PeiServices is not
+  used, so this function can also be called in DXE, on the snapshot of the
+  variables taken in PEI.
+
+  @param  PeiServices     The PEI Services Table.
+  @param  VariableName    The name of the variable.
+  @param  VendorGuid      The vendor GUID of the variable.
+  @param  Attributes      Returns the attributes of the variable. Optional.
+  @param  DataSize        On input, the size of Data. On output, the size of the
+                          variable.
+  @param  Data            Returns the value of the variable.
+
+  @retval EFI_SUCCESS             The variable was returned.
+  @retval EFI_NOT_FOUND           The variable was not found.
+  @retval EFI_BUFFER_TOO_SMALL    DataSize is too small for the variable.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_READY           The variables are not indexed.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexGetVariable (
+  IN     EFI_PEI_SERVICES  **PeiServices,
+  IN     CHAR16            *VariableName,
+  IN     EFI_GUID          *VendorGuid,
+  OUT    UINT32            *Attributes OPTIONAL,
+  IN OUT UINTN             *DataSize,
+  OUT    VOID              *Data
+  );
+
+/**
+  Returns the name of the indexed variable that follows a variable.
+
+  The parameters and return values are those of EFI_PEI_GET_NEXT_VARIABLE_NAME,
+  with the addition of EFI_NOT_READY when the variables are not indexed. The
+  variables are returned in the order of the Read-only Variable PPI the index was
+  built from. PeiServices is not used.
+
+  @param  PeiServices       The PEI Services Table.
+  @param  VariableNameSize  On input, the size of VariableName. On output, the size
+                            of the name of the next variable.
+  @param  VariableName      On input, the name of the previous variable, or an
+                            empty string to start with the first variable. On
+                            output, the name of the next variable.
+  @param  VendorGuid        On input, the vendor GUID of the previous variable. On
+                            output, the vendor GUID of the next variable.
+
+  @retval EFI_SUCCESS             The next variable was returned.
+  @retval EFI_NOT_FOUND           There is no next variable, or the previous
+                                  variable is not indexed.
+  @retval EFI_BUFFER_TOO_SMALL    VariableNameSize is too small for the name.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_READY           The variables are not indexed.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexGetNextVariableName (
+  IN     EFI_PEI_SERVICES  **PeiServices,
+  IN OUT UINTN             *VariableNameSize,
+  IN OUT CHAR16            *VariableName,
+  IN OUT EFI_GUID          *VendorGuid
+  );
+
+/**
+  Returns the counters of the variable index.
+
+  The counters are computed from the index HOBs, which lookups do not write, so
+  they describe the index rather than the lookups made so far.
+
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_NOT_READY           The variables are not indexed.
+  @retval EFI_INVALID_PARAMETER   Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexGetStatistics (
+  OUT VARIABLE_INDEX_STATISTICS  *Statistics
+  );
+
+#endif
@@ -0,0 +1,129 @@
+/** @file
+  This file declares the Firmware Volume Zero Copy Protocol.
+
+  The protocol is an extension of the Firmware Volume Protocol for firmware volumes
+  that are resident in memory, such as memory mapped flash or a volume decompressed
+  into RAM. It is installed on the same handle as the Firmware Volume Protocol and
+  returns read only pointers into the volume instead of copying file and section
+  data into a caller buffer.
+
+  Only data that is stored as is in the volume can be mapped. A section inside a
+  compressed or GUID-defined encapsulation section must be read with ReadSection()
+  of the Firmware Volume Protocol, which decodes and copies it.
+
+  A write to the volume moves, replaces or erases the files in place, and so
+  invalidates every pointer that was mapped before it. A producer whose volume
+  can be written through WriteFile() refuses to map, and the data of such a
+  volume must be read with ReadFile() or ReadSection().
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _FIRMWARE_VOLUME_ZERO_COPY_H_
+#define _FIRMWARE_VOLUME_ZERO_COPY_H_
+
+#include <Protocol/FirmwareVolume.h>
+
+///
+/// Global ID for the FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL.
+///
+#define FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL_GUID \
+  { \
+    0x4efc2859, 0x1365, 0x4950, {0x98, 0x61, 0x20, 0xe9, 0xaf, 0xb3, 0x69, 0x8f } \
+  }
+
+typedef struct _FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL  FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL;
+
+/**
+  Returns a read only pointer to the data of a file in the firmware volume.
+
+  @param  This                  Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL instance.
+  @param  NameGuid              The name of the file.
+  @param  Data                  Returns a pointer to the data of the file. The data stays
+                                valid as long as the Firmware Volume Protocol is installed
+                                and the volume is not written.
+  @param  DataSize              Returns the size of the data of the file.
+  @param  FoundType             Returns the type of the file.
+  @param  FileAttributes        Returns the attributes of the file.
+  @param  AuthenticationStatus  Returns the authentication status of the data.
+
+  @retval EFI_SUCCESS           The data of the file was mapped.
+  @retval EFI_NOT_FOUND         NameGuid was not found in the firmware volume.
+  @retval EFI_ACCESS_DENIED     The firmware volume can be written, so its data cannot
+                                be mapped.
+  @retval EFI_DEVICE_ERROR      The firmware volume is corrupted.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *FRAMEWORK_EFI_FV_MAP_FILE)(
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL  *This,
+  IN  EFI_GUID                                          *NameGuid,
+  OUT CONST VOID                                        **Data,
+  OUT UINTN                                             *DataSize,
+  OUT EFI_FV_FILETYPE                                   *FoundType,
+  OUT EFI_FV_FILE_ATTRIBUTES                            *FileAttributes,
+  OUT UINT32                                            *AuthenticationStatus
+  );
+
+/**
+  Returns a read only pointer to the contents of a section of a file in the firmware
+  volume. The instances of SectionType are numbered as ReadSection() numbers them.
+
+  @param  This                  Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL instance.
+  @param  NameGuid              The name of the file.
+  @param  SectionType           The section type to retrieve.
+  @param  SectionInstance       The instance of SectionType to retrieve.
+  @param  Data                  Returns a pointer to the contents of the section, after
+                                the section header. The data stays valid as long as the
+                                Firmware Volume Protocol is installed and the volume is
+                                not written.
+  @param  DataSize              Returns the size of the contents of the section.
+  @param  AuthenticationStatus  Returns the authentication status of the data.
+
+  @retval EFI_SUCCESS           The section was mapped.
+  @retval EFI_NOT_FOUND         The file or the section was not found.
+  @retval EFI_UNSUPPORTED       The section may be inside an encapsulation section and can
+                                only be read with ReadSection().
+  @retval EFI_ACCESS_DENIED     The firmware volume can be written, so its data cannot
+                                be mapped.
+  @retval EFI_DEVICE_ERROR      The firmware volume is corrupted.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *FRAMEWORK_EFI_FV_MAP_SECTION)(
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL  *This,
+  IN  EFI_GUID                                          *NameGuid,
+  IN  EFI_SECTION_TYPE                                  SectionType,
+  IN  UINTN                                             SectionInstance,
+  OUT CONST VOID                                        **Data,
+  OUT UINTN                                             *DataSize,
+  OUT UINT32                                            *AuthenticationStatus
+  );
+
+//
+// Protocol interface structure
+//
+struct _FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL {
+  ///
+  /// Maps the data of a whole file.
+  ///
+  FRAMEWORK_EFI_FV_MAP_FILE     MapFile;
+  ///
+  /// Maps the contents of a single section of a file.
+  ///
+  FRAMEWORK_EFI_FV_MAP_SECTION  MapSection;
+};
+
+extern EFI_GUID gFrameworkEfiFirmwareVolumeZeroCopyProtocolGuid;
+
+#endif
@@ -0,0 +1,133 @@
+/** @file
+  This file declares the SMM Driver Load Queue Protocol.
+
+  The protocol is shared by the SMM drivers built with the
+  DxeSmmDriverEntryPointBatched library. Instead of one call to
+  EFI_SMM_BASE_PROTOCOL.Register(), and so one SMI, for each SMM driver that the
+  DXE dispatcher starts, the drivers are queued and loaded into SMRAM by one
+  Communicate() to the SMM driver that loads the queue, which calls Register()
+  for each of them from SMM.
+
+  The first SMM driver that finds no queue installs it and is loaded into SMRAM
+  the usual way. Its copy in SMRAM becomes the loader of the queue. The queue
+  also caches the EFI_SMM_BASE_PROTOCOL and the device path of the firmware volume
+  that the drivers are loaded from.
+
+  The loader copies each batch into SMRAM and checks it before it loads any
+  driver, and refuses any batch after the one that closes the queue.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_DRIVER_LOAD_QUEUE_H_
+#define _SMM_DRIVER_LOAD_QUEUE_H_
+
+#include <Protocol/SmmBase.h>
+#include <Protocol/DevicePath.h>
+
+///
+/// Global ID for the FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL. It is also the
+/// HeaderGuid of the EFI_SMM_COMMUNICATE_HEADER that loads the queue.
+///
+#define FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL_GUID \
+  { \
+    0x5b0b3b5a, 0x8bcc, 0x4794, { 0x91, 0x62, 0x1f, 0xa9, 0xea, 0x02, 0xb6, 0xa1 } \
+  }
+
+///
+/// Number of SMM drivers that the queue holds. The queue is loaded when it is full.
+///
+#define FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_SIZE  64
+
+///
+/// The largest device path of an SMM driver in the queue, in bytes.
+///
+#define FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_FILE_PATH_SIZE  0x400
+
+///
+/// The values of the one byte of Data of the EFI_SMM_COMMUNICATE_HEADER that
+/// loads the queue.
+///
+#define FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_LOAD   0x00  ///< Loads the queue.
+#define FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_CLOSE  0x01  ///< Loads the queue, then closes it.
+
+typedef struct _FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL;
+
+/**
+  Loads into SMRAM the SMM drivers of the queue, and empties the queue.
+
+  The SMM drivers that cannot be loaded from SMM are loaded one by one with
+  EFI_SMM_BASE_PROTOCOL.Register(). The time that each SMM driver took to load is
+  reported through DebugLib.
+
+  @param  This                  Indicates the FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL instance.
+
+  @retval EFI_SUCCESS           The queue was empty, or all the SMM drivers of the
+                                queue were loaded.
+  @retval Others                The status of the last SMM driver that failed to load.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_FLUSH)(
+  IN FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *This
+  );
+
+///
+/// An SMM driver in the queue.
+///
+typedef struct {
+  EFI_HANDLE                ImageHandle;  ///< The handle of the driver outside SMM.
+  EFI_DEVICE_PATH_PROTOCOL  *FilePath;    ///< The full device path of the driver, freed once loaded.
+  VOID                      *ImageBase;   ///< The image of the driver outside SMM.
+  EFI_HANDLE                SmmHandle;    ///< The handle of the driver in SMM, once loaded.
+  EFI_STATUS                Status;       ///< The status of Register() from SMM.
+  UINT64                    LoadTime;     ///< Nanoseconds that Register() took in SMM.
+} FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_ENTRY;
+
+///
+/// The SMM Driver Load Queue Protocol. It is in boot services memory, so that the
+/// drivers outside SMM and the loader in SMM share it.
+///
+struct _FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL {
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_FLUSH  Flush;
+  ///
+  /// The EFI_SMM_BASE_PROTOCOL, located once for all the SMM drivers outside SMM.
+  /// The loader uses the one that it located in SMM.
+  ///
+  EFI_SMM_BASE_PROTOCOL                  *SmmBase;
+  ///
+  /// The handle of the loader in SMM, or NULL until it is registered.
+  ///
+  EFI_HANDLE                             LoaderHandle;
+  ///
+  /// The device that the last queued SMM driver was loaded from, with its device
+  /// path and the size of it, so that the device path is looked up and measured
+  /// once for all the SMM drivers of a firmware volume.
+  ///
+  EFI_HANDLE                             DeviceHandle;
+  EFI_DEVICE_PATH_PROTOCOL               *DevicePath;
+  UINTN                                  DevicePathSize;
+  UINT32                                 Count;     ///< SMM drivers in Entries.
+  UINT32                                 Batches;   ///< Communicate() calls so far.
+  UINT32                                 Loaded;    ///< SMM drivers loaded from SMM so far.
+  ///
+  /// TRUE once the queue was loaded at the end of DXE and closed. The SMM drivers
+  /// started after that are loaded one by one.
+  ///
+  BOOLEAN                                Closed;
+  UINT64                                 LoadTime;  ///< Nanoseconds of all their Register() calls.
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_ENTRY  Entries[FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_SIZE];
+};
+
+extern EFI_GUID gFrameworkSmmDriverLoadQueueProtocolGuid;
+
+#endif
@@ -0,0 +1,72 @@
+/** @file
+  Internal definitions of the boot script compression library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _BOOT_SCRIPT_COMPRESS_INTERNAL_H_
+#define _BOOT_SCRIPT_COMPRESS_INTERNAL_H_
+
+#include <PiDxe.h>
+
+#include <Framework/BootScript.h>
+
+#include <Library/BootScriptCompressLib.h>
+#include <Library/BootScriptInterpreterLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+//
+// An encoded record is the low byte of its opcode followed by opcode specific
+// fields. The width field of read-modify-write and poll records carries this flag
+// when the complement of DataMask is stored, which is shorter for the usual masks
+// that keep all but a few bits.
+//
+#define BOOT_SCRIPT_ENCODED_MASK_INVERTED   0x10
+#define BOOT_SCRIPT_ENCODED_WIDTH_MASK      0x0F
+
+/**
+  Returns the address space accessed by a write or read-modify-write opcode.
+
+  @param  OpCode  The opcode.
+
+  @return The address space.
+
+**/
+BOOT_SCRIPT_SPACE
+InternalBootScriptOpCodeSpace (
+  IN UINT16  OpCode
+  );
+
+/**
+  Returns the address that an access to the same space is expected to use next.
+
+  Writes are expected to continue after their last unit, read-modify-write and poll
+  records to access the same register again.
+
+  @param  OpCode    The opcode of the record.
+  @param  Width     The width of the record.
+  @param  Address   The address of the record.
+  @param  Count     The number of units of a write record.
+
+  @return The predicted next address.
+
+**/
+UINT64
+InternalBootScriptNextAddress (
+  IN UINT16  OpCode,
+  IN UINT32  Width,
+  IN UINT64  Address,
+  IN UINT32  Count
+  );
+
+#endif
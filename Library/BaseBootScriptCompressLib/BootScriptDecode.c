@@ -0,0 +1,627 @@
+/** @file
+  Streaming decoder of compact Framework boot script tables.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "BootScriptCompressInternal.h"
+
+/**
+  Reads bytes from the encoded table.
+
+  @param  Decoder   The decoder state.
+  @param  Data      The buffer that receives the bytes.
+  @param  Length    The number of bytes to read.
+
+  @retval TRUE      The bytes were read.
+  @retval FALSE     The encoded table ends first.
+
+**/
+BOOLEAN
+InternalBootScriptReadBytes (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  OUT    VOID                 *Data,
+  IN     UINTN                Length
+  )
+{
+  if (Length > Decoder->EncodedLength - Decoder->Position) {
+    return FALSE;
+  }
+
+  CopyMem (Data, Decoder->Encoded + Decoder->Position, Length);
+  Decoder->Position += Length;
+  return TRUE;
+}
+
+/**
+  Reads a variable length quantity from the encoded table.
+
+  @param  Decoder   The decoder state.
+  @param  Value     Returns the value.
+
+  @retval TRUE      The value was read.
+  @retval FALSE     The encoded table ends first or the value does not fit in 64 bits.
+
+**/
+BOOLEAN
+InternalBootScriptReadVarint (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  OUT    UINT64               *Value
+  )
+{
+  UINT8  Byte;
+  UINTN  Shift;
+
+  *Value = 0;
+  for (Shift = 0; Shift < 64; Shift += 7) {
+    if (Decoder->Position >= Decoder->EncodedLength) {
+      return FALSE;
+    }
+    Byte    = Decoder->Encoded[Decoder->Position++];
+    *Value |= LShiftU64 (Byte & 0x7F, Shift);
+    if ((Byte & 0x80) == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Reads a variable length quantity that must fit in 32 bits.
+
+  @param  Decoder   The decoder state.
+  @param  Value     Returns the value.
+
+  @retval TRUE      The value was read.
+  @retval FALSE     The encoded table is not valid.
+
+**/
+BOOLEAN
+InternalBootScriptReadVarint32 (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  OUT    UINT32               *Value
+  )
+{
+  UINT64  Value64;
+
+  if (!InternalBootScriptReadVarint (Decoder, &Value64) || Value64 > MAX_UINT32) {
+    return FALSE;
+  }
+
+  *Value = (UINT32) Value64;
+  return TRUE;
+}
+
+/**
+  Reads an address stored as the difference from the predicted address of its space.
+
+  @param  Decoder   The decoder state.
+  @param  OpCode    The opcode of the record.
+  @param  Width     The width of the record.
+  @param  Count     The number of units of a write record.
+  @param  Address   Returns the address.
+
+  @retval TRUE      The address was read.
+  @retval FALSE     The encoded table is not valid.
+
+**/
+BOOLEAN
+InternalBootScriptReadAddress (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  IN     UINT16               OpCode,
+  IN     UINT32               Width,
+  IN     UINT32               Count,
+  OUT    UINT64               *Address
+  )
+{
+  BOOT_SCRIPT_SPACE  Space;
+  UINT64             Delta;
+
+  if (!InternalBootScriptReadVarint (Decoder, &Delta)) {
+    return FALSE;
+  }
+
+  Space    = InternalBootScriptOpCodeSpace (OpCode);
+  Delta    = ((Delta & 1) != 0) ? ~RShiftU64 (Delta, 1) : RShiftU64 (Delta, 1);
+  *Address = Decoder->NextAddress[Space] + Delta;
+  Decoder->NextAddress[Space] = InternalBootScriptNextAddress (OpCode, Width, *Address, Count);
+  return TRUE;
+}
+
+/**
+  Reads the width field of a read-modify-write or poll record.
+
+  The field also tells whether the data mask, which follows later, is stored
+  complemented.
+
+  @param  Decoder   The decoder state.
+  @param  Width     Returns the width.
+  @param  Inverted  Returns TRUE if the stored mask is complemented.
+
+  @retval TRUE      The width was read.
+  @retval FALSE     The encoded table is not valid.
+
+**/
+BOOLEAN
+InternalBootScriptReadWidth (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  OUT    UINT32               *Width,
+  OUT    BOOLEAN              *Inverted
+  )
+{
+  UINT32  Value;
+
+  if (!InternalBootScriptReadVarint32 (Decoder, &Value) ||
+      (Value & ~(UINT32) (BOOT_SCRIPT_ENCODED_WIDTH_MASK | BOOT_SCRIPT_ENCODED_MASK_INVERTED)) != 0 ||
+      (Value & BOOT_SCRIPT_ENCODED_WIDTH_MASK) >= EfiBootScriptWidthMaximum) {
+    return FALSE;
+  }
+
+  *Width    = Value & BOOT_SCRIPT_ENCODED_WIDTH_MASK;
+  *Inverted = (BOOLEAN) ((Value & BOOT_SCRIPT_ENCODED_MASK_INVERTED) != 0);
+  return TRUE;
+}
+
+/**
+  Decodes the fields of a write record.
+
+  @param  Decoder   The decoder state.
+  @param  OpCode    The opcode of the record.
+  @param  Record    The buffer that receives the record.
+
+  @retval TRUE      The record was decoded.
+  @retval FALSE     The encoded table is not valid.
+
+**/
+BOOLEAN
+InternalBootScriptDecodeWrite (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  IN     UINT16               OpCode,
+  OUT    UINT8                *Record
+  )
+{
+  FRAMEWORK_EFI_BOOT_SCRIPT_WRITE  *Write;
+  UINT8                            *Data;
+  UINTN                            HeaderLength;
+  UINTN                            UnitSize;
+  UINT32                           Width;
+  UINT32                           Segment;
+  UINT32                           Count;
+  UINT32                           Index;
+  UINT32                           Run;
+  UINT32                           Repeat;
+
+  Write        = (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Record;
+  HeaderLength = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE);
+
+  if (!InternalBootScriptReadVarint32 (Decoder, &Width) || Width >= EfiBootScriptWidthMaximum) {
+    return FALSE;
+  }
+  if (OpCode == EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE) {
+    if (!InternalBootScriptReadVarint32 (Decoder, &Segment) || Segment > MAX_UINT16) {
+      return FALSE;
+    }
+    ((FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE *) Record)->Segment = (UINT16) Segment;
+    HeaderLength = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE);
+  }
+
+  if (!InternalBootScriptReadVarint32 (Decoder, &Count) ||
+      !InternalBootScriptReadAddress (Decoder, OpCode, Width, Count, &Write->Address)) {
+    return FALSE;
+  }
+
+  UnitSize = BootScriptGetWidthSize (Width);
+  if (Count > (BOOT_SCRIPT_MAX_RECORD_LENGTH - HeaderLength) / UnitSize) {
+    return FALSE;
+  }
+
+  Data = Record + HeaderLength;
+  for (Index = 0; Index < Count; Index += Run) {
+    if (!InternalBootScriptReadVarint32 (Decoder, &Run) || Run == 0 || Run > Count - Index ||
+        !InternalBootScriptReadBytes (Decoder, Data + Index * UnitSize, UnitSize)) {
+      return FALSE;
+    }
+    for (Repeat = 1; Repeat < Run; Repeat++) {
+      CopyMem (Data + (Index + Repeat) * UnitSize, Data + Index * UnitSize, UnitSize);
+    }
+  }
+
+  Write->Width  = Width;
+  Write->Count  = Count;
+  Write->Length = (UINT8) (HeaderLength + Count * UnitSize);
+  return TRUE;
+}
+
+/**
+  Decodes the fields of a record other than the table header.
+
+  @param  Decoder   The decoder state.
+  @param  OpCode    The opcode of the record.
+  @param  Record    The buffer that receives the record.
+
+  @retval TRUE      The record was decoded.
+  @retval FALSE     The encoded table is not valid.
+
+**/
+BOOLEAN
+InternalBootScriptDecodeFields (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  IN     UINT16               OpCode,
+  OUT    UINT8                *Record
+  )
+{
+  FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE     *ReadWrite;
+  FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL       *Poll;
+  FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE  *Smbus;
+  FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION    *Information;
+  FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2     *Dispatch2;
+  UINT32                                   Width;
+  UINT32                                   Value;
+  BOOLEAN                                  Inverted;
+
+  switch (OpCode) {
+  case EFI_BOOT_SCRIPT_IO_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+    return InternalBootScriptDecodeWrite (Decoder, OpCode, Record);
+
+  case EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE:
+    ReadWrite         = (FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Record;
+    ReadWrite->Length = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE);
+    if (!InternalBootScriptReadWidth (Decoder, &Width, &Inverted)) {
+      return FALSE;
+    }
+    if (OpCode == EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE) {
+      if (!InternalBootScriptReadVarint32 (Decoder, &Value) || Value > MAX_UINT16) {
+        return FALSE;
+      }
+      ((FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE *) Record)->Segment = (UINT16) Value;
+      ReadWrite->Length = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE);
+    }
+    ReadWrite->Width = Width;
+    if (!InternalBootScriptReadAddress (Decoder, OpCode, Width, 1, &ReadWrite->Address) ||
+        !InternalBootScriptReadVarint (Decoder, &ReadWrite->Data) ||
+        !InternalBootScriptReadVarint (Decoder, &ReadWrite->DataMask)) {
+      return FALSE;
+    }
+    if (Inverted) {
+      ReadWrite->DataMask = ~ReadWrite->DataMask;
+    }
+    return TRUE;
+
+  case FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE:
+    Poll         = (FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL *) Record;
+    Poll->Length = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL);
+    if (!InternalBootScriptReadWidth (Decoder, &Width, &Inverted)) {
+      return FALSE;
+    }
+    Poll->Width = Width;
+    if (!InternalBootScriptReadAddress (Decoder, OpCode, Width, 1, &Poll->Address) ||
+        !InternalBootScriptReadVarint (Decoder, &Poll->Data) ||
+        !InternalBootScriptReadVarint (Decoder, &Poll->DataMask) ||
+        !InternalBootScriptReadVarint (Decoder, &Poll->Duration) ||
+        !InternalBootScriptReadVarint (Decoder, &Poll->LoopTimes)) {
+      return FALSE;
+    }
+    if (Inverted) {
+      Poll->DataMask = ~Poll->DataMask;
+    }
+    return TRUE;
+
+  case EFI_BOOT_SCRIPT_SMBUS_EXECUTE_OPCODE:
+    Smbus = (FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE *) Record;
+    if (!InternalBootScriptReadVarint (Decoder, &Smbus->SlaveAddress) ||
+        !InternalBootScriptReadVarint (Decoder, &Smbus->Command) ||
+        !InternalBootScriptReadVarint32 (Decoder, &Smbus->Operation) ||
+        !InternalBootScriptReadBytes (Decoder, &Smbus->PecCheck, 1) ||
+        !InternalBootScriptReadVarint32 (Decoder, &Smbus->DataSize) ||
+        Smbus->DataSize > BOOT_SCRIPT_MAX_RECORD_LENGTH - sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE) ||
+        !InternalBootScriptReadBytes (Decoder, Smbus + 1, Smbus->DataSize)) {
+      return FALSE;
+    }
+    Smbus->Length = (UINT8) (sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE) + Smbus->DataSize);
+    return TRUE;
+
+  case EFI_BOOT_SCRIPT_STALL_OPCODE:
+    ((FRAMEWORK_EFI_BOOT_SCRIPT_STALL *) Record)->Length = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_STALL);
+    return InternalBootScriptReadVarint (Decoder, &((FRAMEWORK_EFI_BOOT_SCRIPT_STALL *) Record)->Duration);
+
+  case EFI_BOOT_SCRIPT_DISPATCH_OPCODE:
+    ((FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH *) Record)->Length = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH);
+    return InternalBootScriptReadVarint (Decoder, &((FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH *) Record)->EntryPoint);
+
+  case FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2_OPCODE:
+    Dispatch2         = (FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2 *) Record;
+    Dispatch2->Length = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2);
+    return (BOOLEAN) (InternalBootScriptReadVarint (Decoder, &Dispatch2->EntryPoint) &&
+                      InternalBootScriptReadVarint (Decoder, &Dispatch2->Context));
+
+  case EFI_BOOT_SCRIPT_INFORMATION_OPCODE:
+    Information = (FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION *) Record;
+    if (!InternalBootScriptReadVarint32 (Decoder, &Information->InformationLength) ||
+        Information->InformationLength > BOOT_SCRIPT_MAX_RECORD_LENGTH - sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION) ||
+        !InternalBootScriptReadBytes (Decoder, Information + 1, Information->InformationLength)) {
+      return FALSE;
+    }
+    Information->Length = (UINT8) (sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION) + Information->InformationLength);
+    return TRUE;
+
+  case FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE:
+    ((FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE *) Record)->Length = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE);
+    return TRUE;
+
+  default:
+    return FALSE;
+  }
+}
+
+/**
+  Starts decoding an encoded boot script table.
+
+  @param  Decoder       The decoder state to initialize.
+  @param  Encoded       A pointer to the BOOT_SCRIPT_ENCODED_HEADER that starts the encoded table.
+  @param  EncodedSize   The size of the buffer holding the encoded table.
+
+  @retval RETURN_SUCCESS            The decoder is ready.
+  @retval RETURN_INVALID_PARAMETER  Decoder or Encoded is NULL.
+  @retval RETURN_VOLUME_CORRUPTED   The header of the encoded table is not valid.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptDecoderInitialize (
+  OUT BOOT_SCRIPT_DECODER  *Decoder,
+  IN  CONST VOID           *Encoded,
+  IN  UINTN                EncodedSize
+  )
+{
+  BOOT_SCRIPT_ENCODED_HEADER  Header;
+
+  if (Decoder == NULL || Encoded == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (EncodedSize < sizeof (Header)) {
+    return RETURN_VOLUME_CORRUPTED;
+  }
+
+  CopyMem (&Header, Encoded, sizeof (Header));
+  if (Header.Signature != BOOT_SCRIPT_ENCODED_SIGNATURE ||
+      Header.EncodedLength < sizeof (Header) ||
+      Header.EncodedLength > EncodedSize ||
+      Header.TableLength < sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER) + sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE)) {
+    return RETURN_VOLUME_CORRUPTED;
+  }
+
+  ZeroMem (Decoder, sizeof (BOOT_SCRIPT_DECODER));
+  Decoder->Encoded       = Encoded;
+  Decoder->EncodedLength = Header.EncodedLength;
+  Decoder->Position      = sizeof (Header);
+  Decoder->TableLength   = Header.TableLength;
+  Decoder->Version       = Header.Version;
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Decodes the next record of an encoded boot script table.
+
+  The first record returned is the table header and the last one is the terminate
+  record, which must end the encoded table.
+
+  @param  Decoder   The decoder state.
+  @param  Record    A buffer of BOOT_SCRIPT_MAX_RECORD_LENGTH bytes that receives the record.
+  @param  Offset    An optional pointer that receives the offset of the record in the
+                    decoded table.
+
+  @retval RETURN_SUCCESS            A record was decoded.
+  @retval RETURN_END_OF_MEDIA       The terminate record has already been returned.
+  @retval RETURN_VOLUME_CORRUPTED   The encoded table is not valid, or bytes follow
+                                    its terminate record.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptDecodeNext (
+  IN OUT BOOT_SCRIPT_DECODER  *Decoder,
+  OUT    VOID                 *Record,
+  OUT    UINT32               *Offset  OPTIONAL
+  )
+{
+  FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER   *TableHeader;
+  FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER  *Header;
+  UINT8                                    Tag;
+
+  ASSERT (Decoder != NULL && Record != NULL);
+
+  if (Decoder->Done) {
+    return RETURN_END_OF_MEDIA;
+  }
+
+  Header = Record;
+  if (Decoder->Offset == 0) {
+    //
+    // The table header is not stored, it is rebuilt from the encoded header.
+    //
+    TableHeader = Record;
+    ZeroMem (TableHeader, sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER));
+    TableHeader->OpCode      = FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_OPCODE;
+    TableHeader->Length      = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER);
+    TableHeader->Version     = Decoder->Version;
+    TableHeader->TableLength = Decoder->TableLength;
+  } else {
+    if (!InternalBootScriptReadBytes (Decoder, &Tag, 1)) {
+      return RETURN_VOLUME_CORRUPTED;
+    }
+    ZeroMem (Header, sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER));
+    Header->OpCode = Tag;
+    if (!InternalBootScriptDecodeFields (Decoder, Header->OpCode, Record)) {
+      return RETURN_VOLUME_CORRUPTED;
+    }
+  }
+
+  //
+  // The records must add up to the table length recorded by the encoder, with the
+  // terminate record last and nothing encoded after it.
+  //
+  if (Header->Length > Decoder->TableLength - Decoder->Offset) {
+    return RETURN_VOLUME_CORRUPTED;
+  }
+  if (Header->OpCode == FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE) {
+    if (Decoder->Offset + Header->Length != Decoder->TableLength ||
+        Decoder->Position != Decoder->EncodedLength) {
+      return RETURN_VOLUME_CORRUPTED;
+    }
+    Decoder->Done = TRUE;
+  }
+
+  if (Offset != NULL) {
+    *Offset = Decoder->Offset;
+  }
+  Decoder->Offset += Header->Length;
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Decodes a whole encoded boot script table.
+
+  @param  Encoded       A pointer to the BOOT_SCRIPT_ENCODED_HEADER that starts the encoded table.
+  @param  EncodedSize   The size of the buffer holding the encoded table.
+  @param  Table         The buffer that receives the table. It may be NULL if TableSize is 0.
+  @param  TableSize     On input the size of Table, on output the size of the table.
+
+  @retval RETURN_SUCCESS            The table was decoded.
+  @retval RETURN_INVALID_PARAMETER  Encoded or TableSize is NULL.
+  @retval RETURN_VOLUME_CORRUPTED   The encoded table is not valid.
+  @retval RETURN_BUFFER_TOO_SMALL   Table is too small. TableSize returns the size needed.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptDecode (
+  IN     CONST VOID  *Encoded,
+  IN     UINTN       EncodedSize,
+  OUT    VOID        *Table      OPTIONAL,
+  IN OUT UINTN       *TableSize
+  )
+{
+  RETURN_STATUS        Status;
+  BOOT_SCRIPT_DECODER  Decoder;
+  UINT8                Record[BOOT_SCRIPT_MAX_RECORD_LENGTH];
+  UINT32               Offset;
+
+  if (Encoded == NULL || TableSize == NULL || (Table == NULL && *TableSize != 0)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Status = BootScriptDecoderInitialize (&Decoder, Encoded, EncodedSize);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  if (*TableSize < Decoder.TableLength) {
+    *TableSize = Decoder.TableLength;
+    return RETURN_BUFFER_TOO_SMALL;
+  }
+
+  //
+  // The decoder checks every record against the table length before it returns it,
+  // so the copy never crosses the end of the table.
+  //
+  while (!Decoder.Done) {
+    Status = BootScriptDecodeNext (&Decoder, Record, &Offset);
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+    CopyMem ((UINT8 *) Table + Offset, Record, ((FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->Length);
+  }
+
+  *TableSize = Decoder.TableLength;
+  return RETURN_SUCCESS;
+}
+
+/**
+  Executes an encoded boot script table, decoding one record at a time.
+
+  The whole table is decoded and checked once before the first record is executed,
+  so that a truncated or corrupted table does not program part of the hardware.
+
+  @param  Encoded       A pointer to the BOOT_SCRIPT_ENCODED_HEADER that starts the encoded table.
+  @param  EncodedSize   The size of the buffer holding the encoded table.
+  @param  Backend       The hardware access services.
+  @param  Profile       An optional pointer that receives the execution profile.
+
+  @retval RETURN_SUCCESS            The table was executed.
+  @retval RETURN_INVALID_PARAMETER  Encoded or Backend is NULL.
+  @retval RETURN_VOLUME_CORRUPTED   The encoded table is not valid. No record was
+                                    executed.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptExecuteEncoded (
+  IN  CONST VOID               *Encoded,
+  IN  UINTN                    EncodedSize,
+  IN  BOOT_SCRIPT_BACKEND      *Backend,
+  OUT BOOT_SCRIPT_PROFILE      *Profile  OPTIONAL
+  )
+{
+  RETURN_STATUS        Status;
+  BOOT_SCRIPT_DECODER  Decoder;
+  UINT8                Record[BOOT_SCRIPT_MAX_RECORD_LENGTH];
+  UINT32               Offset;
+
+  if (Encoded == NULL || Backend == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Status = BootScriptDecoderInitialize (&Decoder, Encoded, EncodedSize);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  while (!Decoder.Done) {
+    Status = BootScriptDecodeNext (&Decoder, Record, NULL);
+    if (RETURN_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "BootScriptExecuteEncoded: corrupted record at offset 0x%x\n", Decoder.Offset));
+      return Status;
+    }
+  }
+
+  BootScriptDecoderInitialize (&Decoder, Encoded, EncodedSize);
+  if (Profile != NULL) {
+    ZeroMem (Profile, sizeof (BOOT_SCRIPT_PROFILE));
+  }
+
+  while (!Decoder.Done) {
+    Status = BootScriptDecodeNext (&Decoder, Record, &Offset);
+    if (RETURN_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "BootScriptExecuteEncoded: corrupted record at offset 0x%x\n", Decoder.Offset));
+      return Status;
+    }
+
+    Status = BootScriptExecuteRecord (Record, Offset, Backend, Profile);
+    if (RETURN_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "BootScriptExecuteEncoded: opcode 0x%x at offset 0x%x - %r\n", ((FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->OpCode, Offset, Status));
+      return Status;
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
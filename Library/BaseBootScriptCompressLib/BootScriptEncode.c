@@ -0,0 +1,413 @@
+/** @file
+  Encoder of compact Framework boot script tables.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "BootScriptCompressInternal.h"
+
+///
+/// Output of the encoder. Position keeps counting once the buffer is full so
+/// that the size needed can be returned.
+///
+typedef struct {
+  UINT8   *Buffer;
+  UINTN   Size;
+  UINTN   Position;
+} BOOT_SCRIPT_WRITER;
+
+/**
+  Returns the address space accessed by a write or read-modify-write opcode.
+
+  @param  OpCode  The opcode.
+
+  @return The address space.
+
+**/
+BOOT_SCRIPT_SPACE
+InternalBootScriptOpCodeSpace (
+  IN UINT16  OpCode
+  )
+{
+  switch (OpCode) {
+  case EFI_BOOT_SCRIPT_IO_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE:
+    return BootScriptSpaceIo;
+
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE:
+    return BootScriptSpacePciConfig;
+
+  default:
+    return BootScriptSpaceMemory;
+  }
+}
+
+/**
+  Returns the address that an access to the same space is expected to use next.
+
+  Writes are expected to continue after their last unit, read-modify-write and poll
+  records to access the same register again.
+
+  @param  OpCode    The opcode of the record.
+  @param  Width     The width of the record.
+  @param  Address   The address of the record.
+  @param  Count     The number of units of a write record.
+
+  @return The predicted next address.
+
+**/
+UINT64
+InternalBootScriptNextAddress (
+  IN UINT16  OpCode,
+  IN UINT32  Width,
+  IN UINT64  Address,
+  IN UINT32  Count
+  )
+{
+  switch (OpCode) {
+  case EFI_BOOT_SCRIPT_IO_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+    if (Width >= EfiBootScriptWidthFifoUint8 && Width < EfiBootScriptWidthFillUint8) {
+      return Address;
+    }
+    return Address + MultU64x32 (BootScriptGetWidthSize (Width), Count);
+
+  default:
+    return Address;
+  }
+}
+
+/**
+  Appends bytes to the encoded table.
+
+  @param  Writer  The encoder output.
+  @param  Data    The bytes to append.
+  @param  Length  The number of bytes to append.
+
+**/
+VOID
+InternalBootScriptWriteBytes (
+  IN OUT BOOT_SCRIPT_WRITER  *Writer,
+  IN     CONST VOID          *Data,
+  IN     UINTN               Length
+  )
+{
+  if (Writer->Position + Length <= Writer->Size) {
+    CopyMem (Writer->Buffer + Writer->Position, Data, Length);
+  }
+  Writer->Position += Length;
+}
+
+/**
+  Appends an unsigned integer as a variable length quantity of 7 bits per byte,
+  least significant group first.
+
+  @param  Writer  The encoder output.
+  @param  Value   The value to append.
+
+**/
+VOID
+InternalBootScriptWriteVarint (
+  IN OUT BOOT_SCRIPT_WRITER  *Writer,
+  IN     UINT64              Value
+  )
+{
+  UINT8  Byte;
+
+  do {
+    Byte  = (UINT8) (Value & 0x7F);
+    Value = RShiftU64 (Value, 7);
+    if (Value != 0) {
+      Byte |= 0x80;
+    }
+    InternalBootScriptWriteBytes (Writer, &Byte, 1);
+  } while (Value != 0);
+}
+
+/**
+  Appends a signed difference so that small negative and positive values are short.
+
+  @param  Writer  The encoder output.
+  @param  Delta   The difference to append.
+
+**/
+VOID
+InternalBootScriptWriteDelta (
+  IN OUT BOOT_SCRIPT_WRITER  *Writer,
+  IN     UINT64              Delta
+  )
+{
+  if ((INT64) Delta < 0) {
+    InternalBootScriptWriteVarint (Writer, LShiftU64 (~Delta, 1) | 1);
+  } else {
+    InternalBootScriptWriteVarint (Writer, LShiftU64 (Delta, 1));
+  }
+}
+
+/**
+  Appends a width and a data mask, storing whichever of the mask and its complement
+  is shorter.
+
+  @param  Writer    The encoder output.
+  @param  Width     The width of the record.
+  @param  DataMask  The data mask of the record.
+
+  @return The value to append after the address, either DataMask or its complement.
+
+**/
+UINT64
+InternalBootScriptWriteWidthAndMask (
+  IN OUT BOOT_SCRIPT_WRITER  *Writer,
+  IN     UINT32              Width,
+  IN     UINT64              DataMask
+  )
+{
+  if (~DataMask < DataMask) {
+    InternalBootScriptWriteVarint (Writer, Width | BOOT_SCRIPT_ENCODED_MASK_INVERTED);
+    return ~DataMask;
+  }
+
+  InternalBootScriptWriteVarint (Writer, Width);
+  return DataMask;
+}
+
+/**
+  Appends an address as the difference from the predicted address of its space.
+
+  @param  Writer        The encoder output.
+  @param  NextAddress   The predicted addresses, updated for this record.
+  @param  OpCode        The opcode of the record.
+  @param  Width         The width of the record.
+  @param  Address       The address of the record.
+  @param  Count         The number of units of a write record.
+
+**/
+VOID
+InternalBootScriptWriteAddress (
+  IN OUT BOOT_SCRIPT_WRITER  *Writer,
+  IN OUT UINT64              *NextAddress,
+  IN     UINT16              OpCode,
+  IN     UINT32              Width,
+  IN     UINT64              Address,
+  IN     UINT32              Count
+  )
+{
+  BOOT_SCRIPT_SPACE  Space;
+
+  Space = InternalBootScriptOpCodeSpace (OpCode);
+  InternalBootScriptWriteDelta (Writer, Address - NextAddress[Space]);
+  NextAddress[Space] = InternalBootScriptNextAddress (OpCode, Width, Address, Count);
+}
+
+/**
+  Appends the data units of a write record as runs of equal units.
+
+  @param  Writer      The encoder output.
+  @param  Data        The data units.
+  @param  UnitSize    The size of one unit.
+  @param  Count       The number of units.
+  @param  Statistics  The statistics to update.
+
+**/
+VOID
+InternalBootScriptWriteRuns (
+  IN OUT BOOT_SCRIPT_WRITER             *Writer,
+  IN     CONST UINT8                    *Data,
+  IN     UINTN                          UnitSize,
+  IN     UINT32                         Count,
+  IN OUT BOOT_SCRIPT_ENCODE_STATISTICS  *Statistics
+  )
+{
+  UINT32  Index;
+  UINT32  Run;
+
+  for (Index = 0; Index < Count; Index += Run) {
+    for (Run = 1; Index + Run < Count; Run++) {
+      if (CompareMem (Data + Index * UnitSize, Data + (Index + Run) * UnitSize, UnitSize) != 0) {
+        break;
+      }
+    }
+    InternalBootScriptWriteVarint (Writer, Run);
+    InternalBootScriptWriteBytes (Writer, Data + Index * UnitSize, UnitSize);
+    Statistics->RepeatedUnits += Run - 1;
+  }
+}
+
+/**
+  Encodes a Framework boot script table.
+
+  @param  Table         A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that starts the table.
+  @param  Encoded       The buffer that receives the encoded table. It may be NULL if
+                        EncodedSize is 0.
+  @param  EncodedSize   On input the size of Encoded, on output the size of the encoded table.
+  @param  Statistics    An optional pointer that receives the encoding statistics.
+
+  @retval RETURN_SUCCESS            The table was encoded.
+  @retval RETURN_INVALID_PARAMETER  Table or EncodedSize is NULL.
+  @retval RETURN_UNSUPPORTED        The table is malformed.
+  @retval RETURN_BUFFER_TOO_SMALL   Encoded is too small. EncodedSize returns the size needed.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptEncode (
+  IN     CONST VOID                     *Table,
+  OUT    VOID                           *Encoded      OPTIONAL,
+  IN OUT UINTN                          *EncodedSize,
+  OUT    BOOT_SCRIPT_ENCODE_STATISTICS  *Statistics   OPTIONAL
+  )
+{
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER    *TableHeader;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER   *Header;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE           *Write;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE      *ReadWrite;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL        *Poll;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE   *Smbus;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION     *Information;
+  CONST UINT8                                     *Data;
+  BOOT_SCRIPT_ENCODED_HEADER                      EncodedHeader;
+  BOOT_SCRIPT_ENCODE_STATISTICS                   LocalStatistics;
+  BOOT_SCRIPT_WRITER                              Writer;
+  UINT64                                          NextAddress[BootScriptSpaceMaximum];
+  UINT64                                          Mask;
+  UINT32                                          Offset;
+  UINT8                                           Tag;
+
+  if (Table == NULL || EncodedSize == NULL || (Encoded == NULL && *EncodedSize != 0)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (RETURN_ERROR (BootScriptValidateTable (Table))) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  if (Statistics == NULL) {
+    Statistics = &LocalStatistics;
+  }
+  ZeroMem (Statistics, sizeof (BOOT_SCRIPT_ENCODE_STATISTICS));
+  ZeroMem (NextAddress, sizeof (NextAddress));
+
+  TableHeader     = Table;
+  Writer.Buffer   = Encoded;
+  Writer.Size     = *EncodedSize;
+  Writer.Position = sizeof (BOOT_SCRIPT_ENCODED_HEADER);
+
+  Offset = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER);
+  Statistics->Records = 1;
+  do {
+    Header = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) ((CONST UINT8 *) Table + Offset);
+    Tag    = (UINT8) Header->OpCode;
+    InternalBootScriptWriteBytes (&Writer, &Tag, 1);
+
+    switch (Header->OpCode) {
+    case EFI_BOOT_SCRIPT_IO_WRITE_OPCODE:
+    case EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE:
+    case EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE:
+    case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+      Write = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Header;
+      Data  = (CONST UINT8 *) (Write + 1);
+      InternalBootScriptWriteVarint (&Writer, Write->Width);
+      if (Header->OpCode == EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE) {
+        InternalBootScriptWriteVarint (&Writer, ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE *) Header)->Segment);
+        Data = (CONST UINT8 *) ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE *) Header + 1);
+      }
+      InternalBootScriptWriteVarint (&Writer, Write->Count);
+      InternalBootScriptWriteAddress (&Writer, NextAddress, Header->OpCode, Write->Width, Write->Address, Write->Count);
+      InternalBootScriptWriteRuns (&Writer, Data, BootScriptGetWidthSize (Write->Width), Write->Count, Statistics);
+      break;
+
+    case EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE:
+    case EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE:
+    case EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE:
+    case EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE:
+      ReadWrite = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Header;
+      Mask      = InternalBootScriptWriteWidthAndMask (&Writer, ReadWrite->Width, ReadWrite->DataMask);
+      if (Header->OpCode == EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE) {
+        InternalBootScriptWriteVarint (&Writer, ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE *) Header)->Segment);
+      }
+      InternalBootScriptWriteAddress (&Writer, NextAddress, Header->OpCode, ReadWrite->Width, ReadWrite->Address, 1);
+      InternalBootScriptWriteVarint (&Writer, ReadWrite->Data);
+      InternalBootScriptWriteVarint (&Writer, Mask);
+      break;
+
+    case FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE:
+      Poll = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL *) Header;
+      Mask = InternalBootScriptWriteWidthAndMask (&Writer, Poll->Width, Poll->DataMask);
+      InternalBootScriptWriteAddress (&Writer, NextAddress, Header->OpCode, Poll->Width, Poll->Address, 1);
+      InternalBootScriptWriteVarint (&Writer, Poll->Data);
+      InternalBootScriptWriteVarint (&Writer, Mask);
+      InternalBootScriptWriteVarint (&Writer, Poll->Duration);
+      InternalBootScriptWriteVarint (&Writer, Poll->LoopTimes);
+      break;
+
+    case EFI_BOOT_SCRIPT_SMBUS_EXECUTE_OPCODE:
+      Smbus = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE *) Header;
+      InternalBootScriptWriteVarint (&Writer, Smbus->SlaveAddress);
+      InternalBootScriptWriteVarint (&Writer, Smbus->Command);
+      InternalBootScriptWriteVarint (&Writer, Smbus->Operation);
+      InternalBootScriptWriteBytes (&Writer, &Smbus->PecCheck, 1);
+      InternalBootScriptWriteVarint (&Writer, Smbus->DataSize);
+      InternalBootScriptWriteBytes (&Writer, Smbus + 1, Smbus->DataSize);
+      break;
+
+    case EFI_BOOT_SCRIPT_STALL_OPCODE:
+      InternalBootScriptWriteVarint (&Writer, ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_STALL *) Header)->Duration);
+      break;
+
+    case EFI_BOOT_SCRIPT_DISPATCH_OPCODE:
+      InternalBootScriptWriteVarint (&Writer, ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH *) Header)->EntryPoint);
+      break;
+
+    case FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2_OPCODE:
+      InternalBootScriptWriteVarint (&Writer, ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2 *) Header)->EntryPoint);
+      InternalBootScriptWriteVarint (&Writer, ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2 *) Header)->Context);
+      break;
+
+    case EFI_BOOT_SCRIPT_INFORMATION_OPCODE:
+      Information = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION *) Header;
+      InternalBootScriptWriteVarint (&Writer, Information->InformationLength);
+      InternalBootScriptWriteBytes (&Writer, Information + 1, Information->InformationLength);
+      break;
+
+    default:
+      //
+      // The terminate record has no fields.
+      //
+      break;
+    }
+
+    Statistics->Records++;
+    Offset += Header->Length;
+  } while (Header->OpCode != FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE);
+
+  Statistics->TableLength   = TableHeader->TableLength;
+  Statistics->EncodedLength = Writer.Position;
+
+  if (Writer.Position > *EncodedSize) {
+    *EncodedSize = Writer.Position;
+    return RETURN_BUFFER_TOO_SMALL;
+  }
+
+  EncodedHeader.Signature     = BOOT_SCRIPT_ENCODED_SIGNATURE;
+  EncodedHeader.EncodedLength = (UINT32) Writer.Position;
+  EncodedHeader.TableLength   = TableHeader->TableLength;
+  EncodedHeader.Version       = TableHeader->Version;
+  EncodedHeader.Reserved      = 0;
+  CopyMem (Encoded, &EncodedHeader, sizeof (EncodedHeader));
+
+  *EncodedSize = Writer.Position;
+  return RETURN_SUCCESS;
+}
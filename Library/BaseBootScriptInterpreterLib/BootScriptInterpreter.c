@@ -0,0 +1,540 @@
+/** @file
+  Execution and profiling of Framework boot script tables.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "BootScriptInterpreterInternal.h"
+
+/**
+  Performs the units of a write record.
+
+  @param  Backend   The hardware access services.
+  @param  Space     The address space of the record.
+  @param  Write     The write record.
+  @param  Segment   The PCI segment of the record.
+  @param  Data      The data following the record.
+  @param  Cost      Returns the cost of all units.
+
+  @retval RETURN_SUCCESS  All units were written.
+  @retval Others          The status returned by the backend.
+
+**/
+RETURN_STATUS
+InternalBootScriptWrite (
+  IN  BOOT_SCRIPT_BACKEND                    *Backend,
+  IN  BOOT_SCRIPT_SPACE                      Space,
+  IN  CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE  *Write,
+  IN  UINT16                                 Segment,
+  IN  CONST UINT8                            *Data,
+  OUT UINT64                                 *Cost
+  )
+{
+  RETURN_STATUS  Status;
+  UINT64         Address;
+  UINT64         Value;
+  UINT64         AccessCost;
+  UINTN          Size;
+  UINT32         Index;
+
+  Size    = BootScriptGetWidthSize (Write->Width);
+  Address = Write->Address;
+  *Cost   = 0;
+
+  for (Index = 0; Index < Write->Count; Index++) {
+    Value = 0;
+    CopyMem (&Value, Data, Size);
+    Status = Backend->Access (
+                        Backend,
+                        Space,
+                        TRUE,
+                        (EFI_BOOT_SCRIPT_WIDTH) (Write->Width & 0x03),
+                        Segment,
+                        Address,
+                        &Value,
+                        &AccessCost
+                        );
+    *Cost += AccessCost;
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+
+    //
+    // FIFO widths keep the address, fill widths keep the data.
+    //
+    if (Write->Width < EfiBootScriptWidthFifoUint8 || Write->Width >= EfiBootScriptWidthFillUint8) {
+      Address += Size;
+    }
+    if (Write->Width < EfiBootScriptWidthFillUint8) {
+      Data += Size;
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Performs a read-modify-write.
+
+  @param  Backend   The hardware access services.
+  @param  Space     The address space of the record.
+  @param  ReadWrite The read-modify-write record.
+  @param  Segment   The PCI segment of the record.
+  @param  Cost      Returns the cost of the read and the write.
+
+  @retval RETURN_SUCCESS  The register was updated.
+  @retval Others          The status returned by the backend.
+
+**/
+RETURN_STATUS
+InternalBootScriptReadWrite (
+  IN  BOOT_SCRIPT_BACKEND                         *Backend,
+  IN  BOOT_SCRIPT_SPACE                           Space,
+  IN  CONST FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE  *ReadWrite,
+  IN  UINT16                                      Segment,
+  OUT UINT64                                      *Cost
+  )
+{
+  RETURN_STATUS          Status;
+  EFI_BOOT_SCRIPT_WIDTH  Width;
+  UINT64                 Value;
+  UINT64                 AccessCost;
+
+  Width = (EFI_BOOT_SCRIPT_WIDTH) (ReadWrite->Width & 0x03);
+  Value = 0;
+
+  Status = Backend->Access (Backend, Space, FALSE, Width, Segment, ReadWrite->Address, &Value, Cost);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  Value  = (Value & ReadWrite->DataMask) | ReadWrite->Data;
+  Status = Backend->Access (Backend, Space, TRUE, Width, Segment, ReadWrite->Address, &Value, &AccessCost);
+  *Cost += AccessCost;
+
+  return Status;
+}
+
+/**
+  Reads the memory location of a poll record once.
+
+  @param  Backend     The hardware access services.
+  @param  Poll        The FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE record.
+  @param  Satisfied   Returns TRUE if the value read matches the poll condition.
+  @param  Cost        Returns the cost of the read.
+
+  @retval RETURN_SUCCESS  The location was read.
+  @retval Others          The status returned by the backend.
+
+**/
+RETURN_STATUS
+InternalBootScriptPollOnce (
+  IN  BOOT_SCRIPT_BACKEND                       *Backend,
+  IN  CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL  *Poll,
+  OUT BOOLEAN                                   *Satisfied,
+  OUT UINT64                                    *Cost
+  )
+{
+  RETURN_STATUS  Status;
+  UINT64         Value;
+
+  Value  = 0;
+  Status = Backend->Access (
+                      Backend,
+                      BootScriptSpaceMemory,
+                      FALSE,
+                      (EFI_BOOT_SCRIPT_WIDTH) (Poll->Width & 0x03),
+                      0,
+                      Poll->Address,
+                      &Value,
+                      Cost
+                      );
+  *Satisfied = (BOOLEAN) ((Value & Poll->DataMask) == Poll->Data);
+
+  return Status;
+}
+
+/**
+  Polls a memory location until its condition is met or the loop count expires.
+
+  @param  Backend   The hardware access services.
+  @param  Poll      The FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE record.
+  @param  Profile   An optional profile whose poll statistics are updated.
+  @param  Cost      Returns the cost of all reads and waits.
+
+  @retval RETURN_SUCCESS  The condition was met.
+  @retval RETURN_TIMEOUT  The condition was not met within the loop count.
+  @retval Others          The status returned by the backend.
+
+**/
+RETURN_STATUS
+InternalBootScriptPoll (
+  IN     BOOT_SCRIPT_BACKEND                       *Backend,
+  IN     CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL  *Poll,
+  IN OUT BOOT_SCRIPT_PROFILE                       *Profile  OPTIONAL,
+  OUT    UINT64                                    *Cost
+  )
+{
+  RETURN_STATUS  Status;
+  BOOLEAN        Satisfied;
+  UINT64         ReadCost;
+  UINT64         StallCost;
+  UINT64         Loop;
+
+  *Cost = 0;
+  for (Loop = 0; ; Loop++) {
+    Status = InternalBootScriptPollOnce (Backend, Poll, &Satisfied, &ReadCost);
+    *Cost += ReadCost;
+    if (RETURN_ERROR (Status) || Satisfied) {
+      return Status;
+    }
+
+    //
+    // At least one read is performed even if LoopTimes is 0.
+    //
+    if (Loop + 1 >= Poll->LoopTimes) {
+      return RETURN_TIMEOUT;
+    }
+
+    Backend->Stall (Backend, Poll->Duration, &StallCost);
+    *Cost += StallCost;
+    if (Profile != NULL) {
+      Profile->PollRetries++;
+      Profile->PollWait += ReadCost + StallCost;
+    }
+  }
+}
+
+/**
+  Executes one record to completion.
+
+  @param  Record    A pointer to the validated record.
+  @param  Backend   The hardware access services.
+  @param  Profile   An optional profile whose poll statistics are updated.
+  @param  Cost      Returns the cost of the record.
+  @param  Class     Returns the class of work the cost is attributed to.
+
+  @retval RETURN_SUCCESS            The record was executed.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval RETURN_UNSUPPORTED        The opcode is not supported.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+InternalBootScriptRunRecord (
+  IN     CONST UINT8             *Record,
+  IN     BOOT_SCRIPT_BACKEND     *Backend,
+  IN OUT BOOT_SCRIPT_PROFILE     *Profile  OPTIONAL,
+  OUT    UINT64                  *Cost,
+  OUT    BOOT_SCRIPT_COST_CLASS  *Class
+  )
+{
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE  *Smbus;
+  UINT8                                          SmbusData[MAX_UINT8];
+  UINTN                                          SmbusLength;
+
+  *Cost = 0;
+
+  switch (((CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->OpCode) {
+  case EFI_BOOT_SCRIPT_IO_WRITE_OPCODE:
+    *Class = BootScriptCostIo;
+    return InternalBootScriptWrite (
+             Backend,
+             BootScriptSpaceIo,
+             (CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Record,
+             0,
+             Record + sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE),
+             Cost
+             );
+
+  case EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE:
+    *Class = BootScriptCostMemory;
+    return InternalBootScriptWrite (
+             Backend,
+             BootScriptSpaceMemory,
+             (CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Record,
+             0,
+             Record + sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE),
+             Cost
+             );
+
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE:
+    *Class = BootScriptCostPciConfig;
+    return InternalBootScriptWrite (
+             Backend,
+             BootScriptSpacePciConfig,
+             (CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Record,
+             0,
+             Record + sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE),
+             Cost
+             );
+
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+    *Class = BootScriptCostPciConfig;
+    return InternalBootScriptWrite (
+             Backend,
+             BootScriptSpacePciConfig,
+             (CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Record,
+             ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE *) Record)->Segment,
+             Record + sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE),
+             Cost
+             );
+
+  case EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE:
+    *Class = BootScriptCostIo;
+    return InternalBootScriptReadWrite (Backend, BootScriptSpaceIo, (CONST FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Record, 0, Cost);
+
+  case EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE:
+    *Class = BootScriptCostMemory;
+    return InternalBootScriptReadWrite (Backend, BootScriptSpaceMemory, (CONST FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Record, 0, Cost);
+
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE:
+    *Class = BootScriptCostPciConfig;
+    return InternalBootScriptReadWrite (Backend, BootScriptSpacePciConfig, (CONST FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Record, 0, Cost);
+
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE:
+    *Class = BootScriptCostPciConfig;
+    return InternalBootScriptReadWrite (
+             Backend,
+             BootScriptSpacePciConfig,
+             (CONST FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Record,
+             ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE *) Record)->Segment,
+             Cost
+             );
+
+  case EFI_BOOT_SCRIPT_SMBUS_EXECUTE_OPCODE:
+    *Class      = BootScriptCostSmbus;
+    Smbus       = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE *) Record;
+    SmbusLength = Smbus->DataSize;
+    CopyMem (SmbusData, Smbus + 1, SmbusLength);
+    return Backend->Smbus (
+                      Backend,
+                      Smbus->SlaveAddress,
+                      Smbus->Command,
+                      Smbus->Operation,
+                      (BOOLEAN) (Smbus->PecCheck != 0),
+                      &SmbusLength,
+                      SmbusData,
+                      Cost
+                      );
+
+  case EFI_BOOT_SCRIPT_STALL_OPCODE:
+    *Class = BootScriptCostStall;
+    Backend->Stall (Backend, ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_STALL *) Record)->Duration, Cost);
+    return RETURN_SUCCESS;
+
+  case EFI_BOOT_SCRIPT_DISPATCH_OPCODE:
+    *Class = BootScriptCostDispatch;
+    return Backend->Dispatch (Backend, ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH *) Record)->EntryPoint, 0, Cost);
+
+  case FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2_OPCODE:
+    *Class = BootScriptCostDispatch;
+    return Backend->Dispatch (
+                      Backend,
+                      ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2 *) Record)->EntryPoint,
+                      ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2 *) Record)->Context,
+                      Cost
+                      );
+
+  case FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE:
+    *Class = BootScriptCostPoll;
+    return InternalBootScriptPoll (Backend, (CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL *) Record, Profile, Cost);
+
+  case EFI_BOOT_SCRIPT_INFORMATION_OPCODE:
+  case FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_OPCODE:
+  case FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE:
+    *Class = BootScriptCostIo;
+    return RETURN_SUCCESS;
+
+  default:
+    *Class = BootScriptCostIo;
+    return RETURN_UNSUPPORTED;
+  }
+}
+
+/**
+  Records the cost of one record in the per opcode statistics and the list of the
+  most expensive records.
+
+  @param  Profile   The profile to update.
+  @param  Offset    The offset of the record in its table.
+  @param  OpCode    The opcode of the record.
+  @param  Cost      The cost of the record.
+
+**/
+VOID
+InternalBootScriptProfileRecord (
+  IN OUT BOOT_SCRIPT_PROFILE  *Profile,
+  IN     UINT32               Offset,
+  IN     UINT16               OpCode,
+  IN     UINT64               Cost
+  )
+{
+  UINTN  Index;
+
+  if (OpCode < BOOT_SCRIPT_PROFILE_OPCODE_COUNT) {
+    Profile->OpCode[OpCode].Count++;
+    Profile->OpCode[OpCode].Cost += Cost;
+  }
+
+  //
+  // Keep the list of the most expensive records sorted by insertion.
+  //
+  Index = BOOT_SCRIPT_PROFILE_HOT_RECORDS;
+  while (Index > 0 && Profile->HotRecord[Index - 1].Cost < Cost) {
+    if (Index < BOOT_SCRIPT_PROFILE_HOT_RECORDS) {
+      Profile->HotRecord[Index] = Profile->HotRecord[Index - 1];
+    }
+    Index--;
+  }
+  if (Index < BOOT_SCRIPT_PROFILE_HOT_RECORDS) {
+    Profile->HotRecord[Index].Offset = Offset;
+    Profile->HotRecord[Index].OpCode = OpCode;
+    Profile->HotRecord[Index].Cost   = Cost;
+  }
+}
+
+/**
+  Executes one boot script record.
+
+  This allows a caller that produces records one at a time, for example a decoder of
+  an encoded table, to execute them without an expanded copy of the table.
+
+  @param  Record    A pointer to the record. It must have been validated.
+  @param  Offset    The offset of the record in its table, recorded in the profile.
+  @param  Backend   The hardware access services.
+  @param  Profile   An optional profile that is updated with the cost of the record.
+
+  @retval RETURN_SUCCESS            The record was executed.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval RETURN_UNSUPPORTED        The opcode is not supported.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptExecuteRecord (
+  IN     CONST VOID               *Record,
+  IN     UINT32                   Offset,
+  IN     BOOT_SCRIPT_BACKEND      *Backend,
+  IN OUT BOOT_SCRIPT_PROFILE      *Profile  OPTIONAL
+  )
+{
+  RETURN_STATUS           Status;
+  UINT64                  Cost;
+  BOOT_SCRIPT_COST_CLASS  Class;
+
+  ASSERT (Record != NULL && Backend != NULL);
+
+  Status = InternalBootScriptRunRecord (Record, Backend, Profile, &Cost, &Class);
+  if (Profile != NULL) {
+    InternalBootScriptProfileRecord (
+      Profile,
+      Offset,
+      ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->OpCode,
+      Cost
+      );
+    Profile->TotalCost           += Cost;
+    Profile->SerialCost          += Cost;
+    Profile->CriticalPath[Class] += Cost;
+  }
+
+  return Status;
+}
+
+/**
+  Validates and executes a Framework boot script table in order.
+
+  @param  Table     A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that starts the table.
+  @param  Backend   The hardware access services.
+  @param  Profile   An optional pointer that receives the execution profile.
+
+  @retval RETURN_SUCCESS            The table was executed.
+  @retval RETURN_INVALID_PARAMETER  Table or Backend is NULL.
+  @retval RETURN_UNSUPPORTED        The table is malformed or contains an unknown opcode.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptExecute (
+  IN  CONST VOID               *Table,
+  IN  BOOT_SCRIPT_BACKEND      *Backend,
+  OUT BOOT_SCRIPT_PROFILE      *Profile  OPTIONAL
+  )
+{
+  RETURN_STATUS                                  Status;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER  *Header;
+  UINT32                                         Offset;
+
+  if (Table == NULL || Backend == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (!InternalBootScriptIsValidTable (Table)) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  if (Profile != NULL) {
+    ZeroMem (Profile, sizeof (BOOT_SCRIPT_PROFILE));
+  }
+
+  Offset = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER);
+  do {
+    Header = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) ((CONST UINT8 *) Table + Offset);
+    Status = BootScriptExecuteRecord (Header, Offset, Backend, Profile);
+    if (RETURN_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "BootScriptExecute: opcode 0x%x at offset 0x%x - %r\n", Header->OpCode, Offset, Status));
+      return Status;
+    }
+    Offset += Header->Length;
+  } while (Header->OpCode != FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE);
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Looks up the modeled latency of an access.
+
+  @param  Ranges        An array of device latency ranges. The first match wins.
+  @param  RangeCount    The number of entries in Ranges.
+  @param  Space         The address space of the access.
+  @param  Address       The address of the access.
+  @param  Write         TRUE for a write, FALSE for a read.
+  @param  DefaultCost   The cost returned when no range matches.
+
+  @return The modeled cost of the access in nanoseconds.
+
+**/
+UINT64
+EFIAPI
+BootScriptGetAccessLatency (
+  IN CONST BOOT_SCRIPT_LATENCY_RANGE  *Ranges,
+  IN UINTN                            RangeCount,
+  IN BOOT_SCRIPT_SPACE                Space,
+  IN UINT64                           Address,
+  IN BOOLEAN                          Write,
+  IN UINT64                           DefaultCost
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < RangeCount; Index++) {
+    if (Ranges[Index].Space == Space &&
+        Address >= Ranges[Index].Base &&
+        Address - Ranges[Index].Base < Ranges[Index].Length) {
+      return Write ? Ranges[Index].WriteCost : Ranges[Index].ReadCost;
+    }
+  }
+
+  return DefaultCost;
+}
@@ -0,0 +1,103 @@
+/** @file
+  Internal header file for the boot script interpreter library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _BOOT_SCRIPT_INTERPRETER_INTERNAL_H_
+#define _BOOT_SCRIPT_INTERPRETER_INTERNAL_H_
+
+#include <PiDxe.h>
+
+#include <Framework/BootScript.h>
+
+#include <Library/BootScriptInterpreterLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+/**
+  Validates a whole boot script table.
+
+  @param  Table   A pointer to the table header.
+
+  @retval TRUE    The table is well formed.
+  @retval FALSE   The table is malformed.
+
+**/
+BOOLEAN
+InternalBootScriptIsValidTable (
+  IN CONST UINT8  *Table
+  );
+
+/**
+  Reads the memory location of a poll record once.
+
+  @param  Backend     The hardware access services.
+  @param  Poll        The FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE record.
+  @param  Satisfied   Returns TRUE if the value read matches the poll condition.
+  @param  Cost        Returns the cost of the read.
+
+  @retval RETURN_SUCCESS  The location was read.
+  @retval Others          The status returned by the backend.
+
+**/
+RETURN_STATUS
+InternalBootScriptPollOnce (
+  IN  BOOT_SCRIPT_BACKEND                       *Backend,
+  IN  CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL  *Poll,
+  OUT BOOLEAN                                   *Satisfied,
+  OUT UINT64                                    *Cost
+  );
+
+/**
+  Executes one record to completion.
+
+  @param  Record    A pointer to the validated record.
+  @param  Backend   The hardware access services.
+  @param  Profile   An optional profile whose poll statistics are updated.
+  @param  Cost      Returns the cost of the record.
+  @param  Class     Returns the class of work the cost is attributed to.
+
+  @retval RETURN_SUCCESS            The record was executed.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval RETURN_UNSUPPORTED        The opcode is not supported.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+InternalBootScriptRunRecord (
+  IN     CONST UINT8             *Record,
+  IN     BOOT_SCRIPT_BACKEND     *Backend,
+  IN OUT BOOT_SCRIPT_PROFILE     *Profile  OPTIONAL,
+  OUT    UINT64                  *Cost,
+  OUT    BOOT_SCRIPT_COST_CLASS  *Class
+  );
+
+/**
+  Records the cost of one record in the per opcode statistics and the list of the
+  most expensive records.
+
+  @param  Profile   The profile to update.
+  @param  Offset    The offset of the record in its table.
+  @param  OpCode    The opcode of the record.
+  @param  Cost      The cost of the record.
+
+**/
+VOID
+InternalBootScriptProfileRecord (
+  IN OUT BOOT_SCRIPT_PROFILE  *Profile,
+  IN     UINT32               Offset,
+  IN     UINT16               OpCode,
+  IN     UINT64               Cost
+  );
+
+#endif
@@ -0,0 +1,402 @@
+/** @file
+  Interleaved execution of segmented Framework boot script tables.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "BootScriptInterpreterInternal.h"
+
+///
+/// Execution state of one segment.
+///
+typedef struct {
+  UINT32  Offset;           ///< Offset of the next record to execute.
+  UINT32  End;              ///< Offset of the record that ends the segment.
+  UINT32  DependencyMask;
+  UINT64  ReadyTime;        ///< The segment waits until this time.
+  UINT64  PollReads;        ///< Reads done so far by the current poll record.
+  UINT64  RecordCost;       ///< Cost accumulated so far by the current record.
+  UINT64  Cost;             ///< Cost of the completed records of the segment.
+  UINT64  ClassCost[BootScriptCostMaximum];
+} BOOT_SCRIPT_SEGMENT;
+
+///
+/// Execution state of a segmented table.
+///
+typedef struct {
+  CONST UINT8           *Table;
+  BOOT_SCRIPT_BACKEND   *Backend;
+  BOOT_SCRIPT_PROFILE   *Profile;
+  UINT64                Now;
+  UINT32                Count;
+  UINT32                DoneMask;
+  BOOT_SCRIPT_SEGMENT   Segment[BOOT_SCRIPT_MAX_SEGMENTS];
+} BOOT_SCRIPT_SEGMENT_CONTEXT;
+
+/**
+  Reads the segment information carried by a record.
+
+  @param  Record    A pointer to a validated record.
+  @param  Segment   Returns the segment information. The payload of a record is not
+                    aligned, so it is copied.
+
+  @retval TRUE      The record is a segment marker.
+  @retval FALSE     The record is not a segment marker.
+
+**/
+BOOLEAN
+InternalBootScriptGetSegmentInformation (
+  IN  CONST UINT8                      *Record,
+  OUT BOOT_SCRIPT_SEGMENT_INFORMATION  *Segment
+  )
+{
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION  *Information;
+
+  Information = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION *) Record;
+  if (Information->OpCode != EFI_BOOT_SCRIPT_INFORMATION_OPCODE ||
+      Information->InformationLength != sizeof (BOOT_SCRIPT_SEGMENT_INFORMATION)) {
+    return FALSE;
+  }
+
+  CopyMem (Segment, Information + 1, sizeof (BOOT_SCRIPT_SEGMENT_INFORMATION));
+  return (BOOLEAN) (Segment->Signature == BOOT_SCRIPT_SEGMENT_SIGNATURE);
+}
+
+/**
+  Splits a validated table into segments.
+
+  @param  Context   The context whose Table is set. Returns the segments.
+
+  @retval TRUE      The table is segmented and its markers are consistent.
+  @retval FALSE     The table must be executed in order.
+
+**/
+BOOLEAN
+InternalBootScriptParseSegments (
+  IN OUT BOOT_SCRIPT_SEGMENT_CONTEXT  *Context
+  )
+{
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER  *Header;
+  BOOT_SCRIPT_SEGMENT_INFORMATION                Information;
+  UINT32                                         Offset;
+
+  Offset = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER);
+  if (!InternalBootScriptGetSegmentInformation (Context->Table + Offset, &Information)) {
+    return FALSE;
+  }
+
+  Context->Count = 0;
+  for (;;) {
+    Header = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) (Context->Table + Offset);
+    if (Header->OpCode == FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE) {
+      Context->Segment[Context->Count - 1].End = Offset;
+      return TRUE;
+    }
+
+    if (InternalBootScriptGetSegmentInformation ((CONST UINT8 *) Header, &Information)) {
+      //
+      // Segments are numbered in table order and only depend on earlier segments,
+      // which keeps the dependency graph acyclic.
+      //
+      if (Context->Count == BOOT_SCRIPT_MAX_SEGMENTS ||
+          Information.SegmentId != Context->Count ||
+          (Information.DependencyMask & ~(LShiftU64 (1, Context->Count) - 1)) != 0) {
+        DEBUG ((DEBUG_WARN, "BootScriptExecuteSegmented: bad segment marker at offset 0x%x\n", Offset));
+        return FALSE;
+      }
+      if (Context->Count > 0) {
+        Context->Segment[Context->Count - 1].End = Offset;
+      }
+      Context->Segment[Context->Count].Offset         = Offset + Header->Length;
+      Context->Segment[Context->Count].DependencyMask = Information.DependencyMask;
+      Context->Count++;
+    }
+
+    Offset += Header->Length;
+  }
+}
+
+/**
+  Completes the current record of a segment.
+
+  @param  Context   The execution context.
+  @param  Segment   The segment.
+
+**/
+VOID
+InternalBootScriptCompleteRecord (
+  IN OUT BOOT_SCRIPT_SEGMENT_CONTEXT  *Context,
+  IN OUT BOOT_SCRIPT_SEGMENT          *Segment
+  )
+{
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER  *Header;
+
+  Header = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) (Context->Table + Segment->Offset);
+  if (Context->Profile != NULL) {
+    InternalBootScriptProfileRecord (Context->Profile, Segment->Offset, Header->OpCode, Segment->RecordCost);
+    Context->Profile->SerialCost += Segment->RecordCost;
+  }
+
+  Segment->Cost      += Segment->RecordCost;
+  Segment->RecordCost = 0;
+  Segment->PollReads  = 0;
+  Segment->Offset    += Header->Length;
+}
+
+/**
+  Executes the next record of a segment, or the next read of its current poll record.
+
+  Stall and poll waits do not stall the backend. They set the time at which the
+  segment is ready again and let other segments run in the meantime.
+
+  @param  Context   The execution context.
+  @param  Segment   The segment.
+
+  @retval RETURN_SUCCESS            The step was executed.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval RETURN_UNSUPPORTED        The opcode is not supported.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+InternalBootScriptStepSegment (
+  IN OUT BOOT_SCRIPT_SEGMENT_CONTEXT  *Context,
+  IN OUT BOOT_SCRIPT_SEGMENT          *Segment
+  )
+{
+  RETURN_STATUS                             Status;
+  CONST UINT8                               *Record;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL  *Poll;
+  BOOLEAN                                   Satisfied;
+  BOOT_SCRIPT_COST_CLASS                    Class;
+  UINT64                                    Cost;
+  UINT64                                    Wait;
+
+  Record = Context->Table + Segment->Offset;
+
+  switch (((CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->OpCode) {
+  case EFI_BOOT_SCRIPT_STALL_OPCODE:
+    Wait                                     = MultU64x32 (((CONST FRAMEWORK_EFI_BOOT_SCRIPT_STALL *) Record)->Duration, 1000);
+    Segment->ReadyTime                       = Context->Now + Wait;
+    Segment->RecordCost                      = Wait;
+    Segment->ClassCost[BootScriptCostStall] += Wait;
+    InternalBootScriptCompleteRecord (Context, Segment);
+    return RETURN_SUCCESS;
+
+  case FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE:
+    Poll   = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL *) Record;
+    Status = InternalBootScriptPollOnce (Context->Backend, Poll, &Satisfied, &Cost);
+    Context->Now                           += Cost;
+    Segment->RecordCost                    += Cost;
+    Segment->ClassCost[BootScriptCostPoll] += Cost;
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+    if (Satisfied) {
+      InternalBootScriptCompleteRecord (Context, Segment);
+      return RETURN_SUCCESS;
+    }
+
+    //
+    // At least one read is performed even if LoopTimes is 0.
+    //
+    Segment->PollReads++;
+    if (Segment->PollReads >= Poll->LoopTimes) {
+      return RETURN_TIMEOUT;
+    }
+
+    Wait                                    = MultU64x32 (Poll->Duration, 1000);
+    Segment->ReadyTime                      = Context->Now + Wait;
+    Segment->RecordCost                    += Wait;
+    Segment->ClassCost[BootScriptCostPoll] += Wait;
+    if (Context->Profile != NULL) {
+      Context->Profile->PollRetries++;
+      Context->Profile->PollWait += Cost + Wait;
+    }
+    return RETURN_SUCCESS;
+
+  default:
+    Status = InternalBootScriptRunRecord (Record, Context->Backend, Context->Profile, &Cost, &Class);
+    Context->Now              += Cost;
+    Segment->RecordCost       += Cost;
+    Segment->ClassCost[Class] += Cost;
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+    InternalBootScriptCompleteRecord (Context, Segment);
+    return RETURN_SUCCESS;
+  }
+}
+
+/**
+  Computes the most expensive chain of dependent segments.
+
+  @param  Context   The execution context of a completed table.
+  @param  Profile   The profile whose CriticalPath is set.
+
+**/
+VOID
+InternalBootScriptSegmentCriticalPath (
+  IN     BOOT_SCRIPT_SEGMENT_CONTEXT  *Context,
+  IN OUT BOOT_SCRIPT_PROFILE          *Profile
+  )
+{
+  UINT64  Finish[BOOT_SCRIPT_MAX_SEGMENTS];
+  UINT8   Predecessor[BOOT_SCRIPT_MAX_SEGMENTS];
+  UINT32  Index;
+  UINT32  Dependency;
+  UINT32  Last;
+  UINTN   Class;
+
+  //
+  // Dependencies only point to earlier segments, so table order is a topological order.
+  //
+  Last = 0;
+  for (Index = 0; Index < Context->Count; Index++) {
+    Finish[Index]      = 0;
+    Predecessor[Index] = MAX_UINT8;
+    for (Dependency = 0; Dependency < Index; Dependency++) {
+      if ((Context->Segment[Index].DependencyMask & (1u << Dependency)) != 0 && Finish[Dependency] > Finish[Index]) {
+        Finish[Index]      = Finish[Dependency];
+        Predecessor[Index] = (UINT8) Dependency;
+      }
+    }
+    Finish[Index] += Context->Segment[Index].Cost;
+    if (Finish[Index] > Finish[Last]) {
+      Last = Index;
+    }
+  }
+
+  ZeroMem (Profile->CriticalPath, sizeof (Profile->CriticalPath));
+  for (Index = Last; Index != MAX_UINT8; Index = Predecessor[Index]) {
+    for (Class = 0; Class < BootScriptCostMaximum; Class++) {
+      Profile->CriticalPath[Class] += Context->Segment[Index].ClassCost[Class];
+    }
+  }
+}
+
+/**
+  Validates and executes a Framework boot script table, interleaving independent segments.
+
+  Records of a segment run in order. When a segment waits on a stall or a poll
+  record, the lowest numbered segment that is ready runs in the meantime, so the
+  order of execution is deterministic for a given set of costs. The backend is only
+  asked to stall when every ready segment is waiting. Tables without valid segment
+  markers are executed in order as by BootScriptExecute().
+
+  @param  Table     A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that starts the table.
+  @param  Backend   The hardware access services.
+  @param  Profile   An optional pointer that receives the execution profile.
+
+  @retval RETURN_SUCCESS            The table was executed.
+  @retval RETURN_INVALID_PARAMETER  Table or Backend is NULL.
+  @retval RETURN_UNSUPPORTED        The table is malformed or contains an unknown opcode.
+  @retval RETURN_TIMEOUT            A poll condition was not met within its loop count.
+  @retval Others                    The status returned by the backend.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptExecuteSegmented (
+  IN  CONST VOID               *Table,
+  IN  BOOT_SCRIPT_BACKEND      *Backend,
+  OUT BOOT_SCRIPT_PROFILE      *Profile  OPTIONAL
+  )
+{
+  RETURN_STATUS                Status;
+  BOOT_SCRIPT_SEGMENT_CONTEXT  Context;
+  BOOT_SCRIPT_SEGMENT          *Segment;
+  UINT64                       Earliest;
+  UINT64                       Cost;
+  UINT32                       Index;
+  UINT32                       Selected;
+
+  if (Table == NULL || Backend == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (!InternalBootScriptIsValidTable (Table)) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  ZeroMem (&Context, sizeof (Context));
+  Context.Table   = Table;
+  Context.Backend = Backend;
+  Context.Profile = Profile;
+  if (!InternalBootScriptParseSegments (&Context)) {
+    return BootScriptExecute (Table, Backend, Profile);
+  }
+
+  if (Profile != NULL) {
+    ZeroMem (Profile, sizeof (BOOT_SCRIPT_PROFILE));
+    Profile->SegmentCount = Context.Count;
+  }
+
+  while (Context.DoneMask != (UINT32) (LShiftU64 (1, Context.Count) - 1)) {
+    //
+    // Pick the lowest numbered segment whose dependencies are done and which is not
+    // waiting. Track the earliest wake up time in case every segment is waiting. A
+    // segment is done once its last record, which may be a stall, has completed.
+    //
+    Selected = BOOT_SCRIPT_MAX_SEGMENTS;
+    Earliest = MAX_UINT64;
+    for (Index = 0; Index < Context.Count; Index++) {
+      Segment = &Context.Segment[Index];
+      if ((Context.DoneMask & (1u << Index)) != 0 ||
+          (Segment->DependencyMask & Context.DoneMask) != Segment->DependencyMask) {
+        continue;
+      }
+      if (Segment->ReadyTime > Context.Now) {
+        Earliest = MIN (Earliest, Segment->ReadyTime);
+        continue;
+      }
+      if (Segment->Offset == Segment->End) {
+        Context.DoneMask |= 1u << Index;
+        continue;
+      }
+      Selected = Index;
+      break;
+    }
+
+    if (Selected == BOOT_SCRIPT_MAX_SEGMENTS) {
+      if (Earliest == MAX_UINT64) {
+        //
+        // Segments completed during the scan and may have released others.
+        //
+        continue;
+      }
+      Backend->Stall (Backend, DivU64x32 (Earliest - Context.Now + 999, 1000), &Cost);
+      Context.Now = MAX (Context.Now + Cost, Earliest);
+      continue;
+    }
+
+    Segment = &Context.Segment[Selected];
+    Status  = InternalBootScriptStepSegment (&Context, Segment);
+    if (RETURN_ERROR (Status)) {
+      DEBUG ((
+        DEBUG_ERROR,
+        "BootScriptExecuteSegmented: segment %d, opcode 0x%x at offset 0x%x - %r\n",
+        Selected,
+        ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) (Context.Table + Segment->Offset))->OpCode,
+        Segment->Offset,
+        Status
+        ));
+      return Status;
+    }
+  }
+
+  if (Profile != NULL) {
+    Profile->TotalCost = Context.Now;
+    InternalBootScriptSegmentCriticalPath (&Context, Profile);
+  }
+
+  return RETURN_SUCCESS;
+}
@@ -0,0 +1,235 @@
+/** @file
+  Validation of Framework boot script tables.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "BootScriptInterpreterInternal.h"
+
+/**
+  Returns the size, in bytes, of one unit of a boot script width.
+
+  @param  Width   The EFI_BOOT_SCRIPT_WIDTH value.
+
+  @return The size of one unit in bytes.
+
+**/
+UINTN
+EFIAPI
+BootScriptGetWidthSize (
+  IN UINT32  Width
+  )
+{
+  return (UINTN) 1 << (Width & 0x03);
+}
+
+/**
+  Returns the size of the fixed part of a boot script record.
+
+  @param  OpCode  The boot script opcode.
+
+  @return The size of the fixed part of the record in bytes, or 0 if the opcode is
+          unknown.
+
+**/
+UINTN
+EFIAPI
+BootScriptGetFixedLength (
+  IN UINT16  OpCode
+  )
+{
+  switch (OpCode) {
+  case EFI_BOOT_SCRIPT_IO_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE);
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE);
+  case EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE);
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE);
+  case EFI_BOOT_SCRIPT_SMBUS_EXECUTE_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE);
+  case EFI_BOOT_SCRIPT_STALL_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_STALL);
+  case EFI_BOOT_SCRIPT_DISPATCH_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH);
+  case FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_DISPATCH_2);
+  case FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL);
+  case EFI_BOOT_SCRIPT_INFORMATION_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION);
+  case FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE:
+    return sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE);
+  default:
+    return 0;
+  }
+}
+
+/**
+  Validates one record of a boot script table.
+
+  @param  Record      A pointer to the record.
+  @param  Remaining   The number of bytes from Record to the end of the table.
+
+  @retval RETURN_SUCCESS            The record is well formed and fits in the table.
+  @retval RETURN_INVALID_PARAMETER  Record is NULL.
+  @retval RETURN_UNSUPPORTED        The record is malformed or has an unknown opcode.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptValidateRecord (
+  IN CONST VOID  *Record,
+  IN UINTN       Remaining
+  )
+{
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER  *Header;
+  UINTN                                          FixedLength;
+  UINT64                                         ExpectedLength;
+  UINT32                                         Width;
+
+  if (Record == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  //
+  // Only the common header is known to be in the table until its Length has been
+  // checked against Remaining, and the fields of the fixed part of the record are
+  // only read once Length has been checked against the size of that part.
+  //
+  if (Remaining < sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER)) {
+    return RETURN_UNSUPPORTED;
+  }
+  Header = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record;
+  if (Header->Length > Remaining) {
+    return RETURN_UNSUPPORTED;
+  }
+  FixedLength = BootScriptGetFixedLength (Header->OpCode);
+  if (FixedLength == 0 || Header->Length < FixedLength) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  ExpectedLength = FixedLength;
+  Width          = EfiBootScriptWidthUint8;
+
+  switch (Header->OpCode) {
+  case EFI_BOOT_SCRIPT_IO_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+    Width           = ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Record)->Width;
+    ExpectedLength += (UINT64) ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Record)->Count * BootScriptGetWidthSize (Width);
+    break;
+
+  case EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE:
+    Width = ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Record)->Width;
+    break;
+
+  case FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL_OPCODE:
+    Width = ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_MEM_POLL *) Record)->Width;
+    break;
+
+  case EFI_BOOT_SCRIPT_SMBUS_EXECUTE_OPCODE:
+    ExpectedLength += ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_SMBUS_EXECUTE *) Record)->DataSize;
+    break;
+
+  case EFI_BOOT_SCRIPT_INFORMATION_OPCODE:
+    ExpectedLength += ((CONST FRAMEWORK_EFI_BOOT_SCRIPT_INFORMATION *) Record)->InformationLength;
+    break;
+
+  default:
+    break;
+  }
+
+  if (Width >= EfiBootScriptWidthMaximum || ExpectedLength != Header->Length) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Validates a whole boot script table.
+
+  @param  Table   A pointer to the table header.
+
+  @retval TRUE    The table is well formed.
+  @retval FALSE   The table is malformed.
+
+**/
+BOOLEAN
+InternalBootScriptIsValidTable (
+  IN CONST UINT8  *Table
+  )
+{
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER   *TableHeader;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER  *Header;
+  UINTN                                          Offset;
+
+  TableHeader = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER *) Table;
+  if (TableHeader->OpCode != FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_OPCODE ||
+      TableHeader->Length != sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER) ||
+      TableHeader->TableLength < sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER) + sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE)) {
+    return FALSE;
+  }
+
+  Offset = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER);
+  while (Offset < TableHeader->TableLength) {
+    if (RETURN_ERROR (BootScriptValidateRecord (Table + Offset, TableHeader->TableLength - Offset))) {
+      return FALSE;
+    }
+    Header  = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) (Table + Offset);
+    Offset += Header->Length;
+    if (Header->OpCode == FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE) {
+      //
+      // The terminate record must be the last record of the table.
+      //
+      return (BOOLEAN) (Offset == TableHeader->TableLength);
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Validates a Framework boot script table.
+
+  @param  Table   A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that starts the table.
+
+  @retval RETURN_SUCCESS            The table is well formed.
+  @retval RETURN_INVALID_PARAMETER  Table is NULL.
+  @retval RETURN_UNSUPPORTED        The table is malformed or contains an unknown opcode.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptValidateTable (
+  IN CONST VOID  *Table
+  )
+{
+  if (Table == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (!InternalBootScriptIsValidTable (Table)) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  return RETURN_SUCCESS;
+}
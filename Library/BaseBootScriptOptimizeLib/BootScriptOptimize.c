@@ -0,0 +1,635 @@
+/** @file
+  Implementation of the boot script optimization library.
+
+  The optimizer walks the boot script table once with a read cursor and a write
+  cursor. Because every transformation only removes bytes, the write cursor never
+  passes the read cursor and the table can be rewritten in place.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <PiDxe.h>
+
+#include <Framework/BootScript.h>
+
+#include <Library/BootScriptOptimizeLib.h>
+#include <Library/BootScriptInterpreterLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+//
+// Address spaces tracked for dead write elimination.
+//
+#define BOOT_SCRIPT_SPACE_IO      0
+#define BOOT_SCRIPT_SPACE_MEM     1
+#define BOOT_SCRIPT_SPACE_PCI     2
+#define BOOT_SCRIPT_SPACE_COUNT   3
+#define BOOT_SCRIPT_SPACE_NONE    BOOT_SCRIPT_SPACE_COUNT
+
+///
+/// State of one optimization pass.
+///
+typedef struct {
+  ///
+  /// The next byte of the table to be produced.
+  ///
+  UINT8                                 *Write;
+  ///
+  /// The last record produced, or NULL if it was removed.
+  ///
+  UINT8                                 *Last;
+  ///
+  /// For each address space, the last record produced since the last barrier if
+  /// that record is a write that may still be superseded, otherwise NULL. A write
+  /// to one address space can enable or redirect the decode of another, such as
+  /// a PCI configuration write to a BAR or to the command register, so every write
+  /// clears the entries of the other address spaces.
+  ///
+  UINT8                                 *LastInSpace[BOOT_SCRIPT_SPACE_COUNT];
+  ///
+  /// The memory ranges declared to be plain RAM by the caller.
+  ///
+  CONST BOOT_SCRIPT_OPTIMIZE_RAM_RANGE  *RamRanges;
+  UINTN                                 RamRangeCount;
+  BOOT_SCRIPT_OPTIMIZE_STATISTICS       Statistics;
+} BOOT_SCRIPT_OPTIMIZER;
+
+/**
+  Returns the address space accessed by a write or read-modify-write opcode.
+
+  @param  OpCode  The boot script opcode.
+
+  @return The address space, or BOOT_SCRIPT_SPACE_NONE if the opcode neither
+          writes nor reads-modifies-writes a register.
+
+**/
+UINTN
+InternalBootScriptGetSpace (
+  IN UINT16  OpCode
+  )
+{
+  switch (OpCode) {
+  case EFI_BOOT_SCRIPT_IO_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE:
+    return BOOT_SCRIPT_SPACE_IO;
+
+  case EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE:
+    return BOOT_SCRIPT_SPACE_MEM;
+
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE:
+    return BOOT_SCRIPT_SPACE_PCI;
+
+  default:
+    return BOOT_SCRIPT_SPACE_NONE;
+  }
+}
+
+/**
+  Checks whether an opcode is one of the write opcodes.
+
+  @param  OpCode  The boot script opcode.
+
+  @retval TRUE    The opcode writes Count units of data.
+  @retval FALSE   The opcode is not a write.
+
+**/
+BOOLEAN
+InternalBootScriptIsWrite (
+  IN UINT16  OpCode
+  )
+{
+  return (BOOLEAN) (OpCode == EFI_BOOT_SCRIPT_IO_WRITE_OPCODE ||
+                    OpCode == EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE ||
+                    OpCode == EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE ||
+                    OpCode == EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE);
+}
+
+/**
+  Returns the write opcode that matches a read-modify-write opcode.
+
+  @param  OpCode  The read-modify-write opcode.
+
+  @return The write opcode of the same address space.
+
+**/
+UINT16
+InternalBootScriptGetWriteOpCode (
+  IN UINT16  OpCode
+  )
+{
+  switch (OpCode) {
+  case EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE:
+    return EFI_BOOT_SCRIPT_IO_WRITE_OPCODE;
+  case EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE:
+    return EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE;
+  case EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE:
+    return EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE;
+  default:
+    ASSERT (OpCode == EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE);
+    return EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE;
+  }
+}
+
+/**
+  Validates a whole boot script table and counts its records.
+
+  @param  Table         A pointer to the table header.
+  @param  RecordCount   Returns the number of records including the header and the
+                        terminate record.
+
+  @retval TRUE          The table is well formed.
+  @retval FALSE         The table is malformed.
+
+**/
+BOOLEAN
+InternalBootScriptOptimizeIsValidTable (
+  IN  CONST UINT8  *Table,
+  OUT UINTN        *RecordCount
+  )
+{
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER   *TableHeader;
+  CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER  *Header;
+  UINTN                                          Offset;
+
+  TableHeader = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER *) Table;
+  if (TableHeader->OpCode != FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_OPCODE ||
+      TableHeader->Length != sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER) ||
+      TableHeader->TableLength < sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER) + sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE)) {
+    return FALSE;
+  }
+
+  *RecordCount = 1;
+  Offset       = sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER);
+  while (Offset < TableHeader->TableLength) {
+    if (RETURN_ERROR (BootScriptValidateRecord (Table + Offset, TableHeader->TableLength - Offset))) {
+      return FALSE;
+    }
+    Header = (CONST FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) (Table + Offset);
+    Offset += Header->Length;
+    (*RecordCount)++;
+    if (Header->OpCode == FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE) {
+      //
+      // The terminate record must be the last record of the table.
+      //
+      return (BOOLEAN) (Offset == TableHeader->TableLength);
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Returns the PCI segment of a write or read-modify-write record.
+
+  @param  Record  A pointer to the record.
+
+  @return The PCI segment, or 0 for records that do not carry one.
+
+**/
+UINT16
+InternalBootScriptGetSegment (
+  IN CONST UINT8  *Record
+  )
+{
+  switch (((FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->OpCode) {
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE_OPCODE:
+    return ((FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_WRITE *) Record)->Segment;
+  case EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE_OPCODE:
+    return ((FRAMEWORK_EFI_BOOT_SCRIPT_PCI_CONFIG2_READ_WRITE *) Record)->Segment;
+  default:
+    return 0;
+  }
+}
+
+/**
+  Computes the address range written by a write record.
+
+  PCI configuration writes are only considered when they stay inside the 256 byte
+  register space of one function, so that address arithmetic never carries into the
+  function, device or bus fields.
+
+  @param  Write   A pointer to the write record.
+  @param  Extra   Additional units appended to the range.
+  @param  Start   Returns the first address written.
+  @param  End     Returns the address following the last unit written.
+
+  @retval TRUE    The range is well defined.
+  @retval FALSE   The record must not take part in range based optimizations.
+
+**/
+BOOLEAN
+InternalBootScriptGetWriteRange (
+  IN  CONST FRAMEWORK_EFI_BOOT_SCRIPT_WRITE  *Write,
+  IN  UINT32                                 Extra,
+  OUT UINT64                                 *Start,
+  OUT UINT64                                 *End
+  )
+{
+  UINT64  Size;
+
+  if (Write->Width > EfiBootScriptWidthUint64) {
+    //
+    // FIFO and fill widths do not write a contiguous address range.
+    //
+    return FALSE;
+  }
+
+  Size   = ((UINT64) Write->Count + Extra) * BootScriptGetWidthSize (Write->Width);
+  *Start = Write->Address;
+  if (*Start > MAX_UINT64 - Size) {
+    return FALSE;
+  }
+  *End = *Start + Size;
+
+  if (InternalBootScriptGetSpace (Write->OpCode) == BOOT_SCRIPT_SPACE_PCI) {
+    if ((*Start >> 32) != 0 || (*Start & 0xFF) + Size > 0x100) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Removes a record that was already produced from the output.
+
+  @param  Optimizer   The optimization state.
+  @param  Record      A pointer to the record to remove.
+
+**/
+VOID
+InternalBootScriptRemoveRecord (
+  IN OUT BOOT_SCRIPT_OPTIMIZER  *Optimizer,
+  IN     UINT8                  *Record
+  )
+{
+  UINTN  Length;
+  UINTN  Index;
+
+  Length = ((FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->Length;
+  CopyMem (Record, Record + Length, Optimizer->Write - (Record + Length));
+  Optimizer->Write -= Length;
+
+  for (Index = 0; Index < BOOT_SCRIPT_SPACE_COUNT; Index++) {
+    if (Optimizer->LastInSpace[Index] == Record) {
+      Optimizer->LastInSpace[Index] = NULL;
+    } else if (Optimizer->LastInSpace[Index] > Record) {
+      Optimizer->LastInSpace[Index] -= Length;
+    }
+  }
+
+  if (Optimizer->Last == Record) {
+    Optimizer->Last = NULL;
+  } else if (Optimizer->Last > Record) {
+    Optimizer->Last -= Length;
+  }
+}
+
+/**
+  Copies a record to the output.
+
+  @param  Optimizer   The optimization state.
+  @param  Record      A pointer to the record in the input.
+
+**/
+VOID
+InternalBootScriptEmitRecord (
+  IN OUT BOOT_SCRIPT_OPTIMIZER  *Optimizer,
+  IN     CONST UINT8            *Record
+  )
+{
+  UINTN  Length;
+
+  Length = ((FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->Length;
+  CopyMem (Optimizer->Write, Record, Length);
+  Optimizer->Last   = Optimizer->Write;
+  Optimizer->Write += Length;
+}
+
+/**
+  Forgets all writes that could still be superseded.
+
+  @param  Optimizer   The optimization state.
+
+**/
+VOID
+InternalBootScriptBarrier (
+  IN OUT BOOT_SCRIPT_OPTIMIZER  *Optimizer
+  )
+{
+  ZeroMem (Optimizer->LastInSpace, sizeof (Optimizer->LastInSpace));
+}
+
+/**
+  Processes a write record.
+
+  @param  Optimizer   The optimization state.
+  @param  Record      A pointer to the write record in the input.
+
+**/
+VOID
+InternalBootScriptOptimizeWrite (
+  IN OUT BOOT_SCRIPT_OPTIMIZER  *Optimizer,
+  IN     UINT8                  *Record
+  )
+{
+  FRAMEWORK_EFI_BOOT_SCRIPT_WRITE  *Write;
+  FRAMEWORK_EFI_BOOT_SCRIPT_WRITE  *Previous;
+  UINTN                            Space;
+  UINT64                           Start;
+  UINT64                           End;
+  UINT64                           PreviousStart;
+  UINT64                           PreviousEnd;
+  UINT32                           Count;
+  UINTN                            DataSize;
+
+  Write = (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Record;
+  Space = InternalBootScriptGetSpace (Write->OpCode);
+
+  if (!InternalBootScriptGetWriteRange (Write, 0, &Start, &End)) {
+    //
+    // Writes without a well defined range are kept as is and hide earlier
+    // writes to the same address space.
+    //
+    InternalBootScriptEmitRecord (Optimizer, Record);
+    InternalBootScriptBarrier (Optimizer);
+    return;
+  }
+
+  //
+  // Drop the previous write to this address space if it is completely overwritten.
+  // It is only still recorded when no write to another address space came since.
+  //
+  Previous = (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Optimizer->LastInSpace[Space];
+  if (Previous != NULL &&
+      Previous->OpCode == Write->OpCode &&
+      Previous->Width == Write->Width &&
+      InternalBootScriptGetSegment ((UINT8 *) Previous) == InternalBootScriptGetSegment (Record) &&
+      InternalBootScriptGetWriteRange (Previous, 0, &PreviousStart, &PreviousEnd) &&
+      Start <= PreviousStart && PreviousEnd <= End) {
+    InternalBootScriptRemoveRecord (Optimizer, (UINT8 *) Previous);
+    Optimizer->Statistics.EliminatedWrites++;
+  }
+
+  //
+  // Append the data to the previous record if this write continues it.
+  //
+  Previous = (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Optimizer->Last;
+  Count    = Write->Count;
+  DataSize = Write->Length - BootScriptGetFixedLength (Write->OpCode);
+  if (Previous != NULL &&
+      Previous->OpCode == Write->OpCode &&
+      Previous->Width == Write->Width &&
+      Previous->Length + DataSize <= MAX_UINT8 &&
+      InternalBootScriptGetSegment ((UINT8 *) Previous) == InternalBootScriptGetSegment (Record) &&
+      InternalBootScriptGetWriteRange (Previous, 0, &PreviousStart, &PreviousEnd) &&
+      PreviousEnd == Start &&
+      InternalBootScriptGetWriteRange (Previous, Count, &PreviousStart, &PreviousEnd)) {
+    //
+    // The record header in the input may be overwritten by the copy, so Count
+    // and DataSize were captured above.
+    //
+    CopyMem (Optimizer->Write, Record + BootScriptGetFixedLength (Write->OpCode), DataSize);
+    Previous->Count  += Count;
+    Previous->Length  = (UINT8) (Previous->Length + DataSize);
+    Optimizer->Write += DataSize;
+    InternalBootScriptBarrier (Optimizer);
+    Optimizer->LastInSpace[Space] = (UINT8 *) Previous;
+    Optimizer->Statistics.CoalescedWrites++;
+    return;
+  }
+
+  InternalBootScriptEmitRecord (Optimizer, Record);
+  InternalBootScriptBarrier (Optimizer);
+  Optimizer->LastInSpace[Space] = Optimizer->Last;
+}
+
+/**
+  Checks whether an access is within the memory declared to be plain RAM.
+
+  @param  Optimizer   The optimization state.
+  @param  Address     The address of the access.
+  @param  Size        The size of the access in bytes.
+
+  @retval TRUE        The access is within one of the RAM ranges.
+  @retval FALSE       The access may reach a register.
+
+**/
+BOOLEAN
+InternalBootScriptIsRam (
+  IN BOOT_SCRIPT_OPTIMIZER  *Optimizer,
+  IN UINT64                 Address,
+  IN UINTN                  Size
+  )
+{
+  CONST BOOT_SCRIPT_OPTIMIZE_RAM_RANGE  *Range;
+  UINTN                                 Index;
+
+  for (Index = 0; Index < Optimizer->RamRangeCount; Index++) {
+    Range = &Optimizer->RamRanges[Index];
+    if (Address >= Range->Base && Range->Length >= Size &&
+        Address - Range->Base <= Range->Length - Size) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Processes a read-modify-write record.
+
+  @param  Optimizer   The optimization state.
+  @param  Record      A pointer to the read-modify-write record in the input.
+
+**/
+VOID
+InternalBootScriptOptimizeReadWrite (
+  IN OUT BOOT_SCRIPT_OPTIMIZER  *Optimizer,
+  IN     UINT8                  *Record
+  )
+{
+  FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE  *ReadWrite;
+  FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE  *PreviousReadWrite;
+  FRAMEWORK_EFI_BOOT_SCRIPT_WRITE       *PreviousWrite;
+  UINT8                                 *Data;
+  UINT64                                Value;
+  UINTN                                 WidthSize;
+
+  ReadWrite = (FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Record;
+  WidthSize = BootScriptGetWidthSize (ReadWrite->Width);
+
+  //
+  // The folds assume that the location reads back the value last written to it,
+  // which only holds for plain RAM. I/O, PCI configuration and memory mapped I/O
+  // registers may have write-1-to-clear, read-only or self-clearing bits, so only
+  // the memory the caller declared to be RAM is folded.
+  //
+  if (Optimizer->Last != NULL && ReadWrite->Width <= EfiBootScriptWidthUint64 &&
+      ReadWrite->OpCode == EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE &&
+      InternalBootScriptIsRam (Optimizer, ReadWrite->Address, WidthSize)) {
+    //
+    // ((V & M1) | D1) & M2 | D2 == (V & (M1 & M2)) | ((D1 & M2) | D2)
+    //
+    PreviousReadWrite = (FRAMEWORK_EFI_BOOT_SCRIPT_READ_WRITE *) Optimizer->Last;
+    if (PreviousReadWrite->OpCode == ReadWrite->OpCode &&
+        PreviousReadWrite->Width == ReadWrite->Width &&
+        PreviousReadWrite->Address == ReadWrite->Address) {
+      PreviousReadWrite->Data      = (PreviousReadWrite->Data & ReadWrite->DataMask) | ReadWrite->Data;
+      PreviousReadWrite->DataMask &= ReadWrite->DataMask;
+      Optimizer->Statistics.FoldedReadWrites++;
+      return;
+    }
+
+    //
+    // A read-modify-write of a register that was just written with a known value
+    // becomes a write of the modified value.
+    //
+    PreviousWrite = (FRAMEWORK_EFI_BOOT_SCRIPT_WRITE *) Optimizer->Last;
+    if (PreviousWrite->OpCode == InternalBootScriptGetWriteOpCode (ReadWrite->OpCode) &&
+        PreviousWrite->Width == ReadWrite->Width &&
+        PreviousWrite->Count == 1 &&
+        PreviousWrite->Address == ReadWrite->Address) {
+      Data  = Optimizer->Last + BootScriptGetFixedLength (PreviousWrite->OpCode);
+      Value = 0;
+      CopyMem (&Value, Data, WidthSize);
+      Value = (Value & ReadWrite->DataMask) | ReadWrite->Data;
+      CopyMem (Data, &Value, WidthSize);
+      Optimizer->Statistics.FoldedReadWrites++;
+      return;
+    }
+  }
+
+  //
+  // The read of the register is a barrier for all address spaces.
+  //
+  InternalBootScriptEmitRecord (Optimizer, Record);
+  InternalBootScriptBarrier (Optimizer);
+}
+
+/**
+  Optimizes a Framework boot script table in place.
+
+  The table is first validated as a whole and is left untouched if it is malformed.
+  The following transformations are then applied in a single forward pass. None of
+  them moves a record across a barrier, where a barrier is any record that reads
+  hardware, stalls, polls, dispatches code, executes an SMBus operation or carries
+  information, so information records can be used as markers that the optimizer
+  preserves.
+
+  1. A write is merged into the immediately preceding write when both have the same
+     opcode, the same non-FIFO, non-fill width and the second one starts right
+     after the last unit of the first one.
+  2. A write is dropped when the next write, to any address space, is a write
+     with the same opcode and width that covers every unit written by the first
+     one. A write to another address space in between, such as a PCI
+     configuration write that enables a decode, keeps the first write.
+  3. A memory read-modify-write of an address in one of RamRanges is folded into
+     the immediately preceding memory read-modify-write or single unit memory
+     write of the same address. Other read-modify-writes, such as those of I/O,
+     PCI configuration or memory mapped I/O registers, are never folded, because
+     their registers may have write-1-to-clear, read-only or self-clearing bits
+     and need not read back what was written.
+
+  The table only ever shrinks, so TableLength in the table header is updated and no
+  memory is allocated.
+
+  @param  Table         A pointer to the FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER that
+                        starts the boot script table.
+  @param  RamRanges     An optional array of the memory ranges that the caller
+                        declares to be plain RAM, which reads back the last value
+                        written to it. Read-modify-writes are only folded within
+                        them.
+  @param  RamRangeCount The number of entries in RamRanges.
+  @param  Statistics    An optional pointer that receives the optimization statistics.
+
+  @retval RETURN_SUCCESS            The table was optimized.
+  @retval RETURN_INVALID_PARAMETER  Table is NULL, or RamRanges is NULL while
+                                    RamRangeCount is not 0.
+  @retval RETURN_UNSUPPORTED        The table is malformed or contains an unknown opcode.
+
+**/
+RETURN_STATUS
+EFIAPI
+BootScriptOptimize (
+  IN OUT VOID                                  *Table,
+  IN     CONST BOOT_SCRIPT_OPTIMIZE_RAM_RANGE  *RamRanges  OPTIONAL,
+  IN     UINTN                                 RamRangeCount,
+  OUT    BOOT_SCRIPT_OPTIMIZE_STATISTICS       *Statistics  OPTIONAL
+  )
+{
+  FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER  *TableHeader;
+  BOOT_SCRIPT_OPTIMIZER                   Optimizer;
+  UINT8                                   *Read;
+  UINT8                                   *Record;
+  UINT16                                  OpCode;
+  UINTN                                   RecordCount;
+
+  if (Table == NULL || (RamRanges == NULL && RamRangeCount != 0)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (!InternalBootScriptOptimizeIsValidTable (Table, &RecordCount)) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  TableHeader = (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER *) Table;
+  ZeroMem (&Optimizer, sizeof (Optimizer));
+  Optimizer.RamRanges     = RamRanges;
+  Optimizer.RamRangeCount = RamRangeCount;
+  Optimizer.Statistics.RecordsBefore = RecordCount;
+  Optimizer.Statistics.LengthBefore  = TableHeader->TableLength;
+
+  Read            = (UINT8 *) Table + sizeof (FRAMEWORK_EFI_BOOT_SCRIPT_TABLE_HEADER);
+  Optimizer.Write = Read;
+
+  do {
+    Record = Read;
+    OpCode = ((FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->OpCode;
+    Read  += ((FRAMEWORK_EFI_BOOT_SCRIPT_COMMON_HEADER *) Record)->Length;
+
+    if (InternalBootScriptIsWrite (OpCode)) {
+      InternalBootScriptOptimizeWrite (&Optimizer, Record);
+    } else if (InternalBootScriptGetSpace (OpCode) != BOOT_SCRIPT_SPACE_NONE) {
+      InternalBootScriptOptimizeReadWrite (&Optimizer, Record);
+    } else {
+      InternalBootScriptEmitRecord (&Optimizer, Record);
+      InternalBootScriptBarrier (&Optimizer);
+    }
+  } while (OpCode != FRAMEWORK_EFI_BOOT_SCRIPT_TERMINATE_OPCODE);
+
+  TableHeader->TableLength = (UINT32) (Optimizer.Write - (UINT8 *) Table);
+
+  Optimizer.Statistics.LengthAfter  = TableHeader->TableLength;
+  Optimizer.Statistics.RecordsAfter = RecordCount -
+                                      Optimizer.Statistics.CoalescedWrites -
+                                      Optimizer.Statistics.EliminatedWrites -
+                                      Optimizer.Statistics.FoldedReadWrites;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "BootScriptOptimize: %d -> %d records, %d -> %d bytes\n",
+    (UINT32) Optimizer.Statistics.RecordsBefore,
+    (UINT32) Optimizer.Statistics.RecordsAfter,
+    (UINT32) Optimizer.Statistics.LengthBefore,
+    (UINT32) Optimizer.Statistics.LengthAfter
+    ));
+
+  if (Statistics != NULL) {
+    CopyMem (Statistics, &Optimizer.Statistics, sizeof (BOOT_SCRIPT_OPTIMIZE_STATISTICS));
+  }
+
+  return RETURN_SUCCESS;
+}
@@ -0,0 +1,588 @@
+/** @file
+  Validation of the descriptor chain and choice of the relocation plan of the
+  capsule coalescing library.
+
+  The chain is walked without allocating any memory: the plan is stored in a free
+  gap of the memory range, which is found by testing the edges of the ranges used
+  by the chain. The image is then placed in another free gap if there is one, and
+  otherwise over the data blocks, at the place that needs the fewest bytes to be
+  moved out of the way. A verifying coalescing checks the capsule headers once the
+  plan is filled, before the image is placed.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "CapsuleCoalesceInternal.h"
+
+/**
+  Validates a descriptor chain in one pass.
+
+  Every descriptor must be 8-byte aligned, carry the CBDS signature, and sum to 0
+  as an array of UINT32 values. A descriptor with a Length of 0 continues the chain
+  at Data, or ends it if Data is 0. The data blocks must not wrap around the
+  address space.
+
+  @param  BlockList         The first descriptor of the chain.
+  @param  BlockCount        Returns the number of data blocks. Optional.
+  @param  DescriptorCount   Returns the number of descriptors. Optional.
+  @param  DataSize          Returns the total size of the data blocks. Optional.
+
+  @retval EFI_SUCCESS             The chain is valid.
+  @retval EFI_INVALID_PARAMETER   BlockList is NULL.
+  @retval EFI_NOT_FOUND           The chain holds no data.
+  @retval EFI_VOLUME_CORRUPTED    A descriptor is not valid, or the chain is longer than
+                                  CAPSULE_COALESCE_MAX_DESCRIPTORS.
+
+**/
+EFI_STATUS
+EFIAPI
+CapsuleCoalesceValidate (
+  IN  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  OUT UINTN                                         *BlockCount       OPTIONAL,
+  OUT UINTN                                         *DescriptorCount  OPTIONAL,
+  OUT UINT64                                        *DataSize         OPTIONAL
+  )
+{
+  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *Descriptor;
+  UINTN                                         Blocks;
+  UINTN                                         Descriptors;
+  UINT64                                        Size;
+
+  if (BlockList == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Blocks      = 0;
+  Descriptors = 0;
+  Size        = 0;
+  Descriptor  = BlockList;
+  while (TRUE) {
+    if (((UINTN) Descriptor & (CAPSULE_COALESCE_ALIGNMENT - 1)) != 0 ||
+        ++Descriptors > CAPSULE_COALESCE_MAX_DESCRIPTORS ||
+        Descriptor->Signature != CAPSULE_BLOCK_DESCRIPTOR_SIGNATURE ||
+        CalculateSum32 ((CONST UINT32 *) Descriptor, sizeof (*Descriptor)) != 0) {
+      DEBUG ((DEBUG_ERROR, "CapsuleCoalesce: descriptor 0x%p is not valid\n", Descriptor));
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (Descriptor->Length == 0) {
+      if (Descriptor->Data == 0) {
+        break;
+      }
+      if (Descriptor->Data > MAX_ADDRESS - sizeof (*Descriptor)) {
+        return EFI_VOLUME_CORRUPTED;
+      }
+      Descriptor = (CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR *) (UINTN) Descriptor->Data;
+      continue;
+    }
+
+    if (Descriptor->Data > MAX_ADDRESS || Descriptor->Length - 1 > MAX_ADDRESS - Descriptor->Data ||
+        Descriptor->Length > MAX_UINTN - Size) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+    Size += Descriptor->Length;
+    Blocks++;
+    Descriptor++;
+  }
+
+  if (Blocks == 0) {
+    return EFI_NOT_FOUND;
+  }
+  if (BlockCount != NULL) {
+    *BlockCount = Blocks;
+  }
+  if (DescriptorCount != NULL) {
+    *DescriptorCount = Descriptors;
+  }
+  if (DataSize != NULL) {
+    *DataSize = Size;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the next memory range used by a validated descriptor chain: a data
+  block, or a descriptor array once its last descriptor is reached.
+
+  @param  Cursor    The position in the chain, which starts with both fields set
+                    to the first descriptor.
+  @param  Base      Returns the base of the range.
+  @param  Length    Returns the length of the range.
+
+  @retval TRUE    A data block was returned.
+  @retval FALSE   A descriptor array was returned, or the chain has ended if the
+                  Length is 0.
+
+**/
+BOOLEAN
+InternalCapsuleChainNext (
+  IN OUT CAPSULE_CHAIN_CURSOR  *Cursor,
+  OUT    UINTN                 *Base,
+  OUT    UINTN                 *Length
+  )
+{
+  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *Descriptor;
+
+  Descriptor = Cursor->Descriptor;
+  if (Descriptor == NULL) {
+    *Base   = 0;
+    *Length = 0;
+    return FALSE;
+  }
+
+  if (Descriptor->Length != 0) {
+    *Base   = (UINTN) Descriptor->Data;
+    *Length = (UINTN) Descriptor->Length;
+    Cursor->Descriptor++;
+    return TRUE;
+  }
+
+  *Base   = (UINTN) Cursor->Array;
+  *Length = (UINTN) (Descriptor + 1) - (UINTN) Cursor->Array;
+  if (Descriptor->Data == 0) {
+    Cursor->Descriptor = NULL;
+  } else {
+    Cursor->Descriptor = (CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR *) (UINTN) Descriptor->Data;
+    Cursor->Array      = Cursor->Descriptor;
+  }
+  return FALSE;
+}
+
+/**
+  Checks whether two ranges overlap.
+
+  @param  Base1     The base of the first range.
+  @param  Length1   The length of the first range.
+  @param  Base2     The base of the second range.
+  @param  Length2   The length of the second range.
+
+  @retval TRUE    The ranges overlap.
+  @retval FALSE   The ranges do not overlap.
+
+**/
+BOOLEAN
+InternalCapsuleOverlaps (
+  IN UINTN  Base1,
+  IN UINTN  Length1,
+  IN UINTN  Base2,
+  IN UINTN  Length2
+  )
+{
+  if (Length1 == 0 || Length2 == 0) {
+    return FALSE;
+  }
+  return (BOOLEAN) (Base1 - Base2 < Length2 || Base2 - Base1 < Length1);
+}
+
+/**
+  Checks whether a range of the memory range is free of the chain and of an
+  excluded range.
+
+  @param  BlockList       The first descriptor of the chain.
+  @param  MemoryBase      The base of the memory range.
+  @param  MemoryEnd       The end of the memory range.
+  @param  Base            The base of the range.
+  @param  Length          The length of the range.
+  @param  ExcludeBase     The base of the excluded range.
+  @param  ExcludeLength   The length of the excluded range, which may be 0.
+
+  @retval TRUE    The range is free.
+  @retval FALSE   The range is not free.
+
+**/
+BOOLEAN
+InternalCapsuleIsFree (
+  IN CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  IN UINTN                                         MemoryBase,
+  IN UINTN                                         MemoryEnd,
+  IN UINTN                                         Base,
+  IN UINTN                                         Length,
+  IN UINTN                                         ExcludeBase,
+  IN UINTN                                         ExcludeLength
+  )
+{
+  CAPSULE_CHAIN_CURSOR  Cursor;
+  UINTN                 RangeBase;
+  UINTN                 RangeLength;
+
+  if (Base < MemoryBase || Base > MemoryEnd || Length > MemoryEnd - Base ||
+      InternalCapsuleOverlaps (Base, Length, ExcludeBase, ExcludeLength)) {
+    return FALSE;
+  }
+
+  Cursor.Descriptor = BlockList;
+  Cursor.Array      = BlockList;
+  while (InternalCapsuleChainNext (&Cursor, &RangeBase, &RangeLength) || RangeLength != 0) {
+    if (InternalCapsuleOverlaps (Base, Length, RangeBase, RangeLength)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+  Finds a free gap of the memory range, as high as possible.
+
+  The candidates are the top of the memory range and the edges of the ranges used
+  by the chain and of the excluded range.
+
+  @param  BlockList       The first descriptor of the chain.
+  @param  MemoryBase      The base of the memory range.
+  @param  MemoryEnd       The end of the memory range.
+  @param  Length          The length of the gap.
+  @param  ExcludeBase     The base of the excluded range.
+  @param  ExcludeLength   The length of the excluded range, which may be 0.
+  @param  Base            Returns the base of the gap, which is 8-byte aligned.
+
+  @retval TRUE    A gap was found.
+  @retval FALSE   There is no free gap of the length.
+
+**/
+BOOLEAN
+InternalCapsuleFindGap (
+  IN  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  IN  UINTN                                         MemoryBase,
+  IN  UINTN                                         MemoryEnd,
+  IN  UINTN                                         Length,
+  IN  UINTN                                         ExcludeBase,
+  IN  UINTN                                         ExcludeLength,
+  OUT UINTN                                         *Base
+  )
+{
+  CAPSULE_CHAIN_CURSOR  Cursor;
+  UINTN                 RangeBase;
+  UINTN                 RangeLength;
+  UINTN                 Candidate[2];
+  UINTN                 Index;
+  BOOLEAN               Last;
+
+  if (Length > MemoryEnd - MemoryBase) {
+    return FALSE;
+  }
+
+  Candidate[0] = (MemoryEnd - Length) & ~(UINTN) (CAPSULE_COALESCE_ALIGNMENT - 1);
+  Candidate[1] = ALIGN_VALUE (MemoryBase, CAPSULE_COALESCE_ALIGNMENT);
+  for (Index = 0; Index < 2; Index++) {
+    if (InternalCapsuleIsFree (BlockList, MemoryBase, MemoryEnd, Candidate[Index], Length, ExcludeBase, ExcludeLength)) {
+      *Base = Candidate[Index];
+      return TRUE;
+    }
+  }
+
+  //
+  // The excluded range is tested as the last range of the chain.
+  //
+  Cursor.Descriptor = BlockList;
+  Cursor.Array      = BlockList;
+  Last              = FALSE;
+  while (!Last) {
+    if (!InternalCapsuleChainNext (&Cursor, &RangeBase, &RangeLength) && RangeLength == 0) {
+      RangeBase   = ExcludeBase;
+      RangeLength = ExcludeLength;
+      Last        = TRUE;
+      if (RangeLength == 0) {
+        break;
+      }
+    }
+
+    Candidate[0] = (RangeBase - Length) & ~(UINTN) (CAPSULE_COALESCE_ALIGNMENT - 1);
+    Candidate[1] = ALIGN_VALUE (RangeBase + RangeLength, CAPSULE_COALESCE_ALIGNMENT);
+    for (Index = 0; Index < 2; Index++) {
+      if ((Index == 0 && RangeBase < Length) || (Index == 1 && Candidate[1] < RangeBase)) {
+        continue;
+      }
+      if (InternalCapsuleIsFree (BlockList, MemoryBase, MemoryEnd, Candidate[Index], Length, ExcludeBase, ExcludeLength)) {
+        *Base = Candidate[Index];
+        return TRUE;
+      }
+    }
+  }
+  return FALSE;
+}
+
+/**
+  Coalesces the data blocks of a descriptor chain into one image, and optionally
+  verifies the image while it is built.
+
+  @param  BlockList     The first descriptor of the chain.
+  @param  MemoryBase    The base of the memory range.
+  @param  MemorySize    The size of the memory range.
+  @param  Verify        Check the capsule headers before moving any block, and sum
+                        the image while it is copied.
+  @param  Image         Returns the image.
+  @param  ImageSize     Returns the size of the image.
+  @param  Checksum      Returns the checksum of the image if Verify is TRUE.
+  @param  Statistics    Returns the counters of the coalescing. Optional.
+
+  @retval EFI_SUCCESS             The image was built.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_FOUND           The chain holds no data.
+  @retval EFI_VOLUME_CORRUPTED    The chain is not valid, data blocks overlap, or a
+                                  capsule header is not valid.
+  @retval EFI_BUFFER_TOO_SMALL    The memory range cannot hold the image and the plan.
+  @retval EFI_OUT_OF_RESOURCES    The memory range has too little free memory to move
+                                  the blocks out of the way of the image.
+
+**/
+EFI_STATUS
+InternalCapsuleCoalesce (
+  IN  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  IN  VOID                                          *MemoryBase,
+  IN  UINTN                                         MemorySize,
+  IN  BOOLEAN                                       Verify,
+  OUT VOID                                          **Image,
+  OUT UINTN                                         *ImageSize,
+  OUT UINT32                                        *Checksum,
+  OUT CAPSULE_COALESCE_STATISTICS                   *Statistics  OPTIONAL
+  )
+{
+  EFI_STATUS            Status;
+  CAPSULE_PLAN          Plan;
+  CAPSULE_CHAIN_CURSOR  Cursor;
+  CAPSULE_PLAN_ENTRY    *Entry;
+  UINTN                 BlockCount;
+  UINTN                 DescriptorCount;
+  UINT64                DataSize;
+  UINTN                 Base;
+  UINTN                 Length;
+  UINTN                 Offset;
+  UINTN                 Candidate[3];
+  UINTN                 Index;
+  UINTN                 BestBase;
+  UINTN                 BestEvacuated;
+  BOOLEAN               InPlace;
+
+  if (BlockList == NULL || MemoryBase == NULL || Image == NULL || ImageSize == NULL ||
+      MemorySize > MAX_UINTN - (UINTN) MemoryBase) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = CapsuleCoalesceValidate (BlockList, &BlockCount, &DescriptorCount, &DataSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (DataSize > MemorySize) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  ZeroMem (&Plan, sizeof (Plan));
+  Plan.MemoryBase   = (UINTN) MemoryBase;
+  Plan.MemoryEnd    = (UINTN) MemoryBase + MemorySize;
+  Plan.ImageSize    = (UINTN) DataSize;
+  Plan.EntryCount   = BlockCount;
+  Plan.FreeCapacity  = 5 * BlockCount + 4;
+  Plan.PieceCapacity = 2 * BlockCount;
+  Plan.PlanSize      = BlockCount * (sizeof (CAPSULE_PLAN_ENTRY) + sizeof (UINTN)) +
+                       Plan.FreeCapacity * sizeof (CAPSULE_EXTENT) +
+                       Plan.PieceCapacity * sizeof (CAPSULE_PIECE);
+  if (!InternalCapsuleFindGap (BlockList, Plan.MemoryBase, Plan.MemoryEnd, Plan.PlanSize, 0, 0, &Plan.PlanBase)) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  Plan.Entries  = (CAPSULE_PLAN_ENTRY *) Plan.PlanBase;
+  Plan.BySource = (UINTN *) (Plan.Entries + BlockCount);
+  Plan.Free     = (CAPSULE_EXTENT *) (Plan.BySource + BlockCount);
+  Plan.Pieces   = (CAPSULE_PIECE *) (Plan.Free + Plan.FreeCapacity);
+
+  //
+  // Copy mode: the image fits in a free gap.
+  //
+  InPlace = !InternalCapsuleFindGap (
+               BlockList,
+               Plan.MemoryBase,
+               Plan.MemoryEnd,
+               Plan.ImageSize,
+               Plan.PlanBase,
+               Plan.PlanSize,
+               &Plan.ImageBase
+               );
+
+  //
+  // The descriptors are not used once the plan is filled, so they may be
+  // overwritten.
+  //
+  Cursor.Descriptor = BlockList;
+  Cursor.Array      = BlockList;
+  Entry             = Plan.Entries;
+  Offset            = 0;
+  while (TRUE) {
+    if (!InternalCapsuleChainNext (&Cursor, &Base, &Length)) {
+      if (Length == 0) {
+        break;
+      }
+      continue;
+    }
+    Entry->Source  = Base;
+    Entry->Length  = Length;
+    Entry->Offset  = Offset;
+    Offset        += Length;
+    Entry++;
+  }
+  InternalCapsuleSortBySource (&Plan);
+
+  Plan.Verify = Verify;
+  if (Verify) {
+    Status = InternalCapsuleCheckHeader (&Plan);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  if (InPlace) {
+    //
+    // In place mode: try the bottom and the top of the memory range, and the place
+    // that leaves the largest block where it is, and keep the one that moves the
+    // fewest bytes out of the way.
+    //
+    Candidate[0] = ALIGN_VALUE (Plan.MemoryBase, CAPSULE_COALESCE_ALIGNMENT);
+    Candidate[1] = (Plan.MemoryEnd - Plan.ImageSize) & ~(UINTN) (CAPSULE_COALESCE_ALIGNMENT - 1);
+    Candidate[2] = Candidate[0];
+    Length       = 0;
+    for (Index = 0; Index < Plan.EntryCount; Index++) {
+      Entry = &Plan.Entries[Index];
+      if (Entry->Length > Length && Entry->Source >= Entry->Offset &&
+          ((Entry->Source - Entry->Offset) & (CAPSULE_COALESCE_ALIGNMENT - 1)) == 0) {
+        Candidate[2] = Entry->Source - Entry->Offset;
+        Length       = Entry->Length;
+      }
+    }
+
+    BestBase      = 0;
+    BestEvacuated = MAX_UINTN;
+    Status        = EFI_OUT_OF_RESOURCES;
+    for (Index = 0; Index < 3; Index++) {
+      if (Candidate[Index] < Plan.MemoryBase || Candidate[Index] > Plan.MemoryEnd ||
+          Plan.ImageSize > Plan.MemoryEnd - Candidate[Index] ||
+          InternalCapsuleOverlaps (Candidate[Index], Plan.ImageSize, Plan.PlanBase, Plan.PlanSize)) {
+        continue;
+      }
+      Plan.ImageBase = Candidate[Index];
+      Status         = InternalCapsuleRunPlan (&Plan, TRUE);
+      if (Status == EFI_VOLUME_CORRUPTED) {
+        return Status;
+      }
+      if (!EFI_ERROR (Status) && Plan.EvacuatedBytes < BestEvacuated) {
+        BestBase      = Candidate[Index];
+        BestEvacuated = Plan.EvacuatedBytes;
+      }
+    }
+    if (BestEvacuated == MAX_UINTN) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Plan.ImageBase = BestBase;
+  }
+
+  Status = InternalCapsuleRunPlan (&Plan, FALSE);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Image     = (VOID *) Plan.ImageBase;
+  *ImageSize = Plan.ImageSize;
+  if (Verify) {
+    *Checksum = Plan.Checksum;
+  }
+  if (Statistics != NULL) {
+    Statistics->BlockCount      = BlockCount;
+    Statistics->DescriptorCount = DescriptorCount;
+    Statistics->DataSize        = DataSize;
+    Statistics->InPlace         = InPlace;
+    Statistics->PlanSize        = Plan.PlanSize;
+    Statistics->EvacuatedBytes  = Plan.EvacuatedBytes;
+    Statistics->PeakExtraBytes  = Plan.PlanSize + (InPlace ? Plan.PeakEvacuated : Plan.ImageSize);
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Coalesces the data blocks of a descriptor chain into one image.
+
+  The image, an 8-byte aligned relocation plan and the evacuated blocks are placed
+  in the memory range, which may hold data blocks and descriptors of the chain but
+  nothing else the caller needs. The blocks outside the range are only read. The
+  plan is checked before any block is moved, so a failure leaves the data blocks
+  and the descriptors as they were. The descriptors are not valid after the image
+  is built.
+
+  @param  BlockList     The first descriptor of the chain.
+  @param  MemoryBase    The base of the memory range.
+  @param  MemorySize    The size of the memory range.
+  @param  Image         Returns the image.
+  @param  ImageSize     Returns the size of the image.
+  @param  Statistics    Returns the counters of the coalescing. Optional.
+
+  @retval EFI_SUCCESS             The image was built.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_FOUND           The chain holds no data.
+  @retval EFI_VOLUME_CORRUPTED    The chain is not valid, or data blocks overlap.
+  @retval EFI_BUFFER_TOO_SMALL    The memory range cannot hold the image and the plan.
+  @retval EFI_OUT_OF_RESOURCES    The memory range has too little free memory to move
+                                  the blocks out of the way of the image.
+
+**/
+EFI_STATUS
+EFIAPI
+CapsuleCoalesce (
+  IN  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  IN  VOID                                          *MemoryBase,
+  IN  UINTN                                         MemorySize,
+  OUT VOID                                          **Image,
+  OUT UINTN                                         *ImageSize,
+  OUT CAPSULE_COALESCE_STATISTICS                   *Statistics  OPTIONAL
+  )
+{
+  return InternalCapsuleCoalesce (BlockList, MemoryBase, MemorySize, FALSE, Image, ImageSize, NULL, Statistics);
+}
+
+/**
+  Coalesces the data blocks of a descriptor chain into one capsule image, checking
+  the capsule while it is coalesced.
+
+  The FRAMEWORK_EFI_CAPSULE_HEADER and the EFI_CAPSULE_OEM_HEADER of the image are
+  checked on the data blocks before any of them is moved, so a capsule with a bad
+  header is rejected without touching memory. The checksum of the image is summed
+  by the copies that build the image, so the image is not read again.
+
+  @param  BlockList     The first descriptor of the chain.
+  @param  MemoryBase    The base of the memory range.
+  @param  MemorySize    The size of the memory range.
+  @param  Image         Returns the image.
+  @param  ImageSize     Returns the size of the image.
+  @param  Checksum      Returns the sum of the image as an array of UINT32 values,
+                        the last one padded with zeros.
+  @param  Statistics    Returns the counters of the coalescing. Optional.
+
+  @retval EFI_SUCCESS             The image was built.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_FOUND           The chain holds no data.
+  @retval EFI_VOLUME_CORRUPTED    The chain is not valid, data blocks overlap, or a
+                                  capsule header is not valid.
+  @retval EFI_BUFFER_TOO_SMALL    The memory range cannot hold the image and the plan.
+  @retval EFI_OUT_OF_RESOURCES    The memory range has too little free memory to move
+                                  the blocks out of the way of the image.
+
+**/
+EFI_STATUS
+EFIAPI
+CapsuleCoalesceVerify (
+  IN  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *BlockList,
+  IN  VOID                                          *MemoryBase,
+  IN  UINTN                                         MemorySize,
+  OUT VOID                                          **Image,
+  OUT UINTN                                         *ImageSize,
+  OUT UINT32                                        *Checksum,
+  OUT CAPSULE_COALESCE_STATISTICS                   *Statistics  OPTIONAL
+  )
+{
+  if (Checksum == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  return InternalCapsuleCoalesce (BlockList, MemoryBase, MemorySize, TRUE, Image, ImageSize, Checksum, Statistics);
+}
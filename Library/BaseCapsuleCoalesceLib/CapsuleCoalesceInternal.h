@@ -0,0 +1,220 @@
+/** @file
+  Internal definitions of the capsule coalescing library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _CAPSULE_COALESCE_INTERNAL_H_
+#define _CAPSULE_COALESCE_INTERNAL_H_
+
+#include <PiPei.h>
+
+#include <Guid/Capsule.h>
+
+#include <Library/CapsuleCoalesceLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+#define CAPSULE_COALESCE_ALIGNMENT  8
+
+///
+/// A data block, in the order of the image.
+///
+typedef struct {
+  UINTN   Source;           ///< Address of the block in the chain.
+  UINTN   Length;
+  UINTN   Offset;           ///< Offset of the block in the image.
+  UINTN   Blockers;         ///< Total size of the other blocks, not yet copied, that lie
+                            ///< where the block is copied, or CAPSULE_PLAN_COPIED.
+  UINTN   NextReady;        ///< Next block of the ready list, or CAPSULE_PLAN_END.
+  UINTN   Piece;            ///< First piece of the block once it is moved out of the way,
+                            ///< or CAPSULE_PLAN_END.
+} CAPSULE_PLAN_ENTRY;
+
+#define CAPSULE_PLAN_COPIED  MAX_UINTN
+#define CAPSULE_PLAN_END     MAX_UINTN
+
+///
+/// A range of free memory.
+///
+typedef struct {
+  UINTN   Base;
+  UINTN   Length;
+} CAPSULE_EXTENT;
+
+///
+/// A part of a block moved out of the way. A block is split over several free
+/// extents when no free extent can hold all of it.
+///
+typedef struct {
+  UINTN   Base;
+  UINTN   Length;
+  UINTN   Next;             ///< Next piece of the block, or CAPSULE_PLAN_END.
+} CAPSULE_PIECE;
+
+///
+/// The relocation plan. The entries, the extents and the pieces are stored in the
+/// plan area, which is a free gap of the memory range.
+///
+typedef struct {
+  UINTN               MemoryBase;
+  UINTN               MemoryEnd;
+  UINTN               PlanBase;
+  UINTN               PlanSize;
+  UINTN               ImageBase;
+  UINTN               ImageSize;
+  CAPSULE_PLAN_ENTRY  *Entries;
+  UINTN               EntryCount;
+  UINTN               *BySource;          ///< Indexes of the entries, by address.
+  UINTN               Ready;              ///< First block of the ready list.
+  CAPSULE_EXTENT      *Free;
+  UINTN               FreeCount;
+  UINTN               FreeCapacity;
+  CAPSULE_PIECE       *Pieces;
+  UINTN               PieceCapacity;
+  UINTN               FreePiece;          ///< First unused piece.
+  UINTN               Evacuated;          ///< Bytes of the blocks currently moved out of the way.
+  UINTN               EvacuatedBytes;
+  UINTN               PeakEvacuated;
+  BOOLEAN             Verify;             ///< Sum the image while it is copied.
+  UINT32              Checksum;
+} CAPSULE_PLAN;
+
+///
+/// Position in a descriptor chain that was validated.
+///
+typedef struct {
+  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *Descriptor;
+  CONST FRAMEWORK_EFI_CAPSULE_BLOCK_DESCRIPTOR  *Array;       ///< First descriptor of the current array.
+} CAPSULE_CHAIN_CURSOR;
+
+/**
+  Returns the next memory range used by a validated descriptor chain: a data
+  block, or a descriptor array once its last descriptor is reached.
+
+  @param  Cursor    The position in the chain, which starts with both fields set
+                    to the first descriptor.
+  @param  Base      Returns the base of the range.
+  @param  Length    Returns the length of the range.
+
+  @retval TRUE    A data block was returned.
+  @retval FALSE   A descriptor array was returned, or the chain has ended if the
+                  Length is 0.
+
+**/
+BOOLEAN
+InternalCapsuleChainNext (
+  IN OUT CAPSULE_CHAIN_CURSOR  *Cursor,
+  OUT    UINTN                 *Base,
+  OUT    UINTN                 *Length
+  );
+
+/**
+  Checks whether two ranges overlap.
+
+  @param  Base1     The base of the first range.
+  @param  Length1   The length of the first range.
+  @param  Base2     The base of the second range.
+  @param  Length2   The length of the second range.
+
+  @retval TRUE    The ranges overlap.
+  @retval FALSE   The ranges do not overlap.
+
+**/
+BOOLEAN
+InternalCapsuleOverlaps (
+  IN UINTN  Base1,
+  IN UINTN  Length1,
+  IN UINTN  Base2,
+  IN UINTN  Length2
+  );
+
+/**
+  Returns the first block, in the order of the image, that is copied at or above
+  an address.
+
+  @param  Plan    The plan.
+  @param  Base    The address.
+
+  @return The index of the entry, or EntryCount if there is none.
+
+**/
+UINTN
+InternalCapsuleFirstDestination (
+  IN CAPSULE_PLAN  *Plan,
+  IN UINTN         Base
+  );
+
+/**
+  Sorts the indexes of the entries of a plan by the address of their block.
+
+  @param  Plan    The plan, whose entries are filled.
+
+**/
+VOID
+InternalCapsuleSortBySource (
+  IN OUT CAPSULE_PLAN  *Plan
+  );
+
+/**
+  Moves the image to its place, or checks that it can be moved, following the
+  plan. The plan and its entries are reset first, so the function can be run
+  several times on the same plan.
+
+  @param  Plan        The plan, whose ImageBase is set.
+  @param  Simulate    Only check the plan, without moving any byte.
+
+  @retval EFI_SUCCESS             The image was built, or can be built.
+  @retval EFI_VOLUME_CORRUPTED    Data blocks overlap.
+  @retval EFI_OUT_OF_RESOURCES    There is too little free memory to move the blocks
+                                  out of the way of the image.
+
+**/
+EFI_STATUS
+InternalCapsuleRunPlan (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     BOOLEAN       Simulate
+  );
+
+/**
+  Checks the capsule header and the OEM header of the image, on the data blocks.
+
+  @param  Plan    The plan, whose entries are filled.
+
+  @retval EFI_SUCCESS             The headers are valid.
+  @retval EFI_VOLUME_CORRUPTED    A header is not valid.
+
+**/
+EFI_STATUS
+InternalCapsuleCheckHeader (
+  IN CAPSULE_PLAN  *Plan
+  );
+
+/**
+  Copies a part of the image to its place, adding it to the checksum of the image
+  if the plan verifies the image.
+
+  @param  Plan          The plan.
+  @param  Destination   The place of the part in the image.
+  @param  Source        The part.
+  @param  Length        The length of the part.
+
+**/
+VOID
+InternalCapsuleCopyToImage (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     UINTN         Destination,
+  IN     UINTN         Source,
+  IN     UINTN         Length
+  );
+
+#endif
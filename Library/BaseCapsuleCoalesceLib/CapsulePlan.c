@@ -0,0 +1,646 @@
+/** @file
+  Execution of the relocation plan of the capsule coalescing library.
+
+  A block is copied to the image once no other block left to copy lies where it
+  goes, so chains of blocks are copied without moving any of them twice. Only the
+  cycles of blocks waiting for each other are broken by moving blocks to free
+  memory outside the image. The memory that a block leaves, outside the image,
+  becomes free for the next blocks to be moved out of the way. The same code runs
+  without moving any byte to check a plan and count the bytes it moves.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "CapsuleCoalesceInternal.h"
+
+/**
+  Sorts extents by base address.
+
+  @param  Extent    The extents.
+  @param  Count     The number of extents.
+
+**/
+VOID
+InternalCapsuleSortExtents (
+  IN OUT CAPSULE_EXTENT  *Extent,
+  IN     UINTN           Count
+  )
+{
+  CAPSULE_EXTENT  Value;
+  UINTN           Gap;
+  UINTN           Index;
+  UINTN           Position;
+
+  for (Gap = Count / 2; Gap > 0; Gap /= 2) {
+    for (Index = Gap; Index < Count; Index++) {
+      Value = Extent[Index];
+      for (Position = Index; Position >= Gap && Extent[Position - Gap].Base > Value.Base; Position -= Gap) {
+        Extent[Position] = Extent[Position - Gap];
+      }
+      Extent[Position] = Value;
+    }
+  }
+}
+
+/**
+  Adds a free range to the free extents, merging it with its neighbors.
+
+  @param  Plan      The plan.
+  @param  Base      The base of the range.
+  @param  Length    The length of the range.
+
+**/
+VOID
+InternalCapsuleAddExtent (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     UINTN         Base,
+  IN     UINTN         Length
+  )
+{
+  CAPSULE_EXTENT  *Left;
+  CAPSULE_EXTENT  *Right;
+  CAPSULE_EXTENT  *Empty;
+  UINTN           Index;
+
+  Left  = NULL;
+  Right = NULL;
+  Empty = NULL;
+  for (Index = 0; Index < Plan->FreeCount; Index++) {
+    if (Plan->Free[Index].Length == 0) {
+      Empty = &Plan->Free[Index];
+    } else if (Plan->Free[Index].Base + Plan->Free[Index].Length == Base) {
+      Left = &Plan->Free[Index];
+    } else if (Plan->Free[Index].Base == Base + Length) {
+      Right = &Plan->Free[Index];
+    }
+  }
+
+  if (Left != NULL) {
+    Left->Length += Length;
+    if (Right != NULL) {
+      Left->Length += Right->Length;
+      Right->Length = 0;
+    }
+  } else if (Right != NULL) {
+    Right->Base    = Base;
+    Right->Length += Length;
+  } else {
+    if (Empty == NULL) {
+      if (Plan->FreeCount == Plan->FreeCapacity) {
+        //
+        // The range stays unused, which only makes the plan use less memory.
+        //
+        return;
+      }
+      Empty = &Plan->Free[Plan->FreeCount++];
+    }
+    Empty->Base   = Base;
+    Empty->Length = Length;
+  }
+}
+
+/**
+  Frees the part of a range that is in the memory range and outside the image.
+
+  @param  Plan      The plan.
+  @param  Base      The base of the range.
+  @param  Length    The length of the range.
+
+**/
+VOID
+InternalCapsuleRelease (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     UINTN         Base,
+  IN     UINTN         Length
+  )
+{
+  UINTN  Low;
+  UINTN  High;
+  UINTN  ImageEnd;
+
+  Low  = MAX (Base, Plan->MemoryBase);
+  High = MIN (Base + Length, Plan->MemoryEnd);
+  if (Low >= High) {
+    return;
+  }
+
+  ImageEnd = Plan->ImageBase + Plan->ImageSize;
+  if (Low < Plan->ImageBase) {
+    InternalCapsuleAddExtent (Plan, Low, MIN (High, Plan->ImageBase) - Low);
+  }
+  if (High > ImageEnd) {
+    Low = MAX (Low, ImageEnd);
+    InternalCapsuleAddExtent (Plan, Low, High - Low);
+  }
+}
+
+/**
+  Builds the free extents: the memory range, less the plan, the data blocks and
+  the image.
+
+  @param  Plan    The plan.
+
+  @retval EFI_SUCCESS             The free extents were built.
+  @retval EFI_VOLUME_CORRUPTED    Data blocks overlap.
+
+**/
+EFI_STATUS
+InternalCapsuleBuildFreeList (
+  IN OUT CAPSULE_PLAN  *Plan
+  )
+{
+  CAPSULE_PLAN_ENTRY  *Entry;
+  UINTN               Count;
+  UINTN               Index;
+  UINTN               Low;
+  UINTN               High;
+  UINTN               Previous;
+  UINTN               ImageEnd;
+
+  //
+  // List the used ranges, then turn the list into the gaps between them.
+  //
+  Plan->Free[0].Base   = Plan->PlanBase;
+  Plan->Free[0].Length = Plan->PlanSize;
+  Count                = 1;
+  for (Index = 0; Index < Plan->EntryCount; Index++) {
+    Entry = &Plan->Entries[Index];
+    Low   = MAX (Entry->Source, Plan->MemoryBase);
+    High  = MIN (Entry->Source + Entry->Length, Plan->MemoryEnd);
+    if (Low < High) {
+      Plan->Free[Count].Base   = Low;
+      Plan->Free[Count].Length = High - Low;
+      Count++;
+    }
+  }
+  InternalCapsuleSortExtents (Plan->Free, Count);
+
+  Plan->FreeCount = 0;
+  Previous        = Plan->MemoryBase;
+  for (Index = 0; Index < Count; Index++) {
+    Low  = Plan->Free[Index].Base;
+    High = Low + Plan->Free[Index].Length;
+    if (Low < Previous) {
+      DEBUG ((DEBUG_ERROR, "CapsuleCoalesce: data blocks overlap at 0x%p\n", (VOID *) Low));
+      return EFI_VOLUME_CORRUPTED;
+    }
+    if (Low > Previous) {
+      Plan->Free[Plan->FreeCount].Base   = Previous;
+      Plan->Free[Plan->FreeCount].Length = Low - Previous;
+      Plan->FreeCount++;
+    }
+    Previous = High;
+  }
+
+  if (Previous < Plan->MemoryEnd) {
+    Plan->Free[Plan->FreeCount].Base   = Previous;
+    Plan->Free[Plan->FreeCount].Length = Plan->MemoryEnd - Previous;
+    Plan->FreeCount++;
+  }
+
+  //
+  // Take the image out of the gaps. Only the gap that holds the whole image is
+  // split in two.
+  //
+  ImageEnd = Plan->ImageBase + Plan->ImageSize;
+  Count    = Plan->FreeCount;
+  for (Index = 0; Index < Count; Index++) {
+    Low  = Plan->Free[Index].Base;
+    High = Low + Plan->Free[Index].Length;
+    if (!InternalCapsuleOverlaps (Low, High - Low, Plan->ImageBase, Plan->ImageSize)) {
+      continue;
+    }
+    Plan->Free[Index].Length = 0;
+    if (Low < Plan->ImageBase) {
+      Plan->Free[Index].Length = Plan->ImageBase - Low;
+    }
+    if (High > ImageEnd) {
+      if (Plan->Free[Index].Length == 0) {
+        Plan->Free[Index].Base   = ImageEnd;
+        Plan->Free[Index].Length = High - ImageEnd;
+      } else {
+        Plan->Free[Plan->FreeCount].Base   = ImageEnd;
+        Plan->Free[Plan->FreeCount].Length = High - ImageEnd;
+        Plan->FreeCount++;
+      }
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Moves a block out of the way of the image, to free memory outside the image.
+
+  The block goes to the first free extent that can hold it, or else is split over
+  the largest free extents.
+
+  @param  Plan        The plan.
+  @param  Index       The entry of the block.
+  @param  Simulate    Only account for the move, without moving any byte.
+
+  @retval TRUE    The block was moved.
+  @retval FALSE   There is too little free memory, or too few free pieces.
+
+**/
+BOOLEAN
+InternalCapsuleEvacuate (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     UINTN         Index,
+  IN     BOOLEAN       Simulate
+  )
+{
+  CAPSULE_PLAN_ENTRY  *Entry;
+  CAPSULE_EXTENT      *Extent;
+  CAPSULE_PIECE       *Piece;
+  UINTN               ExtentIndex;
+  UINTN               PieceIndex;
+  UINTN               *Link;
+  UINTN               Done;
+  UINTN               Length;
+
+  Entry = &Plan->Entries[Index];
+  Link  = &Entry->Piece;
+  Done  = 0;
+  while (Done < Entry->Length) {
+    Extent = NULL;
+    for (ExtentIndex = 0; ExtentIndex < Plan->FreeCount; ExtentIndex++) {
+      if (Plan->Free[ExtentIndex].Length >= Entry->Length - Done) {
+        Extent = &Plan->Free[ExtentIndex];
+        break;
+      }
+      if (Plan->Free[ExtentIndex].Length > 0 && (Extent == NULL || Plan->Free[ExtentIndex].Length > Extent->Length)) {
+        Extent = &Plan->Free[ExtentIndex];
+      }
+    }
+    if (Extent == NULL || Plan->FreePiece == CAPSULE_PLAN_END) {
+      return FALSE;
+    }
+
+    PieceIndex      = Plan->FreePiece;
+    Piece           = &Plan->Pieces[PieceIndex];
+    Plan->FreePiece = Piece->Next;
+    Length          = MIN (Extent->Length, Entry->Length - Done);
+    Piece->Base     = Extent->Base;
+    Piece->Length   = Length;
+    Piece->Next     = CAPSULE_PLAN_END;
+    Extent->Base   += Length;
+    Extent->Length -= Length;
+    *Link           = PieceIndex;
+    Link            = &Piece->Next;
+
+    if (!Simulate) {
+      CopyMem ((VOID *) Piece->Base, (VOID *) (Entry->Source + Done), Length);
+    }
+    Done += Length;
+  }
+
+  Plan->Evacuated      += Entry->Length;
+  Plan->EvacuatedBytes += Entry->Length;
+  Plan->PeakEvacuated   = MAX (Plan->PeakEvacuated, Plan->Evacuated);
+  return TRUE;
+}
+
+/**
+  Copies a block to its place in the image, and frees the memory it leaves.
+
+  @param  Plan        The plan.
+  @param  Index       The entry of the block.
+  @param  Simulate    Only account for the copy, without moving any byte.
+
+**/
+VOID
+InternalCapsuleCopy (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     UINTN         Index,
+  IN     BOOLEAN       Simulate
+  )
+{
+  CAPSULE_PLAN_ENTRY  *Entry;
+  CAPSULE_PIECE       *Piece;
+  UINTN               Destination;
+  UINTN               PieceIndex;
+
+  Entry       = &Plan->Entries[Index];
+  Destination = Plan->ImageBase + Entry->Offset;
+  if (Entry->Piece == CAPSULE_PLAN_END) {
+    if (!Simulate) {
+      InternalCapsuleCopyToImage (Plan, Destination, Entry->Source, Entry->Length);
+    }
+    InternalCapsuleRelease (Plan, Entry->Source, Entry->Length);
+    return;
+  }
+
+  for (PieceIndex = Entry->Piece; PieceIndex != CAPSULE_PLAN_END; PieceIndex = Piece->Next) {
+    Piece = &Plan->Pieces[PieceIndex];
+    if (!Simulate) {
+      InternalCapsuleCopyToImage (Plan, Destination, Piece->Base, Piece->Length);
+    }
+    Destination += Piece->Length;
+    InternalCapsuleRelease (Plan, Piece->Base, Piece->Length);
+    if (Piece->Next == CAPSULE_PLAN_END) {
+      Piece->Next     = Plan->FreePiece;
+      Plan->FreePiece = Entry->Piece;
+      break;
+    }
+  }
+  Plan->Evacuated -= Entry->Length;
+}
+
+/**
+  Sorts the indexes of the entries of a plan by the address of their block.
+
+  @param  Plan    The plan, whose entries are filled.
+
+**/
+VOID
+InternalCapsuleSortBySource (
+  IN OUT CAPSULE_PLAN  *Plan
+  )
+{
+  UINTN  Value;
+  UINTN  Gap;
+  UINTN  Index;
+  UINTN  Position;
+
+  for (Index = 0; Index < Plan->EntryCount; Index++) {
+    Plan->BySource[Index] = Index;
+  }
+  for (Gap = Plan->EntryCount / 2; Gap > 0; Gap /= 2) {
+    for (Index = Gap; Index < Plan->EntryCount; Index++) {
+      Value = Plan->BySource[Index];
+      for (Position = Index;
+           Position >= Gap &&
+           Plan->Entries[Plan->BySource[Position - Gap]].Source > Plan->Entries[Value].Source;
+           Position -= Gap) {
+        Plan->BySource[Position] = Plan->BySource[Position - Gap];
+      }
+      Plan->BySource[Position] = Value;
+    }
+  }
+}
+
+/**
+  Returns the first block, in the order of the image, that is copied at or above
+  an address.
+
+  @param  Plan    The plan.
+  @param  Base    The address.
+
+  @return The index of the entry, or EntryCount if there is none.
+
+**/
+UINTN
+InternalCapsuleFirstDestination (
+  IN CAPSULE_PLAN  *Plan,
+  IN UINTN         Base
+  )
+{
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
+
+  Low  = 0;
+  High = Plan->EntryCount;
+  while (Low < High) {
+    Middle = (Low + High) / 2;
+    if (Plan->ImageBase + Plan->Entries[Middle].Offset + Plan->Entries[Middle].Length > Base) {
+      High = Middle;
+    } else {
+      Low = Middle + 1;
+    }
+  }
+  return Low;
+}
+
+/**
+  Returns the first block, in the order of the addresses in the chain, that ends
+  above an address.
+
+  @param  Plan    The plan.
+  @param  Base    The address.
+
+  @return The position in BySource, or EntryCount if there is none.
+
+**/
+UINTN
+InternalCapsuleFirstSource (
+  IN CAPSULE_PLAN  *Plan,
+  IN UINTN         Base
+  )
+{
+  CAPSULE_PLAN_ENTRY  *Entry;
+  UINTN               Low;
+  UINTN               High;
+  UINTN               Middle;
+
+  Low  = 0;
+  High = Plan->EntryCount;
+  while (Low < High) {
+    Middle = (Low + High) / 2;
+    Entry  = &Plan->Entries[Plan->BySource[Middle]];
+    if (Entry->Source + Entry->Length > Base) {
+      High = Middle;
+    } else {
+      Low = Middle + 1;
+    }
+  }
+  return Low;
+}
+
+/**
+  Records that a block to copy left a range: the blocks copied over the range
+  have fewer blockers, and join the ready list when they have none.
+
+  @param  Plan      The plan.
+  @param  Owner     The entry of the block that left the range.
+  @param  Base      The base of the range.
+  @param  Length    The length of the range.
+
+**/
+VOID
+InternalCapsuleUnblock (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     UINTN         Owner,
+  IN     UINTN         Base,
+  IN     UINTN         Length
+  )
+{
+  CAPSULE_PLAN_ENTRY  *Entry;
+  UINTN               Index;
+
+  for (Index = InternalCapsuleFirstDestination (Plan, Base); Index < Plan->EntryCount; Index++) {
+    Entry = &Plan->Entries[Index];
+    if (Plan->ImageBase + Entry->Offset >= Base + Length) {
+      break;
+    }
+    if (Index == Owner || Entry->Blockers == CAPSULE_PLAN_COPIED) {
+      continue;
+    }
+    Entry->Blockers -= Length;
+    if (Entry->Blockers == 0) {
+      Entry->NextReady = Plan->Ready;
+      Plan->Ready      = Index;
+    }
+  }
+}
+
+/**
+  Returns the blocks, in the order of the addresses in the chain, that lie where a
+  block is copied. The block itself is included if it lies
+  there.
+
+  @param  Plan      The plan.
+  @param  Index     The entry of the block.
+  @param  First     Returns the position in BySource of the first block.
+  @param  Bytes     Returns the total size of the blocks that have not been moved,
+                    without the block itself.
+
+  @return The number of blocks.
+
+**/
+UINTN
+InternalCapsuleBlockers (
+  IN  CAPSULE_PLAN  *Plan,
+  IN  UINTN         Index,
+  OUT UINTN         *First,
+  OUT UINTN         *Bytes
+  )
+{
+  CAPSULE_PLAN_ENTRY  *Entry;
+  CAPSULE_PLAN_ENTRY  *Other;
+  UINTN               Destination;
+  UINTN               Position;
+
+  Entry       = &Plan->Entries[Index];
+  Destination = Plan->ImageBase + Entry->Offset;
+  *First      = InternalCapsuleFirstSource (Plan, Destination);
+  *Bytes      = 0;
+  for (Position = *First; Position < Plan->EntryCount; Position++) {
+    Other = &Plan->Entries[Plan->BySource[Position]];
+    if (Other->Source >= Destination + Entry->Length) {
+      break;
+    }
+    if (Other != Entry && Other->Piece == CAPSULE_PLAN_END && Other->Blockers != CAPSULE_PLAN_COPIED) {
+      *Bytes += Other->Length;
+    }
+  }
+  return Position - *First;
+}
+
+/**
+  Moves the image to its place, or checks that it can be moved, following the
+  plan. The plan and its entries are reset first, so the function can be run
+  several times on the same plan.
+
+  A block is copied as soon as no block left to copy lies where it goes. When
+  every block left is waiting for another, the blocks are waiting in cycles, and
+  the block whose blockers are the smallest has them moved out of the way.
+
+  @param  Plan        The plan, whose ImageBase is set.
+  @param  Simulate    Only check the plan, without moving any byte.
+
+  @retval EFI_SUCCESS             The image was built, or can be built.
+  @retval EFI_VOLUME_CORRUPTED    Data blocks overlap.
+  @retval EFI_OUT_OF_RESOURCES    There is too little free memory to move the blocks
+                                  out of the way of the image.
+
+**/
+EFI_STATUS
+InternalCapsuleRunPlan (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     BOOLEAN       Simulate
+  )
+{
+  EFI_STATUS          Status;
+  CAPSULE_PLAN_ENTRY  *Entry;
+  CAPSULE_PLAN_ENTRY  *Other;
+  UINTN               Index;
+  UINTN               Position;
+  UINTN               First;
+  UINTN               Count;
+  UINTN               Bytes;
+  UINTN               BestIndex;
+  UINTN               Remaining;
+
+  Plan->Evacuated      = 0;
+  Plan->EvacuatedBytes = 0;
+  Plan->PeakEvacuated  = 0;
+  Plan->Ready          = CAPSULE_PLAN_END;
+  Plan->FreePiece      = 0;
+  Plan->Checksum       = 0;
+  for (Index = 0; Index < Plan->PieceCapacity; Index++) {
+    Plan->Pieces[Index].Next = (Index + 1 < Plan->PieceCapacity) ? Index + 1 : CAPSULE_PLAN_END;
+  }
+  for (Index = 0; Index < Plan->EntryCount; Index++) {
+    Plan->Entries[Index].Blockers = 0;
+    Plan->Entries[Index].Piece    = CAPSULE_PLAN_END;
+  }
+  Status = InternalCapsuleBuildFreeList (Plan);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Count the blockers of every block, then start with the blocks that have none.
+  //
+  for (Index = 0; Index < Plan->EntryCount; Index++) {
+    InternalCapsuleBlockers (Plan, Index, &First, &Plan->Entries[Index].Blockers);
+  }
+  for (Index = Plan->EntryCount; Index > 0; Index--) {
+    Entry = &Plan->Entries[Index - 1];
+    if (Entry->Blockers == 0) {
+      Entry->NextReady = Plan->Ready;
+      Plan->Ready      = Index - 1;
+    }
+  }
+
+  Remaining = Plan->EntryCount;
+  while (Remaining > 0) {
+    if (Plan->Ready == CAPSULE_PLAN_END) {
+      //
+      // Break the cycles at the block whose blockers are the smallest.
+      //
+      BestIndex = 0;
+      for (Index = 1; Index < Plan->EntryCount; Index++) {
+        if (Plan->Entries[Index].Blockers < Plan->Entries[BestIndex].Blockers) {
+          BestIndex = Index;
+        }
+      }
+
+      Count = InternalCapsuleBlockers (Plan, BestIndex, &First, &Bytes);
+      for (Position = First; Position < First + Count; Position++) {
+        Index = Plan->BySource[Position];
+        Other = &Plan->Entries[Index];
+        if (Index == BestIndex || Other->Piece != CAPSULE_PLAN_END || Other->Blockers == CAPSULE_PLAN_COPIED) {
+          continue;
+        }
+        if (!InternalCapsuleEvacuate (Plan, Index, Simulate)) {
+          return EFI_OUT_OF_RESOURCES;
+        }
+        InternalCapsuleRelease (Plan, Other->Source, Other->Length);
+        InternalCapsuleUnblock (Plan, Index, Other->Source, Other->Length);
+      }
+      ASSERT (Plan->Ready != CAPSULE_PLAN_END);
+      continue;
+    }
+
+    Index       = Plan->Ready;
+    Entry       = &Plan->Entries[Index];
+    Plan->Ready = Entry->NextReady;
+    InternalCapsuleCopy (Plan, Index, Simulate);
+    if (Entry->Piece == CAPSULE_PLAN_END) {
+      InternalCapsuleUnblock (Plan, Index, Entry->Source, Entry->Length);
+    }
+    Entry->Blockers = CAPSULE_PLAN_COPIED;
+    Remaining--;
+  }
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,204 @@
+/** @file
+  Integrity check of the capsule coalescing library.
+
+  The capsule header and the OEM header are checked on the data blocks before any
+  of them is moved. The checksum of the image is then accumulated while the blocks
+  are copied to their place in the image, in whatever order they are copied: every
+  byte is added once, when it reaches its offset in the image, to the UINT32 lane
+  of that offset, so the image is never read again after it is built.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "CapsuleCoalesceInternal.h"
+
+/**
+  Reads a part of the image from the data blocks, before they are moved.
+
+  @param  Plan      The plan, whose entries are filled.
+  @param  Offset    The offset of the part in the image.
+  @param  Length    The length of the part, which must be in the image.
+  @param  Buffer    Returns the part.
+
+**/
+VOID
+InternalCapsuleReadImage (
+  IN  CAPSULE_PLAN  *Plan,
+  IN  UINTN         Offset,
+  IN  UINTN         Length,
+  OUT VOID          *Buffer
+  )
+{
+  CAPSULE_PLAN_ENTRY  *Entry;
+  UINTN               Index;
+  UINTN               Size;
+
+  for (Index = InternalCapsuleFirstDestination (Plan, Plan->ImageBase + Offset); Length > 0; Index++) {
+    Entry = &Plan->Entries[Index];
+    Size  = MIN (Length, Entry->Offset + Entry->Length - Offset);
+    CopyMem (Buffer, (VOID *) (Entry->Source + Offset - Entry->Offset), Size);
+    Buffer  = (UINT8 *) Buffer + Size;
+    Offset += Size;
+    Length -= Size;
+  }
+}
+
+/**
+  Checks that an offset of the capsule header points inside the header area that
+  precedes the capsule body.
+
+  @param  Header    The capsule header.
+  @param  Offset    The offset, or 0 if the field is not used.
+
+  @retval TRUE    The offset is valid.
+  @retval FALSE   The offset is not valid.
+
+**/
+BOOLEAN
+InternalCapsuleIsHeaderOffset (
+  IN CONST FRAMEWORK_EFI_CAPSULE_HEADER  *Header,
+  IN UINT32                              Offset
+  )
+{
+  return (BOOLEAN) (Offset == 0 || (Offset >= Header->HeaderSize && Offset < Header->OffsetToCapsuleBody));
+}
+
+/**
+  Checks the capsule header and the OEM header of the image, on the data blocks.
+
+  @param  Plan    The plan, whose entries are filled.
+
+  @retval EFI_SUCCESS             The headers are valid.
+  @retval EFI_VOLUME_CORRUPTED    A header is not valid.
+
+**/
+EFI_STATUS
+InternalCapsuleCheckHeader (
+  IN CAPSULE_PLAN  *Plan
+  )
+{
+  FRAMEWORK_EFI_CAPSULE_HEADER  Header;
+  EFI_CAPSULE_OEM_HEADER        OemHeader;
+
+  if (Plan->ImageSize < sizeof (Header)) {
+    DEBUG ((DEBUG_ERROR, "CapsuleCoalesce: image too small for a capsule header\n"));
+    return EFI_VOLUME_CORRUPTED;
+  }
+  InternalCapsuleReadImage (Plan, 0, sizeof (Header), &Header);
+
+  //
+  // A CapsuleImageSize above the size of the image means that the capsule is split
+  // across media, one below is an error.
+  //
+  if (Header.HeaderSize < sizeof (Header) ||
+      Header.OffsetToCapsuleBody < Header.HeaderSize ||
+      Header.OffsetToCapsuleBody > Plan->ImageSize ||
+      Header.CapsuleImageSize < Plan->ImageSize) {
+    DEBUG ((DEBUG_ERROR, "CapsuleCoalesce: capsule header sizes are not valid\n"));
+    return EFI_VOLUME_CORRUPTED;
+  }
+  if ((Header.Flags & ~EFI_CAPSULE_HEADER_FLAG_SETUP) != 0 || Header.OffsetToApplicableDevices != 0) {
+    DEBUG ((DEBUG_ERROR, "CapsuleCoalesce: capsule header reserved bits are set\n"));
+    return EFI_VOLUME_CORRUPTED;
+  }
+  if (Header.OffsetToSplitInformation >= Plan->ImageSize ||
+      !InternalCapsuleIsHeaderOffset (&Header, Header.OffsetToOemDefinedHeader) ||
+      !InternalCapsuleIsHeaderOffset (&Header, Header.OffsetToAuthorInformation) ||
+      !InternalCapsuleIsHeaderOffset (&Header, Header.OffsetToRevisionInformation) ||
+      !InternalCapsuleIsHeaderOffset (&Header, Header.OffsetToShortDescription) ||
+      !InternalCapsuleIsHeaderOffset (&Header, Header.OffsetToLongDescription)) {
+    DEBUG ((DEBUG_ERROR, "CapsuleCoalesce: capsule header offsets are not valid\n"));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (Header.OffsetToOemDefinedHeader != 0) {
+    if (Header.OffsetToCapsuleBody - Header.OffsetToOemDefinedHeader < sizeof (OemHeader)) {
+      DEBUG ((DEBUG_ERROR, "CapsuleCoalesce: OEM header does not fit\n"));
+      return EFI_VOLUME_CORRUPTED;
+    }
+    InternalCapsuleReadImage (Plan, Header.OffsetToOemDefinedHeader, sizeof (OemHeader), &OemHeader);
+    if (OemHeader.HeaderSize < sizeof (OemHeader) ||
+        OemHeader.HeaderSize > Header.OffsetToCapsuleBody - Header.OffsetToOemDefinedHeader) {
+      DEBUG ((DEBUG_ERROR, "CapsuleCoalesce: OEM header size is not valid\n"));
+      return EFI_VOLUME_CORRUPTED;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Copies a part of the image to its place, adding it to the checksum of the image
+  if the plan verifies the image.
+
+  @param  Plan          The plan.
+  @param  Destination   The place of the part in the image.
+  @param  Source        The part.
+  @param  Length        The length of the part.
+
+**/
+VOID
+InternalCapsuleCopyToImage (
+  IN OUT CAPSULE_PLAN  *Plan,
+  IN     UINTN         Destination,
+  IN     UINTN         Source,
+  IN     UINTN         Length
+  )
+{
+  UINT64  Value;
+  UINT64  Low;
+  UINT64  High;
+  UINT32  Sum;
+  UINTN   Offset;
+  UINTN   Index;
+
+  if (!Plan->Verify) {
+    CopyMem ((VOID *) Destination, (VOID *) Source, Length);
+    return;
+  }
+
+  //
+  // A block that overlaps its own place is copied first, then summed in place.
+  //
+  if (Source != Destination && InternalCapsuleOverlaps (Source, Length, Destination, Length)) {
+    CopyMem ((VOID *) Destination, (VOID *) Source, Length);
+    Source = Destination;
+  }
+
+  Sum    = 0;
+  Offset = Destination - Plan->ImageBase;
+  Index  = 0;
+  while (Index < Length && ((Offset + Index) & (sizeof (UINT32) - 1)) != 0) {
+    Value                             = *(UINT8 *) (Source + Index);
+    *(UINT8 *) (Destination + Index)  = (UINT8) Value;
+    Sum                              += (UINT32) Value << (((Offset + Index) & (sizeof (UINT32) - 1)) * 8);
+    Index++;
+  }
+
+  //
+  // The lanes start at every UINT32 boundary of the image from here: the low and
+  // the high halves of the UINT64 values are summed apart.
+  //
+  Low  = 0;
+  High = 0;
+  for (; Index + sizeof (UINT64) <= Length; Index += sizeof (UINT64)) {
+    Value = ReadUnaligned64 ((UINT64 *) (Source + Index));
+    WriteUnaligned64 ((UINT64 *) (Destination + Index), Value);
+    Low  += (UINT32) Value;
+    High += (UINT32) RShiftU64 (Value, 32);
+  }
+  Sum += (UINT32) (Low + High);
+  for (; Index < Length; Index++) {
+    Value                             = *(UINT8 *) (Source + Index);
+    *(UINT8 *) (Destination + Index)  = (UINT8) Value;
+    Sum                              += (UINT32) Value << (((Offset + Index) & (sizeof (UINT32) - 1)) * 8);
+  }
+  Plan->Checksum += Sum;
+}
@@ -0,0 +1,185 @@
+/** @file
+  Names and formatting of captured status codes.
+
+  This file has no dependency on the processor that captured the status codes, so
+  it can also be built into a tool that decodes ring memory saved from a target.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "StatusCodeRingInternal.h"
+
+#define STATUS_CODE_NAME_ENTRY(Type, Subclass, Operation)  { Type, (Subclass) | (Operation), #Operation }
+
+///
+/// Status codes defined by the Framework Status Codes Specification.
+///
+GLOBAL_REMOVE_IF_UNREFERENCED CONST STATUS_CODE_NAME  mStatusCodeNames[] = {
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_BS_DRIVER,  EFI_SW_DXE_BS_PC_BEGIN_CONNECTING_DRIVERS),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_BS_DRIVER,  EFI_SW_DXE_BS_PC_VERIFYING_PASSWORD),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_BS_DRIVER,  EFI_SW_CSM_LEGACY_ROM_INIT),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_RT_DRIVER,  EFI_SW_DXE_RT_PC_S0),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_RT_DRIVER,  EFI_SW_DXE_RT_PC_S1),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_RT_DRIVER,  EFI_SW_DXE_RT_PC_S2),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_RT_DRIVER,  EFI_SW_DXE_RT_PC_S3),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_RT_DRIVER,  EFI_SW_DXE_RT_PC_S4),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_DXE_RT_DRIVER,  EFI_SW_DXE_RT_PC_S5),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_AL,             EFI_SW_AL_PC_ENTRY_POINT),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_AL,             EFI_SW_AL_PC_RETURN_TO_LAST),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_PEI_MODULE,     EFI_SW_PEIM_PC_RECOVERY_BEGIN),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_PEI_MODULE,     EFI_SW_PEIM_PC_CAPSULE_LOAD),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_PEI_MODULE,     EFI_SW_PEIM_PC_CAPSULE_START),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_PEI_MODULE,     EFI_SW_PEIM_PC_RECOVERY_USER),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_SOFTWARE_PEI_MODULE,     EFI_SW_PEIM_PC_RECOVERY_AUTO),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_IO_BUS_ATA_ATAPI,        EFI_IOB_ATA_BUS_SMART_ENABLE),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_IO_BUS_ATA_ATAPI,        EFI_IOB_ATA_BUS_SMART_DISABLE),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_IO_BUS_ATA_ATAPI,        EFI_IOB_ATA_BUS_SMART_OVERTHRESHOLD),
+  STATUS_CODE_NAME_ENTRY (EFI_PROGRESS_CODE, EFI_IO_BUS_ATA_ATAPI,        EFI_IOB_ATA_BUS_SMART_UNDERTHRESHOLD),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_IO_BUS_ATA_ATAPI,        EFI_IOB_ATA_BUS_SMART_NOTSUPPORTED),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_IO_BUS_ATA_ATAPI,        EFI_IOB_ATA_BUS_SMART_DISABLED),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_PEI_CORE,       EFI_SW_PEIM_CORE_EC_DXE_CORRUPT),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_PEI_CORE,       EFI_SW_PEIM_CORE_EC_DXEIPL_NOT_FOUND),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_DIVIDE_ERROR),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_DEBUG),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_NMI),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_BREAKPOINT),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_OVERFLOW),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_BOUND),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_INVALID_OPCODE),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_DOUBLE_FAULT),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_INVALID_TSS),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_SEG_NOT_PRESENT),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_STACK_FAULT),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_GP_FAULT),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_PAGE_FAULT),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_FP_ERROR),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_ALIGNMENT_CHECK),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_MACHINE_CHECK),
+  STATUS_CODE_NAME_ENTRY (EFI_ERROR_CODE,    EFI_SOFTWARE_X64_EXCEPTION,  EFI_SW_EC_X64_SIMD)
+};
+
+/**
+  Returns the name of a status code defined by the Framework Status Codes Specification.
+
+  @param  CodeType    The type of the status code.
+  @param  Value       The value of the status code.
+
+  @return The name of the status code, or NULL if it is not known.
+
+**/
+CONST CHAR8 *
+EFIAPI
+StatusCodeRingGetName (
+  IN EFI_STATUS_CODE_TYPE   CodeType,
+  IN EFI_STATUS_CODE_VALUE  Value
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < sizeof (mStatusCodeNames) / sizeof (mStatusCodeNames[0]); Index++) {
+    if (mStatusCodeNames[Index].CodeType == (CodeType & EFI_STATUS_CODE_TYPE_MASK) &&
+        mStatusCodeNames[Index].Value == Value) {
+      return mStatusCodeNames[Index].Name;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Formats an entry as one line of a boot timeline.
+
+  The line holds the time since the rings were initialized, the processor, the
+  type and the name of the status code, or its class, subclass and operation if
+  it has no name.
+
+  @param  Ring        The ring header.
+  @param  Entry       The entry.
+  @param  Buffer      The buffer that receives the Null-terminated line.
+  @param  BufferSize  The size of Buffer in bytes.
+
+  @return The number of characters written, not including the Null terminator.
+
+**/
+UINTN
+EFIAPI
+StatusCodeRingFormatEntry (
+  IN  CONST STATUS_CODE_RING_HEADER  *Ring,
+  IN  CONST STATUS_CODE_RING_ENTRY   *Entry,
+  OUT CHAR8                          *Buffer,
+  IN  UINTN                          BufferSize
+  )
+{
+  UINT64       Ticks;
+  UINT64       Seconds;
+  UINT64       Remainder;
+  UINT64       Microseconds;
+  CONST CHAR8  *Type;
+  CONST CHAR8  *Name;
+
+  ASSERT (Ring != NULL && Entry != NULL && Buffer != NULL);
+
+  if (BufferSize == 0) {
+    return 0;
+  }
+
+  Seconds      = 0;
+  Microseconds = 0;
+  if (Ring->Frequency != 0 && Entry->Timestamp >= Ring->StartTimestamp) {
+    Ticks        = Entry->Timestamp - Ring->StartTimestamp;
+    Seconds      = DivU64x64Remainder (Ticks, Ring->Frequency, &Remainder);
+    Microseconds = DivU64x64Remainder (MultU64x32 (Remainder, 1000000), Ring->Frequency, NULL);
+  }
+
+  switch (Entry->CodeType & EFI_STATUS_CODE_TYPE_MASK) {
+  case EFI_PROGRESS_CODE:
+    Type = "PROGRESS";
+    break;
+  case EFI_ERROR_CODE:
+    Type = "ERROR";
+    break;
+  case EFI_DEBUG_CODE:
+    Type = "DEBUG";
+    break;
+  default:
+    Type = "UNKNOWN";
+    break;
+  }
+
+  Name = StatusCodeRingGetName (Entry->CodeType, Entry->Value);
+  if (Name != NULL) {
+    return AsciiSPrint (
+             Buffer,
+             BufferSize,
+             "%5ld.%06ld CPU%02d %-8a %a (Instance %d)",
+             Seconds,
+             Microseconds,
+             Entry->CpuIndex,
+             Type,
+             Name,
+             Entry->Instance
+             );
+  }
+
+  return AsciiSPrint (
+           Buffer,
+           BufferSize,
+           "%5ld.%06ld CPU%02d %-8a Class %02x Subclass %02x Operation %04x (Instance %d)",
+           Seconds,
+           Microseconds,
+           Entry->CpuIndex,
+           Type,
+           (UINT32) ((Entry->Value & EFI_STATUS_CODE_CLASS_MASK) >> 24),
+           (UINT32) ((Entry->Value & EFI_STATUS_CODE_SUBCLASS_MASK) >> 16),
+           (UINT32) (Entry->Value & EFI_STATUS_CODE_OPERATION_MASK),
+           Entry->Instance
+           );
+}
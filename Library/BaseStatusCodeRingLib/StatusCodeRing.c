@@ -0,0 +1,348 @@
+/** @file
+  Per-processor lock free capture of status codes.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "StatusCodeRingInternal.h"
+
+/**
+  Returns the indexes of the ring of a processor.
+
+  @param  Ring      The ring header.
+  @param  CpuIndex  The index of the processor.
+
+  @return The indexes of the ring.
+
+**/
+STATUS_CODE_CPU_RING *
+InternalStatusCodeGetCpuRing (
+  IN CONST STATUS_CODE_RING_HEADER  *Ring,
+  IN UINT32                         CpuIndex
+  )
+{
+  return (STATUS_CODE_CPU_RING *) (Ring + 1) + CpuIndex;
+}
+
+/**
+  Returns an entry of the ring of a processor.
+
+  @param  Ring      The ring header.
+  @param  CpuIndex  The index of the processor.
+  @param  Index     The free running index of the entry.
+
+  @return The entry.
+
+**/
+STATUS_CODE_RING_ENTRY *
+InternalStatusCodeGetEntry (
+  IN CONST STATUS_CODE_RING_HEADER  *Ring,
+  IN UINT32                         CpuIndex,
+  IN UINT32                         Index
+  )
+{
+  STATUS_CODE_RING_ENTRY  *Entries;
+
+  Entries = (STATUS_CODE_RING_ENTRY *) ((STATUS_CODE_CPU_RING *) (Ring + 1) + Ring->CpuCount);
+  return Entries + (UINTN) CpuIndex * Ring->EntriesPerCpu + (Index & (Ring->EntriesPerCpu - 1));
+}
+
+/**
+  Returns the number of ticks of the performance counter since its first value.
+
+  @param  Ring      The ring header.
+
+  @return The ticks since CounterStart, less than CounterPeriod.
+
+**/
+UINT64
+InternalStatusCodeGetCounterTicks (
+  IN CONST STATUS_CODE_RING_HEADER  *Ring
+  )
+{
+  UINT64  Counter;
+
+  Counter = GetPerformanceCounter ();
+  return (Ring->CountsDown != 0) ? Ring->CounterStart - Counter : Counter - Ring->CounterStart;
+}
+
+/**
+  Returns the current timestamp.
+
+  The ticks since the latest timestamp are added to it, modulo the period of the
+  performance counter, which extends the counter to 64 bits across its wraps
+  around as long as timestamps are taken at least once per period. A counter value
+  in the last eighth of the period after the latest timestamp is taken to be a
+  read behind it, such as on a processor whose counter lags a little, and returns
+  the latest timestamp.
+
+  @param  Ring      The ring header.
+
+  @return The timestamp.
+
+**/
+UINT64
+InternalStatusCodeGetTimestamp (
+  IN OUT STATUS_CODE_RING_HEADER  *Ring
+  )
+{
+  UINT64  Last;
+  UINT64  LastTicks;
+  UINT64  Ticks;
+  UINT64  Elapsed;
+  UINT64  Slack;
+
+  Slack = (Ring->CounterPeriod == 0) ? LShiftU64 (1, 61) : RShiftU64 (Ring->CounterPeriod, 3);
+
+  do {
+    //
+    // The counter is read after the latest timestamp, so that a nested producer
+    // that takes a timestamp in between makes the exchange below fail.
+    //
+    Last = Ring->LastTimestamp;
+    MemoryFence ();
+    Ticks = InternalStatusCodeGetCounterTicks (Ring);
+
+    LastTicks = Last;
+    if (Ring->CounterPeriod != 0) {
+      DivU64x64Remainder (Last, Ring->CounterPeriod, &LastTicks);
+    }
+    Elapsed = Ticks - LastTicks;
+    if (Ticks < LastTicks) {
+      Elapsed += Ring->CounterPeriod;
+    }
+
+    //
+    // CounterPeriod - Slack wraps around to 2^64 - Slack when CounterPeriod is 0.
+    //
+    if (Elapsed == 0 || Elapsed >= Ring->CounterPeriod - Slack) {
+      return Last;
+    }
+  } while (InterlockedCompareExchange64 (&Ring->LastTimestamp, Last, Last + Elapsed) != Last);
+
+  return Last + Elapsed;
+}
+
+/**
+  Returns the size of the memory needed for the rings.
+
+  @param  CpuCount        The number of processors.
+  @param  EntriesPerCpu   The number of entries of each ring. It must be a power of two.
+
+  @return The size in bytes, or 0 if a parameter is not valid.
+
+**/
+UINTN
+EFIAPI
+StatusCodeRingGetSize (
+  IN UINT32  CpuCount,
+  IN UINT32  EntriesPerCpu
+  )
+{
+  UINT64  Size;
+
+  if (CpuCount == 0 || EntriesPerCpu == 0 || (EntriesPerCpu & (EntriesPerCpu - 1)) != 0) {
+    return 0;
+  }
+
+  Size = sizeof (STATUS_CODE_RING_HEADER) +
+         MultU64x32 (sizeof (STATUS_CODE_CPU_RING), CpuCount) +
+         MultU64x32 (MultU64x32 (sizeof (STATUS_CODE_RING_ENTRY), CpuCount), EntriesPerCpu);
+  if (Size > MAX_ADDRESS) {
+    return 0;
+  }
+
+  return (UINTN) Size;
+}
+
+/**
+  Initializes the rings in caller supplied memory.
+
+  @param  Buffer          The memory for the rings, aligned on 8 bytes.
+  @param  BufferSize      The size of Buffer.
+  @param  CpuCount        The number of processors.
+  @param  EntriesPerCpu   The number of entries of each ring. It must be a power of two.
+
+  @return The ring header, or NULL if the parameters are not valid or Buffer is too small.
+
+**/
+STATUS_CODE_RING_HEADER *
+EFIAPI
+StatusCodeRingInitialize (
+  OUT VOID    *Buffer,
+  IN  UINTN   BufferSize,
+  IN  UINT32  CpuCount,
+  IN  UINT32  EntriesPerCpu
+  )
+{
+  STATUS_CODE_RING_HEADER  *Ring;
+  UINTN                    Size;
+  UINT64                   StartValue;
+  UINT64                   EndValue;
+
+  Size = StatusCodeRingGetSize (CpuCount, EntriesPerCpu);
+  if (Buffer == NULL || Size == 0 || BufferSize < Size) {
+    return NULL;
+  }
+
+  ZeroMem (Buffer, Size);
+
+  Ring                 = Buffer;
+  Ring->Signature      = STATUS_CODE_RING_SIGNATURE;
+  Ring->CpuCount       = CpuCount;
+  Ring->EntriesPerCpu  = EntriesPerCpu;
+  Ring->Frequency      = GetPerformanceCounterProperties (&StartValue, &EndValue);
+  Ring->CountsDown     = (UINT32) (EndValue < StartValue);
+  Ring->CounterStart   = StartValue;
+  Ring->CounterPeriod  = ((EndValue < StartValue) ? StartValue - EndValue : EndValue - StartValue) + 1;
+  Ring->StartTimestamp = InternalStatusCodeGetCounterTicks (Ring);
+  Ring->LastTimestamp  = Ring->StartTimestamp;
+
+  return Ring;
+}
+
+/**
+  Captures a status code into the ring of a processor.
+
+  A producer claims an entry by advancing Reserve, fills it and then publishes it
+  by setting its Sequence. A nested producer on the same processor simply claims
+  the next entry, so no lock is held while the entry is filled.
+
+  @param  Ring        The ring header.
+  @param  CpuIndex    The index of the calling processor.
+  @param  CodeType    The type of the status code.
+  @param  Value       The value of the status code.
+  @param  Instance    The instance of the status code.
+  @param  CallerId    An optional GUID identifying the caller.
+
+  @retval RETURN_SUCCESS            The status code was captured.
+  @retval RETURN_INVALID_PARAMETER  CpuIndex is not valid.
+  @retval RETURN_OUT_OF_RESOURCES   The ring is full and the status code was dropped.
+
+**/
+RETURN_STATUS
+EFIAPI
+StatusCodeRingRecord (
+  IN OUT STATUS_CODE_RING_HEADER  *Ring,
+  IN     UINT32                   CpuIndex,
+  IN     EFI_STATUS_CODE_TYPE     CodeType,
+  IN     EFI_STATUS_CODE_VALUE    Value,
+  IN     UINT32                   Instance,
+  IN     CONST EFI_GUID           *CallerId  OPTIONAL
+  )
+{
+  STATUS_CODE_CPU_RING    *CpuRing;
+  STATUS_CODE_RING_ENTRY  *Entry;
+  UINT32                  Index;
+
+  ASSERT (Ring != NULL && Ring->Signature == STATUS_CODE_RING_SIGNATURE);
+
+  if (CpuIndex >= Ring->CpuCount) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  CpuRing = InternalStatusCodeGetCpuRing (Ring, CpuIndex);
+  do {
+    Index = CpuRing->Reserve;
+    if (Index - CpuRing->Tail >= Ring->EntriesPerCpu) {
+      InterlockedIncrement (&CpuRing->Dropped);
+      return RETURN_OUT_OF_RESOURCES;
+    }
+  } while (InterlockedCompareExchange32 (&CpuRing->Reserve, Index, Index + 1) != Index);
+
+  Entry            = InternalStatusCodeGetEntry (Ring, CpuIndex, Index);
+  Entry->Timestamp = InternalStatusCodeGetTimestamp (Ring);
+  Entry->CodeType  = CodeType;
+  Entry->Value     = Value;
+  Entry->Instance  = Instance;
+  Entry->CpuIndex  = CpuIndex;
+  if (CallerId != NULL) {
+    CopyGuid (&Entry->CallerId, CallerId);
+  } else {
+    ZeroMem (&Entry->CallerId, sizeof (EFI_GUID));
+  }
+
+  //
+  // Publish the entry only once all of its fields are visible.
+  //
+  MemoryFence ();
+  Entry->Sequence = Index + 1;
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Drains the completed entries of all rings, merged by timestamp.
+
+  The entry to drain next is the oldest of the heads of the rings. The entries of a
+  ring are not strictly in timestamp order, since a nested producer may take its
+  timestamp before the producer it interrupted, so neither is the drain. A ring
+  whose head is claimed but not yet complete is skipped until a later drain.
+
+  @param  Ring        The ring header.
+  @param  Callback    The function called for each entry.
+  @param  Context     The context passed to Callback.
+
+  @return The number of entries drained.
+
+**/
+UINTN
+EFIAPI
+StatusCodeRingDrain (
+  IN OUT STATUS_CODE_RING_HEADER          *Ring,
+  IN     STATUS_CODE_RING_DRAIN_CALLBACK  Callback,
+  IN     VOID                             *Context
+  )
+{
+  STATUS_CODE_CPU_RING    *CpuRing;
+  STATUS_CODE_RING_ENTRY  *Entry;
+  STATUS_CODE_RING_ENTRY  *Oldest;
+  UINT32                  OldestCpu;
+  UINT32                  CpuIndex;
+  UINT32                  Tail;
+  UINTN                   Count;
+
+  ASSERT (Ring != NULL && Ring->Signature == STATUS_CODE_RING_SIGNATURE);
+  ASSERT (Callback != NULL);
+
+  Count = 0;
+  for (;;) {
+    Oldest    = NULL;
+    OldestCpu = 0;
+    for (CpuIndex = 0; CpuIndex < Ring->CpuCount; CpuIndex++) {
+      Tail  = InternalStatusCodeGetCpuRing (Ring, CpuIndex)->Tail;
+      Entry = InternalStatusCodeGetEntry (Ring, CpuIndex, Tail);
+      if (Entry->Sequence != Tail + 1) {
+        continue;
+      }
+      if (Oldest == NULL || Entry->Timestamp < Oldest->Timestamp) {
+        Oldest    = Entry;
+        OldestCpu = CpuIndex;
+      }
+    }
+
+    if (Oldest == NULL) {
+      return Count;
+    }
+
+    //
+    // Read the fields only after Sequence, and release the entry to the producers
+    // only after the callback is done with it.
+    //
+    MemoryFence ();
+    Callback (Context, Ring, Oldest);
+    MemoryFence ();
+
+    CpuRing       = InternalStatusCodeGetCpuRing (Ring, OldestCpu);
+    CpuRing->Tail = CpuRing->Tail + 1;
+    Count++;
+  }
+}
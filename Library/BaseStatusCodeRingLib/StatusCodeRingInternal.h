@@ -0,0 +1,39 @@
+/** @file
+  Internal definitions of the status code ring library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _STATUS_CODE_RING_INTERNAL_H_
+#define _STATUS_CODE_RING_INTERNAL_H_
+
+#include <PiDxe.h>
+
+#include <Framework/StatusCode.h>
+
+#include <Library/StatusCodeRingLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PrintLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/TimerLib.h>
+
+///
+/// Name of a status code value of one type.
+///
+typedef struct {
+  EFI_STATUS_CODE_TYPE    CodeType;
+  EFI_STATUS_CODE_VALUE   Value;
+  CONST CHAR8             *Name;
+} STATUS_CODE_NAME;
+
+#endif
@@ -0,0 +1,402 @@
+/** @file
+  Mailbox dispatch library for the application processors.
+
+  Every mailbox is a ring of work items with two counters: Posted, written by the
+  BSP once the item is in the ring, and Completed, written by the application
+  processor once the item has run. The counters only grow, so the ticket of an
+  item is the value Completed reaches when the item is done, and neither side
+  needs a lock.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "ApMailboxInternal.h"
+
+/**
+  Runs the work items of a mailbox on an application processor until the pool
+  is stopped.
+
+  @param  Buffer    The mailbox pool.
+
+**/
+VOID
+EFIAPI
+InternalApMailboxApProcedure (
+  IN VOID  *Buffer
+  )
+{
+  AP_MAILBOX_POOL  *Pool;
+  AP_MAILBOX       *Mailbox;
+  AP_MAILBOX_ITEM  *Item;
+  UINT32           Posted;
+  UINT32           Completed;
+  UINTN            Index;
+
+  Pool  = (AP_MAILBOX_POOL *) Buffer;
+  Index = InterlockedIncrement (&Pool->NextMailbox) - 1;
+  if (Index >= Pool->Capacity) {
+    return;
+  }
+  Mailbox   = AP_MAILBOX_AT (Pool, Index);
+  Completed = Mailbox->Completed;
+
+  //
+  // The work items posted before Stop are run before the processor returns.
+  //
+  for (;;) {
+    Posted = Mailbox->Request.Posted;
+    if (Posted != Completed) {
+      Item = &Mailbox->Items[Completed % AP_MAILBOX_DEPTH];
+      Item->Procedure (Item->Argument);
+      MemoryFence ();
+      Mailbox->Completed = ++Completed;
+    } else if (Mailbox->Request.Stop) {
+      break;
+    } else if (Pool->Monitor) {
+      InternalApMailboxMonitorWait (&Mailbox->Request, Posted);
+    } else {
+      CpuPause ();
+    }
+  }
+}
+
+/**
+  Frees a mailbox pool.
+
+  @param  Pool    The mailbox pool.
+
+**/
+VOID
+InternalApMailboxFree (
+  IN AP_MAILBOX_POOL  *Pool
+  )
+{
+  if (Pool->ApDone != NULL) {
+    gBS->CloseEvent (Pool->ApDone);
+  }
+  if (Pool->Mailboxes != NULL) {
+    FreePages (Pool->Mailboxes, Pool->Pages);
+  }
+  Pool->Signature = 0;
+  FreePool (Pool);
+}
+
+/**
+  Starts the application processors in their worker loop.
+
+  The function returns once the enabled application processors have reached their
+  loop, or after a second if some never do; the processors that did are given the
+  mailboxes from 0 to the Mailboxes counter minus 1.
+
+  @param  MpServices    The MP Services Protocol.
+  @param  WaitMode      How the application processors wait for work items.
+  @param  Pool          Returns the mailbox pool.
+
+  @retval EFI_SUCCESS             The application processors were started.
+  @retval EFI_INVALID_PARAMETER   MpServices or Pool is NULL, or WaitMode is not valid.
+  @retval EFI_NOT_FOUND           There is no enabled application processor.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+  @retval Others                  The status returned by StartupAllAPs().
+
+**/
+EFI_STATUS
+EFIAPI
+ApMailboxStart (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices,
+  IN  AP_MAILBOX_WAIT_MODE                WaitMode,
+  OUT AP_MAILBOX_POOL                     **Pool
+  )
+{
+  EFI_STATUS       Status;
+  AP_MAILBOX_POOL  *Instance;
+  UINTN            EnabledCount;
+  UINTN            Elapsed;
+
+  if (MpServices == NULL || Pool == NULL || WaitMode >= ApMailboxWaitMaximum) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = MpServices->GetGeneralMPInfo (MpServices, NULL, NULL, &EnabledCount, NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (EnabledCount < 2) {
+    return EFI_NOT_FOUND;
+  }
+
+  Instance = AllocateZeroPool (sizeof (AP_MAILBOX_POOL));
+  if (Instance == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Instance->Signature   = AP_MAILBOX_POOL_SIGNATURE;
+  Instance->MpServices  = MpServices;
+  Instance->Monitor     = (BOOLEAN) (WaitMode == ApMailboxWaitMonitor && InternalApMailboxMonitorSupported ());
+  Instance->Capacity    = EnabledCount - 1;
+  Instance->MailboxSize = ALIGN_VALUE (sizeof (AP_MAILBOX), AP_MAILBOX_CACHE_LINE_SIZE);
+  Instance->Pages       = EFI_SIZE_TO_PAGES (Instance->Capacity * Instance->MailboxSize);
+  Instance->Mailboxes   = AllocatePages (Instance->Pages);
+  if (Instance->Mailboxes == NULL) {
+    InternalApMailboxFree (Instance);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  ZeroMem (Instance->Mailboxes, EFI_PAGES_TO_SIZE (Instance->Pages));
+
+  Status = gBS->CreateEvent (0, TPL_NOTIFY, NULL, NULL, &Instance->ApDone);
+  if (EFI_ERROR (Status)) {
+    Instance->ApDone = NULL;
+    InternalApMailboxFree (Instance);
+    return Status;
+  }
+
+  //
+  // EFI_TIMEOUT is the expected result: the application processors stay in their
+  // loop and signal ApDone once they are stopped.
+  //
+  Status = MpServices->StartupAllAPs (
+                         MpServices,
+                         InternalApMailboxApProcedure,
+                         FALSE,
+                         Instance->ApDone,
+                         AP_MAILBOX_DISPATCH_TIMEOUT,
+                         Instance,
+                         NULL
+                         );
+  if (Status != EFI_TIMEOUT) {
+    if (!EFI_ERROR (Status)) {
+      Status = EFI_NOT_FOUND;
+    }
+    DEBUG ((DEBUG_ERROR, "ApMailboxLib: StartupAllAPs() failed - %r\n", Status));
+    InternalApMailboxFree (Instance);
+    return Status;
+  }
+  Instance->Waiting = TRUE;
+
+  for (Elapsed = 0; Instance->NextMailbox < Instance->Capacity && Elapsed < AP_MAILBOX_START_TIMEOUT; Elapsed += AP_MAILBOX_START_POLL_INTERVAL) {
+    MicroSecondDelay (AP_MAILBOX_START_POLL_INTERVAL);
+  }
+  Instance->Count = MIN (Instance->NextMailbox, Instance->Capacity);
+  if (Instance->Count < Instance->Capacity) {
+    DEBUG ((DEBUG_WARN, "ApMailboxLib: %d of %d APs reached their loop\n", Instance->Count, Instance->Capacity));
+  }
+
+  *Pool = Instance;
+  return EFI_SUCCESS;
+}
+
+/**
+  Stops the application processors, once they have run the work items posted to
+  them, and frees the mailbox pool.
+
+  @param  Pool    The mailbox pool.
+
+**/
+VOID
+EFIAPI
+ApMailboxStop (
+  IN AP_MAILBOX_POOL  *Pool
+  )
+{
+  UINTN  Index;
+
+  if (Pool == NULL) {
+    return;
+  }
+  ASSERT (Pool->Signature == AP_MAILBOX_POOL_SIGNATURE);
+
+  //
+  // The mailboxes of the processors that came late are stopped too.
+  //
+  for (Index = 0; Index < Pool->Capacity; Index++) {
+    AP_MAILBOX_AT (Pool, Index)->Request.Stop = TRUE;
+  }
+  if (Pool->Waiting) {
+    while (gBS->CheckEvent (Pool->ApDone) == EFI_NOT_READY) {
+      CpuPause ();
+    }
+  }
+  InternalApMailboxFree (Pool);
+}
+
+/**
+  Returns the number of mailboxes, one per application processor.
+
+  @param  Pool    The mailbox pool.
+
+  @return The number of mailboxes.
+
+**/
+UINTN
+EFIAPI
+ApMailboxGetCount (
+  IN AP_MAILBOX_POOL  *Pool
+  )
+{
+  ASSERT (Pool != NULL && Pool->Signature == AP_MAILBOX_POOL_SIGNATURE);
+  return Pool->Count;
+}
+
+/**
+  Posts a work item to a mailbox. The items of a mailbox are run in the order they
+  were posted.
+
+  @param  Pool        The mailbox pool.
+  @param  Mailbox     The mailbox.
+  @param  Procedure   The work item.
+  @param  Argument    The argument of the work item.
+  @param  Ticket      Returns the ticket of the work item, for ApMailboxIsDone() and
+                      ApMailboxWait().
+
+  @retval EFI_SUCCESS             The work item was posted.
+  @retval EFI_INVALID_PARAMETER   Procedure is NULL, or Mailbox does not exist.
+  @retval EFI_NOT_READY           The mailbox is full.
+
+**/
+EFI_STATUS
+EFIAPI
+ApMailboxPost (
+  IN  AP_MAILBOX_POOL             *Pool,
+  IN  UINTN                       Mailbox,
+  IN  FRAMEWORK_EFI_AP_PROCEDURE  Procedure,
+  IN  VOID                        *Argument  OPTIONAL,
+  OUT UINT32                      *Ticket    OPTIONAL
+  )
+{
+  AP_MAILBOX       *Box;
+  AP_MAILBOX_ITEM  *Item;
+  UINT32           Posted;
+
+  ASSERT (Pool != NULL && Pool->Signature == AP_MAILBOX_POOL_SIGNATURE);
+  if (Procedure == NULL || Mailbox >= Pool->Count) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Box    = AP_MAILBOX_AT (Pool, Mailbox);
+  Posted = Box->Request.Posted;
+  if (Posted - Box->Completed >= AP_MAILBOX_DEPTH) {
+    Pool->Refused++;
+    return EFI_NOT_READY;
+  }
+
+  Item            = &Box->Items[Posted % AP_MAILBOX_DEPTH];
+  Item->Procedure = Procedure;
+  Item->Argument  = Argument;
+  MemoryFence ();
+  Box->Request.Posted = Posted + 1;
+
+  Pool->Posted++;
+  if (Ticket != NULL) {
+    *Ticket = Posted + 1;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Checks whether a work item has completed.
+
+  @param  Pool      The mailbox pool.
+  @param  Mailbox   The mailbox of the work item.
+  @param  Ticket    The ticket of the work item.
+
+  @retval TRUE    The work item has completed.
+  @retval FALSE   The work item has not completed.
+
+**/
+BOOLEAN
+EFIAPI
+ApMailboxIsDone (
+  IN AP_MAILBOX_POOL  *Pool,
+  IN UINTN            Mailbox,
+  IN UINT32           Ticket
+  )
+{
+  ASSERT (Pool != NULL && Mailbox < Pool->Count);
+  return (BOOLEAN) ((INT32) (AP_MAILBOX_AT (Pool, Mailbox)->Completed - Ticket) >= 0);
+}
+
+/**
+  Waits for a work item to complete.
+
+  @param  Pool      The mailbox pool.
+  @param  Mailbox   The mailbox of the work item.
+  @param  Ticket    The ticket of the work item.
+
+**/
+VOID
+EFIAPI
+ApMailboxWait (
+  IN AP_MAILBOX_POOL  *Pool,
+  IN UINTN            Mailbox,
+  IN UINT32           Ticket
+  )
+{
+  while (!ApMailboxIsDone (Pool, Mailbox, Ticket)) {
+    CpuPause ();
+  }
+}
+
+/**
+  Waits for all the work items posted to all the mailboxes to complete.
+
+  @param  Pool    The mailbox pool.
+
+**/
+VOID
+EFIAPI
+ApMailboxWaitAll (
+  IN AP_MAILBOX_POOL  *Pool
+  )
+{
+  AP_MAILBOX  *Box;
+  UINTN       Index;
+
+  ASSERT (Pool != NULL && Pool->Signature == AP_MAILBOX_POOL_SIGNATURE);
+  for (Index = 0; Index < Pool->Count; Index++) {
+    Box = AP_MAILBOX_AT (Pool, Index);
+    while (Box->Completed != Box->Request.Posted) {
+      CpuPause ();
+    }
+  }
+}
+
+/**
+  Returns the counters of a mailbox pool.
+
+  @param  Pool          The mailbox pool.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   Pool or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+ApMailboxGetStatistics (
+  IN  AP_MAILBOX_POOL        *Pool,
+  OUT AP_MAILBOX_STATISTICS  *Statistics
+  )
+{
+  UINTN  Index;
+
+  if (Pool == NULL || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  ASSERT (Pool->Signature == AP_MAILBOX_POOL_SIGNATURE);
+
+  ZeroMem (Statistics, sizeof (AP_MAILBOX_STATISTICS));
+  Statistics->Mailboxes = Pool->Count;
+  Statistics->Monitor   = Pool->Monitor;
+  Statistics->Posted    = Pool->Posted;
+  Statistics->Refused   = Pool->Refused;
+  for (Index = 0; Index < Pool->Count; Index++) {
+    Statistics->Completed += AP_MAILBOX_AT (Pool, Index)->Completed;
+  }
+  return EFI_SUCCESS;
+}
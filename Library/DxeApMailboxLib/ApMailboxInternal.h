@@ -0,0 +1,120 @@
+/** @file
+  Internal definitions of the mailbox dispatch library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _AP_MAILBOX_INTERNAL_H_
+#define _AP_MAILBOX_INTERNAL_H_
+
+#include <FrameworkDxe.h>
+
+#include <Protocol/FrameworkMpService.h>
+
+#include <Library/ApMailboxLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#define AP_MAILBOX_POOL_SIGNATURE  SIGNATURE_32 ('A', 'P', 'M', 'B')
+
+#define AP_MAILBOX_CACHE_LINE_SIZE  64
+
+///
+/// Timeout given to StartupAllAPs(), after which the BSP goes on while the
+/// application processors stay in their worker loop.
+///
+#define AP_MAILBOX_DISPATCH_TIMEOUT  1
+
+///
+/// Time the BSP waits for the application processors to reach their worker loop,
+/// in microseconds.
+///
+#define AP_MAILBOX_START_TIMEOUT  1000000
+
+#define AP_MAILBOX_START_POLL_INTERVAL  10
+
+typedef struct {
+  FRAMEWORK_EFI_AP_PROCEDURE  Procedure;
+  VOID                        *Argument;
+} AP_MAILBOX_ITEM;
+
+///
+/// The part of a mailbox written by the BSP, which the application processor
+/// monitors.
+///
+typedef struct {
+  volatile UINT32   Posted;         ///< Work items posted since the start.
+  volatile BOOLEAN  Stop;
+} AP_MAILBOX_REQUEST;
+
+///
+/// A mailbox. The request, the completion counter and the work items are on
+/// separate cache lines, so that the BSP and the application processor each write
+/// lines of their own.
+///
+typedef struct {
+  AP_MAILBOX_REQUEST  Request;
+  UINT8               RequestPad[AP_MAILBOX_CACHE_LINE_SIZE - sizeof (AP_MAILBOX_REQUEST)];
+  volatile UINT32     Completed;    ///< Work items completed, written by the application processor.
+  UINT8               CompletedPad[AP_MAILBOX_CACHE_LINE_SIZE - sizeof (UINT32)];
+  AP_MAILBOX_ITEM     Items[AP_MAILBOX_DEPTH];
+} AP_MAILBOX;
+
+struct _AP_MAILBOX_POOL {
+  UINT32                              Signature;
+  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  EFI_EVENT                           ApDone;         ///< Signaled when the application processors return.
+  BOOLEAN                             Waiting;        ///< The application processors have not returned.
+  BOOLEAN                             Monitor;        ///< The application processors wait in MWAIT.
+  UINTN                               Capacity;       ///< Mailboxes allocated, one per enabled AP.
+  UINTN                               Count;          ///< Mailboxes served.
+  UINTN                               MailboxSize;
+  UINT8                               *Mailboxes;
+  UINTN                               Pages;
+  volatile UINT32                     NextMailbox;    ///< Mailboxes taken by the application processors.
+  UINT64                              Posted;
+  UINT64                              Refused;
+};
+
+#define AP_MAILBOX_AT(Pool, Index) \
+  ((AP_MAILBOX *) ((Pool)->Mailboxes + (Index) * (Pool)->MailboxSize))
+
+/**
+  Checks whether the processor supports MONITOR/MWAIT.
+
+  @retval TRUE    MONITOR/MWAIT is supported.
+  @retval FALSE   MONITOR/MWAIT is not supported.
+
+**/
+BOOLEAN
+InternalApMailboxMonitorSupported (
+  VOID
+  );
+
+/**
+  Sleeps until the request of a mailbox is written, unless it has already changed.
+
+  @param  Request   The request.
+  @param  Posted    The Posted counter the caller has seen.
+
+**/
+VOID
+InternalApMailboxMonitorWait (
+  IN AP_MAILBOX_REQUEST  *Request,
+  IN UINT32              Posted
+  );
+
+#endif
@@ -0,0 +1,55 @@
+/** @file
+  MONITOR/MWAIT wait of the mailbox dispatch library for IA32 and X64.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "ApMailboxInternal.h"
+
+/**
+  Checks whether the processor supports MONITOR/MWAIT.
+
+  @retval TRUE    MONITOR/MWAIT is supported.
+  @retval FALSE   MONITOR/MWAIT is not supported.
+
+**/
+BOOLEAN
+InternalApMailboxMonitorSupported (
+  VOID
+  )
+{
+  UINT32  RegEcx;
+
+  AsmCpuid (1, NULL, NULL, &RegEcx, NULL);
+  return (BOOLEAN) ((RegEcx & BIT3) != 0);
+}
+
+/**
+  Sleeps until the request of a mailbox is written, unless it has already changed.
+
+  The request is checked again once the monitor is armed, so that a write that
+  comes before MWAIT is not missed.
+
+  @param  Request   The request.
+  @param  Posted    The Posted counter the caller has seen.
+
+**/
+VOID
+InternalApMailboxMonitorWait (
+  IN AP_MAILBOX_REQUEST  *Request,
+  IN UINT32              Posted
+  )
+{
+  AsmMonitor ((UINTN) Request, 0, 0);
+  if (Request->Posted == Posted && !Request->Stop) {
+    AsmMwait (0, 0);
+  }
+}
@@ -0,0 +1,315 @@
+/** @file
+  Scheduler of the task-parallel library.
+
+  The application processors are started once per run with StartupAllAPs() and a
+  short timeout, so that the call returns EFI_TIMEOUT while they keep looking for
+  tasks. The BSP runs the root task meanwhile, then tells them to stop and waits
+  for the completion event of the MP Services Protocol.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "ApTaskInternal.h"
+
+/**
+  Runs tasks on an application processor until the root task has finished.
+
+  @param  Buffer    The scheduler.
+
+**/
+VOID
+EFIAPI
+InternalApTaskApProcedure (
+  IN VOID  *Buffer
+  )
+{
+  AP_TASK_SCHEDULER  *Scheduler;
+  AP_TASK_WORKER     *Worker;
+  AP_TASK            Task;
+  UINTN              Index;
+
+  Scheduler = (AP_TASK_SCHEDULER *) Buffer;
+
+  //
+  // The BSP is worker 0. A processor enabled since the scheduler was created has
+  // no worker and does not take part.
+  //
+  Index = InterlockedIncrement (&Scheduler->NextWorker);
+  if (Index >= Scheduler->WorkerCount) {
+    return;
+  }
+  Worker = AP_TASK_WORKER_AT (Scheduler, Index);
+
+  while (!Scheduler->Done) {
+    if (InternalApTaskFind (Worker, &Task)) {
+      InternalApTaskExecute (Worker, &Task);
+    } else {
+      CpuPause ();
+    }
+  }
+}
+
+/**
+  Creates a scheduler.
+
+  The deques are allocated here, so that running tasks needs no memory allocation.
+
+  @param  MpServices    The MP Services Protocol used to start the application
+                        processors, or NULL to run the tasks on the calling
+                        processor only.
+  @param  DequeSize     The number of tasks that the deque of a processor holds,
+                        rounded up to a power of 2, or 0 for
+                        AP_TASK_DEFAULT_DEQUE_SIZE.
+  @param  Scheduler     Returns the scheduler.
+
+  @retval EFI_SUCCESS             The scheduler was created.
+  @retval EFI_INVALID_PARAMETER   Scheduler is NULL.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+ApTaskCreate (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices  OPTIONAL,
+  IN  UINTN                               DequeSize,
+  OUT AP_TASK_SCHEDULER                   **Scheduler
+  )
+{
+  EFI_STATUS         Status;
+  AP_TASK_SCHEDULER  *Instance;
+  AP_TASK_WORKER     *Worker;
+  UINTN              WorkerCount;
+  UINTN              DequeBytes;
+  UINTN              Index;
+  UINT8              *Deques;
+
+  if (Scheduler == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (DequeSize == 0) {
+    DequeSize = AP_TASK_DEFAULT_DEQUE_SIZE;
+  }
+  if (DequeSize > MAX_UINTN / 2 / sizeof (AP_TASK)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  DequeSize = (UINTN) GetPowerOfTwo64 ((UINT64) (DequeSize - 1) * 2);
+  DequeSize = MAX (DequeSize, 1);
+
+  WorkerCount = 1;
+  if (MpServices != NULL) {
+    Status = MpServices->GetGeneralMPInfo (MpServices, NULL, NULL, &WorkerCount, NULL, NULL);
+    if (EFI_ERROR (Status) || WorkerCount == 0) {
+      DEBUG ((DEBUG_WARN, "ApTaskLib: GetGeneralMPInfo() failed - %r\n", Status));
+      WorkerCount = 1;
+    }
+    if (WorkerCount == 1) {
+      MpServices = NULL;
+    }
+  }
+
+  Instance = AllocateZeroPool (sizeof (AP_TASK_SCHEDULER));
+  if (Instance == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Instance->Signature   = AP_TASK_SCHEDULER_SIGNATURE;
+  Instance->MpServices  = MpServices;
+  Instance->WorkerCount = WorkerCount;
+  Instance->WorkerSize  = ALIGN_VALUE (sizeof (AP_TASK_WORKER), AP_TASK_CACHE_LINE_SIZE);
+  Instance->DequeMask   = DequeSize - 1;
+
+  //
+  // The workers, then their deques, in pages so that the workers start on cache
+  // line boundaries.
+  //
+  DequeBytes       = ALIGN_VALUE (DequeSize * sizeof (AP_TASK), AP_TASK_CACHE_LINE_SIZE);
+  Instance->Pages  = EFI_SIZE_TO_PAGES (WorkerCount * (Instance->WorkerSize + DequeBytes));
+  Instance->Memory = AllocatePages (Instance->Pages);
+  if (Instance->Memory == NULL) {
+    FreePool (Instance);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  ZeroMem (Instance->Memory, EFI_PAGES_TO_SIZE (Instance->Pages));
+  Instance->Workers = Instance->Memory;
+  Deques            = Instance->Workers + WorkerCount * Instance->WorkerSize;
+  for (Index = 0; Index < WorkerCount; Index++) {
+    Worker            = AP_TASK_WORKER_AT (Instance, Index);
+    Worker->Tasks     = (AP_TASK *) (Deques + Index * DequeBytes);
+    Worker->Scheduler = Instance;
+    Worker->Index     = Index;
+    Worker->Seed      = (UINT32) (Index * 0x9E3779B9 + 1);
+    InitializeSpinLock (&Worker->Lock);
+  }
+
+  if (MpServices != NULL) {
+    Status = gBS->CreateEvent (0, TPL_NOTIFY, NULL, NULL, &Instance->ApDone);
+    if (EFI_ERROR (Status)) {
+      FreePages (Instance->Memory, Instance->Pages);
+      FreePool (Instance);
+      return Status;
+    }
+  }
+
+  *Scheduler = Instance;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees a scheduler created by ApTaskCreate().
+
+  @param  Scheduler   The scheduler, which must not be running.
+
+**/
+VOID
+EFIAPI
+ApTaskDestroy (
+  IN AP_TASK_SCHEDULER  *Scheduler
+  )
+{
+  if (Scheduler == NULL) {
+    return;
+  }
+  ASSERT (Scheduler->Signature == AP_TASK_SCHEDULER_SIGNATURE);
+  ASSERT (!Scheduler->Running);
+
+  if (Scheduler->ApDone != NULL) {
+    gBS->CloseEvent (Scheduler->ApDone);
+  }
+  FreePages (Scheduler->Memory, Scheduler->Pages);
+  Scheduler->Signature = 0;
+  FreePool (Scheduler);
+}
+
+/**
+  Runs a root task on the BSP, and the tasks it spawns on all the processors.
+
+  The application processors are started with StartupAllAPs() and a timeout, so
+  that the BSP goes on with the root task while they work. If they cannot be
+  started, the BSP runs all the tasks. The function returns once the root task has
+  returned and the application processors have stopped. It must be called on the
+  BSP at a TPL that lets the MP Services Protocol signal its completion event.
+
+  @param  Scheduler   The scheduler.
+  @param  Procedure   The root task.
+  @param  Context     The context of the root task.
+
+  @retval EFI_SUCCESS             The tasks were run.
+  @retval EFI_INVALID_PARAMETER   Scheduler or Procedure is NULL.
+  @retval EFI_ALREADY_STARTED     The scheduler is already running.
+
+**/
+EFI_STATUS
+EFIAPI
+ApTaskRun (
+  IN AP_TASK_SCHEDULER  *Scheduler,
+  IN AP_TASK_PROCEDURE  Procedure,
+  IN VOID               *Context  OPTIONAL
+  )
+{
+  EFI_STATUS      Status;
+  AP_TASK_WORKER  *Worker;
+  BOOLEAN         Waiting;
+  UINTN           Index;
+
+  if (Scheduler == NULL || Procedure == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  ASSERT (Scheduler->Signature == AP_TASK_SCHEDULER_SIGNATURE);
+  if (Scheduler->Running) {
+    return EFI_ALREADY_STARTED;
+  }
+  Scheduler->Running = TRUE;
+  Scheduler->Runs++;
+
+  for (Index = 0; Index < Scheduler->WorkerCount; Index++) {
+    Worker         = AP_TASK_WORKER_AT (Scheduler, Index);
+    Worker->Top    = 0;
+    Worker->Bottom = 0;
+  }
+  Scheduler->NextWorker = 0;
+  Scheduler->Done       = FALSE;
+
+  //
+  // EFI_TIMEOUT is the expected result: the application processors are looking
+  // for tasks and signal ApDone once they have seen Done.
+  //
+  Waiting = FALSE;
+  if (Scheduler->MpServices != NULL) {
+    Status = Scheduler->MpServices->StartupAllAPs (
+                                      Scheduler->MpServices,
+                                      InternalApTaskApProcedure,
+                                      FALSE,
+                                      Scheduler->ApDone,
+                                      AP_TASK_DISPATCH_TIMEOUT,
+                                      Scheduler,
+                                      NULL
+                                      );
+    if (Status == EFI_TIMEOUT || !EFI_ERROR (Status)) {
+      Scheduler->Dispatches++;
+      Waiting = (BOOLEAN) (Status == EFI_TIMEOUT);
+    } else {
+      DEBUG ((DEBUG_WARN, "ApTaskLib: StartupAllAPs() failed - %r\n", Status));
+    }
+  }
+
+  Procedure (AP_TASK_WORKER_AT (Scheduler, 0), Context);
+
+  Scheduler->Done = TRUE;
+  if (Waiting) {
+    while (gBS->CheckEvent (Scheduler->ApDone) == EFI_NOT_READY) {
+      CpuPause ();
+    }
+  }
+
+  Scheduler->Running = FALSE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the counters of a scheduler.
+
+  @param  Scheduler     The scheduler.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   Scheduler or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+ApTaskGetStatistics (
+  IN  AP_TASK_SCHEDULER   *Scheduler,
+  OUT AP_TASK_STATISTICS  *Statistics
+  )
+{
+  AP_TASK_WORKER  *Worker;
+  UINTN           Index;
+
+  if (Scheduler == NULL || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  ASSERT (Scheduler->Signature == AP_TASK_SCHEDULER_SIGNATURE);
+
+  ZeroMem (Statistics, sizeof (AP_TASK_STATISTICS));
+  Statistics->Processors = Scheduler->WorkerCount;
+  Statistics->Runs       = Scheduler->Runs;
+  Statistics->Dispatches = Scheduler->Dispatches;
+  for (Index = 0; Index < Scheduler->WorkerCount; Index++) {
+    Worker                    = AP_TASK_WORKER_AT (Scheduler, Index);
+    Statistics->Tasks        += Worker->TaskCount;
+    Statistics->Steals       += Worker->Steals;
+    Statistics->InlineSpawns += Worker->InlineSpawns;
+    if (Index != 0) {
+      Statistics->ApTasks += Worker->TaskCount;
+    }
+  }
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,351 @@
+/** @file
+  Deques, fork/join and parallel loops of the task-parallel library.
+
+  Every deque has its own spin lock. The owner takes it to push and pop, and a
+  thief only tries to take it, and goes on to the next processor if it is held, so
+  that an idle processor never waits on a busy one. The deques are checked for
+  tasks before their lock is tried.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "ApTaskInternal.h"
+
+/**
+  Pushes a task at the bottom of the deque of a processor.
+
+  @param  Worker    The processor, which must be the calling processor.
+  @param  Task      The task.
+
+  @retval TRUE    The task was pushed.
+  @retval FALSE   The deque is full.
+
+**/
+BOOLEAN
+InternalApTaskPush (
+  IN OUT AP_TASK_WORKER  *Worker,
+  IN     CONST AP_TASK   *Task
+  )
+{
+  UINTN  Mask;
+
+  Mask = Worker->Scheduler->DequeMask;
+  AcquireSpinLock (&Worker->Lock);
+  if (Worker->Bottom - Worker->Top > Mask) {
+    ReleaseSpinLock (&Worker->Lock);
+    return FALSE;
+  }
+  CopyMem (&Worker->Tasks[Worker->Bottom & Mask], Task, sizeof (AP_TASK));
+  Worker->Bottom++;
+  ReleaseSpinLock (&Worker->Lock);
+  return TRUE;
+}
+
+/**
+  Pops the last task pushed on the deque of the calling processor.
+
+  @param  Worker    The calling processor.
+  @param  Task      Returns the task.
+
+  @retval TRUE    A task was popped.
+  @retval FALSE   The deque is empty.
+
+**/
+BOOLEAN
+InternalApTaskPop (
+  IN OUT AP_TASK_WORKER  *Worker,
+  OUT    AP_TASK         *Task
+  )
+{
+  if (Worker->Bottom == Worker->Top) {
+    return FALSE;
+  }
+
+  AcquireSpinLock (&Worker->Lock);
+  if (Worker->Bottom == Worker->Top) {
+    ReleaseSpinLock (&Worker->Lock);
+    return FALSE;
+  }
+  Worker->Bottom--;
+  CopyMem (Task, &Worker->Tasks[Worker->Bottom & Worker->Scheduler->DequeMask], sizeof (AP_TASK));
+  ReleaseSpinLock (&Worker->Lock);
+  return TRUE;
+}
+
+/**
+  Steals the first task of the deque of another processor.
+
+  @param  Victim    The other processor.
+  @param  Task      Returns the task.
+
+  @retval TRUE    A task was stolen.
+  @retval FALSE   The deque is empty, or its lock is held.
+
+**/
+BOOLEAN
+InternalApTaskSteal (
+  IN OUT AP_TASK_WORKER  *Victim,
+  OUT    AP_TASK         *Task
+  )
+{
+  if (Victim->Bottom == Victim->Top || !AcquireSpinLockOrFail (&Victim->Lock)) {
+    return FALSE;
+  }
+  if (Victim->Bottom == Victim->Top) {
+    ReleaseSpinLock (&Victim->Lock);
+    return FALSE;
+  }
+  CopyMem (Task, &Victim->Tasks[Victim->Top & Victim->Scheduler->DequeMask], sizeof (AP_TASK));
+  Victim->Top++;
+  ReleaseSpinLock (&Victim->Lock);
+  return TRUE;
+}
+
+/**
+  Finds a task to run: the last task pushed by the calling processor, or else the
+  first task of the deque of another processor.
+
+  The other processors are tried in turn from one chosen at random, so that the
+  thieves spread over the busy processors.
+
+  @param  Worker    The calling processor.
+  @param  Task      Returns the task.
+
+  @retval TRUE    A task was found.
+  @retval FALSE   All the deques are empty.
+
+**/
+BOOLEAN
+InternalApTaskFind (
+  IN OUT AP_TASK_WORKER  *Worker,
+  OUT    AP_TASK         *Task
+  )
+{
+  AP_TASK_SCHEDULER  *Scheduler;
+  UINTN              Count;
+  UINTN              Victim;
+  UINTN              Index;
+
+  if (InternalApTaskPop (Worker, Task)) {
+    return TRUE;
+  }
+
+  Scheduler = Worker->Scheduler;
+  Count     = Scheduler->WorkerCount;
+  if (Count < 2) {
+    return FALSE;
+  }
+
+  Worker->Seed ^= Worker->Seed << 13;
+  Worker->Seed ^= Worker->Seed >> 17;
+  Worker->Seed ^= Worker->Seed << 5;
+  Victim        = Worker->Seed % Count;
+  for (Index = 0; Index < Count; Index++, Victim = (Victim + 1 == Count) ? 0 : Victim + 1) {
+    if (Victim != Worker->Index && InternalApTaskSteal (AP_TASK_WORKER_AT (Scheduler, Victim), Task)) {
+      Worker->Steals++;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/**
+  Runs the parts of a parallel loop. The upper halves are pushed as tasks until
+  the lower part is small enough, which is then run before waiting for the others.
+
+  @param  Worker      The calling processor.
+  @param  Start       The first index of the range.
+  @param  End         The index that follows the range.
+  @param  Grain       The largest number of indexes of a part.
+  @param  Procedure   The body of the loop.
+  @param  Context     The context of the body.
+
+**/
+VOID
+InternalApTaskParallelFor (
+  IN AP_TASK_WORKER           *Worker,
+  IN UINTN                    Start,
+  IN UINTN                    End,
+  IN UINTN                    Grain,
+  IN AP_TASK_RANGE_PROCEDURE  Procedure,
+  IN VOID                     *Context
+  )
+{
+  AP_TASK_GROUP  Group;
+  AP_TASK        Task;
+  UINTN          Middle;
+
+  Group.Pending = 0;
+  while (End - Start > Grain) {
+    Middle = Start + (End - Start) / 2;
+
+    Task.Procedure      = NULL;
+    Task.RangeProcedure = Procedure;
+    Task.Context        = Context;
+    Task.Group          = &Group;
+    Task.Start          = Middle;
+    Task.End            = End;
+    Task.Grain          = Grain;
+    InterlockedIncrement (&Group.Pending);
+    if (!InternalApTaskPush (Worker, &Task)) {
+      //
+      // The deque is full: the whole rest of the range is run here.
+      //
+      InterlockedDecrement (&Group.Pending);
+      Worker->InlineSpawns++;
+      break;
+    }
+    End = Middle;
+  }
+
+  Procedure (Worker, Context, Start, End);
+  ApTaskSync (Worker, &Group);
+}
+
+/**
+  Runs a task taken from a deque and marks it finished in its group.
+
+  @param  Worker    The calling processor.
+  @param  Task      The task.
+
+**/
+VOID
+InternalApTaskExecute (
+  IN OUT AP_TASK_WORKER  *Worker,
+  IN     CONST AP_TASK   *Task
+  )
+{
+  if (Task->RangeProcedure != NULL) {
+    InternalApTaskParallelFor (Worker, Task->Start, Task->End, Task->Grain, Task->RangeProcedure, Task->Context);
+  } else {
+    Task->Procedure (Worker, Task->Context);
+  }
+  Worker->TaskCount++;
+  InterlockedDecrement (&Task->Group->Pending);
+}
+
+/**
+  Spawns a task in a group. The task is run at once if the deque of the processor
+  is full.
+
+  @param  Worker      The processor that runs the calling task.
+  @param  Group       The group of the task.
+  @param  Procedure   The task.
+  @param  Context     The context of the task.
+
+**/
+VOID
+EFIAPI
+ApTaskSpawn (
+  IN     AP_TASK_WORKER     *Worker,
+  IN OUT AP_TASK_GROUP      *Group,
+  IN     AP_TASK_PROCEDURE  Procedure,
+  IN     VOID               *Context  OPTIONAL
+  )
+{
+  AP_TASK  Task;
+
+  ASSERT (Worker != NULL && Group != NULL && Procedure != NULL);
+
+  Task.Procedure      = Procedure;
+  Task.RangeProcedure = NULL;
+  Task.Context        = Context;
+  Task.Group          = Group;
+  Task.Start          = 0;
+  Task.End            = 0;
+  Task.Grain          = 0;
+  InterlockedIncrement (&Group->Pending);
+  if (!InternalApTaskPush (Worker, &Task)) {
+    Worker->InlineSpawns++;
+    InternalApTaskExecute (Worker, &Task);
+  }
+}
+
+/**
+  Waits for the tasks of a group to finish, running tasks meanwhile.
+
+  The tasks run while waiting may belong to other groups, and run on the stack of
+  the waiting task.
+
+  @param  Worker    The processor that runs the calling task.
+  @param  Group     The group.
+
+**/
+VOID
+EFIAPI
+ApTaskSync (
+  IN     AP_TASK_WORKER  *Worker,
+  IN OUT AP_TASK_GROUP   *Group
+  )
+{
+  AP_TASK  Task;
+
+  ASSERT (Worker != NULL && Group != NULL);
+
+  while (Group->Pending != 0) {
+    if (InternalApTaskFind (Worker, &Task)) {
+      InternalApTaskExecute (Worker, &Task);
+    } else {
+      CpuPause ();
+    }
+  }
+}
+
+/**
+  Runs a loop over a range of indexes in parallel, and waits for it to finish.
+
+  The range is split in halves until the parts hold at most Grain indexes. The
+  upper halves are spawned, so that other processors take the largest parts first.
+
+  @param  Worker      The processor that runs the calling task.
+  @param  Start       The first index of the range.
+  @param  End         The index that follows the range.
+  @param  Grain       The largest number of indexes that a part holds, or 0 for 1.
+  @param  Procedure   The body of the loop.
+  @param  Context     The context of the body.
+
+**/
+VOID
+EFIAPI
+ApTaskParallelFor (
+  IN AP_TASK_WORKER           *Worker,
+  IN UINTN                    Start,
+  IN UINTN                    End,
+  IN UINTN                    Grain,
+  IN AP_TASK_RANGE_PROCEDURE  Procedure,
+  IN VOID                     *Context  OPTIONAL
+  )
+{
+  ASSERT (Worker != NULL && Procedure != NULL);
+
+  if (Start >= End) {
+    return;
+  }
+  InternalApTaskParallelFor (Worker, Start, End, MAX (Grain, 1), Procedure, Context);
+}
+
+/**
+  Returns the index of a processor among the processors of its scheduler, which
+  lets tasks keep results per processor without locking.
+
+  @param  Worker    The processor.
+
+  @return The index, which is 0 for the BSP and below the Processors counter.
+
+**/
+UINTN
+EFIAPI
+ApTaskGetWorkerIndex (
+  IN AP_TASK_WORKER  *Worker
+  )
+{
+  return Worker->Index;
+}
@@ -0,0 +1,140 @@
+/** @file
+  Internal definitions of the task-parallel library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _AP_TASK_INTERNAL_H_
+#define _AP_TASK_INTERNAL_H_
+
+#include <FrameworkDxe.h>
+
+#include <Protocol/FrameworkMpService.h>
+
+#include <Library/ApTaskLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#define AP_TASK_SCHEDULER_SIGNATURE  SIGNATURE_32 ('A', 'P', 'T', 'S')
+
+///
+/// The workers are kept on separate cache lines, so that a processor working on its
+/// own deque does not slow down the others.
+///
+#define AP_TASK_CACHE_LINE_SIZE  64
+
+///
+/// Timeout given to StartupAllAPs(), after which the BSP goes on with the root task
+/// while the application processors keep running.
+///
+#define AP_TASK_DISPATCH_TIMEOUT  1
+
+///
+/// A task in a deque. A task with a RangeProcedure is a part of a parallel loop.
+///
+typedef struct {
+  AP_TASK_PROCEDURE        Procedure;
+  AP_TASK_RANGE_PROCEDURE  RangeProcedure;
+  VOID                     *Context;
+  AP_TASK_GROUP            *Group;
+  UINTN                    Start;
+  UINTN                    End;
+  UINTN                    Grain;
+} AP_TASK;
+
+///
+/// A processor that runs tasks, with its deque. The owner pushes and pops at
+/// Bottom, the other processors steal at Top.
+///
+struct _AP_TASK_WORKER {
+  SPIN_LOCK           Lock;
+  volatile UINTN      Top;
+  volatile UINTN      Bottom;
+  AP_TASK             *Tasks;
+  AP_TASK_SCHEDULER   *Scheduler;
+  UINTN               Index;
+  UINT32              Seed;           ///< State of the choice of the processors to steal from.
+  UINT64              TaskCount;
+  UINT64              Steals;
+  UINT64              InlineSpawns;
+};
+
+struct _AP_TASK_SCHEDULER {
+  UINT32                              Signature;
+  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  EFI_EVENT                           ApDone;         ///< Signaled when the application processors stop.
+  UINTN                               WorkerCount;
+  UINTN                               WorkerSize;     ///< Size of a worker, in whole cache lines.
+  UINT8                               *Workers;
+  UINTN                               DequeMask;      ///< Deque size minus 1.
+  VOID                                *Memory;
+  UINTN                               Pages;
+  volatile UINT32                     NextWorker;     ///< Last worker taken by an application processor.
+  volatile BOOLEAN                    Done;           ///< The root task has finished.
+  BOOLEAN                             Running;
+  UINTN                               Runs;
+  UINTN                               Dispatches;
+};
+
+#define AP_TASK_WORKER_AT(Scheduler, Index) \
+  ((AP_TASK_WORKER *) ((Scheduler)->Workers + (Index) * (Scheduler)->WorkerSize))
+
+/**
+  Pushes a task at the bottom of the deque of a processor.
+
+  @param  Worker    The processor, which must be the calling processor.
+  @param  Task      The task.
+
+  @retval TRUE    The task was pushed.
+  @retval FALSE   The deque is full.
+
+**/
+BOOLEAN
+InternalApTaskPush (
+  IN OUT AP_TASK_WORKER  *Worker,
+  IN     CONST AP_TASK   *Task
+  );
+
+/**
+  Finds a task to run: the last task pushed by the calling processor, or else the
+  first task of the deque of another processor.
+
+  @param  Worker    The calling processor.
+  @param  Task      Returns the task.
+
+  @retval TRUE    A task was found.
+  @retval FALSE   All the deques are empty.
+
+**/
+BOOLEAN
+InternalApTaskFind (
+  IN OUT AP_TASK_WORKER  *Worker,
+  OUT    AP_TASK         *Task
+  );
+
+/**
+  Runs a task taken from a deque and marks it finished in its group.
+
+  @param  Worker    The calling processor.
+  @param  Task      The task.
+
+**/
+VOID
+InternalApTaskExecute (
+  IN OUT AP_TASK_WORKER  *Worker,
+  IN     CONST AP_TASK   *Task
+  );
+
+#endif
@@ -0,0 +1,252 @@
+/** @file
+  Creation of Firmware Volume Protocol instances and the volume level services.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FrameworkFvInternal.h"
+
+///
+/// The volume attributes that the Framework and PI firmware volume headers share.
+///
+#define FRAMEWORK_FV_HEADER_ATTRIBUTES  (EFI_FV_READ_DISABLE_CAP | EFI_FV_READ_ENABLE_CAP | \
+                                         EFI_FV_READ_STATUS | EFI_FV_LOCK_CAP | EFI_FV_LOCK_STATUS)
+
+/**
+  Creates a Firmware Volume Protocol instance for a firmware volume in memory.
+
+  The caller installs the returned protocol on a handle and sets its ParentHandle.
+  The firmware volume must stay in memory until FrameworkFvDestroy() is called.
+
+  @param  FvHeader        The header of the firmware volume.
+  @param  FirmwareVolume  Returns the protocol instance.
+
+  @retval EFI_SUCCESS             The protocol instance was created.
+  @retval EFI_INVALID_PARAMETER   FvHeader or FirmwareVolume is NULL.
+  @retval EFI_VOLUME_CORRUPTED    The firmware volume header is not valid.
+  @retval EFI_UNSUPPORTED         The firmware volume does not use a firmware file system
+                                  known to this library.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvCreate (
+  IN  CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  OUT EFI_FIRMWARE_VOLUME_PROTOCOL      **FirmwareVolume
+  )
+{
+  FRAMEWORK_FV_DEVICE             *Device;
+  EFI_FIRMWARE_VOLUME_EXT_HEADER  *ExtHeader;
+  UINT64                          FirstFileOffset;
+  BOOLEAN                         Ffs2;
+  BOOLEAN                         Ffs3;
+
+  if (FvHeader == NULL || FirmwareVolume == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (FvHeader->Signature != EFI_FVH_SIGNATURE ||
+      FvHeader->HeaderLength < sizeof (EFI_FIRMWARE_VOLUME_HEADER) ||
+      FvHeader->FvLength < FvHeader->HeaderLength ||
+      FvHeader->FvLength > MAX_ADDRESS - (UINTN) FvHeader) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Ffs3 = CompareGuid (&FvHeader->FileSystemGuid, &gEfiFirmwareFileSystem3Guid);
+  Ffs2 = (BOOLEAN) (Ffs3 || CompareGuid (&FvHeader->FileSystemGuid, &gEfiFirmwareFileSystem2Guid));
+  if (!Ffs2 && !CompareGuid (&FvHeader->FileSystemGuid, &gEfiFirmwareFileSystemGuid)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  FirstFileOffset = FvHeader->HeaderLength;
+  if (FvHeader->ExtHeaderOffset != 0) {
+    if ((UINT64) FvHeader->ExtHeaderOffset + sizeof (EFI_FIRMWARE_VOLUME_EXT_HEADER) > FvHeader->FvLength) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+    ExtHeader       = (EFI_FIRMWARE_VOLUME_EXT_HEADER *) ((UINT8 *) FvHeader + FvHeader->ExtHeaderOffset);
+    FirstFileOffset = (UINT64) FvHeader->ExtHeaderOffset + ExtHeader->ExtHeaderSize;
+  }
+  FirstFileOffset = ALIGN_VALUE (FirstFileOffset, 8);
+  if (FirstFileOffset > FvHeader->FvLength || FirstFileOffset > MAX_UINT32) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Device = AllocateZeroPool (sizeof (FRAMEWORK_FV_DEVICE));
+  if (Device == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Device->Signature                          = FV_DEVICE_SIGNATURE;
+  Device->FvHeader                           = (EFI_FIRMWARE_VOLUME_HEADER *) FvHeader;
+  Device->FvLength                           = FvHeader->FvLength;
+  Device->FirstFileOffset                    = (UINT32) FirstFileOffset;
+  Device->ErasePolarity                      = (UINT8) (((FvHeader->Attributes & EFI_FVB2_ERASE_POLARITY) != 0) ? 0xFF : 0);
+  Device->Ffs2                               = Ffs2;
+  Device->Ffs3                               = Ffs3;
+  Device->FirmwareVolume.GetVolumeAttributes = FrameworkFvGetVolumeAttributes;
+  Device->FirmwareVolume.SetVolumeAttributes = FrameworkFvSetVolumeAttributes;
+  Device->FirmwareVolume.ReadFile            = FrameworkFvReadFile;
+  Device->FirmwareVolume.ReadSection         = FrameworkFvReadSection;
+  Device->FirmwareVolume.WriteFile           = FrameworkFvWriteFile;
+  Device->FirmwareVolume.GetNextFile         = FrameworkFvGetNextFile;
+  Device->FirmwareVolume.KeySize             = sizeof (UINTN);
+  Device->FirmwareVolume.ParentHandle        = NULL;
+  Device->ZeroCopy.MapFile                   = FrameworkFvMapFile;
+  Device->ZeroCopy.MapSection                = FrameworkFvMapSection;
+
+  *FirmwareVolume = &Device->FirmwareVolume;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the Firmware Volume Zero Copy Protocol of a Firmware Volume Protocol
+  instance created by FrameworkFvCreate().
+
+  The caller installs it on the handle of the Firmware Volume Protocol.
+
+  @param  FirmwareVolume  The protocol instance.
+
+  @return The Firmware Volume Zero Copy Protocol instance.
+
+**/
+FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL *
+EFIAPI
+FrameworkFvGetZeroCopy (
+  IN EFI_FIRMWARE_VOLUME_PROTOCOL  *FirmwareVolume
+  )
+{
+  return &FRAMEWORK_FV_DEVICE_FROM_THIS (FirmwareVolume)->ZeroCopy;
+}
+
+/**
+  Frees a Firmware Volume Protocol instance created by FrameworkFvCreate().
+
+  The caller must uninstall the protocols first.
+
+  @param  FirmwareVolume  The protocol instance.
+
+**/
+VOID
+EFIAPI
+FrameworkFvDestroy (
+  IN EFI_FIRMWARE_VOLUME_PROTOCOL  *FirmwareVolume
+  )
+{
+  FRAMEWORK_FV_DEVICE  *Device;
+
+  Device = FRAMEWORK_FV_DEVICE_FROM_THIS (FirmwareVolume);
+
+  InternalFvFreeIndex (Device);
+  if (Device->BlockMap != NULL) {
+    FreePool (Device->BlockMap);
+  }
+  Device->Signature = 0;
+  FreePool (Device);
+}
+
+/**
+  Returns the lookup, read and write counters of a Firmware Volume Protocol instance
+  created by FrameworkFvCreate().
+
+  @param  FirmwareVolume  The protocol instance.
+  @param  Statistics      Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   FirmwareVolume was not created by this library, or
+                                  Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvGetStatistics (
+  IN  EFI_FIRMWARE_VOLUME_PROTOCOL  *FirmwareVolume,
+  OUT FRAMEWORK_FV_STATISTICS       *Statistics
+  )
+{
+  FRAMEWORK_FV_DEVICE  *Device;
+
+  if (FirmwareVolume == NULL || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = BASE_CR (FirmwareVolume, FRAMEWORK_FV_DEVICE, FirmwareVolume);
+  if (Device->Signature != FV_DEVICE_SIGNATURE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Statistics, &Device->Statistics, sizeof (FRAMEWORK_FV_STATISTICS));
+  return EFI_SUCCESS;
+}
+
+/**
+  Retrieves attributes, insures positive polarity of attribute bits, and returns
+  resulting attributes in an output parameter.
+
+  The volume is read only unless writes were enabled by FrameworkFvEnableWrite().
+
+  @param  This                  Indicates the EFI_FIRMWARE_VOLUME_PROTOCOL instance.
+  @param  Attributes            Output buffer containing attributes.
+
+  @retval EFI_SUCCESS           The firmware volume attributes were returned.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvGetVolumeAttributes (
+  IN  EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  OUT FRAMEWORK_EFI_FV_ATTRIBUTES   *Attributes
+  )
+{
+  FRAMEWORK_FV_DEVICE  *Device;
+
+  Device = FRAMEWORK_FV_DEVICE_FROM_THIS (This);
+
+  *Attributes = (Device->FvHeader->Attributes & FRAMEWORK_FV_HEADER_ATTRIBUTES) | EFI_FV_WRITE_DISABLE_CAP;
+  if (Device->Fvb != NULL) {
+    *Attributes |= EFI_FV_WRITE_ENABLE_CAP | EFI_FV_WRITE_STATUS;
+    if (Device->SpareFvb != NULL) {
+      *Attributes |= EFI_FV_WRITE_POLICY_RELIABLE;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Sets volume attributes.
+
+  The attributes of the volume cannot be changed through this protocol, so only a
+  request for the current attributes succeeds.
+
+  @param  This                  Indicates the EFI_FIRMWARE_VOLUME_PROTOCOL instance.
+  @param  Attributes            On input, the desired firmware volume settings. On
+                                successful return, the new settings.
+
+  @retval EFI_SUCCESS           The attributes are the current ones.
+  @retval EFI_ACCESS_DENIED     The attributes differ from the current ones.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvSetVolumeAttributes (
+  IN     EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  IN OUT FRAMEWORK_EFI_FV_ATTRIBUTES   *Attributes
+  )
+{
+  FRAMEWORK_EFI_FV_ATTRIBUTES  Current;
+
+  FrameworkFvGetVolumeAttributes (This, &Current);
+  if (*Attributes != Current) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,421 @@
+/** @file
+  File index of a firmware volume and the GetNextFile() service.
+
+  The FFS file headers are walked once, on the first access to the volume. The
+  files are kept in volume order for GetNextFile() and in an open addressing hash
+  table keyed by name for ReadFile() and ReadSection().
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FrameworkFvInternal.h"
+
+#define FRAMEWORK_FV_INITIAL_FILES    64
+#define FRAMEWORK_FV_MINIMUM_BUCKETS  16
+
+///
+/// Log2 of the data alignment of an FFS file, indexed by FFS_ATTRIB_DATA_ALIGNMENT.
+///
+GLOBAL_REMOVE_IF_UNREFERENCED CONST UINT8  mFfsAlignmentShift[8] = {
+  0, 4, 7, 9, 10, 12, 15, 16
+};
+
+/**
+  Hashes the name of a file.
+
+  @param  NameGuid  The name of the file.
+
+  @return The hash value.
+
+**/
+UINT32
+InternalFvHashGuid (
+  IN CONST EFI_GUID  *NameGuid
+  )
+{
+  CONST UINT32  *Words;
+  UINT32        Hash;
+
+  Words = (CONST UINT32 *) NameGuid;
+  Hash  = ReadUnaligned32 (Words) ^ ReadUnaligned32 (Words + 1) ^
+          ReadUnaligned32 (Words + 2) ^ ReadUnaligned32 (Words + 3);
+  Hash *= 0x9E3779B1;
+  return Hash ^ (Hash >> 16);
+}
+
+/**
+  Returns the state of an FFS file, which is the most significant bit set in its
+  State field once the erase polarity is removed.
+
+  @param  Device      The firmware volume.
+  @param  FileHeader  The file header.
+
+  @return The state of the file, or 0 if no bit is set.
+
+**/
+UINT8
+InternalFvFileState (
+  IN CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN CONST EFI_FFS_FILE_HEADER  *FileHeader
+  )
+{
+  UINT8  State;
+  UINT8  HighestBit;
+
+  State = (UINT8) (FileHeader->State ^ Device->ErasePolarity);
+  for (HighestBit = 0x80; HighestBit != 0 && (State & HighestBit) == 0; HighestBit >>= 1) {
+  }
+
+  return HighestBit;
+}
+
+/**
+  Checks whether a file header is free space.
+
+  @param  Device      The firmware volume.
+  @param  FileHeader  The file header.
+
+  @retval TRUE    All the bytes of the header are erased.
+  @retval FALSE   The header holds a file.
+
+**/
+BOOLEAN
+InternalFvIsFreeSpace (
+  IN CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN CONST EFI_FFS_FILE_HEADER  *FileHeader
+  )
+{
+  CONST UINT8  *Byte;
+  UINTN        Index;
+
+  Byte = (CONST UINT8 *) FileHeader;
+  for (Index = 0; Index < sizeof (EFI_FFS_FILE_HEADER); Index++) {
+    if (Byte[Index] != Device->ErasePolarity) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Converts the attributes of an FFS file to Firmware Volume Protocol file attributes.
+
+  @param  FfsAttributes   The attributes of the FFS file.
+
+  @return The file attributes.
+
+**/
+EFI_FV_FILE_ATTRIBUTES
+InternalFvFileAttributes (
+  IN EFI_FFS_FILE_ATTRIBUTES  FfsAttributes
+  )
+{
+  return (EFI_FV_FILE_ATTRIBUTES) mFfsAlignmentShift[(FfsAttributes & FFS_ATTRIB_DATA_ALIGNMENT) >> 3];
+}
+
+/**
+  Adds a file to the hash table, or replaces a file of the same name that is only
+  marked for update.
+
+  @param  Device      The firmware volume.
+  @param  FileIndex   The index of the file in Files.
+
+  @retval TRUE    The file was added.
+  @retval FALSE   The file is superseded by a file of the same name.
+
+**/
+BOOLEAN
+InternalFvInsertFile (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device,
+  IN     UINTN                FileIndex
+  )
+{
+  FRAMEWORK_FV_FILE  *File;
+  FRAMEWORK_FV_FILE  *Other;
+  UINTN              Bucket;
+
+  File   = &Device->Files[FileIndex];
+  Bucket = File->Hash & Device->BucketMask;
+  while (Device->Buckets[Bucket] != 0) {
+    Other = &Device->Files[Device->Buckets[Bucket] - 1];
+    if (Other->Hash == File->Hash && CompareGuid (&Other->FileHeader->Name, &File->FileHeader->Name)) {
+      if (Other->State == EFI_FILE_MARKED_FOR_UPDATE && File->State == EFI_FILE_DATA_VALID) {
+        Device->Buckets[Bucket] = (UINT32) FileIndex + 1;
+        Other->Superseded       = TRUE;
+        return TRUE;
+      }
+      return FALSE;
+    }
+    Bucket = (Bucket + 1) & Device->BucketMask;
+  }
+
+  Device->Buckets[Bucket] = (UINT32) FileIndex + 1;
+  return TRUE;
+}
+
+/**
+  Builds the file index of a firmware volume if it is not built yet.
+
+  @param  Device    The firmware volume.
+
+  @retval EFI_SUCCESS             The index is built.
+  @retval EFI_VOLUME_CORRUPTED    A file header is not valid.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalFvBuildIndex (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device
+  )
+{
+  UINT8                *FvBase;
+  EFI_FFS_FILE_HEADER  *FileHeader;
+  FRAMEWORK_FV_FILE    *Files;
+  FRAMEWORK_FV_FILE    *NewFiles;
+  FRAMEWORK_FV_FILE    *File;
+  UINTN                Capacity;
+  UINTN                Count;
+  UINTN                BucketCount;
+  UINTN                Index;
+  UINT64               Offset;
+  UINT64               FileSize;
+  UINT32               HeaderSize;
+  UINT8                State;
+
+  if (Device->IndexBuilt) {
+    return EFI_SUCCESS;
+  }
+
+  FvBase   = (UINT8 *) Device->FvHeader;
+  Files    = NULL;
+  Capacity = 0;
+  Count    = 0;
+  Offset   = Device->FirstFileOffset;
+  while (Offset + sizeof (EFI_FFS_FILE_HEADER) <= Device->FvLength) {
+    FileHeader = (EFI_FFS_FILE_HEADER *) (FvBase + (UINTN) Offset);
+    Device->Statistics.HeadersVisited++;
+    if (InternalFvIsFreeSpace (Device, FileHeader)) {
+      break;
+    }
+
+    if (Device->Ffs3 && IS_FFS_FILE2 (FileHeader)) {
+      HeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
+      if (Offset + HeaderSize > Device->FvLength) {
+        break;
+      }
+      FileSize = FFS_FILE2_SIZE (FileHeader);
+    } else {
+      HeaderSize = sizeof (EFI_FFS_FILE_HEADER);
+      FileSize   = FFS_FILE_SIZE (FileHeader);
+    }
+
+    State = InternalFvFileState (Device, FileHeader);
+    if (State == EFI_FILE_HEADER_CONSTRUCTION || State == EFI_FILE_HEADER_INVALID) {
+      //
+      // The size of the file cannot be trusted, so only step over the header.
+      //
+      Offset = ALIGN_VALUE (Offset + HeaderSize, 8);
+      continue;
+    }
+
+    if (FileSize < HeaderSize || FileSize > Device->FvLength - Offset || FileSize > MAX_UINT32) {
+      DEBUG ((DEBUG_ERROR, "FrameworkFv: file at offset 0x%lx of FV 0x%p is corrupted\n", Offset, Device->FvHeader));
+      if (Files != NULL) {
+        FreePool (Files);
+      }
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if ((State == EFI_FILE_DATA_VALID || State == EFI_FILE_MARKED_FOR_UPDATE) &&
+        FileHeader->Type != EFI_FV_FILETYPE_FFS_PAD) {
+      if (Count == Capacity) {
+        Capacity = (Capacity == 0) ? FRAMEWORK_FV_INITIAL_FILES : Capacity * 2;
+        NewFiles = ReallocatePool (Count * sizeof (FRAMEWORK_FV_FILE), Capacity * sizeof (FRAMEWORK_FV_FILE), Files);
+        if (NewFiles == NULL) {
+          if (Files != NULL) {
+            FreePool (Files);
+          }
+          return EFI_OUT_OF_RESOURCES;
+        }
+        Files = NewFiles;
+      }
+
+      File             = &Files[Count++];
+      File->FileHeader = FileHeader;
+      File->FileSize   = (UINT32) FileSize;
+      File->HeaderSize = HeaderSize;
+      File->DataSize   = (UINT32) FileSize - HeaderSize;
+      File->Hash       = InternalFvHashGuid (&FileHeader->Name);
+      File->State      = State;
+      File->Superseded = FALSE;
+      if (!Device->Ffs2 && (FileHeader->Attributes & FFS_ATTRIB_TAIL_PRESENT) != 0) {
+        if (File->DataSize < sizeof (EFI_FFS_FILE_TAIL)) {
+          FreePool (Files);
+          return EFI_VOLUME_CORRUPTED;
+        }
+        File->DataSize -= sizeof (EFI_FFS_FILE_TAIL);
+      }
+    }
+
+    Offset = ALIGN_VALUE (Offset + FileSize, 8);
+  }
+
+  for (BucketCount = FRAMEWORK_FV_MINIMUM_BUCKETS; BucketCount < Count * 2; BucketCount *= 2) {
+  }
+  Device->Buckets = AllocateZeroPool (BucketCount * sizeof (UINT32));
+  if (Device->Buckets == NULL) {
+    if (Files != NULL) {
+      FreePool (Files);
+    }
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Device->Files      = Files;
+  Device->FileCount  = Count;
+  Device->BucketMask = BucketCount - 1;
+  Device->FreeOffset = MIN (Offset, Device->FvLength);
+  for (Index = 0; Index < Count; Index++) {
+    if (!InternalFvInsertFile (Device, Index)) {
+      Files[Index].Superseded = TRUE;
+    }
+  }
+
+  Device->Statistics.Files = 0;
+  for (Index = 0; Index < Count; Index++) {
+    if (!Files[Index].Superseded) {
+      Device->Statistics.Files++;
+    }
+  }
+
+  Device->IndexBuilt = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees the file index of a firmware volume, so that it is built again on the next access.
+
+  @param  Device    The firmware volume.
+
+**/
+VOID
+InternalFvFreeIndex (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device
+  )
+{
+  if (Device->Files != NULL) {
+    FreePool (Device->Files);
+    Device->Files = NULL;
+  }
+  if (Device->Buckets != NULL) {
+    FreePool (Device->Buckets);
+    Device->Buckets = NULL;
+  }
+  Device->FileCount  = 0;
+  Device->IndexBuilt = FALSE;
+}
+
+/**
+  Finds a file of a firmware volume by name.
+
+  @param  Device    The firmware volume.
+  @param  NameGuid  The name of the file.
+
+  @return The file, or NULL if the volume has no such file.
+
+**/
+FRAMEWORK_FV_FILE *
+InternalFvFindFile (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device,
+  IN     CONST EFI_GUID       *NameGuid
+  )
+{
+  FRAMEWORK_FV_FILE  *File;
+  UINT32             Hash;
+  UINTN              Bucket;
+
+  if (EFI_ERROR (InternalFvBuildIndex (Device))) {
+    return NULL;
+  }
+
+  Device->Statistics.Lookups++;
+
+  Hash   = InternalFvHashGuid (NameGuid);
+  Bucket = Hash & Device->BucketMask;
+  while (Device->Buckets[Bucket] != 0) {
+    Device->Statistics.Probes++;
+    File = &Device->Files[Device->Buckets[Bucket] - 1];
+    if (File->Hash == Hash && CompareGuid (&File->FileHeader->Name, NameGuid)) {
+      return File;
+    }
+    Bucket = (Bucket + 1) & Device->BucketMask;
+  }
+
+  return NULL;
+}
+
+/**
+  Given the input key, search for the next matching file in the volume.
+
+  @param  This                  Indicates the EFI_FIRMWARE_VOLUME_PROTOCOL instance.
+  @param  Key                   The index of the next file to examine. It is zero
+                                on the first call.
+  @param  FileType              The pointer to the file type to filter for.
+  @param  NameGuid              The pointer to Guid filename of the file found.
+  @param  Attributes            The pointer to Attributes of the file found.
+  @param  Size                  The pointer to Size in bytes of the file found.
+
+  @retval EFI_SUCCESS           The output parameters are filled with data obtained from
+                                the first matching file that was found.
+  @retval EFI_NOT_FOUND         No files of type FileType were found.
+  @retval EFI_DEVICE_ERROR      The firmware volume is corrupted.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvGetNextFile (
+  IN     EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  IN OUT VOID                          *Key,
+  IN OUT EFI_FV_FILETYPE               *FileType,
+  OUT    EFI_GUID                      *NameGuid,
+  OUT    EFI_FV_FILE_ATTRIBUTES        *Attributes,
+  OUT    UINTN                         *Size
+  )
+{
+  FRAMEWORK_FV_DEVICE  *Device;
+  FRAMEWORK_FV_FILE    *File;
+  UINTN                *Index;
+
+  Device = FRAMEWORK_FV_DEVICE_FROM_THIS (This);
+
+  if (EFI_ERROR (InternalFvBuildIndex (Device))) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Index = (UINTN *) Key;
+  while (*Index < Device->FileCount) {
+    File = &Device->Files[(*Index)++];
+    if (File->Superseded) {
+      continue;
+    }
+    if (*FileType != EFI_FV_FILETYPE_ALL && *FileType != File->FileHeader->Type) {
+      continue;
+    }
+
+    *FileType   = File->FileHeader->Type;
+    *Attributes = InternalFvFileAttributes (File->FileHeader->Attributes);
+    *Size       = File->DataSize;
+    CopyGuid (NameGuid, &File->FileHeader->Name);
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_FOUND;
+}
@@ -0,0 +1,321 @@
+/** @file
+  Internal definitions of the Framework firmware volume library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _FRAMEWORK_FV_INTERNAL_H_
+#define _FRAMEWORK_FV_INTERNAL_H_
+
+#include <FrameworkDxe.h>
+
+#include <Guid/FirmwareFileSystem.h>
+#include <Guid/FirmwareFileSystem2.h>
+#include <Guid/FirmwareFileSystem3.h>
+
+#include <Protocol/FirmwareVolume.h>
+#include <Protocol/FrameworkFirmwareVolumeBlock.h>
+#include <Protocol/FirmwareVolumeZeroCopy.h>
+#include <Protocol/SectionExtraction.h>
+
+#include <Library/FrameworkFvLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+///
+/// A file of the firmware volume.
+///
+typedef struct {
+  EFI_FFS_FILE_HEADER   *FileHeader;
+  UINT32                FileSize;     ///< Size of the whole FFS file.
+  UINT32                HeaderSize;   ///< Size of the FFS file header.
+  UINT32                DataSize;     ///< Size of the file data, without header and tail.
+  UINT32                Hash;
+  UINT8                 State;        ///< EFI_FILE_DATA_VALID or EFI_FILE_MARKED_FOR_UPDATE.
+  BOOLEAN               Superseded;   ///< A valid file of the same name replaces this one.
+} FRAMEWORK_FV_FILE;
+
+typedef struct {
+  UINT32                                            Signature;        ///< FV_DEVICE_SIGNATURE.
+  EFI_FIRMWARE_VOLUME_PROTOCOL                      FirmwareVolume;
+  FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL  ZeroCopy;
+  EFI_FIRMWARE_VOLUME_HEADER                        *FvHeader;
+  UINT64                                            FvLength;
+  UINT32                                            FirstFileOffset;
+  UINT8                                             ErasePolarity;    ///< Value of an erased byte.
+  BOOLEAN                                           Ffs2;             ///< Files do not have a tail.
+  BOOLEAN                                           Ffs3;             ///< Files may have an extended size.
+  ///
+  /// The index, built on the first access. Files lists the files in volume order
+  /// and Buckets is an open addressing hash table of indexes into Files plus one.
+  ///
+  BOOLEAN                                           IndexBuilt;
+  FRAMEWORK_FV_FILE                                 *Files;
+  UINTN                                             FileCount;
+  UINT32                                            *Buckets;
+  UINTN                                             BucketMask;
+  UINT64                                            FreeOffset;       ///< Start of the free space.
+  FRAMEWORK_FV_STATISTICS                           Statistics;
+  ///
+  /// The firmware volume block protocol that writes the volume, and the spare blocks
+  /// that journal the blocks rewritten by a reclaim under the reliable write policy.
+  ///
+  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL      *Fvb;
+  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL      *SpareFvb;
+  EFI_LBA                                           SpareLba;
+  UINTN                                             SpareBlocks;
+  UINTN                                             SpareBlockLength;
+  ///
+  /// Copy of the block map of the volume, which stays valid while a reclaim erases
+  /// the block holding the firmware volume header.
+  ///
+  EFI_FV_BLOCK_MAP_ENTRY                            *BlockMap;
+  UINTN                                             BlockMapCount;
+  UINTN                                             BlockCount;
+  UINTN                                             MaxBlockLength;   ///< Largest block of the volume.
+} FRAMEWORK_FV_DEVICE;
+
+///
+/// Fixed file checksum of the Framework firmware file system, whose files do not
+/// have a data checksum unless FFS_ATTRIB_CHECKSUM is set.
+///
+#define FRAMEWORK_FFS_FIXED_CHECKSUM   0x5A
+
+///
+/// Alignment of the data of a file, as the log2 of the alignment, in the low bits
+/// of the file attributes of the Firmware Volume Protocol.
+///
+#define FRAMEWORK_FV_FILE_ATTRIB_ALIGNMENT  0x0000001F
+
+///
+/// Log2 of the data alignment of an FFS file, indexed by FFS_ATTRIB_DATA_ALIGNMENT.
+///
+extern CONST UINT8  mFfsAlignmentShift[8];
+
+#define FRAMEWORK_FV_DEVICE_FROM_THIS(a) \
+  CR (a, FRAMEWORK_FV_DEVICE, FirmwareVolume, FV_DEVICE_SIGNATURE)
+
+#define FRAMEWORK_FV_DEVICE_FROM_ZERO_COPY(a) \
+  CR (a, FRAMEWORK_FV_DEVICE, ZeroCopy, FV_DEVICE_SIGNATURE)
+
+/**
+  Builds the file index of a firmware volume if it is not built yet.
+
+  @param  Device    The firmware volume.
+
+  @retval EFI_SUCCESS             The index is built.
+  @retval EFI_VOLUME_CORRUPTED    A file header is not valid.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalFvBuildIndex (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device
+  );
+
+/**
+  Frees the file index of a firmware volume, so that it is built again on the next access.
+
+  @param  Device    The firmware volume.
+
+**/
+VOID
+InternalFvFreeIndex (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device
+  );
+
+/**
+  Returns the state of an FFS file, which is the most significant bit set in its
+  State field once the erase polarity is removed.
+
+  @param  Device      The firmware volume.
+  @param  FileHeader  The file header.
+
+  @return The state of the file, or 0 if no bit is set.
+
+**/
+UINT8
+InternalFvFileState (
+  IN CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN CONST EFI_FFS_FILE_HEADER  *FileHeader
+  );
+
+/**
+  Finds a file of a firmware volume by name.
+
+  @param  Device    The firmware volume.
+  @param  NameGuid  The name of the file.
+
+  @return The file, or NULL if the volume has no such file.
+
+**/
+FRAMEWORK_FV_FILE *
+InternalFvFindFile (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device,
+  IN     CONST EFI_GUID       *NameGuid
+  );
+
+/**
+  Converts the attributes of an FFS file to Firmware Volume Protocol file attributes.
+
+  @param  FfsAttributes   The attributes of the FFS file.
+
+  @return The file attributes.
+
+**/
+EFI_FV_FILE_ATTRIBUTES
+InternalFvFileAttributes (
+  IN EFI_FFS_FILE_ATTRIBUTES  FfsAttributes
+  );
+
+/**
+  Returns the attributes of the firmware volume, which is read only unless writes
+  were enabled.
+
+  @param  This          Indicates the EFI_FIRMWARE_VOLUME_PROTOCOL instance.
+  @param  Attributes    Returns the attributes.
+
+  @retval EFI_SUCCESS   The attributes were returned.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvGetVolumeAttributes (
+  IN  EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  OUT FRAMEWORK_EFI_FV_ATTRIBUTES   *Attributes
+  );
+
+/**
+  Accepts only the current attributes of the firmware volume.
+
+  @param  This                Indicates the EFI_FIRMWARE_VOLUME_PROTOCOL instance.
+  @param  Attributes          The requested attributes.
+
+  @retval EFI_SUCCESS         The attributes are the current ones.
+  @retval EFI_ACCESS_DENIED   The attributes differ from the current ones.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvSetVolumeAttributes (
+  IN     EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  IN OUT FRAMEWORK_EFI_FV_ATTRIBUTES   *Attributes
+  );
+
+/**
+  Reads a file, found through the file index, from the firmware volume.
+
+  See FRAMEWORK_EFI_FV_READ_FILE for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvReadFile (
+  IN     EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  IN     EFI_GUID                      *NameGuid,
+  IN OUT VOID                          **Buffer,
+  IN OUT UINTN                         *BufferSize,
+  OUT    EFI_FV_FILETYPE               *FoundType,
+  OUT    EFI_FV_FILE_ATTRIBUTES        *FileAttributes,
+  OUT    UINT32                        *AuthenticationStatus
+  );
+
+/**
+  Reads a section of a file, found through the file index, from the firmware volume.
+
+  See FRAMEWORK_EFI_FV_READ_SECTION for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvReadSection (
+  IN     EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  IN     EFI_GUID                      *NameGuid,
+  IN     EFI_SECTION_TYPE              SectionType,
+  IN     UINTN                         SectionInstance,
+  IN OUT VOID                          **Buffer,
+  IN OUT UINTN                         *BufferSize,
+  OUT    UINT32                        *AuthenticationStatus
+  );
+
+/**
+  Writes files to the firmware volume through its firmware volume block protocol.
+
+  See FRAMEWORK_EFI_FV_WRITE_FILE for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvWriteFile (
+  IN EFI_FIRMWARE_VOLUME_PROTOCOL      *This,
+  IN UINT32                            NumberOfFiles,
+  IN FRAMEWORK_EFI_FV_WRITE_POLICY     WritePolicy,
+  IN FRAMEWORK_EFI_FV_WRITE_FILE_DATA  *FileData
+  );
+
+/**
+  Returns the next file of the firmware volume in volume order. The key is the index
+  of the next file in the file index.
+
+  See FRAMEWORK_EFI_FV_GET_NEXT_FILE for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvGetNextFile (
+  IN     EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  IN OUT VOID                          *Key,
+  IN OUT EFI_FV_FILETYPE               *FileType,
+  OUT    EFI_GUID                      *NameGuid,
+  OUT    EFI_FV_FILE_ATTRIBUTES        *Attributes,
+  OUT    UINTN                         *Size
+  );
+
+/**
+  Maps the data of a file found through the file index.
+
+  See FRAMEWORK_EFI_FV_MAP_FILE for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvMapFile (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL  *This,
+  IN  EFI_GUID                                          *NameGuid,
+  OUT CONST VOID                                        **Data,
+  OUT UINTN                                             *DataSize,
+  OUT EFI_FV_FILETYPE                                   *FoundType,
+  OUT EFI_FV_FILE_ATTRIBUTES                            *FileAttributes,
+  OUT UINT32                                            *AuthenticationStatus
+  );
+
+/**
+  Maps the contents of a top level leaf section of a file found through the file index.
+
+  See FRAMEWORK_EFI_FV_MAP_SECTION for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvMapSection (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL  *This,
+  IN  EFI_GUID                                          *NameGuid,
+  IN  EFI_SECTION_TYPE                                  SectionType,
+  IN  UINTN                                             SectionInstance,
+  OUT CONST VOID                                        **Data,
+  OUT UINTN                                             *DataSize,
+  OUT UINT32                                            *AuthenticationStatus
+  );
+
+#endif
@@ -0,0 +1,487 @@
+/** @file
+  ReadFile() and ReadSection() services of the Framework firmware volume library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FrameworkFvInternal.h"
+
+/**
+  Returns data to the caller of ReadFile() or ReadSection().
+
+  @param  Device      The firmware volume.
+  @param  Data        The data.
+  @param  DataSize    The size of the data.
+  @param  Buffer      The Buffer parameter of ReadFile() or ReadSection().
+  @param  BufferSize  The BufferSize parameter of ReadFile() or ReadSection().
+
+  @retval EFI_SUCCESS                 The data was returned.
+  @retval EFI_WARN_BUFFER_TOO_SMALL   The data was truncated to the caller buffer.
+  @retval EFI_OUT_OF_RESOURCES        The output buffer could not be allocated.
+
+**/
+EFI_STATUS
+InternalFvReturnData (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device,
+  IN     CONST VOID           *Data,
+  IN     UINTN                DataSize,
+  IN OUT VOID                 **Buffer,
+  IN OUT UINTN                *BufferSize
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       CopySize;
+
+  Status = EFI_SUCCESS;
+  if (Buffer != NULL) {
+    if (*Buffer == NULL) {
+      *Buffer = AllocateCopyPool (DataSize, Data);
+      if (*Buffer == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      CopySize = DataSize;
+    } else {
+      CopySize = DataSize;
+      if (*BufferSize < DataSize) {
+        CopySize = *BufferSize;
+        Status   = EFI_WARN_BUFFER_TOO_SMALL;
+      }
+      CopyMem (*Buffer, Data, CopySize);
+    }
+    Device->Statistics.BytesCopied += CopySize;
+  }
+
+  *BufferSize = DataSize;
+  return Status;
+}
+
+/**
+  Reads a section through the Section Extraction Protocol.
+
+  @param  Device                The firmware volume.
+  @param  Data                  The sections of the file.
+  @param  DataSize              The size of the sections.
+  @param  SectionType           The section type to retrieve.
+  @param  SectionInstance       The instance of SectionType to retrieve.
+  @param  Buffer                The Buffer parameter of ReadSection().
+  @param  BufferSize            The BufferSize parameter of ReadSection().
+  @param  AuthenticationStatus  The authentication status of the data.
+
+  @return The status returned by the Section Extraction Protocol.
+
+**/
+EFI_STATUS
+InternalFvExtractSection (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device,
+  IN     VOID                 *Data,
+  IN     UINTN                DataSize,
+  IN     EFI_SECTION_TYPE     SectionType,
+  IN     UINTN                SectionInstance,
+  IN OUT VOID                 **Buffer,
+  IN OUT UINTN                *BufferSize,
+  OUT    UINT32               *AuthenticationStatus
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_SECTION_EXTRACTION_PROTOCOL  *SectionExtraction;
+  UINTN                            StreamHandle;
+  VOID                             *SizeBuffer;
+
+  Status = gBS->LocateProtocol (&gEfiSectionExtractionProtocolGuid, NULL, (VOID **) &SectionExtraction);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = SectionExtraction->OpenSectionStream (SectionExtraction, DataSize, Data, &StreamHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Buffer != NULL) {
+    Status = SectionExtraction->GetSection (
+                                  SectionExtraction,
+                                  StreamHandle,
+                                  &SectionType,
+                                  NULL,
+                                  SectionInstance,
+                                  Buffer,
+                                  BufferSize,
+                                  AuthenticationStatus
+                                  );
+    if (Status == EFI_SUCCESS) {
+      Device->Statistics.BytesCopied += *BufferSize;
+    }
+  } else {
+    //
+    // Only the size is requested, which the Section Extraction Protocol cannot return
+    // without the data.
+    //
+    SizeBuffer = NULL;
+    Status     = SectionExtraction->GetSection (
+                                      SectionExtraction,
+                                      StreamHandle,
+                                      &SectionType,
+                                      NULL,
+                                      SectionInstance,
+                                      &SizeBuffer,
+                                      BufferSize,
+                                      AuthenticationStatus
+                                      );
+    if (SizeBuffer != NULL) {
+      FreePool (SizeBuffer);
+    }
+  }
+
+  SectionExtraction->CloseSectionStream (SectionExtraction, StreamHandle);
+  return Status;
+}
+
+/**
+  Finds a leaf section at the top level of a file.
+
+  The instances of SectionType are numbered as the Section Extraction Protocol
+  numbers them, so the search stops at the first encapsulation section: the
+  requested instance may be inside it.
+
+  @param  File              The file.
+  @param  SectionType       The section type to find.
+  @param  SectionInstance   The instance of SectionType to find.
+  @param  Data              Returns the contents of the section.
+  @param  DataSize          Returns the size of the contents of the section.
+
+  @retval EFI_SUCCESS       The section was found.
+  @retval EFI_NOT_FOUND     The file has no such section.
+  @retval EFI_UNSUPPORTED   An encapsulation section was reached first.
+  @retval EFI_DEVICE_ERROR  A section header is not valid.
+
+**/
+EFI_STATUS
+InternalFvFindSection (
+  IN  CONST FRAMEWORK_FV_FILE  *File,
+  IN  EFI_SECTION_TYPE         SectionType,
+  IN  UINTN                    SectionInstance,
+  OUT UINT8                    **Data,
+  OUT UINTN                    *DataSize
+  )
+{
+  UINT8                      *FileData;
+  EFI_COMMON_SECTION_HEADER  *Section;
+  UINT32                     Offset;
+  UINT32                     SectionSize;
+  UINT32                     HeaderSize;
+  UINTN                      Instance;
+
+  if (File->FileHeader->Type == EFI_FV_FILETYPE_RAW) {
+    return EFI_NOT_FOUND;
+  }
+
+  FileData = (UINT8 *) File->FileHeader + File->HeaderSize;
+  Instance = 0;
+  for (Offset = 0; Offset + sizeof (EFI_COMMON_SECTION_HEADER) <= File->DataSize; Offset = ALIGN_VALUE (Offset + SectionSize, 4)) {
+    Section = (EFI_COMMON_SECTION_HEADER *) (FileData + Offset);
+    if (IS_SECTION2 (Section)) {
+      HeaderSize = sizeof (EFI_COMMON_SECTION_HEADER2);
+      if (Offset + HeaderSize > File->DataSize) {
+        return EFI_DEVICE_ERROR;
+      }
+      SectionSize = SECTION2_SIZE (Section);
+    } else {
+      HeaderSize  = sizeof (EFI_COMMON_SECTION_HEADER);
+      SectionSize = SECTION_SIZE (Section);
+    }
+
+    if (SectionSize < HeaderSize || SectionSize > File->DataSize - Offset) {
+      return EFI_DEVICE_ERROR;
+    }
+
+    if (Section->Type == EFI_SECTION_COMPRESSION || Section->Type == EFI_SECTION_GUID_DEFINED) {
+      return EFI_UNSUPPORTED;
+    }
+
+    if (Section->Type == SectionType) {
+      if (Instance == SectionInstance) {
+        *Data     = (UINT8 *) Section + HeaderSize;
+        *DataSize = SectionSize - HeaderSize;
+        return EFI_SUCCESS;
+      }
+      Instance++;
+    }
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Read the requested file (NameGuid) or file information from the firmware volume
+  and returns data in Buffer.
+
+  @param  This                  The EFI_FIRMWARE_VOLUME_PROTOCOL instance.
+  @param  NameGuid              The pointer to EFI_GUID, which is the filename of
+                                the file to read.
+  @param  Buffer                The pointer to pointer to buffer in which contents of file are returned.
+  @param  BufferSize            On input: The buffer size. On output: The size
+                                required to complete the read.
+  @param  FoundType             The pointer to the type of the file whose data
+                                is returned.
+  @param  FileAttributes        The pointer to attributes of the file whose data
+                                is returned.
+  @param  AuthenticationStatus  The pointer to the authentication status of the data.
+
+  @retval EFI_SUCCESS               The call completed successfully.
+  @retval EFI_WARN_BUFFER_TOO_SMALL The buffer is too small to contain the requested output.
+                                    The buffer filled, and the output is truncated.
+  @retval EFI_NOT_FOUND             NameGuid was not found in the firmware volume.
+  @retval EFI_DEVICE_ERROR          The firmware volume is corrupted.
+  @retval EFI_OUT_OF_RESOURCES      An allocation failure occurred.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvReadFile (
+  IN     EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  IN     EFI_GUID                      *NameGuid,
+  IN OUT VOID                          **Buffer,
+  IN OUT UINTN                         *BufferSize,
+  OUT    EFI_FV_FILETYPE               *FoundType,
+  OUT    EFI_FV_FILE_ATTRIBUTES        *FileAttributes,
+  OUT    UINT32                        *AuthenticationStatus
+  )
+{
+  FRAMEWORK_FV_DEVICE  *Device;
+  FRAMEWORK_FV_FILE    *File;
+
+  Device = FRAMEWORK_FV_DEVICE_FROM_THIS (This);
+
+  if (EFI_ERROR (InternalFvBuildIndex (Device))) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  File = InternalFvFindFile (Device, NameGuid);
+  if (File == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  *FoundType            = File->FileHeader->Type;
+  *FileAttributes       = InternalFvFileAttributes (File->FileHeader->Attributes);
+  *AuthenticationStatus = 0;
+
+  return InternalFvReturnData (
+           Device,
+           (UINT8 *) File->FileHeader + File->HeaderSize,
+           File->DataSize,
+           Buffer,
+           BufferSize
+           );
+}
+
+/**
+  Read the requested section from the specified file and returns data in Buffer.
+
+  The leaf sections at the top level of the file are read in place. A request that
+  reaches an encapsulation section before the requested instance is found is passed
+  to the Section Extraction Protocol, which numbers the instances the same way.
+
+  @param  This                  Indicates the EFI_FIRMWARE_VOLUME_PROTOCOL instance.
+  @param  NameGuid              Filename identifying the file from which to read.
+  @param  SectionType           The section type to retrieve.
+  @param  SectionInstance       The instance of SectionType to retrieve.
+  @param  Buffer                Pointer to pointer to buffer in which contents of
+                                a file are returned.
+  @param  BufferSize            The pointer to the buffer size passed in, and on
+                                output the size required to complete the read.
+  @param  AuthenticationStatus  The pointer to the authentication status of the data.
+
+  @retval EFI_SUCCESS                The call completed successfully.
+  @retval EFI_WARN_BUFFER_TOO_SMALL  The buffer is too small to contain the requested output.
+                                     The buffer is filled and the output is truncated.
+  @retval EFI_OUT_OF_RESOURCES       An allocation failure occurred.
+  @retval EFI_NOT_FOUND              The name was not found in the firmware volume.
+  @retval EFI_DEVICE_ERROR           The firmware volume is corrupted.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvReadSection (
+  IN     EFI_FIRMWARE_VOLUME_PROTOCOL  *This,
+  IN     EFI_GUID                      *NameGuid,
+  IN     EFI_SECTION_TYPE              SectionType,
+  IN     UINTN                         SectionInstance,
+  IN OUT VOID                          **Buffer,
+  IN OUT UINTN                         *BufferSize,
+  OUT    UINT32                        *AuthenticationStatus
+  )
+{
+  EFI_STATUS           Status;
+  FRAMEWORK_FV_DEVICE  *Device;
+  FRAMEWORK_FV_FILE    *File;
+  UINT8                *Data;
+  UINTN                DataSize;
+
+  Device = FRAMEWORK_FV_DEVICE_FROM_THIS (This);
+
+  if (EFI_ERROR (InternalFvBuildIndex (Device))) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  File = InternalFvFindFile (Device, NameGuid);
+  if (File == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = InternalFvFindSection (File, SectionType, SectionInstance, &Data, &DataSize);
+  if (Status == EFI_UNSUPPORTED) {
+    return InternalFvExtractSection (
+             Device,
+             (UINT8 *) File->FileHeader + File->HeaderSize,
+             File->DataSize,
+             SectionType,
+             SectionInstance,
+             Buffer,
+             BufferSize,
+             AuthenticationStatus
+             );
+  }
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *AuthenticationStatus = 0;
+  return InternalFvReturnData (Device, Data, DataSize, Buffer, BufferSize);
+}
+
+/**
+  Returns a read only pointer to the data of a file in the firmware volume.
+
+  @param  This                  Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL instance.
+  @param  NameGuid              The name of the file.
+  @param  Data                  Returns a pointer to the data of the file.
+  @param  DataSize              Returns the size of the data of the file.
+  @param  FoundType             Returns the type of the file.
+  @param  FileAttributes        Returns the attributes of the file.
+  @param  AuthenticationStatus  Returns the authentication status of the data.
+
+  @retval EFI_SUCCESS           The data of the file was mapped.
+  @retval EFI_NOT_FOUND         NameGuid was not found in the firmware volume.
+  @retval EFI_ACCESS_DENIED     Writes are enabled on the firmware volume.
+  @retval EFI_DEVICE_ERROR      The firmware volume is corrupted.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvMapFile (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL  *This,
+  IN  EFI_GUID                                          *NameGuid,
+  OUT CONST VOID                                        **Data,
+  OUT UINTN                                             *DataSize,
+  OUT EFI_FV_FILETYPE                                   *FoundType,
+  OUT EFI_FV_FILE_ATTRIBUTES                            *FileAttributes,
+  OUT UINT32                                            *AuthenticationStatus
+  )
+{
+  FRAMEWORK_FV_DEVICE  *Device;
+  FRAMEWORK_FV_FILE    *File;
+
+  Device = FRAMEWORK_FV_DEVICE_FROM_ZERO_COPY (This);
+
+  //
+  // WriteFile() moves and erases files in place, which would leave a mapped
+  // pointer on stale or erased flash.
+  //
+  if (Device->Fvb != NULL) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  if (EFI_ERROR (InternalFvBuildIndex (Device))) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  File = InternalFvFindFile (Device, NameGuid);
+  if (File == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  *Data                 = (UINT8 *) File->FileHeader + File->HeaderSize;
+  *DataSize             = File->DataSize;
+  *FoundType            = File->FileHeader->Type;
+  *FileAttributes       = InternalFvFileAttributes (File->FileHeader->Attributes);
+  *AuthenticationStatus = 0;
+
+  Device->Statistics.BytesMapped += File->DataSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns a read only pointer to the contents of a section of a file in the firmware
+  volume.
+
+  @param  This                  Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL instance.
+  @param  NameGuid              The name of the file.
+  @param  SectionType           The section type to retrieve.
+  @param  SectionInstance       The instance of SectionType to retrieve.
+  @param  Data                  Returns a pointer to the contents of the section.
+  @param  DataSize              Returns the size of the contents of the section.
+  @param  AuthenticationStatus  Returns the authentication status of the data.
+
+  @retval EFI_SUCCESS           The section was mapped.
+  @retval EFI_NOT_FOUND         The file or the section was not found.
+  @retval EFI_UNSUPPORTED       The section may be inside an encapsulation section and can
+                                only be read with ReadSection().
+  @retval EFI_ACCESS_DENIED     Writes are enabled on the firmware volume.
+  @retval EFI_DEVICE_ERROR      The firmware volume is corrupted.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvMapSection (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_ZERO_COPY_PROTOCOL  *This,
+  IN  EFI_GUID                                          *NameGuid,
+  IN  EFI_SECTION_TYPE                                  SectionType,
+  IN  UINTN                                             SectionInstance,
+  OUT CONST VOID                                        **Data,
+  OUT UINTN                                             *DataSize,
+  OUT UINT32                                            *AuthenticationStatus
+  )
+{
+  EFI_STATUS           Status;
+  FRAMEWORK_FV_DEVICE  *Device;
+  FRAMEWORK_FV_FILE    *File;
+  UINT8                *SectionData;
+
+  Device = FRAMEWORK_FV_DEVICE_FROM_ZERO_COPY (This);
+
+  //
+  // WriteFile() moves and erases files in place, which would leave a mapped
+  // pointer on stale or erased flash.
+  //
+  if (Device->Fvb != NULL) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  if (EFI_ERROR (InternalFvBuildIndex (Device))) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  File = InternalFvFindFile (Device, NameGuid);
+  if (File == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = InternalFvFindSection (File, SectionType, SectionInstance, &SectionData, DataSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Data                 = SectionData;
+  *AuthenticationStatus = 0;
+
+  Device->Statistics.BytesMapped += *DataSize;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,1552 @@
+/** @file
+  WriteFile() service of the Framework firmware volume library.
+
+  A write of several files is planned as a whole instead of file by file. If the
+  free space of the volume can hold all the new files, they are laid out together
+  and programmed with one Write() per block they cover, and only the State bytes of
+  the files they replace are programmed afterwards. Otherwise the new contents of
+  the whole volume are built in memory, with the live files compacted and the new
+  files appended, and compared with the volume block by block: a block is erased
+  only if a bit has to return to the erased value, consecutive erased blocks are
+  erased by one EraseBlocks() request, and a block that can be updated in place only
+  has its changed bytes programmed.
+
+  Under the reliable write policy the new contents of every block that a reclaim
+  changes are first saved to the spare blocks, together with a journal of their
+  target blocks. The journal is only valid once all of them are saved, and it is
+  marked complete once the volume is updated, so an interrupted reclaim is either
+  not started or completed by FrameworkFvRecoverWrite().
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FrameworkFvInternal.h"
+
+#define FRAMEWORK_FV_JOURNAL_SIGNATURE  SIGNATURE_32 ('F', 'V', 'J', 'R')
+
+///
+/// The largest file whose size fits in the Size field of EFI_FFS_FILE_HEADER.
+///
+#define FRAMEWORK_FV_MAX_FFS_SIZE       0x00FFFFFF
+
+#pragma pack(1)
+///
+/// Header of the journal in the first spare block. SpareValid and Complete are
+/// programmed to the complement of ErasePolarity when the corresponding step is done.
+///
+typedef struct {
+  UINT32  Signature;        ///< FRAMEWORK_FV_JOURNAL_SIGNATURE.
+  UINT32  BlockCount;       ///< Number of FRAMEWORK_FV_JOURNAL_ENTRY that follow.
+  UINT8   ErasePolarity;    ///< Value of an erased byte of the spare blocks.
+  UINT8   SpareValid;       ///< The spare blocks hold the new contents of all the blocks.
+  UINT8   Complete;         ///< The blocks of the firmware volume are updated.
+  UINT8   Reserved[5];
+} FRAMEWORK_FV_JOURNAL_HEADER;
+
+///
+/// A block of the firmware volume whose new contents are in spare block SpareLba + 1
+/// plus the index of the entry.
+///
+typedef struct {
+  EFI_LBA  Lba;
+  UINT32   Length;
+  UINT32   Reserved;
+} FRAMEWORK_FV_JOURNAL_ENTRY;
+#pragma pack()
+
+///
+/// A range of the firmware volume whose contents are being laid out in Buffer. The
+/// files are only placed, not stored, if Buffer is NULL.
+///
+typedef struct {
+  UINT8   *Buffer;          ///< Contents of the range.
+  UINT64  Start;            ///< Offset of the range in the volume.
+  UINT64  End;              ///< Offset of the end of the range in the volume.
+  UINT64  Offset;           ///< Offset of the next file, aligned on 8 bytes.
+} FRAMEWORK_FV_STAGE;
+
+///
+/// A block of the firmware volume that a reclaim changes.
+///
+typedef struct {
+  EFI_LBA  Lba;
+  UINT64   Offset;          ///< Offset of the block in the volume.
+  UINTN    Length;
+  BOOLEAN  Erase;           ///< A bit of the block must return to the erased value.
+} FRAMEWORK_FV_BLOCK_CHANGE;
+
+/**
+  Reads from one block through a firmware volume block protocol.
+
+  @param  Fvb       The firmware volume block protocol.
+  @param  Lba       The block.
+  @param  Offset    The offset in the block.
+  @param  Buffer    Receives the data.
+  @param  Length    The number of bytes to read. They must not span the end of the block.
+
+  @retval EFI_SUCCESS       The data was read.
+  @retval EFI_DEVICE_ERROR  The block could not be read.
+
+**/
+EFI_STATUS
+InternalFvbRead (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN  EFI_LBA                                       Lba,
+  IN  UINTN                                         Offset,
+  OUT VOID                                          *Buffer,
+  IN  UINTN                                         Length
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       NumBytes;
+
+  NumBytes = Length;
+  Status   = Fvb->Read (Fvb, Lba, Offset, &NumBytes, Buffer);
+  if (EFI_ERROR (Status) || NumBytes != Length) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Programs one block through a firmware volume block protocol.
+
+  @param  Statistics  The counters to update, or NULL.
+  @param  Fvb         The firmware volume block protocol.
+  @param  Lba         The block.
+  @param  Offset      The offset in the block.
+  @param  Buffer      The data.
+  @param  Length      The number of bytes to program. They must not span the end of
+                      the block.
+
+  @retval EFI_SUCCESS       The data was programmed.
+  @retval EFI_DEVICE_ERROR  The block could not be programmed.
+
+**/
+EFI_STATUS
+InternalFvbWrite (
+  IN OUT FRAMEWORK_FV_STATISTICS                       *Statistics  OPTIONAL,
+  IN     FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN     EFI_LBA                                       Lba,
+  IN     UINTN                                         Offset,
+  IN     CONST VOID                                    *Buffer,
+  IN     UINTN                                         Length
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       NumBytes;
+
+  if (Length == 0) {
+    return EFI_SUCCESS;
+  }
+
+  NumBytes = Length;
+  Status   = Fvb->Write (Fvb, Lba, Offset, &NumBytes, (UINT8 *) Buffer);
+  if (Statistics != NULL) {
+    Statistics->WriteCalls++;
+    Statistics->BytesWritten += NumBytes;
+  }
+  if (EFI_ERROR (Status) || NumBytes != Length) {
+    DEBUG ((DEBUG_ERROR, "FrameworkFv: write of block 0x%lx failed - %r\n", Lba, Status));
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Erases consecutive blocks through a firmware volume block protocol, with one request.
+
+  @param  Statistics  The counters to update, or NULL.
+  @param  Fvb         The firmware volume block protocol.
+  @param  Lba         The first block.
+  @param  Count       The number of blocks.
+
+  @retval EFI_SUCCESS       The blocks were erased.
+  @retval EFI_DEVICE_ERROR  The blocks could not be erased.
+
+**/
+EFI_STATUS
+InternalFvbErase (
+  IN OUT FRAMEWORK_FV_STATISTICS                       *Statistics  OPTIONAL,
+  IN     FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN     EFI_LBA                                       Lba,
+  IN     UINTN                                         Count
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Fvb->EraseBlocks (Fvb, Lba, Count, FRAMEWORK_EFI_LBA_LIST_TERMINATOR);
+  if (Statistics != NULL) {
+    Statistics->EraseCalls++;
+    Statistics->BlocksErased += Count;
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "FrameworkFv: erase of 0x%x blocks at 0x%lx failed - %r\n", Count, Lba, Status));
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the length of a buffer without its trailing erased bytes.
+
+  @param  Buffer          The buffer.
+  @param  Length          The length of the buffer.
+  @param  ErasePolarity   The value of an erased byte.
+
+  @return The number of bytes up to and including the last byte that is not erased.
+
+**/
+UINTN
+InternalFvUsedLength (
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length,
+  IN UINT8        ErasePolarity
+  )
+{
+  while (Length > 0 && Buffer[Length - 1] == ErasePolarity) {
+    Length--;
+  }
+
+  return Length;
+}
+
+/**
+  Finds the block that holds an offset of the firmware volume.
+
+  @param  Device        The firmware volume.
+  @param  Offset        The offset in the volume.
+  @param  Lba           Returns the block.
+  @param  BlockOffset   Returns the offset of the block in the volume.
+  @param  BlockLength   Returns the length of the block.
+
+  @retval TRUE    The block was found.
+  @retval FALSE   Offset is beyond the block map.
+
+**/
+BOOLEAN
+InternalFvLocateBlock (
+  IN  CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN  UINT64                     Offset,
+  OUT EFI_LBA                    *Lba,
+  OUT UINT64                     *BlockOffset,
+  OUT UINTN                      *BlockLength
+  )
+{
+  UINTN   Index;
+  UINT64  Start;
+  UINT64  Span;
+  UINT64  Block;
+
+  *Lba  = 0;
+  Start = 0;
+  for (Index = 0; Index < Device->BlockMapCount; Index++) {
+    Span = MultU64x32 (Device->BlockMap[Index].Length, Device->BlockMap[Index].NumBlocks);
+    if (Offset < Start + Span) {
+      Block         = DivU64x32 (Offset - Start, Device->BlockMap[Index].Length);
+      *Lba         += Block;
+      *BlockOffset  = Start + MultU64x32 (Block, Device->BlockMap[Index].Length);
+      *BlockLength  = Device->BlockMap[Index].Length;
+      return TRUE;
+    }
+    Start += Span;
+    *Lba  += Device->BlockMap[Index].NumBlocks;
+  }
+
+  return FALSE;
+}
+
+/**
+  Programs a range of the firmware volume, with one Write() per block it covers.
+
+  @param  Device    The firmware volume.
+  @param  Offset    The offset of the range in the volume.
+  @param  Buffer    The data.
+  @param  Length    The length of the range.
+
+  @retval EFI_SUCCESS       The range was programmed.
+  @retval EFI_DEVICE_ERROR  The range could not be programmed.
+
+**/
+EFI_STATUS
+InternalFvProgram (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device,
+  IN     UINT64               Offset,
+  IN     CONST UINT8          *Buffer,
+  IN     UINTN                Length
+  )
+{
+  EFI_STATUS  Status;
+  EFI_LBA     Lba;
+  UINT64      BlockOffset;
+  UINTN       BlockLength;
+  UINTN       Chunk;
+
+  while (Length > 0) {
+    if (!InternalFvLocateBlock (Device, Offset, &Lba, &BlockOffset, &BlockLength)) {
+      return EFI_DEVICE_ERROR;
+    }
+    Chunk = (UINTN) MIN ((UINT64) Length, BlockOffset + BlockLength - Offset);
+    Status = InternalFvbWrite (&Device->Statistics, Device->Fvb, Lba, (UINTN) (Offset - BlockOffset), Buffer, Chunk);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Offset += Chunk;
+    Buffer += Chunk;
+    Length -= Chunk;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the value of the State field of an FFS file once the state bits are set.
+
+  @param  Device    The firmware volume.
+  @param  State     The state bits, such as EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID.
+
+  @return The value of the State field.
+
+**/
+UINT8
+InternalFvStateValue (
+  IN CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN UINT8                      State
+  )
+{
+  return (UINT8) (State ^ Device->ErasePolarity);
+}
+
+/**
+  Returns the value of the State field of an FFS file once a state bit is added.
+
+  @param  Device    The firmware volume.
+  @param  Current   The current value of the State field.
+  @param  State     The state bit to set.
+
+  @return The new value of the State field.
+
+**/
+UINT8
+InternalFvAddState (
+  IN CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN UINT8                      Current,
+  IN UINT8                      State
+  )
+{
+  return InternalFvStateValue (Device, (UINT8) ((Current ^ Device->ErasePolarity) | State));
+}
+
+/**
+  Sets a state bit of a file of the firmware volume by programming its State field.
+
+  @param  Device      The firmware volume.
+  @param  FileHeader  The file header, in the volume.
+  @param  State       The state bit to set.
+
+  @retval EFI_SUCCESS       The state bit was set.
+  @retval EFI_DEVICE_ERROR  The State field could not be programmed.
+
+**/
+EFI_STATUS
+InternalFvSetFileState (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device,
+  IN     EFI_FFS_FILE_HEADER  *FileHeader,
+  IN     UINT8                State
+  )
+{
+  UINT8  Value;
+
+  Value = InternalFvAddState (Device, FileHeader->State, State);
+  return InternalFvProgram (
+           Device,
+           (UINT64) ((UINT8 *) &FileHeader->State - (UINT8 *) Device->FvHeader),
+           &Value,
+           sizeof (Value)
+           );
+}
+
+/**
+  Returns the size of the header of an FFS file.
+
+  @param  Device    The firmware volume.
+  @param  DataSize  The size of the file data.
+
+  @return The size of the header, or 0 if the file is too large for the volume.
+
+**/
+UINT32
+InternalFvHeaderSize (
+  IN CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN UINT64                     DataSize
+  )
+{
+  if (DataSize + sizeof (EFI_FFS_FILE_HEADER) <= FRAMEWORK_FV_MAX_FFS_SIZE) {
+    return sizeof (EFI_FFS_FILE_HEADER);
+  }
+  if (Device->Ffs3 && DataSize + sizeof (EFI_FFS_FILE_HEADER2) <= MAX_UINT32) {
+    return sizeof (EFI_FFS_FILE_HEADER2);
+  }
+  return 0;
+}
+
+/**
+  Initializes the header of an FFS file.
+
+  @param  Device      The firmware volume.
+  @param  FileHeader  The header to initialize.
+  @param  NameGuid    The name of the file, or NULL for a pad file.
+  @param  Type        The type of the file.
+  @param  Attributes  The FFS attributes of the file, without FFS_ATTRIB_LARGE_FILE.
+  @param  HeaderSize  The size of the header returned by InternalFvHeaderSize().
+  @param  FileSize    The size of the file, including the header.
+  @param  State       The state bits of the file.
+
+**/
+VOID
+InternalFvInitializeHeader (
+  IN  CONST FRAMEWORK_FV_DEVICE  *Device,
+  OUT EFI_FFS_FILE_HEADER        *FileHeader,
+  IN  CONST EFI_GUID             *NameGuid    OPTIONAL,
+  IN  EFI_FV_FILETYPE            Type,
+  IN  EFI_FFS_FILE_ATTRIBUTES    Attributes,
+  IN  UINT32                     HeaderSize,
+  IN  UINT32                     FileSize,
+  IN  UINT8                      State
+  )
+{
+  ZeroMem (FileHeader, HeaderSize);
+  if (NameGuid != NULL) {
+    CopyGuid (&FileHeader->Name, NameGuid);
+  }
+  FileHeader->Type       = Type;
+  FileHeader->Attributes = Attributes;
+  if (HeaderSize == sizeof (EFI_FFS_FILE_HEADER2)) {
+    FileHeader->Attributes |= FFS_ATTRIB_LARGE_FILE;
+    ((EFI_FFS_FILE_HEADER2 *) FileHeader)->ExtendedSize = FileSize;
+  } else {
+    FileHeader->Size[0] = (UINT8) FileSize;
+    FileHeader->Size[1] = (UINT8) (FileSize >> 8);
+    FileHeader->Size[2] = (UINT8) (FileSize >> 16);
+  }
+
+  //
+  // The header checksum is computed with the State and file checksum fields zero.
+  //
+  FileHeader->IntegrityCheck.Checksum.Header = CalculateCheckSum8 ((UINT8 *) FileHeader, HeaderSize);
+  FileHeader->IntegrityCheck.Checksum.File   = Device->Ffs2 ? FFS_FIXED_CHECKSUM : FRAMEWORK_FFS_FIXED_CHECKSUM;
+  FileHeader->State                          = InternalFvStateValue (Device, State);
+}
+
+/**
+  Places the next file of a stage so that its data is aligned, preceded by a pad file
+  if needed.
+
+  @param  Device          The firmware volume.
+  @param  Stage           The stage.
+  @param  HeaderSize      The size of the header of the file.
+  @param  FileSize        The size of the file, including the header.
+  @param  AlignmentShift  The log2 of the alignment of the file data.
+  @param  FileHeader      Returns the location of the file in the stage buffer, or
+                          NULL if the stage has no buffer.
+
+  @retval EFI_SUCCESS           The file was placed, and the offset of the stage is
+                                moved past it.
+  @retval EFI_OUT_OF_RESOURCES  The stage cannot hold the file.
+
+**/
+EFI_STATUS
+InternalFvStagePlace (
+  IN     CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN OUT FRAMEWORK_FV_STAGE         *Stage,
+  IN     UINT32                     HeaderSize,
+  IN     UINT32                     FileSize,
+  IN     UINT8                      AlignmentShift,
+  OUT    EFI_FFS_FILE_HEADER        **FileHeader
+  )
+{
+  UINT64  FileOffset;
+  UINT64  DataOffset;
+  UINT32  Alignment;
+
+  FileOffset = Stage->Offset;
+  if (AlignmentShift > 3) {
+    //
+    // Files are aligned on 8 bytes, so a larger data alignment needs a pad file,
+    // which cannot be smaller than its header.
+    //
+    Alignment  = 1U << AlignmentShift;
+    DataOffset = ALIGN_VALUE (FileOffset + HeaderSize, (UINT64) Alignment);
+    if (DataOffset != FileOffset + HeaderSize &&
+        DataOffset - HeaderSize - FileOffset < sizeof (EFI_FFS_FILE_HEADER)) {
+      DataOffset += Alignment;
+    }
+    FileOffset = DataOffset - HeaderSize;
+  }
+
+  if (FileOffset + FileSize > Stage->End) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  *FileHeader = NULL;
+  if (Stage->Buffer != NULL) {
+    if (FileOffset != Stage->Offset) {
+      InternalFvInitializeHeader (
+        Device,
+        (EFI_FFS_FILE_HEADER *) (Stage->Buffer + (UINTN) (Stage->Offset - Stage->Start)),
+        NULL,
+        EFI_FV_FILETYPE_FFS_PAD,
+        0,
+        sizeof (EFI_FFS_FILE_HEADER),
+        (UINT32) (FileOffset - Stage->Offset),
+        EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID
+        );
+    }
+    *FileHeader = (EFI_FFS_FILE_HEADER *) (Stage->Buffer + (UINTN) (FileOffset - Stage->Start));
+  }
+
+  Stage->Offset = ALIGN_VALUE (FileOffset + FileSize, 8);
+  return EFI_SUCCESS;
+}
+
+/**
+  Lays out a new file in a stage.
+
+  @param  Device      The firmware volume.
+  @param  Stage       The stage.
+  @param  FileData    The file.
+  @param  State       The state bits of the file.
+  @param  FileOffset  Returns the offset of the file in the volume. Optional.
+
+  @retval EFI_SUCCESS           The file was laid out.
+  @retval EFI_OUT_OF_RESOURCES  The stage cannot hold the file.
+
+**/
+EFI_STATUS
+InternalFvStageNewFile (
+  IN     CONST FRAMEWORK_FV_DEVICE               *Device,
+  IN OUT FRAMEWORK_FV_STAGE                      *Stage,
+  IN     CONST FRAMEWORK_EFI_FV_WRITE_FILE_DATA  *FileData,
+  IN     UINT8                                   State,
+  OUT    UINT64                                  *FileOffset  OPTIONAL
+  )
+{
+  EFI_STATUS           Status;
+  EFI_FFS_FILE_HEADER  *FileHeader;
+  UINT32               HeaderSize;
+  UINT32               Requested;
+  UINT8                AlignmentIndex;
+
+  Requested = (UINT32) (FileData->FileAttributes & FRAMEWORK_FV_FILE_ATTRIB_ALIGNMENT);
+  for (AlignmentIndex = 0; mFfsAlignmentShift[AlignmentIndex] < Requested; AlignmentIndex++) {
+  }
+
+  HeaderSize = InternalFvHeaderSize (Device, FileData->BufferSize);
+  Status = InternalFvStagePlace (
+             Device,
+             Stage,
+             HeaderSize,
+             HeaderSize + FileData->BufferSize,
+             mFfsAlignmentShift[AlignmentIndex],
+             &FileHeader
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (FileHeader != NULL) {
+    InternalFvInitializeHeader (
+      Device,
+      FileHeader,
+      FileData->NameGuid,
+      FileData->Type,
+      (EFI_FFS_FILE_ATTRIBUTES) (AlignmentIndex << 3),
+      HeaderSize,
+      HeaderSize + FileData->BufferSize,
+      State
+      );
+    CopyMem ((UINT8 *) FileHeader + HeaderSize, FileData->Buffer, FileData->BufferSize);
+    if (FileOffset != NULL) {
+      *FileOffset = Stage->Start + (UINT64) ((UINT8 *) FileHeader - Stage->Buffer);
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Copies a live file of the firmware volume to a stage, as a valid file.
+
+  @param  Device    The firmware volume.
+  @param  Stage     The stage.
+  @param  File      The file.
+
+  @retval EFI_SUCCESS           The file was copied.
+  @retval EFI_OUT_OF_RESOURCES  The stage cannot hold the file.
+
+**/
+EFI_STATUS
+InternalFvStageLiveFile (
+  IN     CONST FRAMEWORK_FV_DEVICE  *Device,
+  IN OUT FRAMEWORK_FV_STAGE         *Stage,
+  IN     CONST FRAMEWORK_FV_FILE    *File
+  )
+{
+  EFI_STATUS           Status;
+  EFI_FFS_FILE_HEADER  *FileHeader;
+
+  Status = InternalFvStagePlace (
+             Device,
+             Stage,
+             File->HeaderSize,
+             File->FileSize,
+             mFfsAlignmentShift[(File->FileHeader->Attributes & FFS_ATTRIB_DATA_ALIGNMENT) >> 3],
+             &FileHeader
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (FileHeader != NULL) {
+    CopyMem (FileHeader, File->FileHeader, File->FileSize);
+    FileHeader->State = InternalFvStateValue (
+                          Device,
+                          EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID
+                          );
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Validates the files of a write.
+
+  @param  Device          The firmware volume.
+  @param  NumberOfFiles   The number of files.
+  @param  FileData        The files.
+
+  @retval EFI_SUCCESS             The files can be written.
+  @retval EFI_INVALID_PARAMETER   A file is not valid, a delete is part of a multiple
+                                  file write, or a file is written twice.
+
+**/
+EFI_STATUS
+InternalFvCheckFileData (
+  IN CONST FRAMEWORK_FV_DEVICE               *Device,
+  IN UINT32                                  NumberOfFiles,
+  IN CONST FRAMEWORK_EFI_FV_WRITE_FILE_DATA  *FileData
+  )
+{
+  UINT32  Index;
+  UINT32  Other;
+
+  for (Index = 0; Index < NumberOfFiles; Index++) {
+    if (FileData[Index].NameGuid == NULL) {
+      return EFI_INVALID_PARAMETER;
+    }
+    for (Other = 0; Other < Index; Other++) {
+      if (CompareGuid (FileData[Other].NameGuid, FileData[Index].NameGuid)) {
+        return EFI_INVALID_PARAMETER;
+      }
+    }
+
+    if (FileData[Index].BufferSize == 0) {
+      //
+      // A file without data is a delete, which cannot be part of a multiple file write.
+      //
+      if (NumberOfFiles != 1) {
+        return EFI_INVALID_PARAMETER;
+      }
+      continue;
+    }
+
+    if (FileData[Index].Buffer == NULL ||
+        FileData[Index].Type == EFI_FV_FILETYPE_ALL ||
+        FileData[Index].Type == EFI_FV_FILETYPE_FFS_PAD ||
+        (FileData[Index].FileAttributes & FRAMEWORK_FV_FILE_ATTRIB_ALIGNMENT) > mFfsAlignmentShift[7] ||
+        InternalFvHeaderSize (Device, FileData[Index].BufferSize) == 0) {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Flags the files of the index that have the name of a file of a write, including
+  the copies that are superseded by the live file.
+
+  @param  Device          The firmware volume.
+  @param  NumberOfFiles   The number of files of the write.
+  @param  FileData        The files of the write.
+  @param  Replaced        Set to TRUE for each file of the index that is replaced.
+
+  @return The number of files of the write that replace a live file.
+
+**/
+UINTN
+InternalFvFindReplaced (
+  IN OUT FRAMEWORK_FV_DEVICE                     *Device,
+  IN     UINT32                                  NumberOfFiles,
+  IN     CONST FRAMEWORK_EFI_FV_WRITE_FILE_DATA  *FileData,
+  OUT    BOOLEAN                                 *Replaced
+  )
+{
+  FRAMEWORK_FV_FILE  *File;
+  FRAMEWORK_FV_FILE  *Live;
+  UINT32             Index;
+  UINTN              Count;
+
+  Count = 0;
+  for (Index = 0; Index < NumberOfFiles; Index++) {
+    File = InternalFvFindFile (Device, FileData[Index].NameGuid);
+    if (File != NULL) {
+      Replaced[File - Device->Files] = TRUE;
+      Count++;
+    }
+  }
+
+  //
+  // A superseded file has the name of a live file, which the index finds.
+  //
+  for (Index = 0; Index < Device->FileCount; Index++) {
+    File = &Device->Files[Index];
+    if (File->Superseded) {
+      Live = InternalFvFindFile (Device, &File->FileHeader->Name);
+      if (Live != NULL && Replaced[Live - Device->Files]) {
+        Replaced[Index] = TRUE;
+      }
+    }
+  }
+
+  return Count;
+}
+
+/**
+  Sets a state bit of the replaced files.
+
+  @param  Device      The firmware volume.
+  @param  Replaced    The replaced files, indexed like Files.
+  @param  State       The state bit to set.
+
+  @retval EFI_SUCCESS       The state bit was set.
+  @retval EFI_DEVICE_ERROR  A State field could not be programmed.
+
+**/
+EFI_STATUS
+InternalFvSetReplacedState (
+  IN OUT FRAMEWORK_FV_DEVICE  *Device,
+  IN     CONST BOOLEAN        *Replaced,
+  IN     UINT8                State
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+
+  for (Index = 0; Index < Device->FileCount; Index++) {
+    if (Replaced[Index]) {
+      Status = InternalFvSetFileState (Device, Device->Files[Index].FileHeader, State);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Places the new files in the free space of the firmware volume.
+
+  @param  Device          The firmware volume.
+  @param  NumberOfFiles   The number of files.
+  @param  FileData        The files.
+
+  @return The length of the free space that the files use, or 0 if the erased free
+          space cannot hold them.
+
+**/
+UINTN
+InternalFvPlaceInFreeSpace (
+  IN CONST FRAMEWORK_FV_DEVICE               *Device,
+  IN UINT32                                  NumberOfFiles,
+  IN CONST FRAMEWORK_EFI_FV_WRITE_FILE_DATA  *FileData
+  )
+{
+  FRAMEWORK_FV_STAGE  Stage;
+  CONST UINT8         *FreeSpace;
+  UINTN               Length;
+  UINTN               Index;
+
+  Stage.Buffer = NULL;
+  Stage.Start  = Device->FreeOffset;
+  Stage.End    = Device->FvLength;
+  Stage.Offset = Device->FreeOffset;
+  for (Index = 0; Index < NumberOfFiles; Index++) {
+    if (EFI_ERROR (InternalFvStageNewFile (Device, &Stage, &FileData[Index], 0, NULL))) {
+      return 0;
+    }
+  }
+
+  Length    = (UINTN) (MIN (Stage.Offset, Device->FvLength) - Device->FreeOffset);
+  FreeSpace = (CONST UINT8 *) Device->FvHeader + (UINTN) Device->FreeOffset;
+  for (Index = 0; Index < Length; Index++) {
+    if (FreeSpace[Index] != Device->ErasePolarity) {
+      return 0;
+    }
+  }
+
+  return Length;
+}
+
+/**
+  Writes the new files to the free space of the firmware volume.
+
+  The new files are laid out together and programmed by one pass over the blocks
+  they cover. The replaced files are marked for update before and deleted after.
+  Under the reliable write policy, which this path serves for a single file, the
+  file is programmed with a valid header and its data is marked valid once it is
+  programmed.
+
+  @param  Device          The firmware volume.
+  @param  NumberOfFiles   The number of files.
+  @param  WritePolicy     The write policy.
+  @param  FileData        The files.
+  @param  Replaced        The files of the index that the new files replace.
+  @param  Length          The length of the free space used, from InternalFvPlaceInFreeSpace().
+
+  @retval EFI_SUCCESS             The files were written.
+  @retval EFI_DEVICE_ERROR        The firmware volume could not be written.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalFvAppendFiles (
+  IN OUT FRAMEWORK_FV_DEVICE                     *Device,
+  IN     UINT32                                  NumberOfFiles,
+  IN     FRAMEWORK_EFI_FV_WRITE_POLICY           WritePolicy,
+  IN     CONST FRAMEWORK_EFI_FV_WRITE_FILE_DATA  *FileData,
+  IN     CONST BOOLEAN                           *Replaced,
+  IN     UINTN                                   Length
+  )
+{
+  EFI_STATUS          Status;
+  FRAMEWORK_FV_STAGE  Stage;
+  UINT64              *FileOffsets;
+  UINTN               Index;
+  UINT8               State;
+
+  Stage.Buffer = AllocatePool (Length);
+  FileOffsets  = AllocatePool (NumberOfFiles * sizeof (UINT64));
+  if (Stage.Buffer == NULL || FileOffsets == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+  SetMem (Stage.Buffer, Length, Device->ErasePolarity);
+  Stage.End    = Device->FreeOffset + Length;
+  Stage.Offset = Device->FreeOffset;
+
+  State = EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID;
+  if (WritePolicy == FRAMEWORK_EFI_FV_UNRELIABLE_WRITE) {
+    State |= EFI_FILE_DATA_VALID;
+  }
+  for (Index = 0; Index < NumberOfFiles; Index++) {
+    Status = InternalFvStageNewFile (Device, &Stage, &FileData[Index], State, &FileOffsets[Index]);
+    ASSERT_EFI_ERROR (Status);
+  }
+
+  Status = InternalFvSetReplacedState (Device, Replaced, EFI_FILE_MARKED_FOR_UPDATE);
+  if (!EFI_ERROR (Status)) {
+    Status = InternalFvProgram (
+               Device,
+               Device->FreeOffset,
+               Stage.Buffer,
+               InternalFvUsedLength (Stage.Buffer, Length, Device->ErasePolarity)
+               );
+  }
+  if (!EFI_ERROR (Status) && WritePolicy == FRAMEWORK_EFI_FV_RELIABLE_WRITE) {
+    for (Index = 0; Index < NumberOfFiles && !EFI_ERROR (Status); Index++) {
+      Status = InternalFvSetFileState (
+                 Device,
+                 (EFI_FFS_FILE_HEADER *) ((UINT8 *) Device->FvHeader + (UINTN) FileOffsets[Index]),
+                 EFI_FILE_DATA_VALID
+                 );
+    }
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = InternalFvSetReplacedState (Device, Replaced, EFI_FILE_DELETED);
+  }
+
+Done:
+  if (Stage.Buffer != NULL) {
+    FreePool (Stage.Buffer);
+  }
+  if (FileOffsets != NULL) {
+    FreePool (FileOffsets);
+  }
+  return Status;
+}
+
+/**
+  Checks whether programming a block from its old contents to its new contents needs
+  an erase, which is the case if a bit has to return to the erased value.
+
+  @param  Old             The old contents.
+  @param  New             The new contents.
+  @param  Length          The length of the block.
+  @param  ErasePolarity   The value of an erased byte.
+
+  @retval TRUE    The block must be erased.
+  @retval FALSE   The block can be programmed in place.
+
+**/
+BOOLEAN
+InternalFvNeedsErase (
+  IN CONST UINT8  *Old,
+  IN CONST UINT8  *New,
+  IN UINTN        Length,
+  IN UINT8        ErasePolarity
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Length; Index++) {
+    if (((Old[Index] ^ New[Index]) & ~(New[Index] ^ ErasePolarity)) != 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Saves the new contents of the changed blocks to the spare blocks, and marks the
+  journal valid once they are all saved.
+
+  @param  Device    The firmware volume.
+  @param  Image     The new contents of the volume.
+  @param  Changes   The changed blocks.
+  @param  Count     The number of changed blocks.
+
+  @retval EFI_SUCCESS             The journal is valid.
+  @retval EFI_DEVICE_ERROR        The spare blocks could not be written.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalFvWriteJournal (
+  IN OUT FRAMEWORK_FV_DEVICE              *Device,
+  IN     CONST UINT8                      *Image,
+  IN     CONST FRAMEWORK_FV_BLOCK_CHANGE  *Changes,
+  IN     UINTN                            Count
+  )
+{
+  EFI_STATUS                   Status;
+  FRAMEWORK_FV_JOURNAL_HEADER  *Journal;
+  FRAMEWORK_FV_JOURNAL_ENTRY   *Entries;
+  UINTN                        JournalSize;
+  UINTN                        Index;
+  UINT8                        Value;
+
+  JournalSize = sizeof (FRAMEWORK_FV_JOURNAL_HEADER) + Count * sizeof (FRAMEWORK_FV_JOURNAL_ENTRY);
+  Journal     = AllocatePool (JournalSize);
+  if (Journal == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  SetMem (Journal, JournalSize, Device->ErasePolarity);
+  Journal->Signature     = FRAMEWORK_FV_JOURNAL_SIGNATURE;
+  Journal->BlockCount    = (UINT32) Count;
+  Journal->ErasePolarity = Device->ErasePolarity;
+  Entries = (FRAMEWORK_FV_JOURNAL_ENTRY *) (Journal + 1);
+  for (Index = 0; Index < Count; Index++) {
+    Entries[Index].Lba      = Changes[Index].Lba;
+    Entries[Index].Length   = (UINT32) Changes[Index].Length;
+    Entries[Index].Reserved = 0;
+  }
+
+  Status = InternalFvbErase (&Device->Statistics, Device->SpareFvb, Device->SpareLba, Count + 1);
+  if (!EFI_ERROR (Status)) {
+    Status = InternalFvbWrite (&Device->Statistics, Device->SpareFvb, Device->SpareLba, 0, Journal, JournalSize);
+  }
+  for (Index = 0; Index < Count && !EFI_ERROR (Status); Index++) {
+    Status = InternalFvbWrite (
+               &Device->Statistics,
+               Device->SpareFvb,
+               Device->SpareLba + 1 + Index,
+               0,
+               Image + (UINTN) Changes[Index].Offset,
+               InternalFvUsedLength (Image + (UINTN) Changes[Index].Offset, Changes[Index].Length, Device->ErasePolarity)
+               );
+  }
+  if (!EFI_ERROR (Status)) {
+    Value  = (UINT8) ~Device->ErasePolarity;
+    Status = InternalFvbWrite (
+               &Device->Statistics,
+               Device->SpareFvb,
+               Device->SpareLba,
+               OFFSET_OF (FRAMEWORK_FV_JOURNAL_HEADER, SpareValid),
+               &Value,
+               sizeof (Value)
+               );
+  }
+  if (!EFI_ERROR (Status)) {
+    Device->Statistics.JournaledBlocks += Count;
+  }
+
+  FreePool (Journal);
+  return Status;
+}
+
+/**
+  Updates the firmware volume to new contents.
+
+  Only the blocks whose contents change are written. A block is erased only if a bit
+  has to return to the erased value, and consecutive blocks to erase are erased by one
+  request. Under the reliable write policy the changed blocks are journaled first.
+
+  @param  Device        The firmware volume.
+  @param  Image         The new contents of the volume.
+  @param  WritePolicy   The write policy.
+
+  @retval EFI_SUCCESS             The volume was updated.
+  @retval EFI_DEVICE_ERROR        The volume could not be written.
+  @retval EFI_OUT_OF_RESOURCES    The spare blocks cannot hold the changed blocks, or
+                                  memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalFvCommitImage (
+  IN OUT FRAMEWORK_FV_DEVICE            *Device,
+  IN     CONST UINT8                    *Image,
+  IN     FRAMEWORK_EFI_FV_WRITE_POLICY  WritePolicy
+  )
+{
+  EFI_STATUS                 Status;
+  CONST UINT8                *Old;
+  FRAMEWORK_FV_BLOCK_CHANGE  *Changes;
+  UINTN                      Count;
+  UINTN                      Index;
+  UINTN                      Run;
+  UINTN                      First;
+  UINTN                      Last;
+  UINTN                      MapIndex;
+  UINT32                     Block;
+  EFI_LBA                    Lba;
+  UINT64                     Offset;
+  CONST UINT8                *New;
+  UINT8                      Value;
+
+  Changes = AllocatePool (Device->BlockCount * sizeof (FRAMEWORK_FV_BLOCK_CHANGE));
+  if (Changes == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Compare the volume with its new contents while the volume is still intact.
+  //
+  Old    = (CONST UINT8 *) Device->FvHeader;
+  Count  = 0;
+  Lba    = 0;
+  Offset = 0;
+  for (MapIndex = 0; MapIndex < Device->BlockMapCount; MapIndex++) {
+    for (Block = 0; Block < Device->BlockMap[MapIndex].NumBlocks; Block++) {
+      if (CompareMem (Old + (UINTN) Offset, Image + (UINTN) Offset, Device->BlockMap[MapIndex].Length) != 0) {
+        Changes[Count].Lba    = Lba;
+        Changes[Count].Offset = Offset;
+        Changes[Count].Length = Device->BlockMap[MapIndex].Length;
+        Changes[Count].Erase  = InternalFvNeedsErase (
+                                  Old + (UINTN) Offset,
+                                  Image + (UINTN) Offset,
+                                  Device->BlockMap[MapIndex].Length,
+                                  Device->ErasePolarity
+                                  );
+        Count++;
+      }
+      Lba++;
+      Offset += Device->BlockMap[MapIndex].Length;
+    }
+  }
+
+  Status = EFI_SUCCESS;
+  if (WritePolicy == FRAMEWORK_EFI_FV_RELIABLE_WRITE && Count > 0) {
+    if (Count > Device->SpareBlocks - 1 ||
+        Count > (Device->SpareBlockLength - sizeof (FRAMEWORK_FV_JOURNAL_HEADER)) / sizeof (FRAMEWORK_FV_JOURNAL_ENTRY)) {
+      DEBUG ((DEBUG_ERROR, "FrameworkFv: 0x%x changed blocks do not fit in the spare blocks\n", Count));
+      Status = EFI_OUT_OF_RESOURCES;
+    } else {
+      Status = InternalFvWriteJournal (Device, Image, Changes, Count);
+    }
+  }
+
+  for (Index = 0; Index < Count && !EFI_ERROR (Status); Index++) {
+    New = Image + (UINTN) Changes[Index].Offset;
+    if (Changes[Index].Erase) {
+      if (Index == 0 || !Changes[Index - 1].Erase || Changes[Index - 1].Lba + 1 != Changes[Index].Lba) {
+        for (Run = 1; Index + Run < Count; Run++) {
+          if (!Changes[Index + Run].Erase || Changes[Index + Run].Lba != Changes[Index].Lba + Run) {
+            break;
+          }
+        }
+        Status = InternalFvbErase (&Device->Statistics, Device->Fvb, Changes[Index].Lba, Run);
+        if (EFI_ERROR (Status)) {
+          break;
+        }
+      }
+      First = 0;
+      Last  = InternalFvUsedLength (New, Changes[Index].Length, Device->ErasePolarity);
+    } else {
+      Old = (CONST UINT8 *) Device->FvHeader + (UINTN) Changes[Index].Offset;
+      for (First = 0; First < Changes[Index].Length && Old[First] == New[First]; First++) {
+      }
+      for (Last = Changes[Index].Length; Last > First && Old[Last - 1] == New[Last - 1]; Last--) {
+      }
+    }
+
+    if (Last > First) {
+      Status = InternalFvbWrite (&Device->Statistics, Device->Fvb, Changes[Index].Lba, First, New + First, Last - First);
+    }
+  }
+
+  if (!EFI_ERROR (Status) && WritePolicy == FRAMEWORK_EFI_FV_RELIABLE_WRITE && Count > 0) {
+    Value  = (UINT8) ~Device->ErasePolarity;
+    Status = InternalFvbWrite (
+               &Device->Statistics,
+               Device->SpareFvb,
+               Device->SpareLba,
+               OFFSET_OF (FRAMEWORK_FV_JOURNAL_HEADER, Complete),
+               &Value,
+               sizeof (Value)
+               );
+  }
+
+  FreePool (Changes);
+  return Status;
+}
+
+/**
+  Writes the new files by building the new contents of the whole firmware volume and
+  committing the blocks that change.
+
+  With Compact set, the live files are compacted and the new files appended after
+  them. Otherwise the new files are appended to the free space and the replaced files
+  deleted in the new contents, which lets the reliable write policy commit a multiple
+  file write at once through the journal.
+
+  @param  Device          The firmware volume.
+  @param  NumberOfFiles   The number of files.
+  @param  WritePolicy     The write policy.
+  @param  FileData        The files.
+  @param  Replaced        The files of the index that the new files replace.
+  @param  Compact         Whether the live files are compacted.
+
+  @retval EFI_SUCCESS             The files were written.
+  @retval EFI_OUT_OF_RESOURCES    The firmware volume cannot hold the files, the spare
+                                  blocks cannot hold the changed blocks, or memory
+                                  could not be allocated.
+  @retval EFI_DEVICE_ERROR        The firmware volume could not be written.
+
+**/
+EFI_STATUS
+InternalFvRebuild (
+  IN OUT FRAMEWORK_FV_DEVICE                     *Device,
+  IN     UINT32                                  NumberOfFiles,
+  IN     FRAMEWORK_EFI_FV_WRITE_POLICY           WritePolicy,
+  IN     CONST FRAMEWORK_EFI_FV_WRITE_FILE_DATA  *FileData,
+  IN     CONST BOOLEAN                           *Replaced,
+  IN     BOOLEAN                                 Compact
+  )
+{
+  EFI_STATUS           Status;
+  FRAMEWORK_FV_STAGE   Stage;
+  EFI_FFS_FILE_HEADER  *FileHeader;
+  UINTN                Index;
+
+  Stage.Buffer = AllocatePool ((UINTN) Device->FvLength);
+  if (Stage.Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Stage.Start = 0;
+  Stage.End   = Device->FvLength;
+
+  Status = EFI_SUCCESS;
+  if (Compact) {
+    CopyMem (Stage.Buffer, Device->FvHeader, Device->FirstFileOffset);
+    SetMem (Stage.Buffer + Device->FirstFileOffset, (UINTN) Device->FvLength - Device->FirstFileOffset, Device->ErasePolarity);
+    Stage.Offset = Device->FirstFileOffset;
+    for (Index = 0; Index < Device->FileCount && !EFI_ERROR (Status); Index++) {
+      if (!Device->Files[Index].Superseded && !Replaced[Index]) {
+        Status = InternalFvStageLiveFile (Device, &Stage, &Device->Files[Index]);
+      }
+    }
+  } else {
+    CopyMem (Stage.Buffer, Device->FvHeader, (UINTN) Device->FvLength);
+    Stage.Offset = Device->FreeOffset;
+    for (Index = 0; Index < Device->FileCount; Index++) {
+      if (Replaced[Index]) {
+        FileHeader = (EFI_FFS_FILE_HEADER *) (Stage.Buffer + ((UINT8 *) Device->Files[Index].FileHeader - (UINT8 *) Device->FvHeader));
+        FileHeader->State = InternalFvAddState (Device, FileHeader->State, EFI_FILE_DELETED);
+      }
+    }
+  }
+
+  for (Index = 0; Index < NumberOfFiles && !EFI_ERROR (Status); Index++) {
+    Status = InternalFvStageNewFile (
+               Device,
+               &Stage,
+               &FileData[Index],
+               EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID,
+               NULL
+               );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    if (Compact) {
+      Device->Statistics.Reclaims++;
+    }
+    Status = InternalFvCommitImage (Device, Stage.Buffer, WritePolicy);
+  }
+
+  FreePool (Stage.Buffer);
+  return Status;
+}
+
+/**
+  Writes files to the firmware volume through its firmware volume block protocol.
+
+  See FRAMEWORK_EFI_FV_WRITE_FILE for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvWriteFile (
+  IN EFI_FIRMWARE_VOLUME_PROTOCOL      *This,
+  IN UINT32                            NumberOfFiles,
+  IN FRAMEWORK_EFI_FV_WRITE_POLICY     WritePolicy,
+  IN FRAMEWORK_EFI_FV_WRITE_FILE_DATA  *FileData
+  )
+{
+  EFI_STATUS           Status;
+  FRAMEWORK_FV_DEVICE  *Device;
+  BOOLEAN              *Replaced;
+  UINTN                Length;
+
+  Device = FRAMEWORK_FV_DEVICE_FROM_THIS (This);
+
+  if (Device->Fvb == NULL) {
+    return EFI_WRITE_PROTECTED;
+  }
+  if (WritePolicy != FRAMEWORK_EFI_FV_UNRELIABLE_WRITE &&
+      (WritePolicy != FRAMEWORK_EFI_FV_RELIABLE_WRITE || Device->SpareFvb == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (NumberOfFiles == 0) {
+    return EFI_SUCCESS;
+  }
+  if (FileData == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = InternalFvCheckFileData (Device, NumberOfFiles, FileData);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (EFI_ERROR (InternalFvBuildIndex (Device))) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Replaced = AllocateZeroPool (MAX (Device->FileCount, 1) * sizeof (BOOLEAN));
+  if (Replaced == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (FileData[0].BufferSize == 0) {
+    if (InternalFvFindReplaced (Device, NumberOfFiles, FileData, Replaced) == 0) {
+      FreePool (Replaced);
+      return EFI_NOT_FOUND;
+    }
+    Status = InternalFvSetReplacedState (Device, Replaced, EFI_FILE_DELETED);
+  } else {
+    InternalFvFindReplaced (Device, NumberOfFiles, FileData, Replaced);
+    Length = InternalFvPlaceInFreeSpace (Device, NumberOfFiles, FileData);
+    if (Length == 0) {
+      Status = InternalFvRebuild (Device, NumberOfFiles, WritePolicy, FileData, Replaced, TRUE);
+    } else if (WritePolicy == FRAMEWORK_EFI_FV_RELIABLE_WRITE && NumberOfFiles > 1) {
+      //
+      // The state of each file only makes the write of that file atomic.
+      //
+      Status = InternalFvRebuild (Device, NumberOfFiles, WritePolicy, FileData, Replaced, FALSE);
+    } else {
+      Status = InternalFvAppendFiles (Device, NumberOfFiles, WritePolicy, FileData, Replaced, Length);
+    }
+  }
+
+  //
+  // The volume may have changed even if the write failed.
+  //
+  FreePool (Replaced);
+  InternalFvFreeIndex (Device);
+  return Status;
+}
+
+/**
+  Completes a reclaim of a firmware volume that was interrupted after its journal
+  became valid.
+
+  @param  Fvb         The firmware volume block protocol of the firmware volume.
+  @param  SpareFvb    The firmware volume block protocol of the spare blocks.
+  @param  SpareLba    The first spare block.
+
+  @retval EFI_SUCCESS             No reclaim was interrupted, or it was completed.
+  @retval EFI_INVALID_PARAMETER   Fvb or SpareFvb is NULL.
+  @retval EFI_VOLUME_CORRUPTED    The journal is not valid, or one of its entries is
+                                  not a block of the firmware volume. Nothing was
+                                  written.
+  @retval EFI_DEVICE_ERROR        The firmware volume or the spare blocks could not be
+                                  read or written.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvRecoverWrite (
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *SpareFvb,
+  IN EFI_LBA                                       SpareLba
+  )
+{
+  EFI_STATUS                   Status;
+  FRAMEWORK_FV_JOURNAL_HEADER  Journal;
+  FRAMEWORK_FV_JOURNAL_ENTRY   *Entries;
+  UINT8                        *Buffer;
+  UINTN                        SpareBlockLength;
+  UINTN                        BlockLength;
+  UINTN                        NumberOfBlocks;
+  UINTN                        Index;
+  UINT8                        Value;
+
+  if (Fvb == NULL || SpareFvb == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = InternalFvbRead (SpareFvb, SpareLba, 0, &Journal, sizeof (Journal));
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (Journal.Signature != FRAMEWORK_FV_JOURNAL_SIGNATURE ||
+      Journal.SpareValid == Journal.ErasePolarity ||
+      Journal.Complete != Journal.ErasePolarity) {
+    return EFI_SUCCESS;
+  }
+  if (Journal.ErasePolarity != 0 && Journal.ErasePolarity != 0xFF) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Status = SpareFvb->GetBlockSize (SpareFvb, SpareLba, &SpareBlockLength, &NumberOfBlocks);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+  if (Journal.BlockCount > (SpareBlockLength - sizeof (Journal)) / sizeof (FRAMEWORK_FV_JOURNAL_ENTRY)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  DEBUG ((DEBUG_INFO, "FrameworkFv: completing an interrupted write of 0x%x blocks\n", Journal.BlockCount));
+
+  Entries = AllocatePool (Journal.BlockCount * sizeof (FRAMEWORK_FV_JOURNAL_ENTRY));
+  Buffer  = AllocatePool (SpareBlockLength);
+  if (Entries == NULL || Buffer == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Status = InternalFvbRead (SpareFvb, SpareLba, sizeof (Journal), Entries, Journal.BlockCount * sizeof (FRAMEWORK_FV_JOURNAL_ENTRY));
+
+  //
+  // A torn or corrupted journal must not drive erases or writes, so every entry is
+  // checked against the block map of the volume before any block is replayed. The
+  // journal lists each changed block once, in increasing order.
+  //
+  for (Index = 0; Index < Journal.BlockCount && !EFI_ERROR (Status); Index++) {
+    if (Index > 0 && Entries[Index].Lba <= Entries[Index - 1].Lba) {
+      Status = EFI_VOLUME_CORRUPTED;
+      break;
+    }
+    if (EFI_ERROR (Fvb->GetBlockSize (Fvb, Entries[Index].Lba, &BlockLength, &NumberOfBlocks)) ||
+        Entries[Index].Length != BlockLength ||
+        Entries[Index].Length > SpareBlockLength) {
+      Status = EFI_VOLUME_CORRUPTED;
+    }
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "FrameworkFv: the journal of an interrupted write is not valid - %r\n", Status));
+    goto Done;
+  }
+
+  for (Index = 0; Index < Journal.BlockCount && !EFI_ERROR (Status); Index++) {
+    Status = InternalFvbRead (SpareFvb, SpareLba + 1 + Index, 0, Buffer, Entries[Index].Length);
+    if (!EFI_ERROR (Status)) {
+      Status = InternalFvbErase (NULL, Fvb, Entries[Index].Lba, 1);
+    }
+    if (!EFI_ERROR (Status)) {
+      Status = InternalFvbWrite (
+                 NULL,
+                 Fvb,
+                 Entries[Index].Lba,
+                 0,
+                 Buffer,
+                 InternalFvUsedLength (Buffer, Entries[Index].Length, Journal.ErasePolarity)
+                 );
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Value  = (UINT8) ~Journal.ErasePolarity;
+    Status = InternalFvbWrite (NULL, SpareFvb, SpareLba, OFFSET_OF (FRAMEWORK_FV_JOURNAL_HEADER, Complete), &Value, sizeof (Value));
+  }
+
+Done:
+  if (Entries != NULL) {
+    FreePool (Entries);
+  }
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+  return Status;
+}
+
+/**
+  Enables WriteFile() on a Firmware Volume Protocol instance created by FrameworkFvCreate().
+
+  @param  FirmwareVolume  The protocol instance.
+  @param  Fvb             The firmware volume block protocol of the firmware volume.
+  @param  SpareFvb        The firmware volume block protocol of the spare blocks, or
+                          NULL to support only the unreliable write policy.
+  @param  SpareLba        The first spare block.
+  @param  SpareBlocks     The number of spare blocks.
+
+  @retval EFI_SUCCESS             Writes are enabled.
+  @retval EFI_INVALID_PARAMETER   FirmwareVolume was not created by this library, Fvb is
+                                  NULL or does not map the firmware volume, or the spare
+                                  blocks are not valid.
+  @retval EFI_VOLUME_CORRUPTED    The block map of the firmware volume is not valid, or
+                                  the journal of an interrupted reclaim is not valid.
+  @retval EFI_DEVICE_ERROR        An interrupted reclaim could not be completed.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+FrameworkFvEnableWrite (
+  IN EFI_FIRMWARE_VOLUME_PROTOCOL                  *FirmwareVolume,
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *SpareFvb     OPTIONAL,
+  IN EFI_LBA                                       SpareLba,
+  IN UINTN                                         SpareBlocks
+  )
+{
+  EFI_STATUS              Status;
+  FRAMEWORK_FV_DEVICE     *Device;
+  EFI_FV_BLOCK_MAP_ENTRY  *Entry;
+  EFI_PHYSICAL_ADDRESS    Address;
+  UINTN                   MapCount;
+  UINTN                   BlockCount;
+  UINTN                   MaxBlockLength;
+  UINTN                   SpareBlockLength;
+  UINTN                   BlockLength;
+  UINTN                   NumberOfBlocks;
+  UINTN                   Index;
+  UINT64                  Length;
+
+  if (FirmwareVolume == NULL || Fvb == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = BASE_CR (FirmwareVolume, FRAMEWORK_FV_DEVICE, FirmwareVolume);
+  if (Device->Signature != FV_DEVICE_SIGNATURE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = Fvb->GetPhysicalAddress (Fvb, &Address);
+  if (EFI_ERROR (Status) || Address != (EFI_PHYSICAL_ADDRESS) (UINTN) Device->FvHeader) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The block map must describe the whole volume.
+  //
+  MapCount       = 0;
+  BlockCount     = 0;
+  MaxBlockLength = 0;
+  Length         = 0;
+  for (Entry = Device->FvHeader->BlockMap; ; Entry++) {
+    if ((UINT8 *) (Entry + 1) > (UINT8 *) Device->FvHeader + Device->FvHeader->HeaderLength) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+    if (Entry->NumBlocks == 0 || Entry->Length == 0) {
+      break;
+    }
+    MapCount++;
+    BlockCount    += Entry->NumBlocks;
+    MaxBlockLength = MAX (MaxBlockLength, Entry->Length);
+    Length        += MultU64x32 (Entry->Length, Entry->NumBlocks);
+  }
+  if (MapCount == 0 || Length != Device->FvLength) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  SpareBlockLength = 0;
+  if (SpareFvb != NULL) {
+    if (SpareBlocks < 2) {
+      return EFI_INVALID_PARAMETER;
+    }
+    for (Index = 0; Index < SpareBlocks; Index += NumberOfBlocks) {
+      Status = SpareFvb->GetBlockSize (SpareFvb, SpareLba + Index, &BlockLength, &NumberOfBlocks);
+      if (EFI_ERROR (Status) || BlockLength < MaxBlockLength || NumberOfBlocks == 0) {
+        return EFI_INVALID_PARAMETER;
+      }
+      if (Index == 0) {
+        SpareBlockLength = BlockLength;
+      }
+    }
+    if (SpareBlockLength < sizeof (FRAMEWORK_FV_JOURNAL_HEADER) + sizeof (FRAMEWORK_FV_JOURNAL_ENTRY)) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Status = FrameworkFvRecoverWrite (Fvb, SpareFvb, SpareLba);
+    if (EFI_ERROR (Status)) {
+      return (Status == EFI_OUT_OF_RESOURCES || Status == EFI_VOLUME_CORRUPTED) ? Status : EFI_DEVICE_ERROR;
+    }
+    InternalFvFreeIndex (Device);
+  }
+
+  if (Device->BlockMap != NULL) {
+    FreePool (Device->BlockMap);
+  }
+  Device->BlockMap = AllocateCopyPool (MapCount * sizeof (EFI_FV_BLOCK_MAP_ENTRY), Device->FvHeader->BlockMap);
+  if (Device->BlockMap == NULL) {
+    Device->Fvb = NULL;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Device->BlockMapCount    = MapCount;
+  Device->BlockCount       = BlockCount;
+  Device->MaxBlockLength   = MaxBlockLength;
+  Device->Fvb              = Fvb;
+  Device->SpareFvb         = SpareFvb;
+  Device->SpareLba         = SpareLba;
+  Device->SpareBlocks      = (SpareFvb != NULL) ? SpareBlocks : 0;
+  Device->SpareBlockLength = SpareBlockLength;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,470 @@
+/** @file
+  Firmware volume block cache library.
+
+  Filters a Framework Firmware Volume Block Protocol instance and serves reads from
+  whole blocks cached in memory.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FvbCacheInternal.h"
+
+/**
+  Creates a caching Firmware Volume Block Protocol instance over another instance.
+
+  The caller installs the returned protocol in place of the filtered one. All the
+  writes to the flash device must go through the returned protocol, or be followed
+  by FvbCacheInvalidate().
+
+  @param  Fvb               The instance to filter.
+  @param  CacheBlocks       The number of blocks the cache holds. It must not be 0.
+  @param  ReadAheadBlocks   The number of blocks read ahead when blocks are read in
+                            sequence, or 0 to disable read-ahead. It must be smaller
+                            than CacheBlocks.
+  @param  CachedFvb         Returns the caching instance.
+
+  @retval EFI_SUCCESS             The caching instance was created.
+  @retval EFI_INVALID_PARAMETER   Fvb or CachedFvb is NULL, CacheBlocks is 0, or
+                                  ReadAheadBlocks is not smaller than CacheBlocks.
+  @retval EFI_DEVICE_ERROR        The block map of Fvb could not be read.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheCreate (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb,
+  IN  UINTN                                         CacheBlocks,
+  IN  UINTN                                         ReadAheadBlocks,
+  OUT FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  **CachedFvb
+  )
+{
+  EFI_STATUS        Status;
+  FVB_CACHE_DEVICE  *Device;
+  UINT8             *Data;
+  EFI_LBA           BlockCount;
+  UINTN             BlockSize;
+  UINTN             NumberOfBlocks;
+  UINTN             MaxBlockSize;
+  UINTN             Index;
+
+  if (Fvb == NULL || CachedFvb == NULL || CacheBlocks == 0 || ReadAheadBlocks >= CacheBlocks) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Walk the block map to learn the number of blocks and the largest block.
+  //
+  BlockCount   = 0;
+  MaxBlockSize = 0;
+  for (;;) {
+    Status = Fvb->GetBlockSize (Fvb, BlockCount, &BlockSize, &NumberOfBlocks);
+    if (EFI_ERROR (Status) || NumberOfBlocks == 0) {
+      break;
+    }
+    MaxBlockSize = MAX (MaxBlockSize, BlockSize);
+    BlockCount  += NumberOfBlocks;
+  }
+  if (BlockCount == 0 || MaxBlockSize == 0) {
+    return EFI_DEVICE_ERROR;
+  }
+  if (CacheBlocks > MAX_ADDRESS / MaxBlockSize) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Device = AllocateZeroPool (sizeof (FVB_CACHE_DEVICE));
+  if (Device == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Device->Blocks = AllocateZeroPool (CacheBlocks * sizeof (FVB_CACHE_BLOCK));
+  Data           = AllocatePool (CacheBlocks * MaxBlockSize);
+  if (Device->Blocks == NULL || Data == NULL) {
+    if (Device->Blocks != NULL) {
+      FreePool (Device->Blocks);
+    }
+    if (Data != NULL) {
+      FreePool (Data);
+    }
+    FreePool (Device);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  InitializeListHead (&Device->LruList);
+  for (Index = 0; Index < CacheBlocks; Index++) {
+    Device->Blocks[Index].Data = Data + Index * MaxBlockSize;
+    InsertTailList (&Device->LruList, &Device->Blocks[Index].Link);
+  }
+
+  Device->Signature              = FVB_CACHE_SIGNATURE;
+  Device->Lower                  = Fvb;
+  Device->ReadAheadBlocks        = ReadAheadBlocks;
+  Device->BlockCount             = BlockCount;
+  Device->CacheBlocks            = CacheBlocks;
+  Device->Fvb.GetAttributes      = FvbCacheGetAttributes;
+  Device->Fvb.SetAttributes      = FvbCacheSetAttributes;
+  Device->Fvb.GetPhysicalAddress = FvbCacheGetPhysicalAddress;
+  Device->Fvb.GetBlockSize       = FvbCacheGetBlockSize;
+  Device->Fvb.Read               = FvbCacheRead;
+  Device->Fvb.Write              = FvbCacheWrite;
+  Device->Fvb.EraseBlocks        = FvbCacheEraseBlocks;
+  Device->Fvb.ParentHandle       = Fvb->ParentHandle;
+
+  *CachedFvb = &Device->Fvb;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees a caching Firmware Volume Block Protocol instance created by FvbCacheCreate().
+
+  The caller must uninstall the protocol first.
+
+  @param  CachedFvb   The caching instance.
+
+**/
+VOID
+EFIAPI
+FvbCacheDestroy (
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *CachedFvb
+  )
+{
+  FVB_CACHE_DEVICE  *Device;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (CachedFvb);
+
+  FreePool (Device->Blocks[0].Data);
+  FreePool (Device->Blocks);
+  Device->Signature = 0;
+  FreePool (Device);
+}
+
+/**
+  Invalidates all the blocks of a caching instance, after the flash device was
+  changed without going through it.
+
+  @param  CachedFvb   The caching instance.
+
+**/
+VOID
+EFIAPI
+FvbCacheInvalidate (
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *CachedFvb
+  )
+{
+  FVB_CACHE_DEVICE  *Device;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (CachedFvb);
+  InternalFvbCacheInvalidateRange (Device, 0, Device->BlockCount);
+  Device->LastLbaValid = FALSE;
+}
+
+/**
+  Returns the counters of a caching instance created by FvbCacheCreate().
+
+  @param  CachedFvb     The caching instance.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   CachedFvb was not created by this library, or
+                                  Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheGetStatistics (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *CachedFvb,
+  OUT FVB_CACHE_STATISTICS                          *Statistics
+  )
+{
+  FVB_CACHE_DEVICE  *Device;
+
+  if (CachedFvb == NULL || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = BASE_CR (CachedFvb, FVB_CACHE_DEVICE, Fvb);
+  if (Device->Signature != FVB_CACHE_SIGNATURE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Statistics, &Device->Statistics, sizeof (FVB_CACHE_STATISTICS));
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the attributes of the filtered instance.
+
+  @param  This          Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL instance.
+  @param  Attributes    Returns the attributes.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheGetAttributes (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  OUT EFI_FVB_ATTRIBUTES                            *Attributes
+  )
+{
+  FVB_CACHE_DEVICE  *Device;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (This);
+  return Device->Lower->GetAttributes (Device->Lower, Attributes);
+}
+
+/**
+  Sets the attributes of the filtered instance.
+
+  The cache is invalidated, since the attributes may disable reads or change what
+  the device returns.
+
+  @param  This          Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL instance.
+  @param  Attributes    On input the requested attributes, on output the new attributes.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheSetAttributes (
+  IN     FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN OUT EFI_FVB_ATTRIBUTES                            *Attributes
+  )
+{
+  FVB_CACHE_DEVICE  *Device;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (This);
+  FvbCacheInvalidate (This);
+  return Device->Lower->SetAttributes (Device->Lower, Attributes);
+}
+
+/**
+  Returns the physical address of the filtered instance.
+
+  @param  This      Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL instance.
+  @param  Address   Returns the base address of the firmware volume.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheGetPhysicalAddress (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  OUT EFI_PHYSICAL_ADDRESS                          *Address
+  )
+{
+  FVB_CACHE_DEVICE  *Device;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (This);
+  return Device->Lower->GetPhysicalAddress (Device->Lower, Address);
+}
+
+/**
+  Returns the size of a block of the filtered instance.
+
+  @param  This            Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL instance.
+  @param  Lba             The block.
+  @param  BlockSize       Returns the size of the block.
+  @param  NumberOfBlocks  Returns the number of consecutive blocks of the same size.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheGetBlockSize (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN  EFI_LBA                                       Lba,
+  OUT UINTN                                         *BlockSize,
+  OUT UINTN                                         *NumberOfBlocks
+  )
+{
+  FVB_CACHE_DEVICE  *Device;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (This);
+  return Device->Lower->GetBlockSize (Device->Lower, Lba, BlockSize, NumberOfBlocks);
+}
+
+/**
+  Reads the specified number of bytes into a buffer from the specified block.
+
+  The block is read whole into the cache on a miss. If the previous read was from
+  the preceding block, the blocks that follow are read ahead as well.
+
+  @param  This        Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL instance.
+  @param  Lba         The block from which to read.
+  @param  Offset      Offset into the block at which to begin reading.
+  @param  NumBytes    At entry the size of the buffer, at exit the number of bytes read.
+  @param  Buffer      Receives the data.
+
+  @retval EFI_SUCCESS           The firmware volume was read successfully and contents
+                                are in Buffer.
+  @retval EFI_BAD_BUFFER_SIZE   The read attempted to cross a block boundary. NumBytes
+                                contains the number of bytes returned in Buffer.
+  @retval Others                The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheRead (
+  IN     FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN     EFI_LBA                                       Lba,
+  IN     UINTN                                         Offset,
+  IN OUT UINTN                                         *NumBytes,
+  OUT    UINT8                                         *Buffer
+  )
+{
+  EFI_STATUS        Status;
+  FVB_CACHE_DEVICE  *Device;
+  FVB_CACHE_BLOCK   *Block;
+  FVB_CACHE_BLOCK   *Next;
+  UINTN             Index;
+  UINTN             Available;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (This);
+  Device->Statistics.Reads++;
+
+  Block = InternalFvbCacheFind (Device, Lba);
+  if (Block != NULL) {
+    Device->Statistics.Hits++;
+    if (Block->ReadAhead) {
+      Device->Statistics.ReadAheadHits++;
+      Block->ReadAhead = FALSE;
+    }
+    RemoveEntryList (&Block->Link);
+    InsertHeadList (&Device->LruList, &Block->Link);
+  } else {
+    Device->Statistics.Misses++;
+    Status = InternalFvbCacheFetch (Device, Lba, FALSE, &Block);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (Device->LastLbaValid && Lba == Device->LastLba + 1) {
+      for (Index = 1; Index <= Device->ReadAheadBlocks && Lba + Index < Device->BlockCount; Index++) {
+        if (InternalFvbCacheFind (Device, Lba + Index) == NULL &&
+            EFI_ERROR (InternalFvbCacheFetch (Device, Lba + Index, TRUE, &Next))) {
+          break;
+        }
+      }
+    }
+  }
+
+  Device->LastLba      = Lba;
+  Device->LastLbaValid = TRUE;
+
+  Status    = EFI_SUCCESS;
+  Available = (Offset < Block->Length) ? Block->Length - Offset : 0;
+  if (*NumBytes > Available) {
+    *NumBytes = Available;
+    Status    = EFI_BAD_BUFFER_SIZE;
+  }
+
+  CopyMem (Buffer, Block->Data + Offset, *NumBytes);
+  Device->Statistics.BytesRead += *NumBytes;
+  return Status;
+}
+
+/**
+  Writes the specified number of bytes from the input buffer to the block.
+
+  The block is invalidated and the write is passed to the filtered instance.
+
+  @param  This        Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL instance.
+  @param  Lba         The block to write to.
+  @param  Offset      Offset into the block at which to begin writing.
+  @param  NumBytes    At entry the size of the buffer, at exit the number of bytes written.
+  @param  Buffer      The data to write.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheWrite (
+  IN     FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN     EFI_LBA                                       Lba,
+  IN     UINTN                                         Offset,
+  IN OUT UINTN                                         *NumBytes,
+  IN     UINT8                                         *Buffer
+  )
+{
+  FVB_CACHE_DEVICE  *Device;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (This);
+  InternalFvbCacheInvalidateRange (Device, Lba, 1);
+  return Device->Lower->Write (Device->Lower, Lba, Offset, NumBytes, Buffer);
+}
+
+/**
+  Erases and initializes a firmware volume block.
+
+  The whole list of blocks is verified before any block is erased. The blocks are
+  then invalidated and each range of the list is passed to the filtered instance.
+
+  @param  This    Indicates the FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL instance.
+  @param  ...     Pairs of the first block of a range and the number of blocks to
+                  erase, terminated by FRAMEWORK_EFI_LBA_LIST_TERMINATOR.
+
+  @retval EFI_SUCCESS             The blocks were erased.
+  @retval EFI_INVALID_PARAMETER   A range of blocks does not exist in the firmware volume.
+  @retval Others                  The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheEraseBlocks (
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  ...
+  )
+{
+  EFI_STATUS        Status;
+  FVB_CACHE_DEVICE  *Device;
+  VA_LIST           Args;
+  EFI_LBA           Lba;
+  UINTN             Count;
+
+  Device = FVB_CACHE_DEVICE_FROM_THIS (This);
+
+  VA_START (Args, This);
+  for (;;) {
+    Lba = VA_ARG (Args, EFI_LBA);
+    if (Lba == FRAMEWORK_EFI_LBA_LIST_TERMINATOR) {
+      break;
+    }
+    Count = VA_ARG (Args, UINTN);
+    if (Count == 0 || Lba >= Device->BlockCount || Count > Device->BlockCount - Lba) {
+      VA_END (Args);
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+  VA_END (Args);
+
+  Status = EFI_SUCCESS;
+  VA_START (Args, This);
+  for (;;) {
+    Lba = VA_ARG (Args, EFI_LBA);
+    if (Lba == FRAMEWORK_EFI_LBA_LIST_TERMINATOR) {
+      break;
+    }
+    Count = VA_ARG (Args, UINTN);
+    InternalFvbCacheInvalidateRange (Device, Lba, Count);
+    Status = Device->Lower->EraseBlocks (Device->Lower, Lba, Count, FRAMEWORK_EFI_LBA_LIST_TERMINATOR);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+  VA_END (Args);
+
+  Device->LastLbaValid = FALSE;
+  return Status;
+}
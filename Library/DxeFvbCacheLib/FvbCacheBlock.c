@@ -0,0 +1,143 @@
+/** @file
+  Block cache of the firmware volume block cache library.
+
+  The blocks are kept in a list ordered from the most to the least recently used.
+  A block is fetched into the least recently used entry, which is moved to the front.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FvbCacheInternal.h"
+
+/**
+  Finds a valid cached block.
+
+  @param  Device    The cache.
+  @param  Lba       The block.
+
+  @return The cached block, or NULL if the block is not cached.
+
+**/
+FVB_CACHE_BLOCK *
+InternalFvbCacheFind (
+  IN FVB_CACHE_DEVICE  *Device,
+  IN EFI_LBA           Lba
+  )
+{
+  LIST_ENTRY       *Link;
+  FVB_CACHE_BLOCK  *Block;
+
+  for (Link = GetFirstNode (&Device->LruList); !IsNull (&Device->LruList, Link); Link = GetNextNode (&Device->LruList, Link)) {
+    Block = BASE_CR (Link, FVB_CACHE_BLOCK, Link);
+    if (!Block->Valid) {
+      //
+      // Invalid blocks are moved to the end of the list.
+      //
+      break;
+    }
+    if (Block->Lba == Lba) {
+      return Block;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Reads a block into the cache, replacing the least recently used block.
+
+  @param  Device      The cache.
+  @param  Lba         The block.
+  @param  ReadAhead   The block is read ahead of a request.
+  @param  Block       Returns the cached block.
+
+  @retval EFI_SUCCESS   The block is cached.
+  @retval Others        The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+InternalFvbCacheFetch (
+  IN OUT FVB_CACHE_DEVICE  *Device,
+  IN     EFI_LBA           Lba,
+  IN     BOOLEAN           ReadAhead,
+  OUT    FVB_CACHE_BLOCK   **Block
+  )
+{
+  EFI_STATUS       Status;
+  FVB_CACHE_BLOCK  *Entry;
+  UINTN            Length;
+  UINTN            NumberOfBlocks;
+  UINTN            NumBytes;
+
+  Status = Device->Lower->GetBlockSize (Device->Lower, Lba, &Length, &NumberOfBlocks);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Entry = BASE_CR (Device->LruList.BackLink, FVB_CACHE_BLOCK, Link);
+  if (Entry->Valid) {
+    Device->Statistics.Evictions++;
+    Entry->Valid = FALSE;
+  }
+
+  NumBytes = Length;
+  Status   = Device->Lower->Read (Device->Lower, Lba, 0, &NumBytes, Entry->Data);
+  Device->Statistics.DeviceReads++;
+  Device->Statistics.DeviceBytes += NumBytes;
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (NumBytes != Length) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Entry->Lba       = Lba;
+  Entry->Length    = Length;
+  Entry->Valid     = TRUE;
+  Entry->ReadAhead = ReadAhead;
+  RemoveEntryList (&Entry->Link);
+  InsertHeadList (&Device->LruList, &Entry->Link);
+  if (ReadAhead) {
+    Device->Statistics.ReadAheads++;
+  }
+
+  *Block = Entry;
+  return EFI_SUCCESS;
+}
+
+/**
+  Invalidates the cached blocks in a range.
+
+  @param  Device    The cache.
+  @param  Lba       The first block.
+  @param  Count     The number of blocks.
+
+**/
+VOID
+InternalFvbCacheInvalidateRange (
+  IN OUT FVB_CACHE_DEVICE  *Device,
+  IN     EFI_LBA           Lba,
+  IN     UINT64            Count
+  )
+{
+  FVB_CACHE_BLOCK  *Block;
+  UINTN            Index;
+
+  for (Index = 0; Index < Device->CacheBlocks; Index++) {
+    Block = &Device->Blocks[Index];
+    if (Block->Valid && Block->Lba >= Lba && Block->Lba - Lba < Count) {
+      Block->Valid = FALSE;
+      RemoveEntryList (&Block->Link);
+      InsertTailList (&Device->LruList, &Block->Link);
+      Device->Statistics.Invalidations++;
+    }
+  }
+}
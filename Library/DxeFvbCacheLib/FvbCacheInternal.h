@@ -0,0 +1,211 @@
+/** @file
+  Internal definitions of the firmware volume block cache library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _FVB_CACHE_INTERNAL_H_
+#define _FVB_CACHE_INTERNAL_H_
+
+#include <FrameworkDxe.h>
+
+#include <Protocol/FrameworkFirmwareVolumeBlock.h>
+
+#include <Library/FvbCacheLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define FVB_CACHE_SIGNATURE   SIGNATURE_32 ('F', 'V', 'B', 'C')
+
+///
+/// A cached block. The cache holds few blocks, so it is searched linearly in LRU order.
+///
+typedef struct {
+  LIST_ENTRY  Link;         ///< Link in the LRU list, most recently used first.
+  EFI_LBA     Lba;
+  UINTN       Length;       ///< Length of the block.
+  BOOLEAN     Valid;
+  BOOLEAN     ReadAhead;    ///< Fetched by read-ahead and not read since.
+  UINT8       *Data;
+} FVB_CACHE_BLOCK;
+
+typedef struct {
+  UINT32                                        Signature;        ///< FVB_CACHE_SIGNATURE.
+  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  Fvb;
+  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Lower;            ///< The filtered instance.
+  UINTN                                         ReadAheadBlocks;
+  EFI_LBA                                       BlockCount;       ///< Number of blocks of the device.
+  FVB_CACHE_BLOCK                               *Blocks;
+  UINTN                                         CacheBlocks;
+  LIST_ENTRY                                    LruList;
+  ///
+  /// The block of the last Read(), which detects reads in sequence.
+  ///
+  EFI_LBA                                       LastLba;
+  BOOLEAN                                       LastLbaValid;
+  FVB_CACHE_STATISTICS                          Statistics;
+} FVB_CACHE_DEVICE;
+
+#define FVB_CACHE_DEVICE_FROM_THIS(a) \
+  CR (a, FVB_CACHE_DEVICE, Fvb, FVB_CACHE_SIGNATURE)
+
+/**
+  Finds a valid cached block.
+
+  @param  Device    The cache.
+  @param  Lba       The block.
+
+  @return The cached block, or NULL if the block is not cached.
+
+**/
+FVB_CACHE_BLOCK *
+InternalFvbCacheFind (
+  IN FVB_CACHE_DEVICE  *Device,
+  IN EFI_LBA           Lba
+  );
+
+/**
+  Reads a block into the cache, replacing the least recently used block.
+
+  @param  Device      The cache.
+  @param  Lba         The block.
+  @param  ReadAhead   The block is read ahead of a request.
+  @param  Block       Returns the cached block.
+
+  @retval EFI_SUCCESS   The block is cached.
+  @retval Others        The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+InternalFvbCacheFetch (
+  IN OUT FVB_CACHE_DEVICE  *Device,
+  IN     EFI_LBA           Lba,
+  IN     BOOLEAN           ReadAhead,
+  OUT    FVB_CACHE_BLOCK   **Block
+  );
+
+/**
+  Invalidates the cached blocks in a range.
+
+  @param  Device    The cache.
+  @param  Lba       The first block.
+  @param  Count     The number of blocks.
+
+**/
+VOID
+InternalFvbCacheInvalidateRange (
+  IN OUT FVB_CACHE_DEVICE  *Device,
+  IN     EFI_LBA           Lba,
+  IN     UINT64            Count
+  );
+
+/**
+  Returns the attributes of the filtered instance.
+
+  See FRAMEWORK_EFI_FVB_GET_ATTRIBUTES for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheGetAttributes (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  OUT EFI_FVB_ATTRIBUTES                            *Attributes
+  );
+
+/**
+  Sets the attributes of the filtered instance, and invalidates the cache.
+
+  See FRAMEWORK_EFI_FVB_SET_ATTRIBUTES for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheSetAttributes (
+  IN     FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN OUT EFI_FVB_ATTRIBUTES                            *Attributes
+  );
+
+/**
+  Returns the physical address of the filtered instance.
+
+  See FRAMEWORK_EFI_FVB_GET_PHYSICAL_ADDRESS for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheGetPhysicalAddress (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  OUT EFI_PHYSICAL_ADDRESS                          *Address
+  );
+
+/**
+  Returns the block size of the filtered instance.
+
+  See FRAMEWORK_EFI_FVB_GET_BLOCK_SIZE for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheGetBlockSize (
+  IN  FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN  EFI_LBA                                       Lba,
+  OUT UINTN                                         *BlockSize,
+  OUT UINTN                                         *NumberOfBlocks
+  );
+
+/**
+  Reads from a block through the cache.
+
+  See FRAMEWORK_EFI_FVB_READ for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheRead (
+  IN     FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN     EFI_LBA                                       Lba,
+  IN     UINTN                                         Offset,
+  IN OUT UINTN                                         *NumBytes,
+  OUT    UINT8                                         *Buffer
+  );
+
+/**
+  Writes to a block through the filtered instance, and invalidates the block.
+
+  See FRAMEWORK_EFI_FVB_WRITE for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheWrite (
+  IN     FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN     EFI_LBA                                       Lba,
+  IN     UINTN                                         Offset,
+  IN OUT UINTN                                         *NumBytes,
+  IN     UINT8                                         *Buffer
+  );
+
+/**
+  Erases blocks through the filtered instance, and invalidates them.
+
+  See FRAMEWORK_EFI_FVB_ERASE_BLOCKS for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+FvbCacheEraseBlocks (
+  IN FRAMEWORK_EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  ...
+  );
+
+#endif
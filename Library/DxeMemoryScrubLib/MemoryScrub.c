@@ -0,0 +1,345 @@
+/** @file
+  Runs of the memory test and scrub library.
+
+  The application processors are started once per run with StartupAllAPs() and a
+  short timeout, so that the call returns EFI_TIMEOUT while they take chunks. The
+  BSP takes chunks too, and is the only processor that reports status codes.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "MemoryScrubInternal.h"
+
+/**
+  Reports the status codes of the ranges that have been handled since the last
+  call.
+
+  @param  Context   The run.
+
+**/
+VOID
+InternalMemoryScrubReport (
+  IN OUT MEMORY_SCRUB_CONTEXT  *Context
+  )
+{
+  EFI_MEMORY_RANGE_EXTENDED_DATA  Data;
+  MEMORY_SCRUB_WORK               *Work;
+  UINTN                           Index;
+
+  for (Index = 0; Index < Context->RangeCount && Context->ReportedCount < Context->RangeCount; Index++) {
+    Work = &Context->Work[Index];
+    if (Work->Reported || Work->DoneChunks != Work->ChunkCount) {
+      continue;
+    }
+    Work->Reported = TRUE;
+    Context->ReportedCount++;
+
+    Data.Start  = Context->Ranges[Index].Base;
+    Data.Length = Context->Ranges[Index].Length;
+    REPORT_STATUS_CODE_WITH_EXTENDED_DATA (
+      EFI_PROGRESS_CODE,
+      EFI_COMPUTING_UNIT_MEMORY | EFI_CU_MEMORY_PC_TEST,
+      &Data.Start,
+      sizeof (Data) - OFFSET_OF (EFI_MEMORY_RANGE_EXTENDED_DATA, Start)
+      );
+
+    if (Work->ErrorCount != 0) {
+      DEBUG ((
+        DEBUG_ERROR,
+        "MemoryScrubLib: %d errors in %lx-%lx, at %lx\n",
+        Work->ErrorCount,
+        Data.Start,
+        Data.Start + Data.Length - 1,
+        Work->ErrorAddress
+        ));
+      Data.Start  = Work->ErrorAddress;
+      Data.Length = sizeof (UINT64);
+      REPORT_STATUS_CODE_WITH_EXTENDED_DATA (
+        EFI_ERROR_CODE | EFI_ERROR_MAJOR,
+        EFI_COMPUTING_UNIT_MEMORY | EFI_CU_MEMORY_EC_UNCORRECTABLE,
+        &Data.Start,
+        sizeof (Data) - OFFSET_OF (EFI_MEMORY_RANGE_EXTENDED_DATA, Start)
+        );
+    }
+  }
+}
+
+/**
+  Takes and handles the chunks of a group of ranges until there are none left.
+
+  @param  Context   The run.
+  @param  Group     The group.
+  @param  Bsp       The caller is the BSP, which reports the status codes.
+
+**/
+VOID
+InternalMemoryScrubGroup (
+  IN OUT MEMORY_SCRUB_CONTEXT  *Context,
+  IN     UINT32                Group,
+  IN     BOOLEAN               Bsp
+  )
+{
+  MEMORY_SCRUB_RANGE  *Range;
+  MEMORY_SCRUB_WORK   *Work;
+  UINTN               Position;
+  UINT32              Chunk;
+  UINT64              Offset;
+  UINT32              Errors;
+  UINT32              Count;
+  UINT64              ErrorAddress;
+
+  for (Position = Context->GroupStart[Group]; Position < Context->GroupStart[Group + 1]; Position++) {
+    Range = &Context->Ranges[Context->Order[Position]];
+    Work  = &Context->Work[Context->Order[Position]];
+
+    //
+    // NextChunk is read first, so that the processors that come to a range that is
+    // done do not keep incrementing it.
+    //
+    while (Work->NextChunk < Work->ChunkCount) {
+      Chunk = InterlockedIncrement (&Work->NextChunk) - 1;
+      if (Chunk >= Work->ChunkCount) {
+        break;
+      }
+
+      Offset = LShiftU64 (Chunk, MEMORY_SCRUB_CHUNK_SHIFT);
+      Errors = InternalMemoryScrubChunk (
+                 Context->Operation,
+                 Context->Pattern,
+                 (UINTN) (Range->Base + Offset),
+                 (UINTN) MIN (Range->Length - Offset, MEMORY_SCRUB_CHUNK_SIZE),
+                 &ErrorAddress
+                 );
+      if (Errors != 0) {
+        InterlockedCompareExchange64 (&Work->ErrorAddress, MAX_UINT64, ErrorAddress);
+        do {
+          Count = Work->ErrorCount;
+        } while (InterlockedCompareExchange32 (&Work->ErrorCount, Count, Count + Errors) != Count);
+      }
+      InterlockedIncrement (&Work->DoneChunks);
+
+      if (Bsp) {
+        InternalMemoryScrubReport (Context);
+      }
+    }
+  }
+}
+
+/**
+  Handles the chunks of the ranges local to the package of the caller, then those
+  of the ranges local to no package, then those of the other packages.
+
+  @param  Context   The run.
+  @param  Bsp       The caller is the BSP, which reports the status codes.
+
+**/
+VOID
+InternalMemoryScrubWorker (
+  IN OUT MEMORY_SCRUB_CONTEXT  *Context,
+  IN     BOOLEAN               Bsp
+  )
+{
+  UINT32  Home;
+  UINT32  Any;
+  UINT32  Group;
+  UINT32  Step;
+
+  Home = InternalMemoryScrubGetGroup (Context);
+  Any  = Context->GroupCount - 1;
+
+  InternalMemoryScrubGroup (Context, Home, Bsp);
+  if (Home != Any) {
+    InternalMemoryScrubGroup (Context, Any, Bsp);
+  }
+
+  //
+  // The other packages are visited starting from the next one, so that the
+  // processors of different packages do not all come to the same one.
+  //
+  for (Step = 0; Step < Any; Step++) {
+    Group = (Home == Any) ? Step : (Home + Step) % Any;
+    if (Group != Home) {
+      InternalMemoryScrubGroup (Context, Group, Bsp);
+    }
+  }
+}
+
+/**
+  Handles chunks on an application processor.
+
+  @param  Buffer    The run.
+
+**/
+VOID
+EFIAPI
+InternalMemoryScrubApProcedure (
+  IN VOID  *Buffer
+  )
+{
+  InternalMemoryScrubWorker ((MEMORY_SCRUB_CONTEXT *) Buffer, FALSE);
+}
+
+/**
+  Fills, tests or reads ranges of memory on the BSP and on the enabled application
+  processors.
+
+  The function reports EFI_CU_MEMORY_PC_TEST with the range as extended data when a
+  range has been handled, and EFI_CU_MEMORY_EC_UNCORRECTABLE with one of the words
+  that did not match when a test found some.
+
+  @param  MpServices    The MP Services Protocol, or NULL to run on the BSP only.
+  @param  Operation     The operation.
+  @param  Pattern       The pattern of MemoryScrubFill and MemoryScrubTest.
+  @param  Ranges        The ranges. Their ErrorCount and ErrorAddress are set.
+  @param  RangeCount    The number of ranges.
+
+  @retval EFI_SUCCESS             The ranges were handled, and tested good.
+  @retval EFI_DEVICE_ERROR        The ranges were handled, and some words did not
+                                  hold the value written to them.
+  @retval EFI_INVALID_PARAMETER   Operation is not valid, Ranges is NULL while
+                                  RangeCount is not 0, or a range is not aligned on
+                                  8 bytes or is beyond the addressable memory.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+  @retval EFI_ACCESS_DENIED       Operation is MemoryScrubFill or MemoryScrubTest,
+                                  and some part of a range is no longer untested
+                                  system memory in the GCD memory space map. No
+                                  memory was written.
+
+**/
+EFI_STATUS
+EFIAPI
+MemoryScrubRun (
+  IN     FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices  OPTIONAL,
+  IN     MEMORY_SCRUB_OPERATION              Operation,
+  IN     UINT64                              Pattern,
+  IN OUT MEMORY_SCRUB_RANGE                  *Ranges,
+  IN     UINTN                               RangeCount
+  )
+{
+  EFI_STATUS            Status;
+  MEMORY_SCRUB_CONTEXT  Context;
+  MEMORY_SCRUB_RANGE    *Range;
+  EFI_EVENT             ApDone;
+  BOOLEAN               Waiting;
+  UINTN                 Index;
+
+  if (Operation >= MemoryScrubOperationMaximum || (Ranges == NULL && RangeCount != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  for (Index = 0; Index < RangeCount; Index++) {
+    Range = &Ranges[Index];
+    if (((Range->Base | Range->Length) & 7) != 0) {
+      return EFI_INVALID_PARAMETER;
+    }
+    if (Range->Length != 0 &&
+        (Range->Base > MAX_ADDRESS || Range->Length - 1 > MAX_ADDRESS - Range->Base ||
+         RShiftU64 (Range->Length - 1, MEMORY_SCRUB_CHUNK_SHIFT) >= MAX_UINT32)) {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  ZeroMem (&Context, sizeof (Context));
+  Context.MpServices = MpServices;
+  Context.Operation  = Operation;
+  Context.Pattern    = Pattern;
+  Context.Ranges     = Ranges;
+  Context.RangeCount = RangeCount;
+  Context.Work       = AllocateZeroPool (MAX (RangeCount, 1) * sizeof (MEMORY_SCRUB_WORK));
+  if (Context.Work == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  for (Index = 0; Index < RangeCount; Index++) {
+    if (Ranges[Index].Length != 0) {
+      Context.Work[Index].ChunkCount = (UINT32) RShiftU64 (Ranges[Index].Length - 1, MEMORY_SCRUB_CHUNK_SHIFT) + 1;
+    }
+    Context.Work[Index].ErrorAddress = MAX_UINT64;
+  }
+
+  Status = InternalMemoryScrubPartition (&Context);
+  if (EFI_ERROR (Status)) {
+    FreePool (Context.Work);
+    return Status;
+  }
+
+  ApDone = NULL;
+  if (Context.ProcessorCount > 1) {
+    Status = gBS->CreateEvent (0, TPL_NOTIFY, NULL, NULL, &ApDone);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "MemoryScrubLib: CreateEvent() failed - %r\n", Status));
+      ApDone = NULL;
+    }
+  }
+
+  //
+  // The DXE core promotes untested memory to system memory when an allocation
+  // fails, so the ranges are checked once the allocations of the run are done,
+  // right before they are written.
+  //
+  if (Operation != MemoryScrubRead) {
+    Status = InternalMemoryScrubCheckRanges (Ranges, RangeCount);
+    if (EFI_ERROR (Status)) {
+      if (ApDone != NULL) {
+        gBS->CloseEvent (ApDone);
+      }
+      InternalMemoryScrubFreePartition (&Context);
+      FreePool (Context.Work);
+      return Status;
+    }
+  }
+
+  //
+  // EFI_TIMEOUT is the expected result: the application processors are taking
+  // chunks and signal ApDone once there are none left.
+  //
+  Waiting = FALSE;
+  if (ApDone != NULL) {
+    Status = MpServices->StartupAllAPs (
+                           MpServices,
+                           InternalMemoryScrubApProcedure,
+                           FALSE,
+                           ApDone,
+                           MEMORY_SCRUB_DISPATCH_TIMEOUT,
+                           &Context,
+                           NULL
+                           );
+    Waiting = (BOOLEAN) (Status == EFI_TIMEOUT);
+    if (EFI_ERROR (Status) && Status != EFI_TIMEOUT) {
+      DEBUG ((DEBUG_WARN, "MemoryScrubLib: StartupAllAPs() failed - %r\n", Status));
+    }
+  }
+
+  InternalMemoryScrubWorker (&Context, TRUE);
+
+  if (Waiting) {
+    while (gBS->CheckEvent (ApDone) == EFI_NOT_READY) {
+      InternalMemoryScrubReport (&Context);
+      CpuPause ();
+    }
+  }
+  if (ApDone != NULL) {
+    gBS->CloseEvent (ApDone);
+  }
+  InternalMemoryScrubReport (&Context);
+
+  Status = EFI_SUCCESS;
+  for (Index = 0; Index < RangeCount; Index++) {
+    Ranges[Index].ErrorCount   = Context.Work[Index].ErrorCount;
+    Ranges[Index].ErrorAddress = 0;
+    if (Ranges[Index].ErrorCount != 0) {
+      Ranges[Index].ErrorAddress = Context.Work[Index].ErrorAddress;
+      Status = EFI_DEVICE_ERROR;
+    }
+  }
+
+  InternalMemoryScrubFreePartition (&Context);
+  FreePool (Context.Work);
+  return Status;
+}
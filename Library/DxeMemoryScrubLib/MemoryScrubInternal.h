@@ -0,0 +1,160 @@
+/** @file
+  Internal definitions of the memory test and scrub library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _MEMORY_SCRUB_INTERNAL_H_
+#define _MEMORY_SCRUB_INTERNAL_H_
+
+#include <FrameworkDxe.h>
+
+#include <Protocol/FrameworkMpService.h>
+
+#include <Library/MemoryScrubLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/CacheMaintenanceLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DxeServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/ReportStatusCodeLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+///
+/// The ranges are handed out to the processors in chunks of 2 MB.
+///
+#define MEMORY_SCRUB_CHUNK_SHIFT  21
+#define MEMORY_SCRUB_CHUNK_SIZE   (1 << MEMORY_SCRUB_CHUNK_SHIFT)
+
+///
+/// Timeout given to StartupAllAPs(), after which the BSP takes chunks too.
+///
+#define MEMORY_SCRUB_DISPATCH_TIMEOUT  1
+
+///
+/// The state of a range during a run.
+///
+typedef struct {
+  UINT32           ChunkCount;
+  volatile UINT32  NextChunk;       ///< Chunks taken by the processors.
+  volatile UINT32  DoneChunks;      ///< Chunks handled.
+  volatile UINT32  ErrorCount;
+  volatile UINT64  ErrorAddress;
+  BOOLEAN          Reported;        ///< The status codes of the range were reported.
+} MEMORY_SCRUB_WORK;
+
+typedef struct {
+  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  MEMORY_SCRUB_OPERATION              Operation;
+  UINT64                              Pattern;
+  MEMORY_SCRUB_RANGE                  *Ranges;
+  MEMORY_SCRUB_WORK                   *Work;
+  UINTN                               RangeCount;
+  UINTN                               ReportedCount;
+  ///
+  /// The ranges are in groups, one per package of processors and one last group
+  /// for the ranges that are not local to any of them.
+  ///
+  UINT32                              GroupCount;
+  ///
+  /// The range indexes, sorted by group.
+  ///
+  UINT32                              *Order;
+  ///
+  /// The first entry of every group in Order, and RangeCount at the end.
+  ///
+  UINT32                              *GroupStart;
+  ///
+  /// The group of the package of every processor, by processor number.
+  ///
+  UINT32                              *ProcessorGroup;
+  UINTN                               ProcessorCount;
+} MEMORY_SCRUB_CONTEXT;
+
+/**
+  Checks that ranges are still untested system memory in the GCD memory space map.
+
+  @param  Ranges        The ranges.
+  @param  RangeCount    The number of ranges.
+
+  @retval EFI_SUCCESS         Every range is untested system memory.
+  @retval EFI_ACCESS_DENIED   Some part of a range is not.
+
+**/
+EFI_STATUS
+InternalMemoryScrubCheckRanges (
+  IN CONST MEMORY_SCRUB_RANGE  *Ranges,
+  IN UINTN                     RangeCount
+  );
+
+/**
+  Groups the ranges of a run by the package of processors they are local to.
+
+  @param  Context   The run. MpServices, Ranges and RangeCount are set.
+
+  @retval EFI_SUCCESS             The ranges were grouped.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalMemoryScrubPartition (
+  IN OUT MEMORY_SCRUB_CONTEXT  *Context
+  );
+
+/**
+  Frees the groups of a run.
+
+  @param  Context   The run.
+
+**/
+VOID
+InternalMemoryScrubFreePartition (
+  IN OUT MEMORY_SCRUB_CONTEXT  *Context
+  );
+
+/**
+  Returns the group of the processor that calls the function.
+
+  @param  Context   The run.
+
+  @return The group of the package of the processor, or the last group if the
+          processor is not known.
+
+**/
+UINT32
+InternalMemoryScrubGetGroup (
+  IN MEMORY_SCRUB_CONTEXT  *Context
+  );
+
+/**
+  Handles a chunk of memory.
+
+  @param  Operation     The operation.
+  @param  Pattern       The pattern.
+  @param  Address       The address of the chunk, a multiple of 8.
+  @param  Length        The length of the chunk, a multiple of 8.
+  @param  ErrorAddress  Returns the address of a word that did not match, if any.
+
+  @return The number of words that did not match.
+
+**/
+UINT32
+InternalMemoryScrubChunk (
+  IN  MEMORY_SCRUB_OPERATION  Operation,
+  IN  UINT64                  Pattern,
+  IN  UINTN                   Address,
+  IN  UINTN                   Length,
+  OUT UINT64                  *ErrorAddress
+  );
+
+#endif
@@ -0,0 +1,173 @@
+/** @file
+  Fill, test and read loops of the memory test and scrub library.
+
+  Only the fill may use non-temporal stores: it goes through SetMem64(), which the
+  SSE2 instance of BaseMemoryLib implements with them, so that the memory is
+  written without being read into the caches first. The test and read loops use
+  ordinary loads and stores, four words per iteration. The test writes the chunk
+  back to memory and invalidates it in the caches before the check, so that the
+  check reads the memory and not the copy of the chunk in the caches.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "MemoryScrubInternal.h"
+
+/**
+  Writes every word with the pattern XOR its address.
+
+  @param  Pattern   The pattern.
+  @param  Address   The address of the chunk.
+  @param  Count     The number of words.
+
+**/
+VOID
+InternalMemoryScrubWriteAddress (
+  IN UINT64  Pattern,
+  IN UINTN   Address,
+  IN UINTN   Count
+  )
+{
+  volatile UINT64  *Word;
+  UINT64           Value;
+
+  Word  = (volatile UINT64 *) Address;
+  Value = (UINT64) Address;
+  for (; Count >= 4; Count -= 4, Word += 4, Value += 32) {
+    Word[0] = Pattern ^ Value;
+    Word[1] = Pattern ^ (Value + 8);
+    Word[2] = Pattern ^ (Value + 16);
+    Word[3] = Pattern ^ (Value + 24);
+  }
+  for (; Count > 0; Count--, Word++, Value += 8) {
+    *Word = Pattern ^ Value;
+  }
+}
+
+/**
+  Compares every word with the pattern XOR its address.
+
+  @param  Pattern       The pattern.
+  @param  Address       The address of the chunk.
+  @param  Count         The number of words.
+  @param  ErrorAddress  Returns the address of a word that did not match, if any.
+
+  @return The number of words that did not match.
+
+**/
+UINT32
+InternalMemoryScrubCheckAddress (
+  IN  UINT64  Pattern,
+  IN  UINTN   Address,
+  IN  UINTN   Count,
+  OUT UINT64  *ErrorAddress
+  )
+{
+  volatile UINT64  *Word;
+  UINT64           Value;
+  UINT32           Errors;
+  UINTN            Group;
+  UINTN            Index;
+
+  Word   = (volatile UINT64 *) Address;
+  Value  = (UINT64) Address;
+  Errors = 0;
+  while (Count > 0) {
+    //
+    // The words of a group are checked one by one only when the group differs.
+    //
+    Group = MIN (Count, 4);
+    if (Group < 4 ||
+        ((Word[0] ^ Pattern ^ Value) |
+         (Word[1] ^ Pattern ^ (Value + 8)) |
+         (Word[2] ^ Pattern ^ (Value + 16)) |
+         (Word[3] ^ Pattern ^ (Value + 24))) != 0) {
+      for (Index = 0; Index < Group; Index++) {
+        if (Word[Index] != (Pattern ^ (Value + Index * 8))) {
+          *ErrorAddress = Value + Index * 8;
+          Errors++;
+        }
+      }
+    }
+    Count -= Group;
+    Word  += Group;
+    Value += Group * 8;
+  }
+  return Errors;
+}
+
+/**
+  Reads every word.
+
+  @param  Address   The address of the chunk.
+  @param  Count     The number of words.
+
+  @return The XOR of the words, so that the reads are not optimized out.
+
+**/
+UINT64
+InternalMemoryScrubReadWords (
+  IN UINTN  Address,
+  IN UINTN  Count
+  )
+{
+  volatile UINT64  *Word;
+  UINT64           Sum;
+
+  Word = (volatile UINT64 *) Address;
+  Sum  = 0;
+  for (; Count >= 4; Count -= 4, Word += 4) {
+    Sum ^= Word[0] ^ Word[1] ^ Word[2] ^ Word[3];
+  }
+  for (; Count > 0; Count--, Word++) {
+    Sum ^= *Word;
+  }
+  return Sum;
+}
+
+/**
+  Handles a chunk of memory.
+
+  @param  Operation     The operation.
+  @param  Pattern       The pattern.
+  @param  Address       The address of the chunk, a multiple of 8.
+  @param  Length        The length of the chunk, a multiple of 8.
+  @param  ErrorAddress  Returns the address of a word that did not match, if any.
+
+  @return The number of words that did not match.
+
+**/
+UINT32
+InternalMemoryScrubChunk (
+  IN  MEMORY_SCRUB_OPERATION  Operation,
+  IN  UINT64                  Pattern,
+  IN  UINTN                   Address,
+  IN  UINTN                   Length,
+  OUT UINT64                  *ErrorAddress
+  )
+{
+  ASSERT ((Address & 7) == 0 && (Length & 7) == 0);
+
+  switch (Operation) {
+  case MemoryScrubFill:
+    SetMem64 ((VOID *) Address, Length, Pattern);
+    return 0;
+
+  case MemoryScrubTest:
+    InternalMemoryScrubWriteAddress (Pattern, Address, Length / sizeof (UINT64));
+    WriteBackInvalidateDataCacheRange ((VOID *) Address, Length);
+    return InternalMemoryScrubCheckAddress (Pattern, Address, Length / sizeof (UINT64), ErrorAddress);
+
+  default:
+    InternalMemoryScrubReadWords (Address, Length / sizeof (UINT64));
+    return 0;
+  }
+}
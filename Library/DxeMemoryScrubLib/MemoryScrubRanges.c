@@ -0,0 +1,381 @@
+/** @file
+  Ranges of the memory test and scrub library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "MemoryScrubInternal.h"
+
+/**
+  Tells whether a memory space descriptor describes untested system memory.
+
+  This is the memory that the DXE core may still promote to system memory when an
+  allocation fails, and that the memory test driver adds to the memory map.
+
+  @param  Descriptor    The memory space descriptor.
+
+  @retval TRUE    The memory is present and initialized, but not tested.
+  @retval FALSE   The memory is not untested system memory.
+
+**/
+BOOLEAN
+InternalMemoryScrubIsUntested (
+  IN CONST EFI_GCD_MEMORY_SPACE_DESCRIPTOR  *Descriptor
+  )
+{
+  return (BOOLEAN) (Descriptor->GcdMemoryType == EfiGcdMemoryTypeReserved &&
+                    (Descriptor->Capabilities & (EFI_MEMORY_PRESENT | EFI_MEMORY_INITIALIZED | EFI_MEMORY_TESTED)) ==
+                    (EFI_MEMORY_PRESENT | EFI_MEMORY_INITIALIZED));
+}
+
+/**
+  Cuts a memory space descriptor to the memory that the processor can address.
+
+  @param  Descriptor    The memory space descriptor.
+  @param  Range         Returns the range.
+
+  @retval TRUE    The descriptor describes untested system memory that can be
+                  addressed.
+  @retval FALSE   The descriptor is to be skipped.
+
+**/
+BOOLEAN
+InternalMemoryScrubDescriptorToRange (
+  IN  CONST EFI_GCD_MEMORY_SPACE_DESCRIPTOR  *Descriptor,
+  OUT MEMORY_SCRUB_RANGE                     *Range
+  )
+{
+  UINT64  Base;
+  UINT64  Last;
+
+  if (!InternalMemoryScrubIsUntested (Descriptor) ||
+      Descriptor->Length == 0 ||
+      Descriptor->BaseAddress > MAX_ADDRESS) {
+    return FALSE;
+  }
+
+  Base = (Descriptor->BaseAddress + 7) & ~(UINT64) 7;
+  Last = Descriptor->BaseAddress + MIN (Descriptor->Length - 1, MAX_ADDRESS - Descriptor->BaseAddress);
+  if (Last < Base) {
+    return FALSE;
+  }
+
+  ZeroMem (Range, sizeof (MEMORY_SCRUB_RANGE));
+  Range->Base    = Base;
+  Range->Length  = (Last - Base + 1) & ~(UINT64) 7;
+  Range->Package = MEMORY_SCRUB_ANY_PACKAGE;
+  return (BOOLEAN) (Range->Length != 0);
+}
+
+/**
+  Returns the untested system memory of the GCD memory space map.
+
+  The ranges are cut to the memory that the processor can address, and their
+  Package is MEMORY_SCRUB_ANY_PACKAGE; the platform sets the package of the ranges
+  it knows to be local to one.
+
+  @param  Ranges        Returns the ranges, to be freed with FreePool().
+  @param  RangeCount    Returns the number of ranges.
+
+  @retval EFI_SUCCESS             The ranges were returned.
+  @retval EFI_INVALID_PARAMETER   Ranges or RangeCount is NULL.
+  @retval EFI_NOT_FOUND           There is no untested system memory.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+MemoryScrubGetUntestedRanges (
+  OUT MEMORY_SCRUB_RANGE  **Ranges,
+  OUT UINTN               *RangeCount
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR  *Map;
+  UINTN                            MapCount;
+  MEMORY_SCRUB_RANGE               Range;
+  MEMORY_SCRUB_RANGE               *Buffer;
+  UINTN                            Count;
+  UINTN                            Index;
+
+  if (Ranges == NULL || RangeCount == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = gDS->GetMemorySpaceMap (&MapCount, &Map);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Count = 0;
+  for (Index = 0; Index < MapCount; Index++) {
+    if (InternalMemoryScrubDescriptorToRange (&Map[Index], &Range)) {
+      Count++;
+    }
+  }
+  if (Count == 0) {
+    FreePool (Map);
+    return EFI_NOT_FOUND;
+  }
+
+  Buffer = AllocatePool (Count * sizeof (MEMORY_SCRUB_RANGE));
+  if (Buffer == NULL) {
+    FreePool (Map);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Count = 0;
+  for (Index = 0; Index < MapCount; Index++) {
+    if (InternalMemoryScrubDescriptorToRange (&Map[Index], &Buffer[Count])) {
+      Count++;
+    }
+  }
+  FreePool (Map);
+
+  *Ranges     = Buffer;
+  *RangeCount = Count;
+  return EFI_SUCCESS;
+}
+
+/**
+  Checks that ranges are still untested system memory in the GCD memory space map.
+
+  The DXE core promotes untested memory to system memory when an allocation fails,
+  so the ranges are checked again right before they are written.
+
+  @param  Ranges        The ranges, checked by MemoryScrubRun().
+  @param  RangeCount    The number of ranges.
+
+  @retval EFI_SUCCESS         Every range is untested system memory.
+  @retval EFI_ACCESS_DENIED   Some part of a range is not.
+
+**/
+EFI_STATUS
+InternalMemoryScrubCheckRanges (
+  IN CONST MEMORY_SCRUB_RANGE  *Ranges,
+  IN UINTN                     RangeCount
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR  Descriptor;
+  EFI_PHYSICAL_ADDRESS             Address;
+  EFI_PHYSICAL_ADDRESS             Last;
+  UINTN                            Index;
+
+  for (Index = 0; Index < RangeCount; Index++) {
+    if (Ranges[Index].Length == 0) {
+      continue;
+    }
+    Address = Ranges[Index].Base;
+    Last    = Ranges[Index].Base + Ranges[Index].Length - 1;
+    while (TRUE) {
+      Status = gDS->GetMemorySpaceDescriptor (Address, &Descriptor);
+      if (EFI_ERROR (Status) || !InternalMemoryScrubIsUntested (&Descriptor) ||
+          Descriptor.Length == 0 || Descriptor.BaseAddress > Address) {
+        DEBUG ((DEBUG_ERROR, "MemoryScrubLib: 0x%lx is not untested memory\n", Address));
+        return EFI_ACCESS_DENIED;
+      }
+      if (Descriptor.Length - 1 >= Last - Descriptor.BaseAddress) {
+        break;
+      }
+      Address = Descriptor.BaseAddress + Descriptor.Length;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Finds a package in the packages seen so far.
+
+  @param  Packages      The package numbers.
+  @param  PackageCount  The number of packages.
+  @param  Package       The package number.
+
+  @return The index of the package, or PackageCount if it is not there.
+
+**/
+UINT32
+InternalMemoryScrubFindPackage (
+  IN CONST UINT32  *Packages,
+  IN UINT32        PackageCount,
+  IN UINT32        Package
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < PackageCount; Index++) {
+    if (Packages[Index] == Package) {
+      break;
+    }
+  }
+  return Index;
+}
+
+/**
+  Groups the ranges of a run by the package of processors they are local to.
+
+  @param  Context   The run. MpServices, Ranges and RangeCount are set.
+
+  @retval EFI_SUCCESS             The ranges were grouped.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalMemoryScrubPartition (
+  IN OUT MEMORY_SCRUB_CONTEXT  *Context
+  )
+{
+  EFI_STATUS                          Status;
+  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  EFI_MP_PROC_CONTEXT                 ProcessorContext;
+  UINTN                               Length;
+  UINTN                               Count;
+  UINT32                              *Packages;
+  UINT32                              PackageCount;
+  UINT32                              Group;
+  UINTN                               Index;
+
+  MpServices   = Context->MpServices;
+  Count        = 0;
+  Packages     = NULL;
+  PackageCount = 0;
+  if (MpServices != NULL) {
+    Status = MpServices->GetGeneralMPInfo (MpServices, &Count, NULL, NULL, NULL, NULL);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "MemoryScrubLib: GetGeneralMPInfo() failed - %r\n", Status));
+      Count = 0;
+    }
+  }
+
+  if (Count != 0) {
+    Packages                = AllocatePool (Count * sizeof (UINT32));
+    Context->ProcessorGroup = AllocatePool (Count * sizeof (UINT32));
+    if (Packages == NULL || Context->ProcessorGroup == NULL) {
+      goto OutOfResources;
+    }
+    Context->ProcessorCount = Count;
+
+    //
+    // The processors whose context cannot be read are given the last group, which
+    // is only known once all the packages have been seen.
+    //
+    for (Index = 0; Index < Count; Index++) {
+      Length = sizeof (EFI_MP_PROC_CONTEXT);
+      Status = MpServices->GetProcessorContext (MpServices, Index, &Length, &ProcessorContext);
+      if (EFI_ERROR (Status)) {
+        Context->ProcessorGroup[Index] = MAX_UINT32;
+        continue;
+      }
+      Group = InternalMemoryScrubFindPackage (Packages, PackageCount, (UINT32) ProcessorContext.PackageNumber);
+      if (Group == PackageCount) {
+        Packages[PackageCount++] = (UINT32) ProcessorContext.PackageNumber;
+      }
+      Context->ProcessorGroup[Index] = Group;
+    }
+    for (Index = 0; Index < Count; Index++) {
+      if (Context->ProcessorGroup[Index] == MAX_UINT32) {
+        Context->ProcessorGroup[Index] = PackageCount;
+      }
+    }
+  }
+  Context->GroupCount = PackageCount + 1;
+
+  Context->GroupStart = AllocateZeroPool ((Context->GroupCount + 1) * sizeof (UINT32));
+  Context->Order      = AllocatePool (MAX (Context->RangeCount, 1) * sizeof (UINT32));
+  if (Context->GroupStart == NULL || Context->Order == NULL) {
+    goto OutOfResources;
+  }
+
+  //
+  // Counting sort: GroupStart[Group + 1] counts the ranges of every group, is
+  // summed up, then is moved forward while the ranges are placed and moved back.
+  //
+  for (Index = 0; Index < Context->RangeCount; Index++) {
+    Group = InternalMemoryScrubFindPackage (Packages, PackageCount, Context->Ranges[Index].Package);
+    Context->GroupStart[Group + 1]++;
+  }
+  for (Group = 0; Group < Context->GroupCount; Group++) {
+    Context->GroupStart[Group + 1] += Context->GroupStart[Group];
+  }
+  for (Index = 0; Index < Context->RangeCount; Index++) {
+    Group = InternalMemoryScrubFindPackage (Packages, PackageCount, Context->Ranges[Index].Package);
+    Context->Order[Context->GroupStart[Group]++] = (UINT32) Index;
+  }
+  for (Group = Context->GroupCount; Group > 0; Group--) {
+    Context->GroupStart[Group] = Context->GroupStart[Group - 1];
+  }
+  Context->GroupStart[0] = 0;
+
+  if (Packages != NULL) {
+    FreePool (Packages);
+  }
+  return EFI_SUCCESS;
+
+OutOfResources:
+  if (Packages != NULL) {
+    FreePool (Packages);
+  }
+  InternalMemoryScrubFreePartition (Context);
+  return EFI_OUT_OF_RESOURCES;
+}
+
+/**
+  Frees the groups of a run.
+
+  @param  Context   The run.
+
+**/
+VOID
+InternalMemoryScrubFreePartition (
+  IN OUT MEMORY_SCRUB_CONTEXT  *Context
+  )
+{
+  if (Context->ProcessorGroup != NULL) {
+    FreePool (Context->ProcessorGroup);
+    Context->ProcessorGroup = NULL;
+  }
+  if (Context->GroupStart != NULL) {
+    FreePool (Context->GroupStart);
+    Context->GroupStart = NULL;
+  }
+  if (Context->Order != NULL) {
+    FreePool (Context->Order);
+    Context->Order = NULL;
+  }
+  Context->ProcessorCount = 0;
+}
+
+/**
+  Returns the group of the processor that calls the function.
+
+  @param  Context   The run.
+
+  @return The group of the package of the processor, or the last group if the
+          processor is not known.
+
+**/
+UINT32
+InternalMemoryScrubGetGroup (
+  IN MEMORY_SCRUB_CONTEXT  *Context
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       ProcessorNumber;
+
+  if (Context->ProcessorCount != 0) {
+    Status = Context->MpServices->WhoAmI (Context->MpServices, &ProcessorNumber);
+    if (!EFI_ERROR (Status) && ProcessorNumber < Context->ProcessorCount) {
+      return Context->ProcessorGroup[ProcessorNumber];
+    }
+  }
+  return Context->GroupCount - 1;
+}
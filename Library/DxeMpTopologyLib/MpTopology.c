@@ -0,0 +1,504 @@
+/** @file
+  Snapshot of the processor topology.
+
+  The snapshot is one block of pages: the MP_TOPOLOGY header, the processors, the
+  processor numbers sorted by topology, the package starts, and the hash table of
+  the APIC IDs, each on its own cache lines. It is rebuilt in place, so that the
+  pointers handed out stay valid, unless the processors outgrow it.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "MpTopologyInternal.h"
+
+/**
+  Compares two processors by package, core and thread number, then by processor
+  number.
+
+  @param  Processors    The processors.
+  @param  Left          The processor number of the first processor.
+  @param  Right         The processor number of the second processor.
+
+  @retval TRUE    The first processor comes after the second one.
+  @retval FALSE   The first processor comes before the second one.
+
+**/
+BOOLEAN
+InternalMpTopologyIsAfter (
+  IN CONST MP_TOPOLOGY_PROCESSOR  *Processors,
+  IN UINT32                       Left,
+  IN UINT32                       Right
+  )
+{
+  if (Processors[Left].Package != Processors[Right].Package) {
+    return (BOOLEAN) (Processors[Left].Package > Processors[Right].Package);
+  }
+  if (Processors[Left].Core != Processors[Right].Core) {
+    return (BOOLEAN) (Processors[Left].Core > Processors[Right].Core);
+  }
+  if (Processors[Left].Thread != Processors[Right].Thread) {
+    return (BOOLEAN) (Processors[Left].Thread > Processors[Right].Thread);
+  }
+  return (BOOLEAN) (Left > Right);
+}
+
+/**
+  Returns the number of pages of a snapshot.
+
+  @param  Capacity    The number of processors the snapshot has room for.
+  @param  TableSize   Returns the number of entries of the hash table.
+
+  @return The number of pages.
+
+**/
+UINTN
+InternalMpTopologyPages (
+  IN  UINTN   Capacity,
+  OUT UINT32  *TableSize
+  )
+{
+  *TableSize = GetPowerOfTwo32 ((UINT32) Capacity) * 4;
+  return EFI_SIZE_TO_PAGES (
+           ALIGN_VALUE (sizeof (MP_TOPOLOGY), MP_TOPOLOGY_CACHE_LINE_SIZE) +
+           ALIGN_VALUE (Capacity * sizeof (MP_TOPOLOGY_PROCESSOR), MP_TOPOLOGY_CACHE_LINE_SIZE) +
+           ALIGN_VALUE ((2 * Capacity + 1) * sizeof (UINT32), MP_TOPOLOGY_CACHE_LINE_SIZE) +
+           *TableSize * sizeof (UINT32)
+           );
+}
+
+/**
+  Builds a snapshot from the processor contexts.
+
+  @param  Topology      The pages of the snapshot.
+  @param  Capacity      The number of processors the pages have room for.
+  @param  Contexts      The processor contexts.
+  @param  Count         The number of processors, which is at most Capacity.
+  @param  Generation    The generation of the snapshot.
+
+**/
+VOID
+InternalMpTopologyBuild (
+  OUT MP_TOPOLOGY                *Topology,
+  IN  UINTN                      Capacity,
+  IN  CONST EFI_MP_PROC_CONTEXT  *Contexts,
+  IN  UINTN                      Count,
+  IN  UINT32                     Generation
+  )
+{
+  MP_TOPOLOGY_PROCESSOR  *Processors;
+  MP_TOPOLOGY_PROCESSOR  *Processor;
+  MP_TOPOLOGY_PROCESSOR  *Previous;
+  UINT32                 *ByTopology;
+  UINT32                 TableSize;
+  UINT32                 Value;
+  UINT32                 Slot;
+  UINTN                  Gap;
+  UINTN                  Index;
+  UINTN                  Position;
+
+  ZeroMem (Topology, EFI_PAGES_TO_SIZE (InternalMpTopologyPages (Capacity, &TableSize)));
+  Processors               = (MP_TOPOLOGY_PROCESSOR *) ((UINT8 *) Topology + ALIGN_VALUE (sizeof (MP_TOPOLOGY), MP_TOPOLOGY_CACHE_LINE_SIZE));
+  ByTopology               = (UINT32 *) ((UINT8 *) Processors + ALIGN_VALUE (Capacity * sizeof (MP_TOPOLOGY_PROCESSOR), MP_TOPOLOGY_CACHE_LINE_SIZE));
+  Topology->Processors     = Processors;
+  Topology->ByTopology     = ByTopology;
+  Topology->PackageStart   = ByTopology + Capacity;
+  Topology->ApicIdTable    = (UINT32 *) ((UINT8 *) ByTopology + ALIGN_VALUE ((2 * Capacity + 1) * sizeof (UINT32), MP_TOPOLOGY_CACHE_LINE_SIZE));
+  Topology->ApicIdMask     = TableSize - 1;
+  Topology->ApicIdShift    = 32 - (UINT32) HighBitSet32 (TableSize);
+  Topology->Generation     = Generation;
+  Topology->ProcessorCount = (UINT32) Count;
+
+  for (Index = 0; Index < Count; Index++) {
+    Processor          = &Processors[Index];
+    Processor->ApicId  = Contexts[Index].ApicID;
+    Processor->Package = (UINT32) Contexts[Index].PackageNumber;
+    Processor->Core    = (UINT32) Contexts[Index].NumberOfCores;
+    Processor->Thread  = (UINT32) Contexts[Index].NumberOfThreads;
+    Processor->Health  = Contexts[Index].Health;
+    Processor->Enabled = Contexts[Index].Enabled;
+    Processor->Bsp     = (BOOLEAN) (Contexts[Index].Designation == EfiCpuBSP);
+    if (Processor->Enabled) {
+      Topology->EnabledCount++;
+    }
+    if (Processor->Bsp) {
+      Topology->BspNumber = (UINT32) Index;
+    }
+    ByTopology[Index] = (UINT32) Index;
+  }
+
+  for (Gap = Count / 2; Gap > 0; Gap /= 2) {
+    for (Index = Gap; Index < Count; Index++) {
+      Value = ByTopology[Index];
+      for (Position = Index; Position >= Gap && InternalMpTopologyIsAfter (Processors, ByTopology[Position - Gap], Value); Position -= Gap) {
+        ByTopology[Position] = ByTopology[Position - Gap];
+      }
+      ByTopology[Position] = Value;
+    }
+  }
+
+  //
+  // The packages and the cores are numbered in the order of the sorted processors.
+  //
+  Previous = NULL;
+  for (Index = 0; Index < Count; Index++) {
+    Processor = &Processors[ByTopology[Index]];
+    if (Previous == NULL || Processor->Package != Previous->Package) {
+      Topology->PackageStart[Topology->PackageCount++] = (UINT32) Index;
+      Topology->CoreCount++;
+    } else if (Processor->Core != Previous->Core) {
+      Topology->CoreCount++;
+    }
+    ASSERT (Topology->PackageCount <= MAX_UINT16 + 1);
+    Processor->PackageIndex = (UINT16) (Topology->PackageCount - 1);
+    Processor->CoreIndex    = Topology->CoreCount - 1;
+    Previous                = Processor;
+  }
+  Topology->PackageStart[Topology->PackageCount] = (UINT32) Count;
+
+  SetMem (Topology->ApicIdTable, TableSize * sizeof (UINT32), 0xFF);
+  for (Index = 0; Index < Count; Index++) {
+    Slot = MP_TOPOLOGY_APIC_ID_HASH (Topology, Processors[Index].ApicId);
+    while (Topology->ApicIdTable[Slot] != MAX_UINT32) {
+      if (Processors[Topology->ApicIdTable[Slot]].ApicId == Processors[Index].ApicId) {
+        DEBUG ((DEBUG_WARN, "MpTopologyLib: processors %d and %d have APIC ID 0x%x\n", Topology->ApicIdTable[Slot], Index, Processors[Index].ApicId));
+        break;
+      }
+      Slot = (Slot + 1) & Topology->ApicIdMask;
+    }
+    if (Topology->ApicIdTable[Slot] == MAX_UINT32) {
+      Topology->ApicIdTable[Slot] = (UINT32) Index;
+    }
+  }
+}
+
+/**
+  Reads all the processors from the filtered instance and rebuilds the snapshot.
+
+  @param  Instance    The caching instance.
+
+  @retval EFI_SUCCESS             The snapshot was rebuilt.
+  @retval EFI_DEVICE_ERROR        The processors could not be read. The previous
+                                  snapshot is kept.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated. The previous
+                                  snapshot is kept.
+
+**/
+EFI_STATUS
+InternalMpTopologyRebuild (
+  IN OUT MP_TOPOLOGY_INSTANCE  *Instance
+  )
+{
+  EFI_STATUS                          Status;
+  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *Lower;
+  EFI_MP_PROC_CONTEXT                 *Contexts;
+  MP_TOPOLOGY                         *Topology;
+  UINT32                              Generation;
+  UINT32                              TableSize;
+  UINTN                               Count;
+  UINTN                               Maximum;
+  UINTN                               RendezvousIntNumber;
+  UINTN                               RendezvousProcLength;
+  UINTN                               Pages;
+  UINTN                               Length;
+  UINTN                               Index;
+
+  Lower  = Instance->Lower;
+  Status = Lower->GetGeneralMPInfo (Lower, &Count, &Maximum, NULL, &RendezvousIntNumber, &RendezvousProcLength);
+  if (EFI_ERROR (Status) || Count == 0 || Count > MAX_UINT32 / 8) {
+    DEBUG ((DEBUG_ERROR, "MpTopologyLib: GetGeneralMPInfo() failed - %r\n", Status));
+    return EFI_DEVICE_ERROR;
+  }
+
+  Contexts = AllocatePool (Count * sizeof (EFI_MP_PROC_CONTEXT));
+  if (Contexts == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  for (Index = 0; Index < Count; Index++) {
+    Length = sizeof (EFI_MP_PROC_CONTEXT);
+    Status = Lower->GetProcessorContext (Lower, Index, &Length, &Contexts[Index]);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "MpTopologyLib: GetProcessorContext(%d) failed - %r\n", Index, Status));
+      FreePool (Contexts);
+      return EFI_DEVICE_ERROR;
+    }
+  }
+
+  Generation = 1;
+  if (Instance->Topology != NULL) {
+    Generation = Instance->Topology->Generation + 1;
+  }
+  if (Count > Instance->Capacity) {
+    Pages    = InternalMpTopologyPages (Count, &TableSize);
+    Topology = AllocatePages (Pages);
+    if (Topology == NULL) {
+      FreePool (Contexts);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    if (Instance->Topology != NULL) {
+      FreePages (Instance->Topology, Instance->Pages);
+    }
+    Instance->Topology = Topology;
+    Instance->Pages    = Pages;
+    Instance->Capacity = Count;
+  }
+  InternalMpTopologyBuild (Instance->Topology, Instance->Capacity, Contexts, Count, Generation);
+
+  if (Instance->Contexts != NULL) {
+    FreePool (Instance->Contexts);
+  }
+  Instance->Contexts             = Contexts;
+  Instance->MaximumNumberOfCPUs  = Maximum;
+  Instance->RendezvousIntNumber  = RendezvousIntNumber;
+  Instance->RendezvousProcLength = RendezvousProcLength;
+  return EFI_SUCCESS;
+}
+
+/**
+  Reads one processor again from the filtered instance, after its state or health
+  changed.
+
+  @param  Instance          The caching instance.
+  @param  ProcessorNumber   The processor.
+
+**/
+VOID
+InternalMpTopologyUpdate (
+  IN OUT MP_TOPOLOGY_INSTANCE  *Instance,
+  IN     UINTN                 ProcessorNumber
+  )
+{
+  EFI_STATUS             Status;
+  MP_TOPOLOGY            *Topology;
+  MP_TOPOLOGY_PROCESSOR  *Processor;
+  EFI_MP_PROC_CONTEXT    Context;
+  UINTN                  Length;
+
+  Topology = Instance->Topology;
+  Length   = sizeof (EFI_MP_PROC_CONTEXT);
+  Status   = Instance->Lower->GetProcessorContext (Instance->Lower, ProcessorNumber, &Length, &Context);
+  if (EFI_ERROR (Status) || ProcessorNumber >= Topology->ProcessorCount) {
+    InternalMpTopologyRebuild (Instance);
+    return;
+  }
+
+  //
+  // Only the state, the designation and the health of a processor change. Anything
+  // else means that the processors were renumbered.
+  //
+  Processor = &Topology->Processors[ProcessorNumber];
+  if (Context.ApicID != Processor->ApicId ||
+      (UINT32) Context.PackageNumber != Processor->Package ||
+      (UINT32) Context.NumberOfCores != Processor->Core ||
+      (UINT32) Context.NumberOfThreads != Processor->Thread) {
+    InternalMpTopologyRebuild (Instance);
+    return;
+  }
+
+  CopyMem (&Instance->Contexts[ProcessorNumber], &Context, sizeof (EFI_MP_PROC_CONTEXT));
+  if (Context.Enabled && !Processor->Enabled) {
+    Topology->EnabledCount++;
+  } else if (!Context.Enabled && Processor->Enabled) {
+    Topology->EnabledCount--;
+  }
+  Processor->Enabled = Context.Enabled;
+  Processor->Health  = Context.Health;
+  Processor->Bsp     = (BOOLEAN) (Context.Designation == EfiCpuBSP);
+  if (Processor->Bsp) {
+    Topology->BspNumber = (UINT32) ProcessorNumber;
+  }
+  Topology->Generation++;
+}
+
+/**
+  Creates a Framework MP Services Protocol instance that caches the topology of
+  another instance.
+
+  The caller installs the returned protocol in place of the filtered one. All the
+  calls to EnableDisableAP() and SwitchBSP() must go through the returned protocol,
+  or be followed by MpTopologyRefresh().
+
+  @param  MpServices        The instance to filter.
+  @param  CachedMpServices  Returns the caching instance.
+
+  @retval EFI_SUCCESS             The caching instance was created.
+  @retval EFI_INVALID_PARAMETER   MpServices or CachedMpServices is NULL.
+  @retval EFI_DEVICE_ERROR        The processors could not be read from MpServices.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyCreate (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices,
+  OUT FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  **CachedMpServices
+  )
+{
+  EFI_STATUS            Status;
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  if (MpServices == NULL || CachedMpServices == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = AllocateZeroPool (sizeof (MP_TOPOLOGY_INSTANCE));
+  if (Instance == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Instance->Lower = MpServices;
+  Status          = InternalMpTopologyRebuild (Instance);
+  if (EFI_ERROR (Status)) {
+    FreePool (Instance);
+    return Status;
+  }
+
+  Instance->Signature                      = MP_TOPOLOGY_SIGNATURE;
+  Instance->MpServices.GetGeneralMPInfo    = MpTopologyGetGeneralMPInfo;
+  Instance->MpServices.GetProcessorContext = MpTopologyGetProcessorContext;
+  Instance->MpServices.StartupAllAPs       = MpTopologyStartupAllAPs;
+  Instance->MpServices.StartupThisAP       = MpTopologyStartupThisAP;
+  Instance->MpServices.SwitchBSP           = MpTopologySwitchBSP;
+  Instance->MpServices.SendIPI             = MpTopologySendIPI;
+  Instance->MpServices.EnableDisableAP     = MpTopologyEnableDisableAP;
+  Instance->MpServices.WhoAmI              = MpTopologyWhoAmI;
+
+  *CachedMpServices = &Instance->MpServices;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees a caching MP Services Protocol instance created by MpTopologyCreate().
+
+  The caller must uninstall the protocol first.
+
+  @param  CachedMpServices  The caching instance.
+
+**/
+VOID
+EFIAPI
+MpTopologyDestroy (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *CachedMpServices
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  Instance = MP_TOPOLOGY_INSTANCE_FROM_THIS (CachedMpServices);
+
+  FreePages (Instance->Topology, Instance->Pages);
+  FreePool (Instance->Contexts);
+  Instance->Signature = 0;
+  FreePool (Instance);
+}
+
+/**
+  Returns the snapshot of a caching instance.
+
+  The snapshot stays at the same address until the instance is destroyed, unless a
+  refresh finds more processors than it has room for.
+
+  @param  CachedMpServices  The caching instance.
+  @param  Topology          Returns the snapshot.
+
+  @retval EFI_SUCCESS             The snapshot was returned.
+  @retval EFI_INVALID_PARAMETER   CachedMpServices was not created by this library,
+                                  or Topology is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyGet (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *CachedMpServices,
+  OUT CONST MP_TOPOLOGY                   **Topology
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  if (CachedMpServices == NULL || Topology == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = BASE_CR (CachedMpServices, MP_TOPOLOGY_INSTANCE, MpServices);
+  if (Instance->Signature != MP_TOPOLOGY_SIGNATURE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Topology = Instance->Topology;
+  return EFI_SUCCESS;
+}
+
+/**
+  Reads all the processors again from the filtered instance, after processors were
+  enabled, disabled or switched without going through the caching instance.
+
+  @param  CachedMpServices  The caching instance.
+
+  @retval EFI_SUCCESS             The snapshot was refreshed.
+  @retval EFI_INVALID_PARAMETER   CachedMpServices was not created by this library.
+  @retval EFI_DEVICE_ERROR        The processors could not be read. The previous
+                                  snapshot is kept.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated. The previous
+                                  snapshot is kept.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyRefresh (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *CachedMpServices
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  if (CachedMpServices == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = BASE_CR (CachedMpServices, MP_TOPOLOGY_INSTANCE, MpServices);
+  if (Instance->Signature != MP_TOPOLOGY_SIGNATURE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return InternalMpTopologyRebuild (Instance);
+}
+
+/**
+  Finds the processor that has an APIC ID.
+
+  @param  Topology          The snapshot.
+  @param  ApicId            The APIC ID.
+  @param  ProcessorNumber   Returns the processor number.
+
+  @retval EFI_SUCCESS     The processor was found.
+  @retval EFI_NOT_FOUND   No processor has the APIC ID.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyFindProcessor (
+  IN  CONST MP_TOPOLOGY  *Topology,
+  IN  UINT32             ApicId,
+  OUT UINTN              *ProcessorNumber
+  )
+{
+  UINT32  Slot;
+  UINT32  Number;
+
+  ASSERT (Topology != NULL && ProcessorNumber != NULL);
+
+  for (Slot = MP_TOPOLOGY_APIC_ID_HASH (Topology, ApicId); ; Slot = (Slot + 1) & Topology->ApicIdMask) {
+    Number = Topology->ApicIdTable[Slot];
+    if (Number == MAX_UINT32) {
+      return EFI_NOT_FOUND;
+    }
+    if (Topology->Processors[Number].ApicId == ApicId) {
+      *ProcessorNumber = Number;
+      return EFI_SUCCESS;
+    }
+  }
+}
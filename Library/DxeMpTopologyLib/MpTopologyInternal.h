@@ -0,0 +1,220 @@
+/** @file
+  Internal definitions of the processor topology library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _MP_TOPOLOGY_INTERNAL_H_
+#define _MP_TOPOLOGY_INTERNAL_H_
+
+#include <FrameworkDxe.h>
+
+#include <Protocol/FrameworkMpService.h>
+
+#include <Library/MpTopologyLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define MP_TOPOLOGY_SIGNATURE  SIGNATURE_32 ('M', 'P', 'T', 'O')
+
+#define MP_TOPOLOGY_CACHE_LINE_SIZE  64
+
+///
+/// Slot of an APIC ID in the hash table: the high bits of its Fibonacci hash, which
+/// spread both consecutive APIC IDs and APIC IDs that differ in their high bits.
+///
+#define MP_TOPOLOGY_APIC_ID_HASH(Topology, ApicId) \
+  ((UINT32) ((ApicId) * 0x9E3779B1U) >> (Topology)->ApicIdShift)
+
+typedef struct {
+  UINT32                              Signature;              ///< MP_TOPOLOGY_SIGNATURE.
+  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  MpServices;
+  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *Lower;                 ///< The filtered instance.
+  ///
+  /// The snapshot, followed in the same pages by its processors, ByTopology,
+  /// PackageStart and ApicIdTable arrays.
+  ///
+  MP_TOPOLOGY                         *Topology;
+  UINTN                               Pages;
+  UINTN                               Capacity;               ///< Processors the pages have room for.
+  ///
+  /// The processor contexts, indexed by processor number, returned by
+  /// GetProcessorContext().
+  ///
+  EFI_MP_PROC_CONTEXT                 *Contexts;
+  UINTN                               MaximumNumberOfCPUs;
+  UINTN                               RendezvousIntNumber;
+  UINTN                               RendezvousProcLength;
+} MP_TOPOLOGY_INSTANCE;
+
+#define MP_TOPOLOGY_INSTANCE_FROM_THIS(a) \
+  CR (a, MP_TOPOLOGY_INSTANCE, MpServices, MP_TOPOLOGY_SIGNATURE)
+
+/**
+  Reads all the processors from the filtered instance and rebuilds the snapshot.
+
+  @param  Instance    The caching instance.
+
+  @retval EFI_SUCCESS             The snapshot was rebuilt.
+  @retval EFI_DEVICE_ERROR        The processors could not be read. The previous
+                                  snapshot is kept.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated. The previous
+                                  snapshot is kept.
+
+**/
+EFI_STATUS
+InternalMpTopologyRebuild (
+  IN OUT MP_TOPOLOGY_INSTANCE  *Instance
+  );
+
+/**
+  Reads one processor again from the filtered instance, after its state or health
+  changed.
+
+  @param  Instance          The caching instance.
+  @param  ProcessorNumber   The processor.
+
+**/
+VOID
+InternalMpTopologyUpdate (
+  IN OUT MP_TOPOLOGY_INSTANCE  *Instance,
+  IN     UINTN                 ProcessorNumber
+  );
+
+/**
+  Returns general information of the processors from the snapshot.
+
+  See EFI_MP_SERVICES_GET_GENERAL_MP_INFO for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyGetGeneralMPInfo (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  OUT UINTN                               *NumberOfCPUs          OPTIONAL,
+  OUT UINTN                               *MaximumNumberOfCPUs   OPTIONAL,
+  OUT UINTN                               *NumberOfEnabledCPUs   OPTIONAL,
+  OUT UINTN                               *RendezvousIntNumber   OPTIONAL,
+  OUT UINTN                               *RendezvousProcLength  OPTIONAL
+  );
+
+/**
+  Returns the context of a processor from the snapshot.
+
+  See EFI_MP_SERVICES_GET_PROCESSOR_CONTEXT for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyGetProcessorContext (
+  IN     FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN     UINTN                               ProcessorNumber,
+  IN OUT UINTN                               *BufferLength,
+  OUT    EFI_MP_PROC_CONTEXT                 *ProcessorContextBuffer
+  );
+
+/**
+  Passes StartupAllAPs() to the filtered instance.
+
+  See FRAMEWORK_EFI_MP_SERVICES_STARTUP_ALL_APS for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyStartupAllAPs (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN  FRAMEWORK_EFI_AP_PROCEDURE          Procedure,
+  IN  BOOLEAN                             SingleThread,
+  IN  EFI_EVENT                           WaitEvent           OPTIONAL,
+  IN  UINTN                               TimeoutInMicroSecs,
+  IN  VOID                                *ProcArguments      OPTIONAL,
+  OUT UINTN                               *FailedCPUList      OPTIONAL
+  );
+
+/**
+  Passes StartupThisAP() to the filtered instance.
+
+  See FRAMEWORK_EFI_MP_SERVICES_STARTUP_THIS_AP for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyStartupThisAP (
+  IN     FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN     FRAMEWORK_EFI_AP_PROCEDURE          Procedure,
+  IN     UINTN                               ProcessorNumber,
+  IN     EFI_EVENT                           WaitEvent            OPTIONAL,
+  IN     UINTN                               TimeoutInMicroSecs,
+  IN OUT VOID                                *ProcArguments       OPTIONAL
+  );
+
+/**
+  Switches the BSP through the filtered instance, and updates the old and the new
+  BSP in the snapshot.
+
+  See FRAMEWORK_EFI_MP_SERVICES_SWITCH_BSP for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologySwitchBSP (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN UINTN                               ProcessorNumber,
+  IN BOOLEAN                             EnableOldBSP
+  );
+
+/**
+  Passes SendIPI() to the filtered instance.
+
+  See EFI_MP_SERVICES_SEND_IPI for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologySendIPI (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN UINTN                               ProcessorNumber,
+  IN UINTN                               VectorNumber,
+  IN UINTN                               DeliveryMode
+  );
+
+/**
+  Enables or disables an AP through the filtered instance, and updates it in the
+  snapshot.
+
+  See FRAMEWORK_EFI_MP_SERVICES_ENABLEDISABLEAP for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyEnableDisableAP (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN UINTN                               ProcessorNumber,
+  IN BOOLEAN                             NewAPState,
+  IN EFI_MP_HEALTH                       *HealthState  OPTIONAL
+  );
+
+/**
+  Passes WhoAmI() to the filtered instance.
+
+  See FRAMEWORK_EFI_MP_SERVICES_WHOAMI for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyWhoAmI (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  OUT UINTN                               *ProcessorNumber
+  );
+
+#endif
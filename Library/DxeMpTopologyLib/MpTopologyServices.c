@@ -0,0 +1,300 @@
+/** @file
+  MP Services Protocol members of the processor topology library.
+
+  GetGeneralMPInfo() and GetProcessorContext() are served from the snapshot.
+  EnableDisableAP() and SwitchBSP() read the processors they changed again. The
+  other members are passed to the filtered instance.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "MpTopologyInternal.h"
+
+/**
+  Returns general information of the processors from the snapshot.
+
+  @param  This                    Indicates the FRAMEWORK_EFI_MP_SERVICES_PROTOCOL instance.
+  @param  NumberOfCPUs            Returns the number of processors, including the
+                                  disabled ones.
+  @param  MaximumNumberOfCPUs     Returns the maximum number of processors.
+  @param  NumberOfEnabledCPUs     Returns the number of enabled processors.
+  @param  RendezvousIntNumber     Returns the rendezvous interrupt number.
+  @param  RendezvousProcLength    Returns the length of the rendezvous procedure.
+
+  @retval EFI_SUCCESS   The information was returned.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyGetGeneralMPInfo (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  OUT UINTN                               *NumberOfCPUs          OPTIONAL,
+  OUT UINTN                               *MaximumNumberOfCPUs   OPTIONAL,
+  OUT UINTN                               *NumberOfEnabledCPUs   OPTIONAL,
+  OUT UINTN                               *RendezvousIntNumber   OPTIONAL,
+  OUT UINTN                               *RendezvousProcLength  OPTIONAL
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  Instance = MP_TOPOLOGY_INSTANCE_FROM_THIS (This);
+
+  if (NumberOfCPUs != NULL) {
+    *NumberOfCPUs = Instance->Topology->ProcessorCount;
+  }
+  if (MaximumNumberOfCPUs != NULL) {
+    *MaximumNumberOfCPUs = Instance->MaximumNumberOfCPUs;
+  }
+  if (NumberOfEnabledCPUs != NULL) {
+    *NumberOfEnabledCPUs = Instance->Topology->EnabledCount;
+  }
+  if (RendezvousIntNumber != NULL) {
+    *RendezvousIntNumber = Instance->RendezvousIntNumber;
+  }
+  if (RendezvousProcLength != NULL) {
+    *RendezvousProcLength = Instance->RendezvousProcLength;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the context of a processor from the snapshot.
+
+  @param  This                      Indicates the FRAMEWORK_EFI_MP_SERVICES_PROTOCOL instance.
+  @param  ProcessorNumber           The processor.
+  @param  BufferLength              On input, the size of ProcessorContextBuffer. On
+                                    output, the size needed if it was too small.
+  @param  ProcessorContextBuffer    Returns the context.
+
+  @retval EFI_SUCCESS             The context was returned.
+  @retval EFI_BUFFER_TOO_SMALL    ProcessorContextBuffer is too small. BufferLength
+                                  holds the size needed.
+  @retval EFI_INVALID_PARAMETER   BufferLength or ProcessorContextBuffer is NULL, or
+                                  the processor does not exist.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyGetProcessorContext (
+  IN     FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN     UINTN                               ProcessorNumber,
+  IN OUT UINTN                               *BufferLength,
+  OUT    EFI_MP_PROC_CONTEXT                 *ProcessorContextBuffer
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  Instance = MP_TOPOLOGY_INSTANCE_FROM_THIS (This);
+
+  if (BufferLength == NULL || ProcessorNumber >= Instance->Topology->ProcessorCount) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (*BufferLength < sizeof (EFI_MP_PROC_CONTEXT)) {
+    *BufferLength = sizeof (EFI_MP_PROC_CONTEXT);
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  if (ProcessorContextBuffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (ProcessorContextBuffer, &Instance->Contexts[ProcessorNumber], sizeof (EFI_MP_PROC_CONTEXT));
+  return EFI_SUCCESS;
+}
+
+/**
+  Passes StartupAllAPs() to the filtered instance.
+
+  @param  This                  Indicates the FRAMEWORK_EFI_MP_SERVICES_PROTOCOL instance.
+  @param  Procedure             The procedure run by the APs.
+  @param  SingleThread          Run the APs one by one.
+  @param  WaitEvent             The event signaled when the APs have finished.
+  @param  TimeoutInMicroSecs    The time the BSP waits for the APs.
+  @param  ProcArguments         The argument of Procedure.
+  @param  FailedCPUList         Returns the APs that did not finish.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyStartupAllAPs (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN  FRAMEWORK_EFI_AP_PROCEDURE          Procedure,
+  IN  BOOLEAN                             SingleThread,
+  IN  EFI_EVENT                           WaitEvent           OPTIONAL,
+  IN  UINTN                               TimeoutInMicroSecs,
+  IN  VOID                                *ProcArguments      OPTIONAL,
+  OUT UINTN                               *FailedCPUList      OPTIONAL
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  Instance = MP_TOPOLOGY_INSTANCE_FROM_THIS (This);
+  return Instance->Lower->StartupAllAPs (
+                            Instance->Lower,
+                            Procedure,
+                            SingleThread,
+                            WaitEvent,
+                            TimeoutInMicroSecs,
+                            ProcArguments,
+                            FailedCPUList
+                            );
+}
+
+/**
+  Passes StartupThisAP() to the filtered instance.
+
+  @param  This                  Indicates the FRAMEWORK_EFI_MP_SERVICES_PROTOCOL instance.
+  @param  Procedure             The procedure run by the AP.
+  @param  ProcessorNumber       The AP.
+  @param  WaitEvent             The event signaled when the AP has finished.
+  @param  TimeoutInMicroSecs    The time the BSP waits for the AP.
+  @param  ProcArguments         The argument of Procedure.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyStartupThisAP (
+  IN     FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN     FRAMEWORK_EFI_AP_PROCEDURE          Procedure,
+  IN     UINTN                               ProcessorNumber,
+  IN     EFI_EVENT                           WaitEvent            OPTIONAL,
+  IN     UINTN                               TimeoutInMicroSecs,
+  IN OUT VOID                                *ProcArguments       OPTIONAL
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  Instance = MP_TOPOLOGY_INSTANCE_FROM_THIS (This);
+  return Instance->Lower->StartupThisAP (
+                            Instance->Lower,
+                            Procedure,
+                            ProcessorNumber,
+                            WaitEvent,
+                            TimeoutInMicroSecs,
+                            ProcArguments
+                            );
+}
+
+/**
+  Switches the BSP through the filtered instance, and updates the old and the new
+  BSP in the snapshot.
+
+  @param  This              Indicates the FRAMEWORK_EFI_MP_SERVICES_PROTOCOL instance.
+  @param  ProcessorNumber   The AP that becomes the BSP.
+  @param  EnableOldBSP      Keep the old BSP enabled as an AP.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologySwitchBSP (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN UINTN                               ProcessorNumber,
+  IN BOOLEAN                             EnableOldBSP
+  )
+{
+  EFI_STATUS            Status;
+  MP_TOPOLOGY_INSTANCE  *Instance;
+  UINTN                 OldBspNumber;
+
+  Instance     = MP_TOPOLOGY_INSTANCE_FROM_THIS (This);
+  OldBspNumber = Instance->Topology->BspNumber;
+  Status       = Instance->Lower->SwitchBSP (Instance->Lower, ProcessorNumber, EnableOldBSP);
+  if (!EFI_ERROR (Status)) {
+    InternalMpTopologyUpdate (Instance, OldBspNumber);
+    InternalMpTopologyUpdate (Instance, ProcessorNumber);
+  }
+  return Status;
+}
+
+/**
+  Passes SendIPI() to the filtered instance.
+
+  @param  This              Indicates the FRAMEWORK_EFI_MP_SERVICES_PROTOCOL instance.
+  @param  ProcessorNumber   The AP.
+  @param  VectorNumber      The vector of the interrupt.
+  @param  DeliveryMode      The delivery mode of the interrupt.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologySendIPI (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN UINTN                               ProcessorNumber,
+  IN UINTN                               VectorNumber,
+  IN UINTN                               DeliveryMode
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  Instance = MP_TOPOLOGY_INSTANCE_FROM_THIS (This);
+  return Instance->Lower->SendIPI (Instance->Lower, ProcessorNumber, VectorNumber, DeliveryMode);
+}
+
+/**
+  Enables or disables an AP through the filtered instance, and updates it in the
+  snapshot.
+
+  @param  This              Indicates the FRAMEWORK_EFI_MP_SERVICES_PROTOCOL instance.
+  @param  ProcessorNumber   The AP.
+  @param  NewAPState        TRUE to enable the AP, FALSE to disable it.
+  @param  HealthState       The new health of the AP.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyEnableDisableAP (
+  IN FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  IN UINTN                               ProcessorNumber,
+  IN BOOLEAN                             NewAPState,
+  IN EFI_MP_HEALTH                       *HealthState  OPTIONAL
+  )
+{
+  EFI_STATUS            Status;
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  Instance = MP_TOPOLOGY_INSTANCE_FROM_THIS (This);
+  Status   = Instance->Lower->EnableDisableAP (Instance->Lower, ProcessorNumber, NewAPState, HealthState);
+  if (!EFI_ERROR (Status)) {
+    InternalMpTopologyUpdate (Instance, ProcessorNumber);
+  }
+  return Status;
+}
+
+/**
+  Passes WhoAmI() to the filtered instance.
+
+  @param  This              Indicates the FRAMEWORK_EFI_MP_SERVICES_PROTOCOL instance.
+  @param  ProcessorNumber   Returns the number of the calling processor.
+
+  @return The status returned by the filtered instance.
+
+**/
+EFI_STATUS
+EFIAPI
+MpTopologyWhoAmI (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *This,
+  OUT UINTN                               *ProcessorNumber
+  )
+{
+  MP_TOPOLOGY_INSTANCE  *Instance;
+
+  Instance = MP_TOPOLOGY_INSTANCE_FROM_THIS (This);
+  return Instance->Lower->WhoAmI (Instance->Lower, ProcessorNumber);
+}
@@ -0,0 +1,489 @@
+/** @file
+  Section Extraction Protocol services of the section extraction library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SectionExtractionInternal.h"
+
+/**
+  Finds an open section stream.
+
+  @param  Instance              The section extraction instance.
+  @param  SectionStreamHandle   The handle of the stream.
+
+  @return The section stream, or NULL if the handle does not exist.
+
+**/
+SECTION_STREAM *
+InternalSectionFindStream (
+  IN SECTION_EXTRACTION_INSTANCE  *Instance,
+  IN UINTN                        SectionStreamHandle
+  )
+{
+  LIST_ENTRY      *Link;
+  SECTION_STREAM  *Stream;
+
+  for (Link = GetFirstNode (&Instance->StreamList); !IsNull (&Instance->StreamList, Link); Link = GetNextNode (&Instance->StreamList, Link)) {
+    Stream = SECTION_STREAM_FROM_LINK (Link);
+    if (Stream->Handle == SectionStreamHandle) {
+      return Stream;
+    }
+  }
+  return NULL;
+}
+
+/**
+  Returns whether a section matches a request.
+
+  @param  Node                    The section.
+  @param  SectionType             The requested section type.
+  @param  SectionDefinitionGuid   The requested GUID of a GUID-defined section.
+
+  @retval TRUE    The section matches.
+  @retval FALSE   The section does not match.
+
+**/
+BOOLEAN
+InternalSectionMatch (
+  IN SECTION_NODE      *Node,
+  IN EFI_SECTION_TYPE  SectionType,
+  IN EFI_GUID          *SectionDefinitionGuid
+  )
+{
+  EFI_GUID  *Guid;
+
+  if (SectionType == EFI_SECTION_ALL) {
+    return TRUE;
+  }
+  if (Node->Section->Type != SectionType) {
+    return FALSE;
+  }
+  if (SectionType != EFI_SECTION_GUID_DEFINED || SectionDefinitionGuid == NULL) {
+    return TRUE;
+  }
+
+  if (Node->HeaderSize == sizeof (EFI_COMMON_SECTION_HEADER2)) {
+    if (Node->Size < sizeof (EFI_GUID_DEFINED_SECTION2)) {
+      return FALSE;
+    }
+    Guid = &((EFI_GUID_DEFINED_SECTION2 *) Node->Section)->SectionDefinitionGuid;
+  } else {
+    if (Node->Size < sizeof (EFI_GUID_DEFINED_SECTION)) {
+      return FALSE;
+    }
+    Guid = &((EFI_GUID_DEFINED_SECTION *) Node->Section)->SectionDefinitionGuid;
+  }
+  return CompareGuid (Guid, SectionDefinitionGuid);
+}
+
+/**
+  Searches sections and their children depth first.
+
+  @param  Tree                    The section tree.
+  @param  First                   The first section to search.
+  @param  Count                   The number of sections to search.
+  @param  SectionType             The requested section type.
+  @param  SectionDefinitionGuid   The requested GUID of a GUID-defined section.
+  @param  SectionInstance         The number of matching sections to skip. It is
+                                  decreased by the matching sections searched.
+  @param  Found                   Returns the section.
+
+  @retval EFI_SUCCESS     The section was found.
+  @retval EFI_NOT_FOUND   The section was not found.
+  @retval Others          The search reached an encapsulation section that could
+                          not be decoded.
+
+**/
+EFI_STATUS
+InternalSectionFind (
+  IN     SECTION_TREE      *Tree,
+  IN     UINTN             First,
+  IN     UINTN             Count,
+  IN     EFI_SECTION_TYPE  SectionType,
+  IN     EFI_GUID          *SectionDefinitionGuid,
+  IN OUT UINTN             *SectionInstance,
+  OUT    SECTION_NODE      **Found
+  )
+{
+  EFI_STATUS    Status;
+  SECTION_NODE  *Node;
+  UINTN         Index;
+
+  for (Index = First; Index < First + Count; Index++) {
+    Node = &Tree->Nodes[Index];
+    if (InternalSectionMatch (Node, SectionType, SectionDefinitionGuid)) {
+      if (*SectionInstance == 0) {
+        *Found = Node;
+        return EFI_SUCCESS;
+      }
+      (*SectionInstance)--;
+    }
+
+    if (Node->Section->Type == EFI_SECTION_COMPRESSION || Node->Section->Type == EFI_SECTION_GUID_DEFINED) {
+      if (EFI_ERROR (Node->DecodeStatus)) {
+        return Node->DecodeStatus;
+      }
+      Status = InternalSectionFind (
+                 Tree,
+                 Node->FirstChild,
+                 Node->ChildCount,
+                 SectionType,
+                 SectionDefinitionGuid,
+                 SectionInstance,
+                 Found
+                 );
+      if (Status != EFI_NOT_FOUND) {
+        return Status;
+      }
+    }
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Opens a section stream and decodes it.
+
+  See EFI_OPEN_SECTION_STREAM for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionOpenSectionStream (
+  IN  EFI_SECTION_EXTRACTION_PROTOCOL  *This,
+  IN  UINTN                            SectionStreamLength,
+  IN  VOID                             *SectionStream,
+  OUT UINTN                            *SectionStreamHandle
+  )
+{
+  EFI_STATUS                   Status;
+  SECTION_EXTRACTION_INSTANCE  *Instance;
+  SECTION_STREAM               *Stream;
+  SECTION_TREE                 *Tree;
+  UINT64                       Hash;
+  UINTN                        First;
+  UINTN                        Index;
+
+  if (SectionStreamHandle == NULL || (SectionStream == NULL && SectionStreamLength != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Instance = SECTION_EXTRACTION_INSTANCE_FROM_THIS (This);
+
+  Stream = AllocateZeroPool (sizeof (SECTION_STREAM));
+  if (Stream == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Hash = InternalSectionHash (SectionStream, SectionStreamLength);
+  Tree = InternalSectionCacheLookup (Instance, SectionStreamLength, SectionStream, Hash);
+  if (Tree != NULL) {
+    Instance->Statistics.CacheHits++;
+    Instance->Statistics.BytesReused += Tree->DecodedSize;
+  } else {
+    Tree = AllocateZeroPool (sizeof (SECTION_TREE));
+    if (Tree == NULL) {
+      FreePool (Stream);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Tree->Signature = SECTION_TREE_SIGNATURE;
+    Tree->Hash      = Hash;
+    if (SectionStreamLength != 0) {
+      Tree->Data = AllocateCopyPool (SectionStreamLength, SectionStream);
+      if (Tree->Data == NULL) {
+        InternalSectionFreeTree (Tree);
+        FreePool (Stream);
+        return EFI_OUT_OF_RESOURCES;
+      }
+    }
+    Tree->DataSize = SectionStreamLength;
+
+    Status = InternalSectionParseStream (Tree, Tree->Data, Tree->DataSize, 0, &First, &Tree->RootCount);
+    if (!EFI_ERROR (Status)) {
+      Status = InternalSectionDecodeStream (Instance, Tree);
+    }
+    if (EFI_ERROR (Status)) {
+      InternalSectionFreeTree (Tree);
+      FreePool (Stream);
+      return (Status == EFI_VOLUME_CORRUPTED) ? EFI_INVALID_PARAMETER : Status;
+    }
+
+    Tree->MemorySize = sizeof (SECTION_TREE) + Tree->DataSize + Tree->NodeCapacity * sizeof (SECTION_NODE);
+    for (Index = 0; Index < Tree->NodeCount; Index++) {
+      if (Tree->Nodes[Index].Buffer != NULL) {
+        Tree->MemorySize += Tree->Nodes[Index].StreamSize;
+      }
+    }
+    InsertHeadList (&Instance->TreeList, &Tree->Link);
+    Instance->CachedBytes += Tree->MemorySize;
+    Instance->Statistics.CacheMisses++;
+    Instance->Statistics.Sections += Tree->NodeCount;
+  }
+
+  Tree->ReferenceCount++;
+  Instance->Statistics.Streams++;
+
+  Stream->Signature = SECTION_STREAM_SIGNATURE;
+  Stream->Tree      = Tree;
+  Stream->Handle    = Instance->NextHandle++;
+  InsertTailList (&Instance->StreamList, &Stream->Link);
+  *SectionStreamHandle = Stream->Handle;
+
+  InternalSectionCacheTrim (Instance);
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns a section of a decoded section stream.
+
+  See EFI_GET_SECTION for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionGetSection (
+  IN EFI_SECTION_EXTRACTION_PROTOCOL  *This,
+  IN UINTN                            SectionStreamHandle,
+  IN EFI_SECTION_TYPE                 *SectionType,
+  IN EFI_GUID                         *SectionDefinitionGuid,
+  IN UINTN                            SectionInstance,
+  IN VOID                             **Buffer,
+  IN OUT UINTN                        *BufferSize,
+  OUT UINT32                          *AuthenticationStatus
+  )
+{
+  EFI_STATUS                   Status;
+  SECTION_EXTRACTION_INSTANCE  *Instance;
+  SECTION_STREAM               *Stream;
+  SECTION_NODE                 *Node;
+  UINT8                        *Data;
+  UINTN                        DataSize;
+  UINTN                        CopySize;
+
+  if (Buffer == NULL || BufferSize == NULL || AuthenticationStatus == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Instance = SECTION_EXTRACTION_INSTANCE_FROM_THIS (This);
+  Instance->Statistics.GetSections++;
+
+  Stream = InternalSectionFindStream (Instance, SectionStreamHandle);
+  if (Stream == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (SectionType == NULL) {
+    Data                  = Stream->Tree->Data;
+    DataSize              = Stream->Tree->DataSize;
+    *AuthenticationStatus = 0;
+  } else {
+    Status = InternalSectionFind (
+               Stream->Tree,
+               0,
+               Stream->Tree->RootCount,
+               *SectionType,
+               SectionDefinitionGuid,
+               &SectionInstance,
+               &Node
+               );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Data                  = (UINT8 *) Node->Section + Node->HeaderSize;
+    DataSize              = Node->Size - Node->HeaderSize;
+    *AuthenticationStatus = Node->AuthenticationStatus;
+  }
+
+  Status = EFI_SUCCESS;
+  if (*Buffer == NULL) {
+    *Buffer = AllocateCopyPool (DataSize, Data);
+    if (*Buffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  } else {
+    CopySize = DataSize;
+    if (*BufferSize < DataSize) {
+      CopySize = *BufferSize;
+      Status   = EFI_WARN_BUFFER_TOO_SMALL;
+    }
+    CopyMem (*Buffer, Data, CopySize);
+  }
+  *BufferSize = DataSize;
+  return Status;
+}
+
+/**
+  Closes a section stream.
+
+  See EFI_CLOSE_SECTION_STREAM for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionCloseSectionStream (
+  IN EFI_SECTION_EXTRACTION_PROTOCOL  *This,
+  IN UINTN                            SectionStreamHandle
+  )
+{
+  SECTION_EXTRACTION_INSTANCE  *Instance;
+  SECTION_STREAM               *Stream;
+
+  Instance = SECTION_EXTRACTION_INSTANCE_FROM_THIS (This);
+  Stream   = InternalSectionFindStream (Instance, SectionStreamHandle);
+  if (Stream == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  RemoveEntryList (&Stream->Link);
+  Stream->Tree->ReferenceCount--;
+  FreePool (Stream);
+
+  InternalSectionCacheTrim (Instance);
+  return EFI_SUCCESS;
+}
+
+/**
+  Creates a Section Extraction Protocol instance.
+
+  The handlers that ExtractGuidedSectionLib registers for the GUIDs in ParallelGuids
+  must not call boot services or use global state without locking, because they
+  run on application processors.
+
+  @param  MpServices          The MP Services Protocol used to decode on the
+                              application processors, or NULL to decode on the
+                              calling processor only.
+  @param  ParallelGuidCount   The number of GUIDs in ParallelGuids.
+  @param  ParallelGuids       The GUID-defined sections that may be decoded on
+                              application processors. It may be NULL if
+                              ParallelGuidCount is 0.
+  @param  CacheSize           The memory that the decoded section streams may hold
+                              after they are closed, in bytes, or 0 to free them
+                              when they are closed.
+  @param  SectionExtraction   Returns the protocol instance.
+
+  @retval EFI_SUCCESS             The instance was created.
+  @retval EFI_INVALID_PARAMETER   SectionExtraction is NULL, or ParallelGuids is NULL
+                                  and ParallelGuidCount is not 0.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionCreate (
+  IN  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices         OPTIONAL,
+  IN  UINTN                               ParallelGuidCount,
+  IN  CONST EFI_GUID                      *ParallelGuids      OPTIONAL,
+  IN  UINTN                               CacheSize,
+  OUT EFI_SECTION_EXTRACTION_PROTOCOL     **SectionExtraction
+  )
+{
+  SECTION_EXTRACTION_INSTANCE  *Instance;
+
+  if (SectionExtraction == NULL || (ParallelGuids == NULL && ParallelGuidCount != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = AllocateZeroPool (sizeof (SECTION_EXTRACTION_INSTANCE));
+  if (Instance == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  if (ParallelGuidCount != 0) {
+    Instance->ParallelGuids = AllocateCopyPool (ParallelGuidCount * sizeof (EFI_GUID), ParallelGuids);
+    if (Instance->ParallelGuids == NULL) {
+      FreePool (Instance);
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Instance->Signature                            = SECTION_EXTRACTION_SIGNATURE;
+  Instance->SectionExtraction.OpenSectionStream  = SectionExtractionOpenSectionStream;
+  Instance->SectionExtraction.GetSection         = SectionExtractionGetSection;
+  Instance->SectionExtraction.CloseSectionStream = SectionExtractionCloseSectionStream;
+  Instance->MpServices                           = MpServices;
+  Instance->ParallelGuidCount                    = ParallelGuidCount;
+  Instance->NextHandle                           = 1;
+  Instance->CacheSize                            = CacheSize;
+  InitializeListHead (&Instance->StreamList);
+  InitializeListHead (&Instance->TreeList);
+
+  *SectionExtraction = &Instance->SectionExtraction;
+  return EFI_SUCCESS;
+}
+
+/**
+  Closes all the section streams of an instance created by SectionExtractionCreate()
+  and frees the instance.
+
+  The caller must uninstall the protocol first.
+
+  @param  SectionExtraction   The protocol instance.
+
+**/
+VOID
+EFIAPI
+SectionExtractionDestroy (
+  IN EFI_SECTION_EXTRACTION_PROTOCOL  *SectionExtraction
+  )
+{
+  SECTION_EXTRACTION_INSTANCE  *Instance;
+  SECTION_STREAM               *Stream;
+  SECTION_TREE                 *Tree;
+
+  Instance = SECTION_EXTRACTION_INSTANCE_FROM_THIS (SectionExtraction);
+  while (!IsListEmpty (&Instance->StreamList)) {
+    Stream = SECTION_STREAM_FROM_LINK (GetFirstNode (&Instance->StreamList));
+    RemoveEntryList (&Stream->Link);
+    FreePool (Stream);
+  }
+  while (!IsListEmpty (&Instance->TreeList)) {
+    Tree = SECTION_TREE_FROM_LINK (GetFirstNode (&Instance->TreeList));
+    RemoveEntryList (&Tree->Link);
+    InternalSectionFreeTree (Tree);
+  }
+
+  if (Instance->ParallelGuids != NULL) {
+    FreePool (Instance->ParallelGuids);
+  }
+  Instance->Signature = 0;
+  FreePool (Instance);
+}
+
+/**
+  Returns the counters of an instance created by SectionExtractionCreate().
+
+  @param  SectionExtraction   The protocol instance.
+  @param  Statistics          Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   SectionExtraction was not created by this library,
+                                  or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionGetStatistics (
+  IN  EFI_SECTION_EXTRACTION_PROTOCOL  *SectionExtraction,
+  OUT SECTION_EXTRACTION_STATISTICS    *Statistics
+  )
+{
+  SECTION_EXTRACTION_INSTANCE  *Instance;
+
+  if (SectionExtraction == NULL || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = BASE_CR (SectionExtraction, SECTION_EXTRACTION_INSTANCE, SectionExtraction);
+  if (Instance->Signature != SECTION_EXTRACTION_SIGNATURE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Statistics, &Instance->Statistics, sizeof (SECTION_EXTRACTION_STATISTICS));
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,296 @@
+/** @file
+  Internal definitions of the section extraction library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SECTION_EXTRACTION_INTERNAL_H_
+#define _SECTION_EXTRACTION_INTERNAL_H_
+
+#include <FrameworkDxe.h>
+
+#include <Protocol/SectionExtraction.h>
+#include <Protocol/FrameworkMpService.h>
+
+#include <Library/SectionExtractionLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiDecompressLib.h>
+#include <Library/ExtractGuidedSectionLib.h>
+
+#define SECTION_EXTRACTION_SIGNATURE  SIGNATURE_32 ('S', 'X', 'T', 'R')
+#define SECTION_STREAM_SIGNATURE      SIGNATURE_32 ('S', 'X', 'S', 'S')
+#define SECTION_TREE_SIGNATURE        SIGNATURE_32 ('S', 'X', 'T', 'E')
+
+//
+// Limits of the decoding of one section stream. The encapsulation sections nested
+// deeper are not decoded, and fail with EFI_VOLUME_CORRUPTED, and those that would
+// take the decoded streams beyond the size fail with EFI_OUT_OF_RESOURCES.
+//
+#define SECTION_MAX_NESTING_DEPTH     16
+#define SECTION_MAX_DECODED_SIZE      SIZE_256MB
+
+///
+/// A section of a stream. The children of an encapsulation section are consecutive
+/// nodes, so the nodes form a tree that is searched depth first.
+///
+typedef struct {
+  EFI_COMMON_SECTION_HEADER  *Section;
+  UINT32                     Size;                  ///< Size of the section.
+  UINT32                     HeaderSize;            ///< Size of the common section header.
+  UINT32                     AuthenticationStatus;  ///< Returned with the section contents.
+  ///
+  /// The following fields are used by encapsulation sections only.
+  ///
+  EFI_STATUS                 DecodeStatus;          ///< Error returned when the search reaches the section.
+  VOID                       *Buffer;               ///< Allocated buffer of the decoded stream.
+  UINT8                      *Stream;               ///< Decoded stream.
+  UINTN                      StreamSize;
+  UINT32                     StreamAuthenticationStatus;
+  UINTN                      FirstChild;
+  UINTN                      ChildCount;
+} SECTION_NODE;
+
+///
+/// The decoded sections of a section stream. Trees are shared by the open streams
+/// with the same contents, and kept in the cache after the last one is closed.
+///
+typedef struct {
+  UINT32          Signature;              ///< SECTION_TREE_SIGNATURE.
+  LIST_ENTRY      Link;                   ///< Link in the cache, most recently used first.
+  UINT64          Hash;                   ///< Hash of the section stream.
+  UINTN           ReferenceCount;         ///< Number of open streams using the tree.
+  UINTN           MemorySize;             ///< Memory held by the tree.
+  UINT64          DecodedSize;            ///< Bytes of the decoded streams of the tree.
+  UINT8           *Data;                  ///< Copy of the section stream.
+  UINTN           DataSize;
+  SECTION_NODE    *Nodes;
+  UINTN           NodeCount;
+  UINTN           NodeCapacity;
+  UINTN           RootCount;              ///< The sections of the stream are the first nodes.
+} SECTION_TREE;
+
+#define SECTION_TREE_FROM_LINK(a) \
+  CR (a, SECTION_TREE, Link, SECTION_TREE_SIGNATURE)
+
+typedef struct {
+  UINT32          Signature;              ///< SECTION_STREAM_SIGNATURE.
+  LIST_ENTRY      Link;
+  UINTN           Handle;
+  SECTION_TREE    *Tree;
+} SECTION_STREAM;
+
+#define SECTION_STREAM_FROM_LINK(a) \
+  CR (a, SECTION_STREAM, Link, SECTION_STREAM_SIGNATURE)
+
+typedef struct {
+  UINT32                              Signature;        ///< SECTION_EXTRACTION_SIGNATURE.
+  EFI_SECTION_EXTRACTION_PROTOCOL     SectionExtraction;
+  FRAMEWORK_EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  EFI_GUID                            *ParallelGuids;
+  UINTN                               ParallelGuidCount;
+  LIST_ENTRY                          StreamList;
+  UINTN                               NextHandle;
+  LIST_ENTRY                          TreeList;         ///< The cached trees, most recently used first.
+  UINTN                               CacheSize;        ///< Limit of the memory held by the cached trees.
+  UINTN                               CachedBytes;      ///< Memory held by all the trees.
+  SECTION_EXTRACTION_STATISTICS       Statistics;
+} SECTION_EXTRACTION_INSTANCE;
+
+#define SECTION_EXTRACTION_INSTANCE_FROM_THIS(a) \
+  CR (a, SECTION_EXTRACTION_INSTANCE, SectionExtraction, SECTION_EXTRACTION_SIGNATURE)
+
+///
+/// The decoding of one encapsulation section. Everything it needs is allocated
+/// before it is dispatched, so that it runs without boot services.
+///
+typedef struct {
+  UINTN                      Node;
+  CONST VOID                 *Section;
+  BOOLEAN                    Guided;
+  BOOLEAN                    Parallel;              ///< May run on an application processor.
+  UINT16                     Attributes;            ///< Attributes of a GUID-defined section.
+  CONST VOID                 *Source;               ///< Compressed data of a compression section.
+  UINT32                     SourceSize;
+  VOID                       *Output;
+  UINT32                     OutputSize;
+  VOID                       *Scratch;
+  ///
+  /// Results.
+  ///
+  EFI_STATUS                 Status;
+  VOID                       *Stream;
+  UINT32                     AuthenticationStatus;
+  BOOLEAN                    OnAp;
+} SECTION_DECODE_WORK;
+
+///
+/// Work shared by the processors, which claim the next item in turn.
+///
+typedef struct {
+  SECTION_DECODE_WORK        *Work;
+  UINT32                     Count;
+  volatile UINT32            Next;
+} SECTION_DECODE_QUEUE;
+
+/**
+  Parses the sections of a stream, and appends them as nodes.
+
+  @param  Tree                  The section tree.
+  @param  Data                  The sections.
+  @param  Size                  The size of the sections.
+  @param  AuthenticationStatus  The authentication status of the sections.
+  @param  FirstChild            Returns the index of the first node.
+  @param  ChildCount            Returns the number of nodes.
+
+  @retval EFI_SUCCESS             The sections were appended.
+  @retval EFI_VOLUME_CORRUPTED    The sections are not well formed. No node is appended.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalSectionParseStream (
+  IN OUT SECTION_TREE    *Tree,
+  IN     UINT8           *Data,
+  IN     UINTN           Size,
+  IN     UINT32          AuthenticationStatus,
+  OUT    UINTN           *FirstChild,
+  OUT    UINTN           *ChildCount
+  );
+
+/**
+  Decodes all the encapsulation sections of a stream, one nesting level at a time.
+
+  The encapsulation sections nested deeper than SECTION_MAX_NESTING_DEPTH levels are
+  not decoded, and record EFI_VOLUME_CORRUPTED in their node.
+
+  @param  Instance    The section extraction instance.
+  @param  Tree        The section tree, whose sections are parsed.
+
+  @retval EFI_SUCCESS             The sections were decoded. The decoding errors of
+                                  single sections are recorded in their nodes.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalSectionDecodeStream (
+  IN OUT SECTION_EXTRACTION_INSTANCE  *Instance,
+  IN OUT SECTION_TREE                 *Tree
+  );
+
+/**
+  Frees a section tree and its decoded streams.
+
+  @param  Tree      The section tree.
+
+**/
+VOID
+InternalSectionFreeTree (
+  IN SECTION_TREE  *Tree
+  );
+
+/**
+  Finds the cached tree of a section stream.
+
+  @param  Instance              The section extraction instance.
+  @param  SectionStreamLength   The size of the section stream.
+  @param  SectionStream         The section stream.
+  @param  Hash                  The hash of the section stream.
+
+  @return The tree, or NULL if the section stream is not cached.
+
+**/
+SECTION_TREE *
+InternalSectionCacheLookup (
+  IN SECTION_EXTRACTION_INSTANCE  *Instance,
+  IN UINTN                        SectionStreamLength,
+  IN CONST VOID                   *SectionStream,
+  IN UINT64                       Hash
+  );
+
+/**
+  Frees the least recently used trees that no stream uses, until the cached trees
+  fit in the cache size.
+
+  @param  Instance    The section extraction instance.
+
+**/
+VOID
+InternalSectionCacheTrim (
+  IN OUT SECTION_EXTRACTION_INSTANCE  *Instance
+  );
+
+/**
+  Computes the hash of a section stream.
+
+  @param  Data    The section stream.
+  @param  Size    The size of the section stream.
+
+  @return The hash.
+
+**/
+UINT64
+InternalSectionHash (
+  IN CONST UINT8  *Data,
+  IN UINTN        Size
+  );
+
+/**
+  Opens a section stream and decodes it.
+
+  See EFI_OPEN_SECTION_STREAM for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionOpenSectionStream (
+  IN  EFI_SECTION_EXTRACTION_PROTOCOL  *This,
+  IN  UINTN                            SectionStreamLength,
+  IN  VOID                             *SectionStream,
+  OUT UINTN                            *SectionStreamHandle
+  );
+
+/**
+  Returns a section of a decoded section stream.
+
+  See EFI_GET_SECTION for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionGetSection (
+  IN EFI_SECTION_EXTRACTION_PROTOCOL  *This,
+  IN UINTN                            SectionStreamHandle,
+  IN EFI_SECTION_TYPE                 *SectionType,
+  IN EFI_GUID                         *SectionDefinitionGuid,
+  IN UINTN                            SectionInstance,
+  IN VOID                             **Buffer,
+  IN OUT UINTN                        *BufferSize,
+  OUT UINT32                          *AuthenticationStatus
+  );
+
+/**
+  Closes a section stream.
+
+  See EFI_CLOSE_SECTION_STREAM for the parameters and return values.
+
+**/
+EFI_STATUS
+EFIAPI
+SectionExtractionCloseSectionStream (
+  IN EFI_SECTION_EXTRACTION_PROTOCOL  *This,
+  IN UINTN                            SectionStreamHandle
+  );
+
+#endif
@@ -0,0 +1,670 @@
+/** @file
+  Parsing and decoding of section streams.
+
+  A stream is decoded one nesting level at a time. The encapsulation sections of a
+  level are independent, so the decoding of a level is a set of work items that the
+  processors claim in turn. Each item writes only its own results, and the children
+  of the decoded sections are parsed afterwards in section order, so the resulting
+  tree does not depend on which processor decoded which section.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SectionExtractionInternal.h"
+
+/**
+  Appends a node to a section tree.
+
+  @param  Tree      The section tree.
+
+  @return The index of the node, or MAX_UINTN if memory could not be allocated.
+
+**/
+UINTN
+InternalSectionAddNode (
+  IN OUT SECTION_TREE    *Tree
+  )
+{
+  SECTION_NODE  *Nodes;
+  UINTN         Capacity;
+
+  if (Tree->NodeCount == Tree->NodeCapacity) {
+    Capacity = MAX (Tree->NodeCapacity * 2, 16);
+    Nodes    = ReallocatePool (
+                 Tree->NodeCapacity * sizeof (SECTION_NODE),
+                 Capacity * sizeof (SECTION_NODE),
+                 Tree->Nodes
+                 );
+    if (Nodes == NULL) {
+      return MAX_UINTN;
+    }
+    Tree->Nodes        = Nodes;
+    Tree->NodeCapacity = Capacity;
+  }
+
+  ZeroMem (&Tree->Nodes[Tree->NodeCount], sizeof (SECTION_NODE));
+  return Tree->NodeCount++;
+}
+
+/**
+  Parses the sections of a stream, and appends them as nodes.
+
+  @param  Tree                  The section tree.
+  @param  Data                  The sections.
+  @param  Size                  The size of the sections.
+  @param  AuthenticationStatus  The authentication status of the sections.
+  @param  FirstChild            Returns the index of the first node.
+  @param  ChildCount            Returns the number of nodes.
+
+  @retval EFI_SUCCESS             The sections were appended.
+  @retval EFI_VOLUME_CORRUPTED    The sections are not well formed. No node is appended.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalSectionParseStream (
+  IN OUT SECTION_TREE    *Tree,
+  IN     UINT8           *Data,
+  IN     UINTN           Size,
+  IN     UINT32          AuthenticationStatus,
+  OUT    UINTN           *FirstChild,
+  OUT    UINTN           *ChildCount
+  )
+{
+  EFI_COMMON_SECTION_HEADER  *Section;
+  SECTION_NODE               *Node;
+  UINTN                      First;
+  UINTN                      Offset;
+  UINTN                      Index;
+  UINT32                     SectionSize;
+  UINT32                     HeaderSize;
+
+  First  = Tree->NodeCount;
+  Offset = 0;
+  while (Offset < Size) {
+    if (Size - Offset < sizeof (EFI_COMMON_SECTION_HEADER)) {
+      goto Corrupted;
+    }
+    Section = (EFI_COMMON_SECTION_HEADER *) (Data + Offset);
+    if (IS_SECTION2 (Section)) {
+      if (Size - Offset < sizeof (EFI_COMMON_SECTION_HEADER2)) {
+        goto Corrupted;
+      }
+      SectionSize = SECTION2_SIZE (Section);
+      HeaderSize  = sizeof (EFI_COMMON_SECTION_HEADER2);
+    } else {
+      SectionSize = SECTION_SIZE (Section);
+      HeaderSize  = sizeof (EFI_COMMON_SECTION_HEADER);
+    }
+    if (SectionSize < HeaderSize || SectionSize > Size - Offset) {
+      goto Corrupted;
+    }
+
+    Index = InternalSectionAddNode (Tree);
+    if (Index == MAX_UINTN) {
+      Tree->NodeCount = First;
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Node                       = &Tree->Nodes[Index];
+    Node->Section              = Section;
+    Node->Size                 = SectionSize;
+    Node->HeaderSize           = HeaderSize;
+    Node->AuthenticationStatus = AuthenticationStatus;
+
+    //
+    // Sections are 4-byte aligned within a stream.
+    //
+    Offset += ALIGN_VALUE (SectionSize, 4);
+  }
+
+  *FirstChild = First;
+  *ChildCount = Tree->NodeCount - First;
+  return EFI_SUCCESS;
+
+Corrupted:
+  Tree->NodeCount = First;
+  return EFI_VOLUME_CORRUPTED;
+}
+
+/**
+  Returns whether a GUID-defined section may be decoded on an application processor.
+
+  @param  Instance    The section extraction instance.
+  @param  Guid        The section definition GUID.
+
+  @retval TRUE    The section may be decoded on an application processor.
+  @retval FALSE   The section must be decoded on the calling processor.
+
+**/
+BOOLEAN
+InternalSectionIsParallelGuid (
+  IN SECTION_EXTRACTION_INSTANCE  *Instance,
+  IN CONST EFI_GUID               *Guid
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Instance->ParallelGuidCount; Index++) {
+    if (CompareGuid (&Instance->ParallelGuids[Index], Guid)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/**
+  Accounts for the decoded stream of an encapsulation section.
+
+  @param  Tree      The section tree.
+  @param  Node      The encapsulation section.
+  @param  Size      The size of the decoded stream.
+
+  @retval TRUE    The decoded streams of the tree stay within SECTION_MAX_DECODED_SIZE.
+  @retval FALSE   The section is not to be decoded. EFI_OUT_OF_RESOURCES is recorded
+                  in its node.
+
+**/
+BOOLEAN
+InternalSectionReserveDecodedSize (
+  IN OUT SECTION_TREE  *Tree,
+  IN OUT SECTION_NODE  *Node,
+  IN     UINT64        Size
+  )
+{
+  if (Size > SECTION_MAX_DECODED_SIZE - Tree->DecodedSize) {
+    DEBUG ((DEBUG_ERROR, "SectionExtractionLib: decoded streams beyond 0x%lx bytes\n", (UINT64) SECTION_MAX_DECODED_SIZE));
+    Node->DecodeStatus = EFI_OUT_OF_RESOURCES;
+    return FALSE;
+  }
+
+  Tree->DecodedSize += Size;
+  return TRUE;
+}
+
+/**
+  Prepares the decoding of an encapsulation section.
+
+  Sections whose contents need no decoding are copied to their decoded stream at
+  once. Sections that cannot be decoded, or whose decoded stream would take the tree
+  beyond SECTION_MAX_DECODED_SIZE, record the error in their node.
+
+  @param  Instance    The section extraction instance.
+  @param  Tree        The section tree.
+  @param  NodeIndex   The encapsulation section.
+  @param  Work        Returns the decoding to run.
+
+  @retval TRUE    Work must be run to decode the section.
+  @retval FALSE   The section was handled.
+
+**/
+BOOLEAN
+InternalSectionPrepareDecode (
+  IN     SECTION_EXTRACTION_INSTANCE  *Instance,
+  IN OUT SECTION_TREE                 *Tree,
+  IN     UINTN                        NodeIndex,
+  OUT    SECTION_DECODE_WORK          *Work
+  )
+{
+  SECTION_NODE                *Node;
+  EFI_COMPRESSION_SECTION     *Compression;
+  EFI_GUID_DEFINED_SECTION    *Guided;
+  UINTN                       FixedSize;
+  UINT32                      UncompressedLength;
+  UINT8                       CompressionType;
+  EFI_GUID                    *Guid;
+  UINT16                      DataOffset;
+  UINT16                      Attributes;
+  UINT32                      ScratchSize;
+  UINT16                      SectionAttribute;
+  RETURN_STATUS               Status;
+  UINT8                       *Data;
+  UINTN                       DataSize;
+
+  Node = &Tree->Nodes[NodeIndex];
+  Node->StreamAuthenticationStatus = Node->AuthenticationStatus;
+  ZeroMem (Work, sizeof (SECTION_DECODE_WORK));
+  Work->Node    = NodeIndex;
+  Work->Section = Node->Section;
+
+  if (Node->Section->Type == EFI_SECTION_COMPRESSION) {
+    Compression = (EFI_COMPRESSION_SECTION *) Node->Section;
+    FixedSize = (Node->HeaderSize == sizeof (EFI_COMMON_SECTION_HEADER2)) ?
+                sizeof (EFI_COMPRESSION_SECTION2) : sizeof (EFI_COMPRESSION_SECTION);
+    if (Node->Size < FixedSize) {
+      Node->DecodeStatus = EFI_NOT_FOUND;
+      return FALSE;
+    }
+    if (Node->HeaderSize == sizeof (EFI_COMMON_SECTION_HEADER2)) {
+      UncompressedLength = ((EFI_COMPRESSION_SECTION2 *) Compression)->UncompressedLength;
+      CompressionType    = ((EFI_COMPRESSION_SECTION2 *) Compression)->CompressionType;
+    } else {
+      UncompressedLength = Compression->UncompressedLength;
+      CompressionType    = Compression->CompressionType;
+    }
+    Data     = (UINT8 *) Compression + FixedSize;
+    DataSize = Node->Size - FixedSize;
+
+    if (CompressionType == EFI_NOT_COMPRESSED) {
+      if (UncompressedLength > DataSize) {
+        Node->DecodeStatus = EFI_NOT_FOUND;
+        return FALSE;
+      }
+      if (!InternalSectionReserveDecodedSize (Tree, Node, UncompressedLength)) {
+        return FALSE;
+      }
+      Data = AllocateCopyPool (UncompressedLength, Data);
+      if (Data == NULL && UncompressedLength != 0) {
+        Tree->DecodedSize -= UncompressedLength;
+        Node->DecodeStatus = EFI_OUT_OF_RESOURCES;
+        return FALSE;
+      }
+      Node->Buffer     = Data;
+      Node->Stream     = Data;
+      Node->StreamSize = UncompressedLength;
+      return FALSE;
+    }
+    if (CompressionType != EFI_STANDARD_COMPRESSION) {
+      Node->DecodeStatus = EFI_UNSUPPORTED;
+      return FALSE;
+    }
+
+    Status = UefiDecompressGetInfo (Data, (UINT32) DataSize, &Work->OutputSize, &ScratchSize);
+    if (RETURN_ERROR (Status) || Work->OutputSize != UncompressedLength) {
+      Node->DecodeStatus = EFI_NOT_FOUND;
+      return FALSE;
+    }
+    Work->Source     = Data;
+    Work->SourceSize = (UINT32) DataSize;
+    Work->Parallel   = TRUE;
+  } else {
+    Guided = (EFI_GUID_DEFINED_SECTION *) Node->Section;
+    FixedSize = (Node->HeaderSize == sizeof (EFI_COMMON_SECTION_HEADER2)) ?
+                sizeof (EFI_GUID_DEFINED_SECTION2) : sizeof (EFI_GUID_DEFINED_SECTION);
+    if (Node->Size < FixedSize) {
+      Node->DecodeStatus = EFI_NOT_FOUND;
+      return FALSE;
+    }
+    if (Node->HeaderSize == sizeof (EFI_COMMON_SECTION_HEADER2)) {
+      Guid       = &((EFI_GUID_DEFINED_SECTION2 *) Guided)->SectionDefinitionGuid;
+      DataOffset = ((EFI_GUID_DEFINED_SECTION2 *) Guided)->DataOffset;
+      Attributes = ((EFI_GUID_DEFINED_SECTION2 *) Guided)->Attributes;
+    } else {
+      Guid       = &Guided->SectionDefinitionGuid;
+      DataOffset = Guided->DataOffset;
+      Attributes = Guided->Attributes;
+    }
+    if (DataOffset < FixedSize || DataOffset > Node->Size) {
+      Node->DecodeStatus = EFI_NOT_FOUND;
+      return FALSE;
+    }
+
+    if ((Attributes & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) == 0) {
+      //
+      // The contents follow the header as they are. There is no handler to verify
+      // them, so the authentication status only says that they were not tested.
+      //
+      if ((Attributes & EFI_GUIDED_SECTION_AUTH_STATUS_VALID) != 0) {
+        Node->StreamAuthenticationStatus |= EFI_AUTH_STATUS_IMAGE_SIGNED | EFI_AUTH_STATUS_NOT_TESTED;
+      }
+      DataSize = Node->Size - DataOffset;
+      if (!InternalSectionReserveDecodedSize (Tree, Node, DataSize)) {
+        return FALSE;
+      }
+      Data = AllocateCopyPool (DataSize, (UINT8 *) Guided + DataOffset);
+      if (Data == NULL && DataSize != 0) {
+        Tree->DecodedSize -= DataSize;
+        Node->DecodeStatus = EFI_OUT_OF_RESOURCES;
+        return FALSE;
+      }
+      Node->Buffer     = Data;
+      Node->Stream     = Data;
+      Node->StreamSize = DataSize;
+      return FALSE;
+    }
+
+    Status = ExtractGuidedSectionGetInfo (Guided, &Work->OutputSize, &ScratchSize, &SectionAttribute);
+    if (RETURN_ERROR (Status)) {
+      Node->DecodeStatus = EFI_PROTOCOL_ERROR;
+      return FALSE;
+    }
+    Work->Guided     = TRUE;
+    Work->Attributes = Attributes;
+    Work->Parallel   = InternalSectionIsParallelGuid (Instance, Guid);
+  }
+
+  if (!InternalSectionReserveDecodedSize (Tree, Node, Work->OutputSize)) {
+    return FALSE;
+  }
+
+  //
+  // Allocate everything here, as the decoding may run where boot services cannot.
+  //
+  if (Work->OutputSize != 0) {
+    Work->Output = AllocatePool (Work->OutputSize);
+  }
+  if (ScratchSize != 0) {
+    Work->Scratch = AllocatePool (ScratchSize);
+  }
+  if ((Work->Output == NULL && Work->OutputSize != 0) || (Work->Scratch == NULL && ScratchSize != 0)) {
+    if (Work->Output != NULL) {
+      FreePool (Work->Output);
+    }
+    if (Work->Scratch != NULL) {
+      FreePool (Work->Scratch);
+    }
+    Tree->DecodedSize -= Work->OutputSize;
+    Node->DecodeStatus = EFI_OUT_OF_RESOURCES;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+  Decodes an encapsulation section. It uses no boot services.
+
+  @param  Work    The decoding.
+
+**/
+VOID
+InternalSectionRunDecode (
+  IN OUT SECTION_DECODE_WORK  *Work
+  )
+{
+  VOID  *Output;
+
+  if (Work->Guided) {
+    Output       = Work->Output;
+    Work->Status = ExtractGuidedSectionDecode (Work->Section, &Output, Work->Scratch, &Work->AuthenticationStatus);
+    Work->Stream = Output;
+  } else {
+    Work->Status = UefiDecompress (Work->Source, Work->Output, Work->Scratch);
+    Work->Stream = Work->Output;
+  }
+}
+
+/**
+  Claims and runs the items of a decoding queue until none is left.
+
+  @param  Queue   The decoding queue.
+  @param  OnAp    The calling processor is an application processor.
+
+**/
+VOID
+InternalSectionRunQueue (
+  IN OUT SECTION_DECODE_QUEUE  *Queue,
+  IN     BOOLEAN               OnAp
+  )
+{
+  UINT32  Index;
+
+  for (;;) {
+    Index = InterlockedIncrement (&Queue->Next) - 1;
+    if (Index >= Queue->Count) {
+      break;
+    }
+    InternalSectionRunDecode (&Queue->Work[Index]);
+    Queue->Work[Index].OnAp = OnAp;
+  }
+}
+
+/**
+  The procedure that the application processors run.
+
+  @param  Buffer    The decoding queue.
+
+**/
+VOID
+EFIAPI
+InternalSectionApProcedure (
+  IN VOID  *Buffer
+  )
+{
+  InternalSectionRunQueue ((SECTION_DECODE_QUEUE *) Buffer, TRUE);
+}
+
+/**
+  Decodes the encapsulation sections of a nesting level.
+
+  The items that may run on application processors come first in Work.
+
+  @param  Instance        The section extraction instance.
+  @param  Work            The decodings.
+  @param  Count           The number of decodings.
+  @param  ParallelCount   The number of decodings that may run on application
+                          processors.
+
+**/
+VOID
+InternalSectionDecodeLevel (
+  IN OUT SECTION_EXTRACTION_INSTANCE  *Instance,
+  IN OUT SECTION_DECODE_WORK          *Work,
+  IN     UINTN                        Count,
+  IN     UINTN                        ParallelCount
+  )
+{
+  SECTION_DECODE_QUEUE  Queue;
+  EFI_STATUS            Status;
+  UINTN                 Index;
+
+  for (Index = ParallelCount; Index < Count; Index++) {
+    InternalSectionRunDecode (&Work[Index]);
+  }
+
+  Queue.Work  = Work;
+  Queue.Count = (UINT32) ParallelCount;
+  Queue.Next  = 0;
+
+  //
+  // StartupAllAPs() blocks until the application processors are done. A single
+  // decoding is not worth the dispatch. The calling processor runs whatever is
+  // left afterwards, which is everything when there are no application processors.
+  //
+  if (Instance->MpServices != NULL && ParallelCount > 1) {
+    Status = Instance->MpServices->StartupAllAPs (
+                                     Instance->MpServices,
+                                     InternalSectionApProcedure,
+                                     FALSE,
+                                     NULL,
+                                     0,
+                                     &Queue,
+                                     NULL
+                                     );
+    if (!EFI_ERROR (Status)) {
+      Instance->Statistics.Dispatches++;
+    } else {
+      DEBUG ((DEBUG_WARN, "SectionExtractionLib: StartupAllAPs() failed - %r\n", Status));
+    }
+  }
+  InternalSectionRunQueue (&Queue, FALSE);
+}
+
+/**
+  Decodes all the encapsulation sections of a stream, one nesting level at a time.
+
+  The encapsulation sections nested deeper than SECTION_MAX_NESTING_DEPTH levels are
+  not decoded, and record EFI_VOLUME_CORRUPTED in their node.
+
+  @param  Instance    The section extraction instance.
+  @param  Tree        The section tree, whose sections are parsed.
+
+  @retval EFI_SUCCESS             The sections were decoded. The decoding errors of
+                                  single sections are recorded in their nodes.
+  @retval EFI_OUT_OF_RESOURCES    Memory could not be allocated.
+
+**/
+EFI_STATUS
+InternalSectionDecodeStream (
+  IN OUT SECTION_EXTRACTION_INSTANCE  *Instance,
+  IN OUT SECTION_TREE                 *Tree
+  )
+{
+  EFI_STATUS           Status;
+  SECTION_DECODE_WORK  *Work;
+  SECTION_DECODE_WORK  Item;
+  SECTION_NODE         *Node;
+  UINTN                LevelStart;
+  UINTN                LevelEnd;
+  UINTN                Index;
+  UINTN                Count;
+  UINTN                ParallelCount;
+  UINTN                Serial;
+  UINTN                FirstChild;
+  UINTN                ChildCount;
+  UINTN                Depth;
+
+  Status     = EFI_SUCCESS;
+  LevelStart = 0;
+  LevelEnd   = Tree->NodeCount;
+  for (Depth = 0; LevelStart < LevelEnd; Depth++) {
+    //
+    // Prepare the decodings of the level. Those that may run on application
+    // processors are stored from the front, the others from the back.
+    //
+    Count = 0;
+    for (Index = LevelStart; Index < LevelEnd; Index++) {
+      if (Tree->Nodes[Index].Section->Type == EFI_SECTION_COMPRESSION ||
+          Tree->Nodes[Index].Section->Type == EFI_SECTION_GUID_DEFINED) {
+        Count++;
+      }
+    }
+    if (Count == 0) {
+      break;
+    }
+    if (Depth == SECTION_MAX_NESTING_DEPTH) {
+      DEBUG ((DEBUG_ERROR, "SectionExtractionLib: sections nested beyond %d levels\n", SECTION_MAX_NESTING_DEPTH));
+      for (Index = LevelStart; Index < LevelEnd; Index++) {
+        if (Tree->Nodes[Index].Section->Type == EFI_SECTION_COMPRESSION ||
+            Tree->Nodes[Index].Section->Type == EFI_SECTION_GUID_DEFINED) {
+          Tree->Nodes[Index].DecodeStatus = EFI_VOLUME_CORRUPTED;
+        }
+      }
+      break;
+    }
+    Work = AllocatePool (Count * sizeof (SECTION_DECODE_WORK));
+    if (Work == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    ParallelCount = 0;
+    Serial        = Count;
+    for (Index = LevelStart; Index < LevelEnd; Index++) {
+      Node = &Tree->Nodes[Index];
+      if (Node->Section->Type != EFI_SECTION_COMPRESSION && Node->Section->Type != EFI_SECTION_GUID_DEFINED) {
+        continue;
+      }
+      if (!InternalSectionPrepareDecode (Instance, Tree, Index, &Item)) {
+        continue;
+      }
+      if (Item.Parallel) {
+        CopyMem (&Work[ParallelCount++], &Item, sizeof (Item));
+      } else {
+        CopyMem (&Work[--Serial], &Item, sizeof (Item));
+      }
+    }
+    CopyMem (&Work[ParallelCount], &Work[Serial], (Count - Serial) * sizeof (SECTION_DECODE_WORK));
+    Count = ParallelCount + Count - Serial;
+
+    InternalSectionDecodeLevel (Instance, Work, Count, ParallelCount);
+
+    //
+    // Collect the results, then free the scratch buffers.
+    //
+    for (Index = 0; Index < Count; Index++) {
+      Node         = &Tree->Nodes[Work[Index].Node];
+      Node->Buffer = Work[Index].Output;
+      if (Work[Index].Scratch != NULL) {
+        FreePool (Work[Index].Scratch);
+      }
+      if (RETURN_ERROR (Work[Index].Status)) {
+        Node->DecodeStatus = Work[Index].Guided ? EFI_PROTOCOL_ERROR : EFI_NOT_FOUND;
+        continue;
+      }
+      Node->Stream     = Work[Index].Stream;
+      Node->StreamSize = Work[Index].OutputSize;
+      if ((Work[Index].Attributes & EFI_GUIDED_SECTION_AUTH_STATUS_VALID) != 0) {
+        Node->StreamAuthenticationStatus |= Work[Index].AuthenticationStatus;
+      }
+      Instance->Statistics.Decodes++;
+      Instance->Statistics.BytesDecoded += Work[Index].OutputSize;
+      if (Work[Index].OnAp) {
+        Instance->Statistics.ApDecodes++;
+      }
+    }
+    FreePool (Work);
+    Instance->Statistics.Levels++;
+
+    //
+    // Parse the decoded streams in section order. Their sections form the next level.
+    //
+    for (Index = LevelStart; Index < LevelEnd; Index++) {
+      Node = &Tree->Nodes[Index];
+      if ((Node->Section->Type != EFI_SECTION_COMPRESSION && Node->Section->Type != EFI_SECTION_GUID_DEFINED) ||
+          EFI_ERROR (Node->DecodeStatus)) {
+        continue;
+      }
+      Status = InternalSectionParseStream (
+                 Tree,
+                 Node->Stream,
+                 Node->StreamSize,
+                 Node->StreamAuthenticationStatus,
+                 &FirstChild,
+                 &ChildCount
+                 );
+      if (Status == EFI_OUT_OF_RESOURCES) {
+        return Status;
+      }
+
+      //
+      // Parsing may have moved the nodes.
+      //
+      Node = &Tree->Nodes[Index];
+      if (EFI_ERROR (Status)) {
+        Node->DecodeStatus = EFI_NOT_FOUND;
+      } else {
+        Node->FirstChild = FirstChild;
+        Node->ChildCount = ChildCount;
+      }
+    }
+
+    LevelStart = LevelEnd;
+    LevelEnd   = Tree->NodeCount;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees a section tree and its decoded streams.
+
+  @param  Tree      The section tree.
+
+**/
+VOID
+InternalSectionFreeTree (
+  IN SECTION_TREE  *Tree
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Tree->NodeCount; Index++) {
+    if (Tree->Nodes[Index].Buffer != NULL) {
+      FreePool (Tree->Nodes[Index].Buffer);
+    }
+  }
+  if (Tree->Nodes != NULL) {
+    FreePool (Tree->Nodes);
+  }
+  if (Tree->Data != NULL) {
+    FreePool (Tree->Data);
+  }
+  FreePool (Tree);
+}
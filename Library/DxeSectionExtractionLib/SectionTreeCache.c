@@ -0,0 +1,119 @@
+/** @file
+  Cache of decoded section trees of the section extraction library.
+
+  Consumers often open the same section stream many times, for example to read the
+  PE32 and the dependency sections of a driver, or the user interface and version
+  sections of every driver. The decoded tree of a stream is therefore kept after the
+  stream is closed, and found again by the hash of the stream contents. The hash
+  selects the candidates, and the contents are compared before a tree is reused.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SectionExtractionInternal.h"
+
+#define SECTION_HASH_OFFSET_BASIS   0xCBF29CE484222325ULL
+#define SECTION_HASH_PRIME          0x00000100000001B3ULL
+
+/**
+  Computes the hash of a section stream.
+
+  The hash is FNV-1a over the bytes of the stream.
+
+  @param  Data    The section stream.
+  @param  Size    The size of the section stream.
+
+  @return The hash.
+
+**/
+UINT64
+InternalSectionHash (
+  IN CONST UINT8  *Data,
+  IN UINTN        Size
+  )
+{
+  UINT64  Hash;
+  UINTN   Index;
+
+  Hash = SECTION_HASH_OFFSET_BASIS;
+  for (Index = 0; Index < Size; Index++) {
+    Hash = MultU64x64 (Hash ^ Data[Index], SECTION_HASH_PRIME);
+  }
+  return Hash;
+}
+
+/**
+  Finds the cached tree of a section stream.
+
+  The tree found becomes the most recently used one.
+
+  @param  Instance              The section extraction instance.
+  @param  SectionStreamLength   The size of the section stream.
+  @param  SectionStream         The section stream.
+  @param  Hash                  The hash of the section stream.
+
+  @return The tree, or NULL if the section stream is not cached.
+
+**/
+SECTION_TREE *
+InternalSectionCacheLookup (
+  IN SECTION_EXTRACTION_INSTANCE  *Instance,
+  IN UINTN                        SectionStreamLength,
+  IN CONST VOID                   *SectionStream,
+  IN UINT64                       Hash
+  )
+{
+  LIST_ENTRY    *Link;
+  SECTION_TREE  *Tree;
+
+  for (Link = GetFirstNode (&Instance->TreeList); !IsNull (&Instance->TreeList, Link); Link = GetNextNode (&Instance->TreeList, Link)) {
+    Tree = SECTION_TREE_FROM_LINK (Link);
+    if (Tree->Hash == Hash && Tree->DataSize == SectionStreamLength &&
+        (SectionStreamLength == 0 || CompareMem (Tree->Data, SectionStream, SectionStreamLength) == 0)) {
+      RemoveEntryList (&Tree->Link);
+      InsertHeadList (&Instance->TreeList, &Tree->Link);
+      return Tree;
+    }
+  }
+  return NULL;
+}
+
+/**
+  Frees the least recently used trees that no stream uses, until the cached trees
+  fit in the cache size.
+
+  @param  Instance    The section extraction instance.
+
+**/
+VOID
+InternalSectionCacheTrim (
+  IN OUT SECTION_EXTRACTION_INSTANCE  *Instance
+  )
+{
+  LIST_ENTRY    *Link;
+  LIST_ENTRY    *Previous;
+  SECTION_TREE  *Tree;
+
+  Link = Instance->TreeList.BackLink;
+  while (Link != &Instance->TreeList && Instance->CachedBytes > Instance->CacheSize) {
+    Previous = Link->BackLink;
+    Tree     = SECTION_TREE_FROM_LINK (Link);
+    if (Tree->ReferenceCount == 0) {
+      RemoveEntryList (&Tree->Link);
+      Instance->CachedBytes -= Tree->MemorySize;
+      Instance->Statistics.Evictions++;
+      Instance->Statistics.EvictedBytes += Tree->MemorySize;
+      InternalSectionFreeTree (Tree);
+    }
+    Link = Previous;
+  }
+  Instance->Statistics.CachedBytes = Instance->CachedBytes;
+}
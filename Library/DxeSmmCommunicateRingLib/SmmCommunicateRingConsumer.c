@@ -0,0 +1,441 @@
+/** @file
+  Functions of the SMM communicate ring library called in SMM.
+
+  The ring is in memory that the code outside SMM may change at any time,
+  including while the SMI is handled on another processor. Every value read from
+  the ring is read once into SMRAM and checked there before it is used: the
+  geometry of the ring when it is opened, and the index, the state, the GUID and
+  the length of every request when it is handled.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmmCommunicateRingInternal.h"
+
+/**
+  Checks that a channel was opened by this library.
+
+  @param  Channel   The channel.
+
+  @retval TRUE    The channel is valid.
+  @retval FALSE   The channel is NULL or was not opened by this library.
+
+**/
+BOOLEAN
+InternalSmmCommRingChannelIsValid (
+  IN SMM_COMM_RING_CHANNEL  *Channel
+  )
+{
+  return (BOOLEAN) (Channel != NULL && Channel->Signature == SMM_COMM_RING_CHANNEL_SIGNATURE);
+}
+
+/**
+  Checks that a buffer is outside SMRAM.
+
+  @param  SmramRanges       The SMRAM ranges.
+  @param  SmramRangeCount   The number of SMRAM ranges.
+  @param  Buffer            The address of the buffer.
+  @param  Size              The size of the buffer.
+
+  @retval TRUE    The buffer is outside SMRAM.
+  @retval FALSE   The buffer is empty, overlaps SMRAM or the end of the address
+                  space.
+
+**/
+BOOLEAN
+InternalSmmCommRingIsOutsideSmram (
+  IN CONST EFI_SMRAM_DESCRIPTOR  *SmramRanges,
+  IN UINTN                       SmramRangeCount,
+  IN EFI_PHYSICAL_ADDRESS        Buffer,
+  IN UINT64                      Size
+  )
+{
+  UINTN  Index;
+
+  if (Size == 0 || Buffer > MAX_ADDRESS || Size - 1 > MAX_ADDRESS - Buffer) {
+    return FALSE;
+  }
+  for (Index = 0; Index < SmramRangeCount; Index++) {
+    if (Buffer < SmramRanges[Index].CpuStart + SmramRanges[Index].PhysicalSize &&
+        SmramRanges[Index].CpuStart < Buffer + Size) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+  Finds the handler of a GUID.
+
+  @param  Channel       The channel.
+  @param  HeaderGuid    The GUID.
+
+  @return The handler, or NULL if none is registered for the GUID.
+
+**/
+SMM_COMM_RING_ENTRY *
+InternalSmmCommRingFindHandler (
+  IN SMM_COMM_RING_CHANNEL  *Channel,
+  IN CONST EFI_GUID         *HeaderGuid
+  )
+{
+  UINTN  Index;
+
+  //
+  // The requests of a batch often go to the same handler.
+  //
+  if (Channel->LastHandler < Channel->HandlerCount &&
+      CompareGuid (&Channel->Handlers[Channel->LastHandler].HeaderGuid, HeaderGuid)) {
+    return &Channel->Handlers[Channel->LastHandler];
+  }
+  for (Index = 0; Index < Channel->HandlerCount; Index++) {
+    if (CompareGuid (&Channel->Handlers[Index].HeaderGuid, HeaderGuid)) {
+      Channel->LastHandler = Index;
+      return &Channel->Handlers[Index];
+    }
+  }
+  return NULL;
+}
+
+/**
+  Opens a ring initialized outside SMM, in SMM.
+
+  @param  Smst              The SMM System Table, whose SmmAllocatePool() allocates
+                            the channel.
+  @param  Ring              The address of the ring.
+  @param  RingSize          The size of the ring.
+  @param  SmramRanges       The SMRAM ranges, that the ring and the doorbell
+                            messages must not overlap. They are copied into the
+                            channel.
+  @param  SmramRangeCount   The number of SMRAM ranges.
+  @param  Channel           Returns the channel.
+
+  @retval EFI_SUCCESS             The channel was opened.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, the ring overlaps SMRAM or
+                                  the end of the address space, or its header is
+                                  not valid or describes more than RingSize bytes.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingOpen (
+  IN  EFI_SMM_SYSTEM_TABLE        *Smst,
+  IN  EFI_PHYSICAL_ADDRESS        Ring,
+  IN  UINTN                       RingSize,
+  IN  CONST EFI_SMRAM_DESCRIPTOR  *SmramRanges,
+  IN  UINTN                       SmramRangeCount,
+  OUT SMM_COMM_RING_CHANNEL       **Channel
+  )
+{
+  EFI_STATUS                   Status;
+  SMM_COMMUNICATE_RING_HEADER  Header;
+  SMM_COMM_RING_CHANNEL        *Instance;
+  EFI_SMRAM_DESCRIPTOR         *Ranges;
+  UINTN                        MaxLength;
+
+  if (Smst == NULL || Channel == NULL || (SmramRanges == NULL && SmramRangeCount != 0) ||
+      SmramRangeCount > MAX_UINTN / sizeof (EFI_SMRAM_DESCRIPTOR) ||
+      Ring == 0 || (Ring & 7) != 0 || RingSize < sizeof (SMM_COMMUNICATE_RING_HEADER) ||
+      !InternalSmmCommRingIsOutsideSmram (SmramRanges, SmramRangeCount, Ring, RingSize)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The geometry is read once, and kept in SMRAM once checked.
+  //
+  CopyMem (&Header, (VOID *) (UINTN) Ring, sizeof (Header));
+  if (Header.Signature != SMM_COMMUNICATE_RING_SIGNATURE ||
+      Header.SlotCount < 2 || (Header.SlotCount & (Header.SlotCount - 1)) != 0 ||
+      (Header.SlotSize & 7) != 0 || Header.SlotSize <= sizeof (SMM_COMMUNICATE_RING_SLOT) ||
+      Header.SlotCount > (RingSize - sizeof (SMM_COMMUNICATE_RING_HEADER)) / Header.SlotSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+  MaxLength = Header.SlotSize - sizeof (SMM_COMMUNICATE_RING_SLOT);
+
+  Status = Smst->SmmAllocatePool (
+                   EfiRuntimeServicesData,
+                   OFFSET_OF (SMM_COMM_RING_CHANNEL, Scratch) + MaxLength,
+                   (VOID **) &Instance
+                   );
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Ranges = NULL;
+  if (SmramRangeCount != 0) {
+    Status = Smst->SmmAllocatePool (
+                     EfiRuntimeServicesData,
+                     SmramRangeCount * sizeof (EFI_SMRAM_DESCRIPTOR),
+                     (VOID **) &Ranges
+                     );
+    if (EFI_ERROR (Status)) {
+      Smst->SmmFreePool (Instance);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    CopyMem (Ranges, SmramRanges, SmramRangeCount * sizeof (EFI_SMRAM_DESCRIPTOR));
+  }
+  ZeroMem (Instance, OFFSET_OF (SMM_COMM_RING_CHANNEL, Scratch));
+  Instance->Signature = SMM_COMM_RING_CHANNEL_SIGNATURE;
+  Instance->Smst      = Smst;
+  Instance->Ring      = (SMM_COMMUNICATE_RING_HEADER *) (UINTN) Ring;
+  Instance->SlotCount = Header.SlotCount;
+  Instance->SlotSize  = Header.SlotSize;
+  Instance->MaxLength = MaxLength;
+  Instance->Done      = Header.Done;
+  Instance->SmramRanges     = Ranges;
+  Instance->SmramRangeCount = SmramRangeCount;
+
+  *Channel = Instance;
+  return EFI_SUCCESS;
+}
+
+/**
+  Closes an SMM channel.
+
+  @param  Channel   The channel.
+
+**/
+VOID
+EFIAPI
+SmmCommRingClose (
+  IN SMM_COMM_RING_CHANNEL  *Channel
+  )
+{
+  if (!InternalSmmCommRingChannelIsValid (Channel)) {
+    return;
+  }
+  Channel->Signature = 0;
+  if (Channel->SmramRanges != NULL) {
+    Channel->Smst->SmmFreePool (Channel->SmramRanges);
+  }
+  Channel->Smst->SmmFreePool (Channel);
+}
+
+/**
+  Registers the handler of the requests of a GUID, in SMM.
+
+  @param  Channel       The channel.
+  @param  HeaderGuid    The GUID of the requests.
+  @param  Handler       The handler.
+  @param  Context       The context of the handler.
+  @param  CopyIn        TRUE to copy the request into SMRAM before the handler is
+                        called and the reply back after, so that the handler
+                        does not read the shared memory; FALSE to have the handler
+                        work in place in the slot.
+
+  @retval EFI_SUCCESS             The handler was registered.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, or a handler is already
+                                  registered for HeaderGuid.
+  @retval EFI_OUT_OF_RESOURCES    SMM_COMM_RING_MAX_HANDLERS handlers are already
+                                  registered.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingRegisterHandler (
+  IN SMM_COMM_RING_CHANNEL  *Channel,
+  IN CONST EFI_GUID         *HeaderGuid,
+  IN SMM_COMM_RING_HANDLER  Handler,
+  IN VOID                   *Context,
+  IN BOOLEAN                CopyIn
+  )
+{
+  SMM_COMM_RING_ENTRY  *Entry;
+
+  if (!InternalSmmCommRingChannelIsValid (Channel) || HeaderGuid == NULL || Handler == NULL ||
+      InternalSmmCommRingFindHandler (Channel, HeaderGuid) != NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Channel->HandlerCount == SMM_COMM_RING_MAX_HANDLERS) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Entry = &Channel->Handlers[Channel->HandlerCount];
+  CopyGuid (&Entry->HeaderGuid, HeaderGuid);
+  Entry->Handler  = Handler;
+  Entry->Context  = Context;
+  Entry->CopyIn   = CopyIn;
+  Channel->HandlerCount++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Handles all the requests posted to the ring, in SMM.
+
+  @param  Channel   The channel.
+
+  @return The number of requests handled.
+
+**/
+UINTN
+EFIAPI
+SmmCommRingProcess (
+  IN SMM_COMM_RING_CHANNEL  *Channel
+  )
+{
+  SMM_COMMUNICATE_RING_SLOT  *Slot;
+  SMM_COMM_RING_ENTRY        *Entry;
+  EFI_GUID                   HeaderGuid;
+  EFI_STATUS                 Status;
+  UINT32                     Head;
+  UINTN                      Length;
+  UINTN                      Count;
+  VOID                       *Data;
+
+  if (!InternalSmmCommRingChannelIsValid (Channel)) {
+    return 0;
+  }
+  Channel->Statistics.Doorbells++;
+
+  //
+  // The ring, with all the requests in it, was checked against SMRAM when the
+  // channel was opened. It is checked again before SMM reads or writes it.
+  //
+  if (!InternalSmmCommRingIsOutsideSmram (
+         Channel->SmramRanges,
+         Channel->SmramRangeCount,
+         (EFI_PHYSICAL_ADDRESS) (UINTN) Channel->Ring,
+         sizeof (SMM_COMMUNICATE_RING_HEADER) + (UINT64) Channel->SlotCount * Channel->SlotSize
+         )) {
+    Channel->Statistics.Corrupted++;
+    return 0;
+  }
+
+  Head = Channel->Ring->Head;
+  if ((UINT32) (Head - Channel->Done) > Channel->SlotCount) {
+    Channel->Statistics.Corrupted++;
+    return 0;
+  }
+
+  for (Count = 0; Channel->Done != Head; Count++) {
+    Slot = SMM_COMM_RING_SLOT_AT (Channel->Ring, Channel->Done, Channel->SlotCount, Channel->SlotSize);
+    if (Slot->State != SMM_COMMUNICATE_RING_SLOT_POSTED) {
+      break;
+    }
+    MemoryFence ();
+    Length = Slot->Length;
+    CopyGuid (&HeaderGuid, &Slot->HeaderGuid);
+
+    Entry = NULL;
+    if (Length > Channel->MaxLength) {
+      Status = EFI_BAD_BUFFER_SIZE;
+    } else {
+      Entry  = InternalSmmCommRingFindHandler (Channel, &HeaderGuid);
+      Status = EFI_NOT_FOUND;
+    }
+
+    if (Entry == NULL) {
+      Channel->Statistics.Rejected++;
+      Length = 0;
+    } else {
+      Data = SMM_COMM_RING_SLOT_DATA (Slot);
+      if (Entry->CopyIn) {
+        CopyMem (Channel->Scratch, Data, Length);
+        Data = Channel->Scratch;
+      }
+      Status = Entry->Handler (Entry->Context, Data, &Length, Channel->MaxLength);
+      if (Length > Channel->MaxLength) {
+        Status = EFI_BAD_BUFFER_SIZE;
+        Length = 0;
+      }
+      if (Entry->CopyIn) {
+        CopyMem (SMM_COMM_RING_SLOT_DATA (Slot), Channel->Scratch, Length);
+      }
+    }
+
+    Slot->Length = (UINT32) Length;
+    Slot->Status = (UINT64) Status;
+    MemoryFence ();
+    Slot->State  = SMM_COMMUNICATE_RING_SLOT_DONE;
+    Channel->Done++;
+    Channel->Ring->Done = Channel->Done;
+  }
+
+  Channel->Statistics.Requests += Count;
+  if (Count > Channel->Statistics.MaximumBatch) {
+    Channel->Statistics.MaximumBatch = (UINT32) Count;
+  }
+  return Count;
+}
+
+/**
+  Answers a doorbell message sent through Communicate(), in SMM.
+
+  @param  Channel               The channel.
+  @param  CommunicationBuffer   The EFI_SMM_COMMUNICATE_HEADER of the message.
+  @param  SourceSize            On input, the size of CommunicationBuffer. On
+                                output, the size of the answer.
+
+  @retval EFI_SUCCESS             The posted requests were handled.
+  @retval EFI_UNSUPPORTED         The message is not a doorbell.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, CommunicationBuffer overlaps
+                                  SMRAM or the end of the address space, or the
+                                  message does not fit in CommunicationBuffer.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingCommunicate (
+  IN     SMM_COMM_RING_CHANNEL  *Channel,
+  IN OUT VOID                   *CommunicationBuffer,
+  IN OUT UINTN                  *SourceSize
+  )
+{
+  EFI_SMM_COMMUNICATE_HEADER  *Header;
+  UINTN                       Size;
+
+  if (!InternalSmmCommRingChannelIsValid (Channel) || CommunicationBuffer == NULL || SourceSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Size   = *SourceSize;
+  Header = (EFI_SMM_COMMUNICATE_HEADER *) CommunicationBuffer;
+  if (Size < OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) ||
+      !InternalSmmCommRingIsOutsideSmram (Channel->SmramRanges, Channel->SmramRangeCount, (EFI_PHYSICAL_ADDRESS) (UINTN) Header, Size)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (!CompareGuid (&Header->HeaderGuid, &gFrameworkSmmCommunicateRingGuid)) {
+    return EFI_UNSUPPORTED;
+  }
+  if (Header->MessageLength > Size - OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SmmCommRingProcess (Channel);
+
+  Header->MessageLength = 0;
+  *SourceSize           = OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data);
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the counters of an SMM channel.
+
+  @param  Channel       The channel.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   Channel or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingGetStatistics (
+  IN  SMM_COMM_RING_CHANNEL     *Channel,
+  OUT SMM_COMM_RING_STATISTICS  *Statistics
+  )
+{
+  if (!InternalSmmCommRingChannelIsValid (Channel) || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  CopyMem (Statistics, &Channel->Statistics, sizeof (SMM_COMM_RING_STATISTICS));
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,82 @@
+/** @file
+  Internal definitions of the SMM communicate ring library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_COMMUNICATE_RING_INTERNAL_H_
+#define _SMM_COMMUNICATE_RING_INTERNAL_H_
+
+#include <FrameworkSmm.h>
+
+#include <Protocol/SmmBase.h>
+#include <Protocol/SmmCommunication.h>
+
+#include <Library/SmmCommunicateRingLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#define SMM_COMM_RING_CHANNEL_SIGNATURE  SIGNATURE_32 ('S', 'C', 'R', 'C')
+
+///
+/// The slot at an index of a ring.
+///
+#define SMM_COMM_RING_SLOT_AT(Ring, Index, SlotCount, SlotSize) \
+  ((SMM_COMMUNICATE_RING_SLOT *) ((UINT8 *) ((SMM_COMMUNICATE_RING_HEADER *) (Ring) + 1) + \
+    (UINTN) ((Index) & ((SlotCount) - 1)) * (SlotSize)))
+
+///
+/// The data of a slot.
+///
+#define SMM_COMM_RING_SLOT_DATA(Slot)  ((VOID *) ((SMM_COMMUNICATE_RING_SLOT *) (Slot) + 1))
+
+typedef struct {
+  EFI_GUID               HeaderGuid;
+  SMM_COMM_RING_HANDLER  Handler;
+  VOID                   *Context;
+  BOOLEAN                CopyIn;
+} SMM_COMM_RING_ENTRY;
+
+struct _SMM_COMM_RING_CHANNEL {
+  UINT32                       Signature;
+  EFI_SMM_SYSTEM_TABLE         *Smst;
+
+  //
+  // The geometry of the ring, checked when the channel was opened. The code outside
+  // SMM may change the header of the ring afterwards; the channel only reads Head
+  // from it.
+  //
+  SMM_COMMUNICATE_RING_HEADER  *Ring;
+  UINT32                       SlotCount;
+  UINT32                       SlotSize;
+  UINTN                        MaxLength;
+  UINT32                       Done;
+
+  //
+  // The SMRAM ranges, copied when the channel was opened, that the ring and the
+  // doorbell messages must not overlap.
+  //
+  EFI_SMRAM_DESCRIPTOR         *SmramRanges;
+  UINTN                        SmramRangeCount;
+
+  UINTN                        HandlerCount;
+  UINTN                        LastHandler;     ///< Handler of the last request.
+  SMM_COMM_RING_ENTRY          Handlers[SMM_COMM_RING_MAX_HANDLERS];
+
+  SMM_COMM_RING_STATISTICS     Statistics;
+  ///
+  /// MaxLength bytes of SMRAM for the requests of the handlers registered with
+  /// CopyIn.
+  ///
+  UINT64                       Scratch[1];
+};
+
+#endif
@@ -0,0 +1,309 @@
+/** @file
+  Functions of the SMM communicate ring library called outside SMM.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmmCommunicateRingInternal.h"
+
+/**
+  Checks that a ring was initialized by SmmCommRingInitialize().
+
+  @param  Ring    The ring.
+
+  @retval TRUE    The ring is valid.
+  @retval FALSE   The ring is NULL or not initialized.
+
+**/
+BOOLEAN
+InternalSmmCommRingIsValid (
+  IN SMM_COMMUNICATE_RING_HEADER  *Ring
+  )
+{
+  return (BOOLEAN) (Ring != NULL && Ring->Signature == SMM_COMMUNICATE_RING_SIGNATURE &&
+                    Ring->SlotCount >= 2 && (Ring->SlotCount & (Ring->SlotCount - 1)) == 0 &&
+                    Ring->SlotSize > sizeof (SMM_COMMUNICATE_RING_SLOT));
+}
+
+/**
+  Checks that a ticket is a request posted and not released.
+
+  @param  Ring      The ring.
+  @param  Ticket    The ticket.
+
+  @retval TRUE    The ticket is valid.
+  @retval FALSE   The ticket is not valid.
+
+**/
+BOOLEAN
+InternalSmmCommRingIsPending (
+  IN SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN UINT32                       Ticket
+  )
+{
+  return (BOOLEAN) ((UINT32) (Ticket - Ring->Tail) < (UINT32) (Ring->Head - Ring->Tail) &&
+                    SMM_COMM_RING_SLOT_AT (Ring, Ticket, Ring->SlotCount, Ring->SlotSize)->State != SMM_COMMUNICATE_RING_SLOT_FREE);
+}
+
+/**
+  Initializes a ring, outside SMM.
+
+  @param  Buffer        The memory of the ring, 8-byte aligned, outside SMRAM.
+  @param  BufferSize    The size of Buffer.
+  @param  MaxLength     The largest request or reply. The slots are sized for it, and
+                        there are as many as fit in Buffer, rounded down to a power
+                        of 2.
+
+  @retval EFI_SUCCESS             The ring was initialized.
+  @retval EFI_INVALID_PARAMETER   Buffer is NULL or not aligned, MaxLength is 0, or
+                                  Buffer cannot hold 2 slots.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingInitialize (
+  OUT VOID   *Buffer,
+  IN  UINTN  BufferSize,
+  IN  UINTN  MaxLength
+  )
+{
+  SMM_COMMUNICATE_RING_HEADER  *Ring;
+  UINTN                        SlotSize;
+  UINTN                        SlotCount;
+
+  if (Buffer == NULL || ((UINTN) Buffer & 7) != 0 || MaxLength == 0 ||
+      MaxLength > MAX_UINT32 - sizeof (SMM_COMMUNICATE_RING_SLOT) - 7 ||
+      BufferSize < sizeof (SMM_COMMUNICATE_RING_HEADER)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SlotSize  = ALIGN_VALUE (sizeof (SMM_COMMUNICATE_RING_SLOT) + MaxLength, 8);
+  SlotCount = (BufferSize - sizeof (SMM_COMMUNICATE_RING_HEADER)) / SlotSize;
+  if (SlotCount < 2) {
+    return EFI_INVALID_PARAMETER;
+  }
+  SlotCount = MIN (GetPowerOfTwo64 (SlotCount), BIT31);
+
+  ZeroMem (Buffer, sizeof (SMM_COMMUNICATE_RING_HEADER) + SlotCount * SlotSize);
+  Ring            = (SMM_COMMUNICATE_RING_HEADER *) Buffer;
+  Ring->SlotCount = (UINT32) SlotCount;
+  Ring->SlotSize  = (UINT32) SlotSize;
+  MemoryFence ();
+  Ring->Signature = SMM_COMMUNICATE_RING_SIGNATURE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns where to write the next request, outside SMM.
+
+  @param  Ring        The ring.
+  @param  Data        Returns the data of the next request.
+  @param  MaxLength   Returns the size of Data.
+
+  @retval EFI_SUCCESS             The slot is free.
+  @retval EFI_OUT_OF_RESOURCES    All the slots hold requests or replies that were
+                                  not released.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, or Ring is not initialized.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingReserve (
+  IN  SMM_COMMUNICATE_RING_HEADER  *Ring,
+  OUT VOID                         **Data,
+  OUT UINTN                        *MaxLength
+  )
+{
+  if (!InternalSmmCommRingIsValid (Ring) || Data == NULL || MaxLength == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((UINT32) (Ring->Head - Ring->Tail) >= Ring->SlotCount) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  *Data      = SMM_COMM_RING_SLOT_DATA (SMM_COMM_RING_SLOT_AT (Ring, Ring->Head, Ring->SlotCount, Ring->SlotSize));
+  *MaxLength = Ring->SlotSize - sizeof (SMM_COMMUNICATE_RING_SLOT);
+  return EFI_SUCCESS;
+}
+
+/**
+  Posts the request written at the place returned by SmmCommRingReserve(), outside
+  SMM.
+
+  @param  Ring          The ring.
+  @param  HeaderGuid    The handler of the request.
+  @param  Length        The length of the request.
+  @param  Ticket        Returns the ticket of the request.
+
+  @retval EFI_SUCCESS             The request was posted.
+  @retval EFI_OUT_OF_RESOURCES    No slot was free.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, Ring is not initialized, or
+                                  Length is larger than the slot.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingSubmit (
+  IN  SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN  CONST EFI_GUID               *HeaderGuid,
+  IN  UINTN                        Length,
+  OUT UINT32                       *Ticket
+  )
+{
+  SMM_COMMUNICATE_RING_SLOT  *Slot;
+
+  if (!InternalSmmCommRingIsValid (Ring) || HeaderGuid == NULL || Ticket == NULL ||
+      Length > Ring->SlotSize - sizeof (SMM_COMMUNICATE_RING_SLOT)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((UINT32) (Ring->Head - Ring->Tail) >= Ring->SlotCount) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Slot         = SMM_COMM_RING_SLOT_AT (Ring, Ring->Head, Ring->SlotCount, Ring->SlotSize);
+  Slot->Length = (UINT32) Length;
+  Slot->Status = EFI_SUCCESS;
+  CopyGuid (&Slot->HeaderGuid, HeaderGuid);
+
+  //
+  // The request is complete before it is seen as posted.
+  //
+  MemoryFence ();
+  Slot->State = SMM_COMMUNICATE_RING_SLOT_POSTED;
+  *Ticket     = Ring->Head;
+  MemoryFence ();
+  Ring->Head++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Has the SMM driver handle the posted requests, outside SMM.
+
+  @param  Ring          The ring.
+  @param  SmmBase       The SMM Base Protocol.
+  @param  ImageHandle   The handle of the SMM driver that opened the ring.
+
+  @retval EFI_SUCCESS             The doorbell was sent, or no request was waiting.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, or Ring is not initialized.
+  @return Others                  The status returned by Communicate().
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingDoorbell (
+  IN SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN EFI_SMM_BASE_PROTOCOL        *SmmBase,
+  IN EFI_HANDLE                   ImageHandle
+  )
+{
+  EFI_SMM_COMMUNICATE_HEADER  Header;
+  UINTN                       Size;
+
+  if (!InternalSmmCommRingIsValid (Ring) || SmmBase == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // No SMI when every request was already handled.
+  //
+  if (Ring->Done == Ring->Head) {
+    return EFI_SUCCESS;
+  }
+
+  CopyGuid (&Header.HeaderGuid, &gFrameworkSmmCommunicateRingGuid);
+  Header.MessageLength = 0;
+  Size = OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data);
+  return SmmBase->Communicate (SmmBase, ImageHandle, &Header, &Size);
+}
+
+/**
+  Returns the reply to a request, outside SMM.
+
+  @param  Ring      The ring.
+  @param  Ticket    The ticket of the request.
+  @param  Data      Returns the data of the reply, in the slot.
+  @param  Length    Returns the length of the reply.
+  @param  Status    Returns the status returned by the handler.
+
+  @retval EFI_SUCCESS             The reply was returned.
+  @retval EFI_NOT_READY           The request was not handled yet.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, Ring is not initialized, or
+                                  Ticket is not a request that was not released.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingGetReply (
+  IN  SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN  UINT32                       Ticket,
+  OUT VOID                         **Data,
+  OUT UINTN                        *Length,
+  OUT EFI_STATUS                   *Status
+  )
+{
+  SMM_COMMUNICATE_RING_SLOT  *Slot;
+
+  if (!InternalSmmCommRingIsValid (Ring) || Data == NULL || Length == NULL || Status == NULL ||
+      !InternalSmmCommRingIsPending (Ring, Ticket)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Slot = SMM_COMM_RING_SLOT_AT (Ring, Ticket, Ring->SlotCount, Ring->SlotSize);
+  if (Slot->State != SMM_COMMUNICATE_RING_SLOT_DONE) {
+    return EFI_NOT_READY;
+  }
+  MemoryFence ();
+  *Data   = SMM_COMM_RING_SLOT_DATA (Slot);
+  *Length = MIN (Slot->Length, Ring->SlotSize - sizeof (SMM_COMMUNICATE_RING_SLOT));
+  *Status = (EFI_STATUS) Slot->Status;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees the slot of a request whose reply was read, outside SMM.
+
+  @param  Ring      The ring.
+  @param  Ticket    The ticket of the request.
+
+  @retval EFI_SUCCESS             The slot was freed.
+  @retval EFI_NOT_READY           The request was not handled yet.
+  @retval EFI_INVALID_PARAMETER   Ring is NULL or not initialized, or Ticket is not
+                                  a request that was not released.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmCommRingRelease (
+  IN SMM_COMMUNICATE_RING_HEADER  *Ring,
+  IN UINT32                       Ticket
+  )
+{
+  SMM_COMMUNICATE_RING_SLOT  *Slot;
+
+  if (!InternalSmmCommRingIsValid (Ring) || !InternalSmmCommRingIsPending (Ring, Ticket)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Slot = SMM_COMM_RING_SLOT_AT (Ring, Ticket, Ring->SlotCount, Ring->SlotSize);
+  if (Slot->State != SMM_COMMUNICATE_RING_SLOT_DONE) {
+    return EFI_NOT_READY;
+  }
+  Slot->State = SMM_COMMUNICATE_RING_SLOT_FREE;
+
+  //
+  // The slots may be released in any order; Tail moves over the ones released.
+  //
+  while (Ring->Tail != Ring->Head &&
+         SMM_COMM_RING_SLOT_AT (Ring, Ring->Tail, Ring->SlotCount, Ring->SlotSize)->State == SMM_COMMUNICATE_RING_SLOT_FREE) {
+    Ring->Tail++;
+  }
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,911 @@
+/** @file
+  This file implement EfiMain() for library class DxeSmmDriverEntryPoint, with
+  the SMM drivers loaded into SMRAM in batches.
+
+  The SMM drivers are queued in the SMM Driver Load Queue Protocol instead of
+  being loaded into SMRAM one SMI each, and the copy in SMRAM of the first of
+  them loads the queue from SMM.
+
+Copyright (c) 2006 - 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+
+#include <FrameworkSmm.h>
+
+#include <Protocol/LoadedImage.h>
+#include <Protocol/SmmBase.h>
+#include <Protocol/SmmAccess.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/SmmCommunication.h>
+#include <Protocol/SmmDriverLoadQueue.h>
+
+#include <Guid/EventGroup.h>
+
+#include <IndustryStandard/PeImage.h>
+
+#include <Library/UefiDriverEntryPoint.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/TimerLib.h>
+
+///
+/// The queue that the copy in SMRAM of this driver loads, when it is the loader.
+///
+FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *mSmmDriverLoadQueue = NULL;
+
+///
+/// The EFI_SMM_BASE_PROTOCOL that the loader located in SMM.
+///
+EFI_SMM_BASE_PROTOCOL                     *mSmmBase = NULL;
+
+///
+/// The SMRAM ranges, that the queue and the SMM drivers in it must not overlap.
+///
+EFI_SMRAM_DESCRIPTOR                      *mSmramRanges = NULL;
+UINTN                                     mSmramRangeCount = 0;
+
+///
+/// The copy in SMRAM of the batch that the loader loads, and of the device path
+/// of the SMM driver that it loads.
+///
+FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_ENTRY     mSmmDriverLoadQueueEntries[FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_SIZE];
+UINT64                                    mSmmDriverFilePath[FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_FILE_PATH_SIZE / sizeof (UINT64)];
+
+///
+/// TRUE once the loader has loaded the batch that closes the queue.
+///
+BOOLEAN                                   mSmmDriverLoadQueueClosed = FALSE;
+
+///
+/// TRUE while the copy outside SMM of this driver loads the queue that it installed.
+///
+BOOLEAN                                   mSmmDriverLoadQueueFlushing = FALSE;
+
+/**
+  This function returns the size, in bytes,
+  of the device path data structure specified by DevicePath.
+  If DevicePath is NULL, then 0 is returned.
+
+  @param  DevicePath A pointer to a device path data structure.
+
+  @return The size of a device path in bytes.
+
+**/
+UINTN
+EFIAPI
+SmmGetDevicePathSize (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath
+  )
+{
+  CONST EFI_DEVICE_PATH_PROTOCOL  *Start;
+
+  if (DevicePath == NULL) {
+    return 0;
+  }
+
+  //
+  // Search for the end of the device path structure
+  //
+  Start = DevicePath;
+  while (!IsDevicePathEnd (DevicePath)) {
+    DevicePath = NextDevicePathNode (DevicePath);
+  }
+
+  //
+  // Compute the size and add back in the size of the end device path structure
+  //
+  return ((UINTN) DevicePath - (UINTN) Start) + sizeof (EFI_DEVICE_PATH_PROTOCOL);
+}
+
+/**
+  This function appends the device path SecondDevicePath to the device path
+  FirstDevicePath whose size is already known.
+
+  @param  FirstDevicePath   A pointer to a device path data structure.
+  @param  Size1             The size of FirstDevicePath, as SmmGetDevicePathSize()
+                            returns it.
+  @param  SecondDevicePath  A pointer to a device path data structure.
+
+  @return A pointer to the new device path is returned.
+          NULL is returned if space for the new device path could not be allocated from pool.
+
+**/
+EFI_DEVICE_PATH_PROTOCOL *
+InternalSmmAppendDevicePath (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *FirstDevicePath,
+  IN UINTN                           Size1,
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *SecondDevicePath
+  )
+{
+  EFI_STATUS                Status;
+  UINTN                     Size;
+  UINTN                     Size2;
+  EFI_DEVICE_PATH_PROTOCOL  *NewDevicePath;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath2;
+
+  //
+  // Allocate space for the combined device path. It only has one end node of
+  // length EFI_DEVICE_PATH_PROTOCOL
+  //
+  Size2         = SmmGetDevicePathSize (SecondDevicePath);
+  Size          = Size1 + Size2 - sizeof (EFI_DEVICE_PATH_PROTOCOL);
+
+  NewDevicePath = NULL;
+  Status = gBS->AllocatePool (EfiBootServicesData, Size, (VOID **) &NewDevicePath);
+
+  if (EFI_SUCCESS == Status) {
+    //
+    // CopyMem in gBS is used as this service should always be ready. We didn't choose
+    // to use a BaseMemoryLib function as such library instance may have constructor.
+    //
+    gBS->CopyMem ((VOID *) NewDevicePath, (VOID *) FirstDevicePath, Size1);
+    //
+    // Over write Src1 EndNode and do the copy
+    //
+    DevicePath2 = (EFI_DEVICE_PATH_PROTOCOL *) ((CHAR8 *) NewDevicePath + (Size1 - sizeof (EFI_DEVICE_PATH_PROTOCOL)));
+    gBS->CopyMem ((VOID *) DevicePath2, (VOID *) SecondDevicePath, Size2);
+  }
+
+  return NewDevicePath;
+}
+
+/**
+  This function appends the device path SecondDevicePath
+  to every device path instance in FirstDevicePath.
+
+  @param  FirstDevicePath A pointer to a device path data structure.
+
+  @param  SecondDevicePath A pointer to a device path data structure.
+
+  @return A pointer to the new device path is returned.
+          NULL is returned if space for the new device path could not be allocated from pool.
+          It is up to the caller to free the memory used by FirstDevicePath and SecondDevicePath
+          if they are no longer needed.
+
+**/
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+SmmAppendDevicePath (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *FirstDevicePath,
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *SecondDevicePath
+  )
+{
+  ASSERT (FirstDevicePath != NULL && SecondDevicePath != NULL);
+
+  return InternalSmmAppendDevicePath (FirstDevicePath, SmmGetDevicePathSize (FirstDevicePath), SecondDevicePath);
+}
+
+/**
+  Returns the name of the file of an SMM driver in a firmware volume, for the
+  report of its load time.
+
+  @param  FilePath    The full device path of the SMM driver.
+
+  @return The name of the file, or NULL when the device path has no firmware
+          volume file node.
+
+**/
+CONST EFI_GUID *
+InternalSmmDriverFileName (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *FilePath
+  )
+{
+  while (!IsDevicePathEnd (FilePath)) {
+    if (DevicePathType (FilePath) == MEDIA_DEVICE_PATH && DevicePathSubType (FilePath) == MEDIA_PIWG_FW_FILE_DP) {
+      return &((CONST MEDIA_FW_VOL_FILEPATH_DEVICE_PATH *) FilePath)->FvFileName;
+    }
+    FilePath = NextDevicePathNode (FilePath);
+  }
+  return NULL;
+}
+
+/**
+  Returns the nanoseconds between two values of the performance counter.
+
+  This function runs in SMM only, where the constructor of TimerLib has run.
+
+  @param  Start   The value of the performance counter before.
+  @param  End     The value of the performance counter after.
+
+  @return The nanoseconds between Start and End.
+
+**/
+UINT64
+InternalSmmDriverLoadTime (
+  IN UINT64  Start,
+  IN UINT64  End
+  )
+{
+  UINT64  StartValue;
+  UINT64  EndValue;
+
+  GetPerformanceCounterProperties (&StartValue, &EndValue);
+  if (EndValue < StartValue) {
+    //
+    // The counter counts down.
+    //
+    return GetTimeInNanoSecond ((Start >= End) ? Start - End : (Start - EndValue) + (StartValue - End));
+  }
+  return GetTimeInNanoSecond ((End >= Start) ? End - Start : (EndValue - Start) + (End - StartValue));
+}
+
+/**
+  Checks that a buffer is outside SMRAM.
+
+  This function runs in SMM only, once the loader has kept the SMRAM ranges.
+
+  @param  Buffer    The address of the buffer.
+  @param  Length    The size of the buffer, in bytes.
+
+  @retval TRUE      The buffer is outside SMRAM.
+  @retval FALSE     The buffer is NULL or empty, wraps around the address space, or
+                    overlaps SMRAM.
+
+**/
+BOOLEAN
+InternalSmmIsBufferOutsideSmram (
+  IN EFI_PHYSICAL_ADDRESS  Buffer,
+  IN UINT64                Length
+  )
+{
+  UINTN  Index;
+
+  if (Buffer == 0 || Length == 0 || Length - 1 > MAX_ADDRESS - Buffer) {
+    return FALSE;
+  }
+  for (Index = 0; Index < mSmramRangeCount; Index++) {
+    if (Buffer < mSmramRanges[Index].CpuStart + mSmramRanges[Index].PhysicalSize &&
+        mSmramRanges[Index].CpuStart < Buffer + Length) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+  Copies into SMRAM the device path of an SMM driver of the queue.
+
+  Each node is copied before its length is checked, so that the device path
+  cannot change between the check and its use.
+
+  @param  FilePath    The device path of the SMM driver, outside SMRAM.
+
+  @return The copy in SMRAM of the device path, which the next call overwrites,
+          or NULL when the device path overlaps SMRAM, has a node shorter than
+          its header, or is larger than FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_FILE_PATH_SIZE.
+
+**/
+EFI_DEVICE_PATH_PROTOCOL *
+InternalSmmDriverCopyFilePath (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *FilePath
+  )
+{
+  EFI_PHYSICAL_ADDRESS      Address;
+  EFI_DEVICE_PATH_PROTOCOL  *Node;
+  UINTN                     Offset;
+  UINTN                     Length;
+
+  Address = (EFI_PHYSICAL_ADDRESS) (UINTN) FilePath;
+  if (Address > MAX_ADDRESS - FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_FILE_PATH_SIZE) {
+    return NULL;
+  }
+
+  Offset = 0;
+  do {
+    if (FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_FILE_PATH_SIZE - Offset < sizeof (EFI_DEVICE_PATH_PROTOCOL) ||
+        !InternalSmmIsBufferOutsideSmram (Address + Offset, sizeof (EFI_DEVICE_PATH_PROTOCOL))) {
+      return NULL;
+    }
+    Node = (EFI_DEVICE_PATH_PROTOCOL *) ((UINT8 *) mSmmDriverFilePath + Offset);
+    CopyMem (Node, (CONST UINT8 *) FilePath + Offset, sizeof (EFI_DEVICE_PATH_PROTOCOL));
+
+    Length = DevicePathNodeLength (Node);
+    if (Length < sizeof (EFI_DEVICE_PATH_PROTOCOL) || Length > FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_FILE_PATH_SIZE - Offset ||
+        !InternalSmmIsBufferOutsideSmram (Address + Offset, Length)) {
+      return NULL;
+    }
+    CopyMem (Node + 1, (CONST UINT8 *) FilePath + Offset + sizeof (EFI_DEVICE_PATH_PROTOCOL), Length - sizeof (EFI_DEVICE_PATH_PROTOCOL));
+    Offset += Length;
+  } while (!IsDevicePathEnd (Node));
+
+  return (EFI_DEVICE_PATH_PROTOCOL *) mSmmDriverFilePath;
+}
+
+/**
+  Loads into SMRAM, from SMM, the SMM drivers of the queue.
+
+  The callback is registered with EFI_SMM_BASE_PROTOCOL.RegisterCallback() by the
+  copy in SMRAM of the SMM driver that installed the queue. The queue is read
+  from the pointer that was checked and saved then, not from the message. The
+  batch is copied into SMRAM before it is checked, the SMM drivers are loaded
+  with the EFI_SMM_BASE_PROTOCOL located in SMM, and only their results are
+  written back to the queue. An SMM driver whose device path or image overlaps
+  SMRAM is left for the copy outside SMM to load.
+
+  Each SMM driver is timed, and the first one that EFI_SMM_BASE_PROTOCOL.Register()
+  cannot load from SMM leaves it and the rest of the queue for the copy outside
+  SMM to load. The message that closes the queue is the last one loaded.
+
+  @param  SmmImageHandle        The handle of the SMM driver that loads the queue.
+  @param  CommunicationBuffer   The EFI_SMM_COMMUNICATE_HEADER of the message.
+  @param  SourceSize            The size of CommunicationBuffer.
+
+  @retval EFI_SUCCESS           The SMM drivers of the queue were loaded, or left
+                                for the copy outside SMM.
+  @retval EFI_UNSUPPORTED       The message is not for the queue, or the queue
+                                was closed.
+
+**/
+EFI_STATUS
+EFIAPI
+InternalSmmDriverLoadQueueCallback (
+  IN     EFI_HANDLE  SmmImageHandle,
+  IN OUT VOID        *CommunicationBuffer,
+  IN OUT UINTN       *SourceSize
+  )
+{
+  EFI_SMM_COMMUNICATE_HEADER             *Header;
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_ENTRY  *Entry;
+  EFI_DEVICE_PATH_PROTOCOL               *FilePath;
+  EFI_STATUS                             Status;
+  UINT32                                 Count;
+  UINT32                                 Index;
+  UINT64                                 Start;
+
+  Header = (EFI_SMM_COMMUNICATE_HEADER *) CommunicationBuffer;
+  if (mSmmDriverLoadQueue == NULL || mSmmDriverLoadQueueClosed || Header == NULL || SourceSize == NULL ||
+      *SourceSize < OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) + 1 ||
+      !InternalSmmIsBufferOutsideSmram ((EFI_PHYSICAL_ADDRESS) (UINTN) Header, *SourceSize) ||
+      !CompareGuid (&Header->HeaderGuid, &gFrameworkSmmDriverLoadQueueProtocolGuid) ||
+      Header->MessageLength < 1) {
+    return EFI_UNSUPPORTED;
+  }
+  if (Header->Data[0] == FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_CLOSE) {
+    mSmmDriverLoadQueueClosed = TRUE;
+  }
+
+  Count = mSmmDriverLoadQueue->Count;
+  if (Count > FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_SIZE) {
+    return EFI_SUCCESS;
+  }
+  CopyMem (mSmmDriverLoadQueueEntries, mSmmDriverLoadQueue->Entries, Count * sizeof (FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_ENTRY));
+
+  for (Index = 0; Index < Count; Index++) {
+    Entry    = &mSmmDriverLoadQueueEntries[Index];
+    FilePath = InternalSmmDriverCopyFilePath (Entry->FilePath);
+    if (FilePath == NULL ||
+        !InternalSmmIsBufferOutsideSmram ((EFI_PHYSICAL_ADDRESS) (UINTN) Entry->ImageBase, sizeof (EFI_IMAGE_DOS_HEADER))) {
+      continue;
+    }
+
+    Start  = GetPerformanceCounter ();
+    Status = mSmmBase->Register (mSmmBase, FilePath, Entry->ImageBase, 0, &Entry->SmmHandle, FALSE);
+    Entry->LoadTime = InternalSmmDriverLoadTime (Start, GetPerformanceCounter ());
+
+    mSmmDriverLoadQueue->Entries[Index].SmmHandle = Entry->SmmHandle;
+    mSmmDriverLoadQueue->Entries[Index].LoadTime  = Entry->LoadTime;
+    mSmmDriverLoadQueue->Entries[Index].Status    = Status;
+    if (Status == EFI_UNSUPPORTED) {
+      //
+      // The SMM core only loads drivers from outside SMM.
+      //
+      break;
+    }
+    if (!EFI_ERROR (Status)) {
+      mSmmDriverLoadQueue->Loaded++;
+      mSmmDriverLoadQueue->LoadTime += Entry->LoadTime;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Makes the copy in SMRAM of this driver the loader of the queue, when the queue
+  is installed and has no loader yet.
+
+  The EFI_SMM_BASE_PROTOCOL located in SMM and the SMRAM ranges are kept in SMRAM
+  for the loader. The queue must be outside SMRAM.
+
+  @param  ImageHandle   The handle of this driver in SMM.
+  @param  SmmBase       The EFI_SMM_BASE_PROTOCOL, located in SMM.
+
+**/
+VOID
+InternalSmmDriverLoadQueueRegisterLoader (
+  IN EFI_HANDLE             ImageHandle,
+  IN EFI_SMM_BASE_PROTOCOL  *SmmBase
+  )
+{
+  EFI_STATUS                                Status;
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *Queue;
+  EFI_SMM_ACCESS_PROTOCOL                   *SmmAccess;
+  UINTN                                     Size;
+
+  Status = gBS->LocateProtocol (&gFrameworkSmmDriverLoadQueueProtocolGuid, NULL, (VOID **) &Queue);
+  if (EFI_ERROR (Status) || Queue->LoaderHandle != NULL) {
+    return;
+  }
+
+  Status = gBS->LocateProtocol (&gEfiSmmAccessProtocolGuid, NULL, (VOID **) &SmmAccess);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+  Size   = 0;
+  Status = SmmAccess->GetCapabilities (SmmAccess, &Size, NULL);
+  if (Status != EFI_BUFFER_TOO_SMALL || Size == 0) {
+    return;
+  }
+  Status = SmmBase->SmmAllocatePool (SmmBase, EfiRuntimeServicesData, Size, (VOID **) &mSmramRanges);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+  Status = SmmAccess->GetCapabilities (SmmAccess, &Size, mSmramRanges);
+  if (!EFI_ERROR (Status)) {
+    mSmramRangeCount = Size / sizeof (EFI_SMRAM_DESCRIPTOR);
+    Status = EFI_ACCESS_DENIED;
+    if (InternalSmmIsBufferOutsideSmram ((EFI_PHYSICAL_ADDRESS) (UINTN) Queue, sizeof (*Queue))) {
+      Status = SmmBase->RegisterCallback (SmmBase, ImageHandle, InternalSmmDriverLoadQueueCallback, FALSE, FALSE);
+    }
+  }
+  if (EFI_ERROR (Status)) {
+    SmmBase->SmmFreePool (SmmBase, mSmramRanges);
+    mSmramRanges     = NULL;
+    mSmramRangeCount = 0;
+    return;
+  }
+
+  mSmmBase            = SmmBase;
+  mSmmDriverLoadQueue = Queue;
+  Queue->LoaderHandle = ImageHandle;
+}
+
+/**
+  Loads into SMRAM the SMM drivers of the queue, empties the queue, and closes it
+  when asked to.
+
+  One Communicate() to the loader in SMM loads the SMM drivers of the queue. The
+  SMM drivers that the loader did not load are loaded one by one with
+  EFI_SMM_BASE_PROTOCOL.Register(). The time that each SMM driver took to load is
+  reported through DebugLib, and its device path is freed.
+
+  @param  This                  Indicates the FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL instance.
+  @param  Close                 TRUE to make the loader refuse any later batch.
+
+  @retval EFI_SUCCESS           The queue was empty, or all the SMM drivers of the
+                                queue were loaded.
+  @retval Others                The status of the last SMM driver that failed to load.
+
+**/
+EFI_STATUS
+InternalSmmDriverLoadQueueLoad (
+  IN FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *This,
+  IN BOOLEAN                                   Close
+  )
+{
+  EFI_STATUS                             Status;
+  EFI_STATUS                             ReturnStatus;
+  EFI_SMM_COMMUNICATE_HEADER             Header;
+  UINTN                                  Size;
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_ENTRY  *Entry;
+  CONST EFI_GUID                         *FileName;
+  UINT32                                 Index;
+
+  if ((This->Count == 0 && !Close) || mSmmDriverLoadQueueFlushing) {
+    return EFI_SUCCESS;
+  }
+  mSmmDriverLoadQueueFlushing = TRUE;
+
+  //
+  // One SMI loads the whole queue. The message only names the queue, and says
+  // if it is the last one.
+  //
+  Status = EFI_NOT_READY;
+  if (This->LoaderHandle != NULL) {
+    gBS->CopyMem (&Header.HeaderGuid, &gFrameworkSmmDriverLoadQueueProtocolGuid, sizeof (EFI_GUID));
+    Header.MessageLength = 1;
+    Header.Data[0]       = Close ? FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_CLOSE : FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_LOAD;
+    Size   = OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) + 1;
+    Status = This->SmmBase->Communicate (This->SmmBase, This->LoaderHandle, &Header, &Size);
+    This->Batches++;
+  }
+
+  ReturnStatus = EFI_SUCCESS;
+  for (Index = 0; Index < This->Count; Index++) {
+    Entry    = &This->Entries[Index];
+    FileName = InternalSmmDriverFileName (Entry->FilePath);
+    if (EFI_ERROR (Status) || Entry->Status == EFI_NOT_STARTED || Entry->Status == EFI_UNSUPPORTED) {
+      Entry->Status = This->SmmBase->Register (This->SmmBase, Entry->FilePath, Entry->ImageBase, 0, &Entry->SmmHandle, FALSE);
+      DEBUG ((DEBUG_INFO, "SMM driver %g at %p loaded by itself - %r\n", FileName, Entry->ImageBase, Entry->Status));
+    } else {
+      DEBUG ((DEBUG_INFO, "SMM driver %g at %p loaded in %ld ns - %r\n", FileName, Entry->ImageBase, Entry->LoadTime, Entry->Status));
+    }
+    if (EFI_ERROR (Entry->Status)) {
+      DEBUG ((DEBUG_ERROR, "SMM driver %g failed to load - %r\n", FileName, Entry->Status));
+      ReturnStatus = Entry->Status;
+    }
+    gBS->FreePool (Entry->FilePath);
+    Entry->FilePath = NULL;
+  }
+  DEBUG ((DEBUG_INFO, "SMM driver load queue: %d drivers loaded in batch %d, %ld ns in all so far\n", This->Count, This->Batches, This->LoadTime));
+
+  This->Count = 0;
+  mSmmDriverLoadQueueFlushing = FALSE;
+  return ReturnStatus;
+}
+
+/**
+  Loads into SMRAM the SMM drivers of the queue, and empties the queue.
+
+  The SMM drivers that the loader did not load are loaded one by one with
+  EFI_SMM_BASE_PROTOCOL.Register(). The time that each SMM driver took to load is
+  reported through DebugLib.
+
+  @param  This                  Indicates the FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL instance.
+
+  @retval EFI_SUCCESS           The queue was empty, or all the SMM drivers of the
+                                queue were loaded.
+  @retval Others                The status of the last SMM driver that failed to load.
+
+**/
+EFI_STATUS
+EFIAPI
+InternalSmmDriverLoadQueueFlush (
+  IN FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *This
+  )
+{
+  return InternalSmmDriverLoadQueueLoad (This, FALSE);
+}
+
+/**
+  Loads the queue at the end of DXE and closes it, so that the loader in SMM
+  refuses any later batch and the SMM drivers started after that load one by one.
+
+  @param  Event     The event of the end of DXE or of the ready to boot.
+  @param  Context   The queue.
+
+**/
+VOID
+EFIAPI
+InternalSmmDriverLoadQueueClose (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *Queue;
+
+  Queue = (FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL *) Context;
+  if (!Queue->Closed) {
+    InternalSmmDriverLoadQueueLoad (Queue, TRUE);
+    Queue->Closed = TRUE;
+  }
+}
+
+/**
+  Installs the queue. The queue is loaded at the end of DXE, and at the ready to
+  boot for the platforms that do not signal the end of DXE.
+
+  @param  SmmBase   The EFI_SMM_BASE_PROTOCOL.
+
+  @retval EFI_SUCCESS   The queue was installed.
+  @retval Others        The queue could not be installed.
+
+**/
+EFI_STATUS
+InternalSmmDriverLoadQueueInstall (
+  IN EFI_SMM_BASE_PROTOCOL  *SmmBase
+  )
+{
+  EFI_STATUS                                Status;
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *Queue;
+  EFI_EVENT                                 EndOfDxeEvent;
+  EFI_EVENT                                 ReadyToBootEvent;
+  EFI_HANDLE                                Handle;
+
+  Status = gBS->AllocatePool (EfiBootServicesData, sizeof (*Queue), (VOID **) &Queue);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  gBS->SetMem (Queue, sizeof (*Queue), 0);
+  Queue->Flush   = InternalSmmDriverLoadQueueFlush;
+  Queue->SmmBase = SmmBase;
+
+  Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  InternalSmmDriverLoadQueueClose,
+                  Queue,
+                  &gEfiEndOfDxeEventGroupGuid,
+                  &EndOfDxeEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    gBS->FreePool (Queue);
+    return Status;
+  }
+  Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  InternalSmmDriverLoadQueueClose,
+                  Queue,
+                  &gEfiEventReadyToBootGuid,
+                  &ReadyToBootEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (EndOfDxeEvent);
+    gBS->FreePool (Queue);
+    return Status;
+  }
+
+  Handle = NULL;
+  Status = gBS->InstallProtocolInterface (
+                  &Handle,
+                  &gFrameworkSmmDriverLoadQueueProtocolGuid,
+                  EFI_NATIVE_INTERFACE,
+                  Queue
+                  );
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (ReadyToBootEvent);
+    gBS->CloseEvent (EndOfDxeEvent);
+    gBS->FreePool (Queue);
+  }
+  return Status;
+}
+
+/**
+  Queues this driver to be loaded into SMRAM with the next batch.
+
+  The device path of the device that this driver was loaded from, and the size
+  of it, are cached in the queue for the next SMM driver.
+
+  @param  Queue         The queue.
+  @param  LoadedImage   The Loaded Image Protocol of this driver.
+  @param  ImageHandle   The handle of this driver.
+
+  @retval EFI_SUCCESS     This driver was queued. It is loaded when the queue is.
+  @retval EFI_NOT_READY   The queue has no loader, or was closed. This driver must
+                          load by itself.
+  @retval Others          This driver could not be queued, and must load by itself.
+
+**/
+EFI_STATUS
+InternalSmmDriverLoadQueueAdd (
+  IN FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *Queue,
+  IN EFI_LOADED_IMAGE_PROTOCOL                 *LoadedImage,
+  IN EFI_HANDLE                                ImageHandle
+  )
+{
+  EFI_STATUS                             Status;
+  EFI_DEVICE_PATH_PROTOCOL               *ImageDevicePath;
+  EFI_DEVICE_PATH_PROTOCOL               *CompleteFilePath;
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_ENTRY  *Entry;
+
+  if (Queue->LoaderHandle == NULL || Queue->Closed) {
+    return EFI_NOT_READY;
+  }
+
+  if (Queue->DeviceHandle != LoadedImage->DeviceHandle || Queue->DevicePath == NULL) {
+    Status = gBS->HandleProtocol (
+                    LoadedImage->DeviceHandle,
+                    &gEfiDevicePathProtocolGuid,
+                    (VOID*)&ImageDevicePath
+                    );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Queue->DeviceHandle   = LoadedImage->DeviceHandle;
+    Queue->DevicePath     = ImageDevicePath;
+    Queue->DevicePathSize = SmmGetDevicePathSize (ImageDevicePath);
+  }
+
+  CompleteFilePath = InternalSmmAppendDevicePath (Queue->DevicePath, Queue->DevicePathSize, LoadedImage->FilePath);
+  if (CompleteFilePath == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Entry              = &Queue->Entries[Queue->Count];
+  Entry->ImageHandle = ImageHandle;
+  Entry->FilePath    = CompleteFilePath;
+  Entry->ImageBase   = LoadedImage->ImageBase;
+  Entry->SmmHandle   = NULL;
+  Entry->Status      = EFI_NOT_STARTED;
+  Entry->LoadTime    = 0;
+  Queue->Count++;
+
+  //
+  // The failures of the other SMM drivers of a full queue are theirs, and are
+  // reported by Flush().
+  //
+  if (Queue->Count == FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_SIZE) {
+    Queue->Flush (Queue);
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Unload function that is registered in the LoadImage protocol.  It un-installs
+  protocols produced and deallocates pool used by the driver.  Called by the core
+  when unloading the driver.
+
+  @param  ImageHandle   ImageHandle of the unloaded driver
+
+  @return Status of the ProcessModuleUnloadList.
+
+**/
+EFI_STATUS
+EFIAPI
+_DriverUnloadHandler (
+  EFI_HANDLE ImageHandle
+  )
+{
+  //
+  // Call the unload handlers for all the modules.
+  // 
+  // Note: All libraries were constructed in SMM space, 
+  // therefore we can not destruct them in Unload 
+  // handler.
+  //
+  return ProcessModuleUnloadList (ImageHandle);
+}
+
+/**
+  Enrty point to DXE SMM Driver.
+
+  @param  ImageHandle ImageHandle of the loaded driver.
+  @param  SystemTable Pointer to the EFI System Table.
+
+  @retval  EFI_SUCCESS One or more of the drivers returned a success code.
+  @retval  !EFI_SUCESS The return status from the last driver entry point in the list.
+
+**/
+EFI_STATUS
+EFIAPI
+_ModuleEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS                                Status;
+  EFI_LOADED_IMAGE_PROTOCOL                 *LoadedImage;
+  EFI_SMM_BASE_PROTOCOL                     *SmmBase;
+  BOOLEAN                                   InSmm;
+  EFI_DEVICE_PATH_PROTOCOL                  *CompleteFilePath;
+  EFI_DEVICE_PATH_PROTOCOL                  *ImageDevicePath;
+  EFI_HANDLE                                Handle;
+  FRAMEWORK_SMM_DRIVER_LOAD_QUEUE_PROTOCOL  *Queue;
+
+  //
+  // Cache a pointer to the Boot Services Table
+  //
+  gBS = SystemTable->BootServices;
+
+  //
+  // Retrieve SMM Base Protocol
+  //
+  Status = gBS->LocateProtocol (
+                  &gEfiSmmBaseProtocolGuid,
+                  NULL,
+                  (VOID **) &SmmBase
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  //
+  // Check to see if we are already in SMM
+  //
+  SmmBase->InSmm (SmmBase, &InSmm);
+
+  //
+  //
+  //
+  if (!InSmm) {
+    //
+    // Retrieve the Loaded Image Protocol
+    //
+    Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiLoadedImageProtocolGuid,
+                  (VOID*)&LoadedImage
+                  );
+    ASSERT_EFI_ERROR (Status);
+
+    //
+    // Queue this driver when a loader in SMM is ready, and else install the
+    // queue and load this driver by itself, so that its copy in SMRAM becomes
+    // the loader.
+    //
+    Status = gBS->LocateProtocol (&gFrameworkSmmDriverLoadQueueProtocolGuid, NULL, (VOID **) &Queue);
+    if (!EFI_ERROR (Status)) {
+      Status = InternalSmmDriverLoadQueueAdd (Queue, LoadedImage, ImageHandle);
+      if (!EFI_ERROR (Status)) {
+        if (_gDriverUnloadImageCount > 0) {
+          LoadedImage->Unload = _DriverUnloadHandler;
+        }
+        return EFI_SUCCESS;
+      }
+    } else {
+      InternalSmmDriverLoadQueueInstall (SmmBase);
+    }
+
+    //
+    // Retrieve the Device Path Protocol from the DeviceHandle from which this driver was loaded
+    //
+    Status = gBS->HandleProtocol (
+                    LoadedImage->DeviceHandle,
+                    &gEfiDevicePathProtocolGuid,
+                    (VOID*)&ImageDevicePath
+                    );
+    ASSERT_EFI_ERROR (Status);
+
+    //
+    // Build the full device path to the currently execuing image
+    //
+    CompleteFilePath = SmmAppendDevicePath (ImageDevicePath, LoadedImage->FilePath);
+
+    //
+    // Load the image in memory to SMRAM; it will automatically generate the
+    // SMI.
+    //
+    Status = SmmBase->Register (SmmBase, CompleteFilePath, LoadedImage->ImageBase, 0, &Handle, FALSE);
+    ASSERT_EFI_ERROR (Status);
+    //
+    // Optionally install the unload handler
+    //
+    if (_gDriverUnloadImageCount > 0) {
+      Status = gBS->HandleProtocol (
+                      ImageHandle,
+                      &gEfiLoadedImageProtocolGuid,
+                      (VOID **)&LoadedImage
+                      );
+      ASSERT_EFI_ERROR (Status);
+      LoadedImage->Unload = _DriverUnloadHandler;
+    }
+
+    return Status;
+  }
+
+  //
+  // Call constructor for all libraries
+  //
+  ProcessLibraryConstructorList (ImageHandle, SystemTable);
+
+  //
+  // Call the list of driver entry points
+  //
+  Status = ProcessModuleEntryPointList (ImageHandle, SystemTable);
+  if (EFI_ERROR (Status)) {
+    ProcessLibraryDestructorList (ImageHandle, SystemTable);
+  } else if (mSmmDriverLoadQueue == NULL) {
+    InternalSmmDriverLoadQueueRegisterLoader (ImageHandle, SmmBase);
+  }
+
+  return Status;
+}
+
+/**
+  Enrty point wrapper of DXE SMM Driver.
+
+  @param  ImageHandle ImageHandle of the loaded driver.
+  @param  SystemTable Pointer to the EFI System Table.
+
+  @retval  EFI_SUCCESS One or more of the drivers returned a success code.
+  @retval  !EFI_SUCESS The return status from the last driver entry point in the list.
+
+**/
+EFI_STATUS
+EFIAPI
+EfiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  return _ModuleEntryPoint (ImageHandle, SystemTable);
+}
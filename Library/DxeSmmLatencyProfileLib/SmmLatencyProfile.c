@@ -0,0 +1,372 @@
+/** @file
+  SMI latency profile library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmmLatencyProfileInternal.h"
+
+/**
+  Checks that a profile was created by this library.
+
+  @param  Profile   The profile.
+
+  @retval TRUE    The profile is valid.
+  @retval FALSE   The profile is NULL or was not created by this library.
+
+**/
+BOOLEAN
+InternalSmmLatencyProfileIsValid (
+  IN SMM_LATENCY_PROFILE  *Profile
+  )
+{
+  return (BOOLEAN) (Profile != NULL && Profile->Signature == SMM_LATENCY_PROFILE_SIGNATURE);
+}
+
+/**
+  Returns the ticks between two values of SmmLatencyProfileGetTicks(), across a
+  wrap around of the performance counter.
+
+  @param  Profile       The profile.
+  @param  StartTicks    The earlier value.
+  @param  EndTicks      The later value.
+
+  @return The ticks.
+
+**/
+UINT64
+InternalSmmLatencyProfileElapsed (
+  IN SMM_LATENCY_PROFILE  *Profile,
+  IN UINT64               StartTicks,
+  IN UINT64               EndTicks
+  )
+{
+  if (EndTicks >= StartTicks) {
+    return EndTicks - StartTicks;
+  }
+  return (Profile->LastTicks - StartTicks) + (EndTicks - Profile->FirstTicks);
+}
+
+/**
+  Adds a record to the ring of a profile, overwriting the oldest one when the ring
+  is full.
+
+  @param  Profile       The profile.
+  @param  Kind          The kind of the record.
+  @param  Handler       The handler of the record.
+  @param  EntryTicks    The ticks at the entry.
+  @param  Rendezvous    The ticks spent waiting for the other processors.
+
+**/
+VOID
+InternalSmmLatencyProfileAdd (
+  IN SMM_LATENCY_PROFILE  *Profile,
+  IN UINT8                Kind,
+  IN UINT64               Handler,
+  IN UINT64               EntryTicks,
+  IN UINT32               Rendezvous
+  )
+{
+  SMM_LATENCY_RECORD  *Record;
+  UINT64              ExitTicks;
+
+  ExitTicks = EntryTicks + InternalSmmLatencyProfileElapsed (Profile, EntryTicks, SmmLatencyProfileGetTicks (Profile));
+
+  Record             = &Profile->Records[Profile->Sequence & Profile->Mask];
+  Record->Handler    = Handler;
+  Record->Entry      = EntryTicks;
+  Record->Exit       = ExitTicks;
+  Record->Rendezvous = Rendezvous;
+  Record->Cpu        = (UINT16) Profile->Smst->CurrentlyExecutingCpu;
+  Record->Kind       = Kind;
+  Record->Reserved   = 0;
+  Profile->Sequence++;
+}
+
+/**
+  Creates an SMI latency profile.
+
+  @param  Smst          The SMM System Table, whose SmmAllocatePool() allocates the
+                        ring.
+  @param  RecordCount   The number of records of the ring, a power of 2. The oldest
+                        records are overwritten when the ring is full.
+  @param  Profile       Returns the profile.
+
+  @retval EFI_SUCCESS             The profile was created.
+  @retval EFI_INVALID_PARAMETER   Smst or Profile is NULL, or RecordCount is not a
+                                  power of 2.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmLatencyProfileCreate (
+  IN  EFI_SMM_SYSTEM_TABLE  *Smst,
+  IN  UINTN                 RecordCount,
+  OUT SMM_LATENCY_PROFILE   **Profile
+  )
+{
+  EFI_STATUS           Status;
+  SMM_LATENCY_PROFILE  *Instance;
+  UINTN                Size;
+  UINT64               StartValue;
+  UINT64               EndValue;
+
+  if (Smst == NULL || Profile == NULL || RecordCount == 0 || (RecordCount & (RecordCount - 1)) != 0 ||
+      RecordCount > (MAX_UINTN - sizeof (SMM_LATENCY_PROFILE)) / sizeof (SMM_LATENCY_RECORD)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Size   = OFFSET_OF (SMM_LATENCY_PROFILE, Records) + RecordCount * sizeof (SMM_LATENCY_RECORD);
+  Status = Smst->SmmAllocatePool (EfiRuntimeServicesData, Size, (VOID **) &Instance);
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  ZeroMem (Instance, Size);
+
+  Instance->Frequency  = GetPerformanceCounterProperties (&StartValue, &EndValue);
+  Instance->Signature  = SMM_LATENCY_PROFILE_SIGNATURE;
+  Instance->Smst       = Smst;
+  Instance->CountsUp   = (BOOLEAN) (EndValue >= StartValue);
+  Instance->StartValue = StartValue;
+  Instance->FirstTicks = Instance->CountsUp ? StartValue : 0;
+  Instance->LastTicks  = Instance->CountsUp ? EndValue : StartValue - EndValue;
+  Instance->Mask       = RecordCount - 1;
+
+  *Profile = Instance;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees an SMI latency profile.
+
+  @param  Profile   The profile.
+
+**/
+VOID
+EFIAPI
+SmmLatencyProfileDestroy (
+  IN SMM_LATENCY_PROFILE  *Profile
+  )
+{
+  if (!InternalSmmLatencyProfileIsValid (Profile)) {
+    return;
+  }
+  Profile->Signature = 0;
+  Profile->Smst->SmmFreePool (Profile);
+}
+
+/**
+  Returns the performance counter, as a value that counts up.
+
+  The ticks passed to the other functions of the library are values returned by
+  this function.
+
+  @param  Profile   The profile.
+
+  @return The ticks.
+
+**/
+UINT64
+EFIAPI
+SmmLatencyProfileGetTicks (
+  IN SMM_LATENCY_PROFILE  *Profile
+  )
+{
+  UINT64  Counter;
+
+  Counter = GetPerformanceCounter ();
+  return Profile->CountsUp ? Counter : Profile->StartValue - Counter;
+}
+
+/**
+  Starts the record of an SMI, once all the processors are in SMM.
+
+  @param  Profile         The profile.
+  @param  ArrivalTicks    The ticks when the processor entered SMM, or 0 if they
+                          are not known.
+
+**/
+VOID
+EFIAPI
+SmmLatencyProfileBeginSmi (
+  IN SMM_LATENCY_PROFILE  *Profile,
+  IN UINT64               ArrivalTicks
+  )
+{
+  UINT64  Now;
+
+  if (!InternalSmmLatencyProfileIsValid (Profile)) {
+    return;
+  }
+
+  Now = SmmLatencyProfileGetTicks (Profile);
+  if (ArrivalTicks == 0) {
+    ArrivalTicks = Now;
+  }
+  Profile->InSmi         = TRUE;
+  Profile->SmiArrival    = ArrivalTicks;
+  Profile->SmiRendezvous = (UINT32) MIN (InternalSmmLatencyProfileElapsed (Profile, ArrivalTicks, Now), MAX_UINT32);
+}
+
+/**
+  Records an SMI started by SmmLatencyProfileBeginSmi(), before the processors
+  leave SMM.
+
+  @param  Profile   The profile.
+
+**/
+VOID
+EFIAPI
+SmmLatencyProfileEndSmi (
+  IN SMM_LATENCY_PROFILE  *Profile
+  )
+{
+  if (!InternalSmmLatencyProfileIsValid (Profile) || !Profile->InSmi) {
+    return;
+  }
+  InternalSmmLatencyProfileAdd (Profile, SMM_LATENCY_KIND_SMI, 0, Profile->SmiArrival, Profile->SmiRendezvous);
+  Profile->InSmi = FALSE;
+}
+
+/**
+  Records a handler or a callback that has just returned.
+
+  @param  Profile       The profile.
+  @param  Kind          SMM_LATENCY_KIND_HANDLER or SMM_LATENCY_KIND_COMMUNICATE.
+  @param  Handler       The address of the handler or of the callback.
+  @param  EntryTicks    The ticks when it was called.
+
+**/
+VOID
+EFIAPI
+SmmLatencyProfileRecord (
+  IN SMM_LATENCY_PROFILE  *Profile,
+  IN UINT8                Kind,
+  IN UINT64               Handler,
+  IN UINT64               EntryTicks
+  )
+{
+  if (!InternalSmmLatencyProfileIsValid (Profile)) {
+    return;
+  }
+  ASSERT (Kind == SMM_LATENCY_KIND_HANDLER || Kind == SMM_LATENCY_KIND_COMMUNICATE);
+  InternalSmmLatencyProfileAdd (Profile, Kind, Handler, EntryTicks, 0);
+}
+
+/**
+  Answers a query of the profile sent through Communicate().
+
+  The driver that owns the profile calls this function from the callback that it
+  registered with EFI_SMM_BASE_PROTOCOL.RegisterCallback(). The message is read
+  once into SMRAM before it is checked, and the records returned never go beyond
+  MessageLength or SourceSize.
+
+  @param  Profile               The profile.
+  @param  CommunicationBuffer   The EFI_SMM_COMMUNICATE_HEADER of the message.
+  @param  SourceSize            On input, the size of CommunicationBuffer. On
+                                output, the size of the answer.
+  @param  SmramRanges           The SMRAM ranges, that CommunicationBuffer must not
+                                overlap.
+  @param  SmramRangeCount       The number of SMRAM ranges.
+
+  @retval EFI_SUCCESS             The records were returned.
+  @retval EFI_UNSUPPORTED         The message is not a query of the profile.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, CommunicationBuffer overlaps
+                                  SMRAM or the end of the address space, or the
+                                  message does not fit in CommunicationBuffer or is
+                                  too small for a query.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmLatencyProfileCommunicate (
+  IN     SMM_LATENCY_PROFILE         *Profile,
+  IN OUT VOID                        *CommunicationBuffer,
+  IN OUT UINTN                       *SourceSize,
+  IN     CONST EFI_SMRAM_DESCRIPTOR  *SmramRanges,
+  IN     UINTN                       SmramRangeCount
+  )
+{
+  EFI_SMM_COMMUNICATE_HEADER  *Header;
+  SMM_LATENCY_PROFILE_QUERY   *Message;
+  SMM_LATENCY_PROFILE_QUERY   Query;
+  UINTN                       Size;
+  UINTN                       MessageLength;
+  UINT64                      Oldest;
+  UINT64                      Next;
+  UINT64                      Count;
+  UINTN                       First;
+  UINTN                       Part;
+  UINTN                       Index;
+  EFI_PHYSICAL_ADDRESS        Buffer;
+
+  if (!InternalSmmLatencyProfileIsValid (Profile) || CommunicationBuffer == NULL || SourceSize == NULL ||
+      (SmramRanges == NULL && SmramRangeCount != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The sizes are read once, so that the checks hold for the rest of the call.
+  // The answer is written over the whole buffer, which must not reach SMRAM.
+  //
+  Size   = *SourceSize;
+  Header = (EFI_SMM_COMMUNICATE_HEADER *) CommunicationBuffer;
+  Buffer = (EFI_PHYSICAL_ADDRESS) (UINTN) CommunicationBuffer;
+  if (Size < OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) || Size - 1 > MAX_ADDRESS - Buffer) {
+    return EFI_INVALID_PARAMETER;
+  }
+  for (Index = 0; Index < SmramRangeCount; Index++) {
+    if (Buffer < SmramRanges[Index].CpuStart + SmramRanges[Index].PhysicalSize &&
+        SmramRanges[Index].CpuStart < Buffer + Size) {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+  if (!CompareGuid (&Header->HeaderGuid, &gFrameworkSmmLatencyProfileGuid)) {
+    return EFI_UNSUPPORTED;
+  }
+  MessageLength = Header->MessageLength;
+  if (MessageLength > Size - OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) ||
+      MessageLength < OFFSET_OF (SMM_LATENCY_PROFILE_QUERY, Records)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Message = (SMM_LATENCY_PROFILE_QUERY *) Header->Data;
+  CopyMem (&Query, Message, OFFSET_OF (SMM_LATENCY_PROFILE_QUERY, Records));
+
+  //
+  // The records from NextSequence that are still in the ring and fit in the message.
+  //
+  Oldest = (Profile->Sequence > Profile->Mask) ? Profile->Sequence - Profile->Mask - 1 : 0;
+  Next   = MIN (Query.NextSequence, Profile->Sequence);
+  Query.Lost = 0;
+  if (Next < Oldest) {
+    Query.Lost = Oldest - Next;
+    Next       = Oldest;
+  }
+  Count = MIN (Profile->Sequence - Next, (MessageLength - OFFSET_OF (SMM_LATENCY_PROFILE_QUERY, Records)) / sizeof (SMM_LATENCY_RECORD));
+  Count = MIN (Count, Query.RecordCount);
+
+  First = (UINTN) (Next & Profile->Mask);
+  Part  = (UINTN) MIN (Count, Profile->Mask + 1 - First);
+  CopyMem (Message->Records, &Profile->Records[First], Part * sizeof (SMM_LATENCY_RECORD));
+  CopyMem (Message->Records + Part, Profile->Records, ((UINTN) Count - Part) * sizeof (SMM_LATENCY_RECORD));
+
+  Query.NextSequence = Next + Count;
+  Query.Frequency    = Profile->Frequency;
+  Query.RecordCount  = (UINT32) Count;
+  Query.Reserved     = 0;
+  CopyMem (Message, &Query, OFFSET_OF (SMM_LATENCY_PROFILE_QUERY, Records));
+
+  MessageLength         = OFFSET_OF (SMM_LATENCY_PROFILE_QUERY, Records) + (UINTN) Count * sizeof (SMM_LATENCY_RECORD);
+  Header->MessageLength = MessageLength;
+  *SourceSize           = OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) + MessageLength;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,60 @@
+/** @file
+  Internal definitions of the SMI latency profile library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_LATENCY_PROFILE_INTERNAL_H_
+#define _SMM_LATENCY_PROFILE_INTERNAL_H_
+
+#include <FrameworkSmm.h>
+
+#include <Protocol/SmmCommunication.h>
+
+#include <Library/SmmLatencyProfileLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/TimerLib.h>
+
+#define SMM_LATENCY_PROFILE_SIGNATURE  SIGNATURE_32 ('S', 'M', 'L', 'P')
+
+///
+/// The percentiles are computed on a histogram with 2^SMM_LATENCY_SUB_BUCKET_BITS
+/// buckets per power of 2. The times below 2^SMM_LATENCY_SUB_BUCKET_BITS ticks
+/// have a bucket each.
+///
+#define SMM_LATENCY_SUB_BUCKET_BITS  3
+#define SMM_LATENCY_FINE_BUCKETS     ((64 - SMM_LATENCY_SUB_BUCKET_BITS + 1) << SMM_LATENCY_SUB_BUCKET_BITS)
+
+struct _SMM_LATENCY_PROFILE {
+  UINT32                Signature;
+  EFI_SMM_SYSTEM_TABLE  *Smst;
+  BOOLEAN               CountsUp;       ///< The performance counter counts up.
+  UINT64                StartValue;
+  UINT64                FirstTicks;     ///< Smallest value of SmmLatencyProfileGetTicks().
+  UINT64                LastTicks;      ///< Largest value of SmmLatencyProfileGetTicks().
+  UINT64                Frequency;
+
+  BOOLEAN               InSmi;
+  UINT64                SmiArrival;
+  UINT32                SmiRendezvous;
+
+  ///
+  /// Number of records written since the profile was created. Record N is at
+  /// Records[N & Mask].
+  ///
+  UINT64                Sequence;
+  UINT64                Mask;
+  SMM_LATENCY_RECORD    Records[1];
+};
+
+#endif
@@ -0,0 +1,180 @@
+/** @file
+  Percentiles of the records of the SMI latency profile library.
+
+  The times are counted in a histogram with a few buckets per power of 2, so that
+  the percentiles are found without sorting or copying the records, with an error
+  below 1/8 of the time.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmmLatencyProfileInternal.h"
+
+/**
+  Returns the bucket of a time in the histogram of the percentiles.
+
+  @param  Time    The time.
+
+  @return The bucket.
+
+**/
+UINTN
+InternalSmmLatencyFineBucket (
+  IN UINT64  Time
+  )
+{
+  UINTN  Octave;
+
+  if (Time < (1 << SMM_LATENCY_SUB_BUCKET_BITS)) {
+    return (UINTN) Time;
+  }
+  Octave = (UINTN) HighBitSet64 (Time);
+  return ((Octave - SMM_LATENCY_SUB_BUCKET_BITS + 1) << SMM_LATENCY_SUB_BUCKET_BITS) +
+         ((UINTN) RShiftU64 (Time, Octave - SMM_LATENCY_SUB_BUCKET_BITS) & ((1 << SMM_LATENCY_SUB_BUCKET_BITS) - 1));
+}
+
+/**
+  Returns the largest time of a bucket of the histogram of the percentiles.
+
+  @param  Bucket  The bucket.
+
+  @return The largest time of the bucket.
+
+**/
+UINT64
+InternalSmmLatencyFineBucketLimit (
+  IN UINTN  Bucket
+  )
+{
+  UINTN  Shift;
+
+  if (Bucket < (1 << SMM_LATENCY_SUB_BUCKET_BITS)) {
+    return Bucket;
+  }
+  Shift = (Bucket >> SMM_LATENCY_SUB_BUCKET_BITS) - 1;
+  return LShiftU64 ((Bucket & ((1 << SMM_LATENCY_SUB_BUCKET_BITS) - 1)) + (1 << SMM_LATENCY_SUB_BUCKET_BITS) + 1, Shift) - 1;
+}
+
+/**
+  Returns a percentile from the histogram of the percentiles.
+
+  @param  Fine        The histogram.
+  @param  Count       The number of times counted.
+  @param  Maximum     The largest time counted.
+  @param  PerMille    The percentile, in thousandths.
+
+  @return The percentile.
+
+**/
+UINT64
+InternalSmmLatencyPercentile (
+  IN CONST UINT32  *Fine,
+  IN UINT64        Count,
+  IN UINT64        Maximum,
+  IN UINT32        PerMille
+  )
+{
+  UINT64  Rank;
+  UINT64  Seen;
+  UINTN   Bucket;
+
+  //
+  // The time of rank ceil (Count * PerMille / 1000), counting from 1.
+  //
+  Rank = DivU64x32 (MultU64x32 (Count, PerMille) + 999, 1000);
+  if (Rank == 0) {
+    Rank = 1;
+  }
+  Seen = 0;
+  for (Bucket = 0; Bucket < SMM_LATENCY_FINE_BUCKETS; Bucket++) {
+    Seen += Fine[Bucket];
+    if (Seen >= Rank) {
+      return MIN (InternalSmmLatencyFineBucketLimit (Bucket), Maximum);
+    }
+  }
+  return Maximum;
+}
+
+/**
+  Summarizes the times of some records of a profile.
+
+  This function may be called outside SMM, on the records returned by a query.
+
+  @param  Records       The records.
+  @param  RecordCount   The number of records.
+  @param  Kind          The kind of the records to summarize.
+  @param  Handler       The handler of the records to summarize, or 0 for all.
+  @param  Rendezvous    TRUE to summarize the time spent waiting for the other
+                        processors instead of the time in SMM.
+  @param  Summary       Returns the summary.
+
+  @retval EFI_SUCCESS             The summary was returned.
+  @retval EFI_NOT_FOUND           No record matches.
+  @retval EFI_INVALID_PARAMETER   Records is NULL while RecordCount is not 0, or
+                                  Summary is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmLatencyProfileSummarize (
+  IN  CONST SMM_LATENCY_RECORD  *Records,
+  IN  UINTN                     RecordCount,
+  IN  UINT8                     Kind,
+  IN  UINT64                    Handler,
+  IN  BOOLEAN                   Rendezvous,
+  OUT SMM_LATENCY_SUMMARY       *Summary
+  )
+{
+  UINT32  Fine[SMM_LATENCY_FINE_BUCKETS];
+  UINTN   Index;
+  UINT64  Time;
+  INTN    Bucket;
+
+  if ((Records == NULL && RecordCount != 0) || Summary == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Summary, sizeof (SMM_LATENCY_SUMMARY));
+  ZeroMem (Fine, sizeof (Fine));
+  Summary->Minimum = MAX_UINT64;
+  for (Index = 0; Index < RecordCount; Index++) {
+    if (Records[Index].Kind != Kind || (Handler != 0 && Records[Index].Handler != Handler)) {
+      continue;
+    }
+    Time = Rendezvous ? Records[Index].Rendezvous : Records[Index].Exit - Records[Index].Entry;
+
+    Summary->Count++;
+    Summary->Total  += Time;
+    Summary->Minimum = MIN (Summary->Minimum, Time);
+    Summary->Maximum = MAX (Summary->Maximum, Time);
+
+    Bucket = HighBitSet64 (Time);
+    if (Bucket < 0) {
+      Bucket = 0;
+    }
+    if (Summary->Histogram[Bucket] != MAX_UINT32) {
+      Summary->Histogram[Bucket]++;
+    }
+    if (Fine[InternalSmmLatencyFineBucket (Time)] != MAX_UINT32) {
+      Fine[InternalSmmLatencyFineBucket (Time)]++;
+    }
+  }
+  if (Summary->Count == 0) {
+    Summary->Minimum = 0;
+    return EFI_NOT_FOUND;
+  }
+
+  Summary->Median        = InternalSmmLatencyPercentile (Fine, Summary->Count, Summary->Maximum, 500);
+  Summary->Percentile90  = InternalSmmLatencyPercentile (Fine, Summary->Count, Summary->Maximum, 900);
+  Summary->Percentile99  = InternalSmmLatencyPercentile (Fine, Summary->Count, Summary->Maximum, 990);
+  Summary->Percentile999 = InternalSmmLatencyPercentile (Fine, Summary->Count, Summary->Maximum, 999);
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,620 @@
+/** @file
+  Arenas, slabs and pools of the SMRAM arena library.
+
+  A slab is one page of objects of one size class, shared by all the arenas; each
+  object records the arena that holds it. The slabs that have free objects are
+  linked per class; a slab leaves the list when its last object is allocated, and
+  is freed when its last object is freed, unless it is the only slab of its class
+  with free objects, that is kept for the next allocations.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmramArenaInternal.h"
+
+//
+// The size classes are multiples of 16 bytes, about 1.5 times apart; the two
+// largest fill a page with 3 and 2 objects.
+//
+GLOBAL_REMOVE_IF_UNREFERENCED CONST UINT16  mSmramArenaClassSize[SMRAM_ARENA_CLASS_COUNT] = {
+  16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1344, SMRAM_ARENA_MAX_SLAB_SIZE
+};
+
+/**
+  Checks the signature of an arena.
+
+  @param  Arena   The arena.
+
+  @retval TRUE    Arena is a created arena.
+  @retval FALSE   Arena is NULL, or not a created arena.
+
+**/
+BOOLEAN
+InternalSmramArenaIsValid (
+  IN SMRAM_ARENA  *Arena
+  )
+{
+  return (BOOLEAN) (Arena != NULL && Arena->Signature == SMRAM_ARENA_SIGNATURE);
+}
+
+/**
+  Returns the address of a page of a heap.
+
+  @param  Heap    The heap.
+  @param  Index   The index of the page.
+
+  @return The address of the page.
+
+**/
+VOID *
+InternalSmramArenaPageAddress (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN UINT32            Index
+  )
+{
+  return (VOID *) (UINTN) (Heap->Base + EFI_PAGES_TO_SIZE ((UINT64) Index));
+}
+
+/**
+  Counts the bytes handed out by an arena.
+
+  @param  Arena   The arena.
+  @param  Bytes   The bytes handed out.
+
+**/
+VOID
+InternalSmramArenaCountAllocation (
+  IN SMRAM_ARENA  *Arena,
+  IN UINTN        Bytes
+  )
+{
+  Arena->Statistics.Allocations++;
+  Arena->Statistics.BytesInUse     += Bytes;
+  Arena->Statistics.HighWaterBytes  = MAX (Arena->Statistics.HighWaterBytes, Arena->Statistics.BytesInUse);
+}
+
+/**
+  Unlinks a slab from the list of the slabs of its class with free objects.
+
+  @param  Heap    The heap.
+  @param  Slab    The slab.
+
+**/
+VOID
+InternalSmramArenaUnlinkSlab (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN SMRAM_ARENA_SLAB  *Slab
+  )
+{
+  if (Slab->Prev != NULL) {
+    Slab->Prev->Next = Slab->Next;
+  } else {
+    Heap->Slabs[Slab->Class] = Slab->Next;
+  }
+  if (Slab->Next != NULL) {
+    Slab->Next->Prev = Slab->Prev;
+  }
+  Slab->Next = NULL;
+  Slab->Prev = NULL;
+}
+
+/**
+  Links a slab first in the list of the slabs of its class with free objects.
+
+  @param  Heap    The heap.
+  @param  Slab    The slab.
+
+**/
+VOID
+InternalSmramArenaLinkSlab (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN SMRAM_ARENA_SLAB  *Slab
+  )
+{
+  Slab->Prev = NULL;
+  Slab->Next = Heap->Slabs[Slab->Class];
+  if (Slab->Next != NULL) {
+    Slab->Next->Prev = Slab;
+  }
+  Heap->Slabs[Slab->Class] = Slab;
+}
+
+/**
+  Allocates a new slab of a class.
+
+  @param  Heap    The heap.
+  @param  Class   The size class.
+
+  @return The slab, linked first in the list of its class, or NULL when the heap has
+          no free page.
+
+**/
+SMRAM_ARENA_SLAB *
+InternalSmramArenaNewSlab (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN UINTN             Class
+  )
+{
+  SMRAM_ARENA_SLAB  *Slab;
+  UINT32            Page;
+  UINTN             Size;
+  UINTN             Capacity;
+  UINT8             *Object;
+  UINTN             Index;
+
+  Page = InternalSmramArenaAllocateRun (Heap, NULL, 1, SMRAM_ARENA_PAGE_SLAB);
+  if (Page == MAX_UINT32) {
+    return NULL;
+  }
+
+  //
+  // As many objects as fit in the page with their arena indexes.
+  //
+  Size     = mSmramArenaClassSize[Class];
+  Capacity = (EFI_PAGE_SIZE - sizeof (SMRAM_ARENA_SLAB)) / (Size + 1);
+  while (ALIGN_VALUE (sizeof (SMRAM_ARENA_SLAB) + Capacity, 16) + Capacity * Size > EFI_PAGE_SIZE) {
+    Capacity--;
+  }
+
+  Slab             = (SMRAM_ARENA_SLAB *) InternalSmramArenaPageAddress (Heap, Page);
+  Slab->Class      = (UINT16) Class;
+  Slab->Capacity   = (UINT16) Capacity;
+  Slab->FreeCount  = (UINT16) Capacity;
+  Slab->DataOffset = (UINT16) ALIGN_VALUE (sizeof (SMRAM_ARENA_SLAB) + Capacity, 16);
+  SetMem (SMRAM_ARENA_SLAB_OWNERS (Slab), Capacity, SMRAM_ARENA_NONE);
+
+  //
+  // The free list links the objects in the order of their addresses.
+  //
+  Object         = (UINT8 *) Slab + Slab->DataOffset;
+  Slab->FreeList = Object;
+  for (Index = 1; Index < Capacity; Index++, Object += Size) {
+    *(VOID **) Object = Object + Size;
+  }
+  *(VOID **) Object = NULL;
+
+  InternalSmramArenaLinkSlab (Heap, Slab);
+  Heap->SlabPages++;
+  Heap->SlabFreeBytes += Capacity * Size;
+  return Slab;
+}
+
+/**
+  Frees an object of a slab, to the arena that holds it.
+
+  @param  Heap      The heap.
+  @param  Slab      The slab.
+  @param  Page      The index of the page of the slab.
+  @param  Object    The index of the object in the slab.
+
+**/
+VOID
+InternalSmramArenaFreeObject (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN SMRAM_ARENA_SLAB  *Slab,
+  IN UINT32            Page,
+  IN UINTN             Object
+  )
+{
+  SMRAM_ARENA  *Arena;
+  UINT8        *Owners;
+  UINTN        Size;
+  VOID         *Buffer;
+
+  Owners = SMRAM_ARENA_SLAB_OWNERS (Slab);
+  Size   = mSmramArenaClassSize[Slab->Class];
+  Buffer = (UINT8 *) Slab + Slab->DataOffset + Object * Size;
+  Arena  = &Heap->Arenas[Owners[Object]];
+
+  Owners[Object]    = SMRAM_ARENA_NONE;
+  *(VOID **) Buffer = Slab->FreeList;
+  Slab->FreeList    = Buffer;
+  Slab->FreeCount++;
+  Arena->Statistics.Frees++;
+  Arena->Statistics.BytesInUse -= Size;
+  Heap->SlabFreeBytes          += Size;
+
+  if (Slab->FreeCount == 1) {
+    //
+    // The slab was full; it has a free object again.
+    //
+    InternalSmramArenaLinkSlab (Heap, Slab);
+  }
+  if (Slab->FreeCount == Slab->Capacity && (Slab->Next != NULL || Slab->Prev != NULL)) {
+    //
+    // The slab is empty and another slab of its class has free objects.
+    //
+    InternalSmramArenaUnlinkSlab (Heap, Slab);
+    Heap->SlabPages--;
+    Heap->SlabFreeBytes -= Slab->Capacity * Size;
+    InternalSmramArenaFreeRun (Heap, Page);
+  }
+}
+
+/**
+  Creates an arena in a heap.
+
+  @param  Heap    The heap.
+  @param  Owner   The handle of the driver that owns the arena, or NULL.
+  @param  Arena   Returns the arena.
+
+  @retval EFI_SUCCESS             The arena was created.
+  @retval EFI_INVALID_PARAMETER   Heap or Arena is NULL.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM_ARENA_MAX_ARENAS arenas are already created.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaCreate (
+  IN  SMRAM_ARENA_HEAP  *Heap,
+  IN  EFI_HANDLE        Owner,
+  OUT SMRAM_ARENA       **Arena
+  )
+{
+  SMRAM_ARENA  *NewArena;
+  UINTN        Index;
+
+  if (!InternalSmramArenaHeapIsValid (Heap) || Arena == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (Index = 0; Index < SMRAM_ARENA_MAX_ARENAS; Index++) {
+    NewArena = &Heap->Arenas[Index];
+    if (NewArena->Signature != SMRAM_ARENA_SIGNATURE) {
+      ZeroMem (&NewArena->Statistics, sizeof (NewArena->Statistics));
+      NewArena->Statistics.Owner = (UINT64) (UINTN) Owner;
+      NewArena->Statistics.Index = (UINT32) Index;
+      NewArena->Signature        = SMRAM_ARENA_SIGNATURE;
+      Heap->ArenaCount++;
+      *Arena = NewArena;
+      return EFI_SUCCESS;
+    }
+  }
+  return EFI_OUT_OF_RESOURCES;
+}
+
+/**
+  Finds the arena of a driver.
+
+  @param  Heap    The heap.
+  @param  Owner   The handle of the driver.
+  @param  Arena   Returns the arena.
+
+  @retval EFI_SUCCESS             The arena was found.
+  @retval EFI_NOT_FOUND           The driver owns no arena.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaFind (
+  IN  SMRAM_ARENA_HEAP  *Heap,
+  IN  EFI_HANDLE        Owner,
+  OUT SMRAM_ARENA       **Arena
+  )
+{
+  UINTN  Index;
+
+  if (!InternalSmramArenaHeapIsValid (Heap) || Owner == NULL || Arena == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (Index = 0; Index < SMRAM_ARENA_MAX_ARENAS; Index++) {
+    if (Heap->Arenas[Index].Signature == SMRAM_ARENA_SIGNATURE &&
+        Heap->Arenas[Index].Statistics.Owner == (UINT64) (UINTN) Owner) {
+      *Arena = &Heap->Arenas[Index];
+      return EFI_SUCCESS;
+    }
+  }
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Destroys an arena, and releases at once all the SMRAM that it holds.
+
+  @param  Arena   The arena.
+
+  @retval EFI_SUCCESS             The arena was destroyed.
+  @retval EFI_INVALID_PARAMETER   Arena is NULL or was destroyed.
+  @retval EFI_ACCESS_DENIED       Arena is the default arena of the SMM System Table
+                                  that the heap is behind.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaDestroy (
+  IN SMRAM_ARENA  *Arena
+  )
+{
+  SMRAM_ARENA_HEAP  *Heap;
+  SMRAM_ARENA_SLAB  *Slab;
+  UINT8             *Owners;
+  UINT32            Index;
+  UINT32            Count;
+  UINTN             Object;
+
+  if (!InternalSmramArenaIsValid (Arena)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Heap = Arena->Heap;
+  if (Arena == Heap->DefaultArena) {
+    return EFI_ACCESS_DENIED;
+  }
+  if (Arena == Heap->CurrentArena) {
+    Heap->CurrentArena = Heap->DefaultArena;
+  }
+
+  //
+  // The runs and the objects of the arena are found from the pages of the heap and
+  // from the arena indexes of the slabs, so that the arena needs no list of them.
+  //
+  Index = 0;
+  while (Index < Heap->TotalPages) {
+    if (Heap->Pages[Index].Kind == SMRAM_ARENA_PAGE_FREE) {
+      Index++;
+      continue;
+    }
+    Count = Heap->Pages[Index].RunPages;
+    if (Heap->Pages[Index].Kind == SMRAM_ARENA_PAGE_SLAB) {
+      Slab   = (SMRAM_ARENA_SLAB *) InternalSmramArenaPageAddress (Heap, Index);
+      Owners = SMRAM_ARENA_SLAB_OWNERS (Slab);
+      //
+      // The slab is freed with the last object of the arena when it is left empty.
+      //
+      for (Object = 0; Object < Slab->Capacity && Heap->Pages[Index].Kind == SMRAM_ARENA_PAGE_SLAB; Object++) {
+        if (Owners[Object] == Arena->Index) {
+          InternalSmramArenaFreeObject (Heap, Slab, Index, Object);
+        }
+      }
+    } else if (Heap->Pages[Index].Arena == Arena->Index) {
+      InternalSmramArenaFreeRun (Heap, Index);
+      Arena->Statistics.BytesInUse -= EFI_PAGES_TO_SIZE ((UINTN) Count);
+    }
+    Index += Count;
+  }
+  ASSERT (Arena->Statistics.Pages == 0 && Arena->Statistics.BytesInUse == 0);
+
+  Arena->Signature = 0;
+  Heap->ArenaCount--;
+  return EFI_SUCCESS;
+}
+
+/**
+  Allocates a pool from an arena.
+
+  @param  Arena   The arena.
+  @param  Size    The size of the pool.
+  @param  Buffer  Returns the pool, 8-byte aligned.
+
+  @retval EFI_SUCCESS             The pool was allocated.
+  @retval EFI_INVALID_PARAMETER   Arena or Buffer is NULL.
+  @retval EFI_OUT_OF_RESOURCES    The heap has no free pages left for the pool.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaAllocatePool (
+  IN  SMRAM_ARENA  *Arena,
+  IN  UINTN        Size,
+  OUT VOID         **Buffer
+  )
+{
+  SMRAM_ARENA_HEAP  *Heap;
+  SMRAM_ARENA_SLAB  *Slab;
+  UINTN             Class;
+  UINT32            Page;
+  VOID              *Object;
+
+  if (!InternalSmramArenaIsValid (Arena) || Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Size > SMRAM_ARENA_MAX_SLAB_SIZE) {
+    if (Size > MAX_UINTN - EFI_PAGE_MASK) {
+      Arena->Statistics.Failures++;
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Page = InternalSmramArenaAllocateRun (Arena->Heap, Arena, EFI_SIZE_TO_PAGES (Size), SMRAM_ARENA_PAGE_POOL);
+    if (Page == MAX_UINT32) {
+      Arena->Statistics.Failures++;
+      return EFI_OUT_OF_RESOURCES;
+    }
+    InternalSmramArenaCountAllocation (Arena, EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (Size)));
+    *Buffer = InternalSmramArenaPageAddress (Arena->Heap, Page);
+    return EFI_SUCCESS;
+  }
+
+  for (Class = 0; mSmramArenaClassSize[Class] < Size; Class++) {
+  }
+  Heap = Arena->Heap;
+  Slab = Heap->Slabs[Class];
+  if (Slab == NULL) {
+    Slab = InternalSmramArenaNewSlab (Heap, Class);
+    if (Slab == NULL) {
+      Arena->Statistics.Failures++;
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Object         = Slab->FreeList;
+  Slab->FreeList = *(VOID **) Object;
+  Slab->FreeCount--;
+  if (Slab->FreeCount == 0) {
+    InternalSmramArenaUnlinkSlab (Heap, Slab);
+  }
+  SMRAM_ARENA_SLAB_OWNERS (Slab)[((UINT8 *) Object - (UINT8 *) Slab - Slab->DataOffset) / mSmramArenaClassSize[Class]] = Arena->Index;
+
+  Heap->SlabFreeBytes -= mSmramArenaClassSize[Class];
+  InternalSmramArenaCountAllocation (Arena, mSmramArenaClassSize[Class]);
+  *Buffer = Object;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees a pool, to the arena that it was allocated from.
+
+  @param  Heap    The heap.
+  @param  Buffer  The pool.
+
+  @retval EFI_SUCCESS             The pool was freed.
+  @retval EFI_INVALID_PARAMETER   Heap is NULL, or Buffer is not a pool of the heap.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaFreePool (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN VOID              *Buffer
+  )
+{
+  SMRAM_ARENA       *Arena;
+  SMRAM_ARENA_SLAB  *Slab;
+  SMRAM_ARENA_PAGE  *Page;
+  UINT32            Index;
+  UINTN             Offset;
+  UINTN             Size;
+
+  if (!InternalSmramArenaHeapIsValid (Heap) || Buffer == NULL ||
+      !InternalSmramArenaContains (Heap, (EFI_PHYSICAL_ADDRESS) (UINTN) Buffer)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Index  = (UINT32) RShiftU64 ((UINTN) Buffer - Heap->Base, EFI_PAGE_SHIFT);
+  Offset = (UINTN) ((UINTN) Buffer - Heap->Base) & EFI_PAGE_MASK;
+  Page   = &Heap->Pages[Index];
+
+  if (Page->Kind == SMRAM_ARENA_PAGE_POOL && Offset == 0) {
+    Arena = &Heap->Arenas[Page->Arena];
+    Size  = EFI_PAGES_TO_SIZE ((UINTN) Page->RunPages);
+    InternalSmramArenaFreeRun (Heap, Index);
+    Arena->Statistics.Frees++;
+    Arena->Statistics.BytesInUse -= Size;
+    return EFI_SUCCESS;
+  }
+
+  if (Page->Kind != SMRAM_ARENA_PAGE_SLAB) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Slab = (SMRAM_ARENA_SLAB *) InternalSmramArenaPageAddress (Heap, Index);
+  Size = mSmramArenaClassSize[Slab->Class];
+  if (Offset < Slab->DataOffset || (Offset - Slab->DataOffset) % Size != 0 ||
+      (Offset - Slab->DataOffset) / Size >= Slab->Capacity ||
+      SMRAM_ARENA_SLAB_OWNERS (Slab)[(Offset - Slab->DataOffset) / Size] == SMRAM_ARENA_NONE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  InternalSmramArenaFreeObject (Heap, Slab, Index, (Offset - Slab->DataOffset) / Size);
+  return EFI_SUCCESS;
+}
+
+/**
+  Allocates pages from an arena.
+
+  @param  Arena           The arena.
+  @param  NumberOfPages   The number of pages.
+  @param  Memory          Returns the address of the first page.
+
+  @retval EFI_SUCCESS             The pages were allocated.
+  @retval EFI_INVALID_PARAMETER   Arena or Memory is NULL, or NumberOfPages is 0.
+  @retval EFI_OUT_OF_RESOURCES    The heap has no run of NumberOfPages free pages.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaAllocatePages (
+  IN  SMRAM_ARENA           *Arena,
+  IN  UINTN                 NumberOfPages,
+  OUT EFI_PHYSICAL_ADDRESS  *Memory
+  )
+{
+  UINT32  Page;
+
+  if (!InternalSmramArenaIsValid (Arena) || Memory == NULL || NumberOfPages == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Page = InternalSmramArenaAllocateRun (Arena->Heap, Arena, NumberOfPages, SMRAM_ARENA_PAGE_PAGES);
+  if (Page == MAX_UINT32) {
+    Arena->Statistics.Failures++;
+    return EFI_OUT_OF_RESOURCES;
+  }
+  InternalSmramArenaCountAllocation (Arena, EFI_PAGES_TO_SIZE (NumberOfPages));
+  *Memory = (EFI_PHYSICAL_ADDRESS) (UINTN) InternalSmramArenaPageAddress (Arena->Heap, Page);
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees pages, to the arena that they were allocated from.
+
+  @param  Heap            The heap.
+  @param  Memory          The address of the first page.
+  @param  NumberOfPages   The number of pages, as they were allocated.
+
+  @retval EFI_SUCCESS             The pages were freed.
+  @retval EFI_INVALID_PARAMETER   Heap is NULL.
+  @retval EFI_NOT_FOUND           The pages were not allocated with
+                                  SmramArenaAllocatePages().
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaFreePages (
+  IN SMRAM_ARENA_HEAP      *Heap,
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages
+  )
+{
+  SMRAM_ARENA  *Arena;
+  UINT32       Index;
+
+  if (!InternalSmramArenaHeapIsValid (Heap)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (!InternalSmramArenaContains (Heap, Memory) || (Memory & EFI_PAGE_MASK) != 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  Index = (UINT32) RShiftU64 (Memory - Heap->Base, EFI_PAGE_SHIFT);
+  if (Heap->Pages[Index].Kind != SMRAM_ARENA_PAGE_PAGES || Heap->Pages[Index].RunPages != NumberOfPages) {
+    return EFI_NOT_FOUND;
+  }
+
+  Arena = &Heap->Arenas[Heap->Pages[Index].Arena];
+  InternalSmramArenaFreeRun (Heap, Index);
+  Arena->Statistics.Frees++;
+  Arena->Statistics.BytesInUse -= EFI_PAGES_TO_SIZE (NumberOfPages);
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the statistics of an arena.
+
+  @param  Arena         The arena.
+  @param  Statistics    Returns the statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Arena or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaGetArenaStatistics (
+  IN  SMRAM_ARENA             *Arena,
+  OUT SMRAM_ARENA_STATISTICS  *Statistics
+  )
+{
+  if (!InternalSmramArenaIsValid (Arena) || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Statistics, &Arena->Statistics, sizeof (*Statistics));
+  return EFI_SUCCESS;
+}
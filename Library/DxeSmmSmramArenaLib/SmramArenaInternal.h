@@ -0,0 +1,207 @@
+/** @file
+  Internal definitions of the SMRAM arena library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMRAM_ARENA_INTERNAL_H_
+#define _SMRAM_ARENA_INTERNAL_H_
+
+#include <FrameworkSmm.h>
+
+#include <Protocol/SmmCommunication.h>
+
+#include <Library/SmramArenaLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+#define SMRAM_ARENA_HEAP_SIGNATURE  SIGNATURE_32 ('S', 'A', 'H', 'P')
+#define SMRAM_ARENA_SIGNATURE       SIGNATURE_32 ('S', 'A', 'R', 'N')
+
+///
+/// Number of size classes of the slabs, from 16 to SMRAM_ARENA_MAX_SLAB_SIZE bytes.
+///
+#define SMRAM_ARENA_CLASS_COUNT  14
+
+///
+/// Sizes of the classes.
+///
+extern CONST UINT16  mSmramArenaClassSize[SMRAM_ARENA_CLASS_COUNT];
+
+///
+/// Arena of the pages and of the objects that no arena holds.
+///
+#define SMRAM_ARENA_NONE  0xFF
+
+///
+/// Kinds of the pages of a heap.
+///
+#define SMRAM_ARENA_PAGE_FREE   0   ///< Free.
+#define SMRAM_ARENA_PAGE_SLAB   1   ///< A slab.
+#define SMRAM_ARENA_PAGE_POOL   2   ///< First page of a pool larger than the slabs.
+#define SMRAM_ARENA_PAGE_PAGES  3   ///< First page of pages allocated as pages.
+#define SMRAM_ARENA_PAGE_TAIL   4   ///< Other page of a pool or of pages.
+
+///
+/// What a page of a heap holds. The pages of a run have the Arena of its first page.
+///
+typedef struct {
+  UINT8   Kind;                     ///< SMRAM_ARENA_PAGE_*.
+  UINT8   Arena;                    ///< Index of the arena, SMRAM_ARENA_NONE for a slab.
+  UINT16  Reserved;
+  UINT32  RunPages;                 ///< Pages of the run, on its first page.
+} SMRAM_ARENA_PAGE;
+
+typedef struct _SMRAM_ARENA_SLAB  SMRAM_ARENA_SLAB;
+
+///
+/// The header at the start of the page of a slab. It is followed by the index of the
+/// arena of each object, SMRAM_ARENA_NONE when the object is free, then by the
+/// objects from DataOffset. The free objects are linked through their first bytes.
+///
+struct _SMRAM_ARENA_SLAB {
+  SMRAM_ARENA_SLAB  *Next;          ///< Next slab of the class that has free objects.
+  SMRAM_ARENA_SLAB  *Prev;
+  VOID              *FreeList;
+  UINT16            Class;
+  UINT16            FreeCount;
+  UINT16            Capacity;
+  UINT16            DataOffset;
+};
+
+#define SMRAM_ARENA_SLAB_OWNERS(Slab)  ((UINT8 *) ((SMRAM_ARENA_SLAB *) (Slab) + 1))
+
+struct _SMRAM_ARENA {
+  UINT32                  Signature;
+  UINT8                   Index;
+  SMRAM_ARENA_HEAP        *Heap;
+  SMRAM_ARENA_STATISTICS  Statistics;
+};
+
+struct _SMRAM_ARENA_HEAP {
+  UINT32                Signature;
+  UINT32                TotalPages;
+  UINT32                FreePages;
+  UINT32                HighWaterPages;
+  UINT32                ArenaCount;
+  UINT32                SlabPages;
+  UINT64                SlabFreeBytes;
+  UINT64                Failures;
+  EFI_PHYSICAL_ADDRESS  Base;       ///< Address of the first page handed out.
+  SMRAM_ARENA_PAGE      *Pages;     ///< TotalPages entries.
+  UINT64                *FreeMap;   ///< One bit per page, set when the page is free.
+  ///
+  /// The slabs of each class that have free objects.
+  ///
+  SMRAM_ARENA_SLAB      *Slabs[SMRAM_ARENA_CLASS_COUNT];
+  ///
+  /// The arenas of the SMM System Table, when the heap is behind it.
+  ///
+  SMRAM_ARENA           *DefaultArena;
+  SMRAM_ARENA           *CurrentArena;
+  SMRAM_ARENA           Arenas[SMRAM_ARENA_MAX_ARENAS];
+};
+
+/**
+  Checks the signature of a heap.
+
+  @param  Heap    The heap.
+
+  @retval TRUE    Heap is a heap.
+  @retval FALSE   Heap is NULL or not a heap.
+
+**/
+BOOLEAN
+InternalSmramArenaHeapIsValid (
+  IN SMRAM_ARENA_HEAP  *Heap
+  );
+
+/**
+  Checks the signature of an arena.
+
+  @param  Arena   The arena.
+
+  @retval TRUE    Arena is a created arena.
+  @retval FALSE   Arena is NULL, or not a created arena.
+
+**/
+BOOLEAN
+InternalSmramArenaIsValid (
+  IN SMRAM_ARENA  *Arena
+  );
+
+/**
+  Checks whether an address is in the pages that a heap hands out.
+
+  @param  Heap      The heap.
+  @param  Address   The address.
+
+  @retval TRUE    Address is in the pages of Heap.
+  @retval FALSE   Address is not in the pages of Heap.
+
+**/
+BOOLEAN
+InternalSmramArenaContains (
+  IN SMRAM_ARENA_HEAP      *Heap,
+  IN EFI_PHYSICAL_ADDRESS  Address
+  );
+
+/**
+  Allocates a run of pages, best fit.
+
+  @param  Heap    The heap.
+  @param  Arena   The arena of the run, or NULL for a slab.
+  @param  Count   The number of pages, at least 1.
+  @param  Kind    SMRAM_ARENA_PAGE_SLAB, SMRAM_ARENA_PAGE_POOL or
+                  SMRAM_ARENA_PAGE_PAGES.
+
+  @return The index of the first page, or MAX_UINT32 when no run of Count pages is
+          free.
+
+**/
+UINT32
+InternalSmramArenaAllocateRun (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN SMRAM_ARENA       *Arena,
+  IN UINTN             Count,
+  IN UINT8             Kind
+  );
+
+/**
+  Frees a run of pages.
+
+  @param  Heap    The heap.
+  @param  Index   The index of the first page of the run.
+
+**/
+VOID
+InternalSmramArenaFreeRun (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN UINT32            Index
+  );
+
+/**
+  Measures the fragmentation of the free pages of a heap.
+
+  @param  Heap            The heap.
+  @param  LargestFreeRun  Returns the most contiguous free pages.
+  @param  FreeRuns        Returns the number of runs of free pages.
+
+**/
+VOID
+InternalSmramArenaMeasureFreeRuns (
+  IN  SMRAM_ARENA_HEAP  *Heap,
+  OUT UINT32            *LargestFreeRun,
+  OUT UINT32            *FreeRuns
+  );
+
+#endif
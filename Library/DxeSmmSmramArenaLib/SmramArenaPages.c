@@ -0,0 +1,352 @@
+/** @file
+  Pages of the heaps of the SMRAM arena library.
+
+  The free pages of a heap are kept in a bitmap, so that a freed run merges with
+  the free runs around it without any work. A run is allocated from the smallest
+  free run that holds it, and the scan stops at the first free run of the exact
+  size.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmramArenaInternal.h"
+
+/**
+  Returns the size of the structures of a heap that hands out a number of pages.
+
+  @param  TotalPages    The number of pages.
+
+  @return The size of the structures.
+
+**/
+UINTN
+InternalSmramArenaHeapSize (
+  IN UINTN  TotalPages
+  )
+{
+  return ALIGN_VALUE (sizeof (SMRAM_ARENA_HEAP), sizeof (UINT64)) +
+         ALIGN_VALUE (TotalPages * sizeof (SMRAM_ARENA_PAGE), sizeof (UINT64)) +
+         (TotalPages + 63) / 64 * sizeof (UINT64);
+}
+
+/**
+  Marks a run of pages as free or in use in the bitmap of a heap.
+
+  @param  Heap    The heap.
+  @param  Index   The index of the first page.
+  @param  Count   The number of pages.
+  @param  Free    TRUE to mark the pages free, FALSE to mark them in use.
+
+**/
+VOID
+InternalSmramArenaMarkRun (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN UINTN             Index,
+  IN UINTN             Count,
+  IN BOOLEAN           Free
+  )
+{
+  UINTN   Bit;
+  UINTN   Bits;
+  UINT64  Mask;
+
+  while (Count > 0) {
+    Bit  = Index & 63;
+    Bits = MIN (Count, 64 - Bit);
+    Mask = (Bits == 64) ? MAX_UINT64 : LShiftU64 (LShiftU64 (1, Bits) - 1, Bit);
+    if (Free) {
+      Heap->FreeMap[Index / 64] |= Mask;
+    } else {
+      Heap->FreeMap[Index / 64] &= ~Mask;
+    }
+    Index += Bits;
+    Count -= Bits;
+  }
+}
+
+/**
+  Returns the first page at or after an index whose bit in the bitmap of a heap has
+  a value.
+
+  The bits after the last page are 0, so that a run of free pages ends at the last
+  page.
+
+  @param  Heap    The heap.
+  @param  Index   The index to start at.
+  @param  Free    TRUE to find a free page, FALSE to find a page in use.
+
+  @return The index of the page, or TotalPages when there is none.
+
+**/
+UINTN
+InternalSmramArenaFindPage (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN UINTN             Index,
+  IN BOOLEAN           Free
+  )
+{
+  UINT64  Word;
+
+  while (Index < Heap->TotalPages) {
+    Word = Heap->FreeMap[Index / 64];
+    if (!Free) {
+      Word = ~Word;
+    }
+    Word = RShiftU64 (Word, Index & 63);
+    if (Word != 0) {
+      return MIN (Index + (UINTN) LowBitSet64 (Word), Heap->TotalPages);
+    }
+    Index = (Index | 63) + 1;
+  }
+  return Heap->TotalPages;
+}
+
+/**
+  Builds a heap over a range of SMRAM.
+
+  The heap keeps its own structures at the start of the range, and hands out the
+  rest of the range.
+
+  @param  Base    The start of the range.
+  @param  Size    The size of the range.
+  @param  Heap    Returns the heap.
+
+  @retval EFI_SUCCESS             The heap was built.
+  @retval EFI_INVALID_PARAMETER   Heap is NULL, or the range is too small to hand out
+                                  one page.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaCreateHeap (
+  IN  EFI_PHYSICAL_ADDRESS  Base,
+  IN  UINTN                 Size,
+  OUT SMRAM_ARENA_HEAP      **Heap
+  )
+{
+  SMRAM_ARENA_HEAP  *NewHeap;
+  UINTN             Skip;
+  UINTN             Pages;
+  UINTN             TotalPages;
+  UINTN             Index;
+
+  if (Heap == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The structures of the heap take the first whole pages of the range, and the
+  // heap hands out as many of the following pages as they can describe.
+  //
+  Skip = (UINTN) (ALIGN_VALUE (Base, EFI_PAGE_SIZE) - Base);
+  if (Size <= Skip) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Pages      = (Size - Skip) / EFI_PAGE_SIZE;
+  TotalPages = MIN (Pages, MAX_UINT32 / 2);
+  while (TotalPages > 0 && EFI_SIZE_TO_PAGES (InternalSmramArenaHeapSize (TotalPages)) + TotalPages > Pages) {
+    TotalPages--;
+  }
+  if (TotalPages == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  NewHeap = (SMRAM_ARENA_HEAP *) (UINTN) (Base + Skip);
+  ZeroMem (NewHeap, InternalSmramArenaHeapSize (TotalPages));
+  NewHeap->Signature  = SMRAM_ARENA_HEAP_SIGNATURE;
+  NewHeap->TotalPages = (UINT32) TotalPages;
+  NewHeap->FreePages  = (UINT32) TotalPages;
+  NewHeap->Base       = Base + Skip + EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (InternalSmramArenaHeapSize (TotalPages)));
+  NewHeap->Pages      = (SMRAM_ARENA_PAGE *) ((UINT8 *) NewHeap + ALIGN_VALUE (sizeof (SMRAM_ARENA_HEAP), sizeof (UINT64)));
+  NewHeap->FreeMap    = (UINT64 *) ((UINT8 *) NewHeap->Pages + ALIGN_VALUE (TotalPages * sizeof (SMRAM_ARENA_PAGE), sizeof (UINT64)));
+  InternalSmramArenaMarkRun (NewHeap, 0, TotalPages, TRUE);
+
+  for (Index = 0; Index < SMRAM_ARENA_MAX_ARENAS; Index++) {
+    NewHeap->Arenas[Index].Index = (UINT8) Index;
+    NewHeap->Arenas[Index].Heap  = NewHeap;
+  }
+
+  *Heap = NewHeap;
+  return EFI_SUCCESS;
+}
+
+/**
+  Checks the signature of a heap.
+
+  @param  Heap    The heap.
+
+  @retval TRUE    Heap is a heap.
+  @retval FALSE   Heap is NULL or not a heap.
+
+**/
+BOOLEAN
+InternalSmramArenaHeapIsValid (
+  IN SMRAM_ARENA_HEAP  *Heap
+  )
+{
+  return (BOOLEAN) (Heap != NULL && Heap->Signature == SMRAM_ARENA_HEAP_SIGNATURE);
+}
+
+/**
+  Checks whether an address is in the pages that a heap hands out.
+
+  @param  Heap      The heap.
+  @param  Address   The address.
+
+  @retval TRUE    Address is in the pages of Heap.
+  @retval FALSE   Address is not in the pages of Heap.
+
+**/
+BOOLEAN
+InternalSmramArenaContains (
+  IN SMRAM_ARENA_HEAP      *Heap,
+  IN EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  return (BOOLEAN) (Address >= Heap->Base && Address - Heap->Base < EFI_PAGES_TO_SIZE ((UINT64) Heap->TotalPages));
+}
+
+/**
+  Allocates a run of pages, best fit.
+
+  @param  Heap    The heap.
+  @param  Arena   The arena of the run, or NULL for a slab.
+  @param  Count   The number of pages, at least 1.
+  @param  Kind    SMRAM_ARENA_PAGE_SLAB, SMRAM_ARENA_PAGE_POOL or
+                  SMRAM_ARENA_PAGE_PAGES.
+
+  @return The index of the first page, or MAX_UINT32 when no run of Count pages is
+          free.
+
+**/
+UINT32
+InternalSmramArenaAllocateRun (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN SMRAM_ARENA       *Arena,
+  IN UINTN             Count,
+  IN UINT8             Kind
+  )
+{
+  UINTN  Index;
+  UINTN  Start;
+  UINTN  Best;
+  UINTN  BestCount;
+  UINTN  Page;
+  UINT8  ArenaIndex;
+
+  if (Count > Heap->FreePages) {
+    Heap->Failures++;
+    return MAX_UINT32;
+  }
+
+  Best      = MAX_UINTN;
+  BestCount = MAX_UINTN;
+  Index     = 0;
+  while (Index < Heap->TotalPages) {
+    Start = InternalSmramArenaFindPage (Heap, Index, TRUE);
+    if (Start == Heap->TotalPages) {
+      break;
+    }
+    Index = InternalSmramArenaFindPage (Heap, Start, FALSE);
+    if (Index - Start >= Count && Index - Start < BestCount) {
+      Best      = Start;
+      BestCount = Index - Start;
+      if (BestCount == Count) {
+        break;
+      }
+    }
+  }
+  if (Best == MAX_UINTN) {
+    Heap->Failures++;
+    return MAX_UINT32;
+  }
+
+  ArenaIndex = (Arena != NULL) ? Arena->Index : SMRAM_ARENA_NONE;
+  InternalSmramArenaMarkRun (Heap, Best, Count, FALSE);
+  Heap->Pages[Best].Kind     = Kind;
+  Heap->Pages[Best].Arena    = ArenaIndex;
+  Heap->Pages[Best].RunPages = (UINT32) Count;
+  for (Page = Best + 1; Page < Best + Count; Page++) {
+    Heap->Pages[Page].Kind     = SMRAM_ARENA_PAGE_TAIL;
+    Heap->Pages[Page].Arena    = ArenaIndex;
+    Heap->Pages[Page].RunPages = 0;
+  }
+
+  Heap->FreePages      -= (UINT32) Count;
+  Heap->HighWaterPages  = MAX (Heap->HighWaterPages, Heap->TotalPages - Heap->FreePages);
+  if (Arena != NULL) {
+    Arena->Statistics.Pages          += (UINT32) Count;
+    Arena->Statistics.HighWaterPages  = MAX (Arena->Statistics.HighWaterPages, Arena->Statistics.Pages);
+  }
+  return (UINT32) Best;
+}
+
+/**
+  Frees a run of pages.
+
+  @param  Heap    The heap.
+  @param  Index   The index of the first page of the run.
+
+**/
+VOID
+InternalSmramArenaFreeRun (
+  IN SMRAM_ARENA_HEAP  *Heap,
+  IN UINT32            Index
+  )
+{
+  UINT32  Count;
+  UINT32  Page;
+
+  Count = Heap->Pages[Index].RunPages;
+  ASSERT (Count > 0 && Heap->Pages[Index].Kind != SMRAM_ARENA_PAGE_FREE);
+
+  if (Heap->Pages[Index].Arena != SMRAM_ARENA_NONE) {
+    Heap->Arenas[Heap->Pages[Index].Arena].Statistics.Pages -= Count;
+  }
+  for (Page = Index; Page < Index + Count; Page++) {
+    Heap->Pages[Page].Kind     = SMRAM_ARENA_PAGE_FREE;
+    Heap->Pages[Page].RunPages = 0;
+  }
+  InternalSmramArenaMarkRun (Heap, Index, Count, TRUE);
+  Heap->FreePages += Count;
+}
+
+/**
+  Measures the fragmentation of the free pages of a heap.
+
+  @param  Heap            The heap.
+  @param  LargestFreeRun  Returns the most contiguous free pages.
+  @param  FreeRuns        Returns the number of runs of free pages.
+
+**/
+VOID
+InternalSmramArenaMeasureFreeRuns (
+  IN  SMRAM_ARENA_HEAP  *Heap,
+  OUT UINT32            *LargestFreeRun,
+  OUT UINT32            *FreeRuns
+  )
+{
+  UINTN  Index;
+  UINTN  Start;
+
+  *LargestFreeRun = 0;
+  *FreeRuns       = 0;
+  Index           = 0;
+  while (Index < Heap->TotalPages) {
+    Start = InternalSmramArenaFindPage (Heap, Index, TRUE);
+    if (Start == Heap->TotalPages) {
+      break;
+    }
+    Index           = InternalSmramArenaFindPage (Heap, Start, FALSE);
+    *LargestFreeRun = MAX (*LargestFreeRun, (UINT32) (Index - Start));
+    (*FreeRuns)++;
+  }
+}
@@ -0,0 +1,355 @@
+/** @file
+  Memory services of the SMM System Table over an SMRAM arena heap, and the
+  statistics of the heap.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmramArenaInternal.h"
+
+//
+// The heap behind the SMM System Table, and the services of the SMM core that it
+// replaced.
+//
+SMRAM_ARENA_HEAP            *mSmramArenaHeap = NULL;
+EFI_SMMCORE_ALLOCATE_POOL   mSmramArenaCoreAllocatePool;
+EFI_SMMCORE_FREE_POOL       mSmramArenaCoreFreePool;
+EFI_SMMCORE_ALLOCATE_PAGES  mSmramArenaCoreAllocatePages;
+EFI_SMMCORE_FREE_PAGES      mSmramArenaCoreFreePages;
+
+/**
+  Allocates pool memory from the current arena, or from the SMM core when the heap
+  is full.
+
+  @param  PoolType         The type of pool to allocate.
+  @param  Size             The number of bytes to allocate from the pool.
+  @param  Buffer           A pointer to a pointer to the allocated buffer if the call
+                           succeeds; undefined otherwise.
+
+  @retval EFI_SUCCESS           The requested number of bytes was allocated.
+  @retval EFI_OUT_OF_RESOURCES  The pool requested could not be allocated.
+  @retval EFI_INVALID_PARAMETER PoolType was invalid.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaSmmAllocatePool (
+  IN  EFI_MEMORY_TYPE  PoolType,
+  IN  UINTN            Size,
+  OUT VOID             **Buffer
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = SmramArenaAllocatePool (mSmramArenaHeap->CurrentArena, Size, Buffer);
+  if (Status == EFI_OUT_OF_RESOURCES) {
+    Status = mSmramArenaCoreAllocatePool (PoolType, Size, Buffer);
+  }
+  return Status;
+}
+
+/**
+  Returns pool memory to the heap or to the SMM core.
+
+  @param  Buffer           The pointer to the buffer to free.
+
+  @retval EFI_SUCCESS           The memory was returned to the system.
+  @retval EFI_INVALID_PARAMETER Buffer was invalid.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaSmmFreePool (
+  IN VOID  *Buffer
+  )
+{
+  if (InternalSmramArenaContains (mSmramArenaHeap, (EFI_PHYSICAL_ADDRESS) (UINTN) Buffer)) {
+    return SmramArenaFreePool (mSmramArenaHeap, Buffer);
+  }
+  return mSmramArenaCoreFreePool (Buffer);
+}
+
+/**
+  Allocates pages from the current arena, or from the SMM core when the heap is full
+  or the pages must be at given addresses.
+
+  @param  Type                   The type of allocation to perform.
+  @param  MemoryType             The type of memory to allocate.
+  @param  NumberOfPages          The number of contiguous pages to allocate.
+  @param  Memory                 The pointer to a physical address. On input, the
+                                 way in which the address is used depends on the
+                                 value of Type.
+
+  @retval EFI_SUCCESS            The requested pages were allocated.
+  @retval EFI_OUT_OF_RESOURCES   The pages could not be allocated.
+  @retval EFI_INVALID_PARAMETER  Type is not AllocateAnyPages or
+                                 AllocateMaxAddress or AllocateAddress, or
+                                 MemoryType is in the range EfiMaxMemoryType..0x7FFFFFFF.
+  @retval EFI_NOT_FOUND          The requested pages could not be found.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaSmmAllocatePages (
+  IN     EFI_ALLOCATE_TYPE     Type,
+  IN     EFI_MEMORY_TYPE       MemoryType,
+  IN     UINTN                 NumberOfPages,
+  IN OUT EFI_PHYSICAL_ADDRESS  *Memory
+  )
+{
+  EFI_STATUS  Status;
+
+  if (Type == AllocateAnyPages && NumberOfPages != 0) {
+    Status = SmramArenaAllocatePages (mSmramArenaHeap->CurrentArena, NumberOfPages, Memory);
+    if (Status != EFI_OUT_OF_RESOURCES) {
+      return Status;
+    }
+  }
+  return mSmramArenaCoreAllocatePages (Type, MemoryType, NumberOfPages, Memory);
+}
+
+/**
+  Frees memory pages to the heap or to the SMM core.
+
+  @param  Memory                 The base physical address of the pages to be freed.
+  @param  NumberOfPages          The number of contiguous pages to free.
+
+  @retval EFI_SUCCESS            The requested memory pages were freed.
+  @retval EFI_INVALID_PARAMETER  Memory is not a page-aligned address or NumberOfPages is invalid.
+  @retval EFI_NOT_FOUND          The requested memory pages were not allocated with SmmAllocatePages().
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaSmmFreePages (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages
+  )
+{
+  if (InternalSmramArenaContains (mSmramArenaHeap, Memory)) {
+    return SmramArenaFreePages (mSmramArenaHeap, Memory, NumberOfPages);
+  }
+  return mSmramArenaCoreFreePages (Memory, NumberOfPages);
+}
+
+/**
+  Puts a heap behind the memory services of the SMM System Table.
+
+  SmmAllocatePool() and SmmAllocatePages() with AllocateAnyPages allocate from the
+  current arena, and from the SMM core when the heap is full. SmmFreePool() and
+  SmmFreePages() free to the heap the memory of the heap, and to the SMM core the
+  rest. Only one heap can be put behind the SMM System Table.
+
+  @param  Heap            The heap.
+  @param  Smst            The SMM System Table.
+  @param  DefaultArena    The arena that is current when no other is.
+
+  @retval EFI_SUCCESS             The heap is behind the SMM System Table.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, or DefaultArena is not an
+                                  arena of Heap.
+  @retval EFI_ALREADY_STARTED     A heap is already behind the SMM System Table.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaHookSmst (
+  IN SMRAM_ARENA_HEAP      *Heap,
+  IN EFI_SMM_SYSTEM_TABLE  *Smst,
+  IN SMRAM_ARENA           *DefaultArena
+  )
+{
+  if (!InternalSmramArenaHeapIsValid (Heap) || Smst == NULL ||
+      !InternalSmramArenaIsValid (DefaultArena) || DefaultArena->Heap != Heap) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (mSmramArenaHeap != NULL) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  Heap->DefaultArena = DefaultArena;
+  Heap->CurrentArena = DefaultArena;
+  mSmramArenaHeap    = Heap;
+
+  mSmramArenaCoreAllocatePool  = Smst->SmmAllocatePool;
+  mSmramArenaCoreFreePool      = Smst->SmmFreePool;
+  mSmramArenaCoreAllocatePages = Smst->SmmAllocatePages;
+  mSmramArenaCoreFreePages     = Smst->SmmFreePages;
+  Smst->SmmAllocatePool        = SmramArenaSmmAllocatePool;
+  Smst->SmmFreePool            = SmramArenaSmmFreePool;
+  Smst->SmmAllocatePages       = SmramArenaSmmAllocatePages;
+  Smst->SmmFreePages           = SmramArenaSmmFreePages;
+  return EFI_SUCCESS;
+}
+
+/**
+  Makes an arena current, for the allocations through the SMM System Table.
+
+  The loader of the SMM drivers makes the arena of a driver current before it
+  calls the entry point of the driver or one of its handlers, and puts back the
+  previous one after.
+
+  @param  Arena   The arena, or NULL for the default arena.
+
+  @return The arena that was current, or NULL when no heap is behind the SMM
+          System Table.
+
+**/
+SMRAM_ARENA *
+EFIAPI
+SmramArenaSetCurrent (
+  IN SMRAM_ARENA  *Arena
+  )
+{
+  SMRAM_ARENA  *Previous;
+
+  if (mSmramArenaHeap == NULL) {
+    return NULL;
+  }
+
+  Previous = mSmramArenaHeap->CurrentArena;
+  if (InternalSmramArenaIsValid (Arena) && Arena->Heap == mSmramArenaHeap) {
+    mSmramArenaHeap->CurrentArena = Arena;
+  } else {
+    ASSERT (Arena == NULL);
+    mSmramArenaHeap->CurrentArena = mSmramArenaHeap->DefaultArena;
+  }
+  return Previous;
+}
+
+/**
+  Returns the statistics of a heap.
+
+  @param  Heap          The heap.
+  @param  Statistics    Returns the statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Heap or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaGetStatistics (
+  IN  SMRAM_ARENA_HEAP             *Heap,
+  OUT SMRAM_ARENA_HEAP_STATISTICS  *Statistics
+  )
+{
+  if (!InternalSmramArenaHeapIsValid (Heap) || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Statistics->TotalPages     = Heap->TotalPages;
+  Statistics->FreePages      = Heap->FreePages;
+  Statistics->HighWaterPages = Heap->HighWaterPages;
+  Statistics->ArenaCount     = Heap->ArenaCount;
+  Statistics->SlabPages      = Heap->SlabPages;
+  Statistics->Reserved       = 0;
+  Statistics->SlabFreeBytes  = Heap->SlabFreeBytes;
+  Statistics->Failures       = Heap->Failures;
+  InternalSmramArenaMeasureFreeRuns (Heap, &Statistics->LargestFreeRun, &Statistics->FreeRuns);
+  return EFI_SUCCESS;
+}
+
+/**
+  Answers a query of the statistics sent through Communicate().
+
+  The driver that owns the heap calls this function from the callback that it
+  registered with EFI_SMM_BASE_PROTOCOL.RegisterCallback(). The query is read once
+  into SMRAM before it is checked, and the arenas returned never go beyond
+  MessageLength or SourceSize.
+
+  @param  Heap                  The heap.
+  @param  CommunicationBuffer   The EFI_SMM_COMMUNICATE_HEADER of the message.
+  @param  SourceSize            On input, the size of CommunicationBuffer. On
+                                output, the size of the answer.
+  @param  SmramRanges           The SMRAM ranges, that CommunicationBuffer must not
+                                overlap.
+  @param  SmramRangeCount       The number of SMRAM ranges.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_UNSUPPORTED         The message is not a query of the statistics.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, CommunicationBuffer overlaps
+                                  SMRAM or the end of the address space, or the
+                                  message does not fit in CommunicationBuffer or is
+                                  too small for a query.
+
+**/
+EFI_STATUS
+EFIAPI
+SmramArenaCommunicate (
+  IN     SMRAM_ARENA_HEAP            *Heap,
+  IN OUT VOID                        *CommunicationBuffer,
+  IN OUT UINTN                       *SourceSize,
+  IN     CONST EFI_SMRAM_DESCRIPTOR  *SmramRanges,
+  IN     UINTN                       SmramRangeCount
+  )
+{
+  EFI_SMM_COMMUNICATE_HEADER    *Header;
+  SMRAM_ARENA_STATISTICS_QUERY  *Message;
+  SMRAM_ARENA_STATISTICS_QUERY  Query;
+  UINTN                         Size;
+  UINTN                         MessageLength;
+  UINTN                         Capacity;
+  UINTN                         Count;
+  UINTN                         Index;
+  EFI_PHYSICAL_ADDRESS          Buffer;
+
+  if (!InternalSmramArenaHeapIsValid (Heap) || CommunicationBuffer == NULL || SourceSize == NULL ||
+      (SmramRanges == NULL && SmramRangeCount != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The sizes are read once, so that the checks hold for the rest of the call.
+  // The answer is written over the whole buffer, which must not reach SMRAM.
+  //
+  Size   = *SourceSize;
+  Header = (EFI_SMM_COMMUNICATE_HEADER *) CommunicationBuffer;
+  Buffer = (EFI_PHYSICAL_ADDRESS) (UINTN) CommunicationBuffer;
+  if (Size < OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) || Size - 1 > MAX_ADDRESS - Buffer) {
+    return EFI_INVALID_PARAMETER;
+  }
+  for (Index = 0; Index < SmramRangeCount; Index++) {
+    if (Buffer < SmramRanges[Index].CpuStart + SmramRanges[Index].PhysicalSize &&
+        SmramRanges[Index].CpuStart < Buffer + Size) {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+  if (!CompareGuid (&Header->HeaderGuid, &gFrameworkSmramArenaStatisticsGuid)) {
+    return EFI_UNSUPPORTED;
+  }
+  MessageLength = Header->MessageLength;
+  if (MessageLength > Size - OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) ||
+      MessageLength < OFFSET_OF (SMRAM_ARENA_STATISTICS_QUERY, Arenas)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Message = (SMRAM_ARENA_STATISTICS_QUERY *) Header->Data;
+  CopyMem (&Query, Message, OFFSET_OF (SMRAM_ARENA_STATISTICS_QUERY, Arenas));
+
+  Capacity = (MessageLength - OFFSET_OF (SMRAM_ARENA_STATISTICS_QUERY, Arenas)) / sizeof (SMRAM_ARENA_STATISTICS);
+  Capacity = MIN (Capacity, Query.ArenaCount);
+  Count    = 0;
+  for (Index = Query.NextIndex; Index < SMRAM_ARENA_MAX_ARENAS && Count < Capacity; Index++) {
+    if (Heap->Arenas[Index].Signature == SMRAM_ARENA_SIGNATURE) {
+      CopyMem (&Message->Arenas[Count], &Heap->Arenas[Index].Statistics, sizeof (SMRAM_ARENA_STATISTICS));
+      Count++;
+    }
+  }
+
+  Query.NextIndex  = (UINT32) MAX (Index, Query.NextIndex);
+  Query.ArenaCount = (UINT32) Count;
+  SmramArenaGetStatistics (Heap, &Query.Heap);
+  CopyMem (Message, &Query, OFFSET_OF (SMRAM_ARENA_STATISTICS_QUERY, Arenas));
+
+  MessageLength         = OFFSET_OF (SMRAM_ARENA_STATISTICS_QUERY, Arenas) + Count * sizeof (SMRAM_ARENA_STATISTICS);
+  Header->MessageLength = MessageLength;
+  *SourceSize           = OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) + MessageLength;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,317 @@
+/** @file
+  SMI source demultiplexer library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmmSourceDemuxInternal.h"
+
+/**
+  Returns the value of a status register from the read buffer.
+
+  @param  Demux     The demultiplexer.
+  @param  Register  The status register.
+
+  @return The value of the register.
+
+**/
+UINT64
+InternalSmmDemuxGetValue (
+  IN SMM_DEMUX                 *Demux,
+  IN CONST SMM_DEMUX_REGISTER  *Register
+  )
+{
+  UINT8  *Value;
+
+  Value = (UINT8 *) Demux->Buffer + Register->Offset;
+  switch (Register->Width) {
+  case SMM_IO_UINT8:
+    return *Value;
+  case SMM_IO_UINT16:
+    return *(UINT16 *) Value;
+  case SMM_IO_UINT32:
+    return *(UINT32 *) Value;
+  default:
+    return *(UINT64 *) Value;
+  }
+}
+
+/**
+  Creates an SMI source demultiplexer.
+
+  @param  Smst    The SMM System Table, whose SmmIo reads the status registers and
+                  whose SmmAllocatePool() allocates the demultiplexer.
+  @param  Demux   Returns the demultiplexer.
+
+  @retval EFI_SUCCESS             The demultiplexer was created.
+  @retval EFI_INVALID_PARAMETER   Smst or Demux is NULL.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmDemuxCreate (
+  IN  EFI_SMM_SYSTEM_TABLE  *Smst,
+  OUT SMM_DEMUX             **Demux
+  )
+{
+  EFI_STATUS  Status;
+  SMM_DEMUX   *Instance;
+
+  if (Smst == NULL || Demux == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = Smst->SmmAllocatePool (EfiRuntimeServicesData, sizeof (SMM_DEMUX), (VOID **) &Instance);
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  ZeroMem (Instance, sizeof (SMM_DEMUX));
+  Instance->Signature = SMM_DEMUX_SIGNATURE;
+  Instance->Smst      = Smst;
+
+  *Demux = Instance;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees an SMI source demultiplexer.
+
+  @param  Demux   The demultiplexer.
+
+**/
+VOID
+EFIAPI
+SmmDemuxDestroy (
+  IN SMM_DEMUX  *Demux
+  )
+{
+  if (Demux == NULL || Demux->Signature != SMM_DEMUX_SIGNATURE) {
+    return;
+  }
+  Demux->Signature = 0;
+  Demux->Smst->SmmFreePool (Demux);
+}
+
+/**
+  Adds a source to a demultiplexer.
+
+  @param  Demux         The demultiplexer.
+  @param  Source        The source, which is copied.
+  @param  SourceHandle  Returns the handle of the source.
+
+  @retval EFI_SUCCESS             The source was added.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL, the space or the width of
+                                  the status register is not valid, or StatusMask
+                                  is 0 or has bits beyond the width.
+  @retval EFI_OUT_OF_RESOURCES    The demultiplexer already holds
+                                  SMM_DEMUX_MAX_SOURCES sources.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmDemuxAddSource (
+  IN  SMM_DEMUX               *Demux,
+  IN  CONST SMM_DEMUX_SOURCE  *Source,
+  OUT UINTN                   *SourceHandle
+  )
+{
+  SMM_DEMUX_SLOT  *Slot;
+  UINTN           Index;
+
+  if (Demux == NULL || Demux->Signature != SMM_DEMUX_SIGNATURE ||
+      Source == NULL || Source->Handler == NULL || SourceHandle == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((UINTN) Source->Space >= SmmDemuxSpaceMaximum || (UINTN) Source->Width > SMM_IO_UINT64) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Source->StatusMask == 0 ||
+      (Source->Width < SMM_IO_UINT64 && RShiftU64 (Source->StatusMask, 8 << Source->Width) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (Index = 0; Index < SMM_DEMUX_MAX_SOURCES; Index++) {
+    if (!Demux->Slots[Index].InUse) {
+      break;
+    }
+  }
+  if (Index == SMM_DEMUX_MAX_SOURCES) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Slot = &Demux->Slots[Index];
+  CopyMem (&Slot->Source, Source, sizeof (SMM_DEMUX_SOURCE));
+  Slot->InUse    = TRUE;
+  Slot->Sequence = Demux->NextSequence++;
+  InternalSmmDemuxBuildPlan (Demux);
+
+  *SourceHandle = Index;
+  return EFI_SUCCESS;
+}
+
+/**
+  Removes a source from a demultiplexer.
+
+  @param  Demux         The demultiplexer.
+  @param  SourceHandle  The handle of the source.
+
+  @retval EFI_SUCCESS             The source was removed.
+  @retval EFI_INVALID_PARAMETER   Demux is NULL, or SourceHandle is not a source of
+                                  the demultiplexer.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmDemuxRemoveSource (
+  IN SMM_DEMUX  *Demux,
+  IN UINTN      SourceHandle
+  )
+{
+  if (Demux == NULL || Demux->Signature != SMM_DEMUX_SIGNATURE ||
+      SourceHandle >= SMM_DEMUX_MAX_SOURCES || !Demux->Slots[SourceHandle].InUse) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Demux->Slots[SourceHandle].InUse = FALSE;
+  InternalSmmDemuxBuildPlan (Demux);
+  return EFI_SUCCESS;
+}
+
+/**
+  Reads the status registers and calls the handlers of the pending sources.
+
+  The status bits are read once, before the first handler is called.
+
+  @param  Demux   The demultiplexer.
+
+  @return The number of handlers called. 0 means that no source was pending.
+
+**/
+UINTN
+EFIAPI
+SmmDemuxDispatch (
+  IN SMM_DEMUX  *Demux
+  )
+{
+  EFI_SMM_CPU_IO_INTERFACE  *SmmIo;
+  EFI_SMM_IO_ACCESS         *Access;
+  SMM_DEMUX_RUN             *Run;
+  SMM_DEMUX_REGISTER        *Register;
+  SMM_DEMUX_SLOT            *Slot;
+  SMM_DEMUX_SOURCE          Source;
+  UINT64                    Values[SMM_DEMUX_MAX_SOURCES];
+  UINT8                     Slots[SMM_DEMUX_MAX_SOURCES];
+  UINT32                    Sequences[SMM_DEMUX_MAX_SOURCES];
+  UINT64                    Pending;
+  UINT64                    Sources;
+  UINT64                    Status;
+  UINTN                     Index;
+  INTN                      Bit;
+  UINTN                     Dispatched;
+
+  if (Demux == NULL || Demux->Signature != SMM_DEMUX_SIGNATURE) {
+    return 0;
+  }
+  Demux->Statistics.Smis++;
+
+  //
+  // One read per run of adjacent registers.
+  //
+  SmmIo = &Demux->Smst->SmmIo;
+  for (Index = 0; Index < Demux->RunCount; Index++) {
+    Run    = &Demux->Runs[Index];
+    Access = (Run->Space == SmmDemuxIo) ? &SmmIo->Io : &SmmIo->Mem;
+    if (EFI_ERROR (Access->Read (SmmIo, Run->Width, Run->Address, Run->Count, (UINT8 *) Demux->Buffer + Run->Offset))) {
+      //
+      // The sources of a register that cannot be read are not pending.
+      //
+      ZeroMem ((UINT8 *) Demux->Buffer + Run->Offset, Run->Count << Run->Width);
+    }
+  }
+  Demux->Statistics.Reads += Demux->RunCount;
+
+  //
+  // The pending bitmap, in priority order.
+  //
+  Pending = 0;
+  for (Index = 0; Index < Demux->RegisterCount; Index++) {
+    Register = &Demux->Registers[Index];
+    Status   = InternalSmmDemuxGetValue (Demux, Register);
+    if (Status == 0) {
+      continue;
+    }
+    for (Sources = Register->Sources; Sources != 0; Sources &= Sources - 1) {
+      Bit  = LowBitSet64 (Sources);
+      Slot = &Demux->Slots[Demux->Order[Bit]];
+      if ((Status & Slot->Source.StatusMask) != 0) {
+        Pending     |= LShiftU64 (1, (UINTN) Bit);
+        Values[Bit]    = Status & Slot->Source.StatusMask;
+        Slots[Bit]     = Demux->Order[Bit];
+        Sequences[Bit] = Slot->Sequence;
+      }
+    }
+  }
+  if (Pending == 0) {
+    Demux->Statistics.Spurious++;
+    return 0;
+  }
+
+  //
+  // The handlers may add or remove sources, which builds the plan again, so the
+  // slots of the pending sources were taken before the first handler is called.
+  // A source removed by an earlier handler is skipped, even if another source was
+  // added in its slot since, which the sequence of the slot tells. The source is
+  // copied before its handler is called, so that the status is written back to
+  // its register even if the handler removes it.
+  //
+  Dispatched = 0;
+  for (; Pending != 0; Pending &= Pending - 1) {
+    Bit  = LowBitSet64 (Pending);
+    Slot = &Demux->Slots[Slots[Bit]];
+    if (!Slot->InUse || Slot->Sequence != Sequences[Bit]) {
+      continue;
+    }
+    CopyMem (&Source, &Slot->Source, sizeof (Source));
+    Source.Handler (Source.Context, Values[Bit]);
+    if (Source.ClearStatus) {
+      Access = (Source.Space == SmmDemuxIo) ? &SmmIo->Io : &SmmIo->Mem;
+      Access->Write (SmmIo, Source.Width, Source.Address, 1, &Values[Bit]);
+    }
+    Dispatched++;
+  }
+  Demux->Statistics.Dispatched += Dispatched;
+  return Dispatched;
+}
+
+/**
+  Returns the counters of a demultiplexer.
+
+  @param  Demux         The demultiplexer.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   Demux or Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmDemuxGetStatistics (
+  IN  SMM_DEMUX             *Demux,
+  OUT SMM_DEMUX_STATISTICS  *Statistics
+  )
+{
+  if (Demux == NULL || Demux->Signature != SMM_DEMUX_SIGNATURE || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  CopyMem (Statistics, &Demux->Statistics, sizeof (SMM_DEMUX_STATISTICS));
+  return EFI_SUCCESS;
+}
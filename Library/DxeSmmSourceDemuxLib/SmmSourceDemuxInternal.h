@@ -0,0 +1,98 @@
+/** @file
+  Internal definitions of the SMI source demultiplexer library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_SOURCE_DEMUX_INTERNAL_H_
+#define _SMM_SOURCE_DEMUX_INTERNAL_H_
+
+#include <FrameworkSmm.h>
+
+#include <Library/SmmSourceDemuxLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#define SMM_DEMUX_SIGNATURE  SIGNATURE_32 ('S', 'M', 'D', 'X')
+
+///
+/// A source, at the slot given by its handle.
+///
+typedef struct {
+  SMM_DEMUX_SOURCE  Source;
+  BOOLEAN           InUse;
+  UINT32            Sequence;       ///< Order of addition, for the sources of the same priority.
+  UINT8             Register;       ///< Index of the status register in the plan.
+} SMM_DEMUX_SLOT;
+
+///
+/// A distinct status register.
+///
+typedef struct {
+  SMM_DEMUX_SPACE   Space;
+  EFI_SMM_IO_WIDTH  Width;
+  UINT64            Address;
+  UINT32            Offset;         ///< Offset of the value in the read buffer.
+  ///
+  /// The sources that use the register, as bits of the pending bitmap.
+  ///
+  UINT64            Sources;
+} SMM_DEMUX_REGISTER;
+
+///
+/// Adjacent status registers of the same space and width, read with one call.
+///
+typedef struct {
+  SMM_DEMUX_SPACE   Space;
+  EFI_SMM_IO_WIDTH  Width;
+  UINT64            Address;
+  UINT32            Count;
+  UINT32            Offset;         ///< Offset of the first value in the read buffer.
+} SMM_DEMUX_RUN;
+
+struct _SMM_DEMUX {
+  UINT32                Signature;
+  EFI_SMM_SYSTEM_TABLE  *Smst;
+  UINT32                NextSequence;
+  SMM_DEMUX_SLOT        Slots[SMM_DEMUX_MAX_SOURCES];
+
+  //
+  // The plan, built again whenever a source is added or removed. Bit N of the
+  // pending bitmap is the source of Order[N], so the lowest bit set is the pending
+  // source of highest priority.
+  //
+  UINTN                 SourceCount;
+  UINT8                 Order[SMM_DEMUX_MAX_SOURCES];
+  UINTN                 RegisterCount;
+  SMM_DEMUX_REGISTER    Registers[SMM_DEMUX_MAX_SOURCES];
+  UINTN                 RunCount;
+  SMM_DEMUX_RUN         Runs[SMM_DEMUX_MAX_SOURCES];
+  ///
+  /// The values read, each aligned on its width. The alignment of the runs takes
+  /// less than one register each.
+  ///
+  UINT64                Buffer[SMM_DEMUX_MAX_SOURCES * 2];
+
+  SMM_DEMUX_STATISTICS  Statistics;
+};
+
+/**
+  Builds the plan of a demultiplexer from its sources.
+
+  @param  Demux   The demultiplexer.
+
+**/
+VOID
+InternalSmmDemuxBuildPlan (
+  IN OUT SMM_DEMUX  *Demux
+  );
+
+#endif
@@ -0,0 +1,183 @@
+/** @file
+  Plan of the SMI source demultiplexer library.
+
+  The plan orders the sources by priority, lists the distinct status registers
+  sorted by space, width and address, and groups the adjacent ones into runs
+  that SmmDemuxDispatch() reads with one call each.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmmSourceDemuxInternal.h"
+
+/**
+  Compares two status registers by space, width and address.
+
+  @param  Space1    The space of the first register.
+  @param  Width1    The width of the first register.
+  @param  Address1  The address of the first register.
+  @param  Register2 The second register.
+
+  @retval <0    The first register comes first.
+  @retval 0     The registers are the same.
+  @retval >0    The second register comes first.
+
+**/
+INTN
+InternalSmmDemuxCompareRegister (
+  IN SMM_DEMUX_SPACE           Space1,
+  IN EFI_SMM_IO_WIDTH          Width1,
+  IN UINT64                    Address1,
+  IN CONST SMM_DEMUX_REGISTER  *Register2
+  )
+{
+  if (Space1 != Register2->Space) {
+    return (Space1 < Register2->Space) ? -1 : 1;
+  }
+  if (Width1 != Register2->Width) {
+    return (Width1 < Register2->Width) ? -1 : 1;
+  }
+  if (Address1 != Register2->Address) {
+    return (Address1 < Register2->Address) ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+  Finds the status register of a source in the plan.
+
+  @param  Demux     The demultiplexer.
+  @param  Source    The source.
+
+  @return The index of the register, or RegisterCount if it is not in the plan.
+
+**/
+UINTN
+InternalSmmDemuxFindRegister (
+  IN SMM_DEMUX               *Demux,
+  IN CONST SMM_DEMUX_SOURCE  *Source
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Demux->RegisterCount; Index++) {
+    if (InternalSmmDemuxCompareRegister (Source->Space, Source->Width, Source->Address, &Demux->Registers[Index]) == 0) {
+      break;
+    }
+  }
+  return Index;
+}
+
+/**
+  Builds the plan of a demultiplexer from its sources.
+
+  @param  Demux   The demultiplexer.
+
+**/
+VOID
+InternalSmmDemuxBuildPlan (
+  IN OUT SMM_DEMUX  *Demux
+  )
+{
+  SMM_DEMUX_SLOT      *Slot;
+  SMM_DEMUX_SLOT      *Other;
+  SMM_DEMUX_REGISTER  Register;
+  SMM_DEMUX_RUN       *Run;
+  UINTN               Index;
+  UINTN               Position;
+  UINT32              Offset;
+  UINT32              Size;
+
+  //
+  // Sources by priority, then by order of addition.
+  //
+  Demux->SourceCount = 0;
+  for (Index = 0; Index < SMM_DEMUX_MAX_SOURCES; Index++) {
+    Slot = &Demux->Slots[Index];
+    if (!Slot->InUse) {
+      continue;
+    }
+    for (Position = Demux->SourceCount; Position > 0; Position--) {
+      Other = &Demux->Slots[Demux->Order[Position - 1]];
+      if (Other->Source.Priority < Slot->Source.Priority ||
+          (Other->Source.Priority == Slot->Source.Priority && Other->Sequence < Slot->Sequence)) {
+        break;
+      }
+      Demux->Order[Position] = Demux->Order[Position - 1];
+    }
+    Demux->Order[Position] = (UINT8) Index;
+    Demux->SourceCount++;
+  }
+
+  //
+  // Distinct status registers, sorted.
+  //
+  Demux->RegisterCount = 0;
+  for (Index = 0; Index < Demux->SourceCount; Index++) {
+    Slot = &Demux->Slots[Demux->Order[Index]];
+    if (InternalSmmDemuxFindRegister (Demux, &Slot->Source) < Demux->RegisterCount) {
+      continue;
+    }
+    for (Position = Demux->RegisterCount; Position > 0; Position--) {
+      if (InternalSmmDemuxCompareRegister (
+            Slot->Source.Space,
+            Slot->Source.Width,
+            Slot->Source.Address,
+            &Demux->Registers[Position - 1]
+            ) > 0) {
+        break;
+      }
+      Demux->Registers[Position] = Demux->Registers[Position - 1];
+    }
+    ZeroMem (&Register, sizeof (Register));
+    Register.Space   = Slot->Source.Space;
+    Register.Width   = Slot->Source.Width;
+    Register.Address = Slot->Source.Address;
+    Demux->Registers[Position] = Register;
+    Demux->RegisterCount++;
+  }
+
+  //
+  // Runs of adjacent registers, and the place of every value in the read buffer.
+  //
+  Demux->RunCount = 0;
+  Run             = NULL;
+  Offset          = 0;
+  for (Index = 0; Index < Demux->RegisterCount; Index++) {
+    Size = 1 << Demux->Registers[Index].Width;
+    if (Run == NULL || Run->Space != Demux->Registers[Index].Space || Run->Width != Demux->Registers[Index].Width ||
+        Run->Address + MultU64x32 (Run->Count, Size) != Demux->Registers[Index].Address) {
+      Run          = &Demux->Runs[Demux->RunCount++];
+      Run->Space   = Demux->Registers[Index].Space;
+      Run->Width   = Demux->Registers[Index].Width;
+      Run->Address = Demux->Registers[Index].Address;
+      Run->Count   = 0;
+      Offset       = ALIGN_VALUE (Offset, Size);
+      Run->Offset  = Offset;
+    }
+    Run->Count++;
+    Demux->Registers[Index].Offset = Offset;
+    Offset += Size;
+  }
+
+  //
+  // The pending bitmap of every register.
+  //
+  for (Index = 0; Index < Demux->SourceCount; Index++) {
+    Slot           = &Demux->Slots[Demux->Order[Index]];
+    Slot->Register = (UINT8) InternalSmmDemuxFindRegister (Demux, &Slot->Source);
+    Demux->Registers[Slot->Register].Sources |= LShiftU64 (1, Index);
+  }
+
+  Demux->Statistics.Sources     = Demux->SourceCount;
+  Demux->Statistics.Registers   = Demux->RegisterCount;
+  Demux->Statistics.ReadsPerSmi = Demux->RunCount;
+}
@@ -0,0 +1,322 @@
+/** @file
+  Software SMI parent dispatch library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "SmmSwDispatchInternal.h"
+
+/**
+  Register a child SMI source dispatch function with a parent SMM driver.
+
+  @param  This                  The pointer to the EFI_SMM_SW_DISPATCH_PROTOCOL instance.
+  @param  DispatchFunction      The function to install.
+  @param  DispatchContext       The pointer to the dispatch function's context.
+  @param  DispatchHandle        The handle generated by the dispatcher to track
+                                the function instance.
+
+  @retval EFI_SUCCESS           The dispatch function has been successfully
+                                registered.
+  @retval EFI_INVALID_PARAMETER DispatchContext is invalid. The SW SMI input value
+                                is not within valid range, or already has a child.
+
+**/
+EFI_STATUS
+EFIAPI
+InternalSmmSwDispatchRegister (
+  IN  EFI_SMM_SW_DISPATCH_PROTOCOL  *This,
+  IN  EFI_SMM_SW_DISPATCH           DispatchFunction,
+  IN  EFI_SMM_SW_DISPATCH_CONTEXT   *DispatchContext,
+  OUT EFI_HANDLE                    *DispatchHandle
+  )
+{
+  SMM_SW_DISPATCH_INSTANCE  *Instance;
+  SMM_SW_DISPATCH_SLOT      *Slot;
+
+  Instance = SMM_SW_DISPATCH_INSTANCE_FROM_THIS (This);
+  if (DispatchFunction == NULL || DispatchContext == NULL || DispatchHandle == NULL ||
+      DispatchContext->SwSmiInputValue > This->MaximumSwiValue) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The parent only allows a single child registration for each SwSmiInputValue.
+  //
+  Slot = &Instance->Slots[DispatchContext->SwSmiInputValue];
+  if (InterlockedCompareExchangePointer (&Slot->Function, NULL, (VOID *) (UINTN) DispatchFunction) != NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The generation cannot change while the slot has a child, since only the
+  // UnRegister() of the handle of that child moves it.
+  //
+  *DispatchHandle = SMM_SW_DISPATCH_HANDLE (Slot->Generation, DispatchContext->SwSmiInputValue);
+  return EFI_SUCCESS;
+}
+
+/**
+  Unregister a child SMI source dispatch function with a parent SMM driver.
+
+  @param  This                  The pointer to the EFI_SMM_SW_DISPATCH_PROTOCOL instance.
+  @param  DispatchHandle        The handle of the service to remove.
+
+  @retval EFI_SUCCESS           The dispatch function has been successfully
+                                unregistered.
+  @retval EFI_INVALID_PARAMETER The handle is invalid.
+
+**/
+EFI_STATUS
+EFIAPI
+InternalSmmSwDispatchUnRegister (
+  IN EFI_SMM_SW_DISPATCH_PROTOCOL  *This,
+  IN EFI_HANDLE                    DispatchHandle
+  )
+{
+  SMM_SW_DISPATCH_INSTANCE  *Instance;
+  SMM_SW_DISPATCH_SLOT      *Slot;
+  UINT32                    Generation;
+  VOID                      *Function;
+
+  Instance = SMM_SW_DISPATCH_INSTANCE_FROM_THIS (This);
+
+  //
+  // The handle must be the one of the current child of its slot.
+  //
+  if (SMM_SW_DISPATCH_HANDLE_VALUE (DispatchHandle) > This->MaximumSwiValue) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Slot       = &Instance->Slots[SMM_SW_DISPATCH_HANDLE_VALUE (DispatchHandle)];
+  Generation = Slot->Generation;
+  Function   = Slot->Function;
+  if (Function == NULL || SMM_SW_DISPATCH_HANDLE_GENERATION (DispatchHandle) != Generation) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Moving the generation first makes this call the only one to remove the child,
+  // and invalidates its handle before the slot can be registered again.
+  //
+  if (InterlockedCompareExchange32 (
+        (UINT32 *) &Slot->Generation,
+        Generation,
+        (Generation % SMM_SW_DISPATCH_GENERATION_MAX) + 1
+        ) != Generation) {
+    return EFI_INVALID_PARAMETER;
+  }
+  InterlockedCompareExchangePointer (&Slot->Function, Function, NULL);
+  return EFI_SUCCESS;
+}
+
+/**
+  Creates a software SMI dispatch instance.
+
+  @param  Smst              The SMM System Table, whose SmmAllocatePool() allocates
+                            the instance.
+  @param  MaximumSwiValue   The largest input value that can be registered, below
+                            SMM_SW_DISPATCH_VALUE_COUNT.
+  @param  SwDispatch        Returns the instance.
+
+  @retval EFI_SUCCESS             The instance was created.
+  @retval EFI_INVALID_PARAMETER   Smst or SwDispatch is NULL, or MaximumSwiValue is
+                                  too large.
+  @retval EFI_OUT_OF_RESOURCES    SMRAM could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmSwDispatchCreate (
+  IN  EFI_SMM_SYSTEM_TABLE          *Smst,
+  IN  UINTN                         MaximumSwiValue,
+  OUT EFI_SMM_SW_DISPATCH_PROTOCOL  **SwDispatch
+  )
+{
+  EFI_STATUS                Status;
+  SMM_SW_DISPATCH_INSTANCE  *Instance;
+  UINTN                     Size;
+  UINTN                     Index;
+
+  if (Smst == NULL || SwDispatch == NULL || MaximumSwiValue >= SMM_SW_DISPATCH_VALUE_COUNT) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Size   = OFFSET_OF (SMM_SW_DISPATCH_INSTANCE, Slots) + (MaximumSwiValue + 1) * sizeof (SMM_SW_DISPATCH_SLOT);
+  Status = Smst->SmmAllocatePool (EfiRuntimeServicesData, Size, (VOID **) &Instance);
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  ZeroMem (Instance, Size);
+  for (Index = 0; Index <= MaximumSwiValue; Index++) {
+    Instance->Slots[Index].Generation = 1;
+  }
+
+  GetPerformanceCounterProperties (&Instance->CounterStart, &Instance->CounterEnd);
+  Instance->Signature                  = SMM_SW_DISPATCH_SIGNATURE;
+  Instance->Smst                       = Smst;
+  Instance->SwDispatch.Register        = InternalSmmSwDispatchRegister;
+  Instance->SwDispatch.UnRegister      = InternalSmmSwDispatchUnRegister;
+  Instance->SwDispatch.MaximumSwiValue = MaximumSwiValue;
+
+  *SwDispatch = &Instance->SwDispatch;
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees a software SMI dispatch instance.
+
+  The caller must uninstall the protocol first.
+
+  @param  SwDispatch    The instance.
+
+**/
+VOID
+EFIAPI
+SmmSwDispatchDestroy (
+  IN EFI_SMM_SW_DISPATCH_PROTOCOL  *SwDispatch
+  )
+{
+  SMM_SW_DISPATCH_INSTANCE  *Instance;
+
+  if (SwDispatch == NULL) {
+    return;
+  }
+  Instance = SMM_SW_DISPATCH_INSTANCE_FROM_THIS (SwDispatch);
+  Instance->Signature = 0;
+  Instance->Smst->SmmFreePool (Instance);
+}
+
+/**
+  Calls the child registered for a software SMI input value.
+
+  @param  SwDispatch        The instance.
+  @param  SwSmiInputValue   The value written to the software SMI port.
+
+  @retval EFI_SUCCESS             The child was called.
+  @retval EFI_NOT_FOUND           No child is registered for the value.
+  @retval EFI_INVALID_PARAMETER   SwDispatch was not created by this library.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmSwDispatchDispatch (
+  IN EFI_SMM_SW_DISPATCH_PROTOCOL  *SwDispatch,
+  IN UINTN                         SwSmiInputValue
+  )
+{
+  SMM_SW_DISPATCH_INSTANCE     *Instance;
+  SMM_SW_DISPATCH_SLOT         *Slot;
+  SMM_SW_DISPATCH_STATISTICS   *Statistics;
+  EFI_SMM_SW_DISPATCH          Function;
+  EFI_SMM_SW_DISPATCH_CONTEXT  Context;
+  UINT32                       Generation;
+  UINT64                       Start;
+  UINT64                       End;
+  UINT64                       Ticks;
+  INTN                         Bucket;
+
+  if (SwDispatch == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Instance = BASE_CR (SwDispatch, SMM_SW_DISPATCH_INSTANCE, SwDispatch);
+  if (Instance->Signature != SMM_SW_DISPATCH_SIGNATURE) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (SwSmiInputValue > SwDispatch->MaximumSwiValue) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // The child is read once, so that it may unregister itself, or be unregistered
+  // by another processor, while it runs. The generation is read on both sides of
+  // it, so that the child is not given the handle of a newer child.
+  //
+  Slot = &Instance->Slots[SwSmiInputValue];
+  do {
+    Generation = Slot->Generation;
+    Function   = (EFI_SMM_SW_DISPATCH) (UINTN) Slot->Function;
+  } while (Generation != Slot->Generation);
+  if (Function == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Context.SwSmiInputValue = SwSmiInputValue;
+  Start = GetPerformanceCounter ();
+  Function (SMM_SW_DISPATCH_HANDLE (Generation, SwSmiInputValue), &Context);
+  End   = GetPerformanceCounter ();
+
+  //
+  // The performance counter may wrap from its last value to its first one during
+  // the call.
+  //
+  if (Instance->CounterEnd >= Instance->CounterStart) {
+    Ticks = (End >= Start) ? End - Start : (Instance->CounterEnd - Start) + (End - Instance->CounterStart);
+  } else {
+    Ticks = (Start >= End) ? Start - End : (Start - Instance->CounterEnd) + (Instance->CounterStart - End);
+  }
+
+  //
+  // The software SMIs of an instance are dispatched by one processor at a time,
+  // so the counters are updated without atomic operations.
+  //
+  Statistics = &Slot->Statistics;
+  Statistics->Count++;
+  Statistics->Ticks += Ticks;
+  if (Ticks > Statistics->MaximumTicks) {
+    Statistics->MaximumTicks = Ticks;
+  }
+  Bucket = HighBitSet64 (Ticks) / 2;
+  if (Bucket < 0) {
+    Bucket = 0;
+  } else if (Bucket >= SMM_SW_DISPATCH_HISTOGRAM_SIZE) {
+    Bucket = SMM_SW_DISPATCH_HISTOGRAM_SIZE - 1;
+  }
+  if (Statistics->Histogram[Bucket] != MAX_UINT32) {
+    Statistics->Histogram[Bucket]++;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the counters of a software SMI input value.
+
+  The counters are kept when the child is unregistered.
+
+  @param  SwDispatch        The instance.
+  @param  SwSmiInputValue   The input value.
+  @param  Statistics        Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_INVALID_PARAMETER   SwDispatch was not created by this library,
+                                  SwSmiInputValue is above MaximumSwiValue, or
+                                  Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+SmmSwDispatchGetStatistics (
+  IN  EFI_SMM_SW_DISPATCH_PROTOCOL  *SwDispatch,
+  IN  UINTN                         SwSmiInputValue,
+  OUT SMM_SW_DISPATCH_STATISTICS    *Statistics
+  )
+{
+  SMM_SW_DISPATCH_INSTANCE  *Instance;
+
+  if (SwDispatch == NULL || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Instance = BASE_CR (SwDispatch, SMM_SW_DISPATCH_INSTANCE, SwDispatch);
+  if (Instance->Signature != SMM_SW_DISPATCH_SIGNATURE || SwSmiInputValue > SwDispatch->MaximumSwiValue) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Statistics, &Instance->Slots[SwSmiInputValue].Statistics, sizeof (SMM_SW_DISPATCH_STATISTICS));
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/** @file
+  Internal definitions of the software SMI parent dispatch library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _SMM_SW_DISPATCH_INTERNAL_H_
+#define _SMM_SW_DISPATCH_INTERNAL_H_
+
+#include <FrameworkSmm.h>
+
+#include <Protocol/SmmSwDispatch.h>
+
+#include <Library/SmmSwDispatchLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/TimerLib.h>
+
+#define SMM_SW_DISPATCH_SIGNATURE  SIGNATURE_32 ('S', 'W', 'D', 'P')
+
+///
+/// The generations of a slot run from 1 to SMM_SW_DISPATCH_GENERATION_MAX, so that
+/// a dispatch handle fits in 32 bits and is never NULL.
+///
+#define SMM_SW_DISPATCH_GENERATION_MAX  0xFFFFFF
+
+///
+/// The dispatch handle of a child is its input value and the generation of its
+/// slot, so that registering allocates nothing, and the handle of a child that was
+/// unregistered does not match the next child of the same input value.
+///
+#define SMM_SW_DISPATCH_HANDLE(Generation, Value) \
+  ((EFI_HANDLE) (UINTN) (((UINTN) (Generation) << 8) | (Value)))
+#define SMM_SW_DISPATCH_HANDLE_VALUE(Handle)       ((UINTN) (Handle) & 0xFF)
+#define SMM_SW_DISPATCH_HANDLE_GENERATION(Handle)  ((UINTN) (Handle) >> 8)
+
+///
+/// The entry of an input value.
+///
+typedef struct {
+  ///
+  /// The child, or NULL. Written with InterlockedCompareExchangePointer() only.
+  ///
+  VOID * volatile             Function;
+  ///
+  /// The generation of the handle of the child. UnRegister() moves it to the next
+  /// generation before it clears Function.
+  ///
+  volatile UINT32             Generation;
+  SMM_SW_DISPATCH_STATISTICS  Statistics;
+} SMM_SW_DISPATCH_SLOT;
+
+typedef struct {
+  UINT32                        Signature;
+  EFI_SMM_SW_DISPATCH_PROTOCOL  SwDispatch;
+  EFI_SMM_SYSTEM_TABLE          *Smst;
+  UINT64                        CounterStart;   ///< First value of the performance counter.
+  UINT64                        CounterEnd;     ///< Last value of the performance counter.
+  ///
+  /// One slot per input value, from 0 to MaximumSwiValue.
+  ///
+  SMM_SW_DISPATCH_SLOT          Slots[1];
+} SMM_SW_DISPATCH_INSTANCE;
+
+#define SMM_SW_DISPATCH_INSTANCE_FROM_THIS(a) \
+  CR (a, SMM_SW_DISPATCH_INSTANCE, SwDispatch, SMM_SW_DISPATCH_SIGNATURE)
+
+#endif
@@ -0,0 +1,283 @@
+/** @file
+  Lookups of the firmware volume file index library.
+
+  The lookups read the index HOBs only, never the file headers of the volume.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FvFileIndexInternal.h"
+
+/**
+  Returns the index HOB that follows a HOB list position for a firmware volume.
+
+  @param  HobStart    The HOB list position to search from.
+  @param  FvBase      The base address of the firmware volume.
+
+  @return The data of the HOB, or NULL if there is none.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexFindHob (
+  IN CONST VOID            *HobStart,
+  IN EFI_PHYSICAL_ADDRESS  FvBase
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+  FV_FILE_INDEX_HOB     *Index;
+
+  for (Hob.Raw = GetNextGuidHob (&gFrameworkFvFileIndexHobGuid, HobStart);
+       Hob.Raw != NULL;
+       Hob.Raw = GetNextGuidHob (&gFrameworkFvFileIndexHobGuid, GET_NEXT_HOB (Hob))) {
+    Index = GET_GUID_HOB_DATA (Hob.Guid);
+    if (Index->FvBase == FvBase) {
+      return Index;
+    }
+  }
+  return NULL;
+}
+
+/**
+  Returns the first index HOB of a firmware volume.
+
+  @param  FvHeader    The firmware volume.
+
+  @return The data of the HOB whose FirstFile is 0, or NULL if the volume is not
+          indexed.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexFirstHob (
+  IN CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader
+  )
+{
+  return InternalFvIndexFindHob (GetHobList (), (EFI_PHYSICAL_ADDRESS) (UINTN) FvHeader);
+}
+
+/**
+  Returns the next index HOB of the same firmware volume.
+
+  @param  Index   The data of an index HOB.
+
+  @return The data of the next HOB of the volume, or NULL if Index is the last one.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexNextHob (
+  IN CONST FV_FILE_INDEX_HOB  *Index
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+
+  Hob.Raw = (UINT8 *) Index - sizeof (EFI_HOB_GUID_TYPE);
+  return InternalFvIndexFindHob (GET_NEXT_HOB (Hob), Index->FvBase);
+}
+
+/**
+  Returns the first index HOB of a firmware volume whose index is complete.
+
+  @param  FvHeader    The firmware volume.
+
+  @return The data of the HOB whose FirstFile is 0, or NULL if the volume is not
+          indexed.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexCompleteHob (
+  IN CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader
+  )
+{
+  FV_FILE_INDEX_HOB  *First;
+
+  First = InternalFvIndexFirstHob (FvHeader);
+  if (First == NULL || First->Complete == 0) {
+    return NULL;
+  }
+  return First;
+}
+
+/**
+  Finds a file of an indexed firmware volume by name.
+
+  A valid file is returned rather than a file marked for update with the same name.
+
+  @param  FvHeader      The firmware volume.
+  @param  FileName      The name of the file.
+  @param  FileHeader    Returns the header of the file.
+
+  @retval EFI_SUCCESS             The file was found.
+  @retval EFI_NOT_FOUND           The volume has no such file.
+  @retval EFI_NOT_READY           The volume is not indexed.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexFindFileByName (
+  IN  CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN  CONST EFI_GUID                    *FileName,
+  OUT EFI_FFS_FILE_HEADER               **FileHeader
+  )
+{
+  FV_FILE_INDEX_HOB    *First;
+  FV_FILE_INDEX_HOB    *Index;
+  FV_FILE_INDEX_ENTRY  *Found;
+  UINT32               FoundNumber;
+  UINT32               FileCount;
+  UINTN                Number;
+
+  if (FvHeader == NULL || FileName == NULL || FileHeader == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  First = InternalFvIndexCompleteHob (FvHeader);
+  if (First == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  Found       = NULL;
+  FoundNumber = 0;
+  FileCount   = 0;
+  for (Index = First; Index != NULL; Index = InternalFvIndexNextHob (Index)) {
+    for (Number = 0; Number < Index->FileCount; Number++) {
+      if (CompareGuid (&Index->Entry[Number].Name, FileName)) {
+        Found       = &Index->Entry[Number];
+        FoundNumber = Index->FirstFile + (UINT32) Number;
+        if (Found->State == EFI_FILE_DATA_VALID) {
+          break;
+        }
+      }
+    }
+    FileCount = Index->FirstFile + Index->FileCount;
+    if (Found != NULL && Found->State == EFI_FILE_DATA_VALID) {
+      break;
+    }
+  }
+
+  //
+  // A walk of the volume reads the headers up to the file, or all of them.
+  //
+  First->Lookups++;
+  if (Found == NULL) {
+    First->HeadersSaved += FileCount;
+    return EFI_NOT_FOUND;
+  }
+  First->HeadersSaved += FoundNumber + 1;
+  *FileHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FvHeader + Found->Offset);
+  return EFI_SUCCESS;
+}
+
+/**
+  Finds the next file of a type in an indexed firmware volume.
+
+  @param  FvHeader      The firmware volume.
+  @param  SearchType    The type of the file, or EFI_FV_FILETYPE_ALL for any type.
+  @param  FileHeader    On input, the file to start after, or NULL to start at the
+                        beginning of the volume. Returns the header of the file.
+
+  @retval EFI_SUCCESS             The file was found.
+  @retval EFI_NOT_FOUND           There is no more file of the type, or the input
+                                  file is not in the index.
+  @retval EFI_NOT_READY           The volume is not indexed.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexFindNextFile (
+  IN     CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN     EFI_FV_FILETYPE                   SearchType,
+  IN OUT EFI_FFS_FILE_HEADER               **FileHeader
+  )
+{
+  FV_FILE_INDEX_HOB    *First;
+  FV_FILE_INDEX_HOB    *Index;
+  FV_FILE_INDEX_ENTRY  *Entry;
+  UINT32               Offset;
+  UINT32               Start;
+  UINT32               FileNumber;
+  BOOLEAN              Started;
+  UINTN                Number;
+
+  if (FvHeader == NULL || FileHeader == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  First = InternalFvIndexCompleteHob (FvHeader);
+  if (First == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  Started = (BOOLEAN) (*FileHeader == NULL);
+  Offset  = Started ? 0 : (UINT32) ((UINT8 *) *FileHeader - (UINT8 *) FvHeader);
+  Start   = 0;
+  First->Lookups++;
+  for (Index = First; Index != NULL; Index = InternalFvIndexNextHob (Index)) {
+    for (Number = 0; Number < Index->FileCount; Number++) {
+      Entry      = &Index->Entry[Number];
+      FileNumber = Index->FirstFile + (UINT32) Number;
+      if (!Started) {
+        if (Entry->Offset == Offset) {
+          Started = TRUE;
+          Start   = FileNumber + 1;
+        }
+        continue;
+      }
+      if (SearchType == EFI_FV_FILETYPE_ALL || Entry->Type == SearchType) {
+        First->HeadersSaved += FileNumber - Start + 1;
+        *FileHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FvHeader + Entry->Offset);
+        return EFI_SUCCESS;
+      }
+    }
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Returns the counters of the index of a firmware volume.
+
+  @param  FvHeader      The firmware volume.
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_NOT_READY           The volume is not indexed.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexGetStatistics (
+  IN  CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  OUT FV_FILE_INDEX_STATISTICS          *Statistics
+  )
+{
+  FV_FILE_INDEX_HOB  *First;
+  FV_FILE_INDEX_HOB  *Index;
+
+  if (FvHeader == NULL || Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  First = InternalFvIndexCompleteHob (FvHeader);
+  if (First == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  Statistics->Files = 0;
+  for (Index = First; Index != NULL; Index = InternalFvIndexNextHob (Index)) {
+    Statistics->Files = Index->FirstFile + Index->FileCount;
+  }
+  Statistics->HeadersRead  = First->HeadersRead;
+  Statistics->Lookups      = First->Lookups;
+  Statistics->HeadersSaved = First->HeadersSaved;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,233 @@
+/** @file
+  Builds the file index of a firmware volume in GUIDed HOBs.
+
+  The file headers are read once, in order. The number of files is not known until
+  the end, so the entries are written to HOBs of a fixed number of entries that are
+  built as they fill up.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FvFileIndexInternal.h"
+
+/**
+  Builds an index HOB of a firmware volume.
+
+  @param  FvHeader    The firmware volume.
+  @param  FirstFile   The number of the first file of the HOB.
+
+  @return The data of the HOB, or NULL if the HOB could not be built.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexBuildHob (
+  IN CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN UINT32                            FirstFile
+  )
+{
+  FV_FILE_INDEX_HOB  *Index;
+
+  Index = BuildGuidHob (&gFrameworkFvFileIndexHobGuid, FV_FILE_INDEX_HOB_SIZE);
+  if (Index == NULL) {
+    return NULL;
+  }
+
+  ZeroMem (Index, FV_FILE_INDEX_HOB_SIZE);
+  Index->FvBase    = (EFI_PHYSICAL_ADDRESS) (UINTN) FvHeader;
+  Index->FvLength  = FvHeader->FvLength;
+  Index->FirstFile = FirstFile;
+  return Index;
+}
+
+/**
+  Indexes the files of a firmware volume, unless the volume is already indexed.
+
+  @param  FvHeader    The firmware volume, which must be memory mapped.
+
+  @retval EFI_SUCCESS             The volume is indexed.
+  @retval EFI_INVALID_PARAMETER   FvHeader is NULL.
+  @retval EFI_UNSUPPORTED         The volume is not formatted with a firmware file
+                                  system this library supports.
+  @retval EFI_VOLUME_CORRUPTED    The volume header or a file header is not valid,
+                                  or an earlier attempt to index the volume failed.
+  @retval EFI_OUT_OF_RESOURCES    The HOBs could not be built.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexBuild (
+  IN CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader
+  )
+{
+  CONST EFI_FIRMWARE_VOLUME_EXT_HEADER  *ExtHeader;
+  CONST EFI_FFS_FILE_HEADER             *FileHeader;
+  CONST UINT8                           *Byte;
+  FV_FILE_INDEX_HOB                     *First;
+  FV_FILE_INDEX_HOB                     *Index;
+  FV_FILE_INDEX_ENTRY                   *Entry;
+  BOOLEAN                               Ffs2;
+  BOOLEAN                               Ffs3;
+  UINT8                                 ErasePolarity;
+  UINT8                                 State;
+  UINT8                                 HighestBit;
+  UINT64                                Offset;
+  UINT64                                FileSize;
+  UINT32                                HeaderSize;
+  UINT32                                HeadersRead;
+  UINT32                                FileCount;
+  UINTN                                 Count;
+
+  if (FvHeader == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  First = InternalFvIndexFirstHob (FvHeader);
+  if (First != NULL) {
+    return (First->Complete != 0) ? EFI_SUCCESS : EFI_VOLUME_CORRUPTED;
+  }
+
+  if (FvHeader->Signature != EFI_FVH_SIGNATURE ||
+      FvHeader->HeaderLength < sizeof (EFI_FIRMWARE_VOLUME_HEADER) ||
+      FvHeader->FvLength < FvHeader->HeaderLength ||
+      FvHeader->FvLength > MAX_UINT32) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Ffs3 = CompareGuid (&FvHeader->FileSystemGuid, &gEfiFirmwareFileSystem3Guid);
+  Ffs2 = (BOOLEAN) (Ffs3 || CompareGuid (&FvHeader->FileSystemGuid, &gEfiFirmwareFileSystem2Guid));
+  if (!Ffs2 && !CompareGuid (&FvHeader->FileSystemGuid, &gEfiFirmwareFileSystemGuid)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Offset = FvHeader->HeaderLength;
+  if (FvHeader->ExtHeaderOffset != 0) {
+    if ((UINT64) FvHeader->ExtHeaderOffset + sizeof (EFI_FIRMWARE_VOLUME_EXT_HEADER) > FvHeader->FvLength) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+    ExtHeader = (CONST EFI_FIRMWARE_VOLUME_EXT_HEADER *) ((CONST UINT8 *) FvHeader + FvHeader->ExtHeaderOffset);
+    Offset    = (UINT64) FvHeader->ExtHeaderOffset + ExtHeader->ExtHeaderSize;
+  }
+  Offset        = ALIGN_VALUE (Offset, 8);
+  ErasePolarity = (UINT8) (((FvHeader->Attributes & EFI_FVB2_ERASE_POLARITY) != 0) ? 0xFF : 0);
+
+  //
+  // The first HOB marks the volume as indexed even if it has no file.
+  //
+  First = InternalFvIndexBuildHob (FvHeader, 0);
+  if (First == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Index       = First;
+  HeadersRead = 0;
+  FileCount   = 0;
+  while (Offset + sizeof (EFI_FFS_FILE_HEADER) <= FvHeader->FvLength) {
+    FileHeader = (CONST EFI_FFS_FILE_HEADER *) ((CONST UINT8 *) FvHeader + (UINTN) Offset);
+    HeadersRead++;
+
+    //
+    // A header that is all erased starts the free space.
+    //
+    Byte = (CONST UINT8 *) FileHeader;
+    for (Count = 0; Count < sizeof (EFI_FFS_FILE_HEADER) && Byte[Count] == ErasePolarity; Count++) {
+    }
+    if (Count == sizeof (EFI_FFS_FILE_HEADER)) {
+      break;
+    }
+
+    if (Ffs3 && IS_FFS_FILE2 (FileHeader)) {
+      HeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
+      if (Offset + HeaderSize > FvHeader->FvLength) {
+        break;
+      }
+      FileSize = FFS_FILE2_SIZE (FileHeader);
+    } else {
+      HeaderSize = sizeof (EFI_FFS_FILE_HEADER);
+      FileSize   = FFS_FILE_SIZE (FileHeader);
+    }
+
+    State = (UINT8) (FileHeader->State ^ ErasePolarity);
+    for (HighestBit = 0x80; HighestBit != 0 && (State & HighestBit) == 0; HighestBit >>= 1) {
+    }
+    if (HighestBit == EFI_FILE_HEADER_CONSTRUCTION || HighestBit == EFI_FILE_HEADER_INVALID) {
+      //
+      // The size of the file cannot be trusted, so only step over the header.
+      //
+      Offset = ALIGN_VALUE (Offset + HeaderSize, 8);
+      continue;
+    }
+    if (FileSize < HeaderSize || FileSize > FvHeader->FvLength - Offset) {
+      DEBUG ((DEBUG_ERROR, "FvFileIndex: file at offset 0x%lx of FV 0x%p is corrupted\n", Offset, FvHeader));
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if ((HighestBit == EFI_FILE_DATA_VALID || HighestBit == EFI_FILE_MARKED_FOR_UPDATE) &&
+        FileHeader->Type != EFI_FV_FILETYPE_FFS_PAD) {
+      if (Index->FileCount == FV_FILE_INDEX_ENTRIES_PER_HOB) {
+        Index = InternalFvIndexBuildHob (FvHeader, FileCount);
+        if (Index == NULL) {
+          return EFI_OUT_OF_RESOURCES;
+        }
+      }
+      Entry = &Index->Entry[Index->FileCount++];
+      CopyGuid (&Entry->Name, &FileHeader->Name);
+      Entry->Offset     = (UINT32) Offset;
+      Entry->Type       = FileHeader->Type;
+      Entry->Attributes = FileHeader->Attributes;
+      Entry->State      = HighestBit;
+      FileCount++;
+    }
+
+    Offset = ALIGN_VALUE (Offset + FileSize, 8);
+  }
+
+  First->HeadersRead = HeadersRead;
+  First->Complete    = 1;
+  return EFI_SUCCESS;
+}
+
+/**
+  Finds a firmware volume through the Find FV PPI, and indexes it.
+
+  The parameters and return values are those of EFI_PEI_FIND_FV_FINDFV. The
+  volume is returned even if it cannot be indexed; lookups then return
+  EFI_NOT_READY and the caller walks the volume.
+
+  @param  FindFv        The Find FV PPI.
+  @param  PeiServices   The PEI Services Table.
+  @param  FvNumber      The index of the firmware volume to locate.
+  @param  FvAddress     Returns the address of the volume.
+
+  @return The status returned by the Find FV PPI.
+
+**/
+EFI_STATUS
+EFIAPI
+FvFileIndexFindFv (
+  IN     EFI_PEI_FIND_FV_PPI         *FindFv,
+  IN     EFI_PEI_SERVICES            **PeiServices,
+  IN     UINT8                       *FvNumber,
+  IN OUT EFI_FIRMWARE_VOLUME_HEADER  **FvAddress
+  )
+{
+  EFI_STATUS  Status;
+  EFI_STATUS  IndexStatus;
+
+  Status = FindFv->FindFv (FindFv, PeiServices, FvNumber, FvAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  IndexStatus = FvFileIndexBuild (*FvAddress);
+  if (EFI_ERROR (IndexStatus)) {
+    DEBUG ((DEBUG_WARN, "FvFileIndex: FV 0x%p is not indexed - %r\n", *FvAddress, IndexStatus));
+  }
+  return Status;
+}
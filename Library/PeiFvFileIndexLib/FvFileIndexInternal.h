@@ -0,0 +1,92 @@
+/** @file
+  Internal definitions of the firmware volume file index library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _FV_FILE_INDEX_INTERNAL_H_
+#define _FV_FILE_INDEX_INTERNAL_H_
+
+#include <FrameworkPei.h>
+
+#include <Ppi/FindFv.h>
+
+#include <Guid/FvFileIndexHob.h>
+#include <Guid/FirmwareFileSystem.h>
+#include <Guid/FirmwareFileSystem2.h>
+#include <Guid/FirmwareFileSystem3.h>
+
+#include <Library/FvFileIndexLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+
+#define FV_FILE_INDEX_HOB_SIZE \
+  (sizeof (FV_FILE_INDEX_HOB) + (FV_FILE_INDEX_ENTRIES_PER_HOB - 1) * sizeof (FV_FILE_INDEX_ENTRY))
+
+/**
+  Returns the index HOB that follows a HOB list position for a firmware volume.
+
+  @param  HobStart    The HOB list position to search from.
+  @param  FvBase      The base address of the firmware volume.
+
+  @return The data of the HOB, or NULL if there is none.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexFindHob (
+  IN CONST VOID            *HobStart,
+  IN EFI_PHYSICAL_ADDRESS  FvBase
+  );
+
+/**
+  Returns the first index HOB of a firmware volume.
+
+  @param  FvHeader    The firmware volume.
+
+  @return The data of the HOB whose FirstFile is 0, or NULL if the volume is not
+          indexed.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexFirstHob (
+  IN CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader
+  );
+
+/**
+  Returns the next index HOB of the same firmware volume.
+
+  @param  Index   The data of an index HOB.
+
+  @return The data of the next HOB of the volume, or NULL if Index is the last one.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexNextHob (
+  IN CONST FV_FILE_INDEX_HOB  *Index
+  );
+
+/**
+  Returns the first index HOB of a firmware volume whose index is complete.
+
+  @param  FvHeader    The firmware volume.
+
+  @return The data of the HOB whose FirstFile is 0, or NULL if the volume is not
+          indexed.
+
+**/
+FV_FILE_INDEX_HOB *
+InternalFvIndexCompleteHob (
+  IN CONST EFI_FIRMWARE_VOLUME_HEADER  *FvHeader
+  );
+
+#endif
@@ -0,0 +1,344 @@
+/** @file
+  Lookups of the read-only variable index library.
+
+  The lookups read the index HOBs only, never the variable store.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "VariableIndexInternal.h"
+
+/**
+  Returns the index HOB that follows a HOB list position.
+
+  @param  HobStart    The HOB list position to search from.
+
+  @return The data of the HOB, or NULL if there is none.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexFindHob (
+  IN CONST VOID  *HobStart
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+
+  Hob.Raw = GetNextGuidHob (&gFrameworkVariableIndexHobGuid, HobStart);
+  if (Hob.Raw == NULL) {
+    return NULL;
+  }
+  return GET_GUID_HOB_DATA (Hob.Guid);
+}
+
+/**
+  Returns the first index HOB.
+
+  @return The data of the HOB whose FirstVariable is 0, or NULL if the variables
+          are not indexed.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexFirstHob (
+  VOID
+  )
+{
+  return InternalVariableIndexFindHob (GetHobList ());
+}
+
+/**
+  Returns the next index HOB.
+
+  @param  Index   The data of an index HOB.
+
+  @return The data of the next HOB, or NULL if Index is the last one.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexNextHob (
+  IN CONST VARIABLE_INDEX_HOB  *Index
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+
+  Hob.Raw = (UINT8 *) Index - sizeof (EFI_HOB_GUID_TYPE);
+  return InternalVariableIndexFindHob (GET_NEXT_HOB (Hob));
+}
+
+/**
+  Returns the first index HOB if all the variables are indexed.
+
+  @return The data of the HOB whose FirstVariable is 0, or NULL if the variables
+          are not indexed.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexCompleteHob (
+  VOID
+  )
+{
+  VARIABLE_INDEX_HOB  *First;
+
+  First = InternalVariableIndexFirstHob ();
+  if (First == NULL || First->Complete == 0) {
+    return NULL;
+  }
+  return First;
+}
+
+/**
+  Finds the record of a variable.
+
+  @param  First         The first index HOB.
+  @param  VariableName  The name of the variable.
+  @param  VendorGuid    The vendor GUID of the variable.
+  @param  Hob           Returns the index HOB of the record.
+
+  @return The record, or NULL if the variable is not indexed.
+
+**/
+VARIABLE_INDEX_RECORD *
+InternalVariableIndexFind (
+  IN     VARIABLE_INDEX_HOB  *First,
+  IN     CONST CHAR16        *VariableName,
+  IN     CONST EFI_GUID      *VendorGuid,
+  OUT    VARIABLE_INDEX_HOB  **Hob
+  )
+{
+  VARIABLE_INDEX_HOB     *Index;
+  VARIABLE_INDEX_RECORD  *Record;
+  UINTN                  NameSize;
+  UINT32                 Hash;
+  UINT16                 Offset;
+
+  NameSize = StrSize (VariableName);
+  Hash     = InternalVariableIndexHash (VariableName, NameSize, VendorGuid);
+  for (Index = First; Index != NULL; Index = InternalVariableIndexNextHob (Index)) {
+    for (Offset = Index->Bucket[Hash % VARIABLE_INDEX_BUCKETS]; Offset != VARIABLE_INDEX_END; Offset = Record->Next) {
+      Record = VARIABLE_INDEX_RECORD_AT (Index, Offset);
+      if (Record->Hash == Hash && Record->NameSize == NameSize &&
+          CompareGuid (&Record->VendorGuid, VendorGuid) &&
+          CompareMem (VARIABLE_INDEX_RECORD_NAME (Record), VariableName, NameSize) == 0) {
+        *Hob = Index;
+        return Record;
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+  Returns the value of an indexed variable.
+
+  The parameters and return values are those of EFI_PEI_GET_VARIABLE, with the
+  addition of EFI_NOT_READY when the variables are not indexed. PeiServices is not
+  used, so this function can also be called in DXE, on the snapshot of the
+  variables taken in PEI.
+
+  @param  PeiServices     The PEI Services Table.
+  @param  VariableName    The name of the variable.
+  @param  VendorGuid      The vendor GUID of the variable.
+  @param  Attributes      Returns the attributes of the variable. Optional.
+  @param  DataSize        On input, the size of Data. On output, the size of the
+                          variable.
+  @param  Data            Returns the value of the variable.
+
+  @retval EFI_SUCCESS             The variable was returned.
+  @retval EFI_NOT_FOUND           The variable was not found.
+  @retval EFI_BUFFER_TOO_SMALL    DataSize is too small for the variable.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_READY           The variables are not indexed.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexGetVariable (
+  IN     EFI_PEI_SERVICES  **PeiServices,
+  IN     CHAR16            *VariableName,
+  IN     EFI_GUID          *VendorGuid,
+  OUT    UINT32            *Attributes OPTIONAL,
+  IN OUT UINTN             *DataSize,
+  OUT    VOID              *Data
+  )
+{
+  VARIABLE_INDEX_HOB     *First;
+  VARIABLE_INDEX_HOB     *Index;
+  VARIABLE_INDEX_RECORD  *Record;
+
+  if (VariableName == NULL || VendorGuid == NULL || DataSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  First = InternalVariableIndexCompleteHob ();
+  if (First == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  Record = InternalVariableIndexFind (First, VariableName, VendorGuid, &Index);
+  if (Record == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (*DataSize < Record->DataSize) {
+    *DataSize = Record->DataSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  if (Data == NULL && Record->DataSize != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Data, VARIABLE_INDEX_RECORD_DATA (Record), Record->DataSize);
+  *DataSize = Record->DataSize;
+  if (Attributes != NULL) {
+    *Attributes = Record->Attributes;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the name of the indexed variable that follows a variable.
+
+  The parameters and return values are those of EFI_PEI_GET_NEXT_VARIABLE_NAME,
+  with the addition of EFI_NOT_READY when the variables are not indexed. The
+  variables are returned in the order of the Read-only Variable PPI the index was
+  built from. PeiServices is not used.
+
+  @param  PeiServices       The PEI Services Table.
+  @param  VariableNameSize  On input, the size of VariableName. On output, the size
+                            of the name of the next variable.
+  @param  VariableName      On input, the name of the previous variable, or an
+                            empty string to start with the first variable. On
+                            output, the name of the next variable.
+  @param  VendorGuid        On input, the vendor GUID of the previous variable. On
+                            output, the vendor GUID of the next variable.
+
+  @retval EFI_SUCCESS             The next variable was returned.
+  @retval EFI_NOT_FOUND           There is no next variable, or the previous
+                                  variable is not indexed.
+  @retval EFI_BUFFER_TOO_SMALL    VariableNameSize is too small for the name.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_READY           The variables are not indexed.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexGetNextVariableName (
+  IN     EFI_PEI_SERVICES  **PeiServices,
+  IN OUT UINTN             *VariableNameSize,
+  IN OUT CHAR16            *VariableName,
+  IN OUT EFI_GUID          *VendorGuid
+  )
+{
+  VARIABLE_INDEX_HOB     *First;
+  VARIABLE_INDEX_HOB     *Index;
+  VARIABLE_INDEX_RECORD  *Record;
+  UINT32                 Offset;
+
+  if (VariableNameSize == NULL || VariableName == NULL || VendorGuid == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  First = InternalVariableIndexCompleteHob ();
+  if (First == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  if (VariableName[0] == L'\0') {
+    Index  = First;
+    Offset = 0;
+  } else {
+    Record = InternalVariableIndexFind (First, VariableName, VendorGuid, &Index);
+    if (Record == NULL) {
+      return EFI_NOT_FOUND;
+    }
+    Offset = (UINT32) ((UINT8 *) Record - (UINT8 *) VARIABLE_INDEX_RECORD_AT (Index, 0)) +
+             (UINT32) VARIABLE_INDEX_RECORD_SIZE (Record->NameSize, Record->DataSize);
+  }
+
+  //
+  // The records follow each other in the HOBs, in the order of the variables.
+  //
+  while (Offset >= Index->RecordBytes) {
+    Index = InternalVariableIndexNextHob (Index);
+    if (Index == NULL) {
+      return EFI_NOT_FOUND;
+    }
+    Offset = 0;
+  }
+  Record = VARIABLE_INDEX_RECORD_AT (Index, Offset);
+
+  if (*VariableNameSize < Record->NameSize) {
+    *VariableNameSize = Record->NameSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  CopyMem (VariableName, VARIABLE_INDEX_RECORD_NAME (Record), Record->NameSize);
+  CopyGuid (VendorGuid, &Record->VendorGuid);
+  *VariableNameSize = Record->NameSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the counters of the variable index.
+
+  The counters are computed from the index HOBs, which lookups do not write, so
+  they describe the index rather than the lookups made so far.
+
+  @param  Statistics    Returns the counters.
+
+  @retval EFI_SUCCESS             The counters were returned.
+  @retval EFI_NOT_READY           The variables are not indexed.
+  @retval EFI_INVALID_PARAMETER   Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexGetStatistics (
+  OUT VARIABLE_INDEX_STATISTICS  *Statistics
+  )
+{
+  VARIABLE_INDEX_HOB     *First;
+  VARIABLE_INDEX_HOB     *Index;
+  VARIABLE_INDEX_RECORD  *Record;
+  UINTN                  Bucket;
+  UINT32                 Depth[VARIABLE_INDEX_BUCKETS];
+  UINT16                 Offset;
+
+  if (Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  First = InternalVariableIndexCompleteHob ();
+  if (First == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  Statistics->Variables  = 0;
+  Statistics->StoreCalls = First->StoreCalls;
+  Statistics->Hobs       = 0;
+  Statistics->Probes     = 0;
+
+  //
+  // A lookup compares the records of the bucket of the variable in each HOB
+  // before the HOB of its record, then the records of the bucket up to its own.
+  //
+  ZeroMem (Depth, sizeof (Depth));
+  for (Index = First; Index != NULL; Index = InternalVariableIndexNextHob (Index)) {
+    Statistics->Hobs++;
+    for (Bucket = 0; Bucket < VARIABLE_INDEX_BUCKETS; Bucket++) {
+      for (Offset = Index->Bucket[Bucket]; Offset != VARIABLE_INDEX_END; Offset = Record->Next) {
+        Record = VARIABLE_INDEX_RECORD_AT (Index, Offset);
+        Depth[Bucket]++;
+        Statistics->Probes += Depth[Bucket];
+      }
+    }
+    Statistics->Variables = Index->FirstVariable + Index->VariableCount;
+  }
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,329 @@
+/** @file
+  Construction of the read-only variable index.
+
+  The variables are enumerated once through the Read-only Variable PPI, and each
+  one is read straight into the free space of the last index HOB. A HOB cannot grow
+  once it is built, so a variable that does not fit starts a new HOB, twice as
+  large as the one before.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "VariableIndexInternal.h"
+
+#define VARIABLE_INDEX_HASH_OFFSET_BASIS  0x811C9DC5
+#define VARIABLE_INDEX_HASH_PRIME         0x01000193
+
+CONST EFI_PEI_READ_ONLY_VARIABLE_PPI  mVariableIndexPpi = {
+  VariableIndexGetVariable,
+  VariableIndexGetNextVariableName
+};
+
+CONST EFI_PEI_PPI_DESCRIPTOR  mVariableIndexPpiList = {
+  (EFI_PEI_PPI_DESCRIPTOR_PPI | EFI_PEI_PPI_DESCRIPTOR_TERMINATE_LIST),
+  &gEfiPeiReadOnlyVariablePpiGuid,
+  (VOID *) &mVariableIndexPpi
+};
+
+/**
+  Computes the hash of a variable name and vendor GUID.
+
+  The hash is FNV-1a over the bytes of the name, including its terminator, and of
+  the vendor GUID.
+
+  @param  VariableName    The name of the variable.
+  @param  NameSize        The size of the name in bytes, including the terminator.
+  @param  VendorGuid      The vendor GUID of the variable.
+
+  @return The hash.
+
+**/
+UINT32
+InternalVariableIndexHash (
+  IN CONST CHAR16    *VariableName,
+  IN UINTN           NameSize,
+  IN CONST EFI_GUID  *VendorGuid
+  )
+{
+  CONST UINT8  *Byte;
+  UINT32       Hash;
+  UINTN        Index;
+
+  Hash = VARIABLE_INDEX_HASH_OFFSET_BASIS;
+  Byte = (CONST UINT8 *) VariableName;
+  for (Index = 0; Index < NameSize; Index++) {
+    Hash = (Hash ^ Byte[Index]) * VARIABLE_INDEX_HASH_PRIME;
+  }
+  Byte = (CONST UINT8 *) VendorGuid;
+  for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+    Hash = (Hash ^ Byte[Index]) * VARIABLE_INDEX_HASH_PRIME;
+  }
+  return Hash;
+}
+
+/**
+  Returns the next variable name of a Read-only Variable PPI, growing the name
+  buffer when the name does not fit.
+
+  @param  PeiServices   The PEI Services Table.
+  @param  Variable      The Read-only Variable PPI.
+  @param  Name          The name buffer, which is reallocated when it is too small.
+  @param  NameSize      The size of the name buffer.
+  @param  VendorGuid    The vendor GUID of the variable.
+  @param  StoreCalls    Incremented by the calls to the PPI.
+
+  @retval EFI_SUCCESS     The next variable was returned.
+  @retval EFI_NOT_FOUND   There is no next variable.
+  @retval Others          The status returned by the PPI, or EFI_OUT_OF_RESOURCES.
+
+**/
+EFI_STATUS
+InternalVariableIndexNextName (
+  IN     EFI_PEI_SERVICES                **PeiServices,
+  IN     EFI_PEI_READ_ONLY_VARIABLE_PPI  *Variable,
+  IN OUT CHAR16                          **Name,
+  IN OUT UINTN                           *NameSize,
+  IN OUT EFI_GUID                        *VendorGuid,
+  IN OUT UINT32                          *StoreCalls
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      *Larger;
+  UINTN       Size;
+
+  Size   = *NameSize;
+  Status = Variable->PeiGetNextVariableName (PeiServices, &Size, *Name, VendorGuid);
+  (*StoreCalls)++;
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    Larger = AllocatePool (Size);
+    if (Larger == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    StrCpy (Larger, *Name);
+    FreePool (*Name);
+    *Name     = Larger;
+    *NameSize = Size;
+    Status    = Variable->PeiGetNextVariableName (PeiServices, &Size, *Name, VendorGuid);
+    (*StoreCalls)++;
+  }
+  return Status;
+}
+
+/**
+  Builds an index HOB.
+
+  @param  FirstVariable   The number of the first record of the HOB.
+  @param  RecordBytes     The size of the records of the HOB.
+
+  @return The data of the HOB, or NULL if the HOB could not be built.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexBuildHob (
+  IN UINT32  FirstVariable,
+  IN UINTN   RecordBytes
+  )
+{
+  VARIABLE_INDEX_HOB  *Index;
+
+  Index = BuildGuidHob (&gFrameworkVariableIndexHobGuid, sizeof (VARIABLE_INDEX_HOB) + RecordBytes);
+  if (Index == NULL) {
+    return NULL;
+  }
+
+  ZeroMem (Index, sizeof (VARIABLE_INDEX_HOB));
+  SetMem16 (Index->Bucket, sizeof (Index->Bucket), VARIABLE_INDEX_END);
+  Index->FirstVariable = FirstVariable;
+  return Index;
+}
+
+/**
+  Indexes the variables returned by a Read-only Variable PPI, unless they are
+  already indexed.
+
+  @param  PeiServices   The PEI Services Table.
+  @param  Variable      The Read-only Variable PPI to read the variables from.
+
+  @retval EFI_SUCCESS             The variables are indexed.
+  @retval EFI_INVALID_PARAMETER   Variable is NULL.
+  @retval EFI_UNSUPPORTED         A variable is too large to be kept in a HOB.
+  @retval EFI_OUT_OF_RESOURCES    The HOBs could not be built.
+  @retval EFI_VOLUME_CORRUPTED    An earlier attempt to index the variables failed.
+  @retval Others                  The status returned by the Read-only Variable PPI.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexBuild (
+  IN EFI_PEI_SERVICES                **PeiServices,
+  IN EFI_PEI_READ_ONLY_VARIABLE_PPI  *Variable
+  )
+{
+  EFI_STATUS             Status;
+  VARIABLE_INDEX_HOB     *First;
+  VARIABLE_INDEX_HOB     *Index;
+  VARIABLE_INDEX_RECORD  *Record;
+  CHAR16                 *Name;
+  UINTN                  NameBufferSize;
+  UINTN                  NameSize;
+  EFI_GUID               VendorGuid;
+  UINT32                 Attributes;
+  UINTN                  DataSize;
+  UINTN                  RecordSize;
+  UINTN                  Capacity;
+  UINT32                 StoreCalls;
+  UINT32                 VariableCount;
+  UINTN                  Bucket;
+
+  if (Variable == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  First = InternalVariableIndexFirstHob ();
+  if (First != NULL) {
+    return (First->Complete != 0) ? EFI_SUCCESS : EFI_VOLUME_CORRUPTED;
+  }
+
+  NameBufferSize = VARIABLE_INDEX_NAME_SIZE;
+  Name           = AllocateZeroPool (NameBufferSize);
+  if (Name == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // The first HOB marks the variables as indexed even if there is none.
+  //
+  Capacity = VARIABLE_INDEX_FIRST_RECORD_BYTES;
+  First    = InternalVariableIndexBuildHob (0, Capacity);
+  if (First == NULL) {
+    FreePool (Name);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Index         = First;
+  StoreCalls    = 0;
+  VariableCount = 0;
+  ZeroMem (&VendorGuid, sizeof (VendorGuid));
+  while (TRUE) {
+    Status = InternalVariableIndexNextName (PeiServices, Variable, &Name, &NameBufferSize, &VendorGuid, &StoreCalls);
+    if (Status == EFI_NOT_FOUND) {
+      break;
+    }
+    if (EFI_ERROR (Status)) {
+      FreePool (Name);
+      return Status;
+    }
+    NameSize = StrSize (Name);
+
+    //
+    // Read the data after the name in the free space of the HOB. The PPI returns
+    // the size of the data if it does not fit, and the variable is read again
+    // into a new HOB large enough for it.
+    //
+    while (TRUE) {
+      DataSize = 0;
+      Status   = EFI_BUFFER_TOO_SMALL;
+      Record   = VARIABLE_INDEX_RECORD_AT (Index, Index->RecordBytes);
+      if (Index->RecordBytes + sizeof (VARIABLE_INDEX_RECORD) + NameSize <= Capacity) {
+        Record->NameSize = (UINT32) NameSize;
+        DataSize = Capacity - Index->RecordBytes - sizeof (VARIABLE_INDEX_RECORD) - NameSize;
+        Status   = Variable->PeiGetVariable (
+                             PeiServices,
+                             Name,
+                             &VendorGuid,
+                             &Attributes,
+                             &DataSize,
+                             VARIABLE_INDEX_RECORD_DATA (Record)
+                             );
+        StoreCalls++;
+      }
+      if (Status != EFI_BUFFER_TOO_SMALL) {
+        break;
+      }
+
+      RecordSize = VARIABLE_INDEX_RECORD_SIZE (NameSize, DataSize);
+      if (RecordSize > VARIABLE_INDEX_MAX_RECORD_BYTES) {
+        DEBUG ((DEBUG_WARN, "VariableIndex: variable %s is too large to index\n", Name));
+        FreePool (Name);
+        return EFI_UNSUPPORTED;
+      }
+      Capacity = MAX (MIN (Capacity * 2, VARIABLE_INDEX_MAX_RECORD_BYTES), RecordSize);
+      Index    = InternalVariableIndexBuildHob (VariableCount, Capacity);
+      if (Index == NULL) {
+        FreePool (Name);
+        return EFI_OUT_OF_RESOURCES;
+      }
+    }
+    if (EFI_ERROR (Status)) {
+      FreePool (Name);
+      return Status;
+    }
+
+    RecordSize = VARIABLE_INDEX_RECORD_SIZE (NameSize, DataSize);
+    CopyGuid (&Record->VendorGuid, &VendorGuid);
+    CopyMem (VARIABLE_INDEX_RECORD_NAME (Record), Name, NameSize);
+    Record->Attributes = Attributes;
+    Record->DataSize   = (UINT32) DataSize;
+    Record->Hash       = InternalVariableIndexHash (Name, NameSize, &VendorGuid);
+    ZeroMem (Record->Reserved, sizeof (Record->Reserved));
+
+    Bucket                = Record->Hash % VARIABLE_INDEX_BUCKETS;
+    Record->Next          = Index->Bucket[Bucket];
+    Index->Bucket[Bucket] = (UINT16) Index->RecordBytes;
+    Index->RecordBytes   += (UINT32) RecordSize;
+    Index->VariableCount++;
+    VariableCount++;
+  }
+
+  FreePool (Name);
+  First->StoreCalls = StoreCalls;
+  First->Complete   = 1;
+  return EFI_SUCCESS;
+}
+
+/**
+  Indexes the variables of the installed Read-only Variable PPI, and reinstalls
+  the PPI with an instance that answers from the index.
+
+  The installed PPI is left in place if the variables cannot be indexed.
+
+  @param  PeiServices   The PEI Services Table.
+
+  @retval EFI_SUCCESS     The indexed PPI is installed.
+  @retval Others          The status returned by VariableIndexBuild() or by the PEI
+                          Services.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableIndexInstall (
+  IN EFI_PEI_SERVICES  **PeiServices
+  )
+{
+  EFI_STATUS                      Status;
+  EFI_PEI_PPI_DESCRIPTOR          *Descriptor;
+  EFI_PEI_READ_ONLY_VARIABLE_PPI  *Variable;
+
+  Status = PeiServicesLocatePpi (&gEfiPeiReadOnlyVariablePpiGuid, 0, &Descriptor, (VOID **) &Variable);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (Variable->PeiGetVariable == VariableIndexGetVariable) {
+    return EFI_SUCCESS;
+  }
+
+  Status = VariableIndexBuild (PeiServices, Variable);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "VariableIndex: variables are not indexed - %r\n", Status));
+    return Status;
+  }
+
+  return PeiServicesReInstallPpi (Descriptor, &mVariableIndexPpiList);
+}
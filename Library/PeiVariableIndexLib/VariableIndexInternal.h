@@ -0,0 +1,129 @@
+/** @file
+  Internal definitions of the read-only variable index library.
+
+Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _VARIABLE_INDEX_INTERNAL_H_
+#define _VARIABLE_INDEX_INTERNAL_H_
+
+#include <FrameworkPei.h>
+
+#include <Ppi/ReadOnlyVariable.h>
+
+#include <Guid/VariableIndexHob.h>
+
+#include <Library/VariableIndexLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PeiServicesLib.h>
+
+#define VARIABLE_INDEX_NAME_SIZE    0x80
+
+///
+/// Size of the records of the first index HOB. Each next HOB is twice as large, up
+/// to VARIABLE_INDEX_MAX_RECORD_BYTES.
+///
+#define VARIABLE_INDEX_FIRST_RECORD_BYTES   0x1000
+
+/**
+  Computes the hash of a variable name and vendor GUID.
+
+  The hash is FNV-1a over the bytes of the name, including its terminator, and of
+  the vendor GUID.
+
+  @param  VariableName    The name of the variable.
+  @param  NameSize        The size of the name in bytes, including the terminator.
+  @param  VendorGuid      The vendor GUID of the variable.
+
+  @return The hash.
+
+**/
+UINT32
+InternalVariableIndexHash (
+  IN CONST CHAR16    *VariableName,
+  IN UINTN           NameSize,
+  IN CONST EFI_GUID  *VendorGuid
+  );
+
+/**
+  Returns the index HOB that follows a HOB list position.
+
+  @param  HobStart    The HOB list position to search from.
+
+  @return The data of the HOB, or NULL if there is none.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexFindHob (
+  IN CONST VOID  *HobStart
+  );
+
+/**
+  Returns the first index HOB.
+
+  @return The data of the HOB whose FirstVariable is 0, or NULL if the variables
+          are not indexed.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexFirstHob (
+  VOID
+  );
+
+/**
+  Returns the next index HOB.
+
+  @param  Index   The data of an index HOB.
+
+  @return The data of the next HOB, or NULL if Index is the last one.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexNextHob (
+  IN CONST VARIABLE_INDEX_HOB  *Index
+  );
+
+/**
+  Returns the first index HOB if all the variables are indexed.
+
+  @return The data of the HOB whose FirstVariable is 0, or NULL if the variables
+          are not indexed.
+
+**/
+VARIABLE_INDEX_HOB *
+InternalVariableIndexCompleteHob (
+  VOID
+  );
+
+/**
+  Finds the record of a variable.
+
+  @param  First         The first index HOB.
+  @param  VariableName  The name of the variable.
+  @param  VendorGuid    The vendor GUID of the variable.
+  @param  Hob           Returns the index HOB of the record.
+
+  @return The record, or NULL if the variable is not indexed.
+
+**/
+VARIABLE_INDEX_RECORD *
+InternalVariableIndexFind (
+  IN     VARIABLE_INDEX_HOB  *First,
+  IN     CONST CHAR16        *VariableName,
+  IN     CONST EFI_GUID      *VendorGuid,
+  OUT    VARIABLE_INDEX_HOB  **Hob
+  );
+
+#endif